@@ -0,0 +1,112 @@
+#include "./hashtable.h"
+#include "../plugins/common.h"
+#include "../plugins/utils.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define MP_HASHTABLE_INITIAL_SLOTS 64
+
+/* FNV-1a, of the lower case characters if the table ignores the case */
+static size_t mp_hashtable_hash(const mp_hashtable *table, const char *key) {
+	uint32_t hash = 2166136261U;
+	for (const unsigned char *character = (const unsigned char *)key; *character != '\0';
+		 character++) {
+		unsigned char byte = table->ignore_case ? (unsigned char)tolower(*character) : *character;
+		hash = (hash ^ byte) * 16777619U;
+	}
+	return hash;
+}
+
+/* the slot of the key, or the empty slot it would go to */
+static mp_hashtable_slot *mp_hashtable_find(const mp_hashtable *table, mp_hashtable_slot *slots,
+											size_t slots_num, const char *key) {
+	size_t slot = mp_hashtable_hash(table, key) & (slots_num - 1);
+	while (slots[slot].key != NULL) {
+		int difference =
+			table->ignore_case ? strcasecmp(slots[slot].key, key) : strcmp(slots[slot].key, key);
+		if (difference == 0) {
+			break;
+		}
+		slot = (slot + 1) & (slots_num - 1);
+	}
+	return &slots[slot];
+}
+
+static void mp_hashtable_grow(mp_hashtable *table) {
+	size_t slots_num =
+		table->slots_num == 0 ? MP_HASHTABLE_INITIAL_SLOTS : 2 * table->slots_num;
+	mp_hashtable_slot *slots = calloc(slots_num, sizeof(mp_hashtable_slot));
+	if (slots == NULL) {
+		die(STATE_UNKNOWN, "%s - %s #%d: %s", __FILE__, __func__, __LINE__, "calloc failed");
+	}
+
+	for (size_t i = 0; i < table->slots_num; i++) {
+		if (table->slots[i].key != NULL) {
+			*mp_hashtable_find(table, slots, slots_num, table->slots[i].key) = table->slots[i];
+		}
+	}
+	free(table->slots);
+	table->slots = slots;
+	table->slots_num = slots_num;
+}
+
+mp_hashtable mp_hashtable_init(bool ignore_case) {
+	mp_hashtable result = {
+		.slots = NULL,
+		.slots_num = 0,
+		.keys_num = 0,
+		.ignore_case = ignore_case,
+	};
+	return result;
+}
+
+void mp_hashtable_clear(mp_hashtable *table) {
+	for (size_t i = 0; i < table->slots_num; i++) {
+		free(table->slots[i].key);
+		table->slots[i].key = NULL;
+	}
+	table->keys_num = 0;
+}
+
+void mp_hashtable_free(mp_hashtable *table) {
+	mp_hashtable_clear(table);
+	free(table->slots);
+	*table = mp_hashtable_init(table->ignore_case);
+}
+
+size_t mp_hashtable_add(mp_hashtable *table, const char *key, size_t index) {
+	size_t existing;
+	if (mp_hashtable_get(table, key, &existing)) {
+		return existing;
+	}
+
+	/* keep the table at most half full */
+	if (2 * (table->keys_num + 1) > table->slots_num) {
+		mp_hashtable_grow(table);
+	}
+
+	mp_hashtable_slot *slot = mp_hashtable_find(table, table->slots, table->slots_num, key);
+	slot->key = strdup(key);
+	if (slot->key == NULL) {
+		die(STATE_UNKNOWN, "%s - %s #%d: %s", __FILE__, __func__, __LINE__, "strdup failed");
+	}
+	slot->index = index;
+	table->keys_num++;
+	return index;
+}
+
+bool mp_hashtable_get(const mp_hashtable *table, const char *key, size_t *index) {
+	if (table->slots_num == 0) {
+		return false;
+	}
+	const mp_hashtable_slot *slot = mp_hashtable_find(table, table->slots, table->slots_num, key);
+	if (slot->key == NULL) {
+		return false;
+	}
+	*index = slot->index;
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../config.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A string keyed hash table with open addressing. It maps names to the
+ * positions of what they name in an array of the caller, which keeps its
+ * order and can be iterated or sorted. The keys are copied.
+ */
+typedef struct {
+	char *key;
+	size_t index;
+} mp_hashtable_slot;
+
+typedef struct {
+	mp_hashtable_slot *slots;
+	size_t slots_num; /* zero or a power of two, at most half of the slots are used */
+	size_t keys_num;
+	bool ignore_case;
+} mp_hashtable;
+
+/* an empty table, it does not allocate until the first key is added */
+mp_hashtable mp_hashtable_init(bool ignore_case);
+void mp_hashtable_free(mp_hashtable *table);
+
+/* removes all keys and keeps the slots */
+void mp_hashtable_clear(mp_hashtable *table);
+
+/*
+ * Adds key with index unless the table already has it. Returns the index
+ * the key maps to afterwards, so the key was added if that is index.
+ */
+size_t mp_hashtable_add(mp_hashtable *table, const char *key, size_t index);
+
+/* stores the index of key in *index, returns false if the table does not have it */
+bool mp_hashtable_get(const mp_hashtable *table, const char *key, size_t *index);
@@ -0,0 +1,69 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "hashtable.h"
+
+#include "tap.h"
+
+#include <stdio.h>
+
+int main(void) {
+	plan_tests(10);
+
+	mp_hashtable table = mp_hashtable_init(false);
+	size_t index = 0;
+	ok(!mp_hashtable_get(&table, "alice", &index) && table.slots_num == 0,
+	   "An empty table finds nothing and has no slots");
+
+	ok(mp_hashtable_add(&table, "alice", 0) == 0 && mp_hashtable_add(&table, "bob", 1) == 1,
+	   "New keys map to their index");
+	ok(mp_hashtable_add(&table, "alice", 2) == 0 && table.keys_num == 2,
+	   "Existing keys keep their index");
+	ok(!mp_hashtable_get(&table, "Alice", &index), "Keys are case sensitive by default");
+
+	char key[32];
+	for (size_t i = 2; i < 1000; i++) {
+		snprintf(key, sizeof(key), "key_%zu", i);
+		mp_hashtable_add(&table, key, i);
+	}
+	ok(table.keys_num == 1000 && 2 * table.keys_num <= table.slots_num,
+	   "The table stays at most half full while it grows");
+	ok(mp_hashtable_get(&table, "key_777", &index) && index == 777 &&
+		   mp_hashtable_get(&table, "bob", &index) && index == 1,
+	   "Keys are found after growing");
+	ok(!mp_hashtable_get(&table, "key_1000", &index), "Missing keys are not found");
+
+	size_t slots_num = table.slots_num;
+	mp_hashtable_clear(&table);
+	ok(table.keys_num == 0 && table.slots_num == slots_num &&
+		   !mp_hashtable_get(&table, "bob", &index),
+	   "Clearing keeps the slots and removes the keys");
+	mp_hashtable_free(&table);
+
+	mp_hashtable names = mp_hashtable_init(true);
+	mp_hashtable_add(&names, "Innodb_rows_read", 0);
+	ok(mp_hashtable_get(&names, "INNODB_ROWS_READ", &index) && index == 0 &&
+		   mp_hashtable_add(&names, "innodb_rows_read", 1) == 0,
+	   "Tables which ignore the case find keys in any case");
+	mp_hashtable_free(&names);
+	ok(names.slots == NULL && names.keys_num == 0 && names.ignore_case,
+	   "A freed table is empty and can be used again");
+
+	return exit_status();
+}
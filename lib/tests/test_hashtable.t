@@ -0,0 +1,6 @@
+#!/usr/bin/perl
+use Test::More;
+if (! -e "./test_hashtable") {
+	plan skip_all => "./test_hashtable not compiled - please enable libtap library to test";
+}
+exec "./test_hashtable";
@@ -28,7 +28,7 @@
 #include "utils_base.c"
 
 int main(int argc, char **argv) {
-	plan_tests(155);
+	plan_tests(162);
 
 	ok(this_monitoring_plugin == NULL, "monitoring_plugin not initialised");
 
@@ -337,5 +337,59 @@ int main(int argc, char **argv) {
 	ok(ERROR == mp_translate_state("10"), "Translate state string: bad numeric string 3");
 	ok(ERROR == mp_translate_state(""), "Translate state string: empty string");
 
+	/* state files */
+	char *fake_argv[] = {"./test_utils", "here", "--and", "now"};
+	ok(!strcmp(_np_state_generate_key(4, fake_argv), "bd72da9f78ff1419fad921ea5e43ce56508aef6c"),
+	   "State key is a hash of argv");
+
+	char state_dir[] = "/tmp/test_utils_state.XXXXXX";
+	if (mkdtemp(state_dir) == NULL) {
+		die(STATE_UNKNOWN, "mkdtemp() failed\n");
+	}
+	setenv("MP_STATE_PATH", state_dir, 1);
+	state_key key = np_enable_state("roundtrip", 3, "check_test", 4, fake_argv);
+	char expected_filename[1024];
+	snprintf(expected_filename, sizeof(expected_filename), "%s/%lu/check_test/roundtrip", state_dir,
+			 (unsigned long)geteuid());
+	ok(!strcmp(key._filename, expected_filename), "State file is below MP_STATE_PATH");
+
+	ok(np_state_read(key) == NULL, "No state before the first write");
+
+	np_state_write_string(key, 1234567890, "17 42 4711");
+	state_data *previous = np_state_read(key);
+	ok(previous->errorcode == OK && previous->time == 1234567890 &&
+		   !strcmp(previous->data, "17 42 4711") && previous->length == 10,
+	   "State is read back with its timestamp");
+
+	/* longer than any fixed line buffer */
+	char *long_data = malloc(100001);
+	memset(long_data, 'x', 100000);
+	long_data[100000] = '\0';
+	np_state_write_string(key, 1234567890, long_data);
+	previous = np_state_read(key);
+	ok(previous->errorcode == OK && previous->length == 100000 &&
+		   !strcmp(previous->data, long_data),
+	   "Long state data is read back whole");
+	free(long_data);
+
+	state_key other_version = np_enable_state("roundtrip", 4, "check_test", 4, fake_argv);
+	ok(np_state_read(other_version)->errorcode == ERROR,
+	   "State with another data version is ignored");
+
+	key._filename = "var/statefile";
+	key.data_version = 54;
+	previous = np_state_read(key);
+	ok(previous->errorcode == OK && !strcmp(previous->data, "String to read"),
+	   "State file of the original format is read");
+
+	unlink(expected_filename);
+	snprintf(expected_filename, sizeof(expected_filename), "%s/%lu/check_test", state_dir,
+			 (unsigned long)geteuid());
+	rmdir(expected_filename);
+	snprintf(expected_filename, sizeof(expected_filename), "%s/%lu", state_dir,
+			 (unsigned long)geteuid());
+	rmdir(expected_filename);
+	rmdir(state_dir);
+
 	return exit_status();
 }
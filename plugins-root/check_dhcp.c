@@ -40,7 +40,9 @@ const char *email = "devel@monitoring-plugins.org";
 #include "../plugins/common.h"
 #include "../plugins/utils.h"
 #include "./check_dhcp.d/config.h"
+#include "./check_dhcp.d/dhcp_probe.h"
 #include "../lib/output.h"
+#include "../lib/perfdata.h"
 #include "../lib/utils_base.h"
 
 #include "states.h"
@@ -119,113 +121,7 @@ static long mac_addr_dlpi(const char *, int, u_char *);
 #define ERROR        -1
 #define MAC_ADDR_LEN 6
 
-/**** DHCP definitions ****/
-
-#define MAX_DHCP_CHADDR_LENGTH  16
-#define MAX_DHCP_SNAME_LENGTH   64
-#define MAX_DHCP_FILE_LENGTH    128
-#define MAX_DHCP_OPTIONS_LENGTH 312
-
-// RFC 2131
-// 0                   1                   2                   3
-// 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-// +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-// |     op (1)    |   htype (1)   |   hlen (1)    |   hops (1)    |
-// +---------------+---------------+---------------+---------------+
-// |                            xid (4)                            |
-// +-------------------------------+-------------------------------+
-// |           secs (2)            |           flags (2)           |
-// +-------------------------------+-------------------------------+
-// |                          ciaddr  (4)                          |
-// +---------------------------------------------------------------+
-// |                          yiaddr  (4)                          |
-// +---------------------------------------------------------------+
-// |                          siaddr  (4)                          |
-// +---------------------------------------------------------------+
-// |                          giaddr  (4)                          |
-// +---------------------------------------------------------------+
-// |                                                               |
-// |                          chaddr  (16)                         |
-// |                                                               |
-// |                                                               |
-// +---------------------------------------------------------------+
-// |                                                               |
-// |                          sname   (64)                         |
-// +---------------------------------------------------------------+
-// |                                                               |
-// |                          file    (128)                        |
-// +---------------------------------------------------------------+
-// |                                                               |
-// |                          options (variable)                   |
-// +---------------------------------------------------------------+
-
-typedef struct dhcp_packet_struct {
-	uint8_t op;            /* packet type */
-	uint8_t htype;         /* type of hardware address for this machine (Ethernet, etc) */
-	uint8_t hlen;          /* length of hardware address (of this machine) */
-	uint8_t hops;          /* hops */
-	uint32_t xid;          /* random transaction id number - chosen by this machine */
-	uint16_t secs;         /* seconds used in timing */
-	uint16_t flags;        /* flags */
-	struct in_addr ciaddr; /* IP address of this machine (if we already have one) */
-	struct in_addr yiaddr; /* IP address of this machine (offered by the DHCP server) */
-	struct in_addr siaddr; /* IP address of next server */
-	struct in_addr giaddr; /* IP address of DHCP relay */
-	unsigned char chaddr[MAX_DHCP_CHADDR_LENGTH]; /* hardware address of this machine */
-	char sname[MAX_DHCP_SNAME_LENGTH];            /* name of DHCP server */
-	char file[MAX_DHCP_FILE_LENGTH];              /* boot file name (used for diskless booting?) */
-	uint8_t options[MAX_DHCP_OPTIONS_LENGTH];     /* options */
-} dhcp_packet;
-
-typedef struct dhcp_offer_struct {
-	struct in_addr server_address;  /* address of DHCP server that sent this offer */
-	struct in_addr offered_address; /* the IP address that was offered to us */
-	uint32_t lease_time;            /* lease time in seconds */
-	uint32_t renewal_time;          /* renewal time in seconds */
-	uint32_t rebinding_time;        /* rebinding time in seconds */
-	bool desired;                   /* is this offer desired (necessary in exclusive mode) */
-	struct dhcp_offer_struct *next;
-} dhcp_offer;
-
-typedef enum {
-	BOOTREQUEST = 1,
-	BOOTREPLY = 2,
-} dhcp_packet_op;
-
-typedef enum {
-	DHCPDISCOVER = 1,
-	DHCPOFFER = 2,
-	DHCPREQUEST = 3,
-	DHCPDECLINE = 4,
-	DHCPACK = 5,
-	DHCPNACK = 6,
-	DHCPRELEASE = 7,
-} dhcp_message_type;
-
-typedef enum {
-	DHCP_OPTION_PADDING = 0,
-	DHCP_OPTION_MESSAGE_TYPE = 53,
-	DHCP_OPTION_HOST_NAME = 12,
-	DHCP_OPTION_BROADCAST_ADDRESS = 28,
-	DHCP_OPTION_REQUESTED_ADDRESS = 50,
-	DHCP_OPTION_LEASE_TIME = 51,
-	DHCP_OPTION_SERVER_IDENTIFIER = 54,
-	DHCP_OPTION_RENEWAL_TIME = 58,
-	DHCP_OPTION_REBINDING_TIME = 59,
-	DHCP_OPTION_END = 255,
-} dhcp_options_type;
-
-#define DHCP_INFINITE_TIME 0xFFFFFFFF
-
-#define DHCP_BROADCAST_FLAG 32768
-
-#define DHCP_SERVER_PORT 67
-#define DHCP_CLIENT_PORT 68
-
-#define ETHERNET_HARDWARE_ADDRESS        1 /* used in htype field of dhcp packet */
-#define ETHERNET_HARDWARE_ADDRESS_LENGTH 6 /* length of Ethernet hardware addresses */
-
-static int verbose = 0;
+int verbose = 0;
 
 typedef struct process_arguments_wrapper {
 	int error;
@@ -236,7 +132,7 @@ static process_arguments_wrapper process_arguments(int /*argc*/, char ** /*argv*
 void print_usage(void);
 static void print_help(void);
 
-static void resolve_host(const char * /*in*/, struct in_addr * /*out*/);
+static void resolve_host(const char * /*in*/, dhcp_address * /*out*/);
 static unsigned char *mac_aton(const char * /*string*/);
 static void print_hardware_address(const unsigned char * /*address*/);
 static int get_hardware_address(int /*sock*/, char * /*interface_name*/,
@@ -248,44 +144,23 @@ typedef struct get_ip_address_wrapper {
 } get_ip_address_wrapper;
 static get_ip_address_wrapper get_ip_address(int /*sock*/, char * /*interface_name*/);
 
-typedef struct send_dhcp_discover_wrapper {
-	int error;
-	uint32_t packet_xid;
-} send_dhcp_discover_wrapper;
-static send_dhcp_discover_wrapper
-send_dhcp_discover(int socket, bool unicast, struct in_addr dhcp_ip,
-				   struct in_addr requested_address, bool request_specific_address,
-				   struct in_addr my_ip, unsigned char *client_hardware_address);
-typedef struct get_dhcp_offer_wrapper {
-	int error;
-	int valid_responses;
-	dhcp_offer *dhcp_offer_list;
-} get_dhcp_offer_wrapper;
-static get_dhcp_offer_wrapper get_dhcp_offer(int /*sock*/, int dhcpoffer_timeout,
-											 uint32_t packet_xid, dhcp_offer *dhcp_offer_list,
-											 const unsigned char *client_hardware_address);
-
-static mp_subcheck get_results(bool exclusive, int requested_servers,
-							   struct in_addr requested_address, bool request_specific_address,
+static mp_subcheck get_results(const char * /*offer_name*/, bool exclusive, int requested_servers,
+							   dhcp_address requested_address, bool request_specific_address,
 							   requested_server *requested_server_list, int valid_responses,
 							   dhcp_offer *dhcp_offer_list);
 
-typedef struct add_dhcp_offer_wrapper {
-	int error;
-	dhcp_offer *dhcp_offer_list;
-} add_dhcp_offer_wrapper;
-static add_dhcp_offer_wrapper add_dhcp_offer(struct in_addr /*source*/,
-											 dhcp_packet * /*offer_packet*/,
-											 dhcp_offer *dhcp_offer_list);
-static int free_dhcp_offer_list(dhcp_offer *dhcp_offer_list);
+static mp_subcheck get_probe_results(check_dhcp_config /*config*/, dhcp_probe * /*probe*/,
+									 bool /*name_probe*/);
+
 static int free_requested_server_list(requested_server *requested_server_list);
 
+static void add_interface_probes(check_dhcp_config /*config*/, char * /*interface_name*/,
+								 sa_family_t /*family*/, dhcp_probe ** /*probes*/,
+								 size_t /*probe_count*/[static 1]);
+
 static int create_dhcp_socket(bool /*unicast*/, char *network_interface_name);
+static int create_dhcp6_socket(char *network_interface_name);
 static int close_dhcp_socket(int /*sock*/);
-static int send_dhcp_packet(void * /*buffer*/, int /*buffer_size*/, int /*sock*/,
-							struct sockaddr_in * /*dest*/);
-static int receive_dhcp_packet(void * /*buffer*/, int /*buffer_size*/, int /*sock*/,
-							   int /*timeout*/, struct sockaddr_in * /*address*/);
 
 int main(int argc, char **argv) {
 	setlocale(LC_ALL, "");
@@ -306,69 +181,112 @@ int main(int argc, char **argv) {
 		mp_set_format(config.output_format);
 	}
 
-	/* create socket for DHCP communications */
-	int dhcp_socket = create_dhcp_socket(config.unicast_mode, config.network_interface_name);
+	/*
+	 * Every interface gets its own socket per address family. Without unicast
+	 * mode there is one broadcast DHCPDISCOVER or multicast SOLICIT per
+	 * interface, in unicast mode every requested IPv4 server gets its own
+	 * relayed DHCPDISCOVER.
+	 */
+	size_t probe_count = 0;
+	dhcp_probe *probes = NULL;
+	for (size_t i = 0; i < config.num_of_network_interfaces; i++) {
+		if (config.probe_dhcpv4) {
+			add_interface_probes(config, config.network_interfaces[i], AF_INET, &probes,
+								 &probe_count);
+		}
+		if (config.probe_dhcpv6) {
+			add_interface_probes(config, config.network_interfaces[i], AF_INET6, &probes,
+								 &probe_count);
+		}
+	}
 
-	/* get hardware address of client machine */
-	unsigned char client_hardware_address[MAX_DHCP_CHADDR_LENGTH] = "";
-	if (config.user_specified_mac != NULL) {
-		memcpy(client_hardware_address, config.user_specified_mac, MAC_ADDR_LEN);
-	} else {
-		get_hardware_address(dhcp_socket, config.network_interface_name, client_hardware_address);
+	/* transaction IDs are supposed to be random, consecutive ones keep the probes apart */
+	srandom((unsigned int)(time(NULL) ^ getpid()));
+	uint32_t xid_base = (uint32_t)random();
+	for (size_t i = 0; i < probe_count; i++) {
+		probes[i].xid = xid_base + (uint32_t)i;
 	}
 
-	struct in_addr my_ip = {0};
+	/* send all DHCPDISCOVER and SOLICIT packets at once and wait for the offers */
+	dhcp_probe_send_all(probes, probe_count, config.requested_address,
+						config.request_specific_address);
+	dhcp_probe_collect(probes, probe_count, config.dhcpoffer_timeout);
 
-	if (config.unicast_mode) { /* get IP address of client machine */
-		get_ip_address_wrapper tmp_get_ip =
-			get_ip_address(dhcp_socket, config.network_interface_name);
-		if (tmp_get_ip.error == OK) {
-			my_ip = tmp_get_ip.my_ip;
-		} else {
-			// TODO failed to get own IP
-			die(STATE_UNKNOWN, "Failed to retrieve my own IP address in unicast mode");
+	/* close sockets we created, the probes of an interface follow each other */
+	for (size_t i = 0; i < probe_count; i++) {
+		if (i == 0 || probes[i].socket != probes[i - 1].socket) {
+			close_dhcp_socket(probes[i].socket);
 		}
 	}
 
-	/* send DHCPDISCOVER packet */
-	send_dhcp_discover_wrapper disco_res = send_dhcp_discover(
-		dhcp_socket, config.unicast_mode, config.dhcp_ip, config.requested_address,
-		config.request_specific_address, my_ip, client_hardware_address);
+	mp_check overall = mp_check_init();
 
-	if (disco_res.error != OK) {
-		// DO something?
-		die(STATE_UNKNOWN, "Failed to send DHCP discover");
+	/* determine state/plugin output to return, mp_add_subcheck_to_check prepends */
+	for (size_t i = probe_count; i-- > 0;) {
+		mp_subcheck sc_res = get_probe_results(config, &probes[i], probe_count > 1);
+		mp_add_subcheck_to_check(&overall, sc_res);
+		/* free allocated memory */
+		free_dhcp_offer_list(probes[i].offers);
 	}
+	free(probes);
+	free_requested_server_list(config.requested_server_list);
 
-	/* wait for a DHCPOFFER packet */
-	get_dhcp_offer_wrapper offer_res = get_dhcp_offer(
-		dhcp_socket, config.dhcpoffer_timeout, disco_res.packet_xid, NULL, client_hardware_address);
+	mp_exit(overall);
+}
 
-	int valid_responses = 0;
-	dhcp_offer *dhcp_offer_list = NULL;
-	if (offer_res.error == OK) {
-		valid_responses = offer_res.valid_responses;
-		dhcp_offer_list = offer_res.dhcp_offer_list;
+/* sets up the probes of an interface for one address family and appends them to probes */
+void add_interface_probes(check_dhcp_config config, char *interface_name, sa_family_t family,
+						  dhcp_probe **probes, size_t probe_count[static 1]) {
+	bool unicast = config.unicast_mode && family == AF_INET;
+
+	/* create socket for DHCP communications */
+	dhcp_probe probe = {
+		.family = family,
+		.socket = (family == AF_INET6) ? create_dhcp6_socket(interface_name)
+									   : create_dhcp_socket(unicast, interface_name),
+		.interface_index = if_nametoindex(interface_name),
+		.unicast = unicast,
+		.server_address = config.dhcp_ip,
+	};
+	strncpy(probe.interface_name, interface_name, sizeof(probe.interface_name) - 1);
+
+	/* get hardware address of client machine */
+	if (config.user_specified_mac != NULL) {
+		memcpy(probe.hardware_address, config.user_specified_mac, MAC_ADDR_LEN);
 	} else {
-		die(STATE_UNKNOWN, "Failed to get DHCP offers");
+		get_hardware_address(probe.socket, interface_name, probe.hardware_address);
 	}
 
-	/* close socket we created */
-	close_dhcp_socket(dhcp_socket);
-
-	mp_check overall = mp_check_init();
+	if (unicast) { /* get IP address of client machine */
+		get_ip_address_wrapper tmp_get_ip = get_ip_address(probe.socket, interface_name);
+		if (tmp_get_ip.error == OK) {
+			probe.relay_address = tmp_get_ip.my_ip;
+		} else {
+			// TODO failed to get own IP
+			die(STATE_UNKNOWN, "Failed to retrieve my own IP address in unicast mode");
+		}
+	}
 
-	/* determine state/plugin output to return */
-	mp_subcheck sc_res =
-		get_results(config.exclusive_mode, config.num_of_requested_servers,
-					config.requested_address, config.request_specific_address,
-					config.requested_server_list, valid_responses, dhcp_offer_list);
-	mp_add_subcheck_to_check(&overall, sc_res);
-	/* free allocated memory */
-	free_dhcp_offer_list(dhcp_offer_list);
-	free_requested_server_list(config.requested_server_list);
+	requested_server *server = unicast ? config.requested_server_list : NULL;
+	do {
+		if (server != NULL) {
+			/* only IPv4 servers can be reached by a relayed DHCPDISCOVER */
+			bool relayable = server->server_address.family == AF_INET;
+			probe.server_address = server->server_address.v4;
+			/* a server answers a relayed DHCPDISCOVER once, unless we look for rogues */
+			probe.expected_offers = config.exclusive_mode ? 0 : 1;
+			server = server->next;
+			if (!relayable) {
+				continue;
+			}
+		}
 
-	mp_exit(overall);
+		*probes = realloc(*probes, (*probe_count + 1) * sizeof(dhcp_probe));
+		if (*probes == NULL) {
+			die(STATE_UNKNOWN, _("Could not realloc() units [%lu]\n"), *probe_count + 1);
+		}
+		(*probes)[(*probe_count)++] = probe;
+	} while (server != NULL);
 }
 
 /* determines hardware address on client machine */
@@ -524,288 +442,6 @@ get_ip_address_wrapper get_ip_address(int sock, char *interface_name) {
 	return result;
 }
 
-/* sends a DHCPDISCOVER broadcast message in an attempt to find DHCP servers */
-static send_dhcp_discover_wrapper send_dhcp_discover(int sock, bool unicast, struct in_addr dhcp_ip,
-													 struct in_addr requested_address,
-													 bool request_specific_address,
-													 struct in_addr my_ip,
-													 unsigned char *client_hardware_address) {
-	dhcp_packet discover_packet = {0};
-	/* boot request flag (backward compatible with BOOTP servers) */
-	discover_packet.op = BOOTREQUEST;
-
-	/* hardware address type */
-	discover_packet.htype = ETHERNET_HARDWARE_ADDRESS;
-
-	/* length of our hardware address */
-	discover_packet.hlen = ETHERNET_HARDWARE_ADDRESS_LENGTH;
-
-	send_dhcp_discover_wrapper result = {
-		.error = OK,
-	};
-	/*
-	 * transaction ID is supposed to be random.
-	 */
-	srand(time(NULL) ^ getpid());
-	result.packet_xid = random();
-	discover_packet.xid = htonl(result.packet_xid);
-
-	/*discover_packet.secs=htons(65535);*/
-	discover_packet.secs = 0xFF;
-
-	/*
-	 * server needs to know if it should broadcast or unicast its response:
-	 * 0x8000L == 32768 == 1 << 15 == broadcast, 0 == unicast
-	 */
-	discover_packet.flags = unicast ? 0 : htons(DHCP_BROADCAST_FLAG);
-
-	/* our hardware address */
-	memcpy(discover_packet.chaddr, client_hardware_address, ETHERNET_HARDWARE_ADDRESS_LENGTH);
-
-	/* first four bytes of options field is magic cookie (as per RFC 2132) */
-	discover_packet.options[0] = '\x63';
-	discover_packet.options[1] = '\x82';
-	discover_packet.options[2] = '\x53';
-	discover_packet.options[3] = '\x63';
-
-	unsigned short opts = 4;
-	/* DHCP message type is embedded in options field */
-	discover_packet.options[opts++] =
-		DHCP_OPTION_MESSAGE_TYPE;             /* DHCP message type option identifier */
-	discover_packet.options[opts++] = '\x01'; /* DHCP message option length in bytes */
-	discover_packet.options[opts++] = DHCPDISCOVER;
-
-	/* the IP address we're requesting */
-	if (request_specific_address) {
-		discover_packet.options[opts++] = DHCP_OPTION_REQUESTED_ADDRESS;
-		discover_packet.options[opts++] = '\x04';
-		memcpy(&discover_packet.options[opts], &requested_address, sizeof(requested_address));
-		opts += sizeof(requested_address);
-	}
-	discover_packet.options[opts++] = (char)DHCP_OPTION_END;
-
-	/* unicast fields */
-	if (unicast) {
-		discover_packet.giaddr.s_addr = my_ip.s_addr;
-	}
-
-	/* see RFC 1542, 4.1.1 */
-	discover_packet.hops = unicast ? 1 : 0;
-
-	/* send the DHCPDISCOVER packet to broadcast address */
-	struct sockaddr_in sockaddr_broadcast = {
-		.sin_family = AF_INET,
-		.sin_port = htons(DHCP_SERVER_PORT),
-		.sin_addr.s_addr = unicast ? dhcp_ip.s_addr : INADDR_BROADCAST,
-	};
-
-	if (verbose) {
-		printf(_("DHCPDISCOVER to %s port %d\n"), inet_ntoa(sockaddr_broadcast.sin_addr),
-			   ntohs(sockaddr_broadcast.sin_port));
-		printf("DHCPDISCOVER XID: %u (0x%X)\n", ntohl(discover_packet.xid),
-			   ntohl(discover_packet.xid));
-		printf("DHCDISCOVER ciaddr:  %s\n", inet_ntoa(discover_packet.ciaddr));
-		printf("DHCDISCOVER yiaddr:  %s\n", inet_ntoa(discover_packet.yiaddr));
-		printf("DHCDISCOVER siaddr:  %s\n", inet_ntoa(discover_packet.siaddr));
-		printf("DHCDISCOVER giaddr:  %s\n", inet_ntoa(discover_packet.giaddr));
-	}
-
-	/* send the DHCPDISCOVER packet out */
-	send_dhcp_packet(&discover_packet, sizeof(discover_packet), sock, &sockaddr_broadcast);
-
-	if (verbose) {
-		printf("\n\n");
-	}
-
-	return result;
-}
-
-/* waits for a DHCPOFFER message from one or more DHCP servers */
-get_dhcp_offer_wrapper get_dhcp_offer(int sock, int dhcpoffer_timeout, uint32_t packet_xid,
-									  dhcp_offer *dhcp_offer_list,
-									  const unsigned char *client_hardware_address) {
-	time_t start_time;
-	time(&start_time);
-
-	int result = OK;
-	int responses = 0;
-	int valid_responses = 0;
-	/* receive as many responses as we can */
-	for (;;) {
-		time_t current_time;
-		time(&current_time);
-		if ((current_time - start_time) >= dhcpoffer_timeout) {
-			break;
-		}
-
-		if (verbose) {
-			printf("\n\n");
-		}
-
-		struct sockaddr_in source = {0};
-		dhcp_packet offer_packet = {0};
-
-		result = OK;
-		result = receive_dhcp_packet(&offer_packet, sizeof(offer_packet), sock, dhcpoffer_timeout,
-									 &source);
-
-		if (result != OK) {
-			if (verbose) {
-				printf(_("Result=ERROR\n"));
-			}
-
-			continue;
-		}
-		if (verbose) {
-			printf(_("Result=OK\n"));
-		}
-
-		responses++;
-
-		/* The "source" is either a server or a relay. */
-		/* Save a copy of "source" into "via" even if it's via itself */
-		struct sockaddr_in via = {0};
-		memcpy(&via, &source, sizeof(source));
-
-		if (verbose) {
-			printf(_("DHCPOFFER from IP address %s"), inet_ntoa(source.sin_addr));
-			printf(_(" via %s\n"), inet_ntoa(via.sin_addr));
-			printf("DHCPOFFER XID: %u (0x%X)\n", ntohl(offer_packet.xid), ntohl(offer_packet.xid));
-		}
-
-		/* check packet xid to see if its the same as the one we used in the discover packet */
-		if (ntohl(offer_packet.xid) != packet_xid) {
-			if (verbose) {
-				printf(
-					_("DHCPOFFER XID (%u) did not match DHCPDISCOVER XID (%u) - ignoring packet\n"),
-					ntohl(offer_packet.xid), packet_xid);
-			}
-
-			continue;
-		}
-
-		/* check hardware address */
-		result = OK;
-		if (verbose) {
-			printf("DHCPOFFER chaddr: ");
-		}
-
-		for (int i = 0; i < ETHERNET_HARDWARE_ADDRESS_LENGTH; i++) {
-			if (verbose) {
-				printf("%02X", offer_packet.chaddr[i]);
-			}
-
-			if (offer_packet.chaddr[i] != client_hardware_address[i]) {
-				result = ERROR;
-			}
-		}
-		if (verbose) {
-			printf("\n");
-		}
-
-		if (result == ERROR) {
-			if (verbose) {
-				printf(_("DHCPOFFER hardware address did not match our own - ignoring packet\n"));
-			}
-
-			continue;
-		}
-
-		if (verbose) {
-			printf("DHCPOFFER ciaddr: %s\n", inet_ntoa(offer_packet.ciaddr));
-			printf("DHCPOFFER yiaddr: %s\n", inet_ntoa(offer_packet.yiaddr));
-			printf("DHCPOFFER siaddr: %s\n", inet_ntoa(offer_packet.siaddr));
-			printf("DHCPOFFER giaddr: %s\n", inet_ntoa(offer_packet.giaddr));
-		}
-
-		add_dhcp_offer_wrapper add_res =
-			add_dhcp_offer(source.sin_addr, &offer_packet, dhcp_offer_list);
-		if (add_res.error != OK) {
-			// TODO
-		} else {
-			dhcp_offer_list = add_res.dhcp_offer_list;
-		}
-
-		valid_responses++;
-	}
-
-	if (verbose) {
-		printf(_("Total responses seen on the wire: %d\n"), responses);
-		printf(_("Valid responses for this machine: %d\n"), valid_responses);
-	}
-
-	get_dhcp_offer_wrapper ret_val = {
-		.error = OK,
-		.valid_responses = valid_responses,
-		.dhcp_offer_list = dhcp_offer_list,
-	};
-	return ret_val;
-}
-
-/* sends a DHCP packet */
-int send_dhcp_packet(void *buffer, int buffer_size, int sock, struct sockaddr_in *dest) {
-	int result =
-		sendto(sock, (char *)buffer, buffer_size, 0, (struct sockaddr *)dest, sizeof(*dest));
-
-	if (verbose) {
-		printf(_("send_dhcp_packet result: %d\n"), result);
-	}
-
-	if (result < 0) {
-		return ERROR;
-	}
-
-	return OK;
-}
-
-/* receives a DHCP packet */
-int receive_dhcp_packet(void *buffer, int buffer_size, int sock, int timeout,
-						struct sockaddr_in *address) {
-	/* wait for data to arrive (up time timeout) */
-	struct timeval timeout_val = {
-		.tv_sec = timeout,
-		.tv_usec = 0,
-	};
-	fd_set readfds;
-	FD_ZERO(&readfds);
-	fd_set oobfds;
-	FD_ZERO(&oobfds);
-	FD_SET(sock, &readfds);
-	FD_SET(sock, &oobfds);
-	int nfound = select(sock + 1, &readfds, NULL, &oobfds, &timeout_val);
-
-	/* make sure some data has arrived */
-	if (!FD_ISSET(sock, &readfds)) {
-		if (verbose) {
-			printf(_("No (more) data received (nfound: %d)\n"), nfound);
-		}
-		return ERROR;
-	}
-
-	struct sockaddr_in source_address = {0};
-	socklen_t address_size = sizeof(source_address);
-	int recv_result = recvfrom(sock, (char *)buffer, buffer_size, 0,
-							   (struct sockaddr *)&source_address, &address_size);
-	if (verbose) {
-		printf("recv_result: %d\n", recv_result);
-	}
-
-	if (recv_result == -1) {
-		if (verbose) {
-			printf(_("recvfrom() failed, "));
-			printf("errno: (%d) -> %s\n", errno, strerror(errno));
-		}
-		return ERROR;
-	}
-	if (verbose) {
-		printf(_("receive_dhcp_packet() result: %d\n"), recv_result);
-		printf(_("receive_dhcp_packet() source: %s\n"), inet_ntoa(source_address.sin_addr));
-	}
-
-	memcpy(address, &source_address, sizeof(source_address));
-	return OK;
-}
-
 /* creates a socket for DHCP communication */
 int create_dhcp_socket(bool unicast, char *network_interface_name) {
 	/* Set up the address we're going to bind to. */
@@ -869,6 +505,64 @@ int create_dhcp_socket(bool unicast, char *network_interface_name) {
 	return sock;
 }
 
+/* creates a socket for DHCPv6 communication on the link of the interface */
+int create_dhcp6_socket(char *network_interface_name) {
+	struct sockaddr_in6 myname = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(DHCP6_CLIENT_PORT),
+		.sin6_addr = in6addr_any,
+	};
+
+	int sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0) {
+		printf(_("Error: Could not create DHCPv6 socket!\n"));
+		exit(STATE_UNKNOWN);
+	}
+
+	if (verbose) {
+		printf("DHCPv6 socket: %d\n", sock);
+	}
+
+	int flag = 1;
+	if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char *)&flag, sizeof(flag)) < 0) {
+		printf(_("Error: Could not set reuse address option on DHCP socket!\n"));
+		exit(STATE_UNKNOWN);
+	}
+	if (setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, (char *)&flag, sizeof(flag)) < 0) {
+		printf(_("Error: Could not restrict DHCPv6 socket to IPv6!\n"));
+		exit(STATE_UNKNOWN);
+	}
+
+	/* the SOLICIT goes to a link-scoped multicast group, send it out of the right interface */
+	unsigned int interface_index = if_nametoindex(network_interface_name);
+	if (interface_index == 0 || setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_IF,
+										   (char *)&interface_index,
+										   sizeof(interface_index)) < 0) {
+		printf(_("Error: Could not use interface %s for DHCPv6 multicast\n"),
+			   network_interface_name);
+		exit(STATE_UNKNOWN);
+	}
+
+#if defined(__linux__)
+	struct ifreq interface;
+	strncpy(interface.ifr_ifrn.ifrn_name, network_interface_name, IFNAMSIZ - 1);
+	interface.ifr_ifrn.ifrn_name[IFNAMSIZ - 1] = '\0';
+	if (setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, (char *)&interface, sizeof(interface)) < 0) {
+		printf(_("Error: Could not bind socket to interface %s.  Check your privileges...\n"),
+			   network_interface_name);
+		exit(STATE_UNKNOWN);
+	}
+#endif
+
+	if (bind(sock, (struct sockaddr *)&myname, sizeof(myname)) < 0) {
+		printf(_("Error: Could not bind to DHCPv6 socket (port %d)!  Check your privileges...\n"),
+			   DHCP6_CLIENT_PORT);
+		exit(STATE_UNKNOWN);
+	}
+
+	return sock;
+}
+
 /* closes DHCP socket */
 int close_dhcp_socket(int sock) {
 	close(sock);
@@ -876,7 +570,7 @@ int close_dhcp_socket(int sock) {
 }
 
 /* adds a requested server address to list in memory */
-int add_requested_server(struct in_addr server_address, int *requested_servers,
+int add_requested_server(dhcp_address server_address, int *requested_servers,
 						 requested_server **requested_server_list) {
 	requested_server *new_server = (requested_server *)malloc(sizeof(requested_server));
 	if (new_server == NULL) {
@@ -892,147 +586,9 @@ int add_requested_server(struct in_addr server_address, int *requested_servers,
 	*requested_servers += 1;
 
 	if (verbose) {
-		printf(_("Requested server address: %s\n"), inet_ntoa(new_server->server_address));
-	}
-
-	return OK;
-}
-
-/* adds a DHCP OFFER to list in memory */
-add_dhcp_offer_wrapper add_dhcp_offer(struct in_addr source, dhcp_packet *offer_packet,
-									  dhcp_offer *dhcp_offer_list) {
-	if (offer_packet == NULL) {
-		add_dhcp_offer_wrapper tmp = {
-			.error = ERROR,
-		};
-		return tmp;
-	}
-
-	uint32_t dhcp_lease_time = 0;
-	uint32_t dhcp_renewal_time = 0;
-	uint32_t dhcp_rebinding_time = 0;
-	dhcp_offer *new_offer;
-	struct in_addr serv_ident = {0};
-	/* process all DHCP options present in the packet */
-	for (size_t dchp_opt_idx = 4; dchp_opt_idx < MAX_DHCP_OPTIONS_LENGTH - 1;) {
-		/* get option type */
-		dhcp_options_type option_type = offer_packet->options[dchp_opt_idx++];
-
-		// End parsing when we find the end option
-		if (option_type == DHCP_OPTION_END) {
-			break;
-		}
-
-		// Padding octet
-		if (option_type == DHCP_OPTION_PADDING) {
-			dchp_opt_idx++;
-			continue;
-		}
-
-		/* neither padding nor end, get option length */
-		uint8_t option_length = offer_packet->options[dchp_opt_idx++];
-
-		if (verbose) {
-			printf("Option: %d (0x%02X)\n", option_type, option_length);
-		}
-
-		/* get option data */
-		switch (option_type) {
-		case DHCP_OPTION_LEASE_TIME:
-			memcpy(&dhcp_lease_time, &offer_packet->options[dchp_opt_idx], sizeof(dhcp_lease_time));
-			dhcp_lease_time = ntohl(dhcp_lease_time);
-			break;
-		case DHCP_OPTION_RENEWAL_TIME:
-			memcpy(&dhcp_renewal_time, &offer_packet->options[dchp_opt_idx],
-				   sizeof(dhcp_renewal_time));
-			dhcp_renewal_time = ntohl(dhcp_renewal_time);
-			break;
-		case DHCP_OPTION_REBINDING_TIME:
-			memcpy(&dhcp_rebinding_time, &offer_packet->options[dchp_opt_idx],
-				   sizeof(dhcp_rebinding_time));
-			dhcp_rebinding_time = ntohl(dhcp_rebinding_time);
-			break;
-		case DHCP_OPTION_SERVER_IDENTIFIER:
-			memcpy(&serv_ident.s_addr, &offer_packet->options[dchp_opt_idx],
-				   sizeof(serv_ident.s_addr));
-			break;
-		default: {
-			// not handled
-		}
-		}
-
-		/* skip option data we're ignoring */
-		dchp_opt_idx += option_length;
-	}
-
-	if (verbose) {
-		if (dhcp_lease_time == DHCP_INFINITE_TIME) {
-			printf(_("Lease Time: Infinite\n"));
-		} else {
-			printf(_("Lease Time: %" PRIu32 " seconds\n"), dhcp_lease_time);
-		}
-		if (dhcp_renewal_time == DHCP_INFINITE_TIME) {
-			printf(_("Renewal Time: Infinite\n"));
-		} else {
-			printf(_("Renewal Time: %" PRIu32 " seconds\n"), dhcp_renewal_time);
-		}
-		if (dhcp_rebinding_time == DHCP_INFINITE_TIME) {
-			printf(_("Rebinding Time: Infinite\n"));
-		}
-		printf(_("Rebinding Time: %" PRIu32 " seconds\n"), dhcp_rebinding_time);
-	}
-
-	new_offer = (dhcp_offer *)malloc(sizeof(dhcp_offer));
-
-	if (new_offer == NULL) {
-		add_dhcp_offer_wrapper tmp = {
-			.error = ERROR,
-		};
-		return tmp;
-	}
-
-	/*
-	 * RFC 2131 (2.) says: "DHCP clarifies the interpretation of the
-	 * 'siaddr' field as the address of the server to use in the next step
-	 * of the client's bootstrap process.  A DHCP server may return its own
-	 * address in the 'siaddr' field, if the server is prepared to supply
-	 * the next bootstrap service (e.g., delivery of an operating system
-	 * executable image).  A DHCP server always returns its own address in
-	 * the 'server identifier' option."  'serv_ident' is the 'server
-	 * identifier' option, 'source' is the IP address we received the
-	 * DHCPOFFER from.  If 'serv_ident' isn't available for some reason, we
-	 * use 'source'.
-	 */
-	new_offer->server_address = serv_ident.s_addr ? serv_ident : source;
-	new_offer->offered_address = offer_packet->yiaddr;
-	new_offer->lease_time = dhcp_lease_time;
-	new_offer->renewal_time = dhcp_renewal_time;
-	new_offer->rebinding_time = dhcp_rebinding_time;
-	new_offer->desired = false; /* exclusive mode: we'll check that in get_results */
-
-	if (verbose) {
-		printf(_("Added offer from server @ %s"), inet_ntoa(new_offer->server_address));
-		printf(_(" of IP address %s\n"), inet_ntoa(new_offer->offered_address));
-	}
-
-	/* add new offer to head of list */
-	new_offer->next = dhcp_offer_list;
-	dhcp_offer_list = new_offer;
-
-	add_dhcp_offer_wrapper result = {
-		.error = OK,
-		.dhcp_offer_list = dhcp_offer_list,
-	};
-
-	return result;
-}
-
-/* frees memory allocated to DHCP OFFER list */
-int free_dhcp_offer_list(dhcp_offer *dhcp_offer_list) {
-	dhcp_offer *next_offer;
-	for (dhcp_offer *this_offer = dhcp_offer_list; this_offer != NULL; this_offer = next_offer) {
-		next_offer = this_offer->next;
-		free(this_offer);
+		char buffer[INET6_ADDRSTRLEN];
+		printf(_("Requested server address: %s\n"),
+			   dhcp_address_ntop(&new_server->server_address, buffer));
 	}
 
 	return OK;
@@ -1051,8 +607,8 @@ int free_requested_server_list(requested_server *requested_server_list) {
 }
 
 /* gets state and plugin output to return */
-mp_subcheck get_results(bool exclusive, const int requested_servers,
-						const struct in_addr requested_address, bool request_specific_address,
+mp_subcheck get_results(const char *offer_name, bool exclusive, const int requested_servers,
+						const dhcp_address requested_address, bool request_specific_address,
 						requested_server *requested_server_list, int valid_responses,
 						dhcp_offer *dhcp_offer_list) {
 	mp_subcheck sc_dhcp_results = mp_subcheck_init();
@@ -1061,7 +617,7 @@ mp_subcheck get_results(bool exclusive, const int requested_servers,
 	/* we didn't receive any DHCPOFFERs */
 	if (dhcp_offer_list == NULL) {
 		sc_dhcp_results = mp_set_subcheck_state(sc_dhcp_results, STATE_CRITICAL);
-		xasprintf(&sc_dhcp_results.output, "%s", "No DHCPOFFERs were received");
+		xasprintf(&sc_dhcp_results.output, "No %ss were received", offer_name);
 		return sc_dhcp_results;
 	}
 
@@ -1073,9 +629,9 @@ mp_subcheck get_results(bool exclusive, const int requested_servers,
 	}
 
 	if (valid_responses == 1) {
-		xasprintf(&sc_dhcp_results.output, "Received %d DHCPOFFER", valid_responses);
+		xasprintf(&sc_dhcp_results.output, "Received %d %s", valid_responses, offer_name);
 	} else {
-		xasprintf(&sc_dhcp_results.output, "Received %d DHCPOFFERs", valid_responses);
+		xasprintf(&sc_dhcp_results.output, "Received %d %ss", valid_responses, offer_name);
 	}
 
 	bool received_requested_address = false;
@@ -1095,18 +651,18 @@ mp_subcheck get_results(bool exclusive, const int requested_servers,
 				}
 
 				/* see if we got the address we requested */
-				if (!memcmp(&requested_address, &temp_offer->offered_address,
-							sizeof(requested_address))) {
+				if (dhcp_address_equal(&requested_address, &temp_offer->offered_address)) {
 					received_requested_address = true;
 				}
 
 				/* see if the servers we wanted a response from, talked to us or not */
-				if (!memcmp(&temp_offer->server_address, &temp_server->server_address,
-							sizeof(temp_server->server_address))) {
+				if (dhcp_address_equal(&temp_offer->server_address, &temp_server->server_address)) {
 					if (verbose) {
+						char buffer[INET6_ADDRSTRLEN];
 						printf(_("DHCP Server Match: Offerer=%s"),
-							   inet_ntoa(temp_offer->server_address));
-						printf(_(" Requested=%s"), inet_ntoa(temp_server->server_address));
+							   dhcp_address_ntop(&temp_offer->server_address, buffer));
+						printf(_(" Requested=%s"),
+							   dhcp_address_ntop(&temp_server->server_address, buffer));
 						if (temp_server->answered) {
 							printf(_(" (duplicate)"));
 						}
@@ -1159,8 +715,7 @@ mp_subcheck get_results(bool exclusive, const int requested_servers,
 			}
 
 			/* see if we got the address we requested */
-			if (!memcmp(&requested_address, &temp_offer->offered_address,
-						sizeof(requested_address))) {
+			if (dhcp_address_equal(&requested_address, &temp_offer->offered_address)) {
 				received_requested_address = true;
 			}
 		}
@@ -1182,24 +737,10 @@ mp_subcheck get_results(bool exclusive, const int requested_servers,
 			sc_rogue_server = mp_set_subcheck_state(sc_rogue_server, STATE_CRITICAL);
 
 			// Get the addresses for printout
-			// 1.address of the sending server
-			char server_address[INET_ADDRSTRLEN];
-			const char *server_address_transformed = inet_ntop(
-				AF_INET, &undesired_offer->server_address, server_address, sizeof(server_address));
-
-			if (server_address != server_address_transformed) {
-				die(STATE_UNKNOWN, "inet_ntop failed");
-			}
-
-			// 2.address offered
-			char offered_address[INET_ADDRSTRLEN];
-			const char *offered_address_transformed =
-				inet_ntop(AF_INET, &undesired_offer->offered_address, offered_address,
-						  sizeof(offered_address));
-
-			if (offered_address != offered_address_transformed) {
-				die(STATE_UNKNOWN, "inet_ntop failed");
-			}
+			char server_address[INET6_ADDRSTRLEN];
+			char offered_address[INET6_ADDRSTRLEN];
+			dhcp_address_ntop(&undesired_offer->server_address, server_address);
+			dhcp_address_ntop(&undesired_offer->offered_address, offered_address);
 
 			xasprintf(&sc_rogue_server.output, "Rogue DHCP Server detected! Server %s offered %s",
 					  server_address, offered_address);
@@ -1212,15 +753,16 @@ mp_subcheck get_results(bool exclusive, const int requested_servers,
 
 	if (request_specific_address) {
 		mp_subcheck sc_rqustd_addr = mp_subcheck_init();
+		char buffer[INET6_ADDRSTRLEN];
 
 		if (received_requested_address) {
 			sc_rqustd_addr = mp_set_subcheck_state(sc_rqustd_addr, STATE_OK);
 			xasprintf(&sc_rqustd_addr.output, "Requested address (%s) was offered",
-					  inet_ntoa(requested_address));
+					  dhcp_address_ntop(&requested_address, buffer));
 		} else {
 			sc_rqustd_addr = mp_set_subcheck_state(sc_rqustd_addr, STATE_WARNING);
 			xasprintf(&sc_rqustd_addr.output, "Requested address (%s) was NOT offered",
-					  inet_ntoa(requested_address));
+					  dhcp_address_ntop(&requested_address, buffer));
 		}
 
 		mp_add_subcheck_to_subcheck(&sc_dhcp_results, sc_rqustd_addr);
@@ -1229,6 +771,96 @@ mp_subcheck get_results(bool exclusive, const int requested_servers,
 	return sc_dhcp_results;
 }
 
+/* evaluates the offers of one probe, with several probes the output and perfdata name it */
+mp_subcheck get_probe_results(check_dhcp_config config, dhcp_probe *probe, bool name_probe) {
+	mp_subcheck sc_res = mp_subcheck_init();
+	bool dhcpv6 = probe->family == AF_INET6;
+
+	/* only the requested servers and address of the probes family can be part of its offers */
+	requested_server *server_list = NULL;
+	int num_of_servers = 0;
+	for (requested_server *server = config.requested_server_list; server != NULL;
+		 server = server->next) {
+		bool relayed_elsewhere =
+			probe->unicast && server->server_address.v4.s_addr != probe->server_address.s_addr;
+		if (server->server_address.family != probe->family || relayed_elsewhere) {
+			continue;
+		}
+
+		requested_server *copy = malloc(sizeof(requested_server));
+		if (copy == NULL) {
+			die(STATE_UNKNOWN, _("Could not malloc() units [%d]\n"), 1);
+		}
+		*copy = *server;
+		copy->answered = false;
+		copy->next = server_list;
+		server_list = copy;
+		num_of_servers++;
+	}
+	bool request_specific_address =
+		config.request_specific_address && config.requested_address.family == probe->family;
+
+	if (probe->send_failed) {
+		sc_res = mp_set_subcheck_state(sc_res, STATE_CRITICAL);
+		xasprintf(&sc_res.output, "Failed to send %s", dhcpv6 ? "SOLICIT" : "DHCPDISCOVER");
+	} else {
+		sc_res = get_results(dhcpv6 ? "ADVERTISE" : "DHCPOFFER", config.exclusive_mode,
+							 num_of_servers, config.requested_address, request_specific_address,
+							 server_list, probe->valid_responses, probe->offers);
+	}
+	free_requested_server_list(server_list);
+
+	char *label_prefix = "";
+	if (name_probe) {
+		char *probe_name = NULL;
+		if (probe->unicast) {
+			xasprintf(&probe_name, "%s", inet_ntoa(probe->server_address));
+			xasprintf(&sc_res.output, "Server %s via %s: %s", probe_name, probe->interface_name,
+					  sc_res.output);
+		} else if (dhcpv6) {
+			xasprintf(&probe_name, "%s_v6", probe->interface_name);
+			xasprintf(&sc_res.output, "Interface %s (DHCPv6): %s", probe->interface_name,
+					  sc_res.output);
+		} else {
+			xasprintf(&probe_name, "%s", probe->interface_name);
+			xasprintf(&sc_res.output, "Interface %s: %s", probe_name, sc_res.output);
+		}
+		xasprintf(&label_prefix, "%s_", probe_name);
+	}
+
+	if (probe->offers == NULL) {
+		return sc_res;
+	}
+
+	double first_offer = probe->offers->latency;
+	uint32_t max_lease_time = 0;
+	for (dhcp_offer *offer = probe->offers; offer != NULL; offer = offer->next) {
+		if (offer->latency < first_offer) {
+			first_offer = offer->latency;
+		}
+		if (offer->lease_time > max_lease_time) {
+			max_lease_time = offer->lease_time;
+		}
+	}
+
+	mp_perfdata pd_offer_time = perfdata_init();
+	xasprintf(&pd_offer_time.label, "%soffer_time", label_prefix);
+	pd_offer_time.uom = "s";
+	pd_offer_time = mp_set_pd_value(pd_offer_time, first_offer);
+	mp_add_perfdata_to_subcheck(&sc_res, pd_offer_time);
+
+	/* an infinite lease has no useful numeric value */
+	if (max_lease_time != DHCP_INFINITE_TIME) {
+		mp_perfdata pd_lease_time = perfdata_init();
+		xasprintf(&pd_lease_time.label, "%slease_time", label_prefix);
+		pd_lease_time.uom = "s";
+		pd_lease_time = mp_set_pd_value(pd_lease_time, max_lease_time);
+		mp_add_perfdata_to_subcheck(&sc_res, pd_lease_time);
+	}
+
+	return sc_res;
+}
+
 /* process command-line arguments */
 process_arguments_wrapper process_arguments(int argc, char **argv) {
 	if (argc < 1) {
@@ -1251,6 +883,8 @@ process_arguments_wrapper process_arguments(int argc, char **argv) {
 		{"mac", required_argument, 0, 'm'},
 		{"unicast", no_argument, 0, 'u'},
 		{"exclusive", no_argument, 0, 'x'},
+		{"use-ipv4", no_argument, 0, '4'},
+		{"use-ipv6", no_argument, 0, '6'},
 		{"verbose", no_argument, 0, 'v'},
 		{"version", no_argument, 0, 'V'},
 		{"help", no_argument, 0, 'h'},
@@ -1260,18 +894,23 @@ process_arguments_wrapper process_arguments(int argc, char **argv) {
 	check_dhcp_config config = check_dhcp_config_init();
 	int option_char = 0;
 	while (true) {
-		option_char = getopt_long(argc, argv, "+hVvxt:s:r:t:i:m:u", long_options, &option_index);
+		option_char = getopt_long(argc, argv, "+hVvxt:s:r:t:i:m:u46", long_options, &option_index);
 
 		if (option_char == -1 || option_char == EOF || option_char == 1) {
 			break;
 		}
 
 		switch (option_char) {
-		case 's': /* DHCP server address */
-			resolve_host(optarg, &config.dhcp_ip);
-			add_requested_server(config.dhcp_ip, &config.num_of_requested_servers,
+		case 's': { /* DHCP server address */
+			dhcp_address server_address;
+			resolve_host(optarg, &server_address);
+			if (server_address.family == AF_INET) {
+				config.dhcp_ip = server_address.v4;
+			}
+			add_requested_server(server_address, &config.num_of_requested_servers,
 								 &config.requested_server_list);
 			break;
+		}
 
 		case 'r': /* address we are requested from DHCP servers */
 			resolve_host(optarg, &config.requested_address);
@@ -1293,10 +932,16 @@ process_arguments_wrapper process_arguments(int argc, char **argv) {
 			}
 			break;
 
-		case 'i': /* interface name */
-			strncpy(config.network_interface_name, optarg,
-					sizeof(config.network_interface_name) - 1);
-			config.network_interface_name[sizeof(config.network_interface_name) - 1] = '\x0';
+		case 'i': /* interface name, may be given repeatedly */
+			config.network_interfaces =
+				realloc(config.network_interfaces,
+						(config.num_of_network_interfaces + 1) * sizeof(char *));
+			if (config.network_interfaces == NULL) {
+				die(STATE_UNKNOWN, _("Could not realloc() units [%lu]\n"),
+					config.num_of_network_interfaces + 1);
+			}
+			config.network_interfaces[config.num_of_network_interfaces++] =
+				strndup(optarg, IFNAMSIZ - 1);
 			break;
 
 		case 'u': /* unicast testing */
@@ -1307,6 +952,14 @@ process_arguments_wrapper process_arguments(int argc, char **argv) {
 			config.exclusive_mode = true;
 			break;
 
+		case '4':
+			config.probe_dhcpv4 = true;
+			break;
+
+		case '6':
+			config.probe_dhcpv6 = true;
+			break;
+
 		case 'V': /* version */
 			print_revision(progname, NP_VERSION);
 			exit(STATE_UNKNOWN);
@@ -1343,6 +996,20 @@ process_arguments_wrapper process_arguments(int argc, char **argv) {
 		usage(_("Got unexpected non-option argument"));
 	}
 
+	/* DHCPv4 unless asked for DHCPv6 only */
+	if (!config.probe_dhcpv6) {
+		config.probe_dhcpv4 = true;
+	}
+
+	if (config.num_of_network_interfaces == 0) {
+		config.network_interfaces = malloc(sizeof(char *));
+		if (config.network_interfaces == NULL) {
+			die(STATE_UNKNOWN, _("Could not malloc() units [%d]\n"), 1);
+		}
+		config.network_interfaces[0] = config.default_network_interface;
+		config.num_of_network_interfaces = 1;
+	}
+
 	process_arguments_wrapper result = {
 		.config = config,
 		.error = OK,
@@ -1488,8 +1155,14 @@ long mac_addr_dlpi(const char *dev, int unit, u_char *addr) {
 /* Kompf 2000-2003 */
 #endif
 
-/* resolve host name or die (TODO: move this to netutils.c!) */
-void resolve_host(const char *name, struct in_addr *out) {
+/* resolve host name or die (TODO: move this to netutils.c!), names resolve to IPv4 */
+void resolve_host(const char *name, dhcp_address *out) {
+	struct in6_addr address6;
+	if (inet_pton(AF_INET6, name, &address6) == 1) {
+		*out = dhcp_address_from_v6(address6);
+		return;
+	}
+
 	struct addrinfo hints = {
 		.ai_family = PF_INET,
 	};
@@ -1499,7 +1172,7 @@ void resolve_host(const char *name, struct in_addr *out) {
 		usage_va(_("Invalid hostname/address - %s"), optarg);
 	}
 
-	memcpy(out, &((struct sockaddr_in *)addr_info->ai_addr)->sin_addr, sizeof(*out));
+	*out = dhcp_address_from_v4(((struct sockaddr_in *)addr_info->ai_addr)->sin_addr);
 	freeaddrinfo(addr_info);
 }
 
@@ -1555,17 +1228,26 @@ void print_help(void) {
 	printf(UT_VERBOSE);
 
 	printf(" %s\n", "-s, --serverip=IPADDRESS");
-	printf("    %s\n", _("IP address of DHCP server that we must hear from"));
+	printf("    %s\n", _("IP address of DHCP server that we must hear from. DHCPv6 servers are"));
+	printf("    %s\n", _("known by the (usually link-local) IPv6 address they answer from"));
 	printf(" %s\n", "-r, --requestedip=IPADDRESS");
 	printf("    %s\n", _("IP address that should be offered by at least one DHCP server"));
+	printf(" %s\n", "-4, --use-ipv4");
+	printf("    %s\n", _("Probe with a DHCPv4 DHCPDISCOVER (default)"));
+	printf(" %s\n", "-6, --use-ipv6");
+	printf("    %s\n", _("Probe with a DHCPv6 SOLICIT, combine with -4 to probe both in one run"));
 	printf(" %s\n", "-t, --timeout=INTEGER");
 	printf("    %s\n", _("Seconds to wait for DHCPOFFER before timeout occurs"));
 	printf(" %s\n", "-i, --interface=STRING");
-	printf("    %s\n", _("Interface to to use for listening (i.e. eth0)"));
+	printf("    %s\n", _("Interface to to use for listening (i.e. eth0), may be used repeatedly."));
+	printf("    %s\n", _("All interfaces are probed at the same time, each one is reported on"));
+	printf("    %s\n", _("its own"));
 	printf(" %s\n", "-m, --mac=STRING");
 	printf("    %s\n", _("MAC address to use in the DHCP request"));
 	printf(" %s\n", "-u, --unicast");
-	printf("    %s\n", _("Unicast testing: mimic a DHCP relay, requires -s"));
+	printf("    %s\n", _("Unicast testing: mimic a DHCP relay, requires -s. Every server given"));
+	printf("    %s\n", _("with -s gets its own DHCPDISCOVER and is reported on its own. DHCPv4"));
+	printf("    %s\n", _("only, DHCPv6 is always probed by multicast"));
 	printf(" %s\n", "-x, --exclusive");
 	printf("    %s\n",
 		   _("Only requested DHCP server may response (rogue DHCP server detection), requires -s"));
@@ -1576,6 +1258,6 @@ void print_help(void) {
 void print_usage(void) {
 
 	printf("%s\n", _("Usage:"));
-	printf(" %s [-v] [-u] [-x] [-s serverip] [-r requestedip] [-t timeout]\n", progname);
+	printf(" %s [-v] [-u] [-x] [-4] [-6] [-s serverip] [-r requestedip] [-t timeout]\n", progname);
 	printf("                  [-i interface] [-m mac]\n");
 }
@@ -6,9 +6,10 @@
 #include <netinet/in.h>
 #include "net/if.h"
 #include "output.h"
+#include "./dhcp_probe.h"
 
 typedef struct requested_server_struct {
-	struct in_addr server_address;
+	dhcp_address server_address;
 	bool answered;
 	struct requested_server_struct *next;
 } requested_server;
@@ -16,14 +17,18 @@ typedef struct requested_server_struct {
 typedef struct check_dhcp_config {
 	bool unicast_mode;   /* unicast mode: mimic a DHCP relay */
 	bool exclusive_mode; /* exclusive mode aka "rogue DHCP server detection" */
+	bool probe_dhcpv4;
+	bool probe_dhcpv6;
 	int num_of_requested_servers;
 	struct in_addr dhcp_ip; /* server to query (if in unicast mode) */
-	struct in_addr requested_address;
+	dhcp_address requested_address;
 	bool request_specific_address;
 
 	int dhcpoffer_timeout;
 	unsigned char *user_specified_mac;
-	char network_interface_name[IFNAMSIZ];
+	char *default_network_interface;
+	char **network_interfaces;
+	size_t num_of_network_interfaces;
 	requested_server *requested_server_list;
 
 	mp_output_format output_format;
@@ -34,6 +39,8 @@ check_dhcp_config check_dhcp_config_init(void) {
 	check_dhcp_config tmp = {
 		.unicast_mode = false,
 		.exclusive_mode = false,
+		.probe_dhcpv4 = false,
+		.probe_dhcpv6 = false,
 		.num_of_requested_servers = 0,
 		.dhcp_ip = {0},
 		.requested_address = {0},
@@ -41,7 +48,9 @@ check_dhcp_config check_dhcp_config_init(void) {
 
 		.dhcpoffer_timeout = 2,
 		.user_specified_mac = NULL,
-		.network_interface_name = "eth0",
+		.default_network_interface = "eth0",
+		.network_interfaces = NULL,
+		.num_of_network_interfaces = 0,
 		.requested_server_list = NULL,
 
 		.output_format_is_set = false,
@@ -0,0 +1,750 @@
+#include "../../plugins/common.h"
+#include "./dhcp_probe.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#define OK    0
+#define ERROR -1
+
+extern int verbose;
+
+static double dhcp_elapsed(struct timeval start, struct timeval end) {
+	return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_usec - start.tv_usec) / 1.0e6;
+}
+
+dhcp_address dhcp_address_from_v4(struct in_addr address) {
+	dhcp_address result = {
+		.family = AF_INET,
+		.v4 = address,
+	};
+	return result;
+}
+
+dhcp_address dhcp_address_from_v6(struct in6_addr address) {
+	dhcp_address result = {
+		.family = AF_INET6,
+		.v6 = address,
+	};
+	return result;
+}
+
+bool dhcp_address_equal(const dhcp_address left[static 1], const dhcp_address right[static 1]) {
+	if (left->family != right->family) {
+		return false;
+	}
+	if (left->family == AF_INET6) {
+		return memcmp(&left->v6, &right->v6, sizeof(left->v6)) == 0;
+	}
+	return left->v4.s_addr == right->v4.s_addr;
+}
+
+const char *dhcp_address_ntop(const dhcp_address address[static 1],
+							  char buffer[static INET6_ADDRSTRLEN]) {
+	const void *source = (address->family == AF_INET6) ? (const void *)&address->v6
+														: (const void *)&address->v4;
+	if (inet_ntop((address->family == AF_INET6) ? AF_INET6 : AF_INET, source, buffer,
+				  INET6_ADDRSTRLEN) == NULL) {
+		strcpy(buffer, "?");
+	}
+	return buffer;
+}
+
+/* adds a DHCP OFFER to list in memory */
+add_dhcp_offer_wrapper add_dhcp_offer(struct in_addr source, dhcp_packet *offer_packet,
+									  double latency, dhcp_offer *dhcp_offer_list) {
+	if (offer_packet == NULL) {
+		add_dhcp_offer_wrapper tmp = {
+			.error = ERROR,
+		};
+		return tmp;
+	}
+
+	uint32_t dhcp_lease_time = 0;
+	uint32_t dhcp_renewal_time = 0;
+	uint32_t dhcp_rebinding_time = 0;
+	dhcp_offer *new_offer;
+	struct in_addr serv_ident = {0};
+	/* process all DHCP options present in the packet */
+	for (size_t dchp_opt_idx = 4; dchp_opt_idx < MAX_DHCP_OPTIONS_LENGTH - 1;) {
+		/* get option type */
+		dhcp_options_type option_type = offer_packet->options[dchp_opt_idx++];
+
+		// End parsing when we find the end option
+		if (option_type == DHCP_OPTION_END) {
+			break;
+		}
+
+		// Padding octet
+		if (option_type == DHCP_OPTION_PADDING) {
+			dchp_opt_idx++;
+			continue;
+		}
+
+		/* neither padding nor end, get option length */
+		uint8_t option_length = offer_packet->options[dchp_opt_idx++];
+
+		if (verbose) {
+			printf("Option: %d (0x%02X)\n", option_type, option_length);
+		}
+
+		/* get option data */
+		switch (option_type) {
+		case DHCP_OPTION_LEASE_TIME:
+			memcpy(&dhcp_lease_time, &offer_packet->options[dchp_opt_idx], sizeof(dhcp_lease_time));
+			dhcp_lease_time = ntohl(dhcp_lease_time);
+			break;
+		case DHCP_OPTION_RENEWAL_TIME:
+			memcpy(&dhcp_renewal_time, &offer_packet->options[dchp_opt_idx],
+				   sizeof(dhcp_renewal_time));
+			dhcp_renewal_time = ntohl(dhcp_renewal_time);
+			break;
+		case DHCP_OPTION_REBINDING_TIME:
+			memcpy(&dhcp_rebinding_time, &offer_packet->options[dchp_opt_idx],
+				   sizeof(dhcp_rebinding_time));
+			dhcp_rebinding_time = ntohl(dhcp_rebinding_time);
+			break;
+		case DHCP_OPTION_SERVER_IDENTIFIER:
+			memcpy(&serv_ident.s_addr, &offer_packet->options[dchp_opt_idx],
+				   sizeof(serv_ident.s_addr));
+			break;
+		default: {
+			// not handled
+		}
+		}
+
+		/* skip option data we're ignoring */
+		dchp_opt_idx += option_length;
+	}
+
+	if (verbose) {
+		if (dhcp_lease_time == DHCP_INFINITE_TIME) {
+			printf(_("Lease Time: Infinite\n"));
+		} else {
+			printf(_("Lease Time: %" PRIu32 " seconds\n"), dhcp_lease_time);
+		}
+		if (dhcp_renewal_time == DHCP_INFINITE_TIME) {
+			printf(_("Renewal Time: Infinite\n"));
+		} else {
+			printf(_("Renewal Time: %" PRIu32 " seconds\n"), dhcp_renewal_time);
+		}
+		if (dhcp_rebinding_time == DHCP_INFINITE_TIME) {
+			printf(_("Rebinding Time: Infinite\n"));
+		}
+		printf(_("Rebinding Time: %" PRIu32 " seconds\n"), dhcp_rebinding_time);
+	}
+
+	new_offer = (dhcp_offer *)malloc(sizeof(dhcp_offer));
+
+	if (new_offer == NULL) {
+		add_dhcp_offer_wrapper tmp = {
+			.error = ERROR,
+		};
+		return tmp;
+	}
+
+	/*
+	 * RFC 2131 (2.) says: "DHCP clarifies the interpretation of the
+	 * 'siaddr' field as the address of the server to use in the next step
+	 * of the client's bootstrap process.  A DHCP server may return its own
+	 * address in the 'siaddr' field, if the server is prepared to supply
+	 * the next bootstrap service (e.g., delivery of an operating system
+	 * executable image).  A DHCP server always returns its own address in
+	 * the 'server identifier' option."  'serv_ident' is the 'server
+	 * identifier' option, 'source' is the IP address we received the
+	 * DHCPOFFER from.  If 'serv_ident' isn't available for some reason, we
+	 * use 'source'.
+	 */
+	new_offer->server_address = dhcp_address_from_v4(serv_ident.s_addr ? serv_ident : source);
+	new_offer->offered_address = dhcp_address_from_v4(offer_packet->yiaddr);
+	new_offer->lease_time = dhcp_lease_time;
+	new_offer->renewal_time = dhcp_renewal_time;
+	new_offer->rebinding_time = dhcp_rebinding_time;
+	new_offer->latency = latency;
+	new_offer->desired = false; /* exclusive mode: we'll check that in get_results */
+
+	if (verbose) {
+		printf(_("Added offer from server @ %s"), inet_ntoa(new_offer->server_address.v4));
+		printf(_(" of IP address %s\n"), inet_ntoa(new_offer->offered_address.v4));
+	}
+
+	/* add new offer to head of list */
+	new_offer->next = dhcp_offer_list;
+	dhcp_offer_list = new_offer;
+
+	add_dhcp_offer_wrapper result = {
+		.error = OK,
+		.dhcp_offer_list = dhcp_offer_list,
+	};
+
+	return result;
+}
+
+/* frees memory allocated to DHCP OFFER list */
+int free_dhcp_offer_list(dhcp_offer *dhcp_offer_list) {
+	dhcp_offer *next_offer;
+	for (dhcp_offer *this_offer = dhcp_offer_list; this_offer != NULL; this_offer = next_offer) {
+		next_offer = this_offer->next;
+		free(this_offer);
+	}
+
+	return OK;
+}
+
+void dhcp_build_discover(dhcp_packet packet[static 1], const dhcp_probe probe[static 1],
+						 struct in_addr requested_address, bool request_specific_address) {
+	memset(packet, 0, sizeof(dhcp_packet));
+
+	/* boot request flag (backward compatible with BOOTP servers) */
+	packet->op = BOOTREQUEST;
+
+	/* hardware address type */
+	packet->htype = ETHERNET_HARDWARE_ADDRESS;
+
+	/* length of our hardware address */
+	packet->hlen = ETHERNET_HARDWARE_ADDRESS_LENGTH;
+
+	packet->xid = htonl(probe->xid);
+
+	/*discover_packet.secs=htons(65535);*/
+	packet->secs = 0xFF;
+
+	/*
+	 * server needs to know if it should broadcast or unicast its response:
+	 * 0x8000L == 32768 == 1 << 15 == broadcast, 0 == unicast
+	 */
+	packet->flags = probe->unicast ? 0 : htons(DHCP_BROADCAST_FLAG);
+
+	/* our hardware address */
+	memcpy(packet->chaddr, probe->hardware_address, ETHERNET_HARDWARE_ADDRESS_LENGTH);
+
+	/* first four bytes of options field is magic cookie (as per RFC 2132) */
+	packet->options[0] = '\x63';
+	packet->options[1] = '\x82';
+	packet->options[2] = '\x53';
+	packet->options[3] = '\x63';
+
+	unsigned short opts = 4;
+	/* DHCP message type is embedded in options field */
+	packet->options[opts++] = DHCP_OPTION_MESSAGE_TYPE; /* DHCP message type option identifier */
+	packet->options[opts++] = '\x01';                   /* DHCP message option length in bytes */
+	packet->options[opts++] = DHCPDISCOVER;
+
+	/* the IP address we're requesting */
+	if (request_specific_address) {
+		packet->options[opts++] = DHCP_OPTION_REQUESTED_ADDRESS;
+		packet->options[opts++] = '\x04';
+		memcpy(&packet->options[opts], &requested_address, sizeof(requested_address));
+		opts += sizeof(requested_address);
+	}
+	packet->options[opts++] = (char)DHCP_OPTION_END;
+
+	/* unicast fields */
+	if (probe->unicast) {
+		packet->giaddr.s_addr = probe->relay_address.s_addr;
+	}
+
+	/* see RFC 1542, 4.1.1 */
+	packet->hops = probe->unicast ? 1 : 0;
+}
+
+static void dhcp6_put16(unsigned char *packet, size_t length[static 1], uint16_t value) {
+	packet[(*length)++] = (unsigned char)(value >> 8);
+	packet[(*length)++] = (unsigned char)(value & 0xFF);
+}
+
+static void dhcp6_put32(unsigned char *packet, size_t length[static 1], uint32_t value) {
+	dhcp6_put16(packet, length, (uint16_t)(value >> 16));
+	dhcp6_put16(packet, length, (uint16_t)(value & 0xFFFF));
+}
+
+static uint16_t dhcp6_get16(const unsigned char *data) {
+	return (uint16_t)(data[0] << 8 | data[1]);
+}
+
+static uint32_t dhcp6_get32(const unsigned char *data) {
+	return (uint32_t)dhcp6_get16(data) << 16 | dhcp6_get16(&data[2]);
+}
+
+/* our client identifier, a DUID based on the link-layer address (RFC 8415, 11.4) */
+#define DHCP6_DUID_LL_LENGTH (4 + ETHERNET_HARDWARE_ADDRESS_LENGTH)
+static void dhcp6_client_duid(const dhcp_probe probe[static 1],
+							  unsigned char duid[static DHCP6_DUID_LL_LENGTH]) {
+	size_t length = 0;
+	dhcp6_put16(duid, &length, DHCP6_DUID_LL);
+	dhcp6_put16(duid, &length, ETHERNET_HARDWARE_ADDRESS);
+	memcpy(&duid[length], probe->hardware_address, ETHERNET_HARDWARE_ADDRESS_LENGTH);
+}
+
+/*
+ * Finds the first option with the given code in an option area, returns its
+ * data or NULL. Options overrunning the area end the search.
+ */
+static const unsigned char *dhcp6_find_option(const unsigned char *options, size_t length,
+											  uint16_t code, size_t option_length[static 1]) {
+	size_t offset = 0;
+	while (offset + 4 <= length) {
+		uint16_t option_code = dhcp6_get16(&options[offset]);
+		size_t data_length = dhcp6_get16(&options[offset + 2]);
+		if (offset + 4 + data_length > length) {
+			return NULL;
+		}
+		if (option_code == code) {
+			*option_length = data_length;
+			return &options[offset + 4];
+		}
+		offset += 4 + data_length;
+	}
+	return NULL;
+}
+
+/* a missing status code option means success */
+static uint16_t dhcp6_status(const unsigned char *options, size_t length) {
+	size_t status_length = 0;
+	const unsigned char *status =
+		dhcp6_find_option(options, length, DHCP6_OPTION_STATUS_CODE, &status_length);
+	return (status != NULL && status_length >= 2) ? dhcp6_get16(status) : DHCP6_STATUS_SUCCESS;
+}
+
+size_t dhcp6_build_solicit(unsigned char packet[static DHCP6_MAX_PACKET],
+						   const dhcp_probe probe[static 1],
+						   const struct in6_addr *requested_address) {
+	size_t length = 0;
+
+	/* message type and a 24 bit transaction id */
+	dhcp6_put32(packet, &length, (uint32_t)DHCP6_SOLICIT << 24 | (probe->xid & DHCP6_XID_MASK));
+
+	dhcp6_put16(packet, &length, DHCP6_OPTION_CLIENTID);
+	dhcp6_put16(packet, &length, DHCP6_DUID_LL_LENGTH);
+	dhcp6_client_duid(probe, &packet[length]);
+	length += DHCP6_DUID_LL_LENGTH;
+
+	/* this is our first and only attempt */
+	dhcp6_put16(packet, &length, DHCP6_OPTION_ELAPSED_TIME);
+	dhcp6_put16(packet, &length, 2);
+	dhcp6_put16(packet, &length, 0);
+
+	/* one non-temporary address, T1 and T2 are left to the server */
+	dhcp6_put16(packet, &length, DHCP6_OPTION_IA_NA);
+	dhcp6_put16(packet, &length, (requested_address != NULL) ? 12 + 28 : 12);
+	dhcp6_put32(packet, &length, probe->interface_index); /* IAID */
+	dhcp6_put32(packet, &length, 0);
+	dhcp6_put32(packet, &length, 0);
+
+	/* the address we'd like to get as a hint, lifetimes are left to the server */
+	if (requested_address != NULL) {
+		dhcp6_put16(packet, &length, DHCP6_OPTION_IAADDR);
+		dhcp6_put16(packet, &length, 24);
+		memcpy(&packet[length], requested_address, sizeof(*requested_address));
+		length += sizeof(*requested_address);
+		dhcp6_put32(packet, &length, 0);
+		dhcp6_put32(packet, &length, 0);
+	}
+
+	return length;
+}
+
+add_dhcp_offer_wrapper add_dhcp6_offer(struct in6_addr source, const unsigned char *packet,
+									   size_t length, double latency,
+									   dhcp_offer *dhcp_offer_list) {
+	add_dhcp_offer_wrapper result = {
+		.error = ERROR,
+		.dhcp_offer_list = dhcp_offer_list,
+	};
+
+	if (length < DHCP6_HEADER_LENGTH) {
+		return result;
+	}
+	const unsigned char *options = &packet[DHCP6_HEADER_LENGTH];
+	size_t options_length = length - DHCP6_HEADER_LENGTH;
+
+	/* RFC 8415 16.3: an ADVERTISE without a server identifier is discarded */
+	size_t server_id_length = 0;
+	if (dhcp6_find_option(options, options_length, DHCP6_OPTION_SERVERID, &server_id_length) ==
+		NULL) {
+		if (verbose) {
+			printf(_("ADVERTISE without server identifier - ignoring packet\n"));
+		}
+		return result;
+	}
+
+	uint16_t status = dhcp6_status(options, options_length);
+	size_t ia_length = 0;
+	const unsigned char *ia_na =
+		dhcp6_find_option(options, options_length, DHCP6_OPTION_IA_NA, &ia_length);
+	if (status == DHCP6_STATUS_SUCCESS && ia_na != NULL && ia_length >= 12) {
+		status = dhcp6_status(&ia_na[12], ia_length - 12);
+	}
+
+	size_t address_length = 0;
+	const unsigned char *ia_address =
+		(ia_na != NULL && ia_length >= 12)
+			? dhcp6_find_option(&ia_na[12], ia_length - 12, DHCP6_OPTION_IAADDR, &address_length)
+			: NULL;
+
+	/* a server answering NoAddrsAvail or the like does not offer anything */
+	if (status != DHCP6_STATUS_SUCCESS || ia_address == NULL || address_length < 24) {
+		if (verbose) {
+			printf(_("ADVERTISE offers no address (status %u) - ignoring packet\n"), status);
+		}
+		return result;
+	}
+
+	dhcp_offer *new_offer = (dhcp_offer *)malloc(sizeof(dhcp_offer));
+	if (new_offer == NULL) {
+		return result;
+	}
+
+	/* the server identifier is a DUID, not an address, so servers are known by their source */
+	struct in6_addr offered;
+	memcpy(&offered, ia_address, sizeof(offered));
+	new_offer->server_address = dhcp_address_from_v6(source);
+	new_offer->offered_address = dhcp_address_from_v6(offered);
+	new_offer->lease_time = dhcp6_get32(&ia_address[20]); /* valid lifetime */
+	new_offer->renewal_time = dhcp6_get32(&ia_na[4]);
+	new_offer->rebinding_time = dhcp6_get32(&ia_na[8]);
+	new_offer->latency = latency;
+	new_offer->desired = false; /* exclusive mode: we'll check that in get_results */
+
+	if (verbose) {
+		char buffer[INET6_ADDRSTRLEN];
+		printf(_("Added offer from server @ %s"),
+			   dhcp_address_ntop(&new_offer->server_address, buffer));
+		printf(_(" of IP address %s"), dhcp_address_ntop(&new_offer->offered_address, buffer));
+		printf(_(", valid lifetime %" PRIu32 " seconds\n"), new_offer->lease_time);
+	}
+
+	new_offer->next = dhcp_offer_list;
+	result.error = OK;
+	result.dhcp_offer_list = new_offer;
+	return result;
+}
+
+/* sends the DHCPv6 SOLICIT of a probe to all servers and relay agents on its link */
+static ssize_t dhcp6_probe_send(dhcp_probe probe[static 1], dhcp_address requested_address,
+								bool request_specific_address) {
+	bool use_requested = request_specific_address && requested_address.family == AF_INET6;
+	unsigned char solicit[DHCP6_MAX_PACKET];
+	size_t length =
+		dhcp6_build_solicit(solicit, probe, use_requested ? &requested_address.v6 : NULL);
+
+	struct sockaddr_in6 destination = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(DHCP6_SERVER_PORT),
+		.sin6_scope_id = probe->interface_index,
+	};
+	inet_pton(AF_INET6, DHCP6_ALL_AGENTS, &destination.sin6_addr);
+
+	if (verbose) {
+		printf(_("SOLICIT to %s port %d via %s\n"), DHCP6_ALL_AGENTS, DHCP6_SERVER_PORT,
+			   probe->interface_name);
+		printf("SOLICIT XID: %u (0x%X)\n", probe->xid & DHCP6_XID_MASK,
+			   probe->xid & DHCP6_XID_MASK);
+	}
+
+	gettimeofday(&probe->sent, NULL);
+	return sendto(probe->socket, solicit, length, 0, (struct sockaddr *)&destination,
+				  sizeof(destination));
+}
+
+int dhcp_probe_send_all(dhcp_probe probes[], size_t probe_count, dhcp_address requested_address,
+						bool request_specific_address) {
+	int failed = 0;
+
+	for (size_t i = 0; i < probe_count; i++) {
+		ssize_t result;
+		if (probes[i].family == AF_INET6) {
+			result = dhcp6_probe_send(&probes[i], requested_address, request_specific_address);
+		} else {
+			dhcp_packet discover_packet;
+			dhcp_build_discover(&discover_packet, &probes[i], requested_address.v4,
+								request_specific_address && requested_address.family == AF_INET);
+
+			/* send the DHCPDISCOVER packet to broadcast address */
+			struct sockaddr_in destination = {
+				.sin_family = AF_INET,
+				.sin_port = htons(DHCP_SERVER_PORT),
+				.sin_addr.s_addr =
+					probes[i].unicast ? probes[i].server_address.s_addr : INADDR_BROADCAST,
+			};
+
+			if (verbose) {
+				printf(_("DHCPDISCOVER to %s port %d via %s\n"), inet_ntoa(destination.sin_addr),
+					   ntohs(destination.sin_port), probes[i].interface_name);
+				printf("DHCPDISCOVER XID: %u (0x%X)\n", probes[i].xid, probes[i].xid);
+				printf("DHCDISCOVER giaddr:  %s\n", inet_ntoa(discover_packet.giaddr));
+			}
+
+			gettimeofday(&probes[i].sent, NULL);
+			result = sendto(probes[i].socket, (char *)&discover_packet, sizeof(discover_packet), 0,
+							(struct sockaddr *)&destination, sizeof(destination));
+		}
+
+		if (verbose) {
+			printf(_("send_dhcp_packet result: %zd\n"), result);
+		}
+
+		if (result < 0) {
+			probes[i].send_failed = true;
+			failed++;
+		}
+	}
+
+	if (verbose) {
+		printf("\n\n");
+	}
+
+	return failed;
+}
+
+int dhcp_probe_dispatch(dhcp_probe probes[], size_t probe_count, int socket,
+						dhcp_packet packet[static 1], struct in_addr source,
+						struct timeval received) {
+	uint32_t xid = ntohl(packet->xid);
+
+	if (verbose) {
+		printf(_("DHCPOFFER from IP address %s"), inet_ntoa(source));
+		printf("DHCPOFFER XID: %u (0x%X)\n", xid, xid);
+	}
+
+	/* check packet xid to see if its the same as the one we used in the discover packet */
+	size_t index = 0;
+	while (index < probe_count && (probes[index].socket != socket || probes[index].xid != xid)) {
+		index++;
+	}
+
+	if (index == probe_count) {
+		if (verbose) {
+			printf(_("DHCPOFFER XID (%u) did not match any DHCPDISCOVER XID - ignoring packet\n"),
+				   xid);
+		}
+		return ERROR;
+	}
+
+	/* our own DHCPDISCOVER may be looped back to us on some interfaces */
+	if (packet->op != BOOTREPLY) {
+		if (verbose) {
+			printf(_("Packet is not a BOOTREPLY - ignoring packet\n"));
+		}
+		return ERROR;
+	}
+
+	dhcp_probe *probe = &probes[index];
+	probe->responses++;
+
+	/* check hardware address */
+	if (memcmp(packet->chaddr, probe->hardware_address, ETHERNET_HARDWARE_ADDRESS_LENGTH) != 0) {
+		if (verbose) {
+			printf(_("DHCPOFFER hardware address did not match our own - ignoring packet\n"));
+		}
+		return ERROR;
+	}
+
+	if (verbose) {
+		printf("DHCPOFFER ciaddr: %s\n", inet_ntoa(packet->ciaddr));
+		printf("DHCPOFFER yiaddr: %s\n", inet_ntoa(packet->yiaddr));
+		printf("DHCPOFFER siaddr: %s\n", inet_ntoa(packet->siaddr));
+		printf("DHCPOFFER giaddr: %s\n", inet_ntoa(packet->giaddr));
+	}
+
+	add_dhcp_offer_wrapper add_res =
+		add_dhcp_offer(source, packet, dhcp_elapsed(probe->sent, received), probe->offers);
+	if (add_res.error == OK) {
+		probe->offers = add_res.dhcp_offer_list;
+	}
+
+	probe->valid_responses++;
+	return (int)index;
+}
+
+int dhcp6_probe_dispatch(dhcp_probe probes[], size_t probe_count, int socket,
+						 const unsigned char *packet, size_t length, struct in6_addr source,
+						 struct timeval received) {
+	/* our own SOLICIT may be looped back to us, replies other than ADVERTISE don't concern us */
+	if (length < DHCP6_HEADER_LENGTH || packet[0] != DHCP6_ADVERTISE) {
+		if (verbose) {
+			printf(_("Packet is not a DHCPv6 ADVERTISE - ignoring packet\n"));
+		}
+		return ERROR;
+	}
+
+	uint32_t xid = dhcp6_get32(packet) & DHCP6_XID_MASK;
+	if (verbose) {
+		char buffer[INET6_ADDRSTRLEN];
+		printf(_("ADVERTISE from IP address %s\n"), inet_ntop(AF_INET6, &source, buffer,
+																sizeof(buffer)));
+		printf("ADVERTISE XID: %u (0x%X)\n", xid, xid);
+	}
+
+	size_t index = 0;
+	while (index < probe_count && (probes[index].socket != socket ||
+								   (probes[index].xid & DHCP6_XID_MASK) != xid)) {
+		index++;
+	}
+
+	if (index == probe_count) {
+		if (verbose) {
+			printf(_("ADVERTISE XID (%u) did not match any SOLICIT XID - ignoring packet\n"), xid);
+		}
+		return ERROR;
+	}
+
+	dhcp_probe *probe = &probes[index];
+	probe->responses++;
+
+	/* the client identifier takes the place of the DHCPv4 hardware address */
+	unsigned char duid[DHCP6_DUID_LL_LENGTH];
+	dhcp6_client_duid(probe, duid);
+	size_t client_id_length = 0;
+	const unsigned char *client_id =
+		dhcp6_find_option(&packet[DHCP6_HEADER_LENGTH], length - DHCP6_HEADER_LENGTH,
+						  DHCP6_OPTION_CLIENTID, &client_id_length);
+	if (client_id == NULL || client_id_length != sizeof(duid) ||
+		memcmp(client_id, duid, sizeof(duid)) != 0) {
+		if (verbose) {
+			printf(_("ADVERTISE client identifier did not match our own - ignoring packet\n"));
+		}
+		return ERROR;
+	}
+
+	add_dhcp_offer_wrapper add_res = add_dhcp6_offer(
+		source, packet, length, dhcp_elapsed(probe->sent, received), probe->offers);
+	if (add_res.error != OK) {
+		return ERROR;
+	}
+
+	probe->offers = add_res.dhcp_offer_list;
+	probe->valid_responses++;
+	return (int)index;
+}
+
+static bool dhcp_probes_complete(dhcp_probe probes[], size_t probe_count) {
+	for (size_t i = 0; i < probe_count; i++) {
+		if (probes[i].send_failed) {
+			continue;
+		}
+		if (probes[i].expected_offers == 0 ||
+			probes[i].valid_responses < probes[i].expected_offers) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* all probes on a socket are of the same family */
+static sa_family_t dhcp_socket_family(dhcp_probe probes[], size_t probe_count, int socket) {
+	for (size_t i = 0; i < probe_count; i++) {
+		if (probes[i].socket == socket) {
+			return probes[i].family;
+		}
+	}
+	return AF_UNSPEC;
+}
+
+void dhcp_probe_collect(dhcp_probe probes[], size_t probe_count, int timeout) {
+	/* all probes of an interface share the socket, poll every socket once */
+	struct pollfd *poll_fds = calloc(probe_count, sizeof(struct pollfd));
+	if (poll_fds == NULL) {
+		die(STATE_UNKNOWN, _("Could not calloc() units [%lu]\n"), probe_count);
+	}
+
+	nfds_t socket_count = 0;
+	for (size_t i = 0; i < probe_count; i++) {
+		bool known = false;
+		for (nfds_t j = 0; j < socket_count; j++) {
+			known = known || poll_fds[j].fd == probes[i].socket;
+		}
+		if (!known) {
+			poll_fds[socket_count].fd = probes[i].socket;
+			poll_fds[socket_count].events = POLLIN;
+			socket_count++;
+		}
+	}
+
+	struct timeval start;
+	gettimeofday(&start, NULL);
+
+	/* receive as many responses as we can */
+	while (!dhcp_probes_complete(probes, probe_count)) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		int remaining = (int)((timeout - dhcp_elapsed(start, now)) * 1000);
+		if (remaining <= 0) {
+			break;
+		}
+
+		int ready = poll(poll_fds, socket_count, remaining);
+		if (ready < 0 && errno != EINTR) {
+			if (verbose) {
+				printf("poll() failed: (%d) -> %s\n", errno, strerror(errno));
+			}
+			break;
+		}
+		if (ready <= 0) {
+			continue;
+		}
+
+		struct timeval received;
+		gettimeofday(&received, NULL);
+
+		for (nfds_t j = 0; j < socket_count; j++) {
+			if ((poll_fds[j].revents & POLLIN) == 0) {
+				continue;
+			}
+
+			struct sockaddr_storage source_address = {0};
+			socklen_t address_size = sizeof(source_address);
+			unsigned char buffer[DHCP6_MAX_PACKET];
+			ssize_t recv_result = recvfrom(poll_fds[j].fd, buffer, sizeof(buffer), 0,
+										   (struct sockaddr *)&source_address, &address_size);
+
+			if (recv_result < 0) {
+				if (verbose) {
+					printf(_("recvfrom() failed, "));
+					printf("errno: (%d) -> %s\n", errno, strerror(errno));
+				}
+				continue;
+			}
+
+			if (verbose) {
+				printf(_("receive_dhcp_packet() result: %zd\n"), recv_result);
+			}
+
+			if (dhcp_socket_family(probes, probe_count, poll_fds[j].fd) == AF_INET6) {
+				struct in6_addr source = in6addr_any;
+				if (source_address.ss_family == AF_INET6) {
+					source = ((struct sockaddr_in6 *)&source_address)->sin6_addr;
+				}
+				dhcp6_probe_dispatch(probes, probe_count, poll_fds[j].fd, buffer,
+									 (size_t)recv_result, source, received);
+				continue;
+			}
+
+			dhcp_packet offer_packet = {0};
+			memcpy(&offer_packet, buffer,
+				   ((size_t)recv_result < sizeof(offer_packet)) ? (size_t)recv_result
+																: sizeof(offer_packet));
+			struct in_addr source = {0};
+			if (source_address.ss_family == AF_INET) {
+				source = ((struct sockaddr_in *)&source_address)->sin_addr;
+			}
+			dhcp_probe_dispatch(probes, probe_count, poll_fds[j].fd, &offer_packet, source,
+								received);
+		}
+	}
+
+	free(poll_fds);
+
+	if (verbose) {
+		for (size_t i = 0; i < probe_count; i++) {
+			printf(_("Probe %s XID %u: responses seen on the wire: %d, valid responses: %d\n"),
+				   probes[i].interface_name, probes[i].xid, probes[i].responses,
+				   probes[i].valid_responses);
+		}
+	}
+}
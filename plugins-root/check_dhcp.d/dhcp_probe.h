@@ -0,0 +1,245 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+/**** DHCP definitions ****/
+
+#define MAX_DHCP_CHADDR_LENGTH  16
+#define MAX_DHCP_SNAME_LENGTH   64
+#define MAX_DHCP_FILE_LENGTH    128
+#define MAX_DHCP_OPTIONS_LENGTH 312
+
+// RFC 2131
+// 0                   1                   2                   3
+// 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+// +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+// |     op (1)    |   htype (1)   |   hlen (1)    |   hops (1)    |
+// +---------------+---------------+---------------+---------------+
+// |                            xid (4)                            |
+// +-------------------------------+-------------------------------+
+// |           secs (2)            |           flags (2)           |
+// +-------------------------------+-------------------------------+
+// |                          ciaddr  (4)                          |
+// +---------------------------------------------------------------+
+// |                          yiaddr  (4)                          |
+// +---------------------------------------------------------------+
+// |                          siaddr  (4)                          |
+// +---------------------------------------------------------------+
+// |                          giaddr  (4)                          |
+// +---------------------------------------------------------------+
+// |                                                               |
+// |                          chaddr  (16)                         |
+// |                                                               |
+// |                                                               |
+// +---------------------------------------------------------------+
+// |                                                               |
+// |                          sname   (64)                         |
+// +---------------------------------------------------------------+
+// |                                                               |
+// |                          file    (128)                        |
+// +---------------------------------------------------------------+
+// |                                                               |
+// |                          options (variable)                   |
+// +---------------------------------------------------------------+
+
+typedef struct dhcp_packet_struct {
+	uint8_t op;            /* packet type */
+	uint8_t htype;         /* type of hardware address for this machine (Ethernet, etc) */
+	uint8_t hlen;          /* length of hardware address (of this machine) */
+	uint8_t hops;          /* hops */
+	uint32_t xid;          /* random transaction id number - chosen by this machine */
+	uint16_t secs;         /* seconds used in timing */
+	uint16_t flags;        /* flags */
+	struct in_addr ciaddr; /* IP address of this machine (if we already have one) */
+	struct in_addr yiaddr; /* IP address of this machine (offered by the DHCP server) */
+	struct in_addr siaddr; /* IP address of next server */
+	struct in_addr giaddr; /* IP address of DHCP relay */
+	unsigned char chaddr[MAX_DHCP_CHADDR_LENGTH]; /* hardware address of this machine */
+	char sname[MAX_DHCP_SNAME_LENGTH];            /* name of DHCP server */
+	char file[MAX_DHCP_FILE_LENGTH];              /* boot file name (used for diskless booting?) */
+	uint8_t options[MAX_DHCP_OPTIONS_LENGTH];     /* options */
+} dhcp_packet;
+
+/* An IPv4 or IPv6 address, DHCPv4 and DHCPv6 results are evaluated alike */
+typedef struct {
+	sa_family_t family; /* AF_INET or AF_INET6, 0 if unset */
+	union {
+		struct in_addr v4;
+		struct in6_addr v6;
+	};
+} dhcp_address;
+
+dhcp_address dhcp_address_from_v4(struct in_addr /*address*/);
+dhcp_address dhcp_address_from_v6(struct in6_addr /*address*/);
+bool dhcp_address_equal(const dhcp_address /*left*/[static 1],
+						const dhcp_address /*right*/[static 1]);
+/* Formats the address into buffer and returns it */
+const char *dhcp_address_ntop(const dhcp_address /*address*/[static 1],
+							  char buffer[static INET6_ADDRSTRLEN]);
+
+typedef struct dhcp_offer_struct {
+	dhcp_address server_address;    /* address of DHCP server that sent this offer */
+	dhcp_address offered_address;   /* the IP address that was offered to us */
+	uint32_t lease_time;            /* lease time in seconds */
+	uint32_t renewal_time;          /* renewal time in seconds */
+	uint32_t rebinding_time;        /* rebinding time in seconds */
+	double latency;                 /* seconds between the DHCPDISCOVER and this offer */
+	bool desired;                   /* is this offer desired (necessary in exclusive mode) */
+	struct dhcp_offer_struct *next;
+} dhcp_offer;
+
+typedef enum {
+	BOOTREQUEST = 1,
+	BOOTREPLY = 2,
+} dhcp_packet_op;
+
+typedef enum {
+	DHCPDISCOVER = 1,
+	DHCPOFFER = 2,
+	DHCPREQUEST = 3,
+	DHCPDECLINE = 4,
+	DHCPACK = 5,
+	DHCPNACK = 6,
+	DHCPRELEASE = 7,
+} dhcp_message_type;
+
+typedef enum {
+	DHCP_OPTION_PADDING = 0,
+	DHCP_OPTION_MESSAGE_TYPE = 53,
+	DHCP_OPTION_HOST_NAME = 12,
+	DHCP_OPTION_BROADCAST_ADDRESS = 28,
+	DHCP_OPTION_REQUESTED_ADDRESS = 50,
+	DHCP_OPTION_LEASE_TIME = 51,
+	DHCP_OPTION_SERVER_IDENTIFIER = 54,
+	DHCP_OPTION_RENEWAL_TIME = 58,
+	DHCP_OPTION_REBINDING_TIME = 59,
+	DHCP_OPTION_END = 255,
+} dhcp_options_type;
+
+#define DHCP_INFINITE_TIME 0xFFFFFFFF
+
+#define DHCP_BROADCAST_FLAG 32768
+
+#define DHCP_SERVER_PORT 67
+#define DHCP_CLIENT_PORT 68
+
+#define ETHERNET_HARDWARE_ADDRESS        1 /* used in htype field of dhcp packet */
+#define ETHERNET_HARDWARE_ADDRESS_LENGTH 6 /* length of Ethernet hardware addresses */
+
+/**** DHCPv6 definitions (RFC 8415) ****/
+
+// 0                   1                   2                   3
+// 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+// +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+// |    msg-type   |               transaction-id                  |
+// +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+// |                                                               |
+// .                            options                            .
+// .                 (variable number and length)                  .
+// |                                                               |
+// +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+#define DHCP6_HEADER_LENGTH  4
+#define DHCP6_MAX_PACKET     1500
+#define DHCP6_XID_MASK       0xFFFFFF
+#define DHCP6_CLIENT_PORT    546
+#define DHCP6_SERVER_PORT    547
+#define DHCP6_ALL_AGENTS     "ff02::1:2" /* All_DHCP_Relay_Agents_and_Servers */
+#define DHCP6_DUID_LL        3
+#define DHCP6_STATUS_SUCCESS 0
+
+typedef enum {
+	DHCP6_SOLICIT = 1,
+	DHCP6_ADVERTISE = 2,
+} dhcp6_message_type;
+
+typedef enum {
+	DHCP6_OPTION_CLIENTID = 1,
+	DHCP6_OPTION_SERVERID = 2,
+	DHCP6_OPTION_IA_NA = 3,
+	DHCP6_OPTION_IAADDR = 5,
+	DHCP6_OPTION_ELAPSED_TIME = 8,
+	DHCP6_OPTION_STATUS_CODE = 13,
+} dhcp6_options_type;
+
+typedef struct add_dhcp_offer_wrapper {
+	int error;
+	dhcp_offer *dhcp_offer_list;
+} add_dhcp_offer_wrapper;
+add_dhcp_offer_wrapper add_dhcp_offer(struct in_addr /*source*/, dhcp_packet * /*offer_packet*/,
+									  double /*latency*/, dhcp_offer *dhcp_offer_list);
+/* Parses a DHCPv6 ADVERTISE into an offer, fails if it offers no address */
+add_dhcp_offer_wrapper add_dhcp6_offer(struct in6_addr /*source*/,
+									   const unsigned char * /*packet*/, size_t /*length*/,
+									   double /*latency*/, dhcp_offer *dhcp_offer_list);
+int free_dhcp_offer_list(dhcp_offer *dhcp_offer_list);
+
+/*
+ * A single DHCPDISCOVER or DHCPv6 SOLICIT of a run. Every interface gets one
+ * socket per address family, in unicast mode all relayed probes of an
+ * interface share it and are told apart by their transaction id.
+ */
+typedef struct {
+	char interface_name[IFNAMSIZ];
+	unsigned int interface_index; /* DHCPv6: scope of the multicast destination */
+	sa_family_t family;           /* AF_INET for DHCPv4, AF_INET6 for DHCPv6 */
+	int socket;
+	unsigned char hardware_address[MAX_DHCP_CHADDR_LENGTH];
+
+	bool unicast;
+	struct in_addr server_address; /* unicast mode: the server we pretend to relay to */
+	struct in_addr relay_address;  /* unicast mode: our own address, sent as giaddr */
+
+	uint32_t xid;
+	struct timeval sent;
+	bool send_failed;
+	/* the probe is complete after this many offers, 0 waits for the timeout */
+	int expected_offers;
+
+	int responses;
+	int valid_responses;
+	dhcp_offer *offers;
+} dhcp_probe;
+
+/* Fills in a DHCPDISCOVER for the probe */
+void dhcp_build_discover(dhcp_packet packet[static 1], const dhcp_probe probe[static 1],
+						 struct in_addr requested_address, bool request_specific_address);
+
+/*
+ * Fills in a DHCPv6 SOLICIT for the probe, asking for one non-temporary
+ * address. Returns the length of the message.
+ */
+size_t dhcp6_build_solicit(unsigned char packet[static DHCP6_MAX_PACKET],
+						   const dhcp_probe probe[static 1],
+						   const struct in6_addr *requested_address);
+
+/*
+ * Sends the DHCPDISCOVER or SOLICIT of every probe, requested_address is only
+ * asked for by the probes of its family. Returns the number of failed probes.
+ */
+int dhcp_probe_send_all(dhcp_probe probes[], size_t probe_count,
+						dhcp_address requested_address, bool request_specific_address);
+
+/*
+ * Assigns a received packet to the probe on the same socket with the same
+ * transaction id and hardware address and records the offer. Returns the
+ * index of the probe or -1 if the packet is not for us.
+ */
+int dhcp_probe_dispatch(dhcp_probe probes[], size_t probe_count, int socket,
+						dhcp_packet packet[static 1], struct in_addr source,
+						struct timeval received);
+
+/* Like dhcp_probe_dispatch for a DHCPv6 ADVERTISE, matched by transaction id and client DUID */
+int dhcp6_probe_dispatch(dhcp_probe probes[], size_t probe_count, int socket,
+						 const unsigned char * /*packet*/, size_t /*length*/,
+						 struct in6_addr source, struct timeval received);
+
+/* Collects offers on all probe sockets until the timeout or all probes are complete */
+void dhcp_probe_collect(dhcp_probe probes[], size_t probe_count, int timeout);
@@ -0,0 +1,302 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "../../plugins/common.h"
+#include "../check_dhcp.d/dhcp_probe.h"
+#include "../../tap/tap.h"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+void print_usage(void) {}
+
+const char *progname = "test_check_dhcp";
+int verbose = 0;
+
+static const unsigned char client_mac[ETHERNET_HARDWARE_ADDRESS_LENGTH] = {0x02, 0x00, 0x00,
+																		   0x00, 0x00, 0x01};
+
+/* A DHCPOFFER like the ones captured from our relays */
+static dhcp_packet make_offer(uint32_t xid, const unsigned char *mac, const char *offered,
+							  const char *server, uint32_t lease_time) {
+	dhcp_packet packet = {0};
+	packet.op = BOOTREPLY;
+	packet.htype = ETHERNET_HARDWARE_ADDRESS;
+	packet.hlen = ETHERNET_HARDWARE_ADDRESS_LENGTH;
+	packet.xid = htonl(xid);
+	inet_pton(AF_INET, offered, &packet.yiaddr);
+	memcpy(packet.chaddr, mac, ETHERNET_HARDWARE_ADDRESS_LENGTH);
+
+	const uint8_t cookie[] = {0x63, 0x82, 0x53, 0x63};
+	memcpy(packet.options, cookie, sizeof(cookie));
+	size_t opts = 4;
+	packet.options[opts++] = DHCP_OPTION_MESSAGE_TYPE;
+	packet.options[opts++] = 1;
+	packet.options[opts++] = DHCPOFFER;
+	packet.options[opts++] = DHCP_OPTION_SERVER_IDENTIFIER;
+	packet.options[opts++] = 4;
+	inet_pton(AF_INET, server, &packet.options[opts]);
+	opts += 4;
+	packet.options[opts++] = DHCP_OPTION_LEASE_TIME;
+	packet.options[opts++] = 4;
+	uint32_t lease = htonl(lease_time);
+	memcpy(&packet.options[opts], &lease, sizeof(lease));
+	opts += 4;
+	packet.options[opts++] = DHCP_OPTION_END;
+	return packet;
+}
+
+static void replay(int socket, dhcp_packet packet) {
+	if (send(socket, &packet, sizeof(packet), 0) != sizeof(packet)) {
+		diag("replaying a packet failed: %s", strerror(errno));
+	}
+}
+
+static size_t put_option6(unsigned char *packet, size_t length, uint16_t code,
+						  const unsigned char *data, uint16_t data_length) {
+	packet[length++] = (unsigned char)(code >> 8);
+	packet[length++] = (unsigned char)(code & 0xFF);
+	packet[length++] = (unsigned char)(data_length >> 8);
+	packet[length++] = (unsigned char)(data_length & 0xFF);
+	memcpy(&packet[length], data, data_length);
+	return length + data_length;
+}
+
+/* A DHCPv6 ADVERTISE, without an offered address if it is NULL */
+static void replay6(int socket, uint32_t xid, const unsigned char *mac, const char *offered,
+					uint32_t valid_lifetime) {
+	unsigned char packet[DHCP6_MAX_PACKET];
+	size_t length = 0;
+	packet[length++] = DHCP6_ADVERTISE;
+	packet[length++] = (unsigned char)(xid >> 16);
+	packet[length++] = (unsigned char)(xid >> 8);
+	packet[length++] = (unsigned char)xid;
+
+	const unsigned char client_id[] = {0, DHCP6_DUID_LL, 0, ETHERNET_HARDWARE_ADDRESS,
+									   mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]};
+	length = put_option6(packet, length, DHCP6_OPTION_CLIENTID, client_id, sizeof(client_id));
+	const unsigned char server_id[] = {0, DHCP6_DUID_LL, 0, 1, 0x02, 0, 0, 0, 0, 0xFE};
+	length = put_option6(packet, length, DHCP6_OPTION_SERVERID, server_id, sizeof(server_id));
+
+	/* IAID, T1 = 1800, T2 = 2880 and an IAADDR or a NoAddrsAvail status */
+	unsigned char ia_na[12 + 28] = {0, 0, 0, 1, 0, 0, 0x07, 0x08, 0, 0, 0x0B, 0x40};
+	size_t ia_length = 12;
+	if (offered != NULL) {
+		unsigned char ia_address[24] = {0};
+		inet_pton(AF_INET6, offered, ia_address);
+		uint32_t lifetime = htonl(valid_lifetime);
+		memcpy(&ia_address[16], &lifetime, sizeof(lifetime));
+		memcpy(&ia_address[20], &lifetime, sizeof(lifetime));
+		ia_length = put_option6(ia_na, ia_length, DHCP6_OPTION_IAADDR, ia_address,
+								sizeof(ia_address));
+	} else {
+		const unsigned char no_addrs_avail[] = {0, 2};
+		ia_length = put_option6(ia_na, ia_length, DHCP6_OPTION_STATUS_CODE, no_addrs_avail,
+								sizeof(no_addrs_avail));
+	}
+	length = put_option6(packet, length, DHCP6_OPTION_IA_NA, ia_na, (uint16_t)ia_length);
+
+	if (send(socket, packet, length, 0) != (ssize_t)length) {
+		diag("replaying a packet failed: %s", strerror(errno));
+	}
+}
+
+int main(void) {
+	/*
+	 * Captured offers are replayed through the receive loop: two interfaces,
+	 * the first one with two relayed probes sharing the socket, and a DHCPv6
+	 * socket.
+	 */
+	int interface_a[2];
+	int interface_b[2];
+	int interface_v6[2];
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, interface_a) != 0 ||
+		socketpair(AF_UNIX, SOCK_DGRAM, 0, interface_b) != 0 ||
+		socketpair(AF_UNIX, SOCK_DGRAM, 0, interface_v6) != 0) {
+		return plan_skip_all("socketpair() failed");
+	}
+
+	plan_tests(29);
+
+	/* DHCPDISCOVER encoding */
+	dhcp_probe relay_probe = {
+		.unicast = true,
+		.xid = 0x01020304,
+	};
+	memcpy(relay_probe.hardware_address, client_mac, sizeof(client_mac));
+	inet_pton(AF_INET, "192.0.2.1", &relay_probe.relay_address);
+
+	struct in_addr requested;
+	inet_pton(AF_INET, "192.0.2.50", &requested);
+
+	dhcp_packet discover;
+	dhcp_build_discover(&discover, &relay_probe, requested, true);
+	ok(discover.op == BOOTREQUEST && discover.xid == htonl(0x01020304),
+	   "DISCOVER carries the probe xid");
+	ok(discover.flags == 0 && discover.hops == 1 &&
+		   discover.giaddr.s_addr == relay_probe.relay_address.s_addr,
+	   "Relayed DISCOVER sets giaddr and hops");
+	ok(discover.options[4] == DHCP_OPTION_MESSAGE_TYPE && discover.options[6] == DHCPDISCOVER,
+	   "Message type option is set");
+	ok(discover.options[7] == DHCP_OPTION_REQUESTED_ADDRESS &&
+		   memcmp(&discover.options[9], &requested, 4) == 0,
+	   "Requested address option is set");
+
+	relay_probe.unicast = false;
+	dhcp_build_discover(&discover, &relay_probe, requested, false);
+	ok(discover.flags == htons(DHCP_BROADCAST_FLAG) && discover.giaddr.s_addr == 0 &&
+		   discover.options[7] == DHCP_OPTION_END,
+	   "Broadcast DISCOVER asks for a broadcast answer");
+
+	dhcp_probe probes[3] = {0};
+	for (size_t i = 0; i < 3; i++) {
+		probes[i].family = AF_INET;
+		probes[i].socket = (i < 2) ? interface_a[0] : interface_b[0];
+		probes[i].xid = 1000 + (uint32_t)i;
+		probes[i].expected_offers = 1;
+		memcpy(probes[i].hardware_address, client_mac, sizeof(client_mac));
+		gettimeofday(&probes[i].sent, NULL);
+	}
+	strcpy(probes[0].interface_name, "vlan10");
+	strcpy(probes[1].interface_name, "vlan10");
+	strcpy(probes[2].interface_name, "vlan20");
+
+	const unsigned char other_mac[ETHERNET_HARDWARE_ADDRESS_LENGTH] = {0x02, 0, 0, 0, 0, 0x99};
+	replay(interface_a[1], make_offer(4711, client_mac, "10.0.0.99", "10.0.0.1", 60));
+	replay(interface_a[1], make_offer(1001, other_mac, "10.0.0.98", "10.0.0.2", 60));
+	replay(interface_a[1], make_offer(1001, client_mac, "10.0.10.20", "10.0.0.2", 7200));
+	replay(interface_a[1], make_offer(1000, client_mac, "10.0.10.10", "10.0.0.1", 3600));
+	/* the xid of vlan10 on vlan20 must not be taken for an answer */
+	replay(interface_b[1], make_offer(1000, client_mac, "10.0.20.99", "10.0.0.3", 60));
+	replay(interface_b[1], make_offer(1002, client_mac, "10.0.20.10", "10.0.0.3", 0xFFFFFFFF));
+
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	dhcp_probe_collect(probes, 3, 5);
+	struct timeval end;
+	gettimeofday(&end, NULL);
+
+	ok(end.tv_sec - start.tv_sec < 2, "Collection ends as soon as every probe is answered");
+
+	ok(probes[0].valid_responses == 1 && probes[0].offers != NULL, "First probe got its offer");
+	ok(probes[0].offers->server_address.v4.s_addr == inet_addr("10.0.0.1") &&
+		   probes[0].offers->offered_address.v4.s_addr == inet_addr("10.0.10.10"),
+	   "First probe offer comes from its server");
+	ok(probes[0].offers->lease_time == 3600, "Lease time is decoded");
+	ok(probes[0].offers->latency >= 0 && probes[0].offers->latency < 2,
+	   "Offer latency is measured from the DISCOVER");
+
+	ok(probes[1].valid_responses == 1, "Offer for a foreign hardware address is ignored");
+	ok(probes[1].responses == 2, "Both packets with the xid were seen");
+	ok(probes[1].offers->lease_time == 7200, "Second probe has its own lease");
+
+	ok(probes[2].valid_responses == 1, "Xid of another interface is ignored");
+	ok(probes[2].offers->offered_address.v4.s_addr == inet_addr("10.0.20.10"),
+	   "Third probe got the offer of its interface");
+	ok(probes[2].offers->lease_time == DHCP_INFINITE_TIME, "Infinite lease is kept");
+
+	/* nothing is answered within the timeout */
+	dhcp_probe silent = probes[2];
+	silent.offers = NULL;
+	silent.valid_responses = 0;
+	gettimeofday(&start, NULL);
+	dhcp_probe_collect(&silent, 1, 1);
+	gettimeofday(&end, NULL);
+	ok(silent.valid_responses == 0 && silent.offers == NULL, "Silent interface has no offers");
+	double waited = (double)(end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1.0e6;
+	ok(waited > 0.9 && waited < 2, "Collection stops at the timeout");
+
+	struct timeval received = probes[0].sent;
+	dhcp_packet unknown = make_offer(42, client_mac, "10.0.0.1", "10.0.0.1", 60);
+	struct in_addr source = {0};
+	ok(dhcp_probe_dispatch(probes, 3, interface_a[0], &unknown, source, received) == -1,
+	   "Unknown xid is not dispatched");
+
+	free_dhcp_offer_list(probes[0].offers);
+	free_dhcp_offer_list(probes[1].offers);
+	free_dhcp_offer_list(probes[2].offers);
+
+	/* DHCPv6 SOLICIT encoding */
+	dhcp_probe probe6 = {
+		.family = AF_INET6,
+		.interface_index = 7,
+		.xid = 0x12ABCDEF,
+	};
+	memcpy(probe6.hardware_address, client_mac, sizeof(client_mac));
+	struct in6_addr requested6;
+	inet_pton(AF_INET6, "2001:db8::50", &requested6);
+
+	unsigned char solicit[DHCP6_MAX_PACKET];
+	size_t solicit_length = dhcp6_build_solicit(solicit, &probe6, NULL);
+	ok(solicit[0] == DHCP6_SOLICIT && solicit[1] == 0xAB && solicit[2] == 0xCD &&
+		   solicit[3] == 0xEF,
+	   "SOLICIT carries a 24 bit transaction id");
+	const unsigned char expected_client_id[] = {0, DHCP6_OPTION_CLIENTID, 0, 10, 0, DHCP6_DUID_LL,
+												0, 1, 0x02, 0, 0, 0, 0, 0x01};
+	ok(memcmp(&solicit[4], expected_client_id, sizeof(expected_client_id)) == 0,
+	   "Client identifier is a link-layer DUID");
+	ok(solicit_length == 4 + 14 + 6 + 16, "SOLICIT without hint asks for one IA_NA");
+	size_t hinted_length = dhcp6_build_solicit(solicit, &probe6, &requested6);
+	ok(hinted_length == solicit_length + 28 && solicit[solicit_length] == 0 &&
+		   solicit[solicit_length + 1] == DHCP6_OPTION_IAADDR &&
+		   memcmp(&solicit[solicit_length + 4], &requested6, sizeof(requested6)) == 0,
+	   "Requested address is sent as IAADDR hint");
+
+	/* DHCPv4 and DHCPv6 on the same interface are collected in one run */
+	dhcp_probe mixed[2] = {0};
+	mixed[0] = probes[0];
+	mixed[0].offers = NULL;
+	mixed[0].responses = mixed[0].valid_responses = 0;
+	mixed[1] = probe6;
+	mixed[1].socket = interface_v6[0];
+	mixed[1].expected_offers = 1;
+	gettimeofday(&mixed[1].sent, NULL);
+
+	replay6(interface_v6[1], 0xABCDEF, other_mac, "2001:db8::99", 3600);
+	replay6(interface_v6[1], 0xABCDEF, client_mac, NULL, 0);
+	replay6(interface_v6[1], 0xABCDEF, client_mac, "2001:db8::10", 86400);
+	replay(interface_a[1], make_offer(1000, client_mac, "10.0.10.10", "10.0.0.1", 3600));
+
+	gettimeofday(&start, NULL);
+	dhcp_probe_collect(mixed, 2, 5);
+	gettimeofday(&end, NULL);
+	ok(end.tv_sec - start.tv_sec < 2, "Mixed collection ends once both probes are answered");
+	ok(mixed[0].valid_responses == 1, "DHCPv4 offer is collected next to DHCPv6");
+	ok(mixed[1].responses == 3 && mixed[1].valid_responses == 1,
+	   "ADVERTISE for another client and NoAddrsAvail are ignored");
+
+	struct in6_addr offered6;
+	inet_pton(AF_INET6, "2001:db8::10", &offered6);
+	ok(mixed[1].offers != NULL && mixed[1].offers->offered_address.family == AF_INET6 &&
+		   memcmp(&mixed[1].offers->offered_address.v6, &offered6, sizeof(offered6)) == 0,
+	   "Offered IPv6 address is decoded");
+	ok(mixed[1].offers->lease_time == 86400 && mixed[1].offers->renewal_time == 1800 &&
+		   mixed[1].offers->rebinding_time == 2880,
+	   "Valid lifetime, T1 and T2 are decoded");
+
+	dhcp_address server6 = dhcp_address_from_v6(in6addr_any);
+	dhcp_address server4 = dhcp_address_from_v4((struct in_addr){0});
+	ok(dhcp_address_equal(&mixed[1].offers->server_address, &server6) &&
+		   !dhcp_address_equal(&server6, &server4),
+	   "Addresses of different families differ");
+
+	free_dhcp_offer_list(mixed[0].offers);
+	free_dhcp_offer_list(mixed[1].offers);
+
+	return exit_status();
+}
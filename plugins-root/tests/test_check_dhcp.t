@@ -0,0 +1,6 @@
+#!/usr/bin/perl
+use Test::More;
+if (! -e "./test_check_dhcp") {
+	plan skip_all => "./test_check_dhcp not compiled - please enable libtap library to test";
+}
+exec "./test_check_dhcp";
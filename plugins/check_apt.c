@@ -57,6 +57,11 @@ const char *PKGINST_PREFIX = "Inst ";
 /* the RE that catches security updates */
 const char *SECURITY_RE = "^[^\\(]*\\(.* (Debian-Security:|Ubuntu:[^/]*/[^-]*-security)";
 
+/* the cached result of --index is "FINGERPRINT PACKAGES SECURITY NAMES" */
+#define APT_INDEX_STATE_VERSION 1
+/* a state file line holds at most 8192 bytes, longer package lists are not cached */
+#define APT_INDEX_CACHE_MAX 8000
+
 /* some standard functions */
 typedef struct {
 	int errorcode;
@@ -91,6 +96,15 @@ run_upgrade_result run_upgrade(upgrade_type upgrade, const char *do_include, con
 							   const char *do_critical, const char *upgrade_opts,
 							   const char *input_filename);
 
+/* count the upgrades from the dpkg status and the apt lists */
+static run_upgrade_result run_index(check_apt_config config, int argc, char **argv);
+static bool read_index_cache(state_key key, const char *fingerprint, bool need_list,
+							 run_upgrade_result result[static 1]);
+static void write_index_cache(state_key key, const char *fingerprint,
+							  run_upgrade_result result[static 1]);
+
+/* compile a regexp or die */
+static void compile_regexp(regex_t *regex, const char *expression);
 /* add another clause to a regexp */
 static char *add_to_regexp(char * /*expr*/, const char * /*next*/);
 /* extract package name from Inst line */
@@ -137,16 +151,28 @@ int main(int argc, char **argv) {
 		mp_add_subcheck_to_check(&overall, update_result.sc);
 	}
 
-	/* apt-get upgrade */
-	run_upgrade_result upgrad_res =
-		run_upgrade(config.upgrade, config.do_include, config.do_exclude, config.do_critical,
-					config.upgrade_opts, config.input_filename);
-
 	mp_subcheck sc_run_upgrade = mp_subcheck_init();
-	if (upgrad_res.errorcode == OK) {
-		sc_run_upgrade = mp_set_subcheck_state(sc_run_upgrade, STATE_OK);
+	run_upgrade_result upgrad_res;
+	if (config.use_index) {
+		upgrad_res = run_index(config, argc, argv);
+		if (upgrad_res.errorcode == OK) {
+			sc_run_upgrade = mp_set_subcheck_state(sc_run_upgrade, STATE_OK);
+			xasprintf(&sc_run_upgrade.output, "Read %s and the indexes in %s",
+					  config.dpkg_status, config.lists_dir);
+		} else {
+			sc_run_upgrade = mp_set_subcheck_state(sc_run_upgrade, STATE_UNKNOWN);
+			xasprintf(&sc_run_upgrade.output, "Could not read %s or %s", config.dpkg_status,
+					  config.lists_dir);
+		}
+	} else {
+		/* apt-get upgrade */
+		upgrad_res = run_upgrade(config.upgrade, config.do_include, config.do_exclude,
+								 config.do_critical, config.upgrade_opts, config.input_filename);
+		if (upgrad_res.errorcode == OK) {
+			sc_run_upgrade = mp_set_subcheck_state(sc_run_upgrade, STATE_OK);
+		}
+		xasprintf(&sc_run_upgrade.output, "Executed apt upgrade (dry run)");
 	}
-	xasprintf(&sc_run_upgrade.output, "Executed apt upgrade (dry run)");
 
 	mp_add_subcheck_to_check(&overall, sc_run_upgrade);
 
@@ -222,6 +248,10 @@ check_apt_config_wrapper process_arguments(int argc, char **argv) {
 		/* Character for hidden input file option (for testing). */
 		INPUT_FILE_OPT = CHAR_MAX + 1,
 		output_format_index,
+		INDEX_OPT,
+		DPKG_STATUS_OPT,
+		LISTS_DIR_OPT,
+		NO_CACHE_OPT,
 	};
 	static struct option longopts[] = {{"version", no_argument, 0, 'V'},
 									   {"help", no_argument, 0, 'h'},
@@ -239,6 +269,10 @@ check_apt_config_wrapper process_arguments(int argc, char **argv) {
 									   {"input-file", required_argument, 0, INPUT_FILE_OPT},
 									   {"packages-warning", required_argument, 0, 'w'},
 									   {"output-format", required_argument, 0, output_format_index},
+									   {"index", no_argument, 0, INDEX_OPT},
+									   {"dpkg-status", required_argument, 0, DPKG_STATUS_OPT},
+									   {"lists-dir", required_argument, 0, LISTS_DIR_OPT},
+									   {"no-cache", no_argument, 0, NO_CACHE_OPT},
 									   {0, 0, 0, 0}};
 
 	check_apt_config_wrapper result = {
@@ -317,6 +351,20 @@ check_apt_config_wrapper process_arguments(int argc, char **argv) {
 		case 'w':
 			result.config.packages_warning = atoi(optarg);
 			break;
+		case INDEX_OPT:
+			result.config.use_index = true;
+			break;
+		case DPKG_STATUS_OPT:
+			result.config.use_index = true;
+			result.config.dpkg_status = optarg;
+			break;
+		case LISTS_DIR_OPT:
+			result.config.use_index = true;
+			result.config.lists_dir = optarg;
+			break;
+		case NO_CACHE_OPT:
+			result.config.use_cache = false;
+			break;
 		case output_format_index: {
 			parsed_output_format parser = mp_parse_output_format(optarg);
 			if (!parser.parsing_success) {
@@ -355,33 +403,18 @@ run_upgrade_result run_upgrade(const upgrade_type upgrade, const char *do_includ
 		return result;
 	}
 
-	int regres = 0;
 	regex_t include_regex;
-	char rerrbuf[64];
 	/* compile the regexps */
 	if (do_include != NULL) {
-		regres = regcomp(&include_regex, do_include, REG_EXTENDED);
-		if (regres != 0) {
-			regerror(regres, &include_regex, rerrbuf, 64);
-			die(STATE_UNKNOWN, _("%s: Error compiling regexp: %s"), progname, rerrbuf);
-		}
+		compile_regexp(&include_regex, do_include);
 	}
 
 	if (do_exclude != NULL) {
-		regres = regcomp(&exclude_regex, do_exclude, REG_EXTENDED);
-		if (regres != 0) {
-			regerror(regres, &exclude_regex, rerrbuf, 64);
-			die(STATE_UNKNOWN, _("%s: Error compiling regexp: %s"), progname, rerrbuf);
-		}
+		compile_regexp(&exclude_regex, do_exclude);
 	}
 
 	regex_t sreg;
-	const char *crit_ptr = (do_critical != NULL) ? do_critical : SECURITY_RE;
-	regres = regcomp(&sreg, crit_ptr, REG_EXTENDED);
-	if (regres != 0) {
-		regerror(regres, &exclude_regex, rerrbuf, 64);
-		die(STATE_UNKNOWN, _("%s: Error compiling regexp: %s"), progname, rerrbuf);
-	}
+	compile_regexp(&sreg, (do_critical != NULL) ? do_critical : SECURITY_RE);
 
 	output chld_out;
 	output chld_err;
@@ -486,6 +519,218 @@ run_upgrade_result run_upgrade(const upgrade_type upgrade, const char *do_includ
 	return result;
 }
 
+/* count the upgrades without apt-get, the result is cached until dpkg or apt change their files */
+run_upgrade_result run_index(const check_apt_config config, int argc, char **argv) {
+	run_upgrade_result result = {
+		.errorcode = OK,
+	};
+
+	if (config.upgrade == NO_UPGRADE) {
+		return result;
+	}
+
+	char *fingerprint = apt_index_fingerprint(config.dpkg_status, config.lists_dir);
+	if (fingerprint == NULL) {
+		result.errorcode = ERROR;
+		return result;
+	}
+
+	state_key key = np_enable_state(NULL, APT_INDEX_STATE_VERSION, progname, argc, argv);
+	if (config.use_cache && read_index_cache(key, fingerprint, config.list, &result)) {
+		if (verbose) {
+			printf("Using the cached result for the index files %s\n", fingerprint);
+		}
+		free(fingerprint);
+		return result;
+	}
+
+	apt_index_result index = apt_index_upgradable(config.dpkg_status, config.lists_dir);
+	if (index.errorcode != OK) {
+		free(fingerprint);
+		result.errorcode = ERROR;
+		return result;
+	}
+
+	regex_t include_regex;
+	regex_t exclude_regex;
+	regex_t critical_regex;
+	if (config.do_include != NULL) {
+		compile_regexp(&include_regex, config.do_include);
+	}
+	if (config.do_exclude != NULL) {
+		compile_regexp(&exclude_regex, config.do_exclude);
+	}
+	/* without -c the security suites are recognised by the names of their indexes */
+	if (config.do_critical != NULL) {
+		compile_regexp(&critical_regex, config.do_critical);
+	}
+
+	result.packages_list = calloc(index.count + 1, sizeof(char *));
+	result.secpackages_list = calloc(index.count + 1, sizeof(char *));
+	if (result.packages_list == NULL || result.secpackages_list == NULL) {
+		die(STATE_UNKNOWN, "calloc failed!\n");
+	}
+
+	for (size_t i = 0; i < index.count; i++) {
+		const apt_upgradable *package = &index.packages[i];
+
+		/* the same form as the apt-get output, so -i, -e and -c work in both modes */
+		char *line = NULL;
+		xasprintf(&line, "%s%s [%s] (%s %s [%s])", PKGINST_PREFIX, package->name,
+				  package->installed_version, package->candidate_version, package->origin,
+				  package->architecture);
+		if (verbose) {
+			printf("%s\n", line);
+		}
+
+		if ((config.do_include != NULL && regexec(&include_regex, line, 0, NULL, 0) != 0) ||
+			(config.do_exclude != NULL && regexec(&exclude_regex, line, 0, NULL, 0) == 0)) {
+			free(line);
+			continue;
+		}
+
+		bool critical = (config.do_critical != NULL)
+							? regexec(&critical_regex, line, 0, NULL, 0) == 0
+							: package->security;
+		if (critical) {
+			result.secpackages_list[result.security_package_count++] = pkg_name(line);
+		} else {
+			result.packages_list[result.package_count - result.security_package_count] =
+				pkg_name(line);
+		}
+		result.package_count++;
+		free(line);
+	}
+
+	if (config.do_include != NULL) {
+		regfree(&include_regex);
+	}
+	if (config.do_exclude != NULL) {
+		regfree(&exclude_regex);
+	}
+	if (config.do_critical != NULL) {
+		regfree(&critical_regex);
+	}
+	apt_index_free(&index);
+
+	if (config.use_cache) {
+		write_index_cache(key, fingerprint, &result);
+	}
+	free(fingerprint);
+
+	return result;
+}
+
+/*
+ * The names follow the counts, separated by commas with the critical ones
+ * marked by a leading '!'; "-" stands for no packages and "?" for a list too
+ * long for the state file
+ */
+bool read_index_cache(state_key key, const char *fingerprint, bool need_list,
+					  run_upgrade_result result[static 1]) {
+	state_data *cached = np_state_read(key);
+	if (cached == NULL || cached->errorcode != OK) {
+		return false;
+	}
+
+	char cached_fingerprint[32];
+	size_t package_count = 0;
+	size_t security_package_count = 0;
+	int names_offset = 0;
+	if (sscanf(cached->data, "%31s %zu %zu %n", cached_fingerprint, &package_count,
+			   &security_package_count, &names_offset) != 3 ||
+		names_offset == 0 || strcmp(cached_fingerprint, fingerprint) != 0 ||
+		security_package_count > package_count) {
+		return false;
+	}
+
+	const char *names = (const char *)cached->data + names_offset;
+	if (strcmp(names, "?") == 0) {
+		if (need_list) {
+			return false;
+		}
+		result->package_count = package_count;
+		result->security_package_count = security_package_count;
+		return true;
+	}
+
+	char **packages_list = calloc(package_count + 1, sizeof(char *));
+	char **secpackages_list = calloc(package_count + 1, sizeof(char *));
+	if (packages_list == NULL || secpackages_list == NULL) {
+		die(STATE_UNKNOWN, "calloc failed!\n");
+	}
+
+	size_t packages = 0;
+	size_t security_packages = 0;
+	char *copy = strdup(names);
+	char *saveptr = NULL;
+	for (char *name = strtok_r(copy, ",", &saveptr); name != NULL && strcmp(name, "-") != 0;
+		 name = strtok_r(NULL, ",", &saveptr)) {
+		if (packages == package_count) {
+			packages++;
+			break;
+		}
+		if (name[0] == '!') {
+			if (security_packages == security_package_count) {
+				break;
+			}
+			secpackages_list[security_packages++] = strdup(name + 1);
+		} else {
+			packages_list[packages - security_packages] = strdup(name);
+		}
+		packages++;
+	}
+	free(copy);
+
+	if (packages != package_count || security_packages != security_package_count) {
+		for (size_t i = 0; i <= package_count; i++) {
+			free(packages_list[i]);
+			free(secpackages_list[i]);
+		}
+		free(packages_list);
+		free(secpackages_list);
+		return false;
+	}
+
+	result->package_count = package_count;
+	result->security_package_count = security_package_count;
+	result->packages_list = packages_list;
+	result->secpackages_list = secpackages_list;
+	return true;
+}
+
+void write_index_cache(state_key key, const char *fingerprint,
+					   run_upgrade_result result[static 1]) {
+	char *names = NULL;
+	size_t other_count = result->package_count - result->security_package_count;
+	for (size_t i = 0; i < result->security_package_count; i++) {
+		char *joined = NULL;
+		xasprintf(&joined, "%s%s!%s", names ? names : "", names ? "," : "",
+				  result->secpackages_list[i]);
+		free(names);
+		names = joined;
+	}
+	for (size_t i = 0; i < other_count; i++) {
+		char *joined = NULL;
+		xasprintf(&joined, "%s%s%s", names ? names : "", names ? "," : "",
+				  result->packages_list[i]);
+		free(names);
+		names = joined;
+	}
+
+	const char *cached_names = "-";
+	if (names != NULL) {
+		cached_names = strlen(names) < APT_INDEX_CACHE_MAX ? names : "?";
+	}
+
+	char *state_string = NULL;
+	xasprintf(&state_string, "%s %zu %zu %s", fingerprint, result->package_count,
+			  result->security_package_count, cached_names);
+	np_state_write_string(key, time(NULL), state_string);
+	free(state_string);
+	free(names);
+}
+
 /* run an apt-get update (needs root) */
 run_update_result run_update(char *update_opts) {
 	char *cmdline;
@@ -557,6 +802,15 @@ char *pkg_name(char *line) {
 	return pkg;
 }
 
+void compile_regexp(regex_t *regex, const char *expression) {
+	int regres = regcomp(regex, expression, REG_EXTENDED);
+	if (regres != 0) {
+		char rerrbuf[64];
+		regerror(regres, regex, rerrbuf, sizeof(rerrbuf));
+		die(STATE_UNKNOWN, _("%s: Error compiling regexp: %s"), progname, rerrbuf);
+	}
+}
+
 int cmpstringp(const void *left_string, const void *right_string) {
 	return strcmp(*(char *const *)left_string, *(char *const *)right_string);
 }
@@ -678,7 +932,21 @@ void print_help(void) {
 	printf(" %s\n", "-w, --packages-warning");
 	printf("    %s\n",
 		   _("Minimum number of packages available for upgrade to return WARNING status."));
-	printf("    %s\n\n", _("Default is 1 package."));
+	printf("    %s\n", _("Default is 1 package."));
+	printf(" %s\n", "--index");
+	printf("    %s\n", _("Do not run apt-get, compare the versions in the dpkg status with"));
+	printf("    %s\n", _("the package indexes of apt instead.  Pin priorities, compressed"));
+	printf("    %s\n", _("indexes and the dependencies a dist-upgrade would add are not taken"));
+	printf("    %s\n", _("into account.  Without -c, packages from a *-security suite are"));
+	printf("    %s\n", _("critical.  The result is kept until dpkg or apt change their files."));
+	printf(" %s\n", "--dpkg-status=FILE");
+	printf("    %s\n", _("The dpkg status file, implies --index."));
+	printf("    %s %s\n", _("Default is"), APT_DPKG_STATUS);
+	printf(" %s\n", "--lists-dir=DIR");
+	printf("    %s\n", _("The directory with the apt lists, implies --index."));
+	printf("    %s %s\n", _("Default is"), APT_LISTS_DIR);
+	printf(" %s\n", "--no-cache");
+	printf("    %s\n\n", _("Always read the index files with --index."));
 
 	printf(UT_OUTPUT_FORMAT);
 
@@ -710,4 +978,5 @@ void print_help(void) {
 void print_usage(void) {
 	printf("%s\n", _("Usage:"));
 	printf("%s [[-d|-u|-U]opts] [-n] [-l] [-t timeout] [-w packages-warning]\n", progname);
+	printf("  [--index [--dpkg-status=FILE] [--lists-dir=DIR] [--no-cache]]\n");
 }
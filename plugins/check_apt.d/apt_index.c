@@ -0,0 +1,553 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./apt_index.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define APT_INDEX_SUFFIX "_Packages"
+
+typedef struct {
+	const char *data;
+	size_t length;
+} apt_string;
+
+typedef struct {
+	apt_string package;
+	apt_string version;
+	apt_string architecture;
+	apt_string status;
+} apt_stanza;
+
+typedef struct {
+	void *data;
+	size_t length;
+} apt_mapping;
+
+/* an installed package and the best candidate found so far */
+typedef struct {
+	bool used;
+	apt_string name;
+	apt_string architecture;
+	apt_string installed;
+	apt_string candidate;
+	const char *origin;
+	bool security;
+} apt_package;
+
+typedef struct {
+	apt_package *slots;
+	size_t size;
+	size_t count;
+} apt_package_table;
+
+static bool apt_string_equal(apt_string left, apt_string right) {
+	return left.length == right.length && memcmp(left.data, right.data, left.length) == 0;
+}
+
+static char *apt_string_dup(apt_string string) {
+	char *result = strndup(string.data, string.length);
+	if (result == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the package list\n"));
+	}
+	return result;
+}
+
+/*
+ * Version comparison, the algorithm of dpkg: non-digit parts are compared
+ * character by character with letters before everything else but '~', which
+ * sorts even before the end of the string; digit parts are compared numerically
+ */
+static int apt_version_order(const char *character, const char *end) {
+	if (character >= end || isdigit((unsigned char)*character)) {
+		return 0;
+	}
+	if (isalpha((unsigned char)*character)) {
+		return *character;
+	}
+	if (*character == '~') {
+		return -1;
+	}
+	return *character + 256;
+}
+
+static int apt_version_part_compare(const char *left, const char *left_end, const char *right,
+									const char *right_end) {
+	while (left < left_end || right < right_end) {
+		while ((left < left_end && !isdigit((unsigned char)*left)) ||
+			   (right < right_end && !isdigit((unsigned char)*right))) {
+			int left_order = apt_version_order(left, left_end);
+			int right_order = apt_version_order(right, right_end);
+			if (left_order != right_order) {
+				return left_order - right_order;
+			}
+			left += (left < left_end);
+			right += (right < right_end);
+		}
+
+		while (left < left_end && *left == '0') {
+			left++;
+		}
+		while (right < right_end && *right == '0') {
+			right++;
+		}
+
+		int first_difference = 0;
+		while (left < left_end && isdigit((unsigned char)*left) && right < right_end &&
+			   isdigit((unsigned char)*right)) {
+			if (first_difference == 0) {
+				first_difference = *left - *right;
+			}
+			left++;
+			right++;
+		}
+		if (left < left_end && isdigit((unsigned char)*left)) {
+			return 1;
+		}
+		if (right < right_end && isdigit((unsigned char)*right)) {
+			return -1;
+		}
+		if (first_difference != 0) {
+			return first_difference;
+		}
+	}
+	return 0;
+}
+
+typedef struct {
+	unsigned long epoch;
+	const char *upstream;
+	const char *upstream_end;
+	const char *revision;
+	const char *revision_end;
+} apt_version;
+
+static apt_version apt_version_split(const char *version, size_t length) {
+	const char *end = version + length;
+	apt_version result = {
+		.epoch = 0,
+		.upstream = version,
+		.upstream_end = end,
+		.revision = end,
+		.revision_end = end,
+	};
+
+	const char *colon = memchr(version, ':', length);
+	if (colon != NULL) {
+		for (const char *digit = version; digit < colon; digit++) {
+			result.epoch = result.epoch * 10 + (unsigned long)(*digit - '0');
+		}
+		result.upstream = colon + 1;
+	}
+
+	for (const char *dash = end; dash > result.upstream; dash--) {
+		if (dash[-1] == '-') {
+			result.upstream_end = dash - 1;
+			result.revision = dash;
+			break;
+		}
+	}
+	return result;
+}
+
+int apt_version_compare(const char *left, size_t left_length, const char *right,
+						size_t right_length) {
+	apt_version left_version = apt_version_split(left, left_length);
+	apt_version right_version = apt_version_split(right, right_length);
+
+	if (left_version.epoch != right_version.epoch) {
+		return left_version.epoch > right_version.epoch ? 1 : -1;
+	}
+	int result = apt_version_part_compare(left_version.upstream, left_version.upstream_end,
+										  right_version.upstream, right_version.upstream_end);
+	if (result != 0) {
+		return result;
+	}
+	return apt_version_part_compare(left_version.revision, left_version.revision_end,
+									right_version.revision, right_version.revision_end);
+}
+
+static bool apt_map_file(const char *path, apt_mapping mapping[static 1]) {
+	int file = open(path, O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+
+	struct stat file_stat;
+	if (fstat(file, &file_stat) != 0) {
+		close(file);
+		return false;
+	}
+
+	mapping->length = (size_t)file_stat.st_size;
+	mapping->data = NULL;
+	if (mapping->length > 0) {
+		mapping->data = mmap(NULL, mapping->length, PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapping->data == MAP_FAILED) {
+			close(file);
+			return false;
+		}
+#ifdef MADV_SEQUENTIAL
+		madvise(mapping->data, mapping->length, MADV_SEQUENTIAL);
+#endif
+	}
+	close(file);
+	return true;
+}
+
+static void apt_unmap_file(apt_mapping mapping[static 1]) {
+	if (mapping->data != NULL) {
+		munmap(mapping->data, mapping->length);
+	}
+	mapping->data = NULL;
+}
+
+static apt_string apt_field_value(const char *line, const char *line_end, size_t key_length) {
+	const char *value = line + key_length + 1;
+	while (value < line_end && (*value == ' ' || *value == '\t')) {
+		value++;
+	}
+	const char *value_end = line_end;
+	while (value_end > value && isspace((unsigned char)value_end[-1])) {
+		value_end--;
+	}
+	apt_string result = {value, (size_t)(value_end - value)};
+	return result;
+}
+
+/*
+ * Walks the RFC822 style stanzas of a dpkg status file or a Packages index
+ * and hands the fields a check needs to handle(), continuation lines and
+ * all the other fields are skipped
+ */
+static void apt_parse_stanzas(const char *data, size_t length,
+							  void (*handle)(const apt_stanza *, void *), void *context) {
+	static const apt_string empty = {"", 0};
+	apt_stanza stanza = {empty, empty, empty, empty};
+	bool in_stanza = false;
+
+	const char *end = data + length;
+	const char *line = data;
+	while (line < end) {
+		const char *line_end = memchr(line, '\n', (size_t)(end - line));
+		if (line_end == NULL) {
+			line_end = end;
+		}
+
+		if (line == line_end || (line_end - line == 1 && *line == '\r')) {
+			if (in_stanza) {
+				handle(&stanza, context);
+			}
+			stanza = (apt_stanza){empty, empty, empty, empty};
+			in_stanza = false;
+		} else if (*line != ' ' && *line != '\t') {
+			in_stanza = true;
+			size_t line_length = (size_t)(line_end - line);
+			const char *colon = memchr(line, ':', line_length);
+			size_t key_length = colon != NULL ? (size_t)(colon - line) : 0;
+
+			if (key_length == 7 && strncmp(line, "Package", 7) == 0) {
+				stanza.package = apt_field_value(line, line_end, key_length);
+			} else if (key_length == 7 && strncmp(line, "Version", 7) == 0) {
+				stanza.version = apt_field_value(line, line_end, key_length);
+			} else if (key_length == 12 && strncmp(line, "Architecture", 12) == 0) {
+				stanza.architecture = apt_field_value(line, line_end, key_length);
+			} else if (key_length == 6 && strncmp(line, "Status", 6) == 0) {
+				stanza.status = apt_field_value(line, line_end, key_length);
+			}
+		}
+
+		line = line_end + 1;
+	}
+
+	if (in_stanza) {
+		handle(&stanza, context);
+	}
+}
+
+static uint64_t apt_hash(const char *data, size_t length, uint64_t hash) {
+	/* FNV-1a */
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+#define APT_HASH_INIT 0xcbf29ce484222325ULL
+
+static uint64_t apt_package_hash(apt_string name, apt_string architecture) {
+	uint64_t hash = apt_hash(name.data, name.length, APT_HASH_INIT);
+	return apt_hash(architecture.data, architecture.length, hash ^ ':');
+}
+
+static apt_package *apt_table_lookup(apt_package_table table[static 1], apt_string name,
+									 apt_string architecture) {
+	size_t mask = table->size - 1;
+	for (size_t i = apt_package_hash(name, architecture) & mask;; i = (i + 1) & mask) {
+		apt_package *slot = &table->slots[i];
+		if (!slot->used || (apt_string_equal(slot->name, name) &&
+							apt_string_equal(slot->architecture, architecture))) {
+			return slot;
+		}
+	}
+}
+
+static void apt_table_grow(apt_package_table table[static 1]) {
+	apt_package_table bigger = {
+		.size = table->size == 0 ? 1024 : table->size * 2,
+		.count = table->count,
+	};
+	bigger.slots = calloc(bigger.size, sizeof(apt_package));
+	if (bigger.slots == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the package table\n"));
+	}
+
+	for (size_t i = 0; i < table->size; i++) {
+		if (table->slots[i].used) {
+			*apt_table_lookup(&bigger, table->slots[i].name, table->slots[i].architecture) =
+				table->slots[i];
+		}
+	}
+	free(table->slots);
+	*table = bigger;
+}
+
+static void apt_handle_installed(const apt_stanza *stanza, void *context) {
+	apt_package_table *table = context;
+
+	/* "want flag status", only packages which are completely installed can be upgraded */
+	const char *status_end = stanza->status.data + stanza->status.length;
+	if (stanza->package.length == 0 || stanza->version.length == 0 ||
+		stanza->status.length < 12 || memcmp(status_end - 12, "ok installed", 12) != 0) {
+		return;
+	}
+
+	/* keep the load factor below one half */
+	if ((table->count + 1) * 2 > table->size) {
+		apt_table_grow(table);
+	}
+
+	apt_package *slot = apt_table_lookup(table, stanza->package, stanza->architecture);
+	if (!slot->used) {
+		slot->used = true;
+		slot->name = stanza->package;
+		slot->architecture = stanza->architecture;
+		slot->installed = stanza->version;
+		table->count++;
+	}
+}
+
+typedef struct {
+	apt_package_table *table;
+	const char *origin;
+	bool security;
+} apt_index_context;
+
+static void apt_handle_available(const apt_stanza *stanza, void *context) {
+	apt_index_context *index = context;
+	if (stanza->package.length == 0 || stanza->version.length == 0 || index->table->size == 0) {
+		return;
+	}
+
+	apt_package *slot = apt_table_lookup(index->table, stanza->package, stanza->architecture);
+	if (!slot->used) {
+		return;
+	}
+
+	apt_string best = slot->candidate.length > 0 ? slot->candidate : slot->installed;
+	int comparison =
+		apt_version_compare(stanza->version.data, stanza->version.length, best.data, best.length);
+	if (comparison > 0) {
+		slot->candidate = stanza->version;
+		slot->origin = index->origin;
+		slot->security = index->security;
+	} else if (comparison == 0 && slot->candidate.length > 0 && index->security) {
+		/* the same version is often in the security and the updates suite */
+		slot->security = true;
+		slot->origin = index->origin;
+	}
+}
+
+static bool apt_is_index(const char *name) {
+	size_t length = strlen(name);
+	size_t suffix_length = strlen(APT_INDEX_SUFFIX);
+	return length > suffix_length &&
+		   strcmp(name + length - suffix_length, APT_INDEX_SUFFIX) == 0;
+}
+
+/* e.g. deb.debian.org_debian-security_dists_bookworm-security_main_binary-amd64_Packages */
+static bool apt_is_security_index(const char *name) { return strstr(name, "-security_") != NULL; }
+
+static int apt_compare_upgradable(const void *left, const void *right) {
+	const apt_upgradable *left_package = left;
+	const apt_upgradable *right_package = right;
+	int result = strcmp(left_package->name, right_package->name);
+	return result != 0 ? result
+					   : strcmp(left_package->architecture, right_package->architecture);
+}
+
+apt_index_result apt_index_upgradable(const char *dpkg_status, const char *lists_dir) {
+	apt_index_result result = {
+		.errorcode = OK,
+		.packages = NULL,
+		.count = 0,
+	};
+
+	apt_mapping status_mapping;
+	if (!apt_map_file(dpkg_status, &status_mapping)) {
+		result.errorcode = ERROR;
+		return result;
+	}
+
+	apt_package_table table = {NULL, 0, 0};
+	apt_parse_stanzas(status_mapping.data, status_mapping.length, apt_handle_installed, &table);
+
+	DIR *lists = opendir(lists_dir);
+	if (lists == NULL) {
+		apt_unmap_file(&status_mapping);
+		free(table.slots);
+		result.errorcode = ERROR;
+		return result;
+	}
+
+	/* the candidates point into the indexes, so they stay mapped until the end */
+	apt_mapping *index_mappings = NULL;
+	char **index_names = NULL;
+	size_t index_count = 0;
+
+	struct dirent *entry;
+	while ((entry = readdir(lists)) != NULL) {
+		if (!apt_is_index(entry->d_name)) {
+			continue;
+		}
+
+		char *path = NULL;
+		xasprintf(&path, "%s/%s", lists_dir, entry->d_name);
+		apt_mapping mapping;
+		bool mapped = apt_map_file(path, &mapping);
+		free(path);
+		if (!mapped) {
+			continue;
+		}
+
+		index_mappings = realloc(index_mappings, (index_count + 1) * sizeof(apt_mapping));
+		index_names = realloc(index_names, (index_count + 1) * sizeof(char *));
+		if (index_mappings == NULL || index_names == NULL) {
+			die(STATE_UNKNOWN, _("Could not allocate memory for the package indexes\n"));
+		}
+		index_mappings[index_count] = mapping;
+		index_names[index_count] = strdup(entry->d_name);
+
+		apt_index_context context = {
+			.table = &table,
+			.origin = index_names[index_count],
+			.security = apt_is_security_index(entry->d_name),
+		};
+		apt_parse_stanzas(mapping.data, mapping.length, apt_handle_available, &context);
+		index_count++;
+	}
+	closedir(lists);
+
+	for (size_t i = 0; i < table.size; i++) {
+		if (table.slots[i].used && table.slots[i].candidate.length > 0) {
+			result.count++;
+		}
+	}
+
+	if (result.count > 0) {
+		result.packages = calloc(result.count, sizeof(apt_upgradable));
+		if (result.packages == NULL) {
+			die(STATE_UNKNOWN, _("Could not allocate memory for the package list\n"));
+		}
+	}
+
+	size_t position = 0;
+	for (size_t i = 0; i < table.size; i++) {
+		apt_package *slot = &table.slots[i];
+		if (!slot->used || slot->candidate.length == 0) {
+			continue;
+		}
+		result.packages[position++] = (apt_upgradable){
+			.name = apt_string_dup(slot->name),
+			.architecture = apt_string_dup(slot->architecture),
+			.installed_version = apt_string_dup(slot->installed),
+			.candidate_version = apt_string_dup(slot->candidate),
+			.origin = strdup(slot->origin),
+			.security = slot->security,
+		};
+	}
+	if (result.count > 1) {
+		qsort(result.packages, result.count, sizeof(apt_upgradable), apt_compare_upgradable);
+	}
+
+	for (size_t i = 0; i < index_count; i++) {
+		apt_unmap_file(&index_mappings[i]);
+		free(index_names[i]);
+	}
+	free(index_mappings);
+	free(index_names);
+	free(table.slots);
+	apt_unmap_file(&status_mapping);
+
+	return result;
+}
+
+void apt_index_free(apt_index_result result[static 1]) {
+	for (size_t i = 0; i < result->count; i++) {
+		free(result->packages[i].name);
+		free(result->packages[i].architecture);
+		free(result->packages[i].installed_version);
+		free(result->packages[i].candidate_version);
+		free(result->packages[i].origin);
+	}
+	free(result->packages);
+	result->packages = NULL;
+	result->count = 0;
+}
+
+static uint64_t apt_stat_hash(const char *name, const struct stat *file_stat) {
+	uint64_t hash = apt_hash(name, strlen(name), APT_HASH_INIT);
+	hash = apt_hash((const char *)&file_stat->st_size, sizeof(file_stat->st_size), hash);
+	hash = apt_hash((const char *)&file_stat->st_mtim.tv_sec, sizeof(file_stat->st_mtim.tv_sec),
+					hash);
+	return apt_hash((const char *)&file_stat->st_mtim.tv_nsec,
+					sizeof(file_stat->st_mtim.tv_nsec), hash);
+}
+
+char *apt_index_fingerprint(const char *dpkg_status, const char *lists_dir) {
+	struct stat file_stat;
+	if (stat(dpkg_status, &file_stat) != 0) {
+		return NULL;
+	}
+	uint64_t fingerprint = apt_stat_hash(dpkg_status, &file_stat);
+
+	/* adding or removing an index changes the directory itself */
+	if (stat(lists_dir, &file_stat) == 0) {
+		fingerprint ^= apt_stat_hash(lists_dir, &file_stat);
+	}
+
+	DIR *lists = opendir(lists_dir);
+	if (lists != NULL) {
+		/* readdir() gives no order, so the hashes of the files are combined order independent */
+		struct dirent *entry;
+		while ((entry = readdir(lists)) != NULL) {
+			if (!apt_is_index(entry->d_name) ||
+				fstatat(dirfd(lists), entry->d_name, &file_stat, 0) != 0) {
+				continue;
+			}
+			fingerprint += apt_stat_hash(entry->d_name, &file_stat);
+		}
+		closedir(lists);
+	}
+
+	char *result = NULL;
+	xasprintf(&result, "%016llx", (unsigned long long)fingerprint);
+	return result;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define APT_DPKG_STATUS "/var/lib/dpkg/status"
+#define APT_LISTS_DIR   "/var/lib/apt/lists"
+
+/* a package with a newer version in one of the indexes than the installed one */
+typedef struct {
+	char *name;
+	char *architecture;
+	char *installed_version;
+	char *candidate_version;
+	char *origin; /* the index file the candidate comes from */
+	bool security;
+} apt_upgradable;
+
+typedef struct {
+	int errorcode;
+	apt_upgradable *packages;
+	size_t count;
+} apt_index_result;
+
+/*
+ * Compares two Debian version strings ([epoch:]upstream[-revision]) like
+ * dpkg --compare-versions, the result is <0, 0 or >0
+ */
+int apt_version_compare(const char *left, size_t left_length, const char *right,
+						size_t right_length);
+
+/*
+ * Reads the installed packages from dpkg_status and the available ones from
+ * the *_Packages indexes in lists_dir. Every file is mapped and walked once.
+ * Pin priorities and compressed indexes are not taken into account.
+ */
+apt_index_result apt_index_upgradable(const char *dpkg_status, const char *lists_dir);
+void apt_index_free(apt_index_result result[static 1]);
+
+/*
+ * A hash of the sizes and modification times of dpkg_status, lists_dir and
+ * its indexes, it changes whenever apt or dpkg touch their metadata.
+ * Returns NULL if dpkg_status can not be read.
+ */
+char *apt_index_fingerprint(const char *dpkg_status, const char *lists_dir);
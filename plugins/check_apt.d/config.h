@@ -3,6 +3,7 @@
 #include "../../config.h"
 #include <stddef.h>
 #include "../lib/output.h"
+#include "./apt_index.h"
 
 /* some constants */
 typedef enum {
@@ -26,6 +27,12 @@ typedef struct {
 	char *do_critical;    /* regexp specifying critical packages */
 	char *input_filename; /* input filename for testing */
 
+	/* read the dpkg status and the apt lists instead of running apt-get */
+	bool use_index;
+	bool use_cache; /* reuse the last result while the index files are unchanged */
+	char *dpkg_status;
+	char *lists_dir;
+
 	bool output_format_is_set;
 	mp_output_format output_format;
 } check_apt_config;
@@ -41,6 +48,10 @@ check_apt_config check_apt_config_init() {
 							.do_exclude = NULL,
 							.do_critical = NULL,
 							.input_filename = NULL,
+							.use_index = false,
+							.use_cache = true,
+							.dpkg_status = APT_DPKG_STATUS,
+							.lists_dir = APT_LISTS_DIR,
 							.output_format_is_set = false};
 	return tmp;
 }
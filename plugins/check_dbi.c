@@ -47,6 +47,10 @@ const char *email = "devel@monitoring-plugins.org";
 
 #include "regex.h"
 
+#ifdef NP_EXTRA_OPTS
+#	include "parse_ini.h"
+#endif
+
 /* required for NAN */
 #ifndef _ISOC99_SOURCE
 #	define _ISOC99_SOURCE
@@ -85,6 +89,9 @@ typedef struct {
 static do_query_result do_query(dbi_conn conn, check_dbi_metric metric, check_dbi_type type,
 								char *query);
 
+static void add_batch_entry(check_dbi_config * /*config*/, char * /*label*/, char * /*spec*/);
+static mp_subcheck evaluate_batch_entry(dbi_conn /*conn*/, check_dbi_batch_entry /*entry*/);
+
 int main(int argc, char **argv) {
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -421,6 +428,11 @@ int main(int argc, char **argv) {
 		mp_add_subcheck_to_check(&overall, sc_query);
 	}
 
+	/* the batch queries share the connection, subchecks are prepended so go backwards */
+	for (size_t i = config.batch_num; i > 0; i--) {
+		mp_add_subcheck_to_check(&overall, evaluate_batch_entry(conn, config.batch[i - 1]));
+	}
+
 	if (verbose) {
 		printf("Closing connection\n");
 	}
@@ -433,6 +445,8 @@ int main(int argc, char **argv) {
 check_dbi_config_wrapper process_arguments(int argc, char **argv) {
 	enum {
 		output_format_index = CHAR_MAX + 1,
+		batch_query_index,
+		batch_section_index,
 	};
 
 	int option = 0;
@@ -446,6 +460,8 @@ check_dbi_config_wrapper process_arguments(int argc, char **argv) {
 									   {"query", required_argument, 0, 'q'},
 									   {"database", required_argument, 0, 'D'},
 									   {"output-format", required_argument, 0, output_format_index},
+									   {"batch-query", required_argument, 0, batch_query_index},
+									   {"batch-section", required_argument, 0, batch_section_index},
 									   {0, 0, 0, 0}};
 
 	check_dbi_config_wrapper result = {
@@ -590,6 +606,35 @@ check_dbi_config_wrapper process_arguments(int argc, char **argv) {
 			result.config.output_format = parser.output_format;
 			break;
 		}
+		case batch_query_index: {
+			char *spec = strchr(optarg, ',');
+			if (spec == NULL) {
+				usage2(_("Batch query must be 'LABEL,METRIC,WARNING,CRITICAL,QUERY'"), optarg);
+			}
+			*spec = '\0';
+			add_batch_entry(&result.config, optarg, spec + 1);
+		} break;
+		case batch_section_index:
+#ifdef NP_EXTRA_OPTS
+			/*
+			 * every key of the section is a label, np_get_defaults returns them as --key=value.
+			 * The default section is not the one of --extra-opts, whose keys are options.
+			 */
+			for (np_arg_list *entry = np_get_defaults(optarg, "check_dbi_batch"); entry != NULL;
+				 entry = entry->next) {
+				char *label = entry->arg + strspn(entry->arg, "-");
+				char *spec = strchr(label, '=');
+				if (spec == NULL) {
+					usage2(_("Batch query must be 'LABEL = METRIC,WARNING,CRITICAL,QUERY'"),
+						   entry->arg);
+				}
+				*spec = '\0';
+				add_batch_entry(&result.config, label, spec + 1);
+			}
+#else
+			usage(_("--batch-section needs a build with extra-opts support"));
+#endif
+			break;
 		}
 	}
 
@@ -597,9 +642,10 @@ check_dbi_config_wrapper process_arguments(int argc, char **argv) {
 		usage("Must specify a DBI driver");
 	}
 
+	/* the batch queries are checked instead of -q */
 	if (((result.config.metric == METRIC_QUERY_RESULT) ||
 		 (result.config.metric == METRIC_QUERY_TIME)) &&
-		(!result.config.query)) {
+		(!result.config.query) && result.config.batch_num == 0) {
 		usage("Must specify a query to execute (metric == QUERY_RESULT)");
 	}
 
@@ -684,6 +730,16 @@ void print_help(void) {
 	printf("    QUERY_RESULT - %s\n", _("result (first column of first row) of the query"));
 	printf("    QUERY_TIME   - %s\n", _("time used to execute the query"));
 	printf("                   %s\n", _("(ignore the query result)"));
+	printf(" %s\n", "--batch-query=LABEL,METRIC,WARNING,CRITICAL,QUERY");
+	printf("    %s\n", _("An additional query with its own metric (QUERY_RESULT or QUERY_TIME)"));
+	printf("    %s\n", _("and thresholds, the fields may be empty. Can be given several times,"));
+	printf("    %s\n", _("all queries run over one connection and become subchecks of their own"));
+#ifdef NP_EXTRA_OPTS
+	printf(" %s\n", "--batch-section=[SECTION][@FILE]");
+	printf("    %s\n", _("Read batch queries from an ini file section, one per line as"));
+	printf("    %s\n", _("LABEL = METRIC,WARNING,CRITICAL,QUERY"));
+	printf("    %s\n", _("The default section is [check_dbi_batch]"));
+#endif
 	printf("\n");
 
 	printf(UT_CONN_TIMEOUT, DEFAULT_SOCKET_TIMEOUT);
@@ -727,6 +783,11 @@ void print_help(void) {
 	printf("  Critical if the database server is not a MySQL enterprise server in either\n");
 	printf("  version 5.0.x or 5.1.x.\n\n");
 
+	printf("  check_dbi -d pgsql -o username=postgres -m CONN_TIME \\\n");
+	printf("    --batch-query='connections,,50,100,SELECT COUNT(*) FROM pg_stat_activity' \\\n");
+	printf("    --batch-query='locks,,,500,SELECT COUNT(*) FROM pg_locks'\n");
+	printf("  Both queries run over the same connection.\n\n");
+
 	printf("  check_dbi -d pgsql -u username=user -m SERVER_VERSION \\\n");
 	printf("    -w 090000:090099 -c 090000:090199\n");
 	printf("  Warn if the PostgreSQL server version is not 9.0.x; critical if the version\n");
@@ -740,6 +801,8 @@ void print_usage(void) {
 	printf("%s -d <DBI driver> [-o <DBI driver option> [...]] [-q <query>]\n", progname);
 	printf(" [-H <host>] [-c <critical range>] [-w <warning range>] [-m <metric>]\n");
 	printf(" [-e <string>] [-r|-R <regex>]\n");
+	printf(" [--batch-query=<label>,<metric>,<warning>,<critical>,<query> [...]]\n");
+	printf(" [--batch-section=[<section>][@<file>]]\n");
 }
 
 const char *get_field_str(dbi_result res, check_dbi_metric metric, check_dbi_type type) {
@@ -906,7 +969,8 @@ static do_query_result do_query(dbi_conn conn, check_dbi_metric metric, check_db
 					result.result_string = strdup(get_field_str(res, metric, type));
 				} else {
 					get_field_wrapper gfw = get_field(res, metric, type);
-					result.result_number = gfw.value;
+					/* a value which is no number must not be checked as 0 */
+					result.result_number = gfw.error_code == OK ? gfw.value : NAN;
 				}
 			} else {
 				// Error when retrieving the field, that is OK if the Query result is not of
@@ -928,6 +992,106 @@ static do_query_result do_query(dbi_conn conn, check_dbi_metric metric, check_db
 	return result;
 }
 
+/* spec is "METRIC,WARNING,CRITICAL,QUERY", the ranges may be empty */
+static void add_batch_entry(check_dbi_config *config, char *label, char *spec) {
+	check_dbi_batch_entry entry = {
+		.label = label,
+		.metric = METRIC_QUERY_RESULT,
+		.thresholds = mp_thresholds_init(),
+	};
+
+	char *fields[3];
+	for (int i = 0; i < 3; i++) {
+		char *comma = strchr(spec, ',');
+		if (comma == NULL) {
+			usage2(_("Batch query must be 'LABEL,METRIC,WARNING,CRITICAL,QUERY'"), label);
+		}
+		*comma = '\0';
+		fields[i] = spec;
+		spec = comma + 1;
+	}
+	entry.query = spec;
+
+	if (label[0] == '\0' || entry.query[0] == '\0') {
+		usage2(_("Batch query needs a label and a query"), label);
+	}
+
+	if (!strcasecmp(fields[0], "QUERY_TIME")) {
+		entry.metric = METRIC_QUERY_TIME;
+	} else if (fields[0][0] != '\0' && strcasecmp(fields[0], "QUERY_RESULT")) {
+		usage2(_("Batch queries support the metrics QUERY_RESULT and QUERY_TIME"), fields[0]);
+	}
+
+	if (fields[1][0] != '\0') {
+		mp_range_parsed tmp = mp_parse_range_string(fields[1]);
+		if (tmp.error != MP_PARSING_SUCCESS) {
+			die(STATE_UNKNOWN, "failed to parse warning threshold of batch query '%s'", label);
+		}
+		entry.thresholds = mp_thresholds_set_warn(entry.thresholds, tmp.range);
+	}
+	if (fields[2][0] != '\0') {
+		mp_range_parsed tmp = mp_parse_range_string(fields[2]);
+		if (tmp.error != MP_PARSING_SUCCESS) {
+			die(STATE_UNKNOWN, "failed to parse critical threshold of batch query '%s'", label);
+		}
+		entry.thresholds = mp_thresholds_set_crit(entry.thresholds, tmp.range);
+	}
+
+	check_dbi_batch_entry *new =
+		realloc(config->batch, (config->batch_num + 1) * sizeof(check_dbi_batch_entry));
+	if (!new) {
+		printf("UNKNOWN - failed to reallocate memory\n");
+		exit(STATE_UNKNOWN);
+	}
+	config->batch = new;
+	config->batch[config->batch_num++] = entry;
+}
+
+static mp_subcheck evaluate_batch_entry(dbi_conn conn, check_dbi_batch_entry entry) {
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_UNKNOWN);
+
+	do_query_result query_res = do_query(conn, entry.metric, TYPE_NUMERIC, entry.query);
+
+	if (query_res.error_code != 0) {
+		xasprintf(&result.output, "%s: query failed: %s", entry.label, query_res.error_string);
+		return mp_set_subcheck_state(result, STATE_CRITICAL);
+	}
+	if (query_res.query_processing_status != STATE_OK) {
+		xasprintf(&result.output, "%s: failed to process query: %s", entry.label,
+				  query_res.error_string ? query_res.error_string : "unknown error");
+		return mp_set_subcheck_state(result, query_res.query_processing_status);
+	}
+
+	mp_perfdata pd_query_duration = perfdata_init();
+	xasprintf(&pd_query_duration.label, "%s_querytime", entry.label);
+	pd_query_duration = mp_set_pd_value(pd_query_duration, query_res.query_duration);
+
+	if (entry.metric == METRIC_QUERY_TIME) {
+		pd_query_duration = mp_pd_set_thresholds(pd_query_duration, entry.thresholds);
+		mp_add_perfdata_to_subcheck(&result, pd_query_duration);
+		result = mp_set_subcheck_state(result, mp_get_pd_status(pd_query_duration));
+		xasprintf(&result.output, "%s: query duration %f", entry.label, query_res.query_duration);
+		return result;
+	}
+
+	mp_add_perfdata_to_subcheck(&result, pd_query_duration);
+	if (isnan(query_res.result_number)) {
+		xasprintf(&result.output, "%s: query result is not numeric", entry.label);
+		return mp_set_subcheck_state(result, STATE_CRITICAL);
+	}
+
+	mp_perfdata pd_query_val = perfdata_init();
+	pd_query_val.label = entry.label;
+	pd_query_val = mp_set_pd_value(pd_query_val, query_res.result_number);
+	pd_query_val = mp_pd_set_thresholds(pd_query_val, entry.thresholds);
+	mp_add_perfdata_to_subcheck(&result, pd_query_val);
+
+	result = mp_set_subcheck_state(result, mp_get_pd_status(pd_query_val));
+	xasprintf(&result.output, "%s: %g", entry.label, query_res.result_number);
+	return result;
+}
+
 static double timediff(struct timeval start, struct timeval end) {
 	double diff;
 
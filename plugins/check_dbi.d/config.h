@@ -22,6 +22,14 @@ typedef struct {
 	char *value;
 } driver_option_t;
 
+/* one query of the batch mode, run over the same connection as the others */
+typedef struct {
+	char *label;
+	check_dbi_metric metric; /* METRIC_QUERY_RESULT or METRIC_QUERY_TIME */
+	char *query;
+	mp_thresholds thresholds;
+} check_dbi_batch_entry;
+
 typedef struct {
 	char *dbi_driver;
 	char *host;
@@ -39,6 +47,9 @@ typedef struct {
 	check_dbi_type type;
 	mp_thresholds thresholds;
 
+	check_dbi_batch_entry *batch;
+	size_t batch_num;
+
 	bool output_format_is_set;
 	mp_output_format output_format;
 } check_dbi_config;
@@ -60,6 +71,9 @@ check_dbi_config check_dbi_config_init() {
 
 		.thresholds = mp_thresholds_init(),
 
+		.batch = NULL,
+		.batch_num = 0,
+
 		.output_format_is_set = false,
 	};
 	return tmp;
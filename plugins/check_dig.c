@@ -43,7 +43,11 @@ const char *email = "devel@monitoring-plugins.org";
 #include "runcmd.h"
 
 #include "check_dig.d/config.h"
+#include "check_dig.d/dig_batch.h"
 #include "states.h"
+#include "output.h"
+#include "perfdata.h"
+#include "thresholds.h"
 
 typedef struct {
 	int errorcode;
@@ -63,6 +67,8 @@ static flag_list split_csv_trim(const char *csv);
 static bool flag_list_contains(const flag_list *list, const char *needle);
 static void free_flag_list(flag_list *list);
 
+static void run_batch_mode(check_dig_config config) __attribute__((noreturn));
+
 int main(int argc, char **argv) {
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -83,6 +89,10 @@ int main(int argc, char **argv) {
 
 	const check_dig_config config = tmp_config.config;
 
+	if (config.batch.count > 0) {
+		run_batch_mode(config);
+	}
+
 	/* dig applies the timeout to each try, so we need to work around this */
 	int timeout_interval_dig = ((int)timeout_interval / config.number_tries) + config.number_tries;
 
@@ -249,8 +259,182 @@ int main(int argc, char **argv) {
 	exit(result);
 }
 
+static int compare_latencies(const void *left, const void *right) {
+	double left_value = *(const double *)left;
+	double right_value = *(const double *)right;
+	return (left_value > right_value) - (left_value < right_value);
+}
+
+/*
+ * Batch mode: all queries are sent natively over one UDP socket, every
+ * query becomes a subcheck with its latency, RCODE and answer evaluation
+ * and the latency distribution is summarized in an additional subcheck.
+ */
+static void run_batch_mode(const check_dig_config config) {
+	mp_check overall = mp_check_init();
+	if (config.output_format_is_set) {
+		mp_set_format(config.output_format);
+	}
+
+	mp_thresholds latency_thresholds = mp_thresholds_init();
+	if (config.warning_interval > UNDEFINED) {
+		latency_thresholds = mp_thresholds_set_warn(
+			latency_thresholds,
+			mp_range_set_end(mp_range_init(), mp_create_pd_value(config.warning_interval)));
+	}
+	if (config.critical_interval > UNDEFINED) {
+		latency_thresholds = mp_thresholds_set_crit(
+			latency_thresholds,
+			mp_range_set_end(mp_range_init(), mp_create_pd_value(config.critical_interval)));
+	}
+
+	/* keep some headroom below the alarm to evaluate and print the results */
+	double time_budget = (timeout_interval > 1) ? (double)timeout_interval - 0.5 : 1.0;
+	alarm(timeout_interval);
+
+	dig_batch_parameters parameters = {
+		.server = config.dns_server,
+		.port = config.server_port,
+		.address_family = config.address_family,
+		.tries = (unsigned int)config.number_tries,
+		.timeout = time_budget,
+		.verbose = verbose,
+	};
+
+	if (verbose) {
+		printf(_("Sending %zu queries to %s port %d\n"), config.batch.count, config.dns_server,
+			   config.server_port);
+	}
+
+	dig_batch_result *results = dig_batch_run(parameters, config.batch);
+
+	double *latencies = calloc(config.batch.count, sizeof(double));
+	if (latencies == NULL) {
+		die(STATE_UNKNOWN, _("Cannot allocate memory: %s"), strerror(errno));
+	}
+	size_t answered = 0;
+
+	for (size_t i = 0; i < config.batch.count; i++) {
+		const dig_batch_query *query = &config.batch.queries[i];
+		dig_batch_result *result = &results[i];
+
+		mp_subcheck sc_query = mp_subcheck_init();
+
+		if (result->status != DIG_BATCH_ANSWERED) {
+			sc_query = mp_set_subcheck_state(sc_query, STATE_CRITICAL);
+			if (result->status == DIG_BATCH_TIMEOUT) {
+				xasprintf(&sc_query.output, _("%s %s: no response after %u tries"), query->name,
+						  query->type_name, result->tries);
+			} else {
+				xasprintf(&sc_query.output, _("%s %s: failed to send query"), query->name,
+						  query->type_name);
+			}
+			mp_add_subcheck_to_check(&overall, sc_query);
+			continue;
+		}
+
+		latencies[answered++] = result->latency;
+		xasprintf(&sc_query.output, "%s %s: %s, %.3f seconds response time", query->name,
+				  query->type_name, dig_rcode_to_string(result->rcode), result->latency);
+
+		if (verbose) {
+			printf("%s %s (%u tries):\n", query->name, query->type_name, result->tries);
+			for (size_t j = 0; j < result->answer_count; j++) {
+				printf("  %s\n", result->answers[j]);
+			}
+		}
+
+		/* response code */
+		mp_subcheck sc_rcode = mp_subcheck_init();
+		sc_rcode = mp_set_subcheck_state(
+			sc_rcode, (result->rcode == DIG_RCODE_NOERROR) ? STATE_OK : STATE_CRITICAL);
+		xasprintf(&sc_rcode.output, "RCODE %s", dig_rcode_to_string(result->rcode));
+		mp_perfdata pd_rcode = perfdata_init();
+		xasprintf(&pd_rcode.label, "rcode_%s_%s", query->name, query->type_name);
+		pd_rcode = mp_set_pd_value(pd_rcode, result->rcode);
+		mp_add_perfdata_to_subcheck(&sc_rcode, pd_rcode);
+		mp_add_subcheck_to_subcheck(&sc_query, sc_rcode);
+
+		/* answer section, same evaluation as in the dig mode */
+		mp_subcheck sc_answer = mp_subcheck_init();
+		if (result->answer_count == 0) {
+			sc_answer = mp_set_subcheck_state(sc_answer, STATE_CRITICAL);
+			sc_answer.output = (char *)_("No ANSWER SECTION found");
+		} else if (result->answer_matched) {
+			sc_answer = mp_set_subcheck_state(sc_answer, STATE_OK);
+			xasprintf(&sc_answer.output, _("Answer: %s"), result->matching_answer);
+		} else {
+			sc_answer = mp_set_subcheck_state(sc_answer, STATE_WARNING);
+			xasprintf(&sc_answer.output, _("'%s' not found in ANSWER SECTION"),
+					  (query->expected == NULL) ? query->name : query->expected);
+		}
+		if (result->truncated) {
+			xasprintf(&sc_answer.output, _("%s (response truncated)"), sc_answer.output);
+		}
+		mp_add_subcheck_to_subcheck(&sc_query, sc_answer);
+
+		/* latency */
+		mp_perfdata pd_time = perfdata_init();
+		xasprintf(&pd_time.label, "time_%s_%s", query->name, query->type_name);
+		pd_time.uom = "s";
+		pd_time = mp_set_pd_value(pd_time, result->latency);
+		pd_time = mp_pd_set_thresholds(pd_time, latency_thresholds);
+		pd_time = mp_set_pd_min_value(pd_time, mp_create_pd_value(0));
+
+		mp_subcheck sc_time = mp_subcheck_init();
+		sc_time = mp_set_subcheck_state(sc_time, mp_get_pd_status(pd_time));
+		xasprintf(&sc_time.output, _("%.3f seconds response time"), result->latency);
+		mp_add_perfdata_to_subcheck(&sc_time, pd_time);
+		mp_add_subcheck_to_subcheck(&sc_query, sc_time);
+
+		mp_add_subcheck_to_check(&overall, sc_query);
+	}
+
+	/* latency distribution over all answered queries */
+	qsort(latencies, answered, sizeof(double), compare_latencies);
+
+	mp_subcheck sc_summary = mp_subcheck_init();
+	sc_summary = mp_set_subcheck_state(sc_summary, STATE_OK);
+	xasprintf(&sc_summary.output, _("%zu of %zu queries answered"), answered,
+			  config.batch.count);
+
+	mp_perfdata pd_answered = perfdata_init();
+	pd_answered.label = "answered";
+	pd_answered = mp_set_pd_value(pd_answered, answered);
+	pd_answered = mp_set_pd_min_value(pd_answered, mp_create_pd_value(0));
+	pd_answered = mp_set_pd_max_value(pd_answered, mp_create_pd_value(config.batch.count));
+	mp_add_perfdata_to_subcheck(&sc_summary, pd_answered);
+
+	if (answered > 0) {
+		const struct {
+			const char *label;
+			double percentile;
+		} percentiles[] = {{"time_p50", 50}, {"time_p95", 95}, {"time_p99", 99}};
+
+		for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+			mp_perfdata pd_percentile = perfdata_init();
+			pd_percentile.label = (char *)percentiles[i].label;
+			pd_percentile.uom = "s";
+			pd_percentile = mp_set_pd_value(
+				pd_percentile, dig_percentile(latencies, answered, percentiles[i].percentile));
+			mp_add_perfdata_to_subcheck(&sc_summary, pd_percentile);
+		}
+		xasprintf(&sc_summary.output, _("%s, p50: %.3fs, p95: %.3fs, p99: %.3fs"),
+				  sc_summary.output, dig_percentile(latencies, answered, 50),
+				  dig_percentile(latencies, answered, 95), dig_percentile(latencies, answered, 99));
+	}
+	mp_add_subcheck_to_check(&overall, sc_summary);
+
+	mp_exit(overall);
+}
+
 /* process command-line arguments */
 check_dig_config_wrapper process_arguments(int argc, char **argv) {
+	enum {
+		batch_query_index = CHAR_MAX + 1,
+		output_format_index,
+	};
+
 	static struct option longopts[] = {{"hostname", required_argument, 0, 'H'},
 									   {"query_address", required_argument, 0, 'l'},
 									   {"warning", required_argument, 0, 'w'},
@@ -267,6 +451,9 @@ check_dig_config_wrapper process_arguments(int argc, char **argv) {
 									   {"port", required_argument, 0, 'p'},
 									   {"use-ipv4", no_argument, 0, '4'},
 									   {"use-ipv6", no_argument, 0, '6'},
+									   {"batch-file", required_argument, 0, 'B'},
+									   {"batch-query", required_argument, 0, batch_query_index},
+									   {"output-format", required_argument, 0, output_format_index},
 									   {0, 0, 0, 0}};
 
 	check_dig_config_wrapper result = {
@@ -282,7 +469,7 @@ check_dig_config_wrapper process_arguments(int argc, char **argv) {
 	int option = 0;
 	while (true) {
 		int option_index =
-			getopt_long(argc, argv, "hVvt:l:H:w:c:T:p:a:A:E:X:46", longopts, &option);
+			getopt_long(argc, argv, "hVvt:l:H:w:c:T:p:a:A:E:X:46B:", longopts, &option);
 
 		if (CHECK_EOF(option_index)) {
 			break;
@@ -350,10 +537,34 @@ check_dig_config_wrapper process_arguments(int argc, char **argv) {
 			break;
 		case '4':
 			result.config.query_transport = "-4";
+			result.config.address_family = AF_INET;
 			break;
 		case '6':
 			result.config.query_transport = "-6";
+			result.config.address_family = AF_INET6;
 			break;
+		case 'B': /* batch file */
+			if (dig_batch_read_file(&result.config.batch, optarg) != OK) {
+				usage_va(_("Could not read batch file %s or it contains an invalid entry"),
+						 optarg);
+			}
+			break;
+		case batch_query_index:
+			if (dig_batch_add_query(&result.config.batch, optarg) != OK) {
+				usage_va(_("Invalid batch query - %s"), optarg);
+			}
+			break;
+		case output_format_index: {
+			parsed_output_format parser = mp_parse_output_format(optarg);
+			if (!parser.parsing_success) {
+				printf("Invalid output format: %s\n", optarg);
+				exit(STATE_UNKNOWN);
+			}
+
+			result.config.output_format_is_set = true;
+			result.config.output_format = parser.output_format;
+			break;
+		}
 		default: /* usage5 */
 			usage5();
 		}
@@ -377,7 +588,7 @@ check_dig_config_wrapper process_arguments(int argc, char **argv) {
 }
 
 check_dig_config_wrapper validate_arguments(check_dig_config_wrapper config_wrapper) {
-	if (config_wrapper.config.query_address == NULL) {
+	if (config_wrapper.config.query_address == NULL && config_wrapper.config.batch.count == 0) {
 		config_wrapper.errorcode = ERROR;
 	}
 	return config_wrapper;
@@ -423,14 +634,25 @@ void print_help(void) {
 	printf("    %s\n", _("Comma-separated dig flags that must be present (e.g. 'aa,qr')"));
 	printf(" %s\n", "-X, --forbid-flags=LIST");
 	printf("    %s\n", _("Comma-separated dig flags that must NOT be present"));
+	printf(" %s\n", "-B, --batch-file=FILE");
+	printf("    %s\n",
+		   _("Batch mode: read queries from FILE, one \"NAME [TYPE [EXPECTED]]\" per line"));
+	printf(" %s\n", "--batch-query=NAME[,TYPE[,EXPECTED]]");
+	printf("    %s\n", _("Batch mode: add a single query, may be given multiple times"));
+	printf("    %s\n", _("In batch mode all queries are sent concurrently over one UDP socket"));
+	printf("    %s\n", _("without running dig. -w/-c apply to the latency of every query"));
 	printf(UT_WARN_CRIT);
 	printf(UT_CONN_TIMEOUT, DEFAULT_SOCKET_TIMEOUT);
+	printf(UT_OUTPUT_FORMAT);
 	printf(UT_VERBOSE);
 
 	printf("\n");
 	printf("%s\n", _("Examples:"));
 	printf(" %s\n", "check_dig -H DNSSERVER -l www.example.com -A \"+tcp\"");
 	printf(" %s\n", "This will send a tcp query to DNSSERVER for www.example.com");
+	printf(" %s\n", "check_dig -H DNSSERVER --batch-query www.example.com,A,192.0.2.1 \\");
+	printf(" %s\n", "          --batch-query example.com,MX,mail.example.com -w 0.2 -c 1");
+	printf(" %s\n", "This will query both records concurrently and report them separately");
 
 	printf(UT_SUPPORT);
 }
@@ -440,6 +662,8 @@ void print_usage(void) {
 	printf("%s -l <query_address> [-H <host>] [-p <server port>]\n", progname);
 	printf(" [-T <query type>] [-w <warning interval>] [-c <critical interval>]\n");
 	printf(" [-t <timeout>] [-a <expected answer address>] [-E <flags>] [-X <flags>] [-v]\n");
+	printf("%s -B <batch file> | --batch-query <name,type,expected> [-H <host>]\n", progname);
+	printf(" [-p <server port>] [-w <warning interval>] [-c <critical interval>] [-t <timeout>]\n");
 }
 
 /* helpers */
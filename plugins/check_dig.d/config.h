@@ -1,6 +1,8 @@
 #pragma once
 
 #include "../../config.h"
+#include "../../lib/output.h"
+#include "./dig_batch.h"
 #include <stddef.h>
 
 #define UNDEFINED     0
@@ -26,6 +28,13 @@ typedef struct {
 	double critical_interval;
 	flag_list require_flags;
 	flag_list forbid_flags;
+
+	/* batch mode, queries are sent natively instead of running dig */
+	dig_batch_list batch;
+	int address_family;
+
+	bool output_format_is_set;
+	mp_output_format output_format;
 } check_dig_config;
 
 check_dig_config check_dig_config_init() {
@@ -43,6 +52,11 @@ check_dig_config check_dig_config_init() {
 		.critical_interval = UNDEFINED,
 		.require_flags = {.count = 0, .items = NULL},
 		.forbid_flags = {.count = 0, .items = NULL},
+
+		.batch = {.count = 0, .queries = NULL},
+		.address_family = AF_UNSPEC,
+
+		.output_format_is_set = false,
 	};
 	return tmp;
 }
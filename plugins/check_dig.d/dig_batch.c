@@ -0,0 +1,651 @@
+#include "./dig_batch.h"
+#include "../common.h"
+#include "../utils.h"
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#define DIG_HEADER_LENGTH 12
+#define DIG_FLAG_QR       0x8000
+#define DIG_FLAG_AA       0x0400
+#define DIG_FLAG_TC       0x0200
+#define DIG_FLAG_RD       0x0100
+#define DIG_CLASS_IN      1
+
+static const struct {
+	const char *name;
+	uint16_t type;
+} dig_record_types[] = {
+	{"A", 1},      {"NS", 2},      {"CNAME", 5}, {"SOA", 6},   {"PTR", 12},
+	{"MX", 15},    {"TXT", 16},    {"AAAA", 28}, {"SRV", 33},  {"NAPTR", 35},
+	{"DNAME", 39}, {"DS", 43},     {"SSHFP", 44}, {"RRSIG", 46}, {"DNSKEY", 48},
+	{"TLSA", 52},  {"SVCB", 64},   {"HTTPS", 65}, {"ANY", 255}, {"CAA", 257},
+};
+
+static const char *dig_rcodes[] = {"NOERROR", "FORMERR", "SERVFAIL", "NXDOMAIN",
+								   "NOTIMP",  "REFUSED", "YXDOMAIN", "YXRRSET",
+								   "NXRRSET", "NOTAUTH", "NOTZONE"};
+
+uint16_t dig_record_type_from_string(const char *type_name) {
+	for (size_t i = 0; i < sizeof(dig_record_types) / sizeof(dig_record_types[0]); i++) {
+		if (strcasecmp(type_name, dig_record_types[i].name) == 0) {
+			return dig_record_types[i].type;
+		}
+	}
+
+	/* RFC 3597 notation for unknown types, e.g. TYPE65534 */
+	if (strncasecmp(type_name, "TYPE", 4) == 0 && isdigit((unsigned char)type_name[4])) {
+		char *end = NULL;
+		long type = strtol(type_name + 4, &end, 10);
+		if (*end == '\0' && type > 0 && type <= UINT16_MAX) {
+			return (uint16_t)type;
+		}
+	}
+	return 0;
+}
+
+const char *dig_record_type_to_string(uint16_t type, char buffer[static 16]) {
+	for (size_t i = 0; i < sizeof(dig_record_types) / sizeof(dig_record_types[0]); i++) {
+		if (dig_record_types[i].type == type) {
+			return dig_record_types[i].name;
+		}
+	}
+	snprintf(buffer, 16, "TYPE%u", type);
+	return buffer;
+}
+
+const char *dig_rcode_to_string(int rcode) {
+	if (rcode >= 0 && (size_t)rcode < sizeof(dig_rcodes) / sizeof(dig_rcodes[0])) {
+		return dig_rcodes[rcode];
+	}
+	return "RESERVED";
+}
+
+static int dig_batch_append(dig_batch_list list[static 1], const char *name, const char *type,
+							const char *expected) {
+	if (name == NULL || *name == '\0') {
+		return ERROR;
+	}
+	if (list->count >= DIG_BATCH_MAX_QUERIES) {
+		return ERROR;
+	}
+
+	const char *type_name = (type == NULL || *type == '\0') ? "A" : type;
+	uint16_t qtype = dig_record_type_from_string(type_name);
+	if (qtype == 0) {
+		return ERROR;
+	}
+
+	dig_batch_query query = {
+		.name = strdup(name),
+		.type_name = strdup(type_name),
+		.expected = (expected == NULL || *expected == '\0') ? NULL : strdup(expected),
+		.qtype = qtype,
+	};
+
+	dig_batch_query *tmp = realloc(list->queries, (list->count + 1) * sizeof(dig_batch_query));
+	if (tmp == NULL) {
+		die(STATE_UNKNOWN, _("Cannot allocate memory: %s"), strerror(errno));
+	}
+	list->queries = tmp;
+	list->queries[list->count++] = query;
+	return OK;
+}
+
+int dig_batch_add_query(dig_batch_list list[static 1], const char *spec) {
+	char *tmp = strdup(spec);
+	char *cursor = tmp;
+	char *name = strsep(&cursor, ",");
+	char *type = strsep(&cursor, ",");
+	/* the expected answer is the remainder, it may contain commas itself (TXT) */
+	char *expected = cursor;
+
+	int result = dig_batch_append(list, name, type, expected);
+	free(tmp);
+	return result;
+}
+
+int dig_batch_read_file(dig_batch_list list[static 1], const char *path) {
+	FILE *batch_file = fopen(path, "r");
+	if (batch_file == NULL) {
+		return ERROR;
+	}
+
+	char line[MAX_INPUT_BUFFER];
+	int result = OK;
+	while (fgets(line, sizeof(line), batch_file) != NULL) {
+		char *comment = strchr(line, '#');
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+
+		char *saveptr = NULL;
+		char *name = strtok_r(line, " \t\r\n", &saveptr);
+		if (name == NULL) {
+			continue;
+		}
+		char *type = strtok_r(NULL, " \t\r\n", &saveptr);
+		char *expected = strtok_r(NULL, "\r\n", &saveptr);
+		if (expected != NULL) {
+			/* trim surrounding whitespace of the expected answer */
+			while (isspace((unsigned char)*expected)) {
+				expected++;
+			}
+			char *end = expected + strlen(expected);
+			while (end > expected && isspace((unsigned char)end[-1])) {
+				*--end = '\0';
+			}
+		}
+
+		if (dig_batch_append(list, name, type, expected) != OK) {
+			result = ERROR;
+			break;
+		}
+	}
+
+	fclose(batch_file);
+	return result;
+}
+
+size_t dig_encode_query(uint8_t *buffer, size_t buffer_size, uint16_t query_id, const char *name,
+						uint16_t qtype) {
+	if (buffer_size < DIG_HEADER_LENGTH + 1 + 4) {
+		return 0;
+	}
+
+	memset(buffer, 0, DIG_HEADER_LENGTH);
+	buffer[0] = (uint8_t)(query_id >> 8);
+	buffer[1] = (uint8_t)(query_id & 0xff);
+	buffer[2] = (uint8_t)(DIG_FLAG_RD >> 8);
+	buffer[5] = 1; /* QDCOUNT */
+
+	size_t offset = DIG_HEADER_LENGTH;
+	const char *label = name;
+	while (*label != '\0') {
+		const char *dot = strchr(label, '.');
+		size_t label_length = (dot == NULL) ? strlen(label) : (size_t)(dot - label);
+
+		if (label_length == 0) {
+			/* the root "." or a trailing dot are fine, empty labels in between are not */
+			if (dot != NULL && dot[1] != '\0') {
+				return 0;
+			}
+			break;
+		}
+		if (label_length > 63 || offset + 1 + label_length + 5 > buffer_size ||
+			offset - DIG_HEADER_LENGTH + label_length + 2 > 255) {
+			return 0;
+		}
+
+		buffer[offset++] = (uint8_t)label_length;
+		memcpy(&buffer[offset], label, label_length);
+		offset += label_length;
+
+		if (dot == NULL) {
+			break;
+		}
+		label = dot + 1;
+	}
+	buffer[offset++] = 0;
+
+	buffer[offset++] = (uint8_t)(qtype >> 8);
+	buffer[offset++] = (uint8_t)(qtype & 0xff);
+	buffer[offset++] = 0;
+	buffer[offset++] = DIG_CLASS_IN;
+
+	return offset;
+}
+
+static uint16_t read_uint16(const uint8_t *ptr) { return (uint16_t)((ptr[0] << 8) | ptr[1]); }
+
+static uint32_t read_uint32(const uint8_t *ptr) {
+	return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | ptr[3];
+}
+
+/*
+ * Decodes a (possibly compressed) domain name starting at offset into
+ * output as dotted string with a trailing dot. next_offset receives the
+ * position right after the name in the original location.
+ */
+static bool dig_read_name(const uint8_t *packet, size_t length, size_t offset, char *output,
+						  size_t output_size, size_t *next_offset) {
+	size_t out_pos = 0;
+	size_t jumps = 0;
+	bool jumped = false;
+
+	while (true) {
+		if (offset >= length) {
+			return false;
+		}
+
+		uint8_t label_length = packet[offset];
+		if ((label_length & 0xc0) == 0xc0) {
+			if (offset + 1 >= length || ++jumps > 64) {
+				return false;
+			}
+			if (!jumped && next_offset != NULL) {
+				*next_offset = offset + 2;
+			}
+			jumped = true;
+			offset = read_uint16(&packet[offset]) & 0x3fff;
+			continue;
+		}
+		if (label_length & 0xc0) {
+			/* extended label types are not in use */
+			return false;
+		}
+
+		offset++;
+		if (label_length == 0) {
+			break;
+		}
+		if (offset + label_length > length || out_pos + label_length + 2 > output_size) {
+			return false;
+		}
+		memcpy(&output[out_pos], &packet[offset], label_length);
+		out_pos += label_length;
+		output[out_pos++] = '.';
+		offset += label_length;
+	}
+
+	if (out_pos == 0) {
+		output[out_pos++] = '.';
+	}
+	output[out_pos] = '\0';
+
+	if (!jumped && next_offset != NULL) {
+		*next_offset = offset;
+	}
+	return true;
+}
+
+dig_response_header dig_parse_response_header(const uint8_t *packet, size_t length) {
+	dig_response_header result = {
+		.errorcode = ERROR,
+	};
+
+	if (length < DIG_HEADER_LENGTH || !(read_uint16(&packet[2]) & DIG_FLAG_QR)) {
+		return result;
+	}
+	result.query_id = read_uint16(packet);
+
+	if (read_uint16(&packet[4]) != 1) {
+		return result;
+	}
+
+	size_t offset = 0;
+	if (!dig_read_name(packet, length, DIG_HEADER_LENGTH, result.question,
+					   sizeof(result.question), &offset) ||
+		offset + 4 > length) {
+		return result;
+	}
+	result.qtype = read_uint16(&packet[offset]);
+	result.errorcode = OK;
+	return result;
+}
+
+/* Renders the RDATA of a record in presentation format */
+static char *dig_render_rdata(const uint8_t *packet, size_t length, size_t offset, uint16_t type,
+							  uint16_t rdlength) {
+	char *result = NULL;
+	char name[DIG_MAX_NAME_LENGTH];
+	char address[INET6_ADDRSTRLEN];
+	const uint8_t *rdata = &packet[offset];
+	size_t next = 0;
+
+	switch (type) {
+	case 1: /* A */
+		if (rdlength == 4 && inet_ntop(AF_INET, rdata, address, sizeof(address))) {
+			return strdup(address);
+		}
+		break;
+	case 28: /* AAAA */
+		if (rdlength == 16 && inet_ntop(AF_INET6, rdata, address, sizeof(address))) {
+			return strdup(address);
+		}
+		break;
+	case 2:  /* NS */
+	case 5:  /* CNAME */
+	case 12: /* PTR */
+	case 39: /* DNAME */
+		if (dig_read_name(packet, length, offset, name, sizeof(name), NULL)) {
+			return strdup(name);
+		}
+		break;
+	case 15: /* MX */
+		if (rdlength > 2 && dig_read_name(packet, length, offset + 2, name, sizeof(name), NULL)) {
+			xasprintf(&result, "%u %s", read_uint16(rdata), name);
+			return result;
+		}
+		break;
+	case 33: /* SRV */
+		if (rdlength > 6 && dig_read_name(packet, length, offset + 6, name, sizeof(name), NULL)) {
+			xasprintf(&result, "%u %u %u %s", read_uint16(rdata), read_uint16(&rdata[2]),
+					  read_uint16(&rdata[4]), name);
+			return result;
+		}
+		break;
+	case 6: /* SOA */ {
+		char rname[DIG_MAX_NAME_LENGTH];
+		if (dig_read_name(packet, length, offset, name, sizeof(name), &next) &&
+			dig_read_name(packet, length, next, rname, sizeof(rname), &next) &&
+			next + 20 <= offset + rdlength) {
+			xasprintf(&result, "%s %s %u %u %u %u %u", name, rname, read_uint32(&packet[next]),
+					  read_uint32(&packet[next + 4]), read_uint32(&packet[next + 8]),
+					  read_uint32(&packet[next + 12]), read_uint32(&packet[next + 16]));
+			return result;
+		}
+	} break;
+	case 16: /* TXT */ {
+		size_t pos = 0;
+		result = strdup("");
+		while (pos < rdlength) {
+			uint8_t string_length = rdata[pos++];
+			if (pos + string_length > rdlength) {
+				break;
+			}
+			xasprintf(&result, "%s%s\"%.*s\"", result, (*result == '\0') ? "" : " ",
+					  (int)string_length, (const char *)&rdata[pos]);
+			pos += string_length;
+		}
+		return result;
+	}
+	default:
+		break;
+	}
+
+	/* RFC 3597 generic encoding */
+	xasprintf(&result, "\\# %u", rdlength);
+	for (uint16_t i = 0; i < rdlength; i++) {
+		xasprintf(&result, "%s%s%02x", result, (i == 0) ? " " : "", rdata[i]);
+	}
+	return result;
+}
+
+int dig_parse_response(const uint8_t *packet, size_t length, dig_batch_result result[static 1]) {
+	if (length < DIG_HEADER_LENGTH) {
+		return ERROR;
+	}
+
+	uint16_t flags = read_uint16(&packet[2]);
+	result->rcode = flags & 0x000f;
+	result->truncated = (flags & DIG_FLAG_TC) != 0;
+	result->authoritative = (flags & DIG_FLAG_AA) != 0;
+
+	uint16_t question_count = read_uint16(&packet[4]);
+	uint16_t answer_count = read_uint16(&packet[6]);
+
+	size_t offset = DIG_HEADER_LENGTH;
+	char name[DIG_MAX_NAME_LENGTH];
+	for (uint16_t i = 0; i < question_count; i++) {
+		if (!dig_read_name(packet, length, offset, name, sizeof(name), &offset) ||
+			offset + 4 > length) {
+			return ERROR;
+		}
+		offset += 4;
+	}
+
+	result->answers = calloc(answer_count ? answer_count : 1, sizeof(char *));
+	if (result->answers == NULL) {
+		die(STATE_UNKNOWN, _("Cannot allocate memory: %s"), strerror(errno));
+	}
+	result->answer_count = 0;
+
+	for (uint16_t i = 0; i < answer_count; i++) {
+		if (!dig_read_name(packet, length, offset, name, sizeof(name), &offset) ||
+			offset + 10 > length) {
+			/* a truncated answer section still yields the records decoded so far */
+			return result->truncated ? OK : ERROR;
+		}
+
+		uint16_t type = read_uint16(&packet[offset]);
+		uint32_t ttl = read_uint32(&packet[offset + 4]);
+		uint16_t rdlength = read_uint16(&packet[offset + 8]);
+		offset += 10;
+		if (offset + rdlength > length) {
+			return result->truncated ? OK : ERROR;
+		}
+
+		char type_buffer[16];
+		char *rdata = dig_render_rdata(packet, length, offset, type, rdlength);
+		xasprintf(&result->answers[result->answer_count++], "%s %u IN %s %s", name, ttl,
+				  dig_record_type_to_string(type, type_buffer), rdata);
+		free(rdata);
+		offset += rdlength;
+	}
+
+	return OK;
+}
+
+void dig_batch_match_answer(const dig_batch_query query[static 1],
+							dig_batch_result result[static 1]) {
+	const char *needle = (query->expected == NULL) ? query->name : query->expected;
+
+	result->answer_matched = false;
+	result->matching_answer = NULL;
+	for (size_t i = 0; i < result->answer_count; i++) {
+		if (strcasestr(result->answers[i], needle) != NULL) {
+			result->answer_matched = true;
+			result->matching_answer = result->answers[i];
+			return;
+		}
+	}
+}
+
+static double dig_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + ((double)now.tv_nsec / 1.0e9);
+}
+
+/* Compares two names case insensitive, ignoring a trailing dot on either side */
+static bool dig_names_equal(const char *left, const char *right) {
+	size_t left_length = strlen(left);
+	size_t right_length = strlen(right);
+	if (left_length > 0 && left[left_length - 1] == '.') {
+		left_length--;
+	}
+	if (right_length > 0 && right[right_length - 1] == '.') {
+		right_length--;
+	}
+	return left_length == right_length && strncasecmp(left, right, left_length) == 0;
+}
+
+typedef struct {
+	double first_sent;
+	double deadline;
+	uint8_t packet[DIG_MAX_QUERY_SIZE];
+	size_t packet_length;
+} dig_inflight;
+
+dig_batch_result *dig_batch_run(dig_batch_parameters parameters, dig_batch_list list) {
+	dig_batch_result *results = calloc(list.count, sizeof(dig_batch_result));
+	if (results == NULL) {
+		die(STATE_UNKNOWN, _("Cannot allocate memory: %s"), strerror(errno));
+	}
+
+	struct addrinfo hints = {
+		.ai_family = parameters.address_family,
+		.ai_socktype = SOCK_DGRAM,
+		.ai_protocol = IPPROTO_UDP,
+	};
+	char port[16];
+	snprintf(port, sizeof(port), "%d", parameters.port);
+
+	struct addrinfo *address = NULL;
+	int ga_result = getaddrinfo(parameters.server, port, &hints, &address);
+	if (ga_result != 0) {
+		die(STATE_UNKNOWN, _("error getting address for %s: %s\n"), parameters.server,
+			gai_strerror(ga_result));
+	}
+
+	int sock = socket(address->ai_family, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == -1) {
+		die(STATE_UNKNOWN, _("Can not create socket: %s\n"), strerror(errno));
+	}
+	/* a connected socket makes the kernel drop datagrams from other sources */
+	if (connect(sock, address->ai_addr, address->ai_addrlen) != 0) {
+		die(STATE_UNKNOWN, _("Can not connect to %s: %s\n"), parameters.server, strerror(errno));
+	}
+	freeaddrinfo(address);
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+
+	/* retransmissions split the time budget in the same way dig does */
+	unsigned int tries = parameters.tries > 0 ? parameters.tries : 1;
+	double try_timeout = parameters.timeout / tries;
+	double start = dig_now();
+	double overall_deadline = start + parameters.timeout;
+
+	/* consecutive ids from a random base, so a response maps to its query by subtraction */
+	srandom((unsigned int)(time(NULL) ^ getpid()));
+	uint16_t id_base = (uint16_t)random();
+
+	dig_inflight *inflight = calloc(list.count, sizeof(dig_inflight));
+	if (inflight == NULL) {
+		die(STATE_UNKNOWN, _("Cannot allocate memory: %s"), strerror(errno));
+	}
+
+	size_t next_to_send = 0;
+	size_t first_pending = 0;
+	size_t in_flight_count = 0;
+	size_t completed = 0;
+	uint8_t receive_buffer[DIG_MAX_PACKET_SIZE];
+
+	while (completed < list.count) {
+		double now = dig_now();
+
+		/* fill the window with fresh queries */
+		while (next_to_send < list.count && in_flight_count < DIG_BATCH_MAX_INFLIGHT) {
+			size_t index = next_to_send++;
+			dig_inflight *slot = &inflight[index];
+			slot->packet_length =
+				dig_encode_query(slot->packet, sizeof(slot->packet), (uint16_t)(id_base + index),
+								 list.queries[index].name, list.queries[index].qtype);
+			/* a refused earlier datagram is reported on the next send, just retry later */
+			if (slot->packet_length == 0 ||
+				(send(sock, slot->packet, slot->packet_length, 0) == -1 &&
+				 errno != ECONNREFUSED && errno != EAGAIN)) {
+				if (parameters.verbose) {
+					printf(_("Failed to send query for %s\n"), list.queries[index].name);
+				}
+				results[index].status = DIG_BATCH_SEND_ERROR;
+				completed++;
+				continue;
+			}
+			results[index].tries = 1;
+			slot->first_sent = now;
+			slot->deadline = now + try_timeout;
+			in_flight_count++;
+		}
+
+		/* retransmit or expire overdue queries, find the next deadline */
+		double next_deadline = overall_deadline;
+		while (first_pending < next_to_send && results[first_pending].status != DIG_BATCH_PENDING) {
+			first_pending++;
+		}
+		for (size_t index = first_pending; index < next_to_send; index++) {
+			if (results[index].status != DIG_BATCH_PENDING) {
+				continue;
+			}
+			dig_inflight *slot = &inflight[index];
+			if (slot->deadline <= now) {
+				if (results[index].tries >= tries || now >= overall_deadline) {
+					results[index].status = DIG_BATCH_TIMEOUT;
+					in_flight_count--;
+					completed++;
+					continue;
+				}
+				if (parameters.verbose > 1) {
+					printf(_("Retransmitting query for %s\n"), list.queries[index].name);
+				}
+				send(sock, slot->packet, slot->packet_length, 0);
+				results[index].tries++;
+				slot->deadline = now + try_timeout;
+			}
+			if (slot->deadline < next_deadline) {
+				next_deadline = slot->deadline;
+			}
+		}
+
+		if (completed >= list.count) {
+			break;
+		}
+		if (now >= overall_deadline) {
+			for (size_t index = 0; index < list.count; index++) {
+				if (results[index].status == DIG_BATCH_PENDING) {
+					results[index].status = DIG_BATCH_TIMEOUT;
+				}
+			}
+			break;
+		}
+
+		struct pollfd ufds = {
+			.fd = sock,
+			.events = POLLIN,
+		};
+		int wait_ms = (int)ceil((next_deadline - now) * 1000);
+		int poll_result = poll(&ufds, 1, wait_ms > 0 ? wait_ms : 0);
+		if (poll_result == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			die(STATE_UNKNOWN, _("Failed to poll socket: %s\n"), strerror(errno));
+		}
+		if (poll_result == 0) {
+			continue;
+		}
+
+		/* drain everything which has arrived so far */
+		ssize_t received;
+		while ((received = recv(sock, receive_buffer, sizeof(receive_buffer), 0)) > 0) {
+			double receive_time = dig_now();
+			dig_response_header header =
+				dig_parse_response_header(receive_buffer, (size_t)received);
+			if (header.errorcode != OK) {
+				continue;
+			}
+
+			size_t index = (uint16_t)(header.query_id - id_base);
+			if (index >= next_to_send || results[index].status != DIG_BATCH_PENDING ||
+				header.qtype != list.queries[index].qtype ||
+				!dig_names_equal(header.question, list.queries[index].name)) {
+				/* late duplicate or an unrelated packet */
+				continue;
+			}
+
+			results[index].latency = receive_time - inflight[index].first_sent;
+			if (dig_parse_response(receive_buffer, (size_t)received, &results[index]) != OK) {
+				if (parameters.verbose) {
+					printf(_("Malformed response for %s\n"), list.queries[index].name);
+				}
+				results[index].rcode = DIG_RCODE_FORMERR;
+			}
+			results[index].status = DIG_BATCH_ANSWERED;
+			dig_batch_match_answer(&list.queries[index], &results[index]);
+			in_flight_count--;
+			completed++;
+		}
+	}
+
+	free(inflight);
+	close(sock);
+	return results;
+}
+
+double dig_percentile(const double *sorted_values, size_t count, double percentile) {
+	if (count == 0) {
+		return 0;
+	}
+	size_t rank = (size_t)ceil(percentile / 100.0 * (double)count);
+	if (rank < 1) {
+		rank = 1;
+	}
+	if (rank > count) {
+		rank = count;
+	}
+	return sorted_values[rank - 1];
+}
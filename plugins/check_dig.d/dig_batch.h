@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Upper bound on the number of queries which are in flight at the same time */
+#define DIG_BATCH_MAX_INFLIGHT 128
+/* The query id is 16 bit wide, so this is the maximum number of queries per run */
+#define DIG_BATCH_MAX_QUERIES 65535
+
+#define DIG_MAX_PACKET_SIZE 4096
+#define DIG_MAX_QUERY_SIZE  512
+#define DIG_MAX_NAME_LENGTH 1025
+
+/* DNS response codes (RFC 1035, RFC 6895) */
+#define DIG_RCODE_NOERROR  0
+#define DIG_RCODE_FORMERR  1
+#define DIG_RCODE_SERVFAIL 2
+#define DIG_RCODE_NXDOMAIN 3
+#define DIG_RCODE_NOTIMP   4
+#define DIG_RCODE_REFUSED  5
+
+/* A single query of the batch */
+typedef struct {
+	char *name;
+	char *type_name;
+	uint16_t qtype;
+	char *expected; /* string which must be contained in an answer, NULL means `name` */
+} dig_batch_query;
+
+typedef struct {
+	dig_batch_query *queries;
+	size_t count;
+} dig_batch_list;
+
+typedef enum {
+	DIG_BATCH_PENDING = 0,
+	DIG_BATCH_ANSWERED,
+	DIG_BATCH_TIMEOUT,
+	DIG_BATCH_SEND_ERROR,
+} dig_batch_status;
+
+/* The outcome of a single query of the batch */
+typedef struct {
+	dig_batch_status status;
+	int rcode;
+	bool truncated;
+	bool authoritative;
+	unsigned int tries;
+	double latency; /* in seconds, measured from the first transmission */
+
+	char **answers; /* answer records rendered like dig does */
+	size_t answer_count;
+	bool answer_matched;
+	char *matching_answer;
+} dig_batch_result;
+
+typedef struct {
+	const char *server;
+	int port;
+	int address_family;
+	unsigned int tries;
+	double timeout; /* overall time budget in seconds */
+	int verbose;
+} dig_batch_parameters;
+
+/* Parses "NAME[,TYPE[,EXPECTED]]" and appends it to the list */
+int dig_batch_add_query(dig_batch_list list[static 1], const char *spec);
+/* Reads one "NAME [TYPE [EXPECTED]]" entry per line, '#' starts a comment */
+int dig_batch_read_file(dig_batch_list list[static 1], const char *path);
+
+uint16_t dig_record_type_from_string(const char *type_name);
+const char *dig_record_type_to_string(uint16_t type, char buffer[static 16]);
+const char *dig_rcode_to_string(int rcode);
+
+/* Encodes a recursive query into buffer, returns the length or 0 on error */
+size_t dig_encode_query(uint8_t *buffer, size_t buffer_size, uint16_t query_id, const char *name,
+						uint16_t qtype);
+
+typedef struct {
+	int errorcode;
+	uint16_t query_id;
+	char question[DIG_MAX_NAME_LENGTH];
+	uint16_t qtype;
+} dig_response_header;
+
+/* Decodes id and question of a response, so it can be matched to its query */
+dig_response_header dig_parse_response_header(const uint8_t *packet, size_t length);
+/* Decodes flags and the answer section into result */
+int dig_parse_response(const uint8_t *packet, size_t length, dig_batch_result result[static 1]);
+
+/* Matches the answers against the expected string, same semantics as the dig mode */
+void dig_batch_match_answer(const dig_batch_query query[static 1],
+							dig_batch_result result[static 1]);
+
+/*
+ * Sends all queries of the list over a single UDP socket to the server and
+ * collects the responses. Returns an array with one result per query.
+ */
+dig_batch_result *dig_batch_run(dig_batch_parameters parameters, dig_batch_list list);
+
+/* Nearest rank percentile of an ascending sorted array */
+double dig_percentile(const double *sorted_values, size_t count, double percentile);
@@ -36,6 +36,9 @@ const char *email = "devel@monitoring-plugins.org";
 #include "common.h"
 #include "utils.h"
 #include "runcmd.h"
+#include "netutils.h"
+#include "output.h"
+#include "perfdata.h"
 #include "check_game.d/config.h"
 #include "../lib/monitoringplug.h"
 
@@ -45,6 +48,7 @@ typedef struct {
 } check_game_config_wrapper;
 
 static check_game_config_wrapper process_arguments(int /*argc*/, char ** /*argv*/);
+static void check_native(check_game_config /*config*/);
 static void print_help(void);
 void print_usage(void);
 
@@ -73,6 +77,13 @@ int main(int argc, char **argv) {
 
 	check_game_config config = tmp.config;
 
+	if (config.native) {
+		check_native(config);
+	}
+
+#ifndef PATH_TO_QSTAT
+	die(STATE_UNKNOWN, _("check_game was built without qstat, only --native queries work\n"));
+#else
 	mp_state_enum result = STATE_OK;
 
 	/* create the command line to execute */
@@ -141,10 +152,142 @@ int main(int argc, char **argv) {
 	}
 
 	exit(result);
+#endif
+}
+
+/* queries all servers at once without qstat, one subcheck per server */
+void check_native(const check_game_config config) {
+	mp_check overall = mp_check_init();
+
+	game_server *servers = calloc(config.servers_num, sizeof(game_server));
+	if (servers == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the game servers\n"));
+	}
+	for (size_t i = 0; i < config.servers_num; i++) {
+		char *host;
+		char *port;
+		servers[i].name = config.servers[i];
+		if (!game_split_address(config.servers[i], &host, &port) ||
+			!dns_lookup(host, &servers[i].address, address_family)) {
+			die(STATE_UNKNOWN, _("Could not resolve %s\n"), config.servers[i]);
+		}
+
+		unsigned short port_number = game_default_port(config.protocol);
+		if (port != NULL) {
+			if (!is_intpos(port) || atoi(port) > 65535) {
+				die(STATE_UNKNOWN, _("Invalid port in %s\n"), config.servers[i]);
+			}
+			port_number = (unsigned short)atoi(port);
+		} else if (config.port > 0) {
+			port_number = (unsigned short)config.port;
+		}
+		if (servers[i].address.ss_family == AF_INET) {
+			((struct sockaddr_in *)&servers[i].address)->sin_port = htons(port_number);
+			servers[i].address_length = sizeof(struct sockaddr_in);
+		} else {
+			((struct sockaddr_in6 *)&servers[i].address)->sin6_port = htons(port_number);
+			servers[i].address_length = sizeof(struct sockaddr_in6);
+		}
+		free(host);
+		free(port);
+	}
+
+	game_query query = {
+		.servers = servers,
+		.servers_num = config.servers_num,
+		.protocol = config.protocol,
+		.concurrency = config.concurrency,
+		.retries = config.retries,
+		.retransmit_ms = config.retransmit_ms,
+		.timeout = timeout_interval,
+	};
+	game_query_result result = game_query_run(&query);
+	if (result.errorcode != OK) {
+		die(STATE_UNKNOWN, "%s\n", result.error);
+	}
+
+	if (verbose) {
+		printf("%zu of %zu servers answered in %.3fs, %zu invalid replies\n", result.answered,
+			   config.servers_num, result.elapsed, result.invalid);
+	}
+
+	/* subchecks are prepended, so the servers are added in reverse to keep their order */
+	for (size_t i = config.servers_num; i > 0; i--) {
+		const game_server *server = &servers[i - 1];
+		mp_subcheck sc_server = mp_subcheck_init();
+		sc_server = mp_set_subcheck_default_state(sc_server, STATE_OK);
+
+		if (!server->answered) {
+			sc_server = mp_set_subcheck_state(sc_server, STATE_CRITICAL);
+			xasprintf(&sc_server.output, _("%s: Game server timeout"), server->name);
+			mp_add_subcheck_to_check(&overall, sc_server);
+			continue;
+		}
+
+		const game_status *status = &server->status;
+		xasprintf(&sc_server.output, _("%s: %s (%s), %d/%d players, Ping: %.0f ms"), server->name,
+				  status->name, status->map, status->players, status->max_players,
+				  server->latency);
+		if (status->bots > 0) {
+			xasprintf(&sc_server.output, _("%s, %d bots"), sc_server.output, status->bots);
+		}
+
+		mp_perfdata pd_players = perfdata_init();
+		xasprintf(&pd_players.label, "%s_players", server->name);
+		pd_players = mp_set_pd_value(pd_players, status->players);
+		pd_players = mp_set_pd_min_value(pd_players, mp_create_pd_value(0));
+		pd_players = mp_set_pd_max_value(pd_players, mp_create_pd_value(status->max_players));
+		mp_add_perfdata_to_subcheck(&sc_server, pd_players);
+
+		mp_perfdata pd_ping = perfdata_init();
+		xasprintf(&pd_ping.label, "%s_ping", server->name);
+		pd_ping.uom = "ms";
+		pd_ping = mp_set_pd_value(pd_ping, server->latency);
+		pd_ping = mp_set_pd_min_value(pd_ping, mp_create_pd_value(0));
+		mp_add_perfdata_to_subcheck(&sc_server, pd_ping);
+
+		mp_add_subcheck_to_check(&overall, sc_server);
+	}
+
+	char *summary;
+	xasprintf(&summary, _("%zu of %zu game servers answered"), result.answered,
+			  config.servers_num);
+	mp_set_summary(&overall, summary);
+	mp_exit(overall);
+}
+
+static void add_server(check_game_config *config, char *server) {
+	char **servers = realloc(config->servers, (config->servers_num + 1) * sizeof(char *));
+	if (servers == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the game servers\n"));
+	}
+	config->servers = servers;
+	config->servers[config->servers_num++] = server;
+}
+
+/* one server per line, empty lines and lines starting with # are skipped */
+static void read_server_file(check_game_config *config, const char *path) {
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		die(STATE_UNKNOWN, _("Could not open %s: %s\n"), path, strerror(errno));
+	}
+
+	char line[MAX_INPUT_BUFFER];
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char *server = line + strspn(line, " \t");
+		server[strcspn(server, " \t\r\n#")] = '\0';
+		if (server[0] != '\0') {
+			add_server(config, strdup(server));
+		}
+	}
+	fclose(file);
 }
 
 #define players_field_index     129
 #define max_players_field_index 130
+#define native_index            131
+#define server_file_index       132
+#define concurrency_index       133
 
 check_game_config_wrapper process_arguments(int argc, char **argv) {
 	static struct option long_opts[] = {
@@ -160,6 +303,9 @@ check_game_config_wrapper process_arguments(int argc, char **argv) {
 		{"game-field", required_argument, 0, 'g'},
 		{"players-field", required_argument, 0, players_field_index},
 		{"max-players-field", required_argument, 0, max_players_field_index},
+		{"native", no_argument, 0, native_index},
+		{"server-file", required_argument, 0, server_file_index},
+		{"concurrency", required_argument, 0, concurrency_index},
 		{0, 0, 0, 0}};
 
 	check_game_config_wrapper result = {
@@ -208,6 +354,7 @@ check_game_config_wrapper process_arguments(int argc, char **argv) {
 				die(STATE_UNKNOWN, _("Input buffer overflow\n"));
 			}
 			result.config.server_ip = optarg;
+			add_server(&result.config, optarg);
 			break;
 		case 'P': /* port */
 			result.config.port = atoi(optarg);
@@ -261,6 +408,18 @@ check_game_config_wrapper process_arguments(int argc, char **argv) {
 				return result;
 			}
 			break;
+		case native_index:
+			result.config.native = true;
+			break;
+		case server_file_index:
+			read_server_file(&result.config, optarg);
+			break;
+		case concurrency_index:
+			if (!is_intpos(optarg)) {
+				usage2(_("Concurrency must be a positive integer"), optarg);
+			}
+			result.config.concurrency = (size_t)atoi(optarg);
+			break;
 		default: /* args not parsable */
 			usage5();
 		}
@@ -272,9 +431,23 @@ check_game_config_wrapper process_arguments(int argc, char **argv) {
 		result.config.game_type = strdup(argv[option_counter++]);
 	}
 
-	/* Second option is the server name */
+	/* Second option is the server name, the native queries take any number of them */
 	if (!result.config.server_ip && option_counter < argc) {
 		result.config.server_ip = strdup(argv[option_counter++]);
+		add_server(&result.config, result.config.server_ip);
+	}
+	while (result.config.native && option_counter < argc) {
+		add_server(&result.config, argv[option_counter++]);
+	}
+
+	if (result.config.native) {
+		if (result.config.game_type == NULL ||
+			!game_protocol_parse(result.config.game_type, &result.config.protocol)) {
+			usage4(_("The native queries support the game types q3s (Quake 3) and a2s (Source)"));
+		}
+		if (result.config.servers_num == 0) {
+			usage4(_("No game server given"));
+		}
 	}
 
 	return result;
@@ -304,6 +477,14 @@ void print_help(void) {
 	printf("    %s\n", _("Field number in raw qstat output that contains map name"));
 	printf(" %s\n", "-p");
 	printf("    %s\n", _("Field number in raw qstat output that contains ping time"));
+	printf(" %s\n", "--native");
+	printf("    %s\n", _("Query the servers directly instead of running qstat, for the game"));
+	printf("    %s\n", _("types q3s (Quake 3) and a2s (Source). -H may be repeated and more"));
+	printf("    %s\n", _("servers may follow the game type, each as host or host:port"));
+	printf(" %s\n", "--server-file=PATH");
+	printf("    %s\n", _("Read more servers for --native from PATH, one per line"));
+	printf(" %s\n", "--concurrency=INTEGER");
+	printf("    %s\n", _("How many servers --native queries at once (default: 64)"));
 
 	printf(UT_CONN_TIMEOUT, DEFAULT_SOCKET_TIMEOUT);
 
@@ -314,6 +495,8 @@ void print_help(void) {
 	printf(" %s\n",
 		   _("If you don't have the package installed, you will need to download it from"));
 	printf(" %s\n", _("https://github.com/multiplay/qstat before you can use this plugin."));
+	printf(" %s\n", _("With --native all servers are queried at once from one UDP socket and"));
+	printf(" %s\n", _("each server gets its own result, qstat is not needed then."));
 
 	printf(UT_SUPPORT);
 }
@@ -324,6 +507,9 @@ void print_usage(void) {
 		   "game-time] [-H hostname] <game> "
 		   "<ip_address>\n",
 		   progname);
+	printf(" %s --native [-t timeout] [-P port] [--concurrency=INTEGER] [--server-file=PATH] "
+		   "<game> <address>...\n",
+		   progname);
 }
 
 /******************************************************************************
@@ -1,5 +1,6 @@
 #pragma once
 #include "../../config.h"
+#include "./query.h"
 #include <stddef.h>
 
 typedef struct {
@@ -12,6 +13,15 @@ typedef struct {
 	int qstat_game_field;
 	int qstat_map_field;
 	int qstat_ping_field;
+
+	/* the native queries without qstat */
+	bool native;
+	game_protocol protocol;
+	char **servers; /* every -H, the positional addresses and the lines of --server-file */
+	size_t servers_num;
+	size_t concurrency;
+	int retries;
+	long retransmit_ms;
 } check_game_config;
 
 check_game_config check_game_config_init() {
@@ -25,6 +35,14 @@ check_game_config check_game_config_init() {
 		.qstat_map_field = 3,
 		.qstat_game_field = 2,
 		.qstat_ping_field = 5,
+
+		.native = false,
+		.protocol = GAME_QUAKE3,
+		.servers = NULL,
+		.servers_num = 0,
+		.concurrency = 64,
+		.retries = 2,
+		.retransmit_ms = 1000,
 	};
 	return tmp;
 }
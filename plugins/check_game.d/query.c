@@ -0,0 +1,435 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./query.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/time.h>
+
+#define GAME_RECEIVE_BUFFER (1024 * 1024)
+
+static const uint8_t quake3_query[] = "\xff\xff\xff\xffgetstatus\n";
+static const char quake3_reply[] = "\xff\xff\xff\xffstatusResponse";
+static const uint8_t a2s_query[] = "\xff\xff\xff\xffTSource Engine Query";
+
+enum {
+	A2S_CHALLENGE = 'A',
+	A2S_INFO = 'I',
+	A2S_INFO_GOLDSRC = 'm',
+};
+
+bool game_protocol_parse(const char *name, game_protocol *protocol) {
+	if (strcmp(name, "q3s") == 0 || strcmp(name, "quake3") == 0) {
+		*protocol = GAME_QUAKE3;
+		return true;
+	}
+	if (strcmp(name, "a2s") == 0 || strcmp(name, "source") == 0) {
+		*protocol = GAME_A2S;
+		return true;
+	}
+	return false;
+}
+
+unsigned short game_default_port(game_protocol protocol) {
+	return protocol == GAME_QUAKE3 ? GAME_QUAKE3_PORT : GAME_A2S_PORT;
+}
+
+size_t game_build_query(game_protocol protocol, bool has_challenge, uint32_t challenge,
+						uint8_t packet[GAME_MAX_PACKET_LENGTH]) {
+	if (protocol == GAME_QUAKE3) {
+		memcpy(packet, quake3_query, sizeof(quake3_query) - 1);
+		return sizeof(quake3_query) - 1;
+	}
+
+	/* the query string is sent with its terminating zero */
+	size_t length = sizeof(a2s_query);
+	memcpy(packet, a2s_query, length);
+	if (has_challenge) {
+		for (int i = 0; i < 4; i++) {
+			packet[length++] = (uint8_t)(challenge >> (8 * i));
+		}
+	}
+	return length;
+}
+
+/* reads a zero terminated string of an A2S reply */
+static char *read_string(const uint8_t *packet, size_t length, size_t *offset) {
+	const uint8_t *end = memchr(packet + *offset, '\0', length - *offset);
+	if (end == NULL) {
+		return NULL;
+	}
+	char *string = strdup((const char *)packet + *offset);
+	*offset = (size_t)(end - packet) + 1;
+	return string;
+}
+
+static game_reply parse_a2s(const uint8_t *packet, size_t length, game_status *status,
+							uint32_t *challenge) {
+	if (length < 5 || memcmp(packet, "\xff\xff\xff\xff", 4) != 0) {
+		return GAME_REPLY_INVALID;
+	}
+
+	if (packet[4] == A2S_CHALLENGE) {
+		if (length < 9) {
+			return GAME_REPLY_INVALID;
+		}
+		*challenge = (uint32_t)packet[5] | (uint32_t)packet[6] << 8 |
+					 (uint32_t)packet[7] << 16 | (uint32_t)packet[8] << 24;
+		return GAME_REPLY_CHALLENGE;
+	}
+
+	size_t offset = 5;
+	char *address = NULL;
+	if (packet[4] == A2S_INFO) {
+		offset++; /* the protocol version */
+	} else if (packet[4] == A2S_INFO_GOLDSRC) {
+		address = read_string(packet, length, &offset);
+		if (address == NULL) {
+			return GAME_REPLY_INVALID;
+		}
+		free(address);
+	} else {
+		return GAME_REPLY_INVALID;
+	}
+
+	status->name = offset < length ? read_string(packet, length, &offset) : NULL;
+	status->map = status->name != NULL ? read_string(packet, length, &offset) : NULL;
+	char *folder = status->map != NULL ? read_string(packet, length, &offset) : NULL;
+	char *game = folder != NULL ? read_string(packet, length, &offset) : NULL;
+	bool complete = game != NULL;
+	free(folder);
+	free(game);
+
+	/* the Source reply has the application ID before the player counts */
+	if (packet[4] == A2S_INFO) {
+		offset += 2;
+	}
+	if (!complete || offset + 2 > length) {
+		game_status_free(status);
+		return GAME_REPLY_INVALID;
+	}
+	status->players = packet[offset];
+	status->max_players = packet[offset + 1];
+	status->bots = packet[4] == A2S_INFO && offset + 3 <= length ? packet[offset + 2] : 0;
+	return GAME_REPLY_STATUS;
+}
+
+/* removes the colour codes like ^1 from a Quake 3 string */
+static char *strip_colours(const char *value, size_t length) {
+	char *result = malloc(length + 1);
+	if (result == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the server status\n"));
+	}
+	size_t written = 0;
+	for (size_t i = 0; i < length; i++) {
+		if (value[i] == '^' && i + 1 < length && value[i + 1] != '^') {
+			i++;
+			continue;
+		}
+		result[written++] = value[i];
+	}
+	result[written] = '\0';
+	return result;
+}
+
+static game_reply parse_quake3(const uint8_t *packet, size_t length, game_status *status) {
+	size_t prefix = sizeof(quake3_reply) - 1;
+	if (length < prefix || memcmp(packet, quake3_reply, prefix) != 0) {
+		return GAME_REPLY_INVALID;
+	}
+
+	const char *text = (const char *)packet + prefix;
+	const char *end = (const char *)packet + length;
+	while (text < end && (*text == '\n' || *text == ' ')) {
+		text++;
+	}
+
+	/* the server info \key\value\key\value, then one line per player */
+	const char *info_end = memchr(text, '\n', (size_t)(end - text));
+	if (info_end == NULL) {
+		info_end = end;
+	}
+	const char *position = text;
+	while (position < info_end && *position == '\\') {
+		const char *key = position + 1;
+		const char *key_end = memchr(key, '\\', (size_t)(info_end - key));
+		if (key_end == NULL) {
+			break;
+		}
+		const char *value = key_end + 1;
+		const char *value_end = memchr(value, '\\', (size_t)(info_end - value));
+		if (value_end == NULL) {
+			value_end = info_end;
+		}
+
+		size_t key_length = (size_t)(key_end - key);
+		size_t value_length = (size_t)(value_end - value);
+		if (key_length == 11 && strncasecmp(key, "sv_hostname", 11) == 0) {
+			free(status->name);
+			status->name = strip_colours(value, value_length);
+		} else if (key_length == 7 && strncasecmp(key, "mapname", 7) == 0) {
+			free(status->map);
+			status->map = strip_colours(value, value_length);
+		} else if (key_length == 13 && strncasecmp(key, "sv_maxclients", 13) == 0) {
+			status->max_players = atoi(value);
+		}
+		position = value_end;
+	}
+
+	status->players = 0;
+	status->bots = 0;
+	for (const char *line = info_end; line < end;) {
+		line++;
+		const char *line_end = memchr(line, '\n', (size_t)(end - line));
+		if (line_end == NULL) {
+			line_end = end;
+		}
+		if (line_end > line) {
+			status->players++;
+		}
+		line = line_end;
+	}
+
+	if (status->name == NULL) {
+		status->name = strdup("");
+	}
+	if (status->map == NULL) {
+		status->map = strdup("");
+	}
+	return GAME_REPLY_STATUS;
+}
+
+game_reply game_parse_reply(game_protocol protocol, const uint8_t *packet, size_t length,
+							game_status *status, uint32_t *challenge) {
+	*status = (game_status){0};
+	if (protocol == GAME_QUAKE3) {
+		return parse_quake3(packet, length, status);
+	}
+	return parse_a2s(packet, length, status, challenge);
+}
+
+void game_status_free(game_status *status) {
+	free(status->name);
+	free(status->map);
+	status->name = NULL;
+	status->map = NULL;
+}
+
+bool game_split_address(const char *argument, char **host, char **port) {
+	*port = NULL;
+	if (argument[0] == '[') {
+		const char *close = strchr(argument, ']');
+		if (close == NULL || (close[1] != '\0' && close[1] != ':')) {
+			return false;
+		}
+		*host = strndup(argument + 1, (size_t)(close - argument - 1));
+		if (close[1] == ':') {
+			*port = strdup(close + 2);
+		}
+		return true;
+	}
+
+	/* an address with more than one colon is IPv6 without a port */
+	const char *colon = strchr(argument, ':');
+	if (colon == NULL || strchr(colon + 1, ':') != NULL) {
+		*host = strdup(argument);
+		return true;
+	}
+	*host = strndup(argument, (size_t)(colon - argument));
+	*port = strdup(colon + 1);
+	return true;
+}
+
+static double elapsed_ms(struct timeval start) { return delta_time(start) * 1000.0; }
+
+/* orders the servers by address so that a reply can be matched with bsearch */
+static int compare_addresses(const struct sockaddr_storage *left,
+							 const struct sockaddr_storage *right) {
+	if (left->ss_family != right->ss_family) {
+		return left->ss_family < right->ss_family ? -1 : 1;
+	}
+	if (left->ss_family == AF_INET) {
+		const struct sockaddr_in *left4 = (const struct sockaddr_in *)left;
+		const struct sockaddr_in *right4 = (const struct sockaddr_in *)right;
+		if (left4->sin_port != right4->sin_port) {
+			return left4->sin_port < right4->sin_port ? -1 : 1;
+		}
+		return memcmp(&left4->sin_addr, &right4->sin_addr, sizeof(struct in_addr));
+	}
+	const struct sockaddr_in6 *left6 = (const struct sockaddr_in6 *)left;
+	const struct sockaddr_in6 *right6 = (const struct sockaddr_in6 *)right;
+	if (left6->sin6_port != right6->sin6_port) {
+		return left6->sin6_port < right6->sin6_port ? -1 : 1;
+	}
+	return memcmp(&left6->sin6_addr, &right6->sin6_addr, sizeof(struct in6_addr));
+}
+
+static int compare_servers(const void *left, const void *right) {
+	return compare_addresses(&(*(game_server *const *)left)->address,
+							 &(*(game_server *const *)right)->address);
+}
+
+static int compare_reply(const void *address, const void *server) {
+	return compare_addresses(address, &(*(game_server *const *)server)->address);
+}
+
+static void transmit(int sock, game_protocol protocol, game_server *server, double now) {
+	uint8_t packet[GAME_MAX_PACKET_LENGTH];
+	size_t length = game_build_query(protocol, server->has_challenge, server->challenge, packet);
+	/* a failed send is not retried at once, the retransmit covers it */
+	sendto(sock, packet, length, 0, (struct sockaddr *)&server->address,
+		   server->address_length);
+	server->last_sent = now;
+}
+
+static void receive_replies(int sock, game_query *query, game_server **sorted,
+							struct timeval start, size_t *waiting, game_query_result *result) {
+	while (true) {
+		uint8_t packet[GAME_MAX_PACKET_LENGTH];
+		struct sockaddr_storage from = {0};
+		socklen_t from_length = sizeof(from);
+		ssize_t length =
+			recvfrom(sock, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_length);
+		if (length < 0) {
+			return;
+		}
+
+		game_server **found = bsearch(&from, sorted, query->servers_num, sizeof(game_server *),
+									  compare_reply);
+		if (found == NULL || !(*found)->waiting) {
+			result->invalid++;
+			continue;
+		}
+		game_server *server = *found;
+
+		uint32_t challenge = 0;
+		game_status status;
+		switch (game_parse_reply(query->protocol, packet, (size_t)length, &status, &challenge)) {
+		case GAME_REPLY_STATUS:
+			server->latency = elapsed_ms(start) - server->first_sent;
+			server->status = status;
+			server->answered = true;
+			server->waiting = false;
+			(*waiting)--;
+			result->answered++;
+			break;
+		case GAME_REPLY_CHALLENGE:
+			/* the answer to a challenge is not a retry and its round trip is not latency */
+			server->has_challenge = true;
+			server->challenge = challenge;
+			transmit(sock, query->protocol, server, elapsed_ms(start));
+			server->first_sent = server->last_sent;
+			break;
+		case GAME_REPLY_INVALID:
+		default:
+			result->invalid++;
+			break;
+		}
+	}
+}
+
+game_query_result game_query_run(game_query *query) {
+	game_query_result result = {
+		.errorcode = OK,
+		.error = NULL,
+	};
+
+	int family = query->servers[0].address.ss_family;
+	game_server **sorted = calloc(query->servers_num, sizeof(game_server *));
+	if (sorted == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the game servers\n"));
+	}
+	for (size_t i = 0; i < query->servers_num; i++) {
+		if (query->servers[i].address.ss_family != family) {
+			result.errorcode = ERROR;
+			xasprintf(&result.error, _("all servers need the same address family"));
+			free(sorted);
+			return result;
+		}
+		sorted[i] = &query->servers[i];
+	}
+	qsort(sorted, query->servers_num, sizeof(game_server *), compare_servers);
+	for (size_t i = 1; i < query->servers_num; i++) {
+		if (compare_servers(&sorted[i - 1], &sorted[i]) == 0) {
+			result.errorcode = ERROR;
+			xasprintf(&result.error, _("%s and %s are the same server"), sorted[i - 1]->name,
+					  sorted[i]->name);
+			free(sorted);
+			return result;
+		}
+	}
+
+	int sock = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0 || fcntl(sock, F_SETFL, O_NONBLOCK) < 0) {
+		int error = errno;
+		if (sock >= 0) {
+			close(sock);
+		}
+		result.errorcode = ERROR;
+		xasprintf(&result.error, _("could not open a UDP socket: %s"), strerror(error));
+		free(sorted);
+		return result;
+	}
+	/* the replies of many servers may arrive at once, a failure only means more retries */
+	int receive_buffer = GAME_RECEIVE_BUFFER;
+	setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	size_t next = 0;
+	size_t waiting = 0;
+
+	while ((next < query->servers_num || waiting > 0) &&
+		   elapsed_ms(start) < query->timeout * 1000) {
+		while (next < query->servers_num && waiting < query->concurrency) {
+			game_server *server = &query->servers[next++];
+			server->waiting = true;
+			server->sent = 1;
+			transmit(sock, query->protocol, server, elapsed_ms(start));
+			server->first_sent = server->last_sent;
+			waiting++;
+		}
+
+		/* retry the servers which did not answer in time and find the next retry */
+		double now = elapsed_ms(start);
+		double next_due = query->timeout * 1000;
+		for (size_t i = 0; i < next; i++) {
+			game_server *server = &query->servers[i];
+			if (!server->waiting) {
+				continue;
+			}
+			if (now - server->last_sent >= (double)query->retransmit_ms) {
+				if (server->sent > query->retries) {
+					server->waiting = false;
+					waiting--;
+					continue;
+				}
+				server->sent++;
+				transmit(sock, query->protocol, server, now);
+			}
+			if (server->last_sent + (double)query->retransmit_ms < next_due) {
+				next_due = server->last_sent + (double)query->retransmit_ms;
+			}
+		}
+
+		if (waiting == 0) {
+			continue;
+		}
+
+		int wait = (int)(next_due - now) + 1;
+		struct pollfd descriptor = {
+			.fd = sock,
+			.events = POLLIN,
+		};
+		if (poll(&descriptor, 1, wait > 0 ? wait : 0) > 0) {
+			receive_replies(sock, query, sorted, start, &waiting, &result);
+		}
+	}
+
+	result.elapsed = delta_time(start);
+	close(sock);
+	free(sorted);
+	return result;
+}
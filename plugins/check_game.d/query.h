@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/*
+ * A native client for the UDP status queries of Quake 3 ("getstatus") and
+ * Source (A2S_INFO) game servers. Many servers are queried at once from
+ * one socket, the replies are told apart by their source address.
+ */
+
+#define GAME_MAX_PACKET_LENGTH 1400
+#define GAME_QUAKE3_PORT       27960
+#define GAME_A2S_PORT          27015
+
+typedef enum {
+	GAME_QUAKE3,
+	GAME_A2S,
+} game_protocol;
+
+/* accepts the qstat names q3s and a2s as well as quake3 and source */
+bool game_protocol_parse(const char *name, game_protocol *protocol);
+unsigned short game_default_port(game_protocol protocol);
+
+typedef struct {
+	char *name;
+	char *map;
+	int players;
+	int max_players;
+	int bots; /* only reported by A2S */
+} game_status;
+
+typedef enum {
+	GAME_REPLY_INVALID,
+	GAME_REPLY_STATUS,
+	GAME_REPLY_CHALLENGE, /* A2S servers may ask to repeat the query with a challenge */
+} game_reply;
+
+/* returns the length of the query, the challenge is only used by A2S */
+size_t game_build_query(game_protocol protocol, bool has_challenge, uint32_t challenge,
+						uint8_t packet[GAME_MAX_PACKET_LENGTH]);
+
+/* fills status or challenge, the strings of status are allocated */
+game_reply game_parse_reply(game_protocol protocol, const uint8_t *packet, size_t length,
+							game_status *status, uint32_t *challenge);
+
+void game_status_free(game_status *status);
+
+/* splits "host", "host:port" and "[address]:port", port is NULL if there is none */
+bool game_split_address(const char *argument, char **host, char **port);
+
+typedef struct {
+	const char *name; /* as given on the command line */
+	struct sockaddr_storage address;
+	socklen_t address_length;
+
+	/* the state of the query */
+	bool waiting; /* for a reply */
+	int sent;
+	double first_sent; /* milliseconds since the start of the run, restarted by a challenge */
+	double last_sent;
+	bool has_challenge;
+	uint32_t challenge;
+
+	bool answered;
+	double latency; /* milliseconds between the first query and the reply */
+	game_status status;
+} game_server;
+
+typedef struct {
+	game_server *servers;
+	size_t servers_num;
+	game_protocol protocol;
+	size_t concurrency; /* the most servers waiting for a reply at once */
+	int retries;
+	long retransmit_ms;
+	double timeout; /* seconds for the whole run */
+} game_query;
+
+typedef struct {
+	int errorcode;
+	char *error; /* why the run failed, or NULL */
+	size_t answered;
+	size_t invalid; /* replies which could not be parsed or came from unknown addresses */
+	double elapsed; /* seconds */
+} game_query_result;
+
+game_query_result game_query_run(game_query *query);
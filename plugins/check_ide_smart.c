@@ -40,7 +40,12 @@ const char *email = "devel@monitoring-plugins.org";
 #include "common.h"
 #include "utils.h"
 #include "check_ide_smart.d/config.h"
+#include "check_ide_smart.d/nvme.h"
+#include "check_ide_smart.d/scan.h"
 #include "states.h"
+#include "output.h"
+#include "perfdata.h"
+#include "thresholds.h"
 
 static void print_help(void);
 void print_usage(void);
@@ -137,21 +142,83 @@ enum SmartCommand {
 	SMART_CMD_AUTO_OFFLINE
 };
 
+/* the result of comparing the SMART values with their thresholds */
+typedef struct {
+	int status; /* PREFAILURE, ADVISORY or OPERATIONAL */
+	int prefailure;
+	int advisory;
+	int failed;
+	int passed;
+	int total;
+} smart_evaluation;
+
+/* where probing a device in --scan or --all-nvme failed */
+enum ProbeStep {
+	PROBE_STEP_OPEN,
+	PROBE_STEP_ENABLE,
+	PROBE_STEP_READ_VALUES,
+	PROBE_STEP_READ_THRESHOLDS,
+	PROBE_STEP_NVME_LOG
+};
+
+static char *probe_step_text[] = {"open", "SMART_CMD_ENABLE", "SMART_READ_VALUES",
+								  "SMART_READ_THRESHOLDS", "NVMe SMART / Health Information log"};
+
 static char *get_offline_text(int /*status*/);
 static int smart_read_values(int /*fd*/, smart_values * /*values*/);
+static smart_evaluation evaluate_values_and_thresholds(smart_values * /*p*/,
+														smart_thresholds * /*t*/);
 static mp_state_enum compare_values_and_thresholds(smart_values * /*p*/, smart_thresholds * /*t*/);
 static void print_value(smart_value * /*p*/, smart_threshold * /*t*/);
 static void print_values(smart_values * /*p*/, smart_thresholds * /*t*/);
 static mp_state_enum smart_cmd_simple(int /*fd*/, enum SmartCommand /*command*/, uint8_t /*val0*/,
 									  bool /*show_error*/);
 static int smart_read_thresholds(int /*fd*/, smart_thresholds * /*thresholds*/);
+static mp_subcheck evaluate_nvme(const char * /*device*/, check_ide_smart_config /*config*/);
+static mp_subcheck evaluate_nvme_health(const char * /*device*/, nvme_health /*health*/,
+										check_ide_smart_config /*config*/);
+static mp_subcheck evaluate_ata(const char * /*device*/, smart_values * /*values*/,
+								smart_thresholds * /*thresholds*/);
+static void probe_device(const char * /*device*/, smart_probe_result * /*result*/);
+static mp_subcheck evaluate_probe(const char * /*device*/, smart_probe_status /*status*/,
+								  smart_probe_result * /*result*/,
+								  check_ide_smart_config /*config*/);
 static int verbose = 0;
 
+/* the texts for the bits of the NVMe critical warning */
+static struct {
+	uint8_t bit;
+	char *text;
+} nvme_warning_text[] = {
+	{NVME_WARNING_SPARE, "available spare below threshold"},
+	{NVME_WARNING_TEMPERATURE, "temperature outside of the limits"},
+	{NVME_WARNING_DEGRADED, "reliability degraded"},
+	{NVME_WARNING_READ_ONLY, "media in read only mode"},
+	{NVME_WARNING_VOLATILE, "volatile memory backup failed"},
+	{NVME_WARNING_PMR, "persistent memory region read only"},
+	{0, 0}};
+
 typedef struct {
 	int errorcode;
 	check_ide_smart_config config;
 } check_ide_smart_config_wrapper;
 static check_ide_smart_config_wrapper process_arguments(int argc, char **argv) {
+	enum {
+		nvme_index = CHAR_MAX + 1,
+		all_nvme_index,
+		temperature_warning_index,
+		temperature_critical_index,
+		percentage_used_warning_index,
+		percentage_used_critical_index,
+		media_errors_warning_index,
+		media_errors_critical_index,
+		available_spare_warning_index,
+		available_spare_critical_index,
+		scan_index,
+		device_timeout_index,
+		output_format_index,
+	};
+
 	static struct option longopts[] = {
 		{"device", required_argument, 0, 'd'},
 		{"immediate", no_argument, 0, 'i'},
@@ -161,6 +228,19 @@ static check_ide_smart_config_wrapper process_arguments(int argc, char **argv) {
 		{"nagios", no_argument, 0, 'n'}, /* DEPRECATED, but we still accept it */
 		{"help", no_argument, 0, 'h'},
 		{"version", no_argument, 0, 'V'},
+		{"nvme", no_argument, 0, nvme_index},
+		{"all-nvme", no_argument, 0, all_nvme_index},
+		{"temperature-warning", required_argument, 0, temperature_warning_index},
+		{"temperature-critical", required_argument, 0, temperature_critical_index},
+		{"percentage-used-warning", required_argument, 0, percentage_used_warning_index},
+		{"percentage-used-critical", required_argument, 0, percentage_used_critical_index},
+		{"media-errors-warning", required_argument, 0, media_errors_warning_index},
+		{"media-errors-critical", required_argument, 0, media_errors_critical_index},
+		{"available-spare-warning", required_argument, 0, available_spare_warning_index},
+		{"available-spare-critical", required_argument, 0, available_spare_critical_index},
+		{"scan", no_argument, 0, scan_index},
+		{"device-timeout", required_argument, 0, device_timeout_index},
+		{"output-format", required_argument, 0, output_format_index},
 		{0, 0, 0, 0}};
 
 	check_ide_smart_config_wrapper result = {
@@ -207,6 +287,66 @@ static check_ide_smart_config_wrapper process_arguments(int argc, char **argv) {
 		case 'V':
 			print_revision(progname, NP_VERSION);
 			exit(STATE_UNKNOWN);
+		case nvme_index:
+			result.config.nvme = true;
+			break;
+		case all_nvme_index:
+			result.config.all_nvme = true;
+			break;
+		case scan_index:
+			result.config.scan = true;
+			break;
+		case device_timeout_index:
+			if (!is_intpos(optarg)) {
+				usage2(_("Device timeout must be a positive integer"), optarg);
+			}
+			result.config.device_timeout = (unsigned int)atoi(optarg);
+			break;
+		case temperature_warning_index:
+		case temperature_critical_index:
+		case percentage_used_warning_index:
+		case percentage_used_critical_index:
+		case media_errors_warning_index:
+		case media_errors_critical_index:
+		case available_spare_warning_index:
+		case available_spare_critical_index: {
+			mp_range_parsed range = mp_parse_range_string(optarg);
+			if (range.error != MP_PARSING_SUCCESS) {
+				die(STATE_UNKNOWN, _("failed to parse threshold: %s"), optarg);
+			}
+
+			mp_thresholds *thresholds = &result.config.th_available_spare;
+			if (option_index == temperature_warning_index ||
+				option_index == temperature_critical_index) {
+				thresholds = &result.config.th_temperature;
+			} else if (option_index == percentage_used_warning_index ||
+					   option_index == percentage_used_critical_index) {
+				thresholds = &result.config.th_percentage_used;
+			} else if (option_index == media_errors_warning_index ||
+					   option_index == media_errors_critical_index) {
+				thresholds = &result.config.th_media_errors;
+			}
+
+			bool warning = option_index == temperature_warning_index ||
+						   option_index == percentage_used_warning_index ||
+						   option_index == media_errors_warning_index ||
+						   option_index == available_spare_warning_index;
+			*thresholds = warning ? mp_thresholds_set_warn(*thresholds, range.range)
+								  : mp_thresholds_set_crit(*thresholds, range.range);
+			/* the thresholds only exist for NVMe */
+			result.config.nvme = true;
+		} break;
+		case output_format_index: {
+			parsed_output_format parser = mp_parse_output_format(optarg);
+			if (!parser.parsing_success) {
+				printf("Invalid output format: %s\n", optarg);
+				exit(STATE_UNKNOWN);
+			}
+
+			result.config.output_format_is_set = true;
+			result.config.output_format = parser.output_format;
+			break;
+		}
 		default:
 			usage5();
 		}
@@ -216,11 +356,15 @@ static check_ide_smart_config_wrapper process_arguments(int argc, char **argv) {
 		result.config.device = argv[optind];
 	}
 
-	if (result.config.device == NULL) {
+	if (result.config.device == NULL && !result.config.all_nvme && !result.config.scan) {
 		print_help();
 		exit(STATE_UNKNOWN);
 	}
 
+	if (result.config.device != NULL && nvme_is_device_name(result.config.device)) {
+		result.config.nvme = true;
+	}
+
 	return result;
 }
 
@@ -240,6 +384,55 @@ int main(int argc, char *argv[]) {
 
 	check_ide_smart_config config = tmp_config.config;
 
+	if (config.output_format_is_set) {
+		mp_set_format(config.output_format);
+	}
+
+	if (config.all_nvme || config.scan) {
+		char **devices = NULL;
+		size_t device_count = 0;
+		if (config.scan) {
+			device_count = smart_list_block_devices(SMART_SYS_BLOCK, SMART_DEV_DIR, &devices);
+			if (device_count == 0) {
+				die(STATE_UNKNOWN, _("No disks found in %s\n"), SMART_SYS_BLOCK);
+			}
+		} else {
+			device_count = nvme_list_controllers(NVME_DEV_DIR, &devices);
+			if (device_count == 0) {
+				die(STATE_UNKNOWN, _("No NVMe controllers found in %s\n"), NVME_DEV_DIR);
+			}
+		}
+
+		smart_probe_status *statuses = calloc(device_count, sizeof(smart_probe_status));
+		smart_probe_result *results = calloc(device_count, sizeof(smart_probe_result));
+		if (statuses == NULL || results == NULL) {
+			die(STATE_UNKNOWN, _("Could not allocate memory for the device probes\n"));
+		}
+		smart_probe_devices(devices, device_count, probe_device, config.device_timeout, statuses,
+							results);
+
+		mp_check overall = mp_check_init();
+		/* subchecks are prepended, so the first device is added last */
+		for (size_t i = device_count; i > 0; i--) {
+			mp_add_subcheck_to_check(&overall, evaluate_probe(devices[i - 1], statuses[i - 1],
+															  &results[i - 1], config));
+		}
+
+		char *ok_summary = NULL;
+		xasprintf(&ok_summary, _("%zu disks are healthy"), device_count);
+		mp_set_ok_summary(&overall, ok_summary);
+		smart_free_devices(devices, device_count);
+		free(statuses);
+		free(results);
+		mp_exit(overall);
+	}
+
+	if (config.nvme) {
+		mp_check overall = mp_check_init();
+		mp_add_subcheck_to_check(&overall, evaluate_nvme(config.device, config));
+		mp_exit(overall);
+	}
+
 	int device_file_descriptor = open(config.device, OPEN_MODE);
 
 	if (device_file_descriptor < 0) {
@@ -322,35 +515,44 @@ int smart_read_values(int file_descriptor, smart_values *values) {
 	return 0;
 }
 
-mp_state_enum compare_values_and_thresholds(smart_values *values, smart_thresholds *thresholds) {
+smart_evaluation evaluate_values_and_thresholds(smart_values *values,
+												smart_thresholds *thresholds) {
 	smart_value *value = values->values;
 	smart_threshold *threshold = thresholds->thresholds;
 
-	int status = OPERATIONAL;
-	int prefailure = 0;
-	int advisory = 0;
-	int failed = 0;
-	int passed = 0;
-	int total = 0;
+	smart_evaluation result = {
+		.status = OPERATIONAL,
+	};
 	for (int i = 0; i < NR_ATTRIBUTES; i++) {
 		if (value->id && threshold->id && value->id == threshold->id) {
 			if (value->value < threshold->threshold) {
-				++failed;
+				++result.failed;
 				if (value->status & 1) {
-					status = PREFAILURE;
-					++prefailure;
+					result.status = PREFAILURE;
+					++result.prefailure;
 				} else {
-					status = ADVISORY;
-					++advisory;
+					result.status = ADVISORY;
+					++result.advisory;
 				}
 			} else {
-				++passed;
+				++result.passed;
 			}
-			++total;
+			++result.total;
 		}
 		++value;
 		++threshold;
 	}
+	return result;
+}
+
+mp_state_enum compare_values_and_thresholds(smart_values *values, smart_thresholds *thresholds) {
+	smart_evaluation evaluation = evaluate_values_and_thresholds(values, thresholds);
+	int status = evaluation.status;
+	int prefailure = evaluation.prefailure;
+	int advisory = evaluation.advisory;
+	int failed = evaluation.failed;
+	int passed = evaluation.passed;
+	int total = evaluation.total;
 
 	switch (status) {
 	case PREFAILURE:
@@ -513,6 +715,217 @@ int smart_read_thresholds(int file_descriptor, smart_thresholds *thresholds) {
 	return 0;
 }
 
+static mp_subcheck nvme_metric(const char *device_name, const char *label, const char *name,
+								mp_perfdata_value value, const char *uom,
+								mp_thresholds thresholds) {
+	mp_perfdata perfdata = perfdata_init();
+	xasprintf(&perfdata.label, "%s_%s", device_name, label);
+	perfdata.value = value;
+	perfdata.uom = (char *)uom;
+	perfdata = mp_pd_set_thresholds(perfdata, thresholds);
+
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_state(result, mp_get_pd_status(perfdata));
+	xasprintf(&result.output, "%s: %s%s", name, pd_value_to_string(value), uom);
+	mp_add_perfdata_to_subcheck(&result, perfdata);
+	return result;
+}
+
+/* the SMART / Health Information log page of one NVMe controller or namespace */
+mp_subcheck evaluate_nvme(const char *device, check_ide_smart_config config) {
+	mp_subcheck result = mp_subcheck_init();
+
+	int device_file_descriptor = open(device, O_RDONLY);
+	if (device_file_descriptor < 0) {
+		result = mp_set_subcheck_state(result, STATE_CRITICAL);
+		xasprintf(&result.output, _("Couldn't open device %s: %s"), device, strerror(errno));
+		return result;
+	}
+
+	uint8_t log[NVME_SMART_LOG_SIZE];
+	int error = nvme_read_smart_log(device_file_descriptor, log);
+	close(device_file_descriptor);
+	if (error != 0) {
+		result = mp_set_subcheck_state(result, STATE_CRITICAL);
+		xasprintf(&result.output, _("%s: reading the SMART / Health Information log failed: %s"),
+				  device, strerror(error));
+		return result;
+	}
+
+	return evaluate_nvme_health(device, nvme_parse_smart_log(log), config);
+}
+
+mp_subcheck evaluate_nvme_health(const char *device, nvme_health health,
+								 check_ide_smart_config config) {
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+
+	const char *device_name = strrchr(device, '/');
+	device_name = (device_name != NULL) ? device_name + 1 : device;
+
+	if (verbose) {
+		printf("%s: CriticalWarning=0x%02x, Temperature=%dC, AvailableSpare=%u%% "
+			   "(Threshold=%u%%), PercentageUsed=%u%%\n",
+			   device, health.critical_warning, health.temperature, health.available_spare,
+			   health.available_spare_threshold, health.percentage_used);
+		printf("%s: PowerOnHours=%llu, PowerCycles=%llu, UnsafeShutdowns=%llu, "
+			   "MediaErrors=%llu, ErrorLogEntries=%llu\n",
+			   device, (unsigned long long)health.power_on_hours,
+			   (unsigned long long)health.power_cycles,
+			   (unsigned long long)health.unsafe_shutdowns,
+			   (unsigned long long)health.media_errors,
+			   (unsigned long long)health.error_log_entries);
+	}
+
+	xasprintf(&result.output, "%s", device);
+
+	/* the controller sets these bits itself, each of them is critical */
+	mp_subcheck sc_warning = mp_subcheck_init();
+	sc_warning = mp_set_subcheck_default_state(sc_warning, STATE_OK);
+	xasprintf(&sc_warning.output, _("Critical warning: none"));
+	if (health.critical_warning != 0) {
+		sc_warning = mp_set_subcheck_state(sc_warning, STATE_CRITICAL);
+		xasprintf(&sc_warning.output, _("Critical warning 0x%02x:"), health.critical_warning);
+		for (int index = 0; nvme_warning_text[index].text; index++) {
+			if (health.critical_warning & nvme_warning_text[index].bit) {
+				xasprintf(&sc_warning.output, "%s %s", sc_warning.output,
+						  _(nvme_warning_text[index].text));
+			}
+		}
+	}
+	mp_add_subcheck_to_subcheck(&result, sc_warning);
+
+	mp_add_subcheck_to_subcheck(&result, nvme_metric(device_name, "temperature", _("Temperature"),
+													 mp_create_pd_value(health.temperature), "C",
+													 config.th_temperature));
+	mp_add_subcheck_to_subcheck(
+		&result, nvme_metric(device_name, "percentage_used", _("Percentage used"),
+							 mp_create_pd_value((unsigned int)health.percentage_used), "%",
+							 config.th_percentage_used));
+	mp_add_subcheck_to_subcheck(
+		&result, nvme_metric(device_name, "available_spare", _("Available spare"),
+							 mp_create_pd_value((unsigned int)health.available_spare), "%",
+							 config.th_available_spare));
+	mp_add_subcheck_to_subcheck(
+		&result, nvme_metric(device_name, "media_errors", _("Media errors"),
+							 mp_create_pd_value((unsigned long long)health.media_errors), "",
+							 config.th_media_errors));
+
+	const char *counter_labels[] = {"power_on_hours", "unsafe_shutdowns", "error_log_entries"};
+	const char *counter_uoms[] = {"", "c", "c"};
+	uint64_t counters[] = {health.power_on_hours, health.unsafe_shutdowns,
+						   health.error_log_entries};
+	for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+		mp_perfdata perfdata = perfdata_init();
+		xasprintf(&perfdata.label, "%s_%s", device_name, counter_labels[i]);
+		perfdata.value = mp_create_pd_value((unsigned long long)counters[i]);
+		perfdata.uom = (char *)counter_uoms[i];
+		mp_add_perfdata_to_subcheck(&result, perfdata);
+	}
+
+	return result;
+}
+
+/* the ATA SMART attributes of one disk, the same evaluation as for a single device */
+mp_subcheck evaluate_ata(const char *device, smart_values *values, smart_thresholds *thresholds) {
+	smart_evaluation evaluation = evaluate_values_and_thresholds(values, thresholds);
+	if (verbose) {
+		printf("%s:\n", device);
+		print_values(values, thresholds);
+	}
+
+	mp_subcheck result = mp_subcheck_init();
+	switch (evaluation.status) {
+	case PREFAILURE:
+		result = mp_set_subcheck_state(result, STATE_CRITICAL);
+		xasprintf(&result.output, _("%s: %d Harddrive PreFailure%s Detected! %d/%d tests failed."),
+				  device, evaluation.prefailure, evaluation.prefailure > 1 ? "s" : "",
+				  evaluation.failed, evaluation.total);
+		break;
+	case ADVISORY:
+		result = mp_set_subcheck_state(result, STATE_WARNING);
+		xasprintf(&result.output, _("%s: %d Harddrive Advisor%s Detected. %d/%d tests failed."),
+				  device, evaluation.advisory, evaluation.advisory > 1 ? "ies" : "y",
+				  evaluation.failed, evaluation.total);
+		break;
+	default:
+		result = mp_set_subcheck_state(result, STATE_OK);
+		xasprintf(&result.output, _("%s: Operational (%d/%d tests passed)"), device,
+				  evaluation.passed, evaluation.total);
+		break;
+	}
+
+	const char *device_name = strrchr(device, '/');
+	device_name = (device_name != NULL) ? device_name + 1 : device;
+	mp_perfdata perfdata = perfdata_init();
+	xasprintf(&perfdata.label, "%s_failed_attributes", device_name);
+	perfdata.value = mp_create_pd_value(evaluation.failed);
+	mp_add_perfdata_to_subcheck(&result, perfdata);
+
+	return result;
+}
+
+/* runs in a process of its own, see smart_probe_devices() */
+void probe_device(const char *device, smart_probe_result *result) {
+	result->step = PROBE_STEP_OPEN;
+	int device_file_descriptor = open(device, nvme_is_device_name(device) ? O_RDONLY : OPEN_MODE);
+	if (device_file_descriptor < 0) {
+		result->error = errno;
+		return;
+	}
+
+	if (nvme_is_device_name(device)) {
+		result->step = PROBE_STEP_NVME_LOG;
+		result->error = nvme_read_smart_log(device_file_descriptor, result->data);
+	} else {
+		result->step = PROBE_STEP_ENABLE;
+		errno = 0;
+		if (smart_cmd_simple(device_file_descriptor, SMART_CMD_ENABLE, 0, false)) {
+			result->error = errno != 0 ? errno : EIO;
+		}
+		if (result->error == 0) {
+			result->step = PROBE_STEP_READ_VALUES;
+			result->error =
+				smart_read_values(device_file_descriptor, (smart_values *)result->data);
+		}
+		if (result->error == 0) {
+			result->step = PROBE_STEP_READ_THRESHOLDS;
+			result->error = smart_read_thresholds(
+				device_file_descriptor, (smart_thresholds *)(result->data + sizeof(smart_values)));
+		}
+	}
+	close(device_file_descriptor);
+}
+
+mp_subcheck evaluate_probe(const char *device, smart_probe_status status,
+						   smart_probe_result *result, check_ide_smart_config config) {
+	mp_subcheck subcheck = mp_subcheck_init();
+	if (status == SMART_PROBE_TIMEOUT) {
+		subcheck = mp_set_subcheck_state(subcheck, STATE_CRITICAL);
+		xasprintf(&subcheck.output, _("%s: no answer within %u seconds"), device,
+				  config.device_timeout);
+		return subcheck;
+	}
+	if (status == SMART_PROBE_FAILED) {
+		subcheck = mp_set_subcheck_state(subcheck, STATE_UNKNOWN);
+		xasprintf(&subcheck.output, _("%s: could not be probed: %s"), device,
+				  strerror(result->error != 0 ? result->error : ECHILD));
+		return subcheck;
+	}
+	if (result->error != 0) {
+		subcheck = mp_set_subcheck_state(subcheck, STATE_CRITICAL);
+		xasprintf(&subcheck.output, _("%s: %s failed: %s"), device,
+				  probe_step_text[result->step], strerror(result->error));
+		return subcheck;
+	}
+
+	if (result->step == PROBE_STEP_NVME_LOG) {
+		return evaluate_nvme_health(device, nvme_parse_smart_log(result->data), config);
+	}
+	return evaluate_ata(device, (smart_values *)result->data,
+						(smart_thresholds *)(result->data + sizeof(smart_values)));
+}
+
 void print_help(void) {
 	print_revision(progname, NP_VERSION);
 
@@ -538,6 +951,30 @@ void print_help(void) {
 
 	printf(UT_VERBOSE);
 
+	printf(" %s\n", "--nvme");
+	printf("    %s\n", _("Read the SMART / Health Information log of an NVMe controller or"));
+	printf("    %s\n", _("namespace.  Implied for devices called nvme*."));
+	printf(" %s\n", "--all-nvme");
+	printf("    %s\n", _("Check every NVMe controller in /dev, -d is not needed then."));
+	printf(" %s\n", "--scan");
+	printf("    %s\n", _("Check every disk in /sys/block at the same time, ATA and NVMe alike,"));
+	printf("    %s\n", _("with one subcheck per disk."));
+	printf(" %s\n", "--device-timeout=SECONDS");
+	printf("    %s\n", _("Seconds a disk may take to answer with --scan or --all-nvme before"));
+	printf("    %s %d%s\n", _("it is reported as CRITICAL (default:"), SMART_DEVICE_TIMEOUT, ")");
+	printf(" %s\n", "--temperature-warning=RANGE, --temperature-critical=RANGE");
+	printf("    %s\n", _("Thresholds for the composite temperature in degrees Celsius"));
+	printf(" %s\n", "--percentage-used-warning=RANGE, --percentage-used-critical=RANGE");
+	printf("    %s\n", _("Thresholds for the estimated percentage of the endurance used"));
+	printf(" %s\n", "--available-spare-warning=RANGE, --available-spare-critical=RANGE");
+	printf("    %s\n", _("Thresholds for the available spare in percent, e.g. 20: alerts"));
+	printf("    %s\n", _("below 20%"));
+	printf(" %s\n", "--media-errors-warning=RANGE, --media-errors-critical=RANGE");
+	printf("    %s\n", _("Thresholds for the number of unrecovered data integrity errors"));
+	printf("    %s\n", _("Any bit in the critical warning of the controller is CRITICAL."));
+
+	printf(UT_OUTPUT_FORMAT);
+
 	printf("\n");
 	printf("%s\n", _("Notes:"));
 	printf(" %s\n",
@@ -565,5 +1002,14 @@ void print_help(void) {
 
 void print_usage(void) {
 	printf("%s\n", _("Usage:"));
-	printf("%s [-d <device>] [-v]", progname);
+	printf("%s [-d <device>] [-v]\n", progname);
+	printf("%s [--nvme] -d <device>|--all-nvme|--scan [--device-timeout=SECONDS]\n", progname);
+	printf("  [--temperature-warning=RANGE] [--temperature-critical=RANGE]\n");
+	printf("  [--percentage-used-warning=RANGE]");
+	printf(" [--percentage-used-critical=RANGE]\n");
+	printf("  [--available-spare-warning=RANGE]");
+	printf(" [--available-spare-critical=RANGE]\n");
+	printf("  [--media-errors-warning=RANGE]");
+	printf(" [--media-errors-critical=RANGE]\n");
+	printf("  [--output-format=OUTPUT_FORMAT]\n");
 }
@@ -1,15 +1,45 @@
 #pragma once
 
 #include "../../config.h"
+#include "output.h"
+#include "thresholds.h"
+#include "scan.h"
 #include <stddef.h>
 
 typedef struct {
 	char *device;
+
+	/* read the NVMe SMART / Health Information log instead of the ATA SMART values */
+	bool nvme;
+	/* every NVMe controller in /dev */
+	bool all_nvme;
+	/* every disk in /sys/block */
+	bool scan;
+	/* seconds a disk may take to answer in the two modes above */
+	unsigned int device_timeout;
+	mp_thresholds th_temperature;
+	mp_thresholds th_percentage_used;
+	mp_thresholds th_media_errors;
+	mp_thresholds th_available_spare;
+
+	bool output_format_is_set;
+	mp_output_format output_format;
 } check_ide_smart_config;
 
 check_ide_smart_config check_ide_smart_init() {
 	check_ide_smart_config tmp = {
 		.device = NULL,
+
+		.nvme = false,
+		.all_nvme = false,
+		.scan = false,
+		.device_timeout = SMART_DEVICE_TIMEOUT,
+		.th_temperature = mp_thresholds_init(),
+		.th_percentage_used = mp_thresholds_init(),
+		.th_media_errors = mp_thresholds_init(),
+		.th_available_spare = mp_thresholds_init(),
+
+		.output_format_is_set = false,
 	};
 	return tmp;
 }
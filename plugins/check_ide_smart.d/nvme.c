@@ -0,0 +1,142 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./nvme.h"
+#include "./scan.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+#ifdef HAVE_LINUX_NVME_IOCTL_H
+#	include <linux/nvme_ioctl.h>
+#endif
+
+/* offsets in the SMART / Health Information log page */
+#define NVME_LOG_CRITICAL_WARNING   0
+#define NVME_LOG_TEMPERATURE        1
+#define NVME_LOG_AVAILABLE_SPARE    3
+#define NVME_LOG_SPARE_THRESHOLD    4
+#define NVME_LOG_PERCENTAGE_USED    5
+#define NVME_LOG_DATA_UNITS_READ    32
+#define NVME_LOG_DATA_UNITS_WRITTEN 48
+#define NVME_LOG_POWER_CYCLES       112
+#define NVME_LOG_POWER_ON_HOURS     128
+#define NVME_LOG_UNSAFE_SHUTDOWNS   144
+#define NVME_LOG_MEDIA_ERRORS       160
+#define NVME_LOG_ERROR_LOG_ENTRIES  176
+
+static uint64_t nvme_le_read(const uint8_t *bytes, size_t length) {
+	uint64_t result = 0;
+	for (size_t i = length; i > 0; i--) {
+		result = (result << 8) | bytes[i - 1];
+	}
+	return result;
+}
+
+/* the counters are 128 bit wide, nobody will see the upper half in practice */
+static uint64_t nvme_le_read_counter(const uint8_t *bytes) {
+	if (nvme_le_read(bytes + 8, 8) != 0) {
+		return UINT64_MAX;
+	}
+	return nvme_le_read(bytes, 8);
+}
+
+nvme_health nvme_parse_smart_log(const uint8_t log[NVME_SMART_LOG_SIZE]) {
+	nvme_health result = {
+		.critical_warning = log[NVME_LOG_CRITICAL_WARNING],
+		.temperature =
+			(int)nvme_le_read(log + NVME_LOG_TEMPERATURE, 2) - NVME_KELVIN_TO_CELSIUS,
+		.available_spare = log[NVME_LOG_AVAILABLE_SPARE],
+		.available_spare_threshold = log[NVME_LOG_SPARE_THRESHOLD],
+		.percentage_used = log[NVME_LOG_PERCENTAGE_USED],
+		.data_units_read = nvme_le_read_counter(log + NVME_LOG_DATA_UNITS_READ),
+		.data_units_written = nvme_le_read_counter(log + NVME_LOG_DATA_UNITS_WRITTEN),
+		.power_cycles = nvme_le_read_counter(log + NVME_LOG_POWER_CYCLES),
+		.power_on_hours = nvme_le_read_counter(log + NVME_LOG_POWER_ON_HOURS),
+		.unsafe_shutdowns = nvme_le_read_counter(log + NVME_LOG_UNSAFE_SHUTDOWNS),
+		.media_errors = nvme_le_read_counter(log + NVME_LOG_MEDIA_ERRORS),
+		.error_log_entries = nvme_le_read_counter(log + NVME_LOG_ERROR_LOG_ENTRIES),
+	};
+	return result;
+}
+
+int nvme_read_smart_log(int file_descriptor, uint8_t log[NVME_SMART_LOG_SIZE]) {
+#ifdef HAVE_LINUX_NVME_IOCTL_H
+	memset(log, 0, NVME_SMART_LOG_SIZE);
+
+	struct nvme_admin_cmd command;
+	memset(&command, 0, sizeof(command));
+	command.opcode = NVME_ADMIN_GET_LOG_PAGE;
+	command.nsid = NVME_NSID_ALL;
+	command.addr = (uint64_t)(uintptr_t)log;
+	command.data_len = NVME_SMART_LOG_SIZE;
+	/* the log page id and the number of dwords to read minus one */
+	command.cdw10 = NVME_LOG_SMART | (((NVME_SMART_LOG_SIZE / 4) - 1) << 16);
+
+	if (ioctl(file_descriptor, NVME_IOCTL_ADMIN_CMD, &command) < 0) {
+		return errno;
+	}
+	return 0;
+#else
+	(void)file_descriptor;
+	(void)log;
+	return ENOTSUP;
+#endif
+}
+
+bool nvme_is_device_name(const char *path) {
+	const char *name = strrchr(path, '/');
+	name = (name != NULL) ? name + 1 : path;
+	return strncmp(name, "nvme", 4) == 0 && isdigit((unsigned char)name[4]);
+}
+
+/* nvme0 but not nvme0n1 or nvme-fabrics */
+static bool nvme_is_controller_name(const char *name) {
+	if (strncmp(name, "nvme", 4) != 0 || name[4] == '\0') {
+		return false;
+	}
+	for (const char *digit = name + 4; *digit != '\0'; digit++) {
+		if (!isdigit((unsigned char)*digit)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t nvme_list_controllers(const char *dev_dir, char ***devices) {
+	*devices = NULL;
+	DIR *directory = opendir(dev_dir);
+	if (directory == NULL) {
+		return 0;
+	}
+
+	size_t count = 0;
+	struct dirent *entry;
+	while ((entry = readdir(directory)) != NULL) {
+		if (!nvme_is_controller_name(entry->d_name)) {
+			continue;
+		}
+		char **bigger = realloc(*devices, (count + 1) * sizeof(char *));
+		if (bigger == NULL) {
+			die(STATE_UNKNOWN, _("Could not allocate memory for the device list\n"));
+		}
+		*devices = bigger;
+		xasprintf(&(*devices)[count], "%s/%s", dev_dir, entry->d_name);
+		count++;
+	}
+	closedir(directory);
+
+	if (count > 1) {
+		qsort(*devices, count, sizeof(char *), smart_compare_device_names);
+	}
+	return count;
+}
+
+void nvme_free_devices(char **devices, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		free(devices[i]);
+	}
+	free(devices);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define NVME_DEV_DIR             "/dev"
+#define NVME_SMART_LOG_SIZE      512
+#define NVME_LOG_SMART           0x02
+#define NVME_ADMIN_GET_LOG_PAGE  0x02
+#define NVME_NSID_ALL            0xffffffffU
+#define NVME_KELVIN_TO_CELSIUS   273
+
+/* bits of the critical warning field of the SMART / Health Information log */
+#define NVME_WARNING_SPARE       0x01
+#define NVME_WARNING_TEMPERATURE 0x02
+#define NVME_WARNING_DEGRADED    0x04
+#define NVME_WARNING_READ_ONLY   0x08
+#define NVME_WARNING_VOLATILE    0x10
+#define NVME_WARNING_PMR         0x20
+
+/* the fields of the SMART / Health Information log page (02h) a check needs */
+typedef struct {
+	uint8_t critical_warning;
+	int temperature; /* degrees Celsius of the composite temperature */
+	uint8_t available_spare;
+	uint8_t available_spare_threshold;
+	uint8_t percentage_used;
+	/* the log has 128 bit counters, they are saturated at 64 bits */
+	uint64_t data_units_read;
+	uint64_t data_units_written;
+	uint64_t power_cycles;
+	uint64_t power_on_hours;
+	uint64_t unsafe_shutdowns;
+	uint64_t media_errors;
+	uint64_t error_log_entries;
+} nvme_health;
+
+/* decodes the little endian log page */
+nvme_health nvme_parse_smart_log(const uint8_t log[NVME_SMART_LOG_SIZE]);
+
+/*
+ * Reads the SMART / Health Information log page of a controller with the
+ * admin passthrough ioctl, works on the controller and the namespace devices.
+ * Returns 0 or an errno value.
+ */
+int nvme_read_smart_log(int file_descriptor, uint8_t log[NVME_SMART_LOG_SIZE]);
+
+/* whether the name of a device looks like an NVMe controller or namespace */
+bool nvme_is_device_name(const char *path);
+
+/*
+ * The controller character devices (nvme0, nvme1, ...) in dev_dir, sorted.
+ * Returns the number of devices, *devices has to be freed with nvme_free_devices.
+ */
+size_t nvme_list_controllers(const char *dev_dir, char ***devices);
+void nvme_free_devices(char **devices, size_t count);
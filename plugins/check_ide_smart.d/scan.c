@@ -0,0 +1,264 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./scan.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* block devices with a "device" link which have no SMART data */
+static const char *smart_skipped_prefixes[] = {"sr", "fd", "nbd", NULL};
+
+int smart_compare_device_names(const void *left, const void *right) {
+	const char *left_name = *(char *const *)left;
+	const char *right_name = *(char *const *)right;
+	size_t left_length = strlen(left_name);
+	size_t right_length = strlen(right_name);
+	if (left_length != right_length) {
+		return left_length < right_length ? -1 : 1;
+	}
+	return strcmp(left_name, right_name);
+}
+
+/* the length of "nvme0n" in "nvme0n1", 0 if the name is no NVMe namespace */
+static size_t smart_nvme_controller_prefix(const char *name) {
+	if (strncmp(name, "nvme", 4) != 0 || !isdigit((unsigned char)name[4])) {
+		return 0;
+	}
+	const char *position = name + 4;
+	while (isdigit((unsigned char)*position)) {
+		position++;
+	}
+	return *position == 'n' ? (size_t)(position - name) + 1 : 0;
+}
+
+size_t smart_list_block_devices(const char *sys_block, const char *dev_dir, char ***devices) {
+	*devices = NULL;
+	DIR *directory = opendir(sys_block);
+	if (directory == NULL) {
+		return 0;
+	}
+
+	char **names = NULL;
+	size_t count = 0;
+	struct dirent *entry;
+	while ((entry = readdir(directory)) != NULL) {
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+
+		bool skipped = false;
+		for (int i = 0; smart_skipped_prefixes[i] != NULL; i++) {
+			size_t length = strlen(smart_skipped_prefixes[i]);
+			skipped = skipped || strncmp(entry->d_name, smart_skipped_prefixes[i], length) == 0;
+		}
+
+		/* loop, ram, zram, dm and md devices have no hardware behind them */
+		char *link = NULL;
+		xasprintf(&link, "%s/device", entry->d_name);
+		bool physical = faccessat(dirfd(directory), link, F_OK, 0) == 0;
+		free(link);
+		if (skipped || !physical) {
+			continue;
+		}
+
+		char **bigger = realloc(names, (count + 1) * sizeof(char *));
+		if (bigger == NULL) {
+			die(STATE_UNKNOWN, _("Could not allocate memory for the device list\n"));
+		}
+		names = bigger;
+		names[count++] = strdup(entry->d_name);
+	}
+	closedir(directory);
+
+	if (count > 1) {
+		qsort(names, count, sizeof(char *), smart_compare_device_names);
+	}
+
+	/* every namespace of a controller returns the same health log */
+	size_t kept = 0;
+	for (size_t i = 0; i < count; i++) {
+		size_t prefix = smart_nvme_controller_prefix(names[i]);
+		bool duplicate = false;
+		for (size_t j = 0; prefix > 0 && j < i && !duplicate; j++) {
+			duplicate = smart_nvme_controller_prefix(names[j]) == prefix &&
+						strncmp(names[i], names[j], prefix) == 0;
+		}
+		if (duplicate) {
+			continue;
+		}
+
+		char **bigger = realloc(*devices, (kept + 1) * sizeof(char *));
+		if (bigger == NULL) {
+			die(STATE_UNKNOWN, _("Could not allocate memory for the device list\n"));
+		}
+		*devices = bigger;
+		xasprintf(&(*devices)[kept++], "%s/%s", dev_dir, names[i]);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		free(names[i]);
+	}
+	free(names);
+
+	return kept;
+}
+
+void smart_free_devices(char **devices, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		free(devices[i]);
+	}
+	free(devices);
+}
+
+static long smart_milliseconds_left(struct timespec deadline) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long)(deadline.tv_sec - now.tv_sec) * 1000 +
+		   (deadline.tv_nsec - now.tv_nsec) / 1000000;
+}
+
+void smart_probe_devices(char *const devices[], size_t count, smart_probe_function probe,
+						 unsigned int timeout, smart_probe_status statuses[],
+						 smart_probe_result results[]) {
+	pid_t *children = calloc(count, sizeof(pid_t));
+	int *pipes = calloc(count, sizeof(int));
+	size_t *received = calloc(count, sizeof(size_t));
+	struct pollfd *poll_fds = calloc(count, sizeof(struct pollfd));
+	size_t *poll_index = calloc(count, sizeof(size_t));
+	if (children == NULL || pipes == NULL || received == NULL || poll_fds == NULL ||
+		poll_index == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the device probes\n"));
+	}
+
+	fflush(stdout);
+	size_t pending = 0;
+	for (size_t i = 0; i < count; i++) {
+		statuses[i] = SMART_PROBE_FAILED;
+		pipes[i] = -1;
+		children[i] = -1;
+		memset(&results[i], 0, sizeof(smart_probe_result));
+
+		int ends[2];
+		if (pipe(ends) != 0) {
+			results[i].error = errno;
+			continue;
+		}
+
+		children[i] = fork();
+		if (children[i] < 0) {
+			results[i].error = errno;
+			close(ends[0]);
+			close(ends[1]);
+			continue;
+		}
+
+		if (children[i] == 0) {
+			close(ends[0]);
+			int null_fd = open("/dev/null", O_WRONLY);
+			if (null_fd >= 0) {
+				dup2(null_fd, STDOUT_FILENO);
+				dup2(null_fd, STDERR_FILENO);
+				close(null_fd);
+			}
+			alarm(0);
+
+			smart_probe_result result;
+			memset(&result, 0, sizeof(result));
+			probe(devices[i], &result);
+
+			const char *buffer = (const char *)&result;
+			size_t written = 0;
+			while (written < sizeof(result)) {
+				ssize_t got = write(ends[1], buffer + written, sizeof(result) - written);
+				if (got <= 0) {
+					break;
+				}
+				written += (size_t)got;
+			}
+			_exit(written == sizeof(result) ? 0 : 1);
+		}
+
+		close(ends[1]);
+		fcntl(ends[0], F_SETFL, fcntl(ends[0], F_GETFL) | O_NONBLOCK);
+		pipes[i] = ends[0];
+		pending++;
+	}
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout;
+
+	while (pending > 0) {
+		long left = smart_milliseconds_left(deadline);
+		if (left <= 0) {
+			break;
+		}
+
+		nfds_t poll_count = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (pipes[i] >= 0) {
+				poll_fds[poll_count].fd = pipes[i];
+				poll_fds[poll_count].events = POLLIN;
+				poll_fds[poll_count].revents = 0;
+				poll_index[poll_count++] = i;
+			}
+		}
+
+		int ready = poll(poll_fds, poll_count, (int)left);
+		if (ready < 0 && errno != EINTR) {
+			break;
+		}
+
+		for (nfds_t j = 0; ready > 0 && j < poll_count; j++) {
+			if (poll_fds[j].revents == 0) {
+				continue;
+			}
+			size_t i = poll_index[j];
+			char *buffer = (char *)&results[i];
+			ssize_t got =
+				read(pipes[i], buffer + received[i], sizeof(smart_probe_result) - received[i]);
+			if (got > 0) {
+				received[i] += (size_t)got;
+				if (received[i] < sizeof(smart_probe_result)) {
+					continue;
+				}
+			} else if (got < 0 && (errno == EAGAIN || errno == EINTR)) {
+				continue;
+			}
+
+			/* complete, or the probe died before it was */
+			statuses[i] = received[i] == sizeof(smart_probe_result) ? SMART_PROBE_DONE
+																   : SMART_PROBE_FAILED;
+			close(pipes[i]);
+			pipes[i] = -1;
+			pending--;
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (pipes[i] >= 0) {
+			/* a process in an uninterruptible ioctl may only die later, it is not waited for */
+			statuses[i] = SMART_PROBE_TIMEOUT;
+			memset(&results[i], 0, sizeof(smart_probe_result));
+			kill(children[i], SIGKILL);
+			close(pipes[i]);
+		}
+		if (children[i] > 0) {
+			waitpid(children[i], NULL, WNOHANG);
+		}
+	}
+
+	free(children);
+	free(pipes);
+	free(received);
+	free(poll_fds);
+	free(poll_index);
+}
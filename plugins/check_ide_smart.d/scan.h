@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../../config.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define SMART_SYS_BLOCK         "/sys/block"
+#define SMART_DEV_DIR           "/dev"
+#define SMART_DEVICE_TIMEOUT    5
+/* room for the ATA values and thresholds or the NVMe log page */
+#define SMART_PROBE_DATA_SIZE   1024
+
+/* what a probe of one device hands back to the plugin */
+typedef struct {
+	int error; /* 0 or an errno value */
+	int step;  /* where it failed, defined by the caller */
+	uint8_t data[SMART_PROBE_DATA_SIZE];
+} smart_probe_result;
+
+typedef enum {
+	SMART_PROBE_DONE,
+	SMART_PROBE_TIMEOUT,
+	SMART_PROBE_FAILED, /* the probe could not be started or died */
+} smart_probe_status;
+
+typedef void (*smart_probe_function)(const char *device, smart_probe_result *result);
+
+/*
+ * The disks in sys_block as devices in dev_dir. Virtual devices without a
+ * "device" link and optical drives are skipped, NVMe namespaces are reduced
+ * to one per controller. Returns the number of devices, *devices has to be
+ * freed with smart_free_devices.
+ */
+size_t smart_list_block_devices(const char *sys_block, const char *dev_dir, char ***devices);
+void smart_free_devices(char **devices, size_t count);
+
+/* orders sda before sdb before sdaa and nvme2 before nvme10, for qsort on char * */
+int smart_compare_device_names(const void *left, const void *right);
+
+/*
+ * Runs probe for all devices at the same time, each in a process of its own,
+ * so a drive hanging in an ioctl is only reported as SMART_PROBE_TIMEOUT
+ * after timeout seconds instead of stalling the others. The output of the
+ * probes is discarded.
+ */
+void smart_probe_devices(char *const devices[], size_t count, smart_probe_function probe,
+						 unsigned int timeout, smart_probe_status statuses[],
+						 smart_probe_result results[]);
@@ -34,8 +34,11 @@
 #include "thresholds.h"
 #include "utils.h"
 #include "check_ldap.d/config.h"
+#include "check_ldap.d/search.h"
+#include "check_ldap.d/replicas.h"
 
 #include "states.h"
+#include <poll.h>
 #include <lber.h>
 #define LDAP_DEPRECATED 1
 #include <ldap.h>
@@ -55,6 +58,8 @@ typedef struct {
 static check_ldap_config_wrapper process_arguments(int /*argc*/, char ** /*argv*/);
 static check_ldap_config_wrapper validate_arguments(check_ldap_config_wrapper /*config_wrapper*/);
 
+static mp_subcheck check_replicas(check_ldap_config /*config*/);
+
 static void print_help(void);
 void print_usage(void);
 
@@ -100,6 +105,11 @@ int main(int argc, char *argv[]) {
 
 	mp_set_ok_summary(&overall, "LDAP check succeeded");
 
+	if (config.replicas_num > 0) {
+		mp_add_subcheck_to_check(&overall, check_replicas(config));
+		mp_exit(overall);
+	}
+
 	LDAP *ldap_connection;
 	/* initialize ldap */
 	{
@@ -215,8 +225,11 @@ int main(int argc, char *argv[]) {
 	/* bind to the ldap server */
 	{
 		mp_subcheck sc_ldap_bind = mp_subcheck_init();
+		struct timeval bind_start;
+		gettimeofday(&bind_start, NULL);
 		int ldap_error =
 			ldap_bind_s(ldap_connection, config.ld_binddn, config.ld_passwd, LDAP_AUTH_SIMPLE);
+		double bind_time = delta_time(bind_start);
 		if (ldap_error != LDAP_SUCCESS) {
 			if (verbose) {
 				ldap_perror(ldap_connection, "ldap_bind");
@@ -230,40 +243,74 @@ int main(int argc, char *argv[]) {
 		} else {
 			xasprintf(&sc_ldap_bind.output, "execute bind to the LDAP server");
 			sc_ldap_bind = mp_set_subcheck_state(sc_ldap_bind, STATE_OK);
+
+			mp_perfdata pd_bind_time = perfdata_init();
+			pd_bind_time.label = "bind_time";
+			pd_bind_time.uom = "s";
+			pd_bind_time = mp_set_pd_value(pd_bind_time, bind_time);
+			mp_add_perfdata_to_subcheck(&sc_ldap_bind, pd_bind_time);
+
 			mp_add_subcheck_to_check(&overall, sc_ldap_bind);
 		}
 	}
 
-	LDAPMessage *result;
-	/* do a search of all objectclasses in the base dn */
+	/*
+	 * do a search of all objectclasses in the base dn, the entries are
+	 * counted as they arrive instead of keeping the whole result
+	 */
+	long num_entries;
 	{
 		mp_subcheck sc_ldap_search = mp_subcheck_init();
-		int ldap_error = ldap_search_s(
+		ldap_async_search search = ldap_async_search_init(
 			ldap_connection, config.ld_base,
 			(config.entries_thresholds.warning_is_set || config.entries_thresholds.critical_is_set)
 				? LDAP_SCOPE_SUBTREE
 				: LDAP_SCOPE_BASE,
-			config.ld_attr, NULL, 0, &result);
+			config.ld_attr, config.page_size);
 
-		if (ldap_error != LDAP_SUCCESS) {
+		if (ldap_async_search_start(&search) == LDAP_SUCCESS) {
+			ldap_async_search_poll(&search, NULL);
+		}
+
+		if (search.error != LDAP_SUCCESS) {
 			if (verbose) {
 				ldap_perror(ldap_connection, "ldap_search");
 			}
 			xasprintf(&sc_ldap_search.output, "could not search/find objectclasses in %s: %s",
-					  config.ld_base, ldap_err2string(ldap_error));
+					  config.ld_base, ldap_err2string(search.error));
 			sc_ldap_search = mp_set_subcheck_state(sc_ldap_search, STATE_CRITICAL);
 			mp_add_subcheck_to_check(&overall, sc_ldap_search);
 			mp_exit(overall);
-		} else {
-			xasprintf(&sc_ldap_search.output, "search/find objectclasses in %s", config.ld_base);
-			sc_ldap_search = mp_set_subcheck_state(sc_ldap_search, STATE_OK);
-			mp_add_subcheck_to_check(&overall, sc_ldap_search);
 		}
+
+		if (verbose) {
+			printf("search took %.3fs in %d page(s)\n", search.complete_time, search.pages);
+		}
+		xasprintf(&sc_ldap_search.output, "search/find objectclasses in %s", config.ld_base);
+		sc_ldap_search = mp_set_subcheck_state(sc_ldap_search, STATE_OK);
+
+		if (search.first_entry_time >= 0) {
+			mp_perfdata pd_first_entry_time = perfdata_init();
+			pd_first_entry_time.label = "first_entry_time";
+			pd_first_entry_time.uom = "s";
+			pd_first_entry_time = mp_set_pd_value(pd_first_entry_time, search.first_entry_time);
+			mp_add_perfdata_to_subcheck(&sc_ldap_search, pd_first_entry_time);
+		}
+
+		mp_perfdata pd_search_time = perfdata_init();
+		pd_search_time.label = "search_time";
+		pd_search_time.uom = "s";
+		pd_search_time = mp_set_pd_value(pd_search_time, search.complete_time);
+		mp_add_perfdata_to_subcheck(&sc_ldap_search, pd_search_time);
+
+		mp_add_subcheck_to_check(&overall, sc_ldap_search);
+
+		num_entries = search.entries;
+		ldap_async_search_free(&search);
 	}
 
-	int num_entries = ldap_count_entries(ldap_connection, result);
 	if (verbose) {
-		printf("entries found: %d\n", num_entries);
+		printf("entries found: %ld\n", num_entries);
 	}
 
 	/* unbind from the ldap server */
@@ -303,7 +350,7 @@ int main(int argc, char *argv[]) {
 
 	mp_subcheck sc_num_entries = mp_subcheck_init();
 	mp_add_perfdata_to_subcheck(&sc_num_entries, pd_num_entries);
-	xasprintf(&sc_num_entries.output, "found %d entries", num_entries);
+	xasprintf(&sc_num_entries.output, "found %ld entries", num_entries);
 	sc_num_entries = mp_set_subcheck_state(sc_num_entries, mp_get_pd_status(pd_num_entries));
 
 	mp_add_subcheck_to_check(&overall, sc_num_entries);
@@ -311,10 +358,304 @@ int main(int argc, char *argv[]) {
 	mp_exit(overall);
 }
 
+typedef enum {
+	REPLICA_BINDING,
+	REPLICA_SEARCHING,
+	REPLICA_DONE,
+} ldap_replica_phase;
+
+/* one server of the replica set, all of them are bound and searched at the same time */
+typedef struct {
+	const char *host;
+	LDAP *ld;
+	ldap_replica_phase phase;
+	int bind_msgid;
+	ldap_async_search search;
+	char *error; /* why the server could not be checked, or NULL */
+	struct timeval start_time;
+	double time; /* seconds until the search completed */
+	ldap_csn_set csns;
+} ldap_replica;
+
+/* the change times of the base entry, contextCSN if the server has one */
+static void collect_change_times(LDAP *ld, LDAPMessage *entry, void *data) {
+	ldap_replica *replica = data;
+	char buffer[64];
+
+	struct berval **values = ldap_get_values_len(ld, entry, "contextCSN");
+	for (int i = 0; values != NULL && values[i] != NULL; i++) {
+		snprintf(buffer, sizeof(buffer), "%.*s", (int)values[i]->bv_len, values[i]->bv_val);
+		ldap_csn csn;
+		if (ldap_csn_parse(buffer, &csn)) {
+			ldap_csn_set_add(&replica->csns, csn);
+		}
+	}
+	ldap_value_free_len(values);
+	if (replica->csns.count > 0) {
+		return;
+	}
+
+	values = ldap_get_values_len(ld, entry, "modifyTimestamp");
+	if (values != NULL && values[0] != NULL) {
+		snprintf(buffer, sizeof(buffer), "%.*s", (int)values[0]->bv_len, values[0]->bv_val);
+		ldap_csn csn = {
+			.sid = LDAP_CSN_NO_SID,
+		};
+		if (ldap_generalized_time_parse(buffer, &csn.time)) {
+			ldap_csn_set_add(&replica->csns, csn);
+		}
+	}
+	ldap_value_free_len(values);
+}
+
+static void replica_fail(ldap_replica *replica, const char *what, int ldap_error) {
+	xasprintf(&replica->error, "%s: %s", what, ldap_err2string(ldap_error));
+	replica->phase = REPLICA_DONE;
+}
+
+/* connects and sends the bind, the connection itself is not asynchronous */
+static void replica_start(ldap_replica *replica, check_ldap_config config,
+						  struct timeval *network_timeout) {
+	gettimeofday(&replica->start_time, NULL);
+	replica->phase = REPLICA_BINDING;
+
+	replica->ld = ldap_init(replica->host, config.ld_port);
+	if (replica->ld == NULL) {
+		xasprintf(&replica->error, "could not connect to the server at port %i", config.ld_port);
+		replica->phase = REPLICA_DONE;
+		return;
+	}
+#ifdef HAVE_LDAP_SET_OPTION
+	ldap_set_option(replica->ld, LDAP_OPT_PROTOCOL_VERSION, &config.ld_protocol);
+#endif
+#ifdef LDAP_OPT_NETWORK_TIMEOUT
+	ldap_set_option(replica->ld, LDAP_OPT_NETWORK_TIMEOUT, network_timeout);
+#else
+	(void)network_timeout;
+#endif
+
+	if (config.ld_port == LDAPS_PORT || config.ssl_on_connect) {
+#if defined(HAVE_LDAP_SET_OPTION) && defined(LDAP_OPT_X_TLS)
+		int tls = LDAP_OPT_X_TLS_HARD;
+		int ldap_error = ldap_set_option(replica->ld, LDAP_OPT_X_TLS, &tls);
+		if (ldap_error != LDAP_SUCCESS) {
+			replica_fail(replica, "could not init TLS", ldap_error);
+			return;
+		}
+#endif
+	} else if (config.starttls) {
+#if defined(HAVE_LDAP_SET_OPTION) && defined(HAVE_LDAP_START_TLS_S)
+		int version = LDAP_VERSION3;
+		ldap_set_option(replica->ld, LDAP_OPT_PROTOCOL_VERSION, &version);
+		int ldap_error = ldap_start_tls_s(replica->ld, NULL, NULL);
+		if (ldap_error != LDAP_SUCCESS) {
+			replica_fail(replica, "could not init STARTTLS", ldap_error);
+			return;
+		}
+#endif
+	}
+
+	replica->bind_msgid = ldap_simple_bind(replica->ld, config.ld_binddn, config.ld_passwd);
+	if (replica->bind_msgid < 0) {
+		int ldap_error = LDAP_SERVER_DOWN;
+		ldap_get_option(replica->ld, LDAP_OPT_RESULT_CODE, &ldap_error);
+		replica_fail(replica, "could not bind to the LDAP server", ldap_error);
+	}
+}
+
+/* handles what arrived from the server without waiting */
+static void replica_step(ldap_replica *replica, check_ldap_config config) {
+	static char *change_attributes[] = {"contextCSN", "modifyTimestamp", NULL};
+	struct timeval no_wait = {0, 0};
+
+	if (replica->phase == REPLICA_BINDING) {
+		LDAPMessage *message = NULL;
+		int type = ldap_result(replica->ld, replica->bind_msgid, LDAP_MSG_ALL, &no_wait, &message);
+		if (type == 0) {
+			return;
+		}
+		int ldap_error = LDAP_SERVER_DOWN;
+		if (type < 0) {
+			ldap_get_option(replica->ld, LDAP_OPT_RESULT_CODE, &ldap_error);
+		} else {
+			ldap_error = ldap_result2error(replica->ld, message, 1);
+		}
+		if (ldap_error != LDAP_SUCCESS) {
+			replica_fail(replica, "could not bind to the LDAP server", ldap_error);
+			return;
+		}
+
+		replica->search = ldap_async_search_init(replica->ld, config.ld_base, LDAP_SCOPE_BASE,
+												 "(objectClass=*)", 0);
+		replica->search.attributes = change_attributes;
+		replica->search.entry_callback = collect_change_times;
+		replica->search.callback_data = replica;
+		if (ldap_async_search_start(&replica->search) != LDAP_SUCCESS) {
+			replica_fail(replica, "could not search the base", replica->search.error);
+			return;
+		}
+		replica->phase = REPLICA_SEARCHING;
+	}
+
+	if (replica->phase == REPLICA_SEARCHING &&
+		ldap_async_search_poll(&replica->search, &no_wait)) {
+		if (replica->search.error != LDAP_SUCCESS) {
+			replica_fail(replica, "could not search the base", replica->search.error);
+			return;
+		}
+		replica->time = delta_time(replica->start_time);
+		replica->phase = REPLICA_DONE;
+	}
+}
+
+/*
+ * Reads the change times of the base from every server and compares them
+ * with the newest one, a replica which has not seen the newest change of
+ * a provider lags behind by the difference.
+ */
+static mp_subcheck check_replicas(check_ldap_config config) {
+	size_t replicas_num = config.replicas_num + 1;
+	ldap_replica *replicas = calloc(replicas_num, sizeof(ldap_replica));
+	if (replicas == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the replicas\n"));
+	}
+	replicas[0].host = config.ld_host;
+	for (size_t i = 1; i < replicas_num; i++) {
+		replicas[i].host = config.replicas[i - 1];
+	}
+
+	/* servers which are down must not use up the time of the others */
+	struct timeval network_timeout = {
+		.tv_sec = socket_timeout / (2 * replicas_num) > 0 ? socket_timeout / (2 * replicas_num) : 1,
+	};
+	struct timeval start_time;
+	gettimeofday(&start_time, NULL);
+	for (size_t i = 0; i < replicas_num; i++) {
+		replica_start(&replicas[i], config, &network_timeout);
+	}
+
+	/* leave a second before the alarm to report which servers did not answer */
+	double deadline = socket_timeout > 1 ? socket_timeout - 1 : 1;
+	struct pollfd *fds = calloc(replicas_num, sizeof(struct pollfd));
+	if (fds == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the replicas\n"));
+	}
+	while (delta_time(start_time) < deadline) {
+		size_t pending = 0;
+		nfds_t fds_num = 0;
+		for (size_t i = 0; i < replicas_num; i++) {
+			if (replicas[i].phase == REPLICA_DONE) {
+				continue;
+			}
+			pending++;
+			int descriptor = -1;
+			if (ldap_get_option(replicas[i].ld, LDAP_OPT_DESC, &descriptor) == LDAP_OPT_SUCCESS &&
+				descriptor >= 0) {
+				fds[fds_num].fd = descriptor;
+				fds[fds_num].events = POLLIN;
+				fds_num++;
+			}
+		}
+		if (pending == 0) {
+			break;
+		}
+		/* without a descriptor this only waits a moment before asking again */
+		poll(fds, fds_num, 100);
+
+		for (size_t i = 0; i < replicas_num; i++) {
+			if (replicas[i].phase != REPLICA_DONE) {
+				replica_step(&replicas[i], config);
+			}
+		}
+	}
+	free(fds);
+
+	ldap_csn_set newest = {0};
+	size_t reachable = 0;
+	for (size_t i = 0; i < replicas_num; i++) {
+		if (replicas[i].phase == REPLICA_DONE && replicas[i].error == NULL) {
+			ldap_csn_set_merge(&newest, &replicas[i].csns);
+			reachable++;
+		}
+	}
+
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+	xasprintf(&result.output, "%zu of %zu servers answered", reachable, replicas_num);
+
+	for (size_t i = 0; i < replicas_num; i++) {
+		ldap_replica *replica = &replicas[i];
+		mp_subcheck sc_replica = mp_subcheck_init();
+
+		if (replica->phase != REPLICA_DONE) {
+			sc_replica = mp_set_subcheck_state(sc_replica, STATE_CRITICAL);
+			xasprintf(&sc_replica.output, "%s: no answer within %.0fs", replica->host, deadline);
+		} else if (replica->error != NULL) {
+			sc_replica = mp_set_subcheck_state(sc_replica, STATE_CRITICAL);
+			xasprintf(&sc_replica.output, "%s: %s", replica->host, replica->error);
+		} else if (replica->csns.count == 0) {
+			sc_replica = mp_set_subcheck_state(sc_replica, STATE_UNKNOWN);
+			xasprintf(&sc_replica.output, "%s: %s has no contextCSN or modifyTimestamp",
+					  replica->host, config.ld_base);
+		} else {
+			ldap_replica_lag lag = ldap_csn_lag(&newest, &replica->csns);
+
+			mp_perfdata pd_time = perfdata_init();
+			xasprintf(&pd_time.label, "%s_time", replica->host);
+			pd_time.uom = "s";
+			pd_time = mp_set_pd_value(pd_time, replica->time);
+			pd_time = mp_pd_set_thresholds(pd_time, config.connection_time_threshold);
+			mp_add_perfdata_to_subcheck(&sc_replica, pd_time);
+
+			mp_perfdata pd_lag = perfdata_init();
+			xasprintf(&pd_lag.label, "%s_lag", replica->host);
+			pd_lag.uom = "s";
+			pd_lag = mp_set_pd_value(pd_lag, lag.lag);
+			pd_lag = mp_set_pd_min_value(pd_lag, mp_create_pd_value(0));
+			pd_lag = mp_pd_set_thresholds(pd_lag, config.lag_thresholds);
+			mp_add_perfdata_to_subcheck(&sc_replica, pd_lag);
+
+			mp_state_enum replica_state =
+				max_state_alt(mp_get_pd_status(pd_time), mp_get_pd_status(pd_lag));
+			if (lag.missing > 0) {
+				/* a provider whose changes never reached this server */
+				replica_state = max_state_alt(replica_state, STATE_WARNING);
+				xasprintf(&sc_replica.output,
+						  "%s: %.1fs behind, missing the changes of %zu provider(s)", replica->host,
+						  lag.lag, lag.missing);
+			} else if (lag.lag > 0) {
+				xasprintf(&sc_replica.output, "%s: %.1fs behind", replica->host, lag.lag);
+			} else {
+				xasprintf(&sc_replica.output, "%s: up to date", replica->host);
+			}
+			sc_replica = mp_set_subcheck_state(sc_replica, replica_state);
+		}
+		mp_add_subcheck_to_subcheck(&result, sc_replica);
+
+		/* a finished or failed search still holds the message of the server */
+		if (replica->search.ld != NULL) {
+			ldap_async_search_free(&replica->search);
+		}
+		if (replica->ld != NULL) {
+			ldap_unbind(replica->ld);
+		}
+		ldap_csn_set_free(&replica->csns);
+		free(replica->error);
+	}
+
+	ldap_csn_set_free(&newest);
+	free(replicas);
+	return result;
+}
+
 /* process command-line arguments */
 check_ldap_config_wrapper process_arguments(int argc, char **argv) {
 	enum {
 		output_format_index = CHAR_MAX + 1,
+		page_size_index,
+		replica_index,
+		warn_lag_index,
+		crit_lag_index,
 	};
 
 	/* initialize the long option struct */
@@ -341,6 +682,10 @@ check_ldap_config_wrapper process_arguments(int argc, char **argv) {
 									   {"crit-entries", required_argument, 0, 'C'},
 									   {"verbose", no_argument, 0, 'v'},
 									   {"output-format", required_argument, 0, output_format_index},
+									   {"page-size", required_argument, 0, page_size_index},
+									   {"replica", required_argument, 0, replica_index},
+									   {"warn-lag", required_argument, 0, warn_lag_index},
+									   {"crit-lag", required_argument, 0, crit_lag_index},
 									   {0, 0, 0, 0}};
 
 	check_ldap_config_wrapper result = {
@@ -466,6 +811,37 @@ check_ldap_config_wrapper process_arguments(int argc, char **argv) {
 		case '6':
 			address_family = AF_INET6;
 			break;
+		case page_size_index:
+			if (!is_intnonneg(optarg)) {
+				usage2(_("Page size must be a positive integer"), optarg);
+			}
+			result.config.page_size = atoi(optarg);
+			break;
+		case replica_index: {
+			char **replicas = realloc(result.config.replicas,
+									  (result.config.replicas_num + 1) * sizeof(char *));
+			if (replicas == NULL) {
+				die(STATE_UNKNOWN, _("Could not allocate memory for the replicas\n"));
+			}
+			replicas[result.config.replicas_num++] = optarg;
+			result.config.replicas = replicas;
+		} break;
+		case warn_lag_index: {
+			mp_range_parsed tmp = mp_parse_range_string(optarg);
+			if (tmp.error != MP_PARSING_SUCCESS) {
+				die(STATE_UNKNOWN, "failed to parse warning replication lag threshold");
+			}
+			result.config.lag_thresholds =
+				mp_thresholds_set_warn(result.config.lag_thresholds, tmp.range);
+		} break;
+		case crit_lag_index: {
+			mp_range_parsed tmp = mp_parse_range_string(optarg);
+			if (tmp.error != MP_PARSING_SUCCESS) {
+				die(STATE_UNKNOWN, "failed to parse critical replication lag threshold");
+			}
+			result.config.lag_thresholds =
+				mp_thresholds_set_crit(result.config.lag_thresholds, tmp.range);
+		} break;
 		case output_format_index: {
 			parsed_output_format parser = mp_parse_output_format(optarg);
 			if (!parser.parsing_success) {
@@ -569,6 +945,20 @@ void print_help(void) {
 	printf("    %s\n", _("Number of found entries to result in warning status"));
 	printf(" %s\n", "-C [--crit-entries]");
 	printf("    %s\n", _("Number of found entries to result in critical status"));
+	printf(" %s\n", "--page-size=INTEGER");
+	printf("    %s\n", _("Request the entries in pages of this size with the paged results"));
+	printf("    %s\n", _("control, for searches above the size limit of the server (default: 0,"));
+	printf("    %s\n", _("no paging)"));
+	printf(" %s\n", "--replica=HOST");
+	printf("    %s\n", _("Another server of the replica set, may be given more than once. All"));
+	printf("    %s\n", _("servers are queried at the same time for the contextCSN (or else the"));
+	printf("    %s\n", _("modifyTimestamp) of the base, which has to be the suffix. The lag of"));
+	printf("    %s\n", _("each server is the time since the newest change on any of them. The"));
+	printf("    %s\n", _("connection time thresholds apply to every server"));
+	printf(" %s\n", "--warn-lag=RANGE");
+	printf("    %s\n", _("Replication lag in seconds to result in warning status"));
+	printf(" %s\n", "--crit-lag=RANGE");
+	printf("    %s\n", _("Replication lag in seconds to result in critical status"));
 
 	printf(UT_CONN_TIMEOUT, DEFAULT_SOCKET_TIMEOUT);
 
@@ -585,6 +975,7 @@ void print_help(void) {
 					  "or '--ssl' flags"));
 	printf(" %s\n", _("to define the behaviour explicitly instead."));
 	printf(" %s\n", _("The parameters --warn-entries and --crit-entries are optional."));
+	printf(" %s\n", _("The entries are counted while they arrive, they are not kept in memory."));
 
 	printf(UT_SUPPORT);
 }
@@ -599,4 +990,6 @@ void print_usage(void) {
 		   ""
 #endif
 	);
+	printf("       [--page-size=<entries>] [--replica=<host> ...] [--warn-lag=<lag>]"
+		   " [--crit-lag=<lag>]\n");
 }
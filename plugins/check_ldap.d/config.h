@@ -25,6 +25,12 @@ typedef struct {
 #ifdef HAVE_LDAP_SET_OPTION
 	int ld_protocol;
 #endif
+	int page_size; /* entries per page of a paged search, 0 to search without paging */
+
+	/* the other servers of a replica set, compared with ld_host */
+	char **replicas;
+	size_t replicas_num;
+	mp_thresholds lag_thresholds;
 
 	mp_thresholds entries_thresholds;
 	mp_thresholds connection_time_threshold;
@@ -46,6 +52,11 @@ check_ldap_config check_ldap_config_init() {
 #ifdef HAVE_LDAP_SET_OPTION
 		.ld_protocol = DEFAULT_PROTOCOL,
 #endif
+		.page_size = 0,
+
+		.replicas = NULL,
+		.replicas_num = 0,
+		.lag_thresholds = mp_thresholds_init(),
 
 		.entries_thresholds = mp_thresholds_init(),
 		.connection_time_threshold = mp_thresholds_init(),
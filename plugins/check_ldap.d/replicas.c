@@ -0,0 +1,95 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./replicas.h"
+
+#include <time.h>
+
+bool ldap_generalized_time_parse(const char *value, double *time) {
+	struct tm stamp = {0};
+	const char *rest = strptime(value, "%Y%m%d%H%M%S", &stamp);
+	if (rest == NULL) {
+		return false;
+	}
+
+	double fraction = 0;
+	if (*rest == '.' || *rest == ',') {
+		char *end;
+		fraction = strtod(rest, &end);
+		rest = end;
+	}
+	if (*rest != 'Z' || (rest[1] != '\0' && rest[1] != '#')) {
+		return false;
+	}
+
+	*time = (double)timegm(&stamp) + fraction;
+	return true;
+}
+
+bool ldap_csn_parse(const char *value, ldap_csn *csn) {
+	if (!ldap_generalized_time_parse(value, &csn->time)) {
+		return false;
+	}
+
+	/* the time, the change count, the server ID and the modification number */
+	const char *count = strchr(value, '#');
+	const char *sid = count != NULL ? strchr(count + 1, '#') : NULL;
+	if (sid == NULL) {
+		return false;
+	}
+	char *end;
+	csn->sid = (int)strtol(sid + 1, &end, 16);
+	return end != sid + 1 && (*end == '#' || *end == '\0');
+}
+
+void ldap_csn_set_add(ldap_csn_set *set, ldap_csn csn) {
+	for (size_t i = 0; i < set->count; i++) {
+		if (set->csns[i].sid == csn.sid) {
+			if (csn.time > set->csns[i].time) {
+				set->csns[i].time = csn.time;
+			}
+			return;
+		}
+	}
+
+	ldap_csn *csns = realloc(set->csns, (set->count + 1) * sizeof(ldap_csn));
+	if (csns == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the change sequence numbers\n"));
+	}
+	csns[set->count++] = csn;
+	set->csns = csns;
+}
+
+void ldap_csn_set_merge(ldap_csn_set *newest, const ldap_csn_set *set) {
+	for (size_t i = 0; i < set->count; i++) {
+		ldap_csn_set_add(newest, set->csns[i]);
+	}
+}
+
+void ldap_csn_set_free(ldap_csn_set *set) {
+	free(set->csns);
+	*set = (ldap_csn_set){0};
+}
+
+ldap_replica_lag ldap_csn_lag(const ldap_csn_set *newest, const ldap_csn_set *replica) {
+	ldap_replica_lag result = {
+		.lag = 0,
+		.missing = 0,
+	};
+
+	for (size_t i = 0; i < newest->count; i++) {
+		bool found = false;
+		for (size_t j = 0; j < replica->count; j++) {
+			if (replica->csns[j].sid == newest->csns[i].sid) {
+				double lag = newest->csns[i].time - replica->csns[j].time;
+				if (lag > result.lag) {
+					result.lag = lag;
+				}
+				found = true;
+			}
+		}
+		if (!found) {
+			result.missing++;
+		}
+	}
+	return result;
+}
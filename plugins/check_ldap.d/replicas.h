@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* the server ID of a change time which comes from modifyTimestamp instead of contextCSN */
+#define LDAP_CSN_NO_SID (-1)
+
+/*
+ * The newest change a server knows of from one provider. contextCSN has a
+ * value per provider server ID in multi-provider setups, e.g.
+ * "20240501123456.123456Z#000000#001#000000" for server ID 1.
+ */
+typedef struct {
+	int sid;
+	double time; /* seconds since the epoch */
+} ldap_csn;
+
+typedef struct {
+	ldap_csn *csns;
+	size_t count;
+} ldap_csn_set;
+
+/* "YYYYmmddHHMMSS[.ffffff]Z", as in modifyTimestamp and the first field of a CSN */
+bool ldap_generalized_time_parse(const char *value, double *time);
+bool ldap_csn_parse(const char *value, ldap_csn *csn);
+
+/* keeps the newest change per server ID */
+void ldap_csn_set_add(ldap_csn_set *set, ldap_csn csn);
+void ldap_csn_set_merge(ldap_csn_set *newest, const ldap_csn_set *set);
+void ldap_csn_set_free(ldap_csn_set *set);
+
+typedef struct {
+	double lag;     /* seconds behind the newest change of any server, over all server IDs */
+	size_t missing; /* server IDs the replica has not seen a change of */
+} ldap_replica_lag;
+
+ldap_replica_lag ldap_csn_lag(const ldap_csn_set *newest, const ldap_csn_set *replica);
@@ -0,0 +1,182 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./search.h"
+
+/* only the number of entries is needed, not their attributes */
+static char *no_attributes[] = {LDAP_NO_ATTRS, NULL};
+
+ldap_async_search ldap_async_search_init(LDAP *ld, const char *base, int scope,
+										 const char *filter, int page_size) {
+	ldap_async_search result = {
+		.ld = ld,
+		.base = base,
+		.scope = scope,
+		.filter = filter,
+		.page_size = page_size,
+		.attributes = NULL,
+		.entry_callback = NULL,
+		.callback_data = NULL,
+
+		.msgid = -1,
+		.done = false,
+		.error = LDAP_SUCCESS,
+		.error_message = NULL,
+		.entries = 0,
+		.pages = 0,
+		.first_entry_time = -1,
+		.complete_time = 0,
+	};
+	gettimeofday(&result.start_time, NULL);
+	return result;
+}
+
+static void ldap_async_search_fail(ldap_async_search *search, int error) {
+	search->error = error;
+	search->done = true;
+	search->complete_time = delta_time(search->start_time);
+}
+
+/* sends the request for the next page, or the only one without paging */
+static int ldap_async_search_send(ldap_async_search *search) {
+	LDAPControl *page_control = NULL;
+	LDAPControl *server_controls[2] = {NULL, NULL};
+
+	if (search->page_size > 0) {
+#ifdef LDAP_CONTROL_PAGEDRESULTS
+		/* not critical, servers without paging send the whole result at once */
+		int error = ldap_create_page_control(search->ld, search->page_size, &search->cookie, 0,
+											 &page_control);
+		if (error != LDAP_SUCCESS) {
+			return error;
+		}
+		server_controls[0] = page_control;
+#else
+		return LDAP_NOT_SUPPORTED;
+#endif
+	}
+
+	int error = ldap_search_ext(search->ld, search->base, search->scope, search->filter,
+								search->attributes != NULL ? search->attributes : no_attributes, 0,
+								server_controls, NULL, NULL, LDAP_NO_LIMIT,
+								&search->msgid);
+	if (page_control != NULL) {
+		ldap_control_free(page_control);
+	}
+	if (error == LDAP_SUCCESS) {
+		search->pages++;
+	}
+	return error;
+}
+
+int ldap_async_search_start(ldap_async_search *search) {
+	int error = ldap_async_search_send(search);
+	if (error != LDAP_SUCCESS) {
+		ldap_async_search_fail(search, error);
+	}
+	return error;
+}
+
+/* the end of one page, true if another page has to be requested */
+static bool ldap_async_search_result(ldap_async_search *search, LDAPMessage *message) {
+	int error = LDAP_SUCCESS;
+	LDAPControl **controls = NULL;
+	int parse_error = ldap_parse_result(search->ld, message, &error, NULL,
+										&search->error_message, NULL, &controls, 0);
+	if (parse_error != LDAP_SUCCESS) {
+		error = parse_error;
+	}
+	if (error != LDAP_SUCCESS) {
+		ldap_controls_free(controls);
+		ldap_async_search_fail(search, error);
+		return false;
+	}
+
+	bool more = false;
+#ifdef LDAP_CONTROL_PAGEDRESULTS
+	LDAPControl *page_response =
+		search->page_size > 0 ? ldap_control_find(LDAP_CONTROL_PAGEDRESULTS, controls, NULL)
+							  : NULL;
+	if (page_response != NULL) {
+		ber_int_t estimate;
+		if (search->cookie.bv_val != NULL) {
+			ber_memfree(search->cookie.bv_val);
+			search->cookie = (struct berval){0};
+		}
+		if (ldap_parse_pageresponse_control(search->ld, page_response, &estimate,
+											&search->cookie) == LDAP_SUCCESS) {
+			/* an empty cookie marks the last page */
+			more = search->cookie.bv_len > 0;
+		}
+	}
+#endif
+	ldap_controls_free(controls);
+
+	if (!more) {
+		search->done = true;
+		search->complete_time = delta_time(search->start_time);
+		return false;
+	}
+	if (search->error_message != NULL) {
+		ldap_memfree(search->error_message);
+		search->error_message = NULL;
+	}
+	return true;
+}
+
+bool ldap_async_search_poll(ldap_async_search *search, struct timeval *timeout) {
+	while (!search->done) {
+		LDAPMessage *message = NULL;
+		int type = ldap_result(search->ld, search->msgid, LDAP_MSG_ONE, timeout, &message);
+		if (type == 0) {
+			/* nothing more arrived within the timeout */
+			return false;
+		}
+		if (type < 0) {
+			int error = LDAP_SERVER_DOWN;
+			ldap_get_option(search->ld, LDAP_OPT_RESULT_CODE, &error);
+			ldap_async_search_fail(search, error);
+			return true;
+		}
+
+		bool next_page = false;
+		switch (type) {
+		case LDAP_RES_SEARCH_ENTRY:
+			if (search->entries == 0) {
+				search->first_entry_time = delta_time(search->start_time);
+			}
+			search->entries++;
+			if (search->entry_callback != NULL) {
+				search->entry_callback(search->ld, message, search->callback_data);
+			}
+			break;
+		case LDAP_RES_SEARCH_RESULT:
+			next_page = ldap_async_search_result(search, message);
+			break;
+		default:
+			/* references are not followed */
+			break;
+		}
+		ldap_msgfree(message);
+
+		if (next_page) {
+			int error = ldap_async_search_send(search);
+			if (error != LDAP_SUCCESS) {
+				ldap_async_search_fail(search, error);
+			}
+		}
+	}
+	return true;
+}
+
+void ldap_async_search_free(ldap_async_search *search) {
+	if (!search->done && search->msgid >= 0) {
+		ldap_abandon_ext(search->ld, search->msgid, NULL, NULL);
+	}
+	if (search->cookie.bv_val != NULL) {
+		ber_memfree(search->cookie.bv_val);
+	}
+	if (search->error_message != NULL) {
+		ldap_memfree(search->error_message);
+	}
+	*search = (ldap_async_search){0};
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+#include <sys/time.h>
+#include <lber.h>
+#define LDAP_DEPRECATED 1
+#include <ldap.h>
+
+/*
+ * A search which is read one message at a time instead of collecting the
+ * whole result with ldap_search_s. The entries are only counted, so the
+ * memory used does not grow with the size of the result. With a page size
+ * the search is sent with the Simple Paged Results control (RFC 2696) and
+ * repeated with the returned cookie until the server has no more pages.
+ */
+typedef struct {
+	/* set by the caller */
+	LDAP *ld;
+	const char *base;
+	int scope;
+	const char *filter;
+	int page_size;     /* 0 for a search without paging */
+	char **attributes; /* NULL to only count the entries */
+	/* called for every entry before it is freed, may be NULL */
+	void (*entry_callback)(LDAP *ld, LDAPMessage *entry, void *data);
+	void *callback_data;
+
+	/* set by ldap_async_search_start and ldap_async_search_poll */
+	int msgid;
+	struct berval cookie; /* the position of the next page */
+	bool done;
+	int error;           /* the LDAP result code */
+	char *error_message; /* the diagnostic message of the server, or NULL */
+	long entries;
+	int pages;
+	struct timeval start_time;
+	double first_entry_time; /* seconds until the first entry arrived, -1 if none did */
+	double complete_time;    /* seconds until the last result arrived */
+} ldap_async_search;
+
+ldap_async_search ldap_async_search_init(LDAP *ld, const char *base, int scope,
+										 const char *filter, int page_size);
+
+/* sends the search, returns the LDAP result code */
+int ldap_async_search_start(ldap_async_search *search);
+
+/*
+ * Handles the messages which arrive within the timeout (NULL waits for the
+ * next one) and sends the request for the next page. Returns true once the
+ * search is complete or failed, the result code is in error.
+ */
+bool ldap_async_search_poll(ldap_async_search *search, struct timeval *timeout);
+
+void ldap_async_search_free(ldap_async_search *search);
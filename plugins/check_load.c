@@ -33,6 +33,7 @@ const char *copyright = "1999-2022";
 const char *email = "devel@monitoring-plugins.org";
 
 #include "./common.h"
+#include <ctype.h>
 #include <string.h>
 #include "./runcmd.h"
 #include "./utils.h"
@@ -42,6 +43,8 @@ const char *email = "devel@monitoring-plugins.org";
 #include "../lib/perfdata.h"
 #include "../lib/thresholds.h"
 #include "check_load.d/config.h"
+#include "check_load.d/top_procs.h"
+#include "check_load.d/pressure.h"
 
 // getloadavg comes from gnulib
 #include "../gl/stdlib.h"
@@ -64,8 +67,20 @@ void print_usage(void);
 typedef struct {
 	int errorcode;
 	char **top_processes;
+	unsigned long lines; /* including the header line */
 } top_processes_result;
 static top_processes_result get_top_consuming_processes(unsigned long n_procs_to_show);
+static top_processes_result get_top_processes_from_proc(unsigned long n_procs_to_show);
+
+static mp_subcheck evaluate_pressure(const char *cgroup_path, mp_thresholds thresholds);
+static mp_subcheck evaluate_cgroup_cpu(const char *cgroup_path, mp_thresholds thresholds);
+
+/* how long the CPU usage of the processes is watched for the top processes */
+#define TOP_PROCS_SAMPLE_INTERVAL_MS 250
+/* longer command lines are cut off, like ps does at the terminal width */
+#define TOP_PROCS_COMMAND_LENGTH 128
+/* how long the cgroup CPU counters are watched for the throttling ratio */
+#define CGROUP_SAMPLE_INTERVAL_MS 1000
 
 typedef struct {
 	mp_range load[3];
@@ -256,6 +271,17 @@ int main(int argc, char **argv) {
 
 	mp_add_subcheck_to_check(&overall, load_sc);
 
+	if (config.cgroup_path != NULL) {
+		mp_add_subcheck_to_check(&overall,
+								 evaluate_cgroup_cpu(config.cgroup_path, config.th_throttling));
+	}
+
+	/* a cgroup has its own pressure files, otherwise the ones of the whole system are used */
+	if (config.check_pressure) {
+		mp_add_subcheck_to_check(&overall,
+								 evaluate_pressure(config.cgroup_path, config.th_pressure));
+	}
+
 	if (config.n_procs_to_show > 0) {
 		mp_subcheck top_proc_sc = mp_subcheck_init();
 		top_proc_sc = mp_set_subcheck_state(top_proc_sc, STATE_OK);
@@ -264,8 +290,7 @@ int main(int argc, char **argv) {
 				  config.n_procs_to_show);
 
 		if (top_proc.errorcode == OK) {
-			// +1 here since the string list contains the header line
-			for (unsigned long i = 0; i < config.n_procs_to_show + 1; i++) {
+			for (unsigned long i = 0; i < top_proc.lines; i++) {
 				xasprintf(&top_proc_sc.output, "%s\n%s", top_proc_sc.output,
 						  top_proc.top_processes[i]);
 			}
@@ -282,6 +307,12 @@ static check_load_config_wrapper process_arguments(int argc, char **argv) {
 
 	enum {
 		output_format_index = CHAR_MAX + 1,
+		pressure_index,
+		pressure_warning_index,
+		pressure_critical_index,
+		cgroup_index,
+		throttling_warning_index,
+		throttling_critical_index,
 	};
 
 	static struct option longopts[] = {{"warning", required_argument, 0, 'w'},
@@ -291,6 +322,16 @@ static check_load_config_wrapper process_arguments(int argc, char **argv) {
 									   {"help", no_argument, 0, 'h'},
 									   {"procs-to-show", required_argument, 0, 'n'},
 									   {"output-format", required_argument, 0, output_format_index},
+									   {"pressure", no_argument, 0, pressure_index},
+									   {"pressure-warning", required_argument, 0,
+										pressure_warning_index},
+									   {"pressure-critical", required_argument, 0,
+										pressure_critical_index},
+									   {"cgroup", required_argument, 0, cgroup_index},
+									   {"throttling-warning", required_argument, 0,
+										throttling_warning_index},
+									   {"throttling-critical", required_argument, 0,
+										throttling_critical_index},
 									   {0, 0, 0, 0}};
 
 	check_load_config_wrapper result = {
@@ -352,6 +393,35 @@ static check_load_config_wrapper process_arguments(int argc, char **argv) {
 		case 'n':
 			result.config.n_procs_to_show = (unsigned long)atol(optarg);
 			break;
+		case pressure_index:
+			result.config.check_pressure = true;
+			break;
+		case pressure_warning_index:
+		case pressure_critical_index:
+		case throttling_warning_index:
+		case throttling_critical_index: {
+			mp_range_parsed range = mp_parse_range_string(optarg);
+			if (range.error != MP_PARSING_SUCCESS) {
+				die(STATE_UNKNOWN, "failed to parse threshold: %s", optarg);
+			}
+
+			bool pressure = option_index == pressure_warning_index ||
+							option_index == pressure_critical_index;
+			bool warning = option_index == pressure_warning_index ||
+						   option_index == throttling_warning_index;
+			mp_thresholds *thresholds =
+				pressure ? &result.config.th_pressure : &result.config.th_throttling;
+			*thresholds = warning ? mp_thresholds_set_warn(*thresholds, range.range)
+								  : mp_thresholds_set_crit(*thresholds, range.range);
+			result.config.check_pressure = result.config.check_pressure || pressure;
+		} break;
+		case cgroup_index:
+			if (optarg[0] == '/') {
+				result.config.cgroup_path = strdup(optarg);
+			} else {
+				xasprintf(&result.config.cgroup_path, "%s/%s", LOAD_CGROUP_ROOT, optarg);
+			}
+			break;
 		case '?': /* help */
 			usage5();
 		}
@@ -423,6 +493,24 @@ void print_help(void) {
 	printf(" %s\n", "-n, --procs-to-show=NUMBER_OF_PROCS");
 	printf("    %s\n", _("Number of processes to show when printing the top consuming processes."));
 	printf("    %s\n", _("NUMBER_OF_PROCS=0 disables this feature. Default value is 0"));
+	printf("    %s\n", _("Where /proc is available, the CPU usage is measured over 0.25 seconds"));
+	printf("    %s\n", _("and the columns are PID, S (state), %CPU, RSS(kB) and COMMAND,"));
+	printf("    %s\n", _("otherwise they are the ones of the ps command found by configure"));
+	printf(" %s\n", "--pressure");
+	printf("    %s\n", _("Report the pressure stall information of CPU, memory and IO"));
+	printf("    %s\n", _("(Linux 4.20 or newer), from the cgroup if --cgroup is given"));
+	printf(" %s\n", "--pressure-warning=RANGE, --pressure-critical=RANGE");
+	printf("    %s\n", _("Thresholds for the \"some avg10\" value of each resource, the"));
+	printf("    %s\n", _("percentage of the last 10 seconds in which some tasks stalled on it."));
+	printf("    %s\n", _("The \"full\" values and the 60 and 300 second averages are only"));
+	printf("    %s\n", _("reported as perfdata. Imply --pressure"));
+	printf(" %s\n", "--cgroup=PATH");
+	printf("    %s\n", _("cgroup v2 directory to report the CPU usage and quota throttling of,"));
+	printf("    %s\n", _("relative paths are taken below " LOAD_CGROUP_ROOT ". The counters are"));
+	printf("    %s\n", _("watched for one second"));
+	printf(" %s\n", "--throttling-warning=RANGE, --throttling-critical=RANGE");
+	printf("    %s\n", _("Thresholds for the percentage of CPU quota periods the cgroup was"));
+	printf("    %s\n", _("throttled in"));
 
 	printf(UT_OUTPUT_FORMAT);
 	printf(UT_SUPPORT);
@@ -432,10 +520,24 @@ void print_usage(void) {
 	printf("%s\n", _("Usage:"));
 	printf("%s [-r] -w WLOAD1,WLOAD5,WLOAD15 -c CLOAD1,CLOAD5,CLOAD15 [-n NUMBER_OF_PROCS]\n",
 		   progname);
+	printf("       [--pressure] [--pressure-warning=RANGE] [--pressure-critical=RANGE]\n");
+	printf("       [--cgroup=PATH] [--throttling-warning=RANGE] [--throttling-critical=RANGE]\n");
 }
 
 #ifdef PS_USES_PROCPCPU
-int cmpstringp(const void *p1, const void *p2) {
+typedef struct {
+	char *line;
+	float pcpu;
+} ps_line;
+
+/* busiest first, every line is parsed once before sorting */
+static int cmp_ps_lines(const void *p1, const void *p2) {
+	const ps_line *line1 = p1;
+	const ps_line *line2 = p2;
+	return (line1->pcpu < line2->pcpu) - (line1->pcpu > line2->pcpu);
+}
+
+static float parse_ps_pcpu(char *line) {
 	int procuid = 0;
 	int procpid = 0;
 	int procppid = 0;
@@ -448,17 +550,89 @@ int cmpstringp(const void *p1, const void *p2) {
 #	endif /* PS_USES_PROCETIME */
 	char procprog[MAX_INPUT_BUFFER];
 	int pos;
-	sscanf(*(char *const *)p1, PS_FORMAT, PS_VARLIST);
-	float procpcpu1 = procpcpu;
-	sscanf(*(char *const *)p2, PS_FORMAT, PS_VARLIST);
-	return procpcpu1 < procpcpu;
+	sscanf(line, PS_FORMAT, PS_VARLIST);
+	return procpcpu;
 }
 #endif /* PS_USES_PROCPCPU */
 
-static top_processes_result get_top_consuming_processes(unsigned long n_procs_to_show) {
+/* formats the busiest processes of a two-sample /proc delta like the ps output */
+static top_processes_result get_top_processes_from_proc(unsigned long n_procs_to_show) {
 	top_processes_result result = {
-		.errorcode = OK,
+		.errorcode = ERROR,
 	};
+
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	load_proc_table before = load_read_proc_table("/proc");
+	if (before.samples == NULL || before.count == 0) {
+		load_free_proc_table(&before);
+		return result;
+	}
+
+	struct timespec interval = {
+		.tv_sec = TOP_PROCS_SAMPLE_INTERVAL_MS / 1000,
+		.tv_nsec = (TOP_PROCS_SAMPLE_INTERVAL_MS % 1000) * 1000000L,
+	};
+	nanosleep(&interval, NULL);
+
+	load_proc_table after = load_read_proc_table("/proc");
+
+	load_top_entry *top = calloc(n_procs_to_show, sizeof(load_top_entry));
+	if (top == NULL) {
+		die(STATE_UNKNOWN, _("Could not calloc() units [%lu]\n"), n_procs_to_show);
+	}
+	size_t selected = load_select_top(&before, &after, (double)deltime(start) / 1.0e6,
+									  sysconf(_SC_CLK_TCK), n_procs_to_show, top);
+	load_free_proc_table(&before);
+	load_free_proc_table(&after);
+
+	result.top_processes = calloc(selected + 1, sizeof(char *));
+	if (result.top_processes == NULL) {
+		die(STATE_UNKNOWN, _("Could not calloc() units [%lu]\n"), selected + 1);
+	}
+	xasprintf(&result.top_processes[0], "%7s %1s %6s %9s %s", "PID", "S", "%CPU", "RSS(kB)",
+			  "COMMAND");
+
+	long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+	for (size_t i = 0; i < selected; i++) {
+		/* the full command line is only read for the few processes we show */
+		char path[MAX_INPUT_BUFFER];
+		char command[TOP_PROCS_COMMAND_LENGTH] = "";
+		snprintf(path, sizeof(path), "/proc/%d/cmdline", (int)top[i].sample.pid);
+		FILE *cmdline = fopen(path, "r");
+		if (cmdline != NULL) {
+			size_t length = fread(command, 1, sizeof(command) - 1, cmdline);
+			fclose(cmdline);
+			/* arguments are separated by NUL, and may contain anything else */
+			for (size_t pos = 0; pos + 1 < length; pos++) {
+				if (command[pos] == '\0' || iscntrl((unsigned char)command[pos])) {
+					command[pos] = ' ';
+				}
+			}
+			command[length] = '\0';
+		}
+		if (command[0] == '\0') {
+			snprintf(command, sizeof(command), "[%s]", top[i].sample.command);
+		}
+
+		xasprintf(&result.top_processes[i + 1], "%7d %c %6.1f %9ld %s", (int)top[i].sample.pid,
+				  top[i].sample.state, top[i].pcpu, top[i].sample.rss_pages * page_kb, command);
+	}
+	free(top);
+
+	result.errorcode = OK;
+	result.lines = selected + 1;
+	return result;
+}
+
+static top_processes_result get_top_consuming_processes(unsigned long n_procs_to_show) {
+	/* where there is a /proc, skip spawning ps and sorting all of its lines */
+	top_processes_result result = get_top_processes_from_proc(n_procs_to_show);
+	if (result.errorcode == OK) {
+		return result;
+	}
+
+	result.errorcode = OK;
 	output chld_out;
 	output chld_err;
 	if (np_runcmd(PS_COMMAND, &chld_out, &chld_err, 0) != 0) {
@@ -474,7 +648,19 @@ static top_processes_result get_top_consuming_processes(unsigned long n_procs_to
 	}
 
 #ifdef PS_USES_PROCPCPU
-	qsort(chld_out.line + 1, chld_out.lines - 1, sizeof(char *), cmpstringp);
+	ps_line *ps_lines = calloc(chld_out.lines - 1, sizeof(ps_line));
+	if (ps_lines == NULL) {
+		die(STATE_UNKNOWN, _("Could not calloc() units [%lu]\n"), chld_out.lines - 1);
+	}
+	for (size_t i = 1; i < chld_out.lines; i++) {
+		ps_lines[i - 1].line = chld_out.line[i];
+		ps_lines[i - 1].pcpu = parse_ps_pcpu(chld_out.line[i]);
+	}
+	qsort(ps_lines, chld_out.lines - 1, sizeof(ps_line), cmp_ps_lines);
+	for (size_t i = 1; i < chld_out.lines; i++) {
+		chld_out.line[i] = ps_lines[i - 1].line;
+	}
+	free(ps_lines);
 #endif /* PS_USES_PROCPCPU */
 	unsigned long lines_to_show =
 		chld_out.lines < (size_t)(n_procs_to_show + 1) ? chld_out.lines : n_procs_to_show + 1;
@@ -489,6 +675,161 @@ static top_processes_result get_top_consuming_processes(unsigned long n_procs_to
 	for (unsigned long i = 0; i < lines_to_show; i += 1) {
 		xasprintf(&result.top_processes[i], "%s", chld_out.line[i]);
 	}
+	result.lines = lines_to_show;
+
+	return result;
+}
+
+static mp_perfdata pressure_perfdata(const char *resource, const char *kind, const char *average,
+									 double value) {
+	mp_perfdata result = perfdata_init();
+	xasprintf(&result.label, "%s_%s_%s", resource, kind, average);
+	result.uom = "%";
+	result = mp_set_pd_value(result, value);
+	result = mp_set_pd_min_value(result, mp_create_pd_value(0));
+	result = mp_set_pd_max_value(result, mp_create_pd_value(100));
+	return result;
+}
+
+/* a cgroup has "<resource>.pressure" files, the system wide ones are in /proc/pressure */
+static mp_subcheck evaluate_pressure(const char *cgroup_path, mp_thresholds thresholds) {
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+	if (cgroup_path != NULL) {
+		xasprintf(&result.output, "Pressure stall information of %s", cgroup_path);
+	} else {
+		result.output = "Pressure stall information";
+	}
+
+	const char *resources[] = {"cpu", "memory", "io"};
+	for (size_t i = 0; i < sizeof(resources) / sizeof(resources[0]); i++) {
+		char *path = NULL;
+		if (cgroup_path != NULL) {
+			xasprintf(&path, "%s/%s.pressure", cgroup_path, resources[i]);
+		} else {
+			xasprintf(&path, "/proc/pressure/%s", resources[i]);
+		}
+		load_pressure pressure = load_read_pressure(path);
+
+		mp_subcheck resource_sc = mp_subcheck_init();
+		if (!pressure.available) {
+			resource_sc = mp_set_subcheck_state(resource_sc, STATE_UNKNOWN);
+			xasprintf(&resource_sc.output, _("%s: could not read %s"), resources[i], path);
+			mp_add_subcheck_to_subcheck(&result, resource_sc);
+			free(path);
+			continue;
+		}
+		free(path);
+
+		mp_perfdata pd_some10 =
+			pressure_perfdata(resources[i], "some", "avg10", pressure.some.avg10);
+		pd_some10 = mp_pd_set_thresholds(pd_some10, thresholds);
+		resource_sc = mp_set_subcheck_state(resource_sc, mp_get_pd_status(pd_some10));
+		mp_add_perfdata_to_subcheck(&resource_sc, pd_some10);
+		mp_add_perfdata_to_subcheck(
+			&resource_sc, pressure_perfdata(resources[i], "some", "avg60", pressure.some.avg60));
+		mp_add_perfdata_to_subcheck(
+			&resource_sc, pressure_perfdata(resources[i], "some", "avg300", pressure.some.avg300));
+
+		/* the CPU has no "full" line before Linux 5.13 */
+		if (pressure.full.present) {
+			mp_perfdata pd_full10 =
+				pressure_perfdata(resources[i], "full", "avg10", pressure.full.avg10);
+			mp_add_perfdata_to_subcheck(&resource_sc, pd_full10);
+			xasprintf(&resource_sc.output, "%s: some %.2f%%, full %.2f%% (10s)", resources[i],
+					  pressure.some.avg10, pressure.full.avg10);
+		} else {
+			xasprintf(&resource_sc.output, "%s: some %.2f%% (10s)", resources[i],
+					  pressure.some.avg10);
+		}
+		mp_add_subcheck_to_subcheck(&result, resource_sc);
+	}
+
+	return result;
+}
+
+static mp_subcheck evaluate_cgroup_cpu(const char *cgroup_path, mp_thresholds thresholds) {
+	mp_subcheck result = mp_subcheck_init();
+
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	load_cgroup_cpu_stat before = load_read_cgroup_cpu_stat(cgroup_path);
+	if (!before.available) {
+		result = mp_set_subcheck_state(result, STATE_UNKNOWN);
+		xasprintf(&result.output, _("Could not read cpu.stat of cgroup %s"), cgroup_path);
+		return result;
+	}
+
+	struct timespec interval = {
+		.tv_sec = CGROUP_SAMPLE_INTERVAL_MS / 1000,
+		.tv_nsec = (CGROUP_SAMPLE_INTERVAL_MS % 1000) * 1000000L,
+	};
+	nanosleep(&interval, NULL);
+
+	load_cgroup_cpu_stat after = load_read_cgroup_cpu_stat(cgroup_path);
+	struct timeval end;
+	gettimeofday(&end, NULL);
+	if (!after.available) {
+		result = mp_set_subcheck_state(result, STATE_UNKNOWN);
+		xasprintf(&result.output, _("cgroup %s disappeared"), cgroup_path);
+		return result;
+	}
+
+	double elapsed_usec =
+		(double)(end.tv_sec - start.tv_sec) * 1.0e6 + (double)(end.tv_usec - start.tv_usec);
+	double usage_cpus = (after.usage_usec >= before.usage_usec && elapsed_usec > 0)
+							? (double)(after.usage_usec - before.usage_usec) / elapsed_usec
+							: 0;
+
+	/* without a quota there are no enforcement periods and nothing is ever throttled */
+	unsigned long long periods =
+		(after.nr_periods >= before.nr_periods) ? after.nr_periods - before.nr_periods : 0;
+	unsigned long long throttled =
+		(after.nr_throttled >= before.nr_throttled) ? after.nr_throttled - before.nr_throttled : 0;
+	double throttled_percent = (periods > 0) ? 100.0 * (double)throttled / (double)periods : 0;
+	double throttled_seconds = (after.throttled_usec >= before.throttled_usec)
+								   ? (double)(after.throttled_usec - before.throttled_usec) / 1.0e6
+								   : 0;
+
+	mp_perfdata pd_throttled = perfdata_init();
+	pd_throttled.label = "throttled_periods";
+	pd_throttled.uom = "%";
+	pd_throttled = mp_set_pd_value(pd_throttled, throttled_percent);
+	pd_throttled = mp_set_pd_min_value(pd_throttled, mp_create_pd_value(0));
+	pd_throttled = mp_set_pd_max_value(pd_throttled, mp_create_pd_value(100));
+	pd_throttled = mp_pd_set_thresholds(pd_throttled, thresholds);
+	result = mp_set_subcheck_state(result, mp_get_pd_status(pd_throttled));
+	mp_add_perfdata_to_subcheck(&result, pd_throttled);
+
+	mp_perfdata pd_throttled_time = perfdata_init();
+	pd_throttled_time.label = "throttled_time";
+	pd_throttled_time.uom = "s";
+	pd_throttled_time = mp_set_pd_value(pd_throttled_time, throttled_seconds);
+	mp_add_perfdata_to_subcheck(&result, pd_throttled_time);
+
+	mp_perfdata pd_usage = perfdata_init();
+	pd_usage.label = "cpu_usage";
+	pd_usage = mp_set_pd_value(pd_usage, usage_cpus);
+	pd_usage = mp_set_pd_min_value(pd_usage, mp_create_pd_value(0));
+
+	load_cgroup_cpu_max limit = load_read_cgroup_cpu_max(cgroup_path);
+	if (limit.available && limit.limited) {
+		double limit_cpus = (double)limit.quota_usec / (double)limit.period_usec;
+		pd_usage = mp_set_pd_max_value(pd_usage, mp_create_pd_value(limit_cpus));
+
+		mp_perfdata pd_limit = perfdata_init();
+		pd_limit.label = "cpu_limit";
+		pd_limit = mp_set_pd_value(pd_limit, limit_cpus);
+		mp_add_perfdata_to_subcheck(&result, pd_limit);
+
+		xasprintf(&result.output,
+				  _("cgroup %s: %.2f of %.2f CPUs used, throttled in %.1f%% of %llu periods"),
+				  cgroup_path, usage_cpus, limit_cpus, throttled_percent, periods);
+	} else {
+		xasprintf(&result.output, _("cgroup %s: %.2f CPUs used, no CPU quota"), cgroup_path,
+				  usage_cpus);
+	}
+	mp_add_perfdata_to_subcheck(&result, pd_usage);
 
 	return result;
 }
@@ -8,6 +8,14 @@ typedef struct {
 	bool take_into_account_cpus;
 	unsigned long n_procs_to_show;
 
+	/* pressure stall information, thresholds apply to the "some" avg10 percentage */
+	bool check_pressure;
+	mp_thresholds th_pressure;
+
+	/* cgroup v2 directory, thresholds apply to the percentage of throttled periods */
+	char *cgroup_path;
+	mp_thresholds th_throttling;
+
 	mp_output_format output_format;
 	bool output_format_set;
 } check_load_config;
@@ -24,6 +32,12 @@ check_load_config check_load_config_init() {
 		.take_into_account_cpus = false,
 		.n_procs_to_show = 0,
 
+		.check_pressure = false,
+		.th_pressure = mp_thresholds_init(),
+
+		.cgroup_path = NULL,
+		.th_throttling = mp_thresholds_init(),
+
 		.output_format_set = false,
 	};
 	return tmp;
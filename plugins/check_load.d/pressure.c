@@ -0,0 +1,134 @@
+#include "../common.h"
+#include "./pressure.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+char *load_read_file(const char *path) {
+	int file = open(path, O_RDONLY);
+	if (file < 0) {
+		return NULL;
+	}
+
+	char buffer[MAX_INPUT_BUFFER];
+	ssize_t length = read(file, buffer, sizeof(buffer) - 1);
+	close(file);
+	if (length < 0) {
+		return NULL;
+	}
+	buffer[length] = '\0';
+	return strdup(buffer);
+}
+
+load_pressure load_parse_pressure(const char *text) {
+	load_pressure result = {
+		.available = false,
+	};
+
+	/* "some avg10=0.00 avg60=0.00 avg300=0.00 total=0", then the same for "full" */
+	while (text != NULL && *text != '\0') {
+		char kind[8];
+		load_pressure_line line = {
+			.present = true,
+		};
+		if (sscanf(text, "%7s avg10=%lf avg60=%lf avg300=%lf total=%llu", kind, &line.avg10,
+				   &line.avg60, &line.avg300, &line.total) == 5) {
+			if (strcmp(kind, "some") == 0) {
+				result.some = line;
+				result.available = true;
+			} else if (strcmp(kind, "full") == 0) {
+				result.full = line;
+			}
+		}
+
+		text = strchr(text, '\n');
+		if (text != NULL) {
+			text++;
+		}
+	}
+
+	return result;
+}
+
+load_pressure load_read_pressure(const char *path) {
+	char *text = load_read_file(path);
+	load_pressure result = load_parse_pressure(text);
+	free(text);
+	return result;
+}
+
+load_cgroup_cpu_stat load_parse_cgroup_cpu_stat(const char *text) {
+	load_cgroup_cpu_stat result = {
+		.available = false,
+	};
+
+	while (text != NULL && *text != '\0') {
+		char key[32];
+		unsigned long long value;
+		if (sscanf(text, "%31s %llu", key, &value) == 2) {
+			if (strcmp(key, "usage_usec") == 0) {
+				result.usage_usec = value;
+				result.available = true;
+			} else if (strcmp(key, "nr_periods") == 0) {
+				result.nr_periods = value;
+			} else if (strcmp(key, "nr_throttled") == 0) {
+				result.nr_throttled = value;
+			} else if (strcmp(key, "throttled_usec") == 0) {
+				result.throttled_usec = value;
+			}
+		}
+
+		text = strchr(text, '\n');
+		if (text != NULL) {
+			text++;
+		}
+	}
+
+	return result;
+}
+
+load_cgroup_cpu_stat load_read_cgroup_cpu_stat(const char *cgroup_path) {
+	char path[MAX_INPUT_BUFFER];
+	snprintf(path, sizeof(path), "%s/cpu.stat", cgroup_path);
+	char *text = load_read_file(path);
+	load_cgroup_cpu_stat result = load_parse_cgroup_cpu_stat(text);
+	free(text);
+	return result;
+}
+
+load_cgroup_cpu_max load_parse_cgroup_cpu_max(const char *text) {
+	load_cgroup_cpu_max result = {
+		.available = false,
+	};
+	if (text == NULL) {
+		return result;
+	}
+
+	char quota[32];
+	unsigned long long period;
+	if (sscanf(text, "%31s %llu", quota, &period) != 2 || period == 0) {
+		return result;
+	}
+
+	result.available = true;
+	result.period_usec = period;
+	if (strcmp(quota, "max") != 0) {
+		char *end = NULL;
+		result.quota_usec = strtoull(quota, &end, 10);
+		result.limited = (end != quota && *end == '\0');
+		result.available = result.limited;
+	}
+	return result;
+}
+
+load_cgroup_cpu_max load_read_cgroup_cpu_max(const char *cgroup_path) {
+	char path[MAX_INPUT_BUFFER];
+	snprintf(path, sizeof(path), "%s/cpu.max", cgroup_path);
+	char *text = load_read_file(path);
+	load_cgroup_cpu_max result = load_parse_cgroup_cpu_max(text);
+	free(text);
+	return result;
+}
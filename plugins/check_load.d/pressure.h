@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+
+/* where relative --cgroup paths are looked up */
+#define LOAD_CGROUP_ROOT "/sys/fs/cgroup"
+
+/* One line of a pressure file, the averages are percentages */
+typedef struct {
+	bool present;
+	double avg10;
+	double avg60;
+	double avg300;
+	unsigned long long total; /* stall time in microseconds */
+} load_pressure_line;
+
+/* /proc/pressure/{cpu,memory,io} or the cgroup v2 {cpu,memory,io}.pressure */
+typedef struct {
+	bool available;
+	load_pressure_line some;
+	load_pressure_line full; /* not present for cpu on older kernels */
+} load_pressure;
+
+load_pressure load_parse_pressure(const char *text);
+load_pressure load_read_pressure(const char *path);
+
+/* The cgroup v2 cpu.stat counters we look at */
+typedef struct {
+	bool available;
+	unsigned long long usage_usec;
+	unsigned long long nr_periods;
+	unsigned long long nr_throttled;
+	unsigned long long throttled_usec;
+} load_cgroup_cpu_stat;
+
+load_cgroup_cpu_stat load_parse_cgroup_cpu_stat(const char *text);
+load_cgroup_cpu_stat load_read_cgroup_cpu_stat(const char *cgroup_path);
+
+/* The cgroup v2 cpu.max, "max PERIOD" means no quota */
+typedef struct {
+	bool available;
+	bool limited;
+	unsigned long long quota_usec;
+	unsigned long long period_usec;
+} load_cgroup_cpu_max;
+
+load_cgroup_cpu_max load_parse_cgroup_cpu_max(const char *text);
+load_cgroup_cpu_max load_read_cgroup_cpu_max(const char *cgroup_path);
+
+/* Reads a small pseudo file, returns NULL if it can't be read */
+char *load_read_file(const char *path);
@@ -0,0 +1,255 @@
+#include "../common.h"
+#include "./top_procs.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+bool load_parse_proc_stat(const char *text, load_proc_sample sample[static 1]) {
+	char *end = NULL;
+	long pid = strtol(text, &end, 10);
+	if (end == text || pid <= 0) {
+		return false;
+	}
+
+	/* the command is everything between the first '(' and the last ')' */
+	const char *command_start = strchr(end, '(');
+	const char *command_end = strrchr(end, ')');
+	if (command_start == NULL || command_end == NULL || command_end < command_start) {
+		return false;
+	}
+
+	unsigned long long utime = 0;
+	unsigned long long stime = 0;
+	if (sscanf(command_end + 1,
+			   " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %*d %*d "
+			   "%llu %*u %ld",
+			   &sample->state, &utime, &stime, &sample->start_time, &sample->rss_pages) != 5) {
+		return false;
+	}
+
+	size_t command_length = (size_t)(command_end - command_start - 1);
+	if (command_length >= sizeof(sample->command)) {
+		command_length = sizeof(sample->command) - 1;
+	}
+	memcpy(sample->command, command_start + 1, command_length);
+	sample->command[command_length] = '\0';
+
+	sample->pid = (pid_t)pid;
+	sample->cpu_ticks = utime + stime;
+	return true;
+}
+
+load_proc_table load_read_proc_table(const char *proc_dir) {
+	load_proc_table table = {
+		.samples = NULL,
+		.count = 0,
+	};
+
+	DIR *directory = opendir(proc_dir);
+	if (directory == NULL) {
+		return table;
+	}
+
+	size_t capacity = 1024;
+	table.samples = malloc(capacity * sizeof(load_proc_sample));
+	if (table.samples == NULL) {
+		die(STATE_UNKNOWN, _("Could not malloc() units [%lu]\n"), capacity);
+	}
+
+	char path[MAX_INPUT_BUFFER];
+	char buffer[MAX_INPUT_BUFFER];
+	struct dirent *entry;
+	while ((entry = readdir(directory)) != NULL) {
+		if (!isdigit((unsigned char)entry->d_name[0])) {
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "%s/%s/stat", proc_dir, entry->d_name);
+		int stat_fd = open(path, O_RDONLY);
+		if (stat_fd < 0) {
+			/* the process is gone already */
+			continue;
+		}
+		ssize_t length = read(stat_fd, buffer, sizeof(buffer) - 1);
+		close(stat_fd);
+		if (length <= 0) {
+			continue;
+		}
+		buffer[length] = '\0';
+
+		if (table.count == capacity) {
+			capacity *= 2;
+			table.samples = realloc(table.samples, capacity * sizeof(load_proc_sample));
+			if (table.samples == NULL) {
+				die(STATE_UNKNOWN, _("Could not realloc() units [%lu]\n"), capacity);
+			}
+		}
+
+		if (load_parse_proc_stat(buffer, &table.samples[table.count])) {
+			table.count++;
+		}
+	}
+
+	closedir(directory);
+	return table;
+}
+
+void load_free_proc_table(load_proc_table table[static 1]) {
+	free(table->samples);
+	table->samples = NULL;
+	table->count = 0;
+}
+
+/* open addressing on (pid, start time), the table is at most half full */
+typedef struct {
+	size_t *slots; /* index into the samples + 1, 0 marks a free slot */
+	size_t mask;
+} load_pid_index;
+
+static size_t load_pid_hash(pid_t pid, unsigned long long start_time, size_t mask) {
+	unsigned long long key = ((unsigned long long)pid << 32) ^ start_time;
+	key *= 0x9E3779B97F4A7C15ULL;
+	return (size_t)(key >> 32) & mask;
+}
+
+static load_pid_index load_build_pid_index(const load_proc_table table[static 1]) {
+	size_t size = 16;
+	while (size < table->count * 2) {
+		size *= 2;
+	}
+
+	load_pid_index index = {
+		.slots = calloc(size, sizeof(size_t)),
+		.mask = size - 1,
+	};
+	if (index.slots == NULL) {
+		die(STATE_UNKNOWN, _("Could not calloc() units [%lu]\n"), size);
+	}
+
+	for (size_t i = 0; i < table->count; i++) {
+		size_t slot = load_pid_hash(table->samples[i].pid, table->samples[i].start_time,
+									index.mask);
+		while (index.slots[slot] != 0) {
+			slot = (slot + 1) & index.mask;
+		}
+		index.slots[slot] = i + 1;
+	}
+	return index;
+}
+
+static const load_proc_sample *load_find_sample(const load_pid_index index[static 1],
+												const load_proc_table table[static 1],
+												const load_proc_sample sample[static 1]) {
+	for (size_t slot = load_pid_hash(sample->pid, sample->start_time, index->mask);
+		 index->slots[slot] != 0; slot = (slot + 1) & index->mask) {
+		const load_proc_sample *candidate = &table->samples[index->slots[slot] - 1];
+		if (candidate->pid == sample->pid && candidate->start_time == sample->start_time) {
+			return candidate;
+		}
+	}
+	return NULL;
+}
+
+/* the heap order: less busy first, equally busy ones by the total CPU time they used */
+static bool load_entry_less(const load_top_entry *left, const load_top_entry *right) {
+	if (left->delta_ticks != right->delta_ticks) {
+		return left->delta_ticks < right->delta_ticks;
+	}
+	if (left->sample.cpu_ticks != right->sample.cpu_ticks) {
+		return left->sample.cpu_ticks < right->sample.cpu_ticks;
+	}
+	return left->sample.pid > right->sample.pid;
+}
+
+static void load_heap_sift_down(load_top_entry heap[], size_t count, size_t position) {
+	while (true) {
+		size_t smallest = position;
+		size_t left = 2 * position + 1;
+		size_t right = left + 1;
+		if (left < count && load_entry_less(&heap[left], &heap[smallest])) {
+			smallest = left;
+		}
+		if (right < count && load_entry_less(&heap[right], &heap[smallest])) {
+			smallest = right;
+		}
+		if (smallest == position) {
+			return;
+		}
+		load_top_entry tmp = heap[position];
+		heap[position] = heap[smallest];
+		heap[smallest] = tmp;
+		position = smallest;
+	}
+}
+
+static void load_heap_sift_up(load_top_entry heap[], size_t position) {
+	while (position > 0) {
+		size_t parent = (position - 1) / 2;
+		if (!load_entry_less(&heap[position], &heap[parent])) {
+			return;
+		}
+		load_top_entry tmp = heap[position];
+		heap[position] = heap[parent];
+		heap[parent] = tmp;
+		position = parent;
+	}
+}
+
+size_t load_select_top(const load_proc_table before[static 1],
+					   const load_proc_table after[static 1], double elapsed_seconds,
+					   long ticks_per_second, size_t n, load_top_entry top[]) {
+	if (n == 0) {
+		return 0;
+	}
+
+	load_pid_index index = load_build_pid_index(before);
+
+	/* a min-heap of the n busiest processes seen so far, its root is the one to replace */
+	size_t count = 0;
+	for (size_t i = 0; i < after->count; i++) {
+		load_top_entry candidate = {
+			.sample = after->samples[i],
+			.delta_ticks = after->samples[i].cpu_ticks,
+		};
+
+		/* a process started in between used all of its CPU time while we watched */
+		const load_proc_sample *previous = load_find_sample(&index, before, &after->samples[i]);
+		if (previous != NULL) {
+			candidate.delta_ticks = (candidate.sample.cpu_ticks > previous->cpu_ticks)
+										? candidate.sample.cpu_ticks - previous->cpu_ticks
+										: 0;
+		}
+
+		if (count < n) {
+			top[count] = candidate;
+			load_heap_sift_up(top, count);
+			count++;
+		} else if (load_entry_less(&top[0], &candidate)) {
+			top[0] = candidate;
+			load_heap_sift_down(top, count, 0);
+		}
+	}
+	free(index.slots);
+
+	/* heap sort the selection, the least busy one goes to the end */
+	for (size_t heap_size = count; heap_size > 1; heap_size--) {
+		load_top_entry tmp = top[0];
+		top[0] = top[heap_size - 1];
+		top[heap_size - 1] = tmp;
+		load_heap_sift_down(top, heap_size - 1, 0);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		top[i].pcpu = (elapsed_seconds > 0 && ticks_per_second > 0)
+						  ? 100.0 * (double)top[i].delta_ticks /
+								((double)ticks_per_second * elapsed_seconds)
+						  : 0;
+	}
+
+	return count;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* the kernel limits comm to 16 bytes, the rest is room for "[kworker/...]" style names */
+#define LOAD_COMMAND_LENGTH 64
+
+/* One process as seen in /proc/PID/stat */
+typedef struct {
+	pid_t pid;
+	unsigned long long start_time; /* clock ticks after boot, tells reused pids apart */
+	unsigned long long cpu_ticks;  /* utime + stime */
+	long rss_pages;
+	char state;
+	char command[LOAD_COMMAND_LENGTH];
+} load_proc_sample;
+
+typedef struct {
+	load_proc_sample *samples;
+	size_t count;
+} load_proc_table;
+
+/* A process with the CPU time it used between two samples */
+typedef struct {
+	load_proc_sample sample;
+	unsigned long long delta_ticks;
+	double pcpu;
+} load_top_entry;
+
+/* Parses the contents of /proc/PID/stat, the command may contain blanks and parentheses */
+bool load_parse_proc_stat(const char *text, load_proc_sample sample[static 1]);
+
+/*
+ * Reads /proc/PID/stat of every process below proc_dir. Processes vanishing
+ * while we read are skipped. Returns a table with samples == NULL if
+ * proc_dir can't be read.
+ */
+load_proc_table load_read_proc_table(const char *proc_dir);
+void load_free_proc_table(load_proc_table table[static 1]);
+
+/*
+ * Selects the n processes which used the most CPU time between before and
+ * after into top, busiest first, and returns how many were selected. Each
+ * process is looked at once, the selection is kept in a heap of n entries.
+ */
+size_t load_select_top(const load_proc_table before[static 1],
+					   const load_proc_table after[static 1], double elapsed_seconds,
+					   long ticks_per_second, size_t n, load_top_entry top[]);
@@ -0,0 +1,551 @@
+/*****************************************************************************
+ *
+ * Monitoring check_memory plugin
+ *
+ * License: GPL
+ * Copyright (c) 2025 Monitoring Plugins Development Team
+ *
+ * Description:
+ *
+ * This file contains the check_memory plugin
+ *
+ * This plugin checks the available memory of a Linux system and of a cgroup
+ * and reports the fields of /proc/meminfo and the cgroup v2 memory controller.
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+const char *progname = "check_memory";
+const char *copyright = "2025-2026";
+const char *email = "devel@monitoring-plugins.org";
+
+#include "./common.h"
+#include "./utils.h"
+#include "../lib/states.h"
+#include "../lib/output.h"
+#include "../lib/perfdata.h"
+#include "../lib/thresholds.h"
+#include "check_memory.d/config.h"
+#include "check_memory.d/meminfo.h"
+
+#include <limits.h>
+#include <stdint.h>
+
+typedef struct {
+	int errorcode;
+	check_memory_config config;
+} check_memory_config_wrapper;
+static check_memory_config_wrapper process_arguments(int argc, char **argv);
+
+void print_help(void);
+void print_usage(void);
+
+static mp_subcheck evaluate_meminfo(check_memory_config config, const memory_value meminfo[]);
+static mp_subcheck evaluate_cgroup(check_memory_config config, const char *cgroup_path,
+								   unsigned long long mem_total);
+
+/* used by the check_swap helpers */
+int verbose = 0;
+
+#define HUNDRED_PERCENT 100
+#define CGROUP_PREFIX   "cgroup_"
+
+int main(int argc, char **argv) {
+	setlocale(LC_ALL, "");
+	bindtextdomain(PACKAGE, LOCALEDIR);
+	textdomain(PACKAGE);
+
+	/* Parse extra opts if any */
+	argv = np_extra_opts(&argc, argv, progname);
+
+	check_memory_config_wrapper tmp_config = process_arguments(argc, argv);
+	if (tmp_config.errorcode == ERROR) {
+		usage4(_("Could not parse arguments"));
+	}
+
+	const check_memory_config config = tmp_config.config;
+
+	if (config.output_format_is_set) {
+		mp_set_format(config.output_format);
+	}
+
+	char *meminfo_text = memory_read_file(config.meminfo_path);
+	if (meminfo_text == NULL) {
+		die(STATE_UNKNOWN, _("Could not read %s\n"), config.meminfo_path);
+	}
+	memory_value *meminfo = calloc(memory_meminfo_fields_count, sizeof(memory_value));
+	if (meminfo == NULL) {
+		die(STATE_UNKNOWN, _("Could not calloc() meminfo fields\n"));
+	}
+	memory_parse_fields(meminfo_text, memory_meminfo_fields, memory_meminfo_fields_count, meminfo);
+	free(meminfo_text);
+
+	mp_check overall = mp_check_init();
+
+	if (config.cgroup_path != NULL) {
+		long total_index =
+			memory_find_field(memory_meminfo_fields, memory_meminfo_fields_count, "MemTotal");
+		mp_add_subcheck_to_check(
+			&overall, evaluate_cgroup(config, config.cgroup_path, meminfo[total_index].value));
+	}
+
+	mp_add_subcheck_to_check(&overall, evaluate_meminfo(config, meminfo));
+	free(meminfo);
+
+	mp_exit(overall);
+}
+
+/* percentages are relative to total */
+static unsigned long long threshold_to_absolute(check_swap_threshold threshold,
+												unsigned long long total) {
+	if (threshold.is_percentage) {
+		return (unsigned long long)((double)total * (double)threshold.value / HUNDRED_PERCENT);
+	}
+	return threshold.value;
+}
+
+static const check_memory_field_threshold *find_field_threshold(check_memory_config config,
+																const char *label) {
+	for (size_t i = 0; i < config.field_thresholds_count; i++) {
+		if (strcmp(config.field_thresholds[i].label, label) == 0) {
+			return &config.field_thresholds[i];
+		}
+	}
+	return NULL;
+}
+
+/* a field exceeding its threshold is a problem */
+static mp_range upper_limit(check_swap_threshold threshold, unsigned long long total) {
+	mp_range result = mp_range_init();
+	result = mp_range_set_start(result, mp_create_pd_value(0));
+	result = mp_range_set_end(result, mp_create_pd_value(threshold_to_absolute(threshold, total)));
+	return result;
+}
+
+/* too little available memory is a problem */
+static mp_range lower_limit(check_swap_threshold threshold, unsigned long long total) {
+	mp_range result = mp_range_init();
+	result =
+		mp_range_set_start(result, mp_create_pd_value(threshold_to_absolute(threshold, total)));
+	return result;
+}
+
+static char *format_field(const char *label, memory_unit unit, unsigned long long value) {
+	char *result = NULL;
+	if (unit == MEMORY_UNIT_BYTES) {
+		xasprintf(&result, "%s: %.1f MiB", label, (double)value / (1024 * 1024));
+	} else {
+		xasprintf(&result, "%s: %llu", label, value);
+	}
+	return result;
+}
+
+/*
+ * Adds the perfdata of all present fields to subcheck, fields with a threshold
+ * get a subcheck of their own
+ */
+static void add_fields(mp_subcheck subcheck[static 1], check_memory_config config,
+					   const char *label_prefix, const memory_field fields[], size_t fields_count,
+					   const memory_value values[], unsigned long long percentage_base) {
+	for (size_t i = 0; i < fields_count; i++) {
+		if (!values[i].present) {
+			continue;
+		}
+
+		mp_perfdata field_pd = perfdata_init();
+		xasprintf(&field_pd.label, "%s%s", label_prefix, fields[i].key);
+		field_pd = mp_set_pd_value(field_pd, values[i].value);
+		if (fields[i].unit == MEMORY_UNIT_BYTES) {
+			field_pd.uom = "B";
+		}
+
+		const check_memory_field_threshold *threshold =
+			find_field_threshold(config, field_pd.label);
+		if (threshold == NULL) {
+			mp_add_perfdata_to_subcheck(subcheck, field_pd);
+			continue;
+		}
+
+		mp_thresholds field_thresholds = mp_thresholds_init();
+		if (threshold->warn_is_set) {
+			field_thresholds = mp_thresholds_set_warn(
+				field_thresholds, upper_limit(threshold->warn, percentage_base));
+		}
+		if (threshold->crit_is_set) {
+			field_thresholds = mp_thresholds_set_crit(
+				field_thresholds, upper_limit(threshold->crit, percentage_base));
+		}
+		field_pd = mp_pd_set_thresholds(field_pd, field_thresholds);
+
+		mp_subcheck field_sc = mp_subcheck_init();
+		field_sc = mp_set_subcheck_state(field_sc, mp_get_pd_status(field_pd));
+		field_sc.output = format_field(field_pd.label, fields[i].unit, values[i].value);
+		mp_add_perfdata_to_subcheck(&field_sc, field_pd);
+		mp_add_subcheck_to_subcheck(subcheck, field_sc);
+	}
+}
+
+/* the available memory against -w and -c, relative to total */
+static mp_subcheck evaluate_available(check_memory_config config, const char *label,
+									  unsigned long long available, unsigned long long total) {
+	mp_perfdata available_pd = perfdata_init();
+	available_pd.label = (char *)label;
+	available_pd.uom = "B";
+	available_pd = mp_set_pd_value(available_pd, available);
+	available_pd = mp_set_pd_min_value(available_pd, mp_create_pd_value(0));
+	available_pd = mp_set_pd_max_value(available_pd, mp_create_pd_value(total));
+	mp_thresholds available_thresholds = mp_thresholds_init();
+	if (config.warn_is_set) {
+		available_thresholds =
+			mp_thresholds_set_warn(available_thresholds, lower_limit(config.warn, total));
+	}
+	if (config.crit_is_set) {
+		available_thresholds =
+			mp_thresholds_set_crit(available_thresholds, lower_limit(config.crit, total));
+	}
+	available_pd = mp_pd_set_thresholds(available_pd, available_thresholds);
+
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_state(result, mp_get_pd_status(available_pd));
+	xasprintf(&result.output, _("%.1f%% available (%llu MiB of %llu MiB)"),
+			  (total > 0) ? HUNDRED_PERCENT * (double)available / (double)total : 0.0,
+			  available >> 20, total >> 20);
+	mp_add_perfdata_to_subcheck(&result, available_pd);
+	return result;
+}
+
+static mp_subcheck evaluate_meminfo(check_memory_config config, const memory_value meminfo[]) {
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+	result.output = "Memory";
+
+	long total_index =
+		memory_find_field(memory_meminfo_fields, memory_meminfo_fields_count, "MemTotal");
+	long available_index =
+		memory_find_field(memory_meminfo_fields, memory_meminfo_fields_count, "MemAvailable");
+
+	/* MemAvailable exists since Linux 3.14 */
+	if (!meminfo[total_index].present || !meminfo[available_index].present) {
+		mp_subcheck available_sc = mp_subcheck_init();
+		available_sc = mp_set_subcheck_state(available_sc, STATE_UNKNOWN);
+		xasprintf(&available_sc.output, _("MemTotal or MemAvailable missing in %s"),
+				  config.meminfo_path);
+		mp_add_subcheck_to_subcheck(&result, available_sc);
+	} else {
+		mp_add_subcheck_to_subcheck(&result,
+									evaluate_available(config, "MemAvailable",
+													   meminfo[available_index].value,
+													   meminfo[total_index].value));
+	}
+
+	/* MemAvailable is reported above, with the thresholds */
+	memory_value *others = calloc(memory_meminfo_fields_count, sizeof(memory_value));
+	if (others == NULL) {
+		die(STATE_UNKNOWN, _("Could not calloc() meminfo fields\n"));
+	}
+	memcpy(others, meminfo, memory_meminfo_fields_count * sizeof(memory_value));
+	others[available_index].present = false;
+	add_fields(&result, config, "", memory_meminfo_fields, memory_meminfo_fields_count, others,
+			   meminfo[total_index].value);
+	free(others);
+
+	return result;
+}
+
+static mp_subcheck evaluate_cgroup(check_memory_config config, const char *cgroup_path,
+								   unsigned long long mem_total) {
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+
+	memory_cgroup cgroup = memory_read_cgroup(cgroup_path);
+	if (!cgroup.available) {
+		result = mp_set_subcheck_state(result, STATE_UNKNOWN);
+		xasprintf(&result.output, _("Could not read memory.current of cgroup %s"), cgroup_path);
+		memory_free_cgroup(&cgroup);
+		return result;
+	}
+
+	mp_perfdata current_pd = perfdata_init();
+	current_pd.label = CGROUP_PREFIX "current";
+	current_pd.uom = "B";
+	current_pd = mp_set_pd_value(current_pd, cgroup.current);
+	current_pd = mp_set_pd_min_value(current_pd, mp_create_pd_value(0));
+
+	/* without a limit the cgroup may use all the memory of the system */
+	unsigned long long percentage_base = mem_total;
+	if (cgroup.limited) {
+		percentage_base = cgroup.max;
+		current_pd = mp_set_pd_max_value(current_pd, mp_create_pd_value(cgroup.max));
+
+		unsigned long long available =
+			(cgroup.max > cgroup.current) ? cgroup.max - cgroup.current : 0;
+		mp_add_subcheck_to_subcheck(
+			&result, evaluate_available(config, CGROUP_PREFIX "available", available, cgroup.max));
+		xasprintf(&result.output, _("cgroup %s: %llu MiB of %llu MiB used"), cgroup_path,
+				  cgroup.current >> 20, cgroup.max >> 20);
+	} else {
+		xasprintf(&result.output, _("cgroup %s: %llu MiB used, no memory limit"), cgroup_path,
+				  cgroup.current >> 20);
+	}
+	mp_add_perfdata_to_subcheck(&result, current_pd);
+
+	/* the events are counted since the cgroup was created */
+	add_fields(&result, config, CGROUP_PREFIX, memory_cgroup_events_fields,
+			   memory_cgroup_events_fields_count, cgroup.events, percentage_base);
+	add_fields(&result, config, CGROUP_PREFIX, memory_cgroup_stat_fields,
+			   memory_cgroup_stat_fields_count, cgroup.stat, percentage_base);
+
+	memory_free_cgroup(&cgroup);
+	return result;
+}
+
+/* the unit of a perfdata label, false if there is no such field */
+static bool find_field_unit(const char *label, memory_unit unit[static 1]) {
+	long index;
+	if (strncmp(label, CGROUP_PREFIX, strlen(CGROUP_PREFIX)) == 0) {
+		const char *key = label + strlen(CGROUP_PREFIX);
+		if ((index = memory_find_field(memory_cgroup_stat_fields, memory_cgroup_stat_fields_count,
+									   key)) >= 0) {
+			*unit = memory_cgroup_stat_fields[index].unit;
+			return true;
+		}
+		if ((index = memory_find_field(memory_cgroup_events_fields,
+									   memory_cgroup_events_fields_count, key)) >= 0) {
+			*unit = memory_cgroup_events_fields[index].unit;
+			return true;
+		}
+		return false;
+	}
+
+	if ((index = memory_find_field(memory_meminfo_fields, memory_meminfo_fields_count, label)) >=
+			0 &&
+		strcmp(label, "MemAvailable") != 0) {
+		*unit = memory_meminfo_fields[index].unit;
+		return true;
+	}
+	return false;
+}
+
+static check_memory_field_threshold *get_field_threshold(check_memory_config config[static 1],
+														 const char *label) {
+	for (size_t i = 0; i < config->field_thresholds_count; i++) {
+		if (strcmp(config->field_thresholds[i].label, label) == 0) {
+			return &config->field_thresholds[i];
+		}
+	}
+
+	config->field_thresholds =
+		realloc(config->field_thresholds,
+				(config->field_thresholds_count + 1) * sizeof(check_memory_field_threshold));
+	if (config->field_thresholds == NULL) {
+		die(STATE_UNKNOWN, _("Could not realloc() field thresholds\n"));
+	}
+
+	check_memory_field_threshold *result =
+		&config->field_thresholds[config->field_thresholds_count++];
+	*result = (check_memory_field_threshold){
+		.label = strdup(label),
+		.warn_is_set = false,
+		.crit_is_set = false,
+	};
+	return result;
+}
+
+/* process command-line arguments */
+static check_memory_config_wrapper process_arguments(int argc, char **argv) {
+	enum {
+		output_format_index = CHAR_MAX + 1,
+		field_warning_index,
+		field_critical_index,
+		cgroup_index,
+		meminfo_index,
+	};
+
+	static struct option longopts[] = {{"warning", required_argument, 0, 'w'},
+									   {"critical", required_argument, 0, 'c'},
+									   {"field-warning", required_argument, 0, field_warning_index},
+									   {"field-critical", required_argument, 0,
+										field_critical_index},
+									   {"cgroup", required_argument, 0, cgroup_index},
+									   {"meminfo", required_argument, 0, meminfo_index},
+									   {"verbose", no_argument, 0, 'v'},
+									   {"version", no_argument, 0, 'V'},
+									   {"help", no_argument, 0, 'h'},
+									   {"output-format", required_argument, 0, output_format_index},
+									   {0, 0, 0, 0}};
+
+	check_memory_config_wrapper result = {
+		.errorcode = OK,
+		.config = check_memory_config_init(),
+	};
+
+	while (true) {
+		int option = 0;
+		int option_char = getopt_long(argc, argv, "+?Vvhw:c:", longopts, &option);
+
+		if (option_char == -1 || option_char == EOF) {
+			break;
+		}
+
+		switch (option_char) {
+		case 'w': /* warning available memory threshold */
+		case 'c': /* critical available memory threshold */
+		{
+			swap_threshold_parsed parsed = parse_swap_threshold(optarg);
+			if (parsed.error == SWAP_THRESHOLD_PERCENTAGE_TOO_BIG) {
+				usage2(_("Threshold percentage must be <= 100"), optarg);
+			} else if (parsed.error != SWAP_THRESHOLD_PARSING_SUCCESS) {
+				usage2(_("Threshold must be a positive integer or percentage"), optarg);
+			}
+
+			if (option_char == 'w') {
+				result.config.warn_is_set = true;
+				result.config.warn = parsed.threshold;
+			} else {
+				result.config.crit_is_set = true;
+				result.config.crit = parsed.threshold;
+			}
+		} break;
+		case field_warning_index:
+		case field_critical_index: {
+			char *separator = strrchr(optarg, '=');
+			if (separator == NULL) {
+				usage2(_("Field thresholds are given as FIELD=THRESHOLD"), optarg);
+			}
+			*separator = '\0';
+
+			memory_unit unit;
+			if (!find_field_unit(optarg, &unit)) {
+				usage2(_("Unknown field"), optarg);
+			}
+
+			swap_threshold_parsed parsed = parse_swap_threshold(separator + 1);
+			if (parsed.error == SWAP_THRESHOLD_PERCENTAGE_TOO_BIG) {
+				usage2(_("Threshold percentage must be <= 100"), separator + 1);
+			} else if (parsed.error != SWAP_THRESHOLD_PARSING_SUCCESS) {
+				usage2(_("Threshold must be a positive integer or percentage"), separator + 1);
+			}
+			if (parsed.threshold.is_percentage && unit == MEMORY_UNIT_COUNT) {
+				usage2(_("Percentages can not be used for counters"), optarg);
+			}
+
+			check_memory_field_threshold *threshold = get_field_threshold(&result.config, optarg);
+			if (option_char == field_warning_index) {
+				threshold->warn_is_set = true;
+				threshold->warn = parsed.threshold;
+			} else {
+				threshold->crit_is_set = true;
+				threshold->crit = parsed.threshold;
+			}
+		} break;
+		case cgroup_index:
+			if (optarg[0] == '/') {
+				result.config.cgroup_path = strdup(optarg);
+			} else {
+				xasprintf(&result.config.cgroup_path, "%s/%s", MEMORY_CGROUP_ROOT, optarg);
+			}
+			break;
+		case meminfo_index:
+			result.config.meminfo_path = optarg;
+			break;
+		case 'v': /* verbose */
+			verbose++;
+			break;
+		case output_format_index: {
+			parsed_output_format parser = mp_parse_output_format(optarg);
+			if (!parser.parsing_success) {
+				printf("Invalid output format: %s\n", optarg);
+				exit(STATE_UNKNOWN);
+			}
+
+			result.config.output_format_is_set = true;
+			result.config.output_format = parser.output_format;
+			break;
+		}
+		case 'V': /* version */
+			print_revision(progname, NP_VERSION);
+			exit(STATE_UNKNOWN);
+		case 'h': /* help */
+			print_help();
+			exit(STATE_UNKNOWN);
+		case '?': /* error */
+			usage5();
+		}
+	}
+
+	if (result.config.warn_is_set && result.config.crit_is_set &&
+		(result.config.warn.is_percentage == result.config.crit.is_percentage) &&
+		(result.config.warn.value < result.config.crit.value)) {
+		usage4(_("Warning should be more than critical"));
+	}
+
+	return result;
+}
+
+void print_help(void) {
+	print_revision(progname, NP_VERSION);
+
+	printf(COPYRIGHT, copyright, email);
+
+	printf("%s\n", _("This plugin checks the available memory of a Linux system and reports the"));
+	printf("%s\n", _("fields of /proc/meminfo and of the cgroup v2 memory controller."));
+
+	printf("\n\n");
+
+	print_usage();
+
+	printf(UT_HELP_VRSN);
+	printf(UT_EXTRA_OPTS);
+
+	printf(" %s\n", "-w, --warning=INTEGER|PERCENT%");
+	printf("    %s\n", _("Exit with WARNING status if less than INTEGER bytes or PERCENT of the"));
+	printf("    %s\n", _("memory are available (MemAvailable, or the limit of the cgroup minus"));
+	printf("    %s\n", _("its usage)"));
+	printf(" %s\n", "-c, --critical=INTEGER|PERCENT%");
+	printf("    %s\n", _("Exit with CRITICAL status if less than INTEGER bytes or PERCENT of the"));
+	printf("    %s\n", _("memory are available"));
+	printf(" %s\n", "--field-warning=FIELD=INTEGER|PERCENT%");
+	printf(" %s\n", "--field-critical=FIELD=INTEGER|PERCENT%");
+	printf("    %s\n", _("Exit with WARNING or CRITICAL status if FIELD is above INTEGER"));
+	printf("    %s\n", _("or PERCENT of the total memory (of the cgroup limit for cgroup"));
+	printf("    %s\n", _("fields). FIELD is the perfdata label, e.g. Dirty, Writeback, Slab"));
+	printf("    %s\n", _("or cgroup_oom_kill. Counters only take INTEGER. Can be given several"));
+	printf("    %s\n", _("times"));
+	printf(" %s\n", "--cgroup=PATH");
+	printf("    %s\n", _("cgroup v2 directory to report memory.current, memory.stat and"));
+	printf("    %s\n", _("memory.events of, relative paths are taken below " MEMORY_CGROUP_ROOT));
+	printf(" %s\n", "--meminfo=FILE");
+	printf("    %s\n", _("Read FILE instead of /proc/meminfo"));
+	printf(UT_OUTPUT_FORMAT);
+	printf(UT_VERBOSE);
+
+	printf("\n");
+	printf("%s\n", _("Notes:"));
+	printf(" %s\n", _("The thresholds take the same format as the ones of check_swap."));
+	printf(" %s\n", _("The memory.events counters count since the creation of the cgroup."));
+
+	printf(UT_SUPPORT);
+}
+
+void print_usage(void) {
+	printf("%s\n", _("Usage:"));
+	printf(" %s [-v] -w <bytes_available>|<percent_available>%% -c <bytes_available>|"
+		   "<percent_available>%%\n",
+		   progname);
+	printf("  [--field-warning=FIELD=THRESHOLD] [--field-critical=FIELD=THRESHOLD]\n");
+	printf("  [--cgroup=PATH] [--meminfo=FILE]\n");
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "output.h"
+#include "../check_swap.d/check_swap.h"
+
+/* an upper limit for one of the reported fields, e.g. --field-warning=Dirty=5% */
+typedef struct {
+	char *label;
+	bool warn_is_set;
+	check_swap_threshold warn;
+	bool crit_is_set;
+	check_swap_threshold crit;
+} check_memory_field_threshold;
+
+typedef struct {
+	/* lower limits for the available memory, the same format as the check_swap thresholds */
+	bool warn_is_set;
+	check_swap_threshold warn;
+	bool crit_is_set;
+	check_swap_threshold crit;
+
+	check_memory_field_threshold *field_thresholds;
+	size_t field_thresholds_count;
+
+	char *meminfo_path;
+	/* cgroup v2 directory */
+	char *cgroup_path;
+
+	bool output_format_is_set;
+	mp_output_format output_format;
+} check_memory_config;
+
+check_memory_config check_memory_config_init() {
+	check_memory_config tmp = {
+		.warn_is_set = false,
+		.crit_is_set = false,
+
+		.field_thresholds = NULL,
+		.field_thresholds_count = 0,
+
+#ifdef PROC_MEMINFO
+		.meminfo_path = PROC_MEMINFO,
+#else
+		.meminfo_path = "/proc/meminfo",
+#endif
+		.cgroup_path = NULL,
+
+		.output_format_is_set = false,
+	};
+	return tmp;
+}
@@ -0,0 +1,265 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./meminfo.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+const memory_field memory_meminfo_fields[] = {
+	{"MemTotal", MEMORY_UNIT_BYTES},
+	{"MemFree", MEMORY_UNIT_BYTES},
+	{"MemAvailable", MEMORY_UNIT_BYTES},
+	{"Buffers", MEMORY_UNIT_BYTES},
+	{"Cached", MEMORY_UNIT_BYTES},
+	{"SwapCached", MEMORY_UNIT_BYTES},
+	{"Active", MEMORY_UNIT_BYTES},
+	{"Inactive", MEMORY_UNIT_BYTES},
+	{"Unevictable", MEMORY_UNIT_BYTES},
+	{"Mlocked", MEMORY_UNIT_BYTES},
+	{"SwapTotal", MEMORY_UNIT_BYTES},
+	{"SwapFree", MEMORY_UNIT_BYTES},
+	{"Dirty", MEMORY_UNIT_BYTES},
+	{"Writeback", MEMORY_UNIT_BYTES},
+	{"AnonPages", MEMORY_UNIT_BYTES},
+	{"Mapped", MEMORY_UNIT_BYTES},
+	{"Shmem", MEMORY_UNIT_BYTES},
+	{"KReclaimable", MEMORY_UNIT_BYTES},
+	{"Slab", MEMORY_UNIT_BYTES},
+	{"SReclaimable", MEMORY_UNIT_BYTES},
+	{"SUnreclaim", MEMORY_UNIT_BYTES},
+	{"KernelStack", MEMORY_UNIT_BYTES},
+	{"PageTables", MEMORY_UNIT_BYTES},
+	{"CommitLimit", MEMORY_UNIT_BYTES},
+	{"Committed_AS", MEMORY_UNIT_BYTES},
+	{"VmallocUsed", MEMORY_UNIT_BYTES},
+	{"AnonHugePages", MEMORY_UNIT_BYTES},
+	{"HugePages_Total", MEMORY_UNIT_COUNT},
+	{"HugePages_Free", MEMORY_UNIT_COUNT},
+	{"HugePages_Rsvd", MEMORY_UNIT_COUNT},
+	{"HugePages_Surp", MEMORY_UNIT_COUNT},
+	{"Hugepagesize", MEMORY_UNIT_BYTES},
+	{"Hugetlb", MEMORY_UNIT_BYTES},
+};
+const size_t memory_meminfo_fields_count =
+	sizeof(memory_meminfo_fields) / sizeof(memory_meminfo_fields[0]);
+
+const memory_field memory_cgroup_stat_fields[] = {
+	{"anon", MEMORY_UNIT_BYTES},
+	{"file", MEMORY_UNIT_BYTES},
+	{"kernel", MEMORY_UNIT_BYTES},
+	{"kernel_stack", MEMORY_UNIT_BYTES},
+	{"pagetables", MEMORY_UNIT_BYTES},
+	{"sock", MEMORY_UNIT_BYTES},
+	{"shmem", MEMORY_UNIT_BYTES},
+	{"file_mapped", MEMORY_UNIT_BYTES},
+	{"file_dirty", MEMORY_UNIT_BYTES},
+	{"file_writeback", MEMORY_UNIT_BYTES},
+	{"swapcached", MEMORY_UNIT_BYTES},
+	{"anon_thp", MEMORY_UNIT_BYTES},
+	{"slab_reclaimable", MEMORY_UNIT_BYTES},
+	{"slab_unreclaimable", MEMORY_UNIT_BYTES},
+	{"slab", MEMORY_UNIT_BYTES},
+	{"workingset_refault_anon", MEMORY_UNIT_COUNT},
+	{"workingset_refault_file", MEMORY_UNIT_COUNT},
+	{"pgscan", MEMORY_UNIT_COUNT},
+	{"pgsteal", MEMORY_UNIT_COUNT},
+	{"pgfault", MEMORY_UNIT_COUNT},
+	{"pgmajfault", MEMORY_UNIT_COUNT},
+};
+const size_t memory_cgroup_stat_fields_count =
+	sizeof(memory_cgroup_stat_fields) / sizeof(memory_cgroup_stat_fields[0]);
+
+const memory_field memory_cgroup_events_fields[] = {
+	{"low", MEMORY_UNIT_COUNT},      {"high", MEMORY_UNIT_COUNT},
+	{"max", MEMORY_UNIT_COUNT},      {"oom", MEMORY_UNIT_COUNT},
+	{"oom_kill", MEMORY_UNIT_COUNT}, {"oom_group_kill", MEMORY_UNIT_COUNT},
+};
+const size_t memory_cgroup_events_fields_count =
+	sizeof(memory_cgroup_events_fields) / sizeof(memory_cgroup_events_fields[0]);
+
+long memory_find_field(const memory_field fields[], size_t fields_count, const char *key) {
+	for (size_t i = 0; i < fields_count; i++) {
+		if (strcmp(fields[i].key, key) == 0) {
+			return (long)i;
+		}
+	}
+	return -1;
+}
+
+size_t memory_parse_fields(const char *text, const memory_field fields[], size_t fields_count,
+						   memory_value values[]) {
+	for (size_t i = 0; i < fields_count; i++) {
+		values[i].present = false;
+		values[i].value = 0;
+	}
+	if (text == NULL || fields_count == 0) {
+		return 0;
+	}
+
+	size_t found = 0;
+	/* the tables are in the order the kernel prints, so the next line usually is the next field */
+	size_t cursor = 0;
+	while (*text != '\0') {
+		const char *key_end = text;
+		while (*key_end != '\0' && *key_end != ':' && !isspace((unsigned char)*key_end)) {
+			key_end++;
+		}
+		size_t key_length = (size_t)(key_end - text);
+
+		for (size_t tried = 0; key_length > 0 && tried < fields_count; tried++) {
+			size_t i = (cursor + tried) % fields_count;
+			if (strncmp(fields[i].key, text, key_length) != 0 ||
+				fields[i].key[key_length] != '\0') {
+				continue;
+			}
+
+			const char *number = key_end + (*key_end == ':');
+			char *number_end = NULL;
+			unsigned long long value = strtoull(number, &number_end, 10);
+			if (number_end != number && !values[i].present) {
+				while (*number_end == ' ' || *number_end == '\t') {
+					number_end++;
+				}
+				if (strncmp(number_end, "kB", 2) == 0) {
+					value *= 1024;
+				}
+				values[i].present = true;
+				values[i].value = value;
+				found++;
+			}
+			cursor = i + 1;
+			break;
+		}
+
+		text = strchr(text, '\n');
+		if (text == NULL) {
+			break;
+		}
+		text++;
+	}
+
+	return found;
+}
+
+char *memory_read_file(const char *path) {
+	int file = open(path, O_RDONLY);
+	if (file < 0) {
+		return NULL;
+	}
+
+	/* memory.stat and /proc/meminfo are a few kB, read until the end in any case */
+	size_t size = MAX_INPUT_BUFFER;
+	size_t length = 0;
+	char *buffer = malloc(size);
+	while (buffer != NULL) {
+		ssize_t got = read(file, buffer + length, size - length - 1);
+		if (got < 0) {
+			free(buffer);
+			buffer = NULL;
+			break;
+		}
+		if (got == 0) {
+			buffer[length] = '\0';
+			break;
+		}
+		length += (size_t)got;
+		if (length == size - 1) {
+			size *= 2;
+			char *bigger = realloc(buffer, size);
+			if (bigger == NULL) {
+				free(buffer);
+			}
+			buffer = bigger;
+		}
+	}
+
+	close(file);
+	return buffer;
+}
+
+bool memory_parse_cgroup_limit(const char *text, bool limited[static 1],
+							   unsigned long long limit[static 1]) {
+	if (text == NULL) {
+		return false;
+	}
+	if (strncmp(text, "max", 3) == 0) {
+		*limited = false;
+		return true;
+	}
+
+	char *end = NULL;
+	unsigned long long value = strtoull(text, &end, 10);
+	if (end == text) {
+		return false;
+	}
+	*limited = true;
+	*limit = value;
+	return true;
+}
+
+/* a missing file leaves all of its fields not present */
+static void memory_read_cgroup_fields(const char *cgroup_path, const char *name,
+									  const memory_field fields[], size_t fields_count,
+									  memory_value values[]) {
+	char *path = NULL;
+	xasprintf(&path, "%s/%s", cgroup_path, name);
+	char *text = memory_read_file(path);
+	free(path);
+
+	memory_parse_fields(text, fields, fields_count, values);
+	free(text);
+}
+
+memory_cgroup memory_read_cgroup(const char *cgroup_path) {
+	memory_cgroup result = {
+		.available = false,
+		.stat = calloc(memory_cgroup_stat_fields_count, sizeof(memory_value)),
+		.events = calloc(memory_cgroup_events_fields_count, sizeof(memory_value)),
+	};
+	if (result.stat == NULL || result.events == NULL) {
+		die(STATE_UNKNOWN, _("Could not calloc() cgroup fields\n"));
+	}
+
+	char *path = NULL;
+	xasprintf(&path, "%s/memory.current", cgroup_path);
+	char *text = memory_read_file(path);
+	free(path);
+	if (text == NULL) {
+		return result;
+	}
+	char *end = NULL;
+	result.current = strtoull(text, &end, 10);
+	bool current_parsed = end != text;
+	free(text);
+	if (!current_parsed) {
+		return result;
+	}
+
+	/* the root cgroup has no memory.max */
+	xasprintf(&path, "%s/memory.max", cgroup_path);
+	text = memory_read_file(path);
+	free(path);
+	if (!memory_parse_cgroup_limit(text, &result.limited, &result.max)) {
+		result.limited = false;
+	}
+	free(text);
+
+	memory_read_cgroup_fields(cgroup_path, "memory.stat", memory_cgroup_stat_fields,
+							  memory_cgroup_stat_fields_count, result.stat);
+	memory_read_cgroup_fields(cgroup_path, "memory.events", memory_cgroup_events_fields,
+							  memory_cgroup_events_fields_count, result.events);
+
+	result.available = true;
+	return result;
+}
+
+void memory_free_cgroup(memory_cgroup cgroup[static 1]) {
+	free(cgroup->stat);
+	free(cgroup->events);
+	cgroup->stat = NULL;
+	cgroup->events = NULL;
+}
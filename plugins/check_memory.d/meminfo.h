@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MEMORY_CGROUP_ROOT "/sys/fs/cgroup"
+
+typedef enum {
+	MEMORY_UNIT_BYTES, /* sizes, /proc/meminfo gives them in kB */
+	MEMORY_UNIT_COUNT, /* page and event counters */
+} memory_unit;
+
+typedef struct {
+	const char *key;
+	memory_unit unit;
+} memory_field;
+
+typedef struct {
+	bool present;
+	unsigned long long value; /* Bytes for sizes */
+} memory_value;
+
+/* the fields of /proc/meminfo which are reported, in the order the kernel prints them */
+extern const memory_field memory_meminfo_fields[];
+extern const size_t memory_meminfo_fields_count;
+
+/* the fields of memory.stat and memory.events of a cgroup v2 */
+extern const memory_field memory_cgroup_stat_fields[];
+extern const size_t memory_cgroup_stat_fields_count;
+extern const memory_field memory_cgroup_events_fields[];
+extern const size_t memory_cgroup_events_fields_count;
+
+/*
+ * Parses "key value" or "Key:   value kB" lines in one pass, every key found in
+ * fields stores its value at the same index in values.
+ * Returns the number of fields found.
+ */
+size_t memory_parse_fields(const char *text, const memory_field fields[], size_t fields_count,
+						   memory_value values[]);
+
+/* index of key in fields or -1 */
+long memory_find_field(const memory_field fields[], size_t fields_count, const char *key);
+
+/* reads a whole (small) file, NULL if it could not be read */
+char *memory_read_file(const char *path);
+
+typedef struct {
+	bool available;
+	unsigned long long current; /* memory.current */
+	bool limited;
+	unsigned long long max; /* memory.max, only if limited */
+	memory_value *stat;     /* memory_cgroup_stat_fields_count values */
+	memory_value *events;   /* memory_cgroup_events_fields_count values */
+} memory_cgroup;
+
+/* "max" means there is no limit */
+bool memory_parse_cgroup_limit(const char *text, bool limited[static 1],
+							   unsigned long long limit[static 1]);
+
+memory_cgroup memory_read_cgroup(const char *cgroup_path);
+void memory_free_cgroup(memory_cgroup cgroup[static 1]);
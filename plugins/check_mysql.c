@@ -39,6 +39,7 @@
 #include "utils_base.h"
 #include "netutils.h"
 #include "check_mysql.d/config.h"
+#include "check_mysql.d/rates.h"
 
 #include <mysql.h>
 #include <mysqld_error.h>
@@ -67,6 +68,38 @@ static const char *metric_counter[LENGTH_METRIC_COUNTER] = {"Connections",
 															"Questions",
 															"Table_locks_waited",
 															"Uptime"};
+#define METRIC_UPTIME "Uptime"
+
+/*
+ * The numeric status variables which go up and down. All others are counters,
+ * which only grow until a restart or FLUSH STATUS, and have rates.
+ */
+#define LENGTH_METRIC_GAUGE 25
+static const char *metric_gauge[LENGTH_METRIC_GAUGE] = {"Open_*",
+														"Threads_cached",
+														"Threads_connected",
+														"Threads_running",
+														"Qcache_free_*",
+														"Qcache_queries_in_cache",
+														"Qcache_total_blocks",
+														"Innodb_buffer_pool_bytes_*",
+														"Innodb_buffer_pool_pages_data",
+														"Innodb_buffer_pool_pages_dirty",
+														"Innodb_buffer_pool_pages_free",
+														"Innodb_buffer_pool_pages_misc",
+														"Innodb_buffer_pool_pages_total",
+														"Innodb_num_open_files",
+														"Innodb_page_size",
+														"Innodb_row_lock_current_waits",
+														"Innodb_row_lock_time_avg",
+														"Innodb_row_lock_time_max",
+														"Key_blocks_*",
+														"Max_used_connections",
+														"Memory_used*",
+														"Not_flushed_delayed_rows",
+														"Prepared_stmt_count",
+														"*_open_temp_tables",
+														"Uptime_since_flush_status"};
 
 #define MYSQLDUMP_THREADS_QUERY                                                                    \
 	"SELECT COUNT(1) mysqldumpThreads FROM information_schema.processlist WHERE info LIKE "        \
@@ -78,6 +111,10 @@ typedef struct {
 } check_mysql_config_wrapper;
 static check_mysql_config_wrapper process_arguments(int /*argc*/, char ** /*argv*/);
 static check_mysql_config_wrapper validate_arguments(check_mysql_config_wrapper /*config_wrapper*/);
+static bool metric_is_gauge(const char * /*name*/);
+static mp_subcheck evaluate_rates(check_mysql_config /*config*/,
+								  const mysql_counter_list * /*counters*/, int /*argc*/,
+								  char ** /*argv*/);
 static void print_help(void);
 void print_usage(void);
 
@@ -193,14 +230,36 @@ int main(int argc, char **argv) {
 	} else {
 		xasprintf(&sc_stats.output, "retrieved stats: %s", mysql_stats);
 		sc_stats = mp_set_subcheck_state(sc_stats, STATE_OK);
-		mp_add_subcheck_to_check(&overall, sc_stats);
+	}
+
+	/* every integer variable which is no gauge is a counter, they are kept by name */
+	mysql_counter_list counters = mysql_counter_list_init();
+
+	/* the rates need the uptime and their counters even if those are not reported */
+	mysql_metric_set fetched = mysql_metric_set_init();
+	for (size_t i = 0; i < config.metrics.count; i++) {
+		mysql_metric_set_add(&fetched, config.metrics.names[i]);
+	}
+	for (size_t i = 0; i < config.metrics.globs_count; i++) {
+		mysql_metric_set_add(&fetched, config.metrics.globs[i]);
+	}
+	if (config.rates) {
+		mysql_metric_set_add(&fetched, METRIC_UPTIME);
+		for (size_t i = 0; i < config.rate_thresholds_num; i++) {
+			mysql_metric_set_add(&fetched, config.rate_thresholds[i].counter);
+		}
+	}
+
+	char *status_query = mysql_metric_set_query(&fetched);
+	if (verbose >= 2) {
+		printf("%s\n", status_query);
 	}
 
 	MYSQL_RES *res;
 	MYSQL_ROW row;
 	mp_subcheck sc_query = mp_subcheck_init();
-	/* try to fetch some perf data */
-	if (mysql_query(&mysql, "show global status") == 0) {
+	/* try to fetch some perf data, only the variables asked for are transferred */
+	if (mysql_query(&mysql, status_query) == 0) {
 		if ((res = mysql_store_result(&mysql)) == NULL) {
 			xasprintf(&sc_connection.output, "query failed - status store_result error: %s",
 					  mysql_error(&mysql));
@@ -212,27 +271,46 @@ int main(int argc, char **argv) {
 		}
 
 		while ((row = mysql_fetch_row(res)) != NULL) {
-			for (int i = 0; i < LENGTH_METRIC_UNIT; i++) {
-				if (strcmp(row[0], metric_unit[i]) == 0) {
-					mp_perfdata pd_mysql_stat = perfdata_init();
-					pd_mysql_stat.label = (char *)metric_unit[i];
-					pd_mysql_stat.value = mp_create_pd_value(atol(row[1]));
-					mp_add_perfdata_to_subcheck(&sc_stats, pd_mysql_stat);
-					continue;
+			if (row[1] == NULL) {
+				continue;
+			}
+
+			char *end;
+			bool counter = false;
+			if (!metric_is_gauge(row[0])) {
+				unsigned long long value = strtoull(row[1], &end, 10);
+				counter = end != row[1] && *end == '\0' && row[1][0] != '-';
+				if (counter) {
+					mysql_counters_set(&counters, row[0], value);
 				}
 			}
 
-			for (int i = 0; i < LENGTH_METRIC_COUNTER; i++) {
-				if (strcmp(row[0], metric_counter[i]) == 0) {
-					mp_perfdata pd_mysql_stat = perfdata_init();
-					pd_mysql_stat.label = (char *)metric_counter[i];
-					pd_mysql_stat.value = mp_create_pd_value(atol(row[1]));
-					pd_mysql_stat.uom = "c";
-					mp_add_perfdata_to_subcheck(&sc_stats, pd_mysql_stat);
+			if (!mysql_metric_set_matches(&config.metrics, row[0])) {
+				continue;
+			}
+
+			/* globs also match variables like ON/OFF switches, those are no performance data */
+			mp_perfdata pd_mysql_stat = perfdata_init();
+			long long integer = strtoll(row[1], &end, 10);
+			if (end != row[1] && *end == '\0') {
+				pd_mysql_stat.value = mp_create_pd_value(integer);
+			} else {
+				double real = strtod(row[1], &end);
+				if (end == row[1] || *end != '\0') {
+					if (verbose) {
+						printf("Skipping %s, %s is not a number\n", row[0], row[1]);
+					}
 					continue;
 				}
+				pd_mysql_stat.value = mp_create_pd_value(real);
 			}
+			pd_mysql_stat.label = strdup(row[0]);
+			if (counter) {
+				pd_mysql_stat.uom = "c";
+			}
+			mp_add_perfdata_to_subcheck(&sc_stats, pd_mysql_stat);
 		}
+		mysql_free_result(res);
 	} else {
 		// Query failed!
 		xasprintf(&sc_connection.output, "query failed");
@@ -240,6 +318,16 @@ int main(int argc, char **argv) {
 		mp_add_subcheck_to_check(&overall, sc_query);
 		mp_exit(overall);
 	}
+	free(status_query);
+	mysql_metric_set_free(&fetched);
+
+	/* added after the rows, the subcheck is copied with its performance data */
+	mp_add_subcheck_to_check(&overall, sc_stats);
+
+	if (config.rates) {
+		mp_add_subcheck_to_check(&overall, evaluate_rates(config, &counters, argc, argv));
+	}
+	mysql_counter_list_free(&counters);
 
 	if (config.check_replica) {
 		// Detect which version we are, on older version
@@ -458,12 +546,173 @@ int main(int argc, char **argv) {
 	mp_exit(overall);
 }
 
+static bool metric_is_gauge(const char *name) {
+	static mysql_metric_set gauges;
+	static bool gauges_set = false;
+	if (!gauges_set) {
+		gauges = mysql_metric_set_init();
+		for (int i = 0; i < LENGTH_METRIC_GAUGE; i++) {
+			mysql_metric_set_add(&gauges, metric_gauge[i]);
+		}
+		gauges_set = true;
+	}
+	return mysql_metric_set_matches(&gauges, name);
+}
+
+/* adds the subcheck of one rate, a missing rate only matters if there are thresholds */
+static void add_rate(mp_subcheck *result, check_mysql_config config, const char *counter,
+					 double rate) {
+	mp_thresholds thresholds = mp_thresholds_init();
+	bool has_thresholds = false;
+	for (size_t i = 0; i < config.rate_thresholds_num; i++) {
+		if (strcasecmp(config.rate_thresholds[i].counter, counter) == 0) {
+			thresholds = config.rate_thresholds[i].thresholds;
+			has_thresholds = true;
+		}
+	}
+
+	mp_subcheck sc_rate = mp_subcheck_init();
+	if (isnan(rate)) {
+		/* missing on this server or reset by FLUSH STATUS */
+		if (has_thresholds) {
+			sc_rate = mp_set_subcheck_state(sc_rate, STATE_UNKNOWN);
+			xasprintf(&sc_rate.output, _("%s: no rate available"), counter);
+			mp_add_subcheck_to_subcheck(result, sc_rate);
+		}
+		return;
+	}
+
+	mp_perfdata pd_rate = perfdata_init();
+	xasprintf(&pd_rate.label, "%s_rate", counter);
+	pd_rate = mp_set_pd_value(pd_rate, rate);
+	pd_rate = mp_set_pd_min_value(pd_rate, mp_create_pd_value(0));
+	pd_rate = mp_pd_set_thresholds(pd_rate, thresholds);
+
+	sc_rate = mp_set_subcheck_state(sc_rate, mp_get_pd_status(pd_rate));
+	xasprintf(&sc_rate.output, "%s: %.2f/s", counter, rate);
+	mp_add_perfdata_to_subcheck(&sc_rate, pd_rate);
+	mp_add_subcheck_to_subcheck(result, sc_rate);
+}
+
+/*
+ * The rates are computed against the counters of the previous run with the
+ * same arguments, the first run only stores its sample
+ */
+static mp_subcheck evaluate_rates(check_mysql_config config, const mysql_counter_list *counters,
+								  int argc, char **argv) {
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+
+	time_t now = time(NULL);
+	state_key key = np_enable_state(NULL, MYSQL_RATE_STATE_VERSION, progname, argc, argv);
+	state_data *previous_state = np_state_read(key);
+
+	double *rates = calloc(counters->count + 1, sizeof(double));
+	if (rates == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the counters\n"));
+	}
+	mysql_rates_result rates_result = {
+		.errorcode = ERROR,
+	};
+	/* there is no state data on the first run */
+	mysql_counter_list previous = mysql_counter_list_init();
+	if (previous_state != NULL && previous_state->errorcode == OK &&
+		mysql_counters_parse(previous_state->data, &previous)) {
+		rates_result = mysql_counters_rates(&previous, counters, METRIC_UPTIME,
+											(double)(now - previous_state->time), rates);
+	}
+	mysql_counter_list_free(&previous);
+
+	char *state_string = mysql_counters_format(counters);
+	np_state_write_string(key, now, state_string);
+	free(state_string);
+
+	if (rates_result.errorcode != OK) {
+		free(rates);
+		xasprintf(&result.output, _("No previous sample of the counters, rates are available "
+									"from the next run on"));
+		return result;
+	}
+
+	for (size_t i = 0; i < counters->count; i++) {
+		if (strcasecmp(counters->counters[i].name, METRIC_UPTIME) != 0) {
+			add_rate(&result, config, counters->counters[i].name, rates[i]);
+		}
+	}
+	/* counters with thresholds which the server did not report */
+	for (size_t i = 0; i < config.rate_thresholds_num; i++) {
+		if (mysql_counters_get(counters, config.rate_thresholds[i].counter) == NULL) {
+			add_rate(&result, config, config.rate_thresholds[i].counter, NAN);
+		}
+	}
+	free(rates);
+
+	if (rates_result.restarted) {
+		xasprintf(&result.output, _("Rates since the server restart %.0f seconds ago"),
+				  rates_result.elapsed);
+	} else {
+		xasprintf(&result.output, _("Rates over %.0f seconds"), rates_result.elapsed);
+	}
+	return result;
+}
+
+/* "COUNTER,WARN,CRIT", either threshold may be empty */
+static void add_rate_threshold(check_mysql_config *config, char *arg) {
+	char *counter = arg;
+	char *warning = strchr(counter, ',');
+	char *critical = NULL;
+	if (warning != NULL) {
+		*warning++ = '\0';
+		critical = strchr(warning, ',');
+		if (critical != NULL) {
+			*critical++ = '\0';
+		}
+	}
+
+	/* any counter has a rate, but gauges and the uptime itself have none */
+	if (!mysql_metric_valid_pattern(counter) || strpbrk(counter, "*?") != NULL ||
+		strcasecmp(counter, METRIC_UPTIME) == 0 || metric_is_gauge(counter)) {
+		die(STATE_UNKNOWN, _("There is no rate for the counter %s\n"), counter);
+	}
+
+	check_mysql_rate_threshold entry = {
+		.counter = counter,
+		.thresholds = mp_thresholds_init(),
+	};
+	if (warning != NULL && *warning != '\0') {
+		mp_range_parsed tmp = mp_parse_range_string(warning);
+		if (tmp.error != MP_PARSING_SUCCESS) {
+			die(STATE_UNKNOWN, _("failed to parse rate warning threshold: %s\n"), warning);
+		}
+		entry.thresholds = mp_thresholds_set_warn(entry.thresholds, tmp.range);
+	}
+	if (critical != NULL && *critical != '\0') {
+		mp_range_parsed tmp = mp_parse_range_string(critical);
+		if (tmp.error != MP_PARSING_SUCCESS) {
+			die(STATE_UNKNOWN, _("failed to parse rate critical threshold: %s\n"), critical);
+		}
+		entry.thresholds = mp_thresholds_set_crit(entry.thresholds, tmp.range);
+	}
+
+	check_mysql_rate_threshold *entries =
+		realloc(config->rate_thresholds,
+				(config->rate_thresholds_num + 1) * sizeof(check_mysql_rate_threshold));
+	if (entries == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the rate thresholds\n"));
+	}
+	entries[config->rate_thresholds_num++] = entry;
+	config->rate_thresholds = entries;
+}
+
 /* process command-line arguments */
 check_mysql_config_wrapper process_arguments(int argc, char **argv) {
 
 	enum {
 		CHECK_REPLICA_OPT = CHAR_MAX + 1,
 		output_format_index,
+		RATES_OPT,
+		RATE_THRESHOLD_OPT,
+		METRICS_OPT,
 	};
 
 	static struct option longopts[] = {{"hostname", required_argument, 0, 'H'},
@@ -489,6 +738,9 @@ check_mysql_config_wrapper process_arguments(int argc, char **argv) {
 									   {"ca-dir", required_argument, 0, 'D'},
 									   {"ciphers", required_argument, 0, 'L'},
 									   {"output-format", required_argument, 0, output_format_index},
+									   {"rates", no_argument, 0, RATES_OPT},
+									   {"rate-threshold", required_argument, 0, RATE_THRESHOLD_OPT},
+									   {"metrics", required_argument, 0, METRICS_OPT},
 									   {0, 0, 0, 0}};
 
 	check_mysql_config_wrapper result = {
@@ -588,6 +840,16 @@ check_mysql_config_wrapper process_arguments(int argc, char **argv) {
 			result.config.replica_thresholds =
 				mp_thresholds_set_crit(result.config.replica_thresholds, tmp.range);
 		} break;
+		case RATES_OPT:
+			result.config.rates = true;
+			break;
+		case METRICS_OPT:
+			mysql_metric_set_add_list(&result.config.metrics, optarg);
+			break;
+		case RATE_THRESHOLD_OPT:
+			add_rate_threshold(&result.config, optarg);
+			result.config.rates = true;
+			break;
 		case 'V': /* version */
 			print_revision(progname, NP_VERSION);
 			exit(STATE_UNKNOWN);
@@ -651,6 +913,16 @@ check_mysql_config_wrapper validate_arguments(check_mysql_config_wrapper config_
 		config_wrapper.config.db = strdup("");
 	}
 
+	mysql_metric_set *metrics = &config_wrapper.config.metrics;
+	if (metrics->count == 0 && metrics->globs_count == 0) {
+		for (int i = 0; i < LENGTH_METRIC_UNIT; i++) {
+			mysql_metric_set_add(metrics, metric_unit[i]);
+		}
+		for (int i = 0; i < LENGTH_METRIC_COUNTER; i++) {
+			mysql_metric_set_add(metrics, metric_counter[i]);
+		}
+	}
+
 	return config_wrapper;
 }
 
@@ -703,6 +975,19 @@ void print_help(void) {
 	printf("    %s\n",
 		   _("Exit with CRITICAL status if replica server is more then INTEGER seconds"));
 	printf("    %s\n", _("behind master"));
+	printf(" %s\n", "--metrics=LIST");
+	printf("    %s\n", _("Comma separated status variables to report, * matches any characters"));
+	printf("    %s\n", _("and ? one, e.g. Innodb_buffer_pool_*,Threads_*. Only these are"));
+	printf("    %s\n", _("fetched from the server. The default is a few common variables"));
+	printf(" %s\n", "--rates");
+	printf("    %s\n", _("Report the per second rates of the counters among the variables,"));
+	printf("    %s\n", _("computed against the counters of the previous run with the same"));
+	printf("    %s\n", _("arguments. Gauges like Threads_connected have no rate. After a server"));
+	printf("    %s\n", _("restart, detected through Uptime, they are the averages since then"));
+	printf(" %s\n", "--rate-threshold=COUNTER,WARN,CRIT");
+	printf("    %s\n", _("Thresholds on the rate of any counter, e.g. Slow_queries,1,10. The"));
+	printf("    %s\n", _("counter is fetched even if --metrics does not list it. Implies --rates"));
+	printf("    %s\n", _("and can be given once per counter"));
 	printf(" %s\n", "-l, --ssl");
 	printf("    %s\n", _("Use ssl encryption"));
 	printf(" %s\n", "-C, --ca-cert=STRING");
@@ -737,4 +1022,5 @@ void print_usage(void) {
 	printf(" %s [-d database] [-H host] [-P port] [-s socket]\n", progname);
 	printf("       [-u user] [-p password] [-S] [-l] [-a cert] [-k key]\n");
 	printf("       [-C ca-cert] [-D ca-dir] [-L ciphers] [-f optfile] [-g group]\n");
+	printf("       [--metrics=LIST] [--rates] [--rate-threshold=COUNTER,WARN,CRIT]\n");
 }
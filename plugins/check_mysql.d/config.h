@@ -3,9 +3,16 @@
 #include "../../config.h"
 #include "output.h"
 #include "thresholds.h"
+#include "metrics.h"
 #include <stddef.h>
 #include <mysql.h>
 
+/* thresholds on the per second rate of one SHOW GLOBAL STATUS counter */
+typedef struct {
+	const char *counter;
+	mp_thresholds thresholds;
+} check_mysql_rate_threshold;
+
 typedef struct {
 	char *db_host;
 	unsigned int db_port;
@@ -27,6 +34,14 @@ typedef struct {
 
 	mp_thresholds replica_thresholds;
 
+	/* the status variables reported as performance data */
+	mysql_metric_set metrics;
+
+	/* per second rates of the counters, against the sample of the previous run */
+	bool rates;
+	check_mysql_rate_threshold *rate_thresholds;
+	size_t rate_thresholds_num;
+
 	bool output_format_is_set;
 	mp_output_format output_format;
 } check_mysql_config;
@@ -53,6 +68,12 @@ check_mysql_config check_mysql_config_init() {
 
 		.replica_thresholds = mp_thresholds_init(),
 
+		.metrics = mysql_metric_set_init(),
+
+		.rates = false,
+		.rate_thresholds = NULL,
+		.rate_thresholds_num = 0,
+
 		.output_format_is_set = false,
 	};
 	return tmp;
@@ -0,0 +1,198 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./metrics.h"
+
+#include <ctype.h>
+#include <string.h>
+
+mysql_metric_set mysql_metric_set_init(void) {
+	mysql_metric_set result = {
+		.count = 0,
+		.index = mp_hashtable_init(true),
+	};
+	return result;
+}
+
+void mysql_metric_set_free(mysql_metric_set *set) {
+	for (size_t i = 0; i < set->count; i++) {
+		free(set->names[i]);
+	}
+	for (size_t i = 0; i < set->globs_count; i++) {
+		free(set->globs[i]);
+	}
+	free(set->names);
+	free(set->globs);
+	mp_hashtable_free(&set->index);
+	*set = mysql_metric_set_init();
+}
+
+bool mysql_metric_valid_pattern(const char *pattern) {
+	if (pattern[0] == '\0') {
+		return false;
+	}
+	for (const char *character = pattern; *character != '\0'; character++) {
+		if (!isalnum((unsigned char)*character) && *character != '_' && *character != '*' &&
+			*character != '?') {
+			return false;
+		}
+	}
+	return true;
+}
+
+void mysql_metric_set_add(mysql_metric_set *set, const char *pattern) {
+	if (strpbrk(pattern, "*?") != NULL) {
+		for (size_t i = 0; i < set->globs_count; i++) {
+			if (strcasecmp(set->globs[i], pattern) == 0) {
+				return;
+			}
+		}
+		char **globs = realloc(set->globs, (set->globs_count + 1) * sizeof(char *));
+		if (globs == NULL) {
+			die(STATE_UNKNOWN, _("Could not allocate memory for the metrics\n"));
+		}
+		globs[set->globs_count++] = strdup(pattern);
+		set->globs = globs;
+		return;
+	}
+
+	if (mp_hashtable_add(&set->index, pattern, set->count) != set->count) {
+		return;
+	}
+	if (set->count == set->capacity) {
+		size_t capacity = set->capacity == 0 ? 16 : set->capacity * 2;
+		char **names = realloc(set->names, capacity * sizeof(char *));
+		if (names == NULL) {
+			die(STATE_UNKNOWN, _("Could not allocate memory for the metrics\n"));
+		}
+		set->names = names;
+		set->capacity = capacity;
+	}
+	set->names[set->count++] = strdup(pattern);
+}
+
+void mysql_metric_set_add_list(mysql_metric_set *set, const char *list) {
+	char *copy = strdup(list);
+	char *saveptr = NULL;
+	for (char *pattern = strtok_r(copy, ",", &saveptr); pattern != NULL;
+		 pattern = strtok_r(NULL, ",", &saveptr)) {
+		if (!mysql_metric_valid_pattern(pattern)) {
+			die(STATE_UNKNOWN, _("Invalid status variable name: %s\n"), pattern);
+		}
+		mysql_metric_set_add(set, pattern);
+	}
+	free(copy);
+}
+
+ssize_t mysql_metric_set_index(const mysql_metric_set *set, const char *name) {
+	size_t index;
+	if (!mp_hashtable_get(&set->index, name, &index)) {
+		return -1;
+	}
+	return (ssize_t)index;
+}
+
+/* * and ? like the % and _ of LIKE, without case */
+static bool mysql_metric_glob_match(const char *glob, const char *name) {
+	const char *star = NULL;
+	const char *resume = NULL;
+	while (*name != '\0') {
+		if (*glob == '*') {
+			star = glob++;
+			resume = name;
+		} else if (*glob == '?' ||
+				   tolower((unsigned char)*glob) == tolower((unsigned char)*name)) {
+			glob++;
+			name++;
+		} else if (star != NULL) {
+			/* let the last star take one more character */
+			glob = star + 1;
+			name = ++resume;
+		} else {
+			return false;
+		}
+	}
+	while (*glob == '*') {
+		glob++;
+	}
+	return *glob == '\0';
+}
+
+bool mysql_metric_set_matches(const mysql_metric_set *set, const char *name) {
+	if (mysql_metric_set_index(set, name) >= 0) {
+		return true;
+	}
+	for (size_t i = 0; i < set->globs_count; i++) {
+		if (mysql_metric_glob_match(set->globs[i], name)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* appends the glob as LIKE pattern, the _ of the names are escaped */
+static char *mysql_metric_append_like(char *position, const char *glob) {
+	for (const char *character = glob; *character != '\0'; character++) {
+		if (*character == '*') {
+			*position++ = '%';
+		} else if (*character == '?') {
+			*position++ = '_';
+		} else {
+			if (*character == '_') {
+				*position++ = '\\';
+			}
+			*position++ = *character;
+		}
+	}
+	return position;
+}
+
+#define MYSQL_METRIC_QUERY "SHOW GLOBAL STATUS WHERE "
+#define MYSQL_METRIC_IN "Variable_name IN ("
+#define MYSQL_METRIC_LIKE "Variable_name LIKE '"
+#define MYSQL_METRIC_OR " OR "
+
+char *mysql_metric_set_query(const mysql_metric_set *set) {
+	/* the quotes and commas of the names, the globs may double in length */
+	size_t size = sizeof(MYSQL_METRIC_QUERY) + sizeof(MYSQL_METRIC_IN) + sizeof("FALSE");
+	for (size_t i = 0; i < set->count; i++) {
+		size += strlen(set->names[i]) + 3;
+	}
+	for (size_t i = 0; i < set->globs_count; i++) {
+		size += sizeof(MYSQL_METRIC_OR) + sizeof(MYSQL_METRIC_LIKE) + 2 * strlen(set->globs[i]) + 1;
+	}
+
+	char *result = malloc(size);
+	if (result == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the metrics\n"));
+	}
+
+	/* the patterns were validated, they need no quoting */
+	char *position = stpcpy(result, MYSQL_METRIC_QUERY);
+	if (set->count > 0) {
+		position = stpcpy(position, MYSQL_METRIC_IN);
+		for (size_t i = 0; i < set->count; i++) {
+			if (i > 0) {
+				*position++ = ',';
+			}
+			*position++ = '\'';
+			position = stpcpy(position, set->names[i]);
+			*position++ = '\'';
+		}
+		*position++ = ')';
+	}
+
+	for (size_t i = 0; i < set->globs_count; i++) {
+		if (set->count > 0 || i > 0) {
+			position = stpcpy(position, MYSQL_METRIC_OR);
+		}
+		position = stpcpy(position, MYSQL_METRIC_LIKE);
+		position = mysql_metric_append_like(position, set->globs[i]);
+		*position++ = '\'';
+	}
+
+	if (set->count == 0 && set->globs_count == 0) {
+		position = stpcpy(position, "FALSE");
+	}
+	*position = '\0';
+	return result;
+}
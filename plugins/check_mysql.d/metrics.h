@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../../config.h"
+#include "../../lib/hashtable.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * A set of status variable names and globs, * for any run of characters and
+ * ? for one. The names are looked up through a hash table, case insensitive
+ * like the Variable_name column of SHOW GLOBAL STATUS.
+ */
+typedef struct {
+	char **names;
+	size_t count;
+	size_t capacity;
+
+	char **globs;
+	size_t globs_count;
+
+	mp_hashtable index; /* the names, without case */
+} mysql_metric_set;
+
+mysql_metric_set mysql_metric_set_init(void);
+void mysql_metric_set_free(mysql_metric_set *set);
+
+/* whether the pattern only has the characters of variable names and the glob characters */
+bool mysql_metric_valid_pattern(const char *pattern);
+
+/* adds a name or a glob, duplicates are ignored */
+void mysql_metric_set_add(mysql_metric_set *set, const char *pattern);
+
+/* adds the patterns of a comma separated list */
+void mysql_metric_set_add_list(mysql_metric_set *set, const char *list);
+
+/* the index of an exact name in names, -1 if it is not in the set */
+ssize_t mysql_metric_set_index(const mysql_metric_set *set, const char *name);
+
+/* whether the name is in the set or matches one of its globs */
+bool mysql_metric_set_matches(const mysql_metric_set *set, const char *name);
+
+/*
+ * SHOW GLOBAL STATUS restricted to the variables of the set, the names go
+ * into an IN list and the globs become LIKE patterns.
+ */
+char *mysql_metric_set_query(const mysql_metric_set *set);
@@ -0,0 +1,130 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./rates.h"
+
+#include <math.h>
+#include <string.h>
+
+mysql_counter_list mysql_counter_list_init(void) {
+	mysql_counter_list result = {
+		.counters = NULL,
+		.count = 0,
+		.capacity = 0,
+		.index = mp_hashtable_init(true),
+	};
+	return result;
+}
+
+void mysql_counter_list_free(mysql_counter_list *list) {
+	for (size_t i = 0; i < list->count; i++) {
+		free(list->counters[i].name);
+	}
+	free(list->counters);
+	mp_hashtable_free(&list->index);
+	*list = mysql_counter_list_init();
+}
+
+void mysql_counters_set(mysql_counter_list *list, const char *name, unsigned long long value) {
+	size_t index = mp_hashtable_add(&list->index, name, list->count);
+	if (index < list->count) {
+		list->counters[index].value = value;
+		return;
+	}
+
+	if (list->count == list->capacity) {
+		size_t capacity = list->capacity == 0 ? 16 : list->capacity * 2;
+		mysql_counter *counters = realloc(list->counters, capacity * sizeof(mysql_counter));
+		if (counters == NULL) {
+			die(STATE_UNKNOWN, _("Could not allocate memory for the counters\n"));
+		}
+		list->counters = counters;
+		list->capacity = capacity;
+	}
+	list->counters[list->count++] = (mysql_counter){.name = strdup(name), .value = value};
+}
+
+const mysql_counter *mysql_counters_get(const mysql_counter_list *list, const char *name) {
+	size_t index;
+	if (!mp_hashtable_get(&list->index, name, &index)) {
+		return NULL;
+	}
+	return &list->counters[index];
+}
+
+char *mysql_counters_format(const mysql_counter_list *list) {
+	char *result = strdup("");
+	for (size_t i = 0; i < list->count; i++) {
+		char *previous = result;
+		xasprintf(&result, "%s%s%s=%llu", previous, previous[0] == '\0' ? "" : " ",
+				  list->counters[i].name, list->counters[i].value);
+		free(previous);
+	}
+	return result;
+}
+
+bool mysql_counters_parse(const char *data, mysql_counter_list *list) {
+	char *copy = strdup(data);
+	char *saveptr = NULL;
+	bool result = true;
+	for (char *token = strtok_r(copy, " \n", &saveptr); token != NULL;
+		 token = strtok_r(NULL, " \n", &saveptr)) {
+		char *separator = strchr(token, '=');
+		if (separator == NULL || separator == token) {
+			result = false;
+			break;
+		}
+		*separator = '\0';
+
+		char *end;
+		unsigned long long value = strtoull(separator + 1, &end, 10);
+		if (end == separator + 1 || *end != '\0') {
+			result = false;
+			break;
+		}
+		mysql_counters_set(list, token, value);
+	}
+	free(copy);
+	return result;
+}
+
+mysql_rates_result mysql_counters_rates(const mysql_counter_list *previous,
+										const mysql_counter_list *current, const char *uptime,
+										double elapsed, double *rates) {
+	mysql_rates_result result = {
+		.errorcode = ERROR,
+		.elapsed = elapsed,
+	};
+	for (size_t i = 0; i < current->count; i++) {
+		rates[i] = NAN;
+	}
+
+	const mysql_counter *current_uptime = mysql_counters_get(current, uptime);
+	const mysql_counter *previous_uptime = mysql_counters_get(previous, uptime);
+	if (current_uptime != NULL && previous_uptime != NULL) {
+		double expected = (double)previous_uptime->value + elapsed;
+		if ((double)current_uptime->value + MYSQL_RATE_UPTIME_SLACK < expected) {
+			/* the counters started from zero when the server came back up */
+			result.restarted = true;
+			result.elapsed = (double)current_uptime->value;
+		}
+	}
+
+	if (result.elapsed <= 0) {
+		return result;
+	}
+
+	result.errorcode = OK;
+	for (size_t i = 0; i < current->count; i++) {
+		const mysql_counter *counter = &current->counters[i];
+		if (counter == current_uptime) {
+			continue;
+		}
+		const mysql_counter *before = mysql_counters_get(previous, counter->name);
+		if (result.restarted) {
+			rates[i] = (double)counter->value / result.elapsed;
+		} else if (before != NULL && counter->value >= before->value) {
+			rates[i] = (double)(counter->value - before->value) / result.elapsed;
+		}
+	}
+	return result;
+}
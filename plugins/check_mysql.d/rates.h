@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../../config.h"
+#include "../../lib/hashtable.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MYSQL_RATE_STATE_VERSION 1
+
+/* how far Uptime may fall behind the time between two samples before it counts as a restart */
+#define MYSQL_RATE_UPTIME_SLACK 5
+
+/* one of the monotonically increasing values of SHOW GLOBAL STATUS */
+typedef struct {
+	char *name;
+	unsigned long long value;
+} mysql_counter;
+
+/* the counters reported by the server, looked up by name without case */
+typedef struct {
+	mysql_counter *counters;
+	size_t count;
+	size_t capacity;
+	mp_hashtable index;
+} mysql_counter_list;
+
+typedef struct {
+	int errorcode;  /* OK, or ERROR if there is nothing to compute the rates against */
+	bool restarted; /* the server was restarted, the rates are averages since then */
+	double elapsed; /* seconds the rates are computed over */
+} mysql_rates_result;
+
+mysql_counter_list mysql_counter_list_init(void);
+void mysql_counter_list_free(mysql_counter_list *list);
+
+/* sets the value of the counter, it is added if the list does not have it */
+void mysql_counters_set(mysql_counter_list *list, const char *name, unsigned long long value);
+
+/* NULL if the list does not have the counter */
+const mysql_counter *mysql_counters_get(const mysql_counter_list *list, const char *name);
+
+/* "Name=value Name=value" of the counters, for the state file */
+char *mysql_counters_format(const mysql_counter_list *list);
+
+/*
+ * Adds the counters of a string written by mysql_counters_format to the
+ * list. Returns false if the string is malformed.
+ */
+bool mysql_counters_parse(const char *data, mysql_counter_list *list);
+
+/*
+ * Computes the per second rates of the current counters. A server restart
+ * is recognised by the uptime counter growing slower than the elapsed time,
+ * the rates are then the averages since the restart. rates[i] belongs to
+ * current->counters[i] and is NAN where there is no rate, for the uptime
+ * itself, for counters new since the previous sample and for counters reset
+ * by FLUSH STATUS.
+ */
+mysql_rates_result mysql_counters_rates(const mysql_counter_list *previous,
+										const mysql_counter_list *current, const char *uptime,
+										double elapsed, double *rates);
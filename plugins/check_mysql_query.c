@@ -37,6 +37,7 @@
 #include "utils.h"
 #include "utils_base.h"
 #include "netutils.h"
+#include "dbbroker.h"
 #include "check_mysql_query.d/config.h"
 
 #include <mysql.h>
@@ -58,6 +59,25 @@ void print_usage(void);
 
 static int verbose = 0;
 
+static char *broker_dsn(check_mysql_query_config /*config*/);
+static MYSQL *connect_dsn(const char * /*dsn*/, dbbroker_reply * /*reply*/,
+						  unsigned int /*connect_timeout*/);
+static void *broker_connect(const char * /*dsn*/, dbbroker_reply * /*reply*/);
+static bool broker_alive(void * /*connection*/);
+static dbbroker_reply broker_query(void * /*connection*/, const char * /*query*/);
+static void broker_close(void * /*connection*/);
+static mp_state_enum connect_error_state(int /*error_code*/);
+static void evaluate_reply(mp_check /*overall*/, check_mysql_query_config /*config*/,
+						   dbbroker_reply /*reply*/);
+
+static const dbbroker_backend mysql_backend = {
+	.name = "mysql",
+	.connect = broker_connect,
+	.alive = broker_alive,
+	.query = broker_query,
+	.close = broker_close,
+};
+
 int main(int argc, char **argv) {
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -77,100 +97,109 @@ int main(int argc, char **argv) {
 		mp_set_format(config.output_format);
 	}
 
-	MYSQL mysql;
-	/* initialize mysql  */
-	mysql_init(&mysql);
+	mp_check overall = mp_check_init();
 
-	if (config.opt_file != NULL) {
-		mysql_options(&mysql, MYSQL_READ_DEFAULT_FILE, config.opt_file);
-	}
+	mp_set_ok_summary(&overall, "MySQL query is OK");
 
-	if (config.opt_group != NULL) {
-		mysql_options(&mysql, MYSQL_READ_DEFAULT_GROUP, config.opt_group);
-	} else {
-		mysql_options(&mysql, MYSQL_READ_DEFAULT_GROUP, "client");
+	char *dsn = broker_dsn(config);
+	dbbroker_reply reply = {
+		.status = DBBROKER_UNAVAILABLE,
+	};
+	if (config.broker_socket != NULL) {
+		reply = dbbroker_request(config.broker_socket, &mysql_backend, dsn, config.sql_query);
+		/* the check still works without the broker */
+		if (reply.status == DBBROKER_UNAVAILABLE && verbose) {
+			printf("Connecting without the broker: %s\n", reply.message);
+		}
 	}
 
-	mp_check overall = mp_check_init();
+	if (reply.status == DBBROKER_UNAVAILABLE) {
+		dbbroker_reply_free(&reply);
+		reply = (dbbroker_reply){
+			.status = DBBROKER_OK,
+		};
+
+		struct timeval start;
+		gettimeofday(&start, NULL);
+		MYSQL *mysql = connect_dsn(dsn, &reply, 0);
+		reply.connect_time = delta_time(start);
+		if (mysql == NULL) {
+			reply.status = DBBROKER_CONNECT_FAILED;
+		} else {
+			gettimeofday(&start, NULL);
+			dbbroker_reply query_reply = broker_query(mysql, config.sql_query);
+			reply.query_time = delta_time(start);
+			reply.status = query_reply.status;
+			reply.value = query_reply.value;
+			reply.message = query_reply.message;
+			reply.error_code = query_reply.error_code;
+			broker_close(mysql);
+		}
+	}
+	free(dsn);
 
-	mp_set_ok_summary(&overall, "MySQL query is OK");
+	evaluate_reply(overall, config, reply);
+}
 
+static void evaluate_reply(mp_check overall, check_mysql_query_config config,
+						   dbbroker_reply reply) {
 	mp_subcheck sc_connect = mp_subcheck_init();
 
 	/* establish a connection to the server and error checking */
-	if (!mysql_real_connect(&mysql, config.db_host, config.db_user, config.db_pass, config.db,
-							config.db_port, config.db_socket, 0)) {
-		xasprintf(&sc_connect.output, "query failed: %s", mysql_error(&mysql));
-
-		if (mysql_errno(&mysql) == CR_UNKNOWN_HOST) {
-			sc_connect = mp_set_subcheck_state(sc_connect, STATE_WARNING);
-		} else if (mysql_errno(&mysql) == CR_VERSION_ERROR) {
-			sc_connect = mp_set_subcheck_state(sc_connect, STATE_WARNING);
-		} else if (mysql_errno(&mysql) == CR_OUT_OF_MEMORY) {
-			sc_connect = mp_set_subcheck_state(sc_connect, STATE_WARNING);
-		} else if (mysql_errno(&mysql) == CR_IPSOCK_ERROR) {
-			sc_connect = mp_set_subcheck_state(sc_connect, STATE_WARNING);
-		} else if (mysql_errno(&mysql) == CR_SOCKET_CREATE_ERROR) {
-			sc_connect = mp_set_subcheck_state(sc_connect, STATE_WARNING);
-		} else {
-			sc_connect = mp_set_subcheck_state(sc_connect, STATE_CRITICAL);
-		}
-
+	if (reply.status == DBBROKER_CONNECT_FAILED) {
+		xasprintf(&sc_connect.output, "query failed: %s", reply.message);
+		sc_connect = mp_set_subcheck_state(sc_connect, connect_error_state(reply.error_code));
 		mp_add_subcheck_to_check(&overall, sc_connect);
 		mp_exit(overall);
 	}
 
 	sc_connect = mp_set_subcheck_state(sc_connect, STATE_OK);
-	xasprintf(&sc_connect.output, "query succeeded");
-	mp_add_subcheck_to_check(&overall, sc_connect);
-
-	if (mysql_query(&mysql, config.sql_query) != 0) {
-		char *error = strdup(mysql_error(&mysql));
-		mysql_close(&mysql);
-		die(STATE_CRITICAL, "QUERY %s: %s - %s\n", _("CRITICAL"), _("Error with query"), error);
+	if (reply.reused) {
+		xasprintf(&sc_connect.output, "query succeeded (connection kept by the broker)");
+	} else {
+		xasprintf(&sc_connect.output, "query succeeded");
 	}
 
-	MYSQL_RES *res;
-	/* store the result */
-	if ((res = mysql_store_result(&mysql)) == NULL) {
-		char *error = strdup(mysql_error(&mysql));
-		mysql_close(&mysql);
-		die(STATE_CRITICAL, "QUERY %s: Error with store_result - %s\n", _("CRITICAL"), error);
-	}
+	/* the connection and the query are timed apart, 0 for a connection kept by the broker */
+	mp_perfdata pd_connection_time = perfdata_init();
+	pd_connection_time.label = "connection_time";
+	pd_connection_time.uom = "s";
+	pd_connection_time = mp_set_pd_value(pd_connection_time, reply.connect_time);
+	mp_add_perfdata_to_subcheck(&sc_connect, pd_connection_time);
+
+	mp_perfdata pd_query_time = perfdata_init();
+	pd_query_time.label = "query_time";
+	pd_query_time.uom = "s";
+	pd_query_time = mp_set_pd_value(pd_query_time, reply.query_time);
+	mp_add_perfdata_to_subcheck(&sc_connect, pd_query_time);
+	mp_add_subcheck_to_check(&overall, sc_connect);
 
-	/* Check there is some data */
-	if (mysql_num_rows(res) == 0) {
-		mysql_close(&mysql);
+	switch (reply.status) {
+	case DBBROKER_OK:
+		break;
+	case DBBROKER_NO_ROWS:
 		die(STATE_WARNING, "QUERY %s: %s\n", _("WARNING"), _("No rows returned"));
-	}
-
-	mp_subcheck sc_value = mp_subcheck_init();
-	MYSQL_ROW row;
-	/* fetch the first row */
-	if ((row = mysql_fetch_row(res)) == NULL) {
-		xasprintf(&sc_value.output, "fetch row error - %s", mysql_error(&mysql));
-		mysql_free_result(res);
-		mysql_close(&mysql);
-
+	case DBBROKER_NO_DATA: {
+		mp_subcheck sc_value = mp_subcheck_init();
+		xasprintf(&sc_value.output, "fetch row error - %s", reply.message);
 		sc_value = mp_set_subcheck_state(sc_value, STATE_CRITICAL);
 		mp_add_subcheck_to_check(&overall, sc_value);
 		mp_exit(overall);
 	}
+	default:
+		die(STATE_CRITICAL, "QUERY %s: %s - %s\n", _("CRITICAL"), _("Error with query"),
+			reply.message);
+	}
 
-	if (!is_numeric(row[0])) {
+	mp_subcheck sc_value = mp_subcheck_init();
+	if (reply.value == NULL || !is_numeric(reply.value)) {
 		xasprintf(&sc_value.output, "query result is not numeric");
 		sc_value = mp_set_subcheck_state(sc_value, STATE_CRITICAL);
 		mp_add_subcheck_to_check(&overall, sc_value);
 		mp_exit(overall);
 	}
 
-	double value = strtod(row[0], NULL);
-
-	/* free the result */
-	mysql_free_result(res);
-
-	/* close the connection */
-	mysql_close(&mysql);
+	double value = strtod(reply.value, NULL);
 
 	if (verbose >= 3) {
 		printf("mysql result: %f\n", value);
@@ -194,11 +223,143 @@ int main(int argc, char **argv) {
 	mp_exit(overall);
 }
 
+static mp_state_enum connect_error_state(int error_code) {
+	switch (error_code) {
+	case CR_UNKNOWN_HOST:
+	case CR_VERSION_ERROR:
+	case CR_OUT_OF_MEMORY:
+	case CR_IPSOCK_ERROR:
+	case CR_SOCKET_CREATE_ERROR:
+		return STATE_WARNING;
+	default:
+		return STATE_CRITICAL;
+	}
+}
+
+/* the connection parameters one per line, with a + in front, an empty line is NULL */
+static char *broker_dsn(check_mysql_query_config config) {
+	const char *fields[] = {config.db_host, config.db_socket, config.db,       config.db_user,
+							config.db_pass, config.opt_file,  config.opt_group};
+	char *result;
+	xasprintf(&result, "%u", config.db_port);
+	for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+		char *previous = result;
+		xasprintf(&result, "%s\n%s%s", previous, fields[i] != NULL ? "+" : "",
+				  fields[i] != NULL ? fields[i] : "");
+		free(previous);
+	}
+	return result;
+}
+
+/* a connect_timeout of 0 keeps the one of the option file or the default */
+static MYSQL *connect_dsn(const char *dsn, dbbroker_reply *reply, unsigned int connect_timeout) {
+	char *copy = strdup(dsn);
+	char *position = copy;
+	unsigned int port = (unsigned int)strtoul(strsep(&position, "\n"), NULL, 10);
+	/* an empty password is not the same as none */
+	char *fields[7] = {0};
+	for (int i = 0; i < 7 && position != NULL; i++) {
+		char *field = strsep(&position, "\n");
+		fields[i] = field[0] == '+' ? field + 1 : NULL;
+	}
+	char *host = fields[0];
+	char *unix_socket = fields[1];
+	char *db = fields[2];
+	char *user = fields[3];
+	char *pass = fields[4];
+	char *opt_file = fields[5];
+	char *opt_group = fields[6];
+
+	MYSQL *mysql = malloc(sizeof(MYSQL));
+	if (mysql == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the connection\n"));
+	}
+	/* initialize mysql  */
+	mysql_init(mysql);
+
+	if (opt_file != NULL) {
+		mysql_options(mysql, MYSQL_READ_DEFAULT_FILE, opt_file);
+	}
+
+	if (opt_group != NULL) {
+		mysql_options(mysql, MYSQL_READ_DEFAULT_GROUP, opt_group);
+	} else {
+		mysql_options(mysql, MYSQL_READ_DEFAULT_GROUP, "client");
+	}
+
+	if (connect_timeout > 0) {
+		mysql_options(mysql, MYSQL_OPT_CONNECT_TIMEOUT, &connect_timeout);
+	}
+
+	if (!mysql_real_connect(mysql, host, user, pass, db, port, unix_socket, 0)) {
+		reply->message = strdup(mysql_error(mysql));
+		reply->error_code = (int)mysql_errno(mysql);
+		mysql_close(mysql);
+		free(mysql);
+		mysql = NULL;
+	}
+	free(copy);
+	return mysql;
+}
+
+static void *broker_connect(const char *dsn, dbbroker_reply *reply) {
+	/* the checks of the same connection string wait for each other in the broker */
+	return connect_dsn(dsn, reply, DBBROKER_CONNECT_TIMEOUT);
+}
+
+static bool broker_alive(void *connection) { return mysql_ping(connection) == 0; }
+
+static dbbroker_reply broker_query(void *connection, const char *query) {
+	MYSQL *mysql = connection;
+	dbbroker_reply result = {
+		.status = DBBROKER_OK,
+	};
+
+	if (mysql_query(mysql, query) != 0) {
+		result.status = DBBROKER_QUERY_FAILED;
+		result.message = strdup(mysql_error(mysql));
+		result.error_code = (int)mysql_errno(mysql);
+		return result;
+	}
+
+	MYSQL_RES *res;
+	/* store the result */
+	if ((res = mysql_store_result(mysql)) == NULL) {
+		result.status = DBBROKER_QUERY_FAILED;
+		xasprintf(&result.message, "Error with store_result - %s", mysql_error(mysql));
+		result.error_code = (int)mysql_errno(mysql);
+		return result;
+	}
+
+	MYSQL_ROW row;
+	/* Check there is some data */
+	if (mysql_num_rows(res) == 0) {
+		result.status = DBBROKER_NO_ROWS;
+	} else if ((row = mysql_fetch_row(res)) == NULL) {
+		/* fetch the first row */
+		result.status = DBBROKER_NO_DATA;
+		result.message = strdup(mysql_error(mysql));
+	} else if (row[0] != NULL) {
+		result.value = strdup(row[0]);
+	}
+
+	/* free the result */
+	mysql_free_result(res);
+	return result;
+}
+
+static void broker_close(void *connection) {
+	/* close the connection */
+	mysql_close(connection);
+	free(connection);
+}
+
 /* process command-line arguments */
 check_mysql_query_config_wrapper process_arguments(int argc, char **argv) {
 	enum {
 		output_format_index = CHAR_MAX + 1,
 		queryname_index,
+		broker_index,
 	};
 
 	static struct option longopts[] = {{"hostname", required_argument, 0, 'H'},
@@ -217,6 +378,7 @@ check_mysql_query_config_wrapper process_arguments(int argc, char **argv) {
 									   {"critical", required_argument, 0, 'c'},
 									   {"output-format", required_argument, 0, output_format_index},
 									   {"queryname", required_argument, 0, queryname_index},
+									   {"broker", required_argument, 0, broker_index},
 									   {0, 0, 0, 0}};
 
 	check_mysql_query_config_wrapper result = {
@@ -313,7 +475,10 @@ check_mysql_query_config_wrapper process_arguments(int argc, char **argv) {
 		}
 		case queryname_index: {
 			result.config.queryname = optarg;
-		}
+		} break;
+		case broker_index:
+			result.config.broker_socket = optarg;
+			break;
 		}
 	}
 
@@ -378,6 +543,11 @@ void print_help(void) {
 	printf("    %s\n", _("Password to login with"));
 	printf("    ==> %s <==\n", _("IMPORTANT: THIS FORM OF AUTHENTICATION IS NOT SECURE!!!"));
 	printf("    %s\n", _("Your clear-text password could be visible as a process table entry"));
+	printf(" %s\n", "--broker=PATH");
+	printf("    %s\n", _("Run the query through a connection broker on the Unix socket PATH,"));
+	printf("    %s\n", _("which keeps the connection open for the next check. The broker is"));
+	printf("    %s\n", _("started if none is running and exits after some minutes without"));
+	printf("    %s\n", _("checks. The directory of PATH must not be writable by other users"));
 
 	printf(UT_OUTPUT_FORMAT);
 
@@ -397,4 +567,5 @@ void print_usage(void) {
 	printf("%s\n", _("Usage:"));
 	printf(" %s -q SQL_query [-w warn] [-c crit] [-H host] [-P port] [-s socket]\n", progname);
 	printf("       [-d database] [-u user] [-p password] [-f optfile] [-g group]\n");
+	printf("       [--broker=socket]\n");
 }
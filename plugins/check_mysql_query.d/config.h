@@ -19,6 +19,8 @@ typedef struct {
 	char *queryname;
 	mp_thresholds thresholds;
 
+	char *broker_socket; /* the connection broker, see dbbroker.h */
+
 	bool output_format_is_set;
 	mp_output_format output_format;
 } check_mysql_query_config;
@@ -39,6 +41,8 @@ check_mysql_query_config check_mysql_query_config_init() {
 		.queryname = NULL,
 		.thresholds = mp_thresholds_init(),
 
+		.broker_socket = NULL,
+
 		.output_format_is_set = false,
 	};
 	return tmp;
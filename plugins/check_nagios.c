@@ -41,17 +41,25 @@ const char *email = "devel@monitoring-plugins.org";
 #include "utils.h"
 #include "states.h"
 #include "check_nagios.d/config.h"
+#include "check_nagios.d/status_log.h"
+#include "check_nagios.d/proc.h"
 
 typedef struct {
 	int errorcode;
 	check_nagios_config config;
 } check_nagios_config_wrapper;
 static check_nagios_config_wrapper process_arguments(int /*argc*/, char ** /*argv*/);
+static int count_processes_with_ps(const char * /*process_string*/, const char * /*self*/);
 static void print_help(void);
 void print_usage(void);
 
 static int verbose = 0;
 
+enum {
+	INCREMENTAL_OPT = CHAR_MAX + 1,
+	PIDFILE_OPT,
+};
+
 int main(int argc, char **argv) {
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -76,44 +84,116 @@ int main(int argc, char **argv) {
 	/* handle timeouts gracefully... */
 	alarm(timeout_interval);
 
-	/* open the status log */
-	FILE *log_file = fopen(config.status_log, "r");
-	if (log_file == NULL) {
+	/* find the latest entry of the status log, continuing where the last run stopped */
+	status_log_position position = {0};
+	state_key key = {0};
+	if (config.incremental) {
+		key = np_enable_state(NULL, STATUS_LOG_STATE_VERSION, progname, argc, argv);
+		state_data *previous_state = np_state_read(key);
+		/* there is no state data on the first run */
+		if (previous_state != NULL && previous_state->errorcode == OK) {
+			status_log_parse_position(previous_state->data, &position);
+		}
+		if (verbose >= 2) {
+			printf(_("Continuing the status log at offset %lld\n"), position.offset);
+		}
+	}
+
+	if (status_log_scan(config.status_log, &position) != OK) {
 		die(STATE_CRITICAL, "NAGIOS %s: %s\n", _("CRITICAL"),
 			_("Cannot open status log for reading!"));
 	}
+	unsigned long latest_entry_time = position.latest_entry_time;
 
-	unsigned long latest_entry_time = 0L;
-	unsigned long temp_entry_time = 0L;
-	char input_buffer[MAX_INPUT_BUFFER];
-	char *temp_ptr;
-	/* get the date/time of the last item updated in the log */
-	while (fgets(input_buffer, MAX_INPUT_BUFFER - 1, log_file)) {
-		if ((temp_ptr = strstr(input_buffer, "created=")) != NULL) {
-			temp_entry_time = strtoul(temp_ptr + 8, NULL, 10);
-			latest_entry_time = temp_entry_time;
-			break;
+	if (config.incremental) {
+		char *state_string = status_log_format_position(position);
+		np_state_write_string(key, time(NULL), state_string);
+		free(state_string);
+	}
+
+	/* look for the daemon in /proc, the process table is only listed with ps without it */
+	nagios_proc_result process = {
+		.errorcode = ERROR,
+		.uptime = -1,
+		.rss = -1,
+	};
+	if (config.pidfile != NULL) {
+		process = nagios_proc_from_pidfile(NAGIOS_PROC_DIR, config.pidfile, config.process_string);
+		if (process.errorcode != OK && verbose >= 2) {
+			printf(_("The pidfile %s names no running process, scanning the process table\n"),
+				   config.pidfile);
 		}
-		if ((temp_ptr = strtok(input_buffer, "]")) != NULL) {
-			temp_entry_time = strtoul(temp_ptr + 1, NULL, 10);
-			if (temp_entry_time > latest_entry_time) {
-				latest_entry_time = temp_entry_time;
-			}
+	}
+	if (process.errorcode != OK && nagios_proc_available(NAGIOS_PROC_DIR)) {
+		process = nagios_proc_scan(NAGIOS_PROC_DIR, config.process_string, argv[0]);
+	}
+
+	int proc_entries = 0;
+	if (process.errorcode == OK) {
+		proc_entries = process.processes;
+		if (verbose >= 2 && process.pid != 0) {
+			printf(_("Found process %ld in %s\n"), (long)process.pid,
+				   process.from_pidfile ? config.pidfile : NAGIOS_PROC_DIR);
+		}
+	} else {
+		proc_entries = count_processes_with_ps(config.process_string, argv[0]);
+	}
+
+	/* reset the alarm handler */
+	alarm(0);
+
+	if (proc_entries == 0) {
+		die(STATE_CRITICAL, "NAGIOS %s: %s\n", _("CRITICAL"),
+			_("Could not locate a running Nagios process!"));
+	}
+
+	if (latest_entry_time == 0L) {
+		die(STATE_CRITICAL, "NAGIOS %s: %s\n", _("CRITICAL"),
+			_("Cannot parse Nagios log file for valid time"));
+	}
+
+	time_t current_time;
+	time(&current_time);
+	mp_state_enum result = STATE_UNKNOWN;
+	if ((int)(current_time - latest_entry_time) > (config.expire_minutes * 60)) {
+		result = STATE_WARNING;
+	} else {
+		result = STATE_OK;
+	}
+
+	printf("NAGIOS %s: ", (result == STATE_OK) ? _("OK") : _("WARNING"));
+	printf(ngettext("%d process", "%d processes", proc_entries), proc_entries);
+	printf(", ");
+	printf(ngettext("status log updated %d second ago", "status log updated %d seconds ago",
+					(int)(current_time - latest_entry_time)),
+		   (int)(current_time - latest_entry_time));
+	/* the uptime and memory of the daemon are only known from /proc */
+	if (process.errorcode == OK && process.pid != 0) {
+		printf("|");
+		if (process.uptime >= 0) {
+			printf("%s ", perfdata_int64("uptime", process.uptime, "s", false, 0, false, 0, true,
+										 0, false, 0));
+		}
+		if (process.rss >= 0) {
+			printf("%s", perfdata_int64("rss", process.rss, "B", false, 0, false, 0, true, 0,
+										false, 0));
 		}
 	}
-	fclose(log_file);
+	printf("\n");
 
+	exit(result);
+}
+
+/* counts the processes whose arguments contain process_string in the output of ps */
+static int count_processes_with_ps(const char *process_string, const char *self) {
 	if (verbose >= 2) {
 		printf("command: %s\n", PS_COMMAND);
 	}
 
 	/* run the command to check for the Nagios process.. */
-	mp_state_enum result = STATE_UNKNOWN;
 	output chld_out;
 	output chld_err;
-	if ((result = np_runcmd(PS_COMMAND, &chld_out, &chld_err, 0)) != 0) {
-		result = STATE_WARNING;
-	}
+	np_runcmd(PS_COMMAND, &chld_out, &chld_err, 0);
 
 	int procuid = 0;
 	int procpid = 0;
@@ -154,7 +234,7 @@ int main(int argc, char **argv) {
 			}
 
 			/* May get empty procargs */
-			if (!strstr(procargs, argv[0]) && strstr(procargs, config.process_string) &&
+			if (!strstr(procargs, self) && strstr(procargs, process_string) &&
 				strcmp(procargs, "")) {
 				proc_entries++;
 				if (verbose >= 2) {
@@ -164,41 +244,7 @@ int main(int argc, char **argv) {
 		}
 	}
 
-	/* If we get anything on stderr, at least set warning */
-	if (chld_err.buflen) {
-		result = max_state(result, STATE_WARNING);
-	}
-
-	/* reset the alarm handler */
-	alarm(0);
-
-	if (proc_entries == 0) {
-		die(STATE_CRITICAL, "NAGIOS %s: %s\n", _("CRITICAL"),
-			_("Could not locate a running Nagios process!"));
-	}
-
-	if (latest_entry_time == 0L) {
-		die(STATE_CRITICAL, "NAGIOS %s: %s\n", _("CRITICAL"),
-			_("Cannot parse Nagios log file for valid time"));
-	}
-
-	time_t current_time;
-	time(&current_time);
-	if ((int)(current_time - latest_entry_time) > (config.expire_minutes * 60)) {
-		result = STATE_WARNING;
-	} else {
-		result = STATE_OK;
-	}
-
-	printf("NAGIOS %s: ", (result == STATE_OK) ? _("OK") : _("WARNING"));
-	printf(ngettext("%d process", "%d processes", proc_entries), proc_entries);
-	printf(", ");
-	printf(ngettext("status log updated %d second ago", "status log updated %d seconds ago",
-					(int)(current_time - latest_entry_time)),
-		   (int)(current_time - latest_entry_time));
-	printf("\n");
-
-	exit(result);
+	return proc_entries;
 }
 
 /* process command-line arguments */
@@ -207,7 +253,8 @@ check_nagios_config_wrapper process_arguments(int argc, char **argv) {
 		{"filename", required_argument, 0, 'F'}, {"expires", required_argument, 0, 'e'},
 		{"command", required_argument, 0, 'C'},  {"timeout", optional_argument, 0, 't'},
 		{"version", no_argument, 0, 'V'},        {"help", no_argument, 0, 'h'},
-		{"verbose", no_argument, 0, 'v'},        {0, 0, 0, 0}};
+		{"verbose", no_argument, 0, 'v'},        {"incremental", no_argument, 0, INCREMENTAL_OPT},
+		{"pidfile", required_argument, 0, PIDFILE_OPT}, {0, 0, 0, 0}};
 
 	check_nagios_config_wrapper result = {
 		.errorcode = OK,
@@ -267,6 +314,12 @@ check_nagios_config_wrapper process_arguments(int argc, char **argv) {
 		case 'v':
 			verbose++;
 			break;
+		case INCREMENTAL_OPT:
+			result.config.incremental = true;
+			break;
+		case PIDFILE_OPT:
+			result.config.pidfile = optarg;
+			break;
 		default: /* print short usage_va statement if args not parsable */
 			usage5();
 		}
@@ -293,6 +346,8 @@ void print_help(void) {
 	printf("%s\n", _("the number of minutes specified by the expires option."));
 	printf("%s\n",
 		   _("It also checks the process table for a process matching the command argument."));
+	printf("%s\n", _("Where /proc is available it is read instead of running ps, the uptime and"));
+	printf("%s\n", _("the resident memory of the daemon are then reported as performance data."));
 
 	printf("\n\n");
 
@@ -309,6 +364,13 @@ void print_help(void) {
 	printf("    %s\n", _("Substring to search for in process arguments"));
 	printf(" %s\n", "-t, --timeout=INTEGER");
 	printf("    %s\n", _("Timeout for the plugin in seconds"));
+	printf(" %s\n", "--incremental");
+	printf("    %s\n", _("Remember the inode and offset of the status log between runs and only"));
+	printf("    %s\n", _("read the lines appended since. The position is kept in the state"));
+	printf("    %s\n", _("directory, see MP_STATE_PATH"));
+	printf(" %s\n", "--pidfile=FILE");
+	printf("    %s\n", _("The pidfile (lock_file) of the daemon. Its process is looked up in"));
+	printf("    %s\n", _("/proc directly instead of listing all processes"));
 	printf(UT_VERBOSE);
 
 	printf("\n");
@@ -323,4 +385,5 @@ void print_usage(void) {
 	printf("%s\n", _("Usage:"));
 	printf("%s -F <status log file> -t <timeout_seconds> -e <expire_minutes> -C <process_string>\n",
 		   progname);
+	printf("  [--incremental] [--pidfile=<file>]\n");
 }
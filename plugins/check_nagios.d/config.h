@@ -1,12 +1,15 @@
 #pragma once
 
 #include "../../config.h"
+#include <stdbool.h>
 #include <stddef.h>
 
 typedef struct {
 	char *status_log;
 	char *process_string;
 	int expire_minutes;
+	bool incremental;
+	char *pidfile;
 } check_nagios_config;
 
 check_nagios_config check_nagios_config_init() {
@@ -14,6 +17,8 @@ check_nagios_config check_nagios_config_init() {
 		.status_log = NULL,
 		.process_string = NULL,
 		.expire_minutes = 0,
+		.incremental = false,
+		.pidfile = NULL,
 	};
 	return tmp;
 }
@@ -0,0 +1,224 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./proc.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* longer command lines are cut, the daemon name is at the start anyway */
+#define NAGIOS_PROC_CMDLINE_SIZE 4096
+
+/* reads a whole (small) file, returns the length or -1 */
+static ssize_t nagios_proc_read(const char *path, char *buffer, size_t size) {
+	int file_descriptor = open(path, O_RDONLY);
+	if (file_descriptor < 0) {
+		return -1;
+	}
+	size_t length = 0;
+	while (length < size - 1) {
+		ssize_t got = read(file_descriptor, buffer + length, size - 1 - length);
+		if (got <= 0) {
+			break;
+		}
+		length += (size_t)got;
+	}
+	close(file_descriptor);
+	buffer[length] = '\0';
+	return (ssize_t)length;
+}
+
+static ssize_t nagios_proc_read_pid_file(const char *proc_dir, pid_t pid, const char *name,
+										 char *buffer, size_t size) {
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%ld/%s", proc_dir, (long)pid, name);
+	return nagios_proc_read(path, buffer, size);
+}
+
+/* the arguments are separated by NUL bytes, they are joined with spaces like ps does */
+static bool nagios_proc_cmdline(const char *proc_dir, pid_t pid, char *buffer, size_t size) {
+	ssize_t length = nagios_proc_read_pid_file(proc_dir, pid, "cmdline", buffer, size);
+	if (length <= 0) {
+		/* kernel threads and zombies have no command line */
+		return false;
+	}
+	while (length > 0 && buffer[length - 1] == '\0') {
+		length--;
+	}
+	for (ssize_t i = 0; i < length; i++) {
+		if (buffer[i] == '\0') {
+			buffer[i] = ' ';
+		}
+	}
+	buffer[length] = '\0';
+	return length > 0;
+}
+
+/* the start time in clock ticks after boot, the 22nd field of /proc/<pid>/stat */
+static bool nagios_proc_start_ticks(const char *proc_dir, pid_t pid, unsigned long long *ticks) {
+	char buffer[1024];
+	if (nagios_proc_read_pid_file(proc_dir, pid, "stat", buffer, sizeof(buffer)) <= 0) {
+		return false;
+	}
+	/* the command name in parentheses may contain spaces */
+	char *fields = strrchr(buffer, ')');
+	if (fields == NULL) {
+		return false;
+	}
+	fields++;
+	for (int field = 3; field < 22; field++) {
+		while (*fields == ' ') {
+			fields++;
+		}
+		while (*fields != ' ' && *fields != '\0') {
+			fields++;
+		}
+	}
+	char *end;
+	*ticks = strtoull(fields, &end, 10);
+	return end != fields;
+}
+
+static bool nagios_proc_boot_time(const char *proc_dir, time_t *boot_time) {
+	char path[PATH_MAX];
+	char buffer[8192];
+	snprintf(path, sizeof(path), "%s/stat", proc_dir);
+	if (nagios_proc_read(path, buffer, sizeof(buffer)) <= 0) {
+		return false;
+	}
+	char *line = strstr(buffer, "\nbtime ");
+	if (line == NULL) {
+		return false;
+	}
+	*boot_time = (time_t)strtoll(line + 7, NULL, 10);
+	return true;
+}
+
+/* when the process was started, in seconds since the epoch */
+static bool nagios_proc_start_time(const char *proc_dir, pid_t pid, time_t *start_time) {
+	unsigned long long ticks;
+	time_t boot_time;
+	long ticks_per_second = sysconf(_SC_CLK_TCK);
+	if (ticks_per_second <= 0 || !nagios_proc_start_ticks(proc_dir, pid, &ticks) ||
+		!nagios_proc_boot_time(proc_dir, &boot_time)) {
+		return false;
+	}
+	*start_time = boot_time + (time_t)(ticks / (unsigned long long)ticks_per_second);
+	return true;
+}
+
+/* the uptime and the resident set size of the daemon */
+static void nagios_proc_details(const char *proc_dir, nagios_proc_result *result) {
+	time_t start_time;
+	if (nagios_proc_start_time(proc_dir, result->pid, &start_time)) {
+		result->uptime = (long long)(time(NULL) - start_time);
+		if (result->uptime < 0) {
+			result->uptime = 0;
+		}
+	}
+
+	char buffer[256];
+	unsigned long long size;
+	unsigned long long resident;
+	if (nagios_proc_read_pid_file(proc_dir, result->pid, "statm", buffer, sizeof(buffer)) > 0 &&
+		sscanf(buffer, "%llu %llu", &size, &resident) == 2) {
+		result->rss = (long long)resident * sysconf(_SC_PAGESIZE);
+	}
+}
+
+bool nagios_proc_available(const char *proc_dir) {
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/stat", proc_dir);
+	return access(path, R_OK) == 0;
+}
+
+nagios_proc_result nagios_proc_from_pidfile(const char *proc_dir, const char *pidfile,
+											const char *process_string) {
+	nagios_proc_result result = {
+		.errorcode = ERROR,
+		.uptime = -1,
+		.rss = -1,
+	};
+
+	char buffer[64];
+	struct stat pidfile_stat;
+	if (stat(pidfile, &pidfile_stat) != 0 ||
+		nagios_proc_read(pidfile, buffer, sizeof(buffer)) <= 0) {
+		return result;
+	}
+	char *end;
+	long pid = strtol(buffer, &end, 10);
+	if (end == buffer || pid <= 0) {
+		return result;
+	}
+
+	char cmdline[NAGIOS_PROC_CMDLINE_SIZE];
+	if (!nagios_proc_cmdline(proc_dir, (pid_t)pid, cmdline, sizeof(cmdline)) ||
+		strstr(cmdline, process_string) == NULL) {
+		return result;
+	}
+
+	/* a process started after the pidfile was written got a recycled pid */
+	time_t start_time;
+	if (!nagios_proc_start_time(proc_dir, (pid_t)pid, &start_time) ||
+		start_time > pidfile_stat.st_mtime + 1) {
+		return result;
+	}
+
+	result.errorcode = OK;
+	result.processes = 1;
+	result.pid = (pid_t)pid;
+	result.from_pidfile = true;
+	nagios_proc_details(proc_dir, &result);
+	return result;
+}
+
+nagios_proc_result nagios_proc_scan(const char *proc_dir, const char *process_string,
+									const char *exclude) {
+	nagios_proc_result result = {
+		.errorcode = ERROR,
+		.uptime = -1,
+		.rss = -1,
+	};
+
+	DIR *directory = opendir(proc_dir);
+	if (directory == NULL) {
+		return result;
+	}
+
+	pid_t self = getpid();
+	unsigned long long oldest_ticks = 0;
+	char cmdline[NAGIOS_PROC_CMDLINE_SIZE];
+	struct dirent *entry;
+	while ((entry = readdir(directory)) != NULL) {
+		if (!isdigit((unsigned char)entry->d_name[0])) {
+			continue;
+		}
+		pid_t pid = (pid_t)strtol(entry->d_name, NULL, 10);
+		/* the process may have exited since the directory was read */
+		if (pid == self || !nagios_proc_cmdline(proc_dir, pid, cmdline, sizeof(cmdline)) ||
+			strstr(cmdline, process_string) == NULL ||
+			(exclude != NULL && strstr(cmdline, exclude) != NULL)) {
+			continue;
+		}
+
+		result.processes++;
+		unsigned long long ticks;
+		if (nagios_proc_start_ticks(proc_dir, pid, &ticks) &&
+			(result.pid == 0 || ticks < oldest_ticks)) {
+			result.pid = pid;
+			oldest_ticks = ticks;
+		}
+	}
+	closedir(directory);
+
+	result.errorcode = OK;
+	if (result.pid != 0) {
+		nagios_proc_details(proc_dir, &result);
+	}
+	return result;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+#include <sys/types.h>
+
+#define NAGIOS_PROC_DIR "/proc"
+
+typedef struct {
+	int errorcode;           /* OK, or ERROR if the process table could not be read */
+	int processes;           /* the number of matching processes */
+	pid_t pid;               /* the oldest of them, the daemon itself */
+	bool from_pidfile;       /* whether the pidfile was valid */
+	long long uptime;        /* seconds, -1 if unknown */
+	long long rss;           /* bytes, -1 if unknown */
+} nagios_proc_result;
+
+/* whether proc_dir is a mounted proc file system this can be used on */
+bool nagios_proc_available(const char *proc_dir);
+
+/*
+ * Looks up the process in the pidfile. It only counts if its command
+ * line contains process_string and it was started before the pidfile
+ * was written, otherwise the pid was reused by another process.
+ * errorcode is ERROR if the pidfile does not name the daemon.
+ */
+nagios_proc_result nagios_proc_from_pidfile(const char *proc_dir, const char *pidfile,
+											const char *process_string);
+
+/*
+ * Counts the processes whose command line contains process_string but not
+ * exclude (the name of the plugin, which has the string in its arguments).
+ */
+nagios_proc_result nagios_proc_scan(const char *proc_dir, const char *process_string,
+									const char *exclude);
@@ -0,0 +1,102 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./status_log.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+/* FNV-1a, only used to recognise the line again */
+static unsigned long long status_log_hash(const char *line, size_t length) {
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; i++) {
+		hash = (hash ^ (unsigned char)line[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+/* whether the line which ended at the offset is still the same */
+static bool status_log_line_unchanged(FILE *log_file, const status_log_position *position) {
+	if (position->line_length <= 0 || position->line_length >= MAX_INPUT_BUFFER ||
+		position->line_length > position->offset ||
+		fseeko(log_file, (off_t)(position->offset - position->line_length), SEEK_SET) != 0) {
+		return false;
+	}
+	char line[MAX_INPUT_BUFFER];
+	size_t length = (size_t)position->line_length;
+	return fread(line, 1, length, log_file) == length &&
+		   status_log_hash(line, length) == position->line_hash;
+}
+
+int status_log_scan(const char *path, status_log_position *position) {
+	FILE *log_file = fopen(path, "r");
+	if (log_file == NULL) {
+		return ERROR;
+	}
+
+	struct stat file_stat;
+	if (fstat(fileno(log_file), &file_stat) != 0) {
+		fclose(log_file);
+		return ERROR;
+	}
+
+	/* a new file or one which was truncated or rewritten since is read again from the start */
+	bool resume = position->inode != 0 &&
+				  position->inode == (unsigned long long)file_stat.st_ino &&
+				  position->offset <= (long long)file_stat.st_size &&
+				  status_log_line_unchanged(log_file, position);
+	if (!resume) {
+		rewind(log_file);
+		position->offset = 0;
+		position->line_length = 0;
+		position->latest_entry_time = 0L;
+	}
+	position->inode = (unsigned long long)file_stat.st_ino;
+
+	char input_buffer[MAX_INPUT_BUFFER];
+	char *temp_ptr;
+	/* get the date/time of the last item updated in the log */
+	while (fgets(input_buffer, MAX_INPUT_BUFFER - 1, log_file)) {
+		/* a line which is still being written is read again next time */
+		size_t length = strlen(input_buffer);
+		if (length > 0 && input_buffer[length - 1] == '\n') {
+			position->line_length = (long long)length;
+			position->line_hash = status_log_hash(input_buffer, length);
+			position->offset = (long long)ftello(log_file);
+		}
+
+		if ((temp_ptr = strstr(input_buffer, "created=")) != NULL) {
+			position->latest_entry_time = strtoul(temp_ptr + 8, NULL, 10);
+			/* status.dat is replaced as a whole, there is nothing to continue */
+			position->inode = 0;
+			break;
+		}
+		if ((temp_ptr = strtok(input_buffer, "]")) != NULL) {
+			unsigned long temp_entry_time = strtoul(temp_ptr + 1, NULL, 10);
+			if (temp_entry_time > position->latest_entry_time) {
+				position->latest_entry_time = temp_entry_time;
+			}
+		}
+	}
+
+	int result = ferror(log_file) ? ERROR : OK;
+	fclose(log_file);
+	return result;
+}
+
+char *status_log_format_position(status_log_position position) {
+	char *result = NULL;
+	xasprintf(&result, "%llu %lld %lld %llx %lu", position.inode, position.offset,
+			  position.line_length, position.line_hash, position.latest_entry_time);
+	return result;
+}
+
+bool status_log_parse_position(const char *string, status_log_position *position) {
+	status_log_position parsed;
+	if (string == NULL ||
+		sscanf(string, "%llu %lld %lld %llx %lu", &parsed.inode, &parsed.offset,
+			   &parsed.line_length, &parsed.line_hash, &parsed.latest_entry_time) != 5) {
+		return false;
+	}
+	*position = parsed;
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+
+/* bump this when the format of the saved position changes */
+#define STATUS_LOG_STATE_VERSION 1
+
+/*
+ * Where the previous run stopped reading the status log. An inode of 0
+ * means there is no usable position and the log is read from the start.
+ */
+typedef struct {
+	unsigned long long inode;
+	long long offset; /* behind the last complete line that was read */
+	/* that line, to notice a file which was rewritten in place */
+	long long line_length;
+	unsigned long long line_hash;
+	unsigned long latest_entry_time;
+} status_log_position;
+
+/*
+ * Finds the time of the latest entry in the status log, either the
+ * "created=" value of a status.dat or the newest "[timestamp]" of a
+ * line based log. If *position belongs to the same file and the line
+ * before the offset is still there only the lines appended since are
+ * read, afterwards *position is where the next run can continue.
+ * Returns OK or ERROR if the log can not be read.
+ */
+int status_log_scan(const char *path, status_log_position *position);
+
+/* the position as saved in the state file and back */
+char *status_log_format_position(status_log_position position);
+bool status_log_parse_position(const char *string, status_log_position *position);
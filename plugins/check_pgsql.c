@@ -35,8 +35,10 @@
 #include "utils.h"
 #include "utils_cmd.h"
 #include "check_pgsql.d/config.h"
+#include "check_pgsql.d/stats.h"
 #include "thresholds.h"
 #include "netutils.h"
+#include "dbbroker.h"
 #include <libpq-fe.h>
 #include <pg_config_manual.h>
 
@@ -79,10 +81,33 @@ typedef enum {
 typedef struct {
 	do_query_errorcode error_code;
 	double numerical_result;
+	char *error_message;
 } do_query_wrapper;
 static do_query_wrapper do_query(PGconn * /*conn*/, char * /*query*/);
+static do_query_wrapper evaluate_reply(dbbroker_reply /*reply*/);
+static void add_connection_result(mp_check * /*overall*/, check_pgsql_config /*config*/,
+								  double /*elapsed_time*/, bool /*reused*/);
+static void add_query_result(mp_check * /*overall*/, check_pgsql_config /*config*/,
+							 do_query_wrapper /*query_result*/, double /*query_time*/);
+static void add_stats_results(mp_check * /*overall*/, check_pgsql_config /*config*/,
+							  PGconn * /*conn*/, int /*argc*/, char ** /*argv*/);
+static void add_stats_threshold(check_pgsql_config * /*config*/, char * /*arg*/);
+static void append_statement(char ** /*query*/, const char * /*statement*/);
 void print_usage(void);
 
+static void *broker_connect(const char * /*dsn*/, dbbroker_reply * /*reply*/);
+static bool broker_alive(void * /*connection*/);
+static dbbroker_reply broker_query(void * /*connection*/, const char * /*query*/);
+static void broker_close(void * /*connection*/);
+
+static const dbbroker_backend pgsql_backend = {
+	.name = "pgsql",
+	.connect = broker_connect,
+	.alive = broker_alive,
+	.query = broker_query,
+	.close = broker_close,
+};
+
 static int verbose = 0;
 
 /******************************************************************************
@@ -189,19 +214,47 @@ int main(int argc, char **argv) {
 		asprintf(&conninfo, "%s password = '%s'", conninfo, config.pgpasswd);
 	}
 
+	mp_check overall = mp_check_init();
+
+	mp_set_ok_summary(&overall, "Postgres check is OK");
+
+	/* the statistics need more than one value, they are not run through the broker */
+	if (config.broker_socket && !config.stats) {
+		dbbroker_reply reply =
+			dbbroker_request(config.broker_socket, &pgsql_backend, conninfo, config.pgquery);
+		if (reply.status == DBBROKER_CONNECT_FAILED) {
+			mp_subcheck sc_connection = mp_subcheck_init();
+			sc_connection = mp_set_subcheck_state(sc_connection, STATE_CRITICAL);
+			xasprintf(&sc_connection.output, "no connection to '%s' (%s)", config.dbName,
+					  reply.message);
+			mp_add_subcheck_to_check(&overall, sc_connection);
+			mp_exit(overall);
+		}
+
+		if (reply.status != DBBROKER_UNAVAILABLE) {
+			if (verbose) {
+				printf("Connection time: %f, query time: %f, %s connection\n",
+					   reply.connect_time, reply.query_time, reply.reused ? "reused" : "new");
+			}
+			add_connection_result(&overall, config, reply.connect_time, reply.reused);
+			if (config.pgquery) {
+				add_query_result(&overall, config, evaluate_reply(reply), reply.query_time);
+			}
+			mp_exit(overall);
+		}
+
+		/* the check still works without the broker */
+		if (verbose) {
+			printf("Connecting without the broker: %s\n", reply.message);
+		}
+		dbbroker_reply_free(&reply);
+	}
+
 	/* make a connection to the database */
 	struct timeval start_timeval;
 	gettimeofday(&start_timeval, NULL);
 	PGconn *conn = PQconnectdb(conninfo);
-	struct timeval end_timeval;
-	gettimeofday(&end_timeval, NULL);
-
-	while (start_timeval.tv_usec > end_timeval.tv_usec) {
-		--end_timeval.tv_sec;
-		end_timeval.tv_usec += 1000000;
-	}
-	double elapsed_time = (double)(end_timeval.tv_sec - start_timeval.tv_sec) +
-						  ((double)(end_timeval.tv_usec - start_timeval.tv_usec) / 1000000.0);
+	double elapsed_time = delta_time(start_timeval);
 
 	if (verbose) {
 		printf("Time elapsed: %f\n", elapsed_time);
@@ -212,24 +265,60 @@ int main(int argc, char **argv) {
 		printf("Verifying connection\n");
 	}
 
-	mp_check overall = mp_check_init();
-
-	mp_set_ok_summary(&overall, "Postgres check is OK");
-
-	mp_subcheck sc_connection = mp_subcheck_init();
-
 	if (PQstatus(conn) == CONNECTION_BAD) {
+		mp_subcheck sc_connection = mp_subcheck_init();
 		sc_connection = mp_set_subcheck_state(sc_connection, STATE_CRITICAL);
 		xasprintf(&sc_connection.output, "no connection to '%s' (%s)", config.dbName,
 				  PQerrorMessage(conn));
 		PQfinish(conn);
 		mp_add_subcheck_to_check(&overall, sc_connection);
 		mp_exit(overall);
+	}
+
+	add_connection_result(&overall, config, elapsed_time, false);
+
+	if (verbose) {
+		char *server_host = PQhost(conn);
+		int server_version = PQserverVersion(conn);
+
+		printf("Successfully connected to database %s (user %s) "
+			   "at server %s%s%s (server version: %d.%d.%d, "
+			   "protocol version: %d, pid: %d)\n",
+			   PQdb(conn), PQuser(conn), PSQL_SOCKET3(server_host, PQport(conn)),
+			   PSQL_SERVER_VERSION3(server_version), PQprotocolVersion(conn), PQbackendPID(conn));
+	}
+
+	if (config.pgquery) {
+		struct timeval query_timeval;
+		gettimeofday(&query_timeval, NULL);
+		do_query_wrapper query_result = do_query(conn, config.pgquery);
+		add_query_result(&overall, config, query_result, delta_time(query_timeval));
+	}
+
+	if (config.stats) {
+		add_stats_results(&overall, config, conn, argc, argv);
+	}
+
+	if (verbose) {
+		printf("Closing connection\n");
+	}
+	PQfinish(conn);
+
+	mp_exit(overall);
+}
+
+/* the connection subchecks, elapsed_time is 0 for a connection kept by the broker */
+static void add_connection_result(mp_check *overall, check_pgsql_config config,
+								  double elapsed_time, bool reused) {
+	mp_subcheck sc_connection = mp_subcheck_init();
+	sc_connection = mp_set_subcheck_state(sc_connection, STATE_OK);
+	if (reused) {
+		xasprintf(&sc_connection.output, "connected to '%s' (connection kept by the broker)",
+				  config.dbName);
 	} else {
-		sc_connection = mp_set_subcheck_state(sc_connection, STATE_OK);
 		xasprintf(&sc_connection.output, "connected to '%s'", config.dbName);
-		mp_add_subcheck_to_check(&overall, sc_connection);
 	}
+	mp_add_subcheck_to_check(overall, sc_connection);
 
 	mp_subcheck sc_connection_time = mp_subcheck_init();
 	sc_connection_time = mp_set_subcheck_default_state(sc_connection_time, STATE_UNKNOWN);
@@ -246,90 +335,483 @@ int main(int argc, char **argv) {
 	sc_connection_time =
 		mp_set_subcheck_state(sc_connection_time, mp_get_pd_status(pd_connection_time));
 
-	mp_add_subcheck_to_check(&overall, sc_connection_time);
-
-	if (verbose) {
-		char *server_host = PQhost(conn);
-		int server_version = PQserverVersion(conn);
+	mp_add_subcheck_to_check(overall, sc_connection_time);
+}
 
-		printf("Successfully connected to database %s (user %s) "
-			   "at server %s%s%s (server version: %d.%d.%d, "
-			   "protocol version: %d, pid: %d)\n",
-			   PQdb(conn), PQuser(conn), PSQL_SOCKET3(server_host, PQport(conn)),
-			   PSQL_SERVER_VERSION3(server_version), PQprotocolVersion(conn), PQbackendPID(conn));
+static void add_query_result(mp_check *overall, check_pgsql_config config,
+							 do_query_wrapper query_result, double query_time) {
+	mp_subcheck sc_query = mp_subcheck_init();
+	sc_query = mp_set_subcheck_default_state(sc_query, STATE_UNKNOWN);
+	if (config.pgqueryname) {
+		xasprintf(&sc_query.output, "query '%s'", config.pgqueryname);
+	} else {
+		xasprintf(&sc_query.output, "query '%s'", config.pgquery);
 	}
 
-	if (config.pgquery) {
-		mp_subcheck sc_query = mp_subcheck_init();
-		sc_query = mp_set_subcheck_default_state(sc_query, STATE_UNKNOWN);
-		if (config.pgqueryname) {
-			xasprintf(&sc_query.output, "query '%s'", config.pgqueryname);
+	/* the query time is reported apart from the connection time */
+	mp_perfdata pd_query_time = perfdata_init();
+	pd_query_time.label = "query_time";
+	pd_query_time.uom = "s";
+	pd_query_time = mp_set_pd_value(pd_query_time, query_time);
+	mp_add_perfdata_to_subcheck(&sc_query, pd_query_time);
+
+	switch (query_result.error_code) {
+	case QUERY_OK: {
+		// Query was successful and there is a numerical result
+		sc_query = mp_set_subcheck_state(sc_query, STATE_OK);
+		xasprintf(&sc_query.output, "%s succeeded", sc_query.output);
+
+		mp_perfdata pd_query = perfdata_init();
+		pd_query = mp_set_pd_value(pd_query, query_result.numerical_result);
+		pd_query = mp_pd_set_thresholds(pd_query, config.qthresholds);
+		pd_query.label = "query";
+
+		mp_subcheck sc_query_compare = mp_subcheck_init();
+		mp_state_enum query_compare_state = mp_get_pd_status(pd_query);
+
+		sc_query_compare = mp_set_subcheck_state(sc_query_compare, query_compare_state);
+		mp_add_perfdata_to_subcheck(&sc_query_compare, pd_query);
+
+		if (query_compare_state == STATE_OK) {
+			xasprintf(&sc_query_compare.output, "query result '%f' is within thresholds",
+					  query_result.numerical_result);
 		} else {
-			xasprintf(&sc_query.output, "query '%s'", config.pgquery);
+			xasprintf(&sc_query_compare.output, "query result '%f' is violating thresholds",
+					  query_result.numerical_result);
 		}
+		mp_add_subcheck_to_check(overall, sc_query_compare);
+
+	} break;
+	case ERROR_WITH_QUERY:
+		xasprintf(&sc_query.output, "%s - Error with query: %s", sc_query.output,
+				  query_result.error_message ? query_result.error_message : "");
+		sc_query = mp_set_subcheck_state(sc_query, STATE_CRITICAL);
+		break;
+	case NO_ROWS_RETURNED:
+		xasprintf(&sc_query.output, "%s - no rows were returned by the query", sc_query.output);
+		sc_query = mp_set_subcheck_state(sc_query, STATE_WARNING);
+		break;
+	case NO_COLUMNS_RETURNED:
+		xasprintf(&sc_query.output, "%s - no columns were returned by the query", sc_query.output);
+		sc_query = mp_set_subcheck_state(sc_query, STATE_WARNING);
+		break;
+	case NO_DATA_RETURNED:
+		xasprintf(&sc_query.output, "%s - no data was returned by the query", sc_query.output);
+		sc_query = mp_set_subcheck_state(sc_query, STATE_WARNING);
+		break;
+	case RESULT_IS_NOT_NUMERIC:
+		xasprintf(&sc_query.output, "%s - result of the query is not numeric", sc_query.output);
+		sc_query = mp_set_subcheck_state(sc_query, STATE_CRITICAL);
+		break;
+	};
 
-		do_query_wrapper query_result = do_query(conn, config.pgquery);
+	mp_add_subcheck_to_check(overall, sc_query);
+}
 
-		switch (query_result.error_code) {
-		case QUERY_OK: {
-			// Query was successful and there is a numerical result
-			sc_query = mp_set_subcheck_state(sc_query, STATE_OK);
-			xasprintf(&sc_query.output, "%s succeeded", sc_query.output);
+/* the metrics of the built-in statistics which take thresholds */
+static const char *stats_metrics[] = {
+	"replicas",
+	"lag",
+	"lag_bytes",
+	"backends",
+	"size",
+	"commit_rate",
+	"rollback_rate",
+	"deadlock_rate",
+	"hit_ratio",
+	"temp_bytes_rate",
+	"checkpoints_timed_rate",
+	"checkpoints_req_rate",
+	"buffers_checkpoint_rate",
+	"buffers_clean_rate",
+	"maxwritten_clean_rate",
+	"buffers_backend_rate",
+	"buffers_alloc_rate",
+};
+
+/* the columns of pg_stat_bgwriter in the order of the queries below */
+static const char *bgwriter_counters[] = {
+	"checkpoints_timed", "checkpoints_req", "buffers_checkpoint", "buffers_clean",
+	"maxwritten_clean",  "buffers_backend", "buffers_alloc",
+};
+#define LENGTH_BGWRITER_COUNTERS (sizeof(bgwriter_counters) / sizeof(bgwriter_counters[0]))
+
+static mp_thresholds get_stats_thresholds(check_pgsql_config config, const char *metric) {
+	mp_thresholds result = mp_thresholds_init();
+	for (size_t i = 0; i < config.stats_thresholds_num; i++) {
+		if (strcmp(config.stats_thresholds[i].metric, metric) == 0) {
+			result = config.stats_thresholds[i].thresholds;
+		}
+	}
+	return result;
+}
 
-			mp_perfdata pd_query = perfdata_init();
-			pd_query = mp_set_pd_value(pd_query, query_result.numerical_result);
-			pd_query = mp_pd_set_thresholds(pd_query, config.qthresholds);
-			pd_query.label = "query";
+/* adds the perfdata "<prefix>_<metric>" and returns its state */
+static mp_state_enum add_stats_perfdata(mp_subcheck *subcheck, check_pgsql_config config,
+										const char *prefix, const char *metric, double value,
+										char *uom) {
+	mp_perfdata pd_stat = perfdata_init();
+	if (prefix != NULL) {
+		xasprintf(&pd_stat.label, "%s_%s", prefix, metric);
+	} else {
+		pd_stat.label = (char *)metric;
+	}
+	pd_stat.uom = uom;
+	pd_stat = mp_set_pd_value(pd_stat, value);
+	pd_stat = mp_set_pd_min_value(pd_stat, mp_create_pd_value(0));
+	pd_stat = mp_pd_set_thresholds(pd_stat, get_stats_thresholds(config, metric));
+	mp_add_perfdata_to_subcheck(subcheck, pd_stat);
+	return mp_get_pd_status(pd_stat);
+}
+
+static mp_subcheck evaluate_replication(check_pgsql_config config, PGresult *res) {
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+	int replicas = PQntuples(res);
+	xasprintf(&result.output, "replication: %d replica(s)", replicas);
+
+	mp_subcheck sc_replicas = mp_subcheck_init();
+	mp_state_enum replicas_state =
+		add_stats_perfdata(&sc_replicas, config, NULL, "replicas", replicas, NULL);
+	sc_replicas = mp_set_subcheck_state(sc_replicas, replicas_state);
+	xasprintf(&sc_replicas.output, "%d replica(s) connected", replicas);
+	mp_add_subcheck_to_subcheck(&result, sc_replicas);
+
+	for (int row = 0; row < replicas; row++) {
+		const char *name = PQgetvalue(res, row, 0);
+		const char *state = PQgetisnull(res, row, 1) ? "unknown" : PQgetvalue(res, row, 1);
+		/* the lag is NULL while the replica has nothing to replay */
+		double lag = PQgetisnull(res, row, 2) ? 0 : strtod(PQgetvalue(res, row, 2), NULL);
+		double lag_bytes = PQgetisnull(res, row, 3) ? 0 : strtod(PQgetvalue(res, row, 3), NULL);
+
+		mp_subcheck sc_replica = mp_subcheck_init();
+		mp_state_enum replica_state = strcmp(state, "streaming") == 0 ? STATE_OK : STATE_WARNING;
+		replica_state = max_state_alt(
+			replica_state, add_stats_perfdata(&sc_replica, config, name, "lag", lag, "s"));
+		replica_state = max_state_alt(
+			replica_state,
+			add_stats_perfdata(&sc_replica, config, name, "lag_bytes", lag_bytes, "B"));
+		sc_replica = mp_set_subcheck_state(sc_replica, replica_state);
+		xasprintf(&sc_replica.output, "replica '%s' is %s, %.3fs / %.0f bytes behind", name, state,
+				  lag, lag_bytes);
+		mp_add_subcheck_to_subcheck(&result, sc_replica);
+	}
+	return result;
+}
 
-			mp_subcheck sc_query_compare = mp_subcheck_init();
-			mp_state_enum query_compare_state = mp_get_pd_status(pd_query);
+static mp_subcheck evaluate_databases(check_pgsql_config config, PGresult *res,
+									  pgsql_counter_list *previous, double elapsed,
+									  pgsql_counter_list *current) {
+	/* the cumulative columns of the query below, starting at the third */
+	static const char *counters[] = {
+		"xact_commit", "xact_rollback", "blks_read", "blks_hit", "deadlocks", "temp_bytes",
+	};
+	enum {
+		COUNTER_COMMIT,
+		COUNTER_ROLLBACK,
+		COUNTER_BLKS_READ,
+		COUNTER_BLKS_HIT,
+		COUNTER_DEADLOCKS,
+		COUNTER_TEMP_BYTES,
+		LENGTH_COUNTERS,
+	};
 
-			sc_query_compare = mp_set_subcheck_state(sc_query_compare, query_compare_state);
-			mp_add_perfdata_to_subcheck(&sc_query_compare, pd_query);
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+	xasprintf(&result.output, "databases: %d", PQntuples(res));
+
+	for (int row = 0; row < PQntuples(res); row++) {
+		const char *datname = PQgetvalue(res, row, 0);
+		int backends = atoi(PQgetvalue(res, row, 1));
+
+		mp_subcheck sc_database = mp_subcheck_init();
+		mp_state_enum database_state =
+			add_stats_perfdata(&sc_database, config, datname, "backends", backends, NULL);
+		xasprintf(&sc_database.output, "database '%s': %d backend(s)", datname, backends);
+
+		/* the size is NULL for databases the user may not connect to */
+		if (!PQgetisnull(res, row, 8)) {
+			double size = strtod(PQgetvalue(res, row, 8), NULL);
+			database_state = max_state_alt(
+				database_state,
+				add_stats_perfdata(&sc_database, config, datname, "size", size, "B"));
+		}
 
-			if (query_compare_state == STATE_OK) {
-				xasprintf(&sc_query_compare.output, "query result '%f' is within thresholds",
-						  query_result.numerical_result);
-			} else {
-				xasprintf(&sc_query_compare.output, "query result '%f' is violating thresholds",
-						  query_result.numerical_result);
+		long long deltas[LENGTH_COUNTERS];
+		bool has_delta[LENGTH_COUNTERS];
+		for (int i = 0; i < LENGTH_COUNTERS; i++) {
+			long long value = strtoll(PQgetvalue(res, row, i + 2), NULL, 10);
+			char *name = NULL;
+			xasprintf(&name, "database %s %s", datname, counters[i]);
+			pgsql_counters_add(current, name, value);
+			has_delta[i] = elapsed > 0 && pgsql_counter_delta(previous, name, value, &deltas[i]);
+			free(name);
+		}
+
+		static const struct {
+			int counter;
+			const char *metric;
+			const char *description;
+		} rates[] = {
+			{COUNTER_COMMIT, "commit_rate", "commits"},
+			{COUNTER_ROLLBACK, "rollback_rate", "rollbacks"},
+			{COUNTER_DEADLOCKS, "deadlock_rate", "deadlocks"},
+			{COUNTER_TEMP_BYTES, "temp_bytes_rate", "temporary bytes"},
+		};
+		for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+			if (!has_delta[rates[i].counter]) {
+				continue;
 			}
-			mp_add_subcheck_to_check(&overall, sc_query_compare);
+			double rate = (double)deltas[rates[i].counter] / elapsed;
+			database_state = max_state_alt(database_state,
+										   add_stats_perfdata(&sc_database, config, datname,
+															  rates[i].metric, rate, NULL));
+			xasprintf(&sc_database.output, "%s, %.2f %s/s", sc_database.output, rate,
+					  rates[i].description);
+		}
 
-		} break;
-		case ERROR_WITH_QUERY:
-			xasprintf(&sc_query.output, "%s - Error with query: %s", sc_query.output,
-					  PQerrorMessage(conn));
-			sc_query = mp_set_subcheck_state(sc_query, STATE_CRITICAL);
-			break;
-		case NO_ROWS_RETURNED:
-			xasprintf(&sc_query.output, "%s - no rows were returned by the query", sc_query.output);
-			sc_query = mp_set_subcheck_state(sc_query, STATE_WARNING);
-			break;
-		case NO_COLUMNS_RETURNED:
-			xasprintf(&sc_query.output, "%s - no columns were returned by the query",
-					  sc_query.output);
-			sc_query = mp_set_subcheck_state(sc_query, STATE_WARNING);
+		/* the share of the blocks read since the last check which were in the buffer cache */
+		if (has_delta[COUNTER_BLKS_READ] && has_delta[COUNTER_BLKS_HIT] &&
+			deltas[COUNTER_BLKS_READ] + deltas[COUNTER_BLKS_HIT] > 0) {
+			double hit_ratio = 100.0 * (double)deltas[COUNTER_BLKS_HIT] /
+							   (double)(deltas[COUNTER_BLKS_READ] + deltas[COUNTER_BLKS_HIT]);
+			database_state = max_state_alt(database_state,
+										   add_stats_perfdata(&sc_database, config, datname,
+															  "hit_ratio", hit_ratio, "%"));
+			xasprintf(&sc_database.output, "%s, %.1f%% cache hits", sc_database.output,
+					  hit_ratio);
+		}
+
+		sc_database = mp_set_subcheck_state(sc_database, database_state);
+		mp_add_subcheck_to_subcheck(&result, sc_database);
+	}
+	return result;
+}
+
+static mp_subcheck evaluate_bgwriter(check_pgsql_config config, PGresult *res,
+									 pgsql_counter_list *previous, double elapsed,
+									 pgsql_counter_list *current) {
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+	if (PQntuples(res) != 1) {
+		result = mp_set_subcheck_state(result, STATE_UNKNOWN);
+		xasprintf(&result.output, "bgwriter: no statistics returned");
+		return result;
+	}
+
+	mp_state_enum bgwriter_state = STATE_OK;
+	bool has_rates = false;
+	for (size_t i = 0; i < LENGTH_BGWRITER_COUNTERS; i++) {
+		/* buffers_backend is gone from PostgreSQL 17 on */
+		if (PQgetisnull(res, 0, (int)i)) {
+			continue;
+		}
+		long long value = strtoll(PQgetvalue(res, 0, (int)i), NULL, 10);
+		char *name = NULL;
+		xasprintf(&name, "bgwriter %s", bgwriter_counters[i]);
+		pgsql_counters_add(current, name, value);
+
+		double rate;
+		if (pgsql_counter_rate(previous, name, value, elapsed, &rate)) {
+			char *metric = NULL;
+			xasprintf(&metric, "%s_rate", bgwriter_counters[i]);
+			bgwriter_state = max_state_alt(
+				bgwriter_state, add_stats_perfdata(&result, config, NULL, metric, rate, NULL));
+			has_rates = true;
+		}
+		free(name);
+	}
+
+	result = mp_set_subcheck_state(result, bgwriter_state);
+	if (has_rates) {
+		xasprintf(&result.output, "bgwriter: rates over %.0f seconds", elapsed);
+	} else {
+		xasprintf(&result.output,
+				  "bgwriter: no previous sample, rates are available from the next run on");
+	}
+	return result;
+}
+
+/*
+ * Runs the queries of all selected statistics in one round trip and adds
+ * a subcheck for each. The counters are kept in the state file to compute
+ * the rates since the previous check.
+ */
+static void add_stats_results(mp_check *overall, check_pgsql_config config, PGconn *conn,
+							  int argc, char **argv) {
+	pgsql_stats_set sets[3];
+	size_t sets_num = 0;
+	char *query = NULL;
+
+	if (config.stats & PGSQL_STATS_REPLICATION) {
+		sets[sets_num++] = PGSQL_STATS_REPLICATION;
+		append_statement(
+			&query,
+			"SELECT COALESCE(NULLIF(application_name, ''), host(client_addr), pid::text), "
+			"state, EXTRACT(EPOCH FROM replay_lag), "
+			"pg_wal_lsn_diff(CASE WHEN pg_is_in_recovery() THEN pg_last_wal_receive_lsn() "
+			"ELSE pg_current_wal_lsn() END, replay_lsn) "
+			"FROM pg_stat_replication ORDER BY 1");
+	}
+	if (config.stats & PGSQL_STATS_DATABASE) {
+		sets[sets_num++] = PGSQL_STATS_DATABASE;
+		append_statement(&query,
+						 "SELECT datname, numbackends, xact_commit, xact_rollback, blks_read, "
+						 "blks_hit, deadlocks, temp_bytes, "
+						 "CASE WHEN has_database_privilege(datid, 'CONNECT') "
+						 "THEN pg_database_size(datid) END "
+						 "FROM pg_stat_database WHERE datname IS NOT NULL ORDER BY datname");
+	}
+	if (config.stats & PGSQL_STATS_BGWRITER) {
+		sets[sets_num++] = PGSQL_STATS_BGWRITER;
+		/* the checkpoint counters moved to pg_stat_checkpointer in PostgreSQL 17 */
+		if (PQserverVersion(conn) < 170000) {
+			append_statement(&query,
+							 "SELECT checkpoints_timed, checkpoints_req, buffers_checkpoint, "
+							 "buffers_clean, maxwritten_clean, buffers_backend, buffers_alloc "
+							 "FROM pg_stat_bgwriter");
+		} else {
+			append_statement(&query,
+							 "SELECT c.num_timed, c.num_requested, c.buffers_written, "
+							 "b.buffers_clean, b.maxwritten_clean, NULL, b.buffers_alloc "
+							 "FROM pg_stat_bgwriter b, pg_stat_checkpointer c");
+		}
+	}
+
+	if (verbose) {
+		printf("Statistics query: %s\n", query);
+	}
+
+	time_t now = time(NULL);
+	state_key key = np_enable_state(NULL, PGSQL_STATS_STATE_VERSION, progname, argc, argv);
+	state_data *previous_state = np_state_read(key);
+	pgsql_counter_list previous = {0};
+	double elapsed = 0;
+	/* there is no state data on the first run */
+	if (previous_state != NULL && previous_state->errorcode == OK) {
+		previous = pgsql_counters_parse(previous_state->data);
+		elapsed = (double)(now - previous_state->time);
+	}
+	pgsql_counter_list current = {0};
+
+	mp_subcheck sc_stats = mp_subcheck_init();
+	sc_stats = mp_set_subcheck_default_state(sc_stats, STATE_OK);
+	xasprintf(&sc_stats.output, "statistics");
+
+	if (PQsendQuery(conn, query) == 0) {
+		sc_stats = mp_set_subcheck_state(sc_stats, STATE_CRITICAL);
+		xasprintf(&sc_stats.output, "statistics query failed: %s", PQerrorMessage(conn));
+		mp_add_subcheck_to_check(overall, sc_stats);
+		return;
+	}
+
+	/* one result per statement, the server stops at the first error */
+	size_t set = 0;
+	bool failed = false;
+	for (PGresult *res = PQgetResult(conn); res != NULL; res = PQgetResult(conn)) {
+		if (failed || set >= sets_num) {
+			PQclear(res);
+			continue;
+		}
+		if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+			mp_subcheck sc_error = mp_subcheck_init();
+			sc_error = mp_set_subcheck_state(sc_error, STATE_CRITICAL);
+			xasprintf(&sc_error.output, "statistics query failed: %s",
+					  PQresultErrorMessage(res));
+			mp_add_subcheck_to_subcheck(&sc_stats, sc_error);
+			failed = true;
+			PQclear(res);
+			continue;
+		}
+
+		switch (sets[set++]) {
+		case PGSQL_STATS_REPLICATION:
+			mp_add_subcheck_to_subcheck(&sc_stats, evaluate_replication(config, res));
 			break;
-		case NO_DATA_RETURNED:
-			xasprintf(&sc_query.output, "%s - no data was returned by the query", sc_query.output);
-			sc_query = mp_set_subcheck_state(sc_query, STATE_WARNING);
+		case PGSQL_STATS_DATABASE:
+			mp_add_subcheck_to_subcheck(
+				&sc_stats, evaluate_databases(config, res, &previous, elapsed, &current));
 			break;
-		case RESULT_IS_NOT_NUMERIC:
-			xasprintf(&sc_query.output, "%s - result of the query is not numeric", sc_query.output);
-			sc_query = mp_set_subcheck_state(sc_query, STATE_CRITICAL);
+		case PGSQL_STATS_BGWRITER:
+			mp_add_subcheck_to_subcheck(
+				&sc_stats, evaluate_bgwriter(config, res, &previous, elapsed, &current));
 			break;
-		};
+		}
+		PQclear(res);
+	}
 
-		mp_add_subcheck_to_check(&overall, sc_query);
+	/* a failed query keeps the previous sample for the next check */
+	if (!failed) {
+		char *state_string = pgsql_counters_format(&current);
+		np_state_write_string(key, now, state_string);
+		free(state_string);
 	}
+	pgsql_counters_free(&previous);
+	pgsql_counters_free(&current);
+	free(query);
 
-	if (verbose) {
-		printf("Closing connection\n");
+	mp_add_subcheck_to_check(overall, sc_stats);
+}
+
+/* the statements of the statistics are sent as one query string */
+static void append_statement(char **query, const char *statement) {
+	char *joined;
+	xasprintf(&joined, "%s%s%s", *query ? *query : "", *query ? "; " : "", statement);
+	free(*query);
+	*query = joined;
+}
+
+/* "METRIC,WARN,CRIT", either threshold may be empty */
+static void add_stats_threshold(check_pgsql_config *config, char *arg) {
+	char *metric = arg;
+	char *warning = strchr(metric, ',');
+	char *critical = NULL;
+	if (warning != NULL) {
+		*warning++ = '\0';
+		critical = strchr(warning, ',');
+		if (critical != NULL) {
+			*critical++ = '\0';
+		}
 	}
-	PQfinish(conn);
 
-	mp_exit(overall);
+	bool known = false;
+	for (size_t i = 0; i < sizeof(stats_metrics) / sizeof(stats_metrics[0]); i++) {
+		if (strcmp(metric, stats_metrics[i]) == 0) {
+			known = true;
+		}
+	}
+	if (!known) {
+		die(STATE_UNKNOWN, _("There is no statistics metric %s\n"), metric);
+	}
+
+	check_pgsql_stats_threshold entry = {
+		.metric = metric,
+		.thresholds = mp_thresholds_init(),
+	};
+	if (warning != NULL && *warning != '\0') {
+		mp_range_parsed tmp = mp_parse_range_string(warning);
+		if (tmp.error != MP_PARSING_SUCCESS) {
+			die(STATE_UNKNOWN, _("failed to parse statistics warning threshold: %s\n"), warning);
+		}
+		entry.thresholds = mp_thresholds_set_warn(entry.thresholds, tmp.range);
+	}
+	if (critical != NULL && *critical != '\0') {
+		mp_range_parsed tmp = mp_parse_range_string(critical);
+		if (tmp.error != MP_PARSING_SUCCESS) {
+			die(STATE_UNKNOWN, _("failed to parse statistics critical threshold: %s\n"),
+				critical);
+		}
+		entry.thresholds = mp_thresholds_set_crit(entry.thresholds, tmp.range);
+	}
+
+	check_pgsql_stats_threshold *entries =
+		realloc(config->stats_thresholds,
+				(config->stats_thresholds_num + 1) * sizeof(check_pgsql_stats_threshold));
+	if (entries == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the statistics thresholds\n"));
+	}
+	entries[config->stats_thresholds_num++] = entry;
+	config->stats_thresholds = entries;
 }
 
 /* process command-line arguments */
@@ -338,6 +820,9 @@ static check_pgsql_config_wrapper process_arguments(int argc, char **argv) {
 	enum {
 		OPTID_QUERYNAME = CHAR_MAX + 1,
 		output_format_index,
+		OPTID_BROKER,
+		OPTID_STATS,
+		OPTID_STATS_THRESHOLD,
 	};
 
 	static struct option longopts[] = {{"help", no_argument, 0, 'h'},
@@ -358,6 +843,10 @@ static check_pgsql_config_wrapper process_arguments(int argc, char **argv) {
 									   {"query_warning", required_argument, 0, 'W'},
 									   {"verbose", no_argument, 0, 'v'},
 									   {"output-format", required_argument, 0, output_format_index},
+									   {"broker", required_argument, 0, OPTID_BROKER},
+									   {"stats", required_argument, 0, OPTID_STATS},
+									   {"stats-threshold", required_argument, 0,
+										OPTID_STATS_THRESHOLD},
 									   {0, 0, 0, 0}};
 
 	check_pgsql_config_wrapper result = {
@@ -479,6 +968,19 @@ static check_pgsql_config_wrapper process_arguments(int argc, char **argv) {
 		case OPTID_QUERYNAME:
 			result.config.pgqueryname = optarg;
 			break;
+		case OPTID_BROKER:
+			result.config.broker_socket = optarg;
+			break;
+		case OPTID_STATS:
+			result.config.stats = pgsql_stats_parse_sets(optarg);
+			if (result.config.stats == 0) {
+				usage2(_("Statistics must be a list of replication, database and bgwriter"),
+					   optarg);
+			}
+			break;
+		case OPTID_STATS_THRESHOLD:
+			add_stats_threshold(&result.config, optarg);
+			break;
 		case 'v':
 			verbose++;
 			break;
@@ -571,6 +1073,24 @@ void print_help(void) {
 	printf(" %s\n", "-C, --query_critical=RANGE");
 	printf("    %s\n", _("SQL query value to result in critical status (double)"));
 
+	printf(" %s\n", "--broker=PATH");
+	printf("    %s\n", _("Run the query through a connection broker on the Unix socket PATH,"));
+	printf("    %s\n", _("which keeps the connection open for the next check. The broker is"));
+	printf("    %s\n", _("started if none is running and exits after some minutes without"));
+	printf("    %s\n", _("checks. The directory of PATH must not be writable by other users"));
+
+	printf(" %s\n", "--stats=LIST");
+	printf("    %s\n", _("Report the built-in statistics, a comma separated list of replication"));
+	printf("    %s\n", _("(pg_stat_replication), database (pg_stat_database) and bgwriter"));
+	printf("    %s\n", _("(pg_stat_bgwriter). All of them are fetched in one round trip, the"));
+	printf("    %s\n", _("rates of the counters are computed from the previous check. The"));
+	printf("    %s\n", _("statistics always use a connection of their own, not the broker"));
+	printf(" %s\n", "--stats-threshold=METRIC,WARN,CRIT");
+	printf("    %s\n", _("Thresholds on a metric of every replica or database, one of replicas,"));
+	printf("    %s\n", _("lag, lag_bytes, backends, size, commit_rate, rollback_rate,"));
+	printf("    %s\n", _("deadlock_rate, hit_ratio, temp_bytes_rate or <bgwriter counter>_rate"));
+	printf("    %s\n", _("Either threshold may be empty, e.g. --stats-threshold=lag,,60"));
+
 	printf(UT_VERBOSE);
 	printf(UT_OUTPUT_FORMAT);
 
@@ -626,49 +1146,45 @@ void print_usage(void) {
 	printf("%s\n", _("Usage:"));
 	printf("%s [-H <host>] [-P <port>] [-c <critical time>] [-w <warning time>]\n", progname);
 	printf(" [-t <timeout>] [-d <database>] [-l <logname>] [-p <password>]\n"
-		   "[-q <query>] [-C <critical query range>] [-W <warning query range>]\n");
+		   "[-q <query>] [-C <critical query range>] [-W <warning query range>]\n"
+		   "[--broker=<socket>] [--stats=<list>] [--stats-threshold=<metric,warn,crit>]\n");
 }
 
 static do_query_wrapper do_query(PGconn *conn, char *query) {
-	if (verbose) {
-		printf("Executing SQL query \"%s\".\n", query);
-	}
-	PGresult *res = PQexec(conn, query);
+	return evaluate_reply(broker_query(conn, query));
+}
 
+/* the result of a query, run here or by the broker */
+static do_query_wrapper evaluate_reply(dbbroker_reply reply) {
 	do_query_wrapper result = {
 		.error_code = QUERY_OK,
+		.error_message = reply.message,
 	};
 
-	if (PGRES_TUPLES_OK != PQresultStatus(res)) {
-		// TODO
-		// printf(_("QUERY %s - %s: %s.\n"), _("CRITICAL"), _("Error with query"),
-		// PQerrorMessage(conn));
-		result.error_code = ERROR_WITH_QUERY;
-		return result;
-	}
-
-	if (PQntuples(res) < 1) {
+	switch (reply.status) {
+	case DBBROKER_OK:
+		break;
+	case DBBROKER_NO_ROWS:
 		// TODO
 		// printf("QUERY %s - %s.\n", _("WARNING"), _("No rows returned"));
 		result.error_code = NO_ROWS_RETURNED;
 		return result;
-	}
-
-	if (PQnfields(res) < 1) {
+	case DBBROKER_NO_COLUMNS:
 		// TODO
 		// printf("QUERY %s - %s.\n", _("WARNING"), _("No columns returned"));
 		result.error_code = NO_COLUMNS_RETURNED;
 		return result;
-	}
-
-	char *val_str = PQgetvalue(res, 0, 0);
-	if (!val_str) {
+	case DBBROKER_NO_DATA:
 		// TODO
 		// printf("QUERY %s - %s.\n", _("CRITICAL"), _("No data returned"));
 		result.error_code = NO_DATA_RETURNED;
 		return result;
+	default:
+		result.error_code = ERROR_WITH_QUERY;
+		return result;
 	}
 
+	char *val_str = reply.value != NULL ? reply.value : "";
 	char *endptr = NULL;
 	double value = strtod(val_str, &endptr);
 	if (verbose) {
@@ -692,3 +1208,59 @@ static do_query_wrapper do_query(PGconn *conn, char *query) {
 
 	return result;
 }
+
+static void *broker_connect(const char *dsn, dbbroker_reply *reply) {
+	/* later keywords win, a connect_timeout of the user is kept */
+	char *conninfo;
+	xasprintf(&conninfo, "connect_timeout = %d %s", DBBROKER_CONNECT_TIMEOUT, dsn);
+	PGconn *conn = PQconnectdb(conninfo);
+	free(conninfo);
+	if (PQstatus(conn) != CONNECTION_OK) {
+		reply->message = strdup(PQerrorMessage(conn));
+		PQfinish(conn);
+		return NULL;
+	}
+	return conn;
+}
+
+static bool broker_alive(void *connection) {
+	/* an empty query is one round trip to the backend */
+	PGresult *res = PQexec(connection, "");
+	bool result = PQresultStatus(res) == PGRES_EMPTY_QUERY;
+	PQclear(res);
+	return result && PQstatus(connection) == CONNECTION_OK;
+}
+
+static dbbroker_reply broker_query(void *connection, const char *query) {
+	PGconn *conn = connection;
+	if (verbose) {
+		printf("Executing SQL query \"%s\".\n", query);
+	}
+	PGresult *res = PQexec(conn, query);
+
+	dbbroker_reply result = {
+		.status = DBBROKER_OK,
+	};
+
+	if (PGRES_TUPLES_OK != PQresultStatus(res)) {
+		result.status = DBBROKER_QUERY_FAILED;
+		result.message = strdup(PQerrorMessage(conn));
+	} else if (PQntuples(res) < 1) {
+		result.status = DBBROKER_NO_ROWS;
+	} else if (PQnfields(res) < 1) {
+		result.status = DBBROKER_NO_COLUMNS;
+	} else if (PQgetvalue(res, 0, 0) == NULL) {
+		result.status = DBBROKER_NO_DATA;
+	} else {
+		result.value = strdup(PQgetvalue(res, 0, 0));
+	}
+	PQclear(res);
+
+	/* a kept connection must not stay in a transaction the query opened */
+	if (PQtransactionStatus(conn) != PQTRANS_IDLE) {
+		PQclear(PQexec(conn, "ROLLBACK"));
+	}
+	return result;
+}
+
+static void broker_close(void *connection) { PQfinish(connection); }
@@ -9,6 +9,12 @@
 
 #define DEFAULT_DB "template1"
 
+/* thresholds on one metric of the built-in statistics, e.g. lag or commit_rate */
+typedef struct {
+	const char *metric;
+	mp_thresholds thresholds;
+} check_pgsql_stats_threshold;
+
 enum {
 	DEFAULT_WARN = 2,
 	DEFAULT_CRIT = 8,
@@ -25,6 +31,11 @@ typedef struct {
 	char *pgparams;
 	char *pgquery;
 	char *pgqueryname;
+	char *broker_socket; /* the connection broker, see dbbroker.h */
+
+	unsigned int stats; /* the built-in metric sets, see stats.h */
+	check_pgsql_stats_threshold *stats_thresholds;
+	size_t stats_thresholds_num;
 
 	mp_thresholds time_thresholds;
 	mp_thresholds qthresholds;
@@ -52,6 +63,11 @@ check_pgsql_config check_pgsql_config_init() {
 		.pgparams = NULL,
 		.pgquery = NULL,
 		.pgqueryname = NULL,
+		.broker_socket = NULL,
+
+		.stats = 0,
+		.stats_thresholds = NULL,
+		.stats_thresholds_num = 0,
 
 		.time_thresholds = mp_thresholds_init(),
 		.qthresholds = mp_thresholds_init(),
@@ -0,0 +1,178 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./stats.h"
+
+#include <string.h>
+
+unsigned int pgsql_stats_parse_sets(const char *list) {
+	unsigned int result = 0;
+	char *copy = strdup(list);
+	char *saveptr = NULL;
+	for (char *set = strtok_r(copy, ",", &saveptr); set != NULL;
+		 set = strtok_r(NULL, ",", &saveptr)) {
+		if (strcmp(set, "replication") == 0) {
+			result |= PGSQL_STATS_REPLICATION;
+		} else if (strcmp(set, "database") == 0) {
+			result |= PGSQL_STATS_DATABASE;
+		} else if (strcmp(set, "bgwriter") == 0) {
+			result |= PGSQL_STATS_BGWRITER;
+		} else {
+			result = 0;
+			break;
+		}
+	}
+	free(copy);
+	return result;
+}
+
+void pgsql_counters_add(pgsql_counter_list *list, const char *name, long long value) {
+	if (list->count == list->capacity) {
+		size_t capacity = list->capacity == 0 ? 32 : list->capacity * 2;
+		pgsql_counter *counters = realloc(list->counters, capacity * sizeof(pgsql_counter));
+		if (counters == NULL) {
+			die(STATE_UNKNOWN, _("Could not allocate memory for the statistics\n"));
+		}
+		list->counters = counters;
+		list->capacity = capacity;
+	}
+	list->counters[list->count].name = strdup(name);
+	list->counters[list->count].value = value;
+	list->count++;
+	list->sorted = false;
+}
+
+void pgsql_counters_free(pgsql_counter_list *list) {
+	for (size_t i = 0; i < list->count; i++) {
+		free(list->counters[i].name);
+	}
+	free(list->counters);
+	*list = (pgsql_counter_list){0};
+}
+
+static bool pgsql_counter_escaped(char character) {
+	return character == '%' || character == ';' || character == '=' ||
+		   (unsigned char)character < 0x20;
+}
+
+char *pgsql_counters_format(const pgsql_counter_list *list) {
+	/* every character may be escaped, then the equals sign, the value and the semicolon */
+	size_t size = 1;
+	for (size_t i = 0; i < list->count; i++) {
+		size += 3 * strlen(list->counters[i].name) + 24;
+	}
+	char *result = malloc(size);
+	if (result == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the statistics\n"));
+	}
+
+	size_t length = 0;
+	for (size_t i = 0; i < list->count; i++) {
+		for (const char *character = list->counters[i].name; *character != '\0'; character++) {
+			if (pgsql_counter_escaped(*character)) {
+				length += (size_t)snprintf(result + length, size - length, "%%%02X",
+										   (unsigned char)*character);
+			} else {
+				result[length++] = *character;
+			}
+		}
+		length += (size_t)snprintf(result + length, size - length, "=%lld;",
+								   list->counters[i].value);
+	}
+	result[length] = '\0';
+	return result;
+}
+
+static int pgsql_hex_digit(char character) {
+	if (character >= '0' && character <= '9') {
+		return character - '0';
+	}
+	if (character >= 'A' && character <= 'F') {
+		return character - 'A' + 10;
+	}
+	if (character >= 'a' && character <= 'f') {
+		return character - 'a' + 10;
+	}
+	return -1;
+}
+
+pgsql_counter_list pgsql_counters_parse(const char *data) {
+	pgsql_counter_list result = {0};
+	char *name = malloc(strlen(data) + 1);
+	if (name == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the statistics\n"));
+	}
+
+	/* a counter without its semicolon was cut off, its value may be incomplete */
+	for (const char *end; (end = strchr(data, ';')) != NULL; data = end + 1) {
+		const char *equals = memchr(data, '=', (size_t)(end - data));
+		if (equals == NULL || equals == data) {
+			continue;
+		}
+
+		size_t length = 0;
+		bool valid = true;
+		for (const char *character = data; character < equals; character++) {
+			if (*character != '%') {
+				name[length++] = *character;
+				continue;
+			}
+			int high = character + 2 < equals ? pgsql_hex_digit(character[1]) : -1;
+			int low = high < 0 ? -1 : pgsql_hex_digit(character[2]);
+			if (low < 0) {
+				valid = false;
+				break;
+			}
+			name[length++] = (char)(high * 16 + low);
+			character += 2;
+		}
+		name[length] = '\0';
+
+		char *value_end;
+		long long value = strtoll(equals + 1, &value_end, 10);
+		if (valid && value_end != equals + 1 && value_end == end) {
+			pgsql_counters_add(&result, name, value);
+		}
+	}
+	free(name);
+	return result;
+}
+
+static int pgsql_compare_counters(const void *left, const void *right) {
+	return strcmp(((const pgsql_counter *)left)->name, ((const pgsql_counter *)right)->name);
+}
+
+static const pgsql_counter *pgsql_counters_find(pgsql_counter_list *list, const char *name) {
+	if (list->count == 0) {
+		return NULL;
+	}
+	/* sorted once, looked up for every counter of every database */
+	if (!list->sorted) {
+		qsort(list->counters, list->count, sizeof(pgsql_counter), pgsql_compare_counters);
+		list->sorted = true;
+	}
+	pgsql_counter key = {
+		.name = (char *)name,
+	};
+	return bsearch(&key, list->counters, list->count, sizeof(pgsql_counter),
+				   pgsql_compare_counters);
+}
+
+bool pgsql_counter_delta(pgsql_counter_list *previous, const char *name, long long current,
+						 long long *delta) {
+	const pgsql_counter *counter = pgsql_counters_find(previous, name);
+	if (counter == NULL || current < counter->value) {
+		return false;
+	}
+	*delta = current - counter->value;
+	return true;
+}
+
+bool pgsql_counter_rate(pgsql_counter_list *previous, const char *name, long long current,
+						double elapsed, double *rate) {
+	long long delta;
+	if (elapsed <= 0 || !pgsql_counter_delta(previous, name, current, &delta)) {
+		return false;
+	}
+	*rate = (double)delta / elapsed;
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PGSQL_STATS_STATE_VERSION 2
+
+/* the built-in metric sets, each is read with one catalog query */
+typedef enum {
+	PGSQL_STATS_REPLICATION = 1 << 0, /* pg_stat_replication */
+	PGSQL_STATS_DATABASE = 1 << 1,    /* pg_stat_database */
+	PGSQL_STATS_BGWRITER = 1 << 2,    /* pg_stat_bgwriter */
+} pgsql_stats_set;
+
+/* a cumulative statistics counter, e.g. "database postgres xact_commit" */
+typedef struct {
+	char *name;
+	long long value;
+} pgsql_counter;
+
+typedef struct {
+	pgsql_counter *counters;
+	size_t count;
+	size_t capacity;
+	bool sorted;
+} pgsql_counter_list;
+
+/* parses "replication,database", returns 0 for unknown sets */
+unsigned int pgsql_stats_parse_sets(const char *list);
+
+void pgsql_counters_add(pgsql_counter_list *list, const char *name, long long value);
+void pgsql_counters_free(pgsql_counter_list *list);
+
+/*
+ * One line of "name=value;" for the state file, %, ; and = and control
+ * characters of the names are written as %XX.
+ */
+char *pgsql_counters_format(const pgsql_counter_list *list);
+pgsql_counter_list pgsql_counters_parse(const char *data);
+
+/*
+ * The rate per second of the counter since the previous sample. False if
+ * the counter was not in the previous sample or went down, which happens
+ * when the statistics are reset.
+ */
+bool pgsql_counter_rate(pgsql_counter_list *previous, const char *name, long long current,
+						double elapsed, double *rate);
+
+/* the difference to the previous sample, with the same exceptions */
+bool pgsql_counter_delta(pgsql_counter_list *previous, const char *name, long long current,
+						 long long *delta);
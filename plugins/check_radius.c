@@ -38,6 +38,8 @@ const char *email = "devel@monitoring-plugins.org";
 #include "netutils.h"
 #include "states.h"
 #include "check_radius.d/config.h"
+#include "check_radius.d/client.h"
+#include "perfdata.h"
 
 #if defined(HAVE_LIBRADCLI)
 #	include <radcli/radcli.h>
@@ -54,6 +56,7 @@ typedef struct {
 	check_radius_config config;
 } check_radius_config_wrapper;
 static check_radius_config_wrapper process_arguments(int /*argc*/, char ** /*argv*/);
+static mp_subcheck check_load(check_radius_config /*config*/);
 static void print_help(void);
 void print_usage(void);
 
@@ -174,6 +177,11 @@ int main(int argc, char **argv) {
 
 	mp_set_ok_summary(&overall, "Radius check is OK");
 
+	if (config.requests > 0) {
+		mp_add_subcheck_to_check(&overall, check_load(config));
+		mp_exit(overall);
+	}
+
 	mp_subcheck sc_read_config = mp_subcheck_init();
 
 	char *str = strdup("dictionary");
@@ -306,10 +314,208 @@ int main(int argc, char **argv) {
 	mp_exit(overall);
 }
 
+/* the state of the accepted share, without thresholds any failure counts */
+static mp_state_enum success_state(check_radius_config config, mp_perfdata pd_success,
+								   size_t accepted, size_t sent) {
+	if (config.success_thresholds.warning_is_set || config.success_thresholds.critical_is_set) {
+		return mp_get_pd_status(pd_success);
+	}
+	if (accepted == 0) {
+		return STATE_CRITICAL;
+	}
+	return accepted < sent ? STATE_WARNING : STATE_OK;
+}
+
+static mp_perfdata success_perfdata(check_radius_config config, const char *prefix,
+									size_t accepted, size_t sent) {
+	mp_perfdata pd_success = perfdata_init();
+	if (prefix != NULL) {
+		xasprintf(&pd_success.label, "%s_success_rate", prefix);
+	} else {
+		pd_success.label = "success_rate";
+	}
+	pd_success.uom = "%";
+	pd_success =
+		mp_set_pd_value(pd_success, sent > 0 ? 100.0 * (double)accepted / (double)sent : 0);
+	pd_success = mp_set_pd_min_value(pd_success, mp_create_pd_value(0));
+	pd_success = mp_set_pd_max_value(pd_success, mp_create_pd_value(100));
+	return mp_pd_set_thresholds(pd_success, config.success_thresholds);
+}
+
+/* sends the requests concurrently to all servers, one subcheck per server */
+static mp_subcheck check_load(check_radius_config config) {
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+
+	radius_server *servers = calloc(config.servers_num, sizeof(radius_server));
+	if (servers == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the servers\n"));
+	}
+	for (size_t i = 0; i < config.servers_num; i++) {
+		servers[i].name = config.servers[i];
+		if (!dns_lookup(config.servers[i], &servers[i].address, address_family)) {
+			result = mp_set_subcheck_state(result, STATE_UNKNOWN);
+			xasprintf(&result.output, "could not resolve %s", config.servers[i]);
+			free(servers);
+			return result;
+		}
+		if (servers[i].address.ss_family == AF_INET) {
+			((struct sockaddr_in *)&servers[i].address)->sin_port = htons(config.port);
+			servers[i].address_length = sizeof(struct sockaddr_in);
+		} else {
+			((struct sockaddr_in6 *)&servers[i].address)->sin6_port = htons(config.port);
+			servers[i].address_length = sizeof(struct sockaddr_in6);
+		}
+		/* the replies are told apart by their source address */
+		for (size_t j = 0; j < i; j++) {
+			if (servers[j].address_length == servers[i].address_length &&
+				memcmp(&servers[j].address, &servers[i].address, servers[i].address_length) ==
+					0) {
+				result = mp_set_subcheck_state(result, STATE_UNKNOWN);
+				xasprintf(&result.output, "%s and %s are the same server", config.servers[j],
+						  config.servers[i]);
+				free(servers);
+				return result;
+			}
+		}
+	}
+
+	radius_credentials credentials = {
+		.username = config.username,
+		.password = config.password,
+		.secret = config.secret,
+		.nas_id = config.nas_id,
+		.has_nas_ip = false,
+	};
+	if (config.nas_ip_address != NULL) {
+		struct sockaddr_storage nas_address;
+		if (!dns_lookup(config.nas_ip_address, &nas_address, AF_INET)) {
+			result = mp_set_subcheck_state(result, STATE_UNKNOWN);
+			xasprintf(&result.output, "invalid NAS IP address. Lookup failed");
+			free(servers);
+			return result;
+		}
+		credentials.has_nas_ip = true;
+		credentials.nas_ip = ntohl(((struct sockaddr_in *)&nas_address)->sin_addr.s_addr);
+	}
+
+	radius_load load = {
+		.servers = servers,
+		.servers_num = config.servers_num,
+		.credentials = &credentials,
+		.requests = config.requests,
+		.concurrency = config.concurrency > 0 ? config.concurrency : config.requests,
+		.retries = config.retries,
+		.retransmit_ms = config.retransmit_ms,
+		.timeout = (double)timeout_interval,
+	};
+	radius_load_result run = radius_load_run(&load);
+	if (run.errorcode != OK) {
+		result = mp_set_subcheck_state(result, STATE_UNKNOWN);
+		xasprintf(&result.output, "%s", run.error);
+		free(run.error);
+		free(servers);
+		return result;
+	}
+
+	size_t sent = 0;
+	size_t accepted = 0;
+	size_t histogram[RADIUS_LATENCY_BUCKETS] = {0};
+	for (size_t i = 0; i < config.servers_num; i++) {
+		radius_server *server = &servers[i];
+		sent += server->sent;
+		accepted += server->accepted;
+		for (int bucket = 0; bucket < RADIUS_LATENCY_BUCKETS; bucket++) {
+			histogram[bucket] += server->histogram[bucket];
+		}
+
+		mp_subcheck sc_server = mp_subcheck_init();
+		mp_perfdata pd_success =
+			success_perfdata(config, server->name, server->accepted, server->sent);
+		mp_add_perfdata_to_subcheck(&sc_server, pd_success);
+
+		size_t answered = server->accepted + server->rejected;
+		double latency_avg = answered > 0 ? server->latency_sum / (double)answered : 0;
+		mp_perfdata pd_latency_avg = perfdata_init();
+		xasprintf(&pd_latency_avg.label, "%s_latency_avg", server->name);
+		pd_latency_avg.uom = "ms";
+		pd_latency_avg = mp_set_pd_value(pd_latency_avg, latency_avg);
+		mp_add_perfdata_to_subcheck(&sc_server, pd_latency_avg);
+
+		mp_perfdata pd_latency_max = perfdata_init();
+		xasprintf(&pd_latency_max.label, "%s_latency_max", server->name);
+		pd_latency_max.uom = "ms";
+		pd_latency_max = mp_set_pd_value(pd_latency_max, server->latency_max);
+		mp_add_perfdata_to_subcheck(&sc_server, pd_latency_max);
+
+		mp_perfdata pd_retransmits = perfdata_init();
+		xasprintf(&pd_retransmits.label, "%s_retransmits", server->name);
+		pd_retransmits.uom = "c";
+		pd_retransmits = mp_set_pd_value(pd_retransmits, server->retransmits);
+		mp_add_perfdata_to_subcheck(&sc_server, pd_retransmits);
+
+		sc_server = mp_set_subcheck_state(
+			sc_server, success_state(config, pd_success, server->accepted, server->sent));
+		xasprintf(&sc_server.output,
+				  "%s: %zu of %zu accepted, %zu rejected, %zu timed out, %.1fms on average",
+				  server->name, server->accepted, server->sent, server->rejected,
+				  server->timed_out, latency_avg);
+		if (server->invalid > 0) {
+			char *output = sc_server.output;
+			xasprintf(&sc_server.output, "%s, %zu invalid replies", output, server->invalid);
+			free(output);
+		}
+		mp_add_subcheck_to_subcheck(&result, sc_server);
+	}
+
+	mp_subcheck sc_success = mp_subcheck_init();
+	mp_perfdata pd_success = success_perfdata(config, NULL, accepted, sent);
+	mp_add_perfdata_to_subcheck(&sc_success, pd_success);
+	mp_perfdata pd_rate = perfdata_init();
+	pd_rate.label = "requests_per_second";
+	pd_rate = mp_set_pd_value(pd_rate, run.elapsed > 0 ? (double)sent / run.elapsed : 0);
+	mp_add_perfdata_to_subcheck(&sc_success, pd_rate);
+
+	/* the number of replies per latency bucket, not cumulative */
+	for (int bucket = 0; bucket < RADIUS_LATENCY_BUCKETS; bucket++) {
+		mp_perfdata pd_bucket = perfdata_init();
+		if (bucket < RADIUS_LATENCY_BUCKETS - 1) {
+			xasprintf(&pd_bucket.label, "latency_le_%gms", radius_latency_bounds[bucket]);
+		} else {
+			xasprintf(&pd_bucket.label, "latency_gt_%gms", radius_latency_bounds[bucket - 1]);
+		}
+		pd_bucket = mp_set_pd_value(pd_bucket, histogram[bucket]);
+		mp_add_perfdata_to_subcheck(&sc_success, pd_bucket);
+	}
+	sc_success = mp_set_subcheck_state(sc_success,
+									   success_state(config, pd_success, accepted, sent));
+	xasprintf(&sc_success.output, "%zu of %zu requests accepted", accepted, sent);
+	mp_add_subcheck_to_subcheck(&result, sc_success);
+
+	if (run.started < config.requests) {
+		mp_subcheck sc_unsent = mp_subcheck_init();
+		sc_unsent = mp_set_subcheck_state(sc_unsent, STATE_WARNING);
+		xasprintf(&sc_unsent.output, "only %zu of %zu requests were sent before the timeout",
+				  run.started, config.requests);
+		mp_add_subcheck_to_subcheck(&result, sc_unsent);
+	}
+
+	xasprintf(&result.output, "%zu requests to %zu server(s) in %.2fs (%.1f/s)", sent,
+			  config.servers_num, run.elapsed, run.elapsed > 0 ? (double)sent / run.elapsed : 0);
+	free(servers);
+	return result;
+}
+
 /* process command-line arguments */
 check_radius_config_wrapper process_arguments(int argc, char **argv) {
 	enum {
-		output_format_index
+		output_format_index = CHAR_MAX + 1,
+		requests_index,
+		concurrency_index,
+		secret_index,
+		retransmit_index,
+		warn_success_index,
+		crit_success_index,
 	};
 
 	static struct option longopts[] = {{"hostname", required_argument, 0, 'H'},
@@ -326,6 +532,12 @@ check_radius_config_wrapper process_arguments(int argc, char **argv) {
 									   {"version", no_argument, 0, 'V'},
 									   {"help", no_argument, 0, 'h'},
 									   {"output-format", required_argument, 0, output_format_index},
+									   {"requests", required_argument, 0, requests_index},
+									   {"concurrency", required_argument, 0, concurrency_index},
+									   {"secret", required_argument, 0, secret_index},
+									   {"retransmit", required_argument, 0, retransmit_index},
+									   {"warn-success", required_argument, 0, warn_success_index},
+									   {"crit-success", required_argument, 0, crit_success_index},
 									   {0, 0, 0, 0}};
 
 	check_radius_config_wrapper result = {
@@ -358,6 +570,15 @@ check_radius_config_wrapper process_arguments(int argc, char **argv) {
 				usage2(_("Invalid hostname/address"), optarg);
 			}
 			result.config.server = optarg;
+			{
+				char **servers = realloc(result.config.servers,
+										 (result.config.servers_num + 1) * sizeof(char *));
+				if (servers == NULL) {
+					die(STATE_UNKNOWN, _("Could not allocate memory for the servers\n"));
+				}
+				servers[result.config.servers_num++] = optarg;
+				result.config.servers = servers;
+			}
 			break;
 		case 'P': /* port */
 			if (is_intnonneg(optarg)) {
@@ -404,6 +625,49 @@ check_radius_config_wrapper process_arguments(int argc, char **argv) {
 				usage2(_("Timeout interval must be a positive integer"), optarg);
 			}
 			break;
+		case requests_index:
+			if (!is_intpos(optarg)) {
+				usage2(_("Number of requests must be a positive integer"), optarg);
+			}
+			result.config.requests = strtoul(optarg, NULL, 10);
+			break;
+		case concurrency_index:
+			if (!is_intpos(optarg)) {
+				usage2(_("Concurrency must be a positive integer"), optarg);
+			}
+			result.config.concurrency = strtoul(optarg, NULL, 10);
+			break;
+		case secret_index:
+			result.config.secret = strdup(optarg);
+
+			/* Delete the secret from process list */
+			while (*optarg != '\0') {
+				*optarg = 'X';
+				optarg++;
+			}
+			break;
+		case retransmit_index:
+			if (!is_intpos(optarg)) {
+				usage2(_("Retransmit interval must be a positive integer"), optarg);
+			}
+			result.config.retransmit_ms = atol(optarg);
+			break;
+		case warn_success_index: {
+			mp_range_parsed tmp = mp_parse_range_string(optarg);
+			if (tmp.error != MP_PARSING_SUCCESS) {
+				die(STATE_UNKNOWN, "failed to parse warning success rate threshold");
+			}
+			result.config.success_thresholds =
+				mp_thresholds_set_warn(result.config.success_thresholds, tmp.range);
+		} break;
+		case crit_success_index: {
+			mp_range_parsed tmp = mp_parse_range_string(optarg);
+			if (tmp.error != MP_PARSING_SUCCESS) {
+				die(STATE_UNKNOWN, "failed to parse critical success rate threshold");
+			}
+			result.config.success_thresholds =
+				mp_thresholds_set_crit(result.config.success_thresholds, tmp.range);
+		} break;
 		case output_format_index: {
 			parsed_output_format parser = mp_parse_output_format(optarg);
 			if (!parser.parsing_success) {
@@ -428,7 +692,15 @@ check_radius_config_wrapper process_arguments(int argc, char **argv) {
 	if (result.config.password == NULL) {
 		usage4(_("Password not specified"));
 	}
-	if (result.config.config_file == NULL) {
+	if (result.config.requests > 0) {
+		/* the load test builds the requests itself, it needs no radius library configuration */
+		if (result.config.secret == NULL) {
+			usage4(_("The concurrent requests need the shared secret"));
+		}
+#ifndef MOPL_USE_OPENSSL
+		usage4(_("The concurrent requests need OpenSSL"));
+#endif
+	} else if (result.config.config_file == NULL) {
 		usage4(_("Configuration file not specified"));
 	}
 
@@ -469,6 +741,26 @@ void print_help(void) {
 	printf("    %s\n", _("Response string to expect from the server"));
 	printf(" %s\n", "-r, --retries=INTEGER");
 	printf("    %s\n", _("Number of times to retry a failed connection"));
+	printf(" %s\n", "--requests=INTEGER");
+	printf("    %s\n", _("Send this many Access-Requests concurrently from one socket"));
+	printf("    %s\n", _("instead of a single one through the radius library. With more"));
+	printf("    %s\n", _("than one -H the requests go to the servers in turn, every server"));
+	printf("    %s\n", _("gets a subcheck. -t is the time for all requests, -r the"));
+	printf("    %s\n", _("retransmits of each"));
+	printf(" %s\n", "--concurrency=INTEGER");
+	printf("    %s\n", _("The most requests in flight at once (default: all of them, at"));
+	printf("    %s\n", _("most 256 per server)"));
+	printf(" %s\n", "--secret=STRING");
+	printf("    %s\n", _("The shared secret for the concurrent requests (SECURITY RISK)"));
+	printf(" %s\n", "--retransmit=INTEGER");
+	printf("    %s\n", _("Milliseconds until a request without reply is sent again"));
+	printf("    %s\n", _("(default: 1000)"));
+	printf(" %s\n", "--warn-success=RANGE");
+	printf("    %s\n", _("Percentage of accepted requests to result in warning status"));
+	printf(" %s\n", "--crit-success=RANGE");
+	printf("    %s\n", _("Percentage of accepted requests to result in critical status."));
+	printf("    %s\n", _("Without thresholds any failed request is a warning and no"));
+	printf("    %s\n", _("accepted request at all critical"));
 	printf(UT_OUTPUT_FORMAT);
 
 	printf(UT_CONN_TIMEOUT, timeout_interval);
@@ -493,7 +785,11 @@ void print_usage(void) {
 	printf("%s\n", _("Usage:"));
 	printf("%s -H host -F config_file -u username -p password\n\
 			[-P port] [-t timeout] [-r retries] [-e expect]\n\
-			[-n nas-id] [-N nas-ip-addr]\n",
+			[-n nas-id] [-N nas-ip-addr]\n\
+       %s -H host [-H host ...] -u username -p password --secret=secret\n\
+			--requests=count [--concurrency=count] [--retransmit=ms]\n\
+			[--warn-success=range] [--crit-success=range]\n",
+		   progname,
 		   progname);
 }
 
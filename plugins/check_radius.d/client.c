@@ -0,0 +1,484 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./client.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/time.h>
+#ifdef MOPL_USE_OPENSSL
+#	include <openssl/evp.h>
+#	include <openssl/hmac.h>
+#	include <openssl/rand.h>
+#endif
+
+/* attribute types of RFC 2865 and 2869 */
+enum {
+	RADIUS_ATTRIBUTE_USER_NAME = 1,
+	RADIUS_ATTRIBUTE_USER_PASSWORD = 2,
+	RADIUS_ATTRIBUTE_NAS_IP_ADDRESS = 4,
+	RADIUS_ATTRIBUTE_SERVICE_TYPE = 6,
+	RADIUS_ATTRIBUTE_NAS_IDENTIFIER = 32,
+	RADIUS_ATTRIBUTE_MESSAGE_AUTHENTICATOR = 80,
+};
+#define RADIUS_SERVICE_AUTHENTICATE_ONLY 8
+#define RADIUS_MAX_PASSWORD_LENGTH       128
+
+const double radius_latency_bounds[RADIUS_LATENCY_BUCKETS - 1] = {
+	5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000,
+};
+
+struct radius_request {
+	radius_server *server;
+	uint8_t identifier;
+	uint8_t authenticator[RADIUS_AUTHENTICATOR_LENGTH];
+	uint8_t *packet;
+	size_t length;
+	double first_sent; /* milliseconds since the start of the run */
+	int transmissions;
+	long due_tick;
+	radius_request *next; /* in the slot of the timer wheel */
+	radius_request *previous;
+};
+
+typedef struct {
+	radius_request *slots[RADIUS_WHEEL_SLOTS];
+	long tick;
+} radius_wheel;
+
+#ifdef MOPL_USE_OPENSSL
+static void radius_md5(uint8_t digest[16], const uint8_t *first, size_t first_length,
+					   const uint8_t *second, size_t second_length) {
+	EVP_MD_CTX *context = EVP_MD_CTX_new();
+	EVP_DigestInit_ex(context, EVP_md5(), NULL);
+	EVP_DigestUpdate(context, first, first_length);
+	EVP_DigestUpdate(context, second, second_length);
+	EVP_DigestFinal_ex(context, digest, NULL);
+	EVP_MD_CTX_free(context);
+}
+
+static void radius_hmac_md5(uint8_t digest[16], const char *secret, const uint8_t *packet,
+							size_t length) {
+	HMAC(EVP_md5(), secret, (int)strlen(secret), packet, length, digest, NULL);
+}
+
+static void radius_random(uint8_t *buffer, size_t length) {
+	if (RAND_bytes(buffer, (int)length) != 1) {
+		die(STATE_UNKNOWN, _("Could not get random bytes for the request authenticator\n"));
+	}
+}
+#else
+static void radius_md5(uint8_t digest[16], const uint8_t *first, size_t first_length,
+					   const uint8_t *second, size_t second_length) {
+	(void)digest, (void)first, (void)first_length, (void)second, (void)second_length;
+	die(STATE_UNKNOWN, _("Concurrent RADIUS requests need OpenSSL\n"));
+}
+
+static void radius_hmac_md5(uint8_t digest[16], const char *secret, const uint8_t *packet,
+							size_t length) {
+	(void)digest, (void)secret, (void)packet, (void)length;
+	die(STATE_UNKNOWN, _("Concurrent RADIUS requests need OpenSSL\n"));
+}
+
+static void radius_random(uint8_t *buffer, size_t length) {
+	(void)buffer, (void)length;
+	die(STATE_UNKNOWN, _("Concurrent RADIUS requests need OpenSSL\n"));
+}
+#endif
+
+static uint8_t *radius_add_attribute(uint8_t *position, uint8_t type, const void *value,
+									 size_t length) {
+	position[0] = type;
+	position[1] = (uint8_t)(length + 2);
+	memcpy(position + 2, value, length);
+	return position + 2 + length;
+}
+
+size_t radius_build_access_request(uint8_t *packet, uint8_t identifier,
+								   const uint8_t authenticator[RADIUS_AUTHENTICATOR_LENGTH],
+								   const radius_credentials *credentials) {
+	size_t username_length = strlen(credentials->username);
+	size_t password_length = strlen(credentials->password);
+	size_t nas_id_length = credentials->nas_id != NULL ? strlen(credentials->nas_id) : 0;
+	if (username_length == 0 || username_length > 253 ||
+		password_length > RADIUS_MAX_PASSWORD_LENGTH || nas_id_length > 253) {
+		return 0;
+	}
+
+	packet[0] = RADIUS_ACCESS_REQUEST;
+	packet[1] = identifier;
+	memcpy(packet + 4, authenticator, RADIUS_AUTHENTICATOR_LENGTH);
+
+	/* the Message-Authenticator comes first, it is filled in at the end */
+	uint8_t *position = packet + RADIUS_HEADER_LENGTH;
+	uint8_t *message_authenticator = position + 2;
+	uint8_t zero[16] = {0};
+	position = radius_add_attribute(position, RADIUS_ATTRIBUTE_MESSAGE_AUTHENTICATOR, zero, 16);
+
+	position = radius_add_attribute(position, RADIUS_ATTRIBUTE_USER_NAME, credentials->username,
+									username_length);
+
+	/* the password is padded to 16 bytes and hidden as in RFC 2865 section 5.2 */
+	uint8_t hidden[RADIUS_MAX_PASSWORD_LENGTH] = {0};
+	size_t hidden_length = password_length == 0 ? 16 : (password_length + 15) / 16 * 16;
+	memcpy(hidden, credentials->password, password_length);
+	const uint8_t *previous = authenticator;
+	for (size_t block = 0; block < hidden_length; block += 16) {
+		uint8_t digest[16];
+		radius_md5(digest, (const uint8_t *)credentials->secret, strlen(credentials->secret),
+				   previous, 16);
+		for (size_t i = 0; i < 16; i++) {
+			hidden[block + i] ^= digest[i];
+		}
+		previous = hidden + block;
+	}
+	position =
+		radius_add_attribute(position, RADIUS_ATTRIBUTE_USER_PASSWORD, hidden, hidden_length);
+
+	uint8_t service[4] = {0, 0, 0, RADIUS_SERVICE_AUTHENTICATE_ONLY};
+	position = radius_add_attribute(position, RADIUS_ATTRIBUTE_SERVICE_TYPE, service, 4);
+
+	if (credentials->nas_id != NULL) {
+		position = radius_add_attribute(position, RADIUS_ATTRIBUTE_NAS_IDENTIFIER,
+										credentials->nas_id, nas_id_length);
+	}
+	if (credentials->has_nas_ip) {
+		uint32_t nas_ip = htonl(credentials->nas_ip);
+		position = radius_add_attribute(position, RADIUS_ATTRIBUTE_NAS_IP_ADDRESS, &nas_ip, 4);
+	}
+
+	size_t length = (size_t)(position - packet);
+	packet[2] = (uint8_t)(length >> 8);
+	packet[3] = (uint8_t)(length & 0xff);
+
+	uint8_t digest[16];
+	radius_hmac_md5(digest, credentials->secret, packet, length);
+	memcpy(message_authenticator, digest, 16);
+	return length;
+}
+
+radius_reply radius_check_reply(const uint8_t *packet, size_t length, uint8_t identifier,
+								 const uint8_t request_authenticator[RADIUS_AUTHENTICATOR_LENGTH],
+								 const char *secret) {
+	if (length < RADIUS_HEADER_LENGTH || packet[1] != identifier) {
+		return RADIUS_REPLY_INVALID;
+	}
+	size_t packet_length = ((size_t)packet[2] << 8) | packet[3];
+	if (packet_length < RADIUS_HEADER_LENGTH || packet_length > length ||
+		packet_length > RADIUS_MAX_PACKET_LENGTH) {
+		return RADIUS_REPLY_INVALID;
+	}
+
+	/* MD5(Code + Identifier + Length + Request Authenticator + Attributes + Secret) */
+	uint8_t copy[RADIUS_MAX_PACKET_LENGTH];
+	memcpy(copy, packet, packet_length);
+	memcpy(copy + 4, request_authenticator, RADIUS_AUTHENTICATOR_LENGTH);
+	uint8_t digest[16];
+	radius_md5(digest, copy, packet_length, (const uint8_t *)secret, strlen(secret));
+	if (memcmp(digest, packet + 4, 16) != 0) {
+		return RADIUS_REPLY_INVALID;
+	}
+
+	/* a Message-Authenticator is checked over the packet with the request authenticator */
+	for (size_t offset = RADIUS_HEADER_LENGTH; offset + 2 <= packet_length;) {
+		uint8_t attribute_length = copy[offset + 1];
+		if (attribute_length < 2 || offset + attribute_length > packet_length) {
+			return RADIUS_REPLY_INVALID;
+		}
+		if (copy[offset] == RADIUS_ATTRIBUTE_MESSAGE_AUTHENTICATOR) {
+			if (attribute_length != 18) {
+				return RADIUS_REPLY_INVALID;
+			}
+			memset(copy + offset + 2, 0, 16);
+			radius_hmac_md5(digest, secret, copy, packet_length);
+			if (memcmp(digest, packet + offset + 2, 16) != 0) {
+				return RADIUS_REPLY_INVALID;
+			}
+		}
+		offset += attribute_length;
+	}
+
+	switch (packet[0]) {
+	case RADIUS_ACCESS_ACCEPT:
+		return RADIUS_REPLY_ACCEPT;
+	case RADIUS_ACCESS_REJECT:
+		return RADIUS_REPLY_REJECT;
+	case RADIUS_ACCESS_CHALLENGE:
+		return RADIUS_REPLY_CHALLENGE;
+	default:
+		return RADIUS_REPLY_INVALID;
+	}
+}
+
+int radius_latency_bucket(double milliseconds) {
+	int bucket = 0;
+	while (bucket < RADIUS_LATENCY_BUCKETS - 1 && milliseconds > radius_latency_bounds[bucket]) {
+		bucket++;
+	}
+	return bucket;
+}
+
+static void wheel_insert(radius_wheel *wheel, radius_request *request, long due_tick) {
+	request->due_tick = due_tick > wheel->tick ? due_tick : wheel->tick + 1;
+	radius_request **slot = &wheel->slots[request->due_tick % RADIUS_WHEEL_SLOTS];
+	request->previous = NULL;
+	request->next = *slot;
+	if (*slot != NULL) {
+		(*slot)->previous = request;
+	}
+	*slot = request;
+}
+
+static void wheel_remove(radius_wheel *wheel, radius_request *request) {
+	if (request->previous != NULL) {
+		request->previous->next = request->next;
+	} else {
+		wheel->slots[request->due_tick % RADIUS_WHEEL_SLOTS] = request->next;
+	}
+	if (request->next != NULL) {
+		request->next->previous = request->previous;
+	}
+}
+
+static double elapsed_ms(struct timeval start) { return delta_time(start) * 1000.0; }
+
+static bool same_address(const struct sockaddr_storage *left,
+						 const struct sockaddr_storage *right) {
+	if (left->ss_family != right->ss_family) {
+		return false;
+	}
+	if (left->ss_family == AF_INET) {
+		const struct sockaddr_in *left4 = (const struct sockaddr_in *)left;
+		const struct sockaddr_in *right4 = (const struct sockaddr_in *)right;
+		return left4->sin_port == right4->sin_port &&
+			   left4->sin_addr.s_addr == right4->sin_addr.s_addr;
+	}
+	const struct sockaddr_in6 *left6 = (const struct sockaddr_in6 *)left;
+	const struct sockaddr_in6 *right6 = (const struct sockaddr_in6 *)right;
+	return left6->sin6_port == right6->sin6_port &&
+		   memcmp(&left6->sin6_addr, &right6->sin6_addr, sizeof(struct in6_addr)) == 0;
+}
+
+static void transmit(int sock, radius_request *request) {
+	/* a failed send is not retried at once, the retransmit timer covers it */
+	sendto(sock, request->packet, request->length, 0,
+		   (struct sockaddr *)&request->server->address, request->server->address_length);
+	request->transmissions++;
+}
+
+/* the request leaves the wheel and frees its identifier */
+static void finish(radius_wheel *wheel, radius_request *request, size_t *in_flight) {
+	wheel_remove(wheel, request);
+	request->server->outstanding[request->identifier] = NULL;
+	request->server->in_flight--;
+	(*in_flight)--;
+	free(request->packet);
+	free(request);
+}
+
+/* the next server in turn with a free identifier, or NULL */
+static radius_server *next_server(radius_load *load, size_t *turn) {
+	for (size_t tries = 0; tries < load->servers_num; tries++) {
+		radius_server *server = &load->servers[(*turn)++ % load->servers_num];
+		if (server->in_flight < RADIUS_IDENTIFIERS) {
+			return server;
+		}
+	}
+	return NULL;
+}
+
+static radius_request *start_request(radius_load *load, radius_server *server) {
+	radius_request *request = calloc(1, sizeof(radius_request));
+	uint8_t *packet = malloc(RADIUS_MAX_PACKET_LENGTH);
+	if (request == NULL || packet == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the RADIUS requests\n"));
+	}
+
+	while (server->outstanding[server->next_identifier % RADIUS_IDENTIFIERS] != NULL) {
+		server->next_identifier++;
+	}
+	request->server = server;
+	request->identifier = (uint8_t)(server->next_identifier++ % RADIUS_IDENTIFIERS);
+	radius_random(request->authenticator, RADIUS_AUTHENTICATOR_LENGTH);
+	request->packet = packet;
+	request->length = radius_build_access_request(packet, request->identifier,
+												  request->authenticator, load->credentials);
+
+	server->outstanding[request->identifier] = request;
+	server->in_flight++;
+	server->sent++;
+	return request;
+}
+
+static void receive_replies(int sock, radius_load *load, radius_wheel *wheel,
+							struct timeval start, size_t *in_flight) {
+	uint8_t packet[RADIUS_MAX_PACKET_LENGTH];
+	while (true) {
+		struct sockaddr_storage from;
+		socklen_t from_length = sizeof(from);
+		ssize_t length =
+			recvfrom(sock, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_length);
+		if (length < 0) {
+			return;
+		}
+
+		radius_server *server = NULL;
+		for (size_t i = 0; i < load->servers_num && server == NULL; i++) {
+			if (same_address(&from, &load->servers[i].address)) {
+				server = &load->servers[i];
+			}
+		}
+		if (server == NULL || length < RADIUS_HEADER_LENGTH) {
+			continue;
+		}
+
+		radius_request *request = server->outstanding[packet[1]];
+		radius_reply reply =
+			request == NULL ? RADIUS_REPLY_INVALID
+							: radius_check_reply(packet, (size_t)length, request->identifier,
+												 request->authenticator,
+												 load->credentials->secret);
+		if (reply == RADIUS_REPLY_INVALID) {
+			/* e.g. a late reply to a retransmit, the request keeps waiting */
+			server->invalid++;
+			continue;
+		}
+
+		double latency = elapsed_ms(start) - request->first_sent;
+		server->histogram[radius_latency_bucket(latency)]++;
+		server->latency_sum += latency;
+		if (latency > server->latency_max) {
+			server->latency_max = latency;
+		}
+		if (reply == RADIUS_REPLY_ACCEPT) {
+			server->accepted++;
+		} else {
+			server->rejected++;
+		}
+		finish(wheel, request, in_flight);
+	}
+}
+
+/* retransmits the requests which are due and gives up on those out of retries */
+static void advance_wheel(int sock, radius_load *load, radius_wheel *wheel, long target_tick,
+						  size_t *in_flight) {
+	long retransmit_ticks = load->retransmit_ms / RADIUS_WHEEL_TICK_MS;
+	if (retransmit_ticks < 1) {
+		retransmit_ticks = 1;
+	}
+
+	while (wheel->tick < target_tick) {
+		wheel->tick++;
+		radius_request *request = wheel->slots[wheel->tick % RADIUS_WHEEL_SLOTS];
+		while (request != NULL) {
+			radius_request *next = request->next;
+			if (request->due_tick <= wheel->tick) {
+				if (request->transmissions <= load->retries) {
+					wheel_remove(wheel, request);
+					transmit(sock, request);
+					request->server->retransmits++;
+					wheel_insert(wheel, request, wheel->tick + retransmit_ticks);
+				} else {
+					request->server->timed_out++;
+					finish(wheel, request, in_flight);
+				}
+			}
+			request = next;
+		}
+	}
+}
+
+radius_load_result radius_load_run(radius_load *load) {
+	radius_load_result result = {
+		.errorcode = OK,
+		.error = NULL,
+		.started = 0,
+		.elapsed = 0,
+	};
+
+	int family = load->servers[0].address.ss_family;
+	for (size_t i = 1; i < load->servers_num; i++) {
+		if (load->servers[i].address.ss_family != family) {
+			result.errorcode = ERROR;
+			xasprintf(&result.error, _("all servers need the same address family"));
+			return result;
+		}
+	}
+
+	uint8_t probe[RADIUS_MAX_PACKET_LENGTH];
+	uint8_t probe_authenticator[RADIUS_AUTHENTICATOR_LENGTH] = {0};
+	if (radius_build_access_request(probe, 0, probe_authenticator, load->credentials) == 0) {
+		result.errorcode = ERROR;
+		xasprintf(&result.error, _("the user name, password or NAS identifier is too long"));
+		return result;
+	}
+
+	int sock = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0 || fcntl(sock, F_SETFL, O_NONBLOCK) < 0) {
+		result.errorcode = ERROR;
+		xasprintf(&result.error, _("could not open a UDP socket: %s"), strerror(errno));
+		return result;
+	}
+
+	radius_wheel *wheel = calloc(1, sizeof(radius_wheel));
+	if (wheel == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the RADIUS requests\n"));
+	}
+	long retransmit_ticks = load->retransmit_ms / RADIUS_WHEEL_TICK_MS;
+	if (retransmit_ticks < 1) {
+		retransmit_ticks = 1;
+	}
+
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	size_t in_flight = 0;
+	size_t turn = 0;
+
+	while (result.started < load->requests || in_flight > 0) {
+		if (elapsed_ms(start) >= load->timeout * 1000) {
+			break;
+		}
+
+		while (result.started < load->requests && in_flight < load->concurrency) {
+			radius_server *server = next_server(load, &turn);
+			if (server == NULL) {
+				break;
+			}
+			radius_request *request = start_request(load, server);
+			request->first_sent = elapsed_ms(start);
+			transmit(sock, request);
+			wheel_insert(wheel, request, wheel->tick + retransmit_ticks);
+			result.started++;
+			in_flight++;
+		}
+
+		/* wait for replies until the next tick of the wheel */
+		double next_tick_ms = (double)(wheel->tick + 1) * RADIUS_WHEEL_TICK_MS;
+		int wait = (int)(next_tick_ms - elapsed_ms(start));
+		struct pollfd descriptor = {
+			.fd = sock,
+			.events = POLLIN,
+		};
+		if (poll(&descriptor, 1, wait > 0 ? wait : 0) > 0) {
+			receive_replies(sock, load, wheel, start, &in_flight);
+		}
+
+		advance_wheel(sock, load, wheel, (long)(elapsed_ms(start) / RADIUS_WHEEL_TICK_MS),
+					  &in_flight);
+	}
+
+	/* whatever is still waiting at the end of the run timed out */
+	for (size_t i = 0; i < RADIUS_WHEEL_SLOTS; i++) {
+		while (wheel->slots[i] != NULL) {
+			radius_request *request = wheel->slots[i];
+			request->server->timed_out++;
+			finish(wheel, request, &in_flight);
+		}
+	}
+
+	free(wheel);
+	close(sock);
+	result.elapsed = delta_time(start);
+	return result;
+}
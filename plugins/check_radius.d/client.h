@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../../config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/*
+ * A RADIUS client for load tests which keeps many Access-Requests in
+ * flight over one UDP socket instead of waiting for each reply. Every
+ * server has its own 256 identifiers, the retransmits are scheduled on a
+ * timer wheel.
+ */
+
+#define RADIUS_HEADER_LENGTH        20
+#define RADIUS_AUTHENTICATOR_LENGTH 16
+#define RADIUS_MAX_PACKET_LENGTH    4096
+#define RADIUS_IDENTIFIERS          256
+/* the retransmit timers, one slot per tick */
+#define RADIUS_WHEEL_SLOTS   256
+#define RADIUS_WHEEL_TICK_MS 10
+#define RADIUS_LATENCY_BUCKETS 11
+
+enum {
+	RADIUS_ACCESS_REQUEST = 1,
+	RADIUS_ACCESS_ACCEPT = 2,
+	RADIUS_ACCESS_REJECT = 3,
+	RADIUS_ACCESS_CHALLENGE = 11,
+};
+
+typedef enum {
+	RADIUS_REPLY_INVALID, /* not a reply to the request, e.g. a wrong authenticator */
+	RADIUS_REPLY_ACCEPT,
+	RADIUS_REPLY_REJECT,
+	RADIUS_REPLY_CHALLENGE,
+} radius_reply;
+
+/* the upper bounds of the latency histogram in milliseconds, the last bucket has none */
+extern const double radius_latency_bounds[RADIUS_LATENCY_BUCKETS - 1];
+
+typedef struct {
+	const char *username;
+	const char *password;
+	const char *secret;
+	const char *nas_id; /* may be NULL */
+	bool has_nas_ip;
+	uint32_t nas_ip; /* host byte order */
+} radius_credentials;
+
+/* returns the length of the packet, 0 if the attributes do not fit */
+size_t radius_build_access_request(uint8_t *packet, uint8_t identifier,
+								   const uint8_t authenticator[RADIUS_AUTHENTICATOR_LENGTH],
+								   const radius_credentials *credentials);
+
+radius_reply radius_check_reply(const uint8_t *packet, size_t length, uint8_t identifier,
+								 const uint8_t request_authenticator[RADIUS_AUTHENTICATOR_LENGTH],
+								 const char *secret);
+
+int radius_latency_bucket(double milliseconds);
+
+typedef struct radius_request radius_request;
+
+typedef struct {
+	const char *name;
+	struct sockaddr_storage address;
+	socklen_t address_length;
+
+	/* the requests waiting for a reply, by identifier */
+	radius_request *outstanding[RADIUS_IDENTIFIERS];
+	unsigned int next_identifier;
+	size_t in_flight;
+
+	size_t sent;
+	size_t accepted;
+	size_t rejected; /* Access-Reject and Access-Challenge */
+	size_t timed_out;
+	size_t invalid; /* replies which did not match a request */
+	size_t retransmits;
+	size_t histogram[RADIUS_LATENCY_BUCKETS];
+	double latency_sum; /* milliseconds, of the answered requests */
+	double latency_max;
+} radius_server;
+
+typedef struct {
+	radius_server *servers;
+	size_t servers_num;
+	const radius_credentials *credentials;
+	size_t requests;    /* in total, spread over the servers in turn */
+	size_t concurrency; /* the most requests in flight at once */
+	int retries;
+	long retransmit_ms;
+	double timeout; /* seconds for the whole run */
+} radius_load;
+
+typedef struct {
+	int errorcode;
+	char *error; /* why the run failed, or NULL */
+	size_t started;
+	double elapsed; /* seconds */
+} radius_load_result;
+
+radius_load_result radius_load_run(radius_load *load);
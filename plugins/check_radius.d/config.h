@@ -2,6 +2,7 @@
 
 #include "../../config.h"
 #include "output.h"
+#include "thresholds.h"
 #include <stddef.h>
 #if defined(HAVE_LIBRADCLI)
 #	include <radcli/radcli.h>
@@ -25,6 +26,15 @@ typedef struct {
 
 	char *expect;
 
+	/* the load test with concurrent requests, see client.h */
+	char **servers; /* every -H, the single request only goes to the last one */
+	size_t servers_num;
+	char *secret;
+	size_t requests; /* 0 for a single request through the radius library */
+	size_t concurrency;
+	long retransmit_ms;
+	mp_thresholds success_thresholds;
+
 	bool output_format_is_set;
 	mp_output_format output_format;
 } check_radius_config;
@@ -42,6 +52,14 @@ check_radius_config check_radius_config_init() {
 
 		.expect = NULL,
 
+		.servers = NULL,
+		.servers_num = 0,
+		.secret = NULL,
+		.requests = 0,
+		.concurrency = 0,
+		.retransmit_ms = 1000,
+		.success_thresholds = mp_thresholds_init(),
+
 		.output_format_is_set = false,
 	};
 	return tmp;
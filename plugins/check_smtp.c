@@ -38,8 +38,11 @@
 #include "regex.h"
 
 #include <ctype.h>
+#include <poll.h>
 #include <string.h>
+#include <sys/wait.h>
 #include "check_smtp.d/config.h"
+#include "check_smtp.d/check_smtp_helpers.h"
 #include "../lib/states.h"
 
 const char *progname = "check_smtp";
@@ -56,6 +59,33 @@ const char *email = "devel@monitoring-plugins.org";
 
 #define EHLO_SUPPORTS_STARTTLS 1
 
+/* the phases of the dialogue which are timed separately */
+typedef enum {
+	SMTP_PHASE_CONNECT,
+	SMTP_PHASE_TLS,
+	SMTP_PHASE_BANNER,
+	SMTP_PHASE_HELO,
+	SMTP_PHASE_ENVELOPE,
+	SMTP_PHASE_AUTH,
+	SMTP_PHASE_COUNT,
+} smtp_phase;
+
+static const char *smtp_phase_names[SMTP_PHASE_COUNT] = {
+	"connect", "tls", "banner", "helo", "envelope", "auth",
+};
+
+typedef struct {
+	bool measured;
+	double duration;
+} smtp_phase_timing;
+
+/* the timing of one dialogue, only complete if it ran up to the QUIT */
+typedef struct {
+	bool finished;
+	double elapsed;
+	smtp_phase_timing phases[SMTP_PHASE_COUNT];
+} smtp_dialogue_timing;
+
 typedef struct {
 	int errorcode;
 	check_smtp_config config;
@@ -96,6 +126,20 @@ static int recvline(char * /*buf*/, size_t /*bufsize*/, check_smtp_config /*conf
 static int recvlines(check_smtp_config /*config*/, char * /*buf*/, size_t /*bufsize*/,
 					 int /*socket_descriptor*/, bool /*ssl_established*/);
 static int my_close(int /*socket_descriptor*/);
+static bool smtp_is_pipelinable(const char * /*command*/);
+static mp_subcheck smtp_check_command_response(check_smtp_config /*config*/, size_t /*index*/,
+											   char * /*buffer*/);
+static mp_subcheck smtp_check_rcpt_response(const char * /*recipient*/, char * /*buffer*/,
+											int /*received*/);
+static void smtp_phase_add(smtp_phase_timing /*timings*/[SMTP_PHASE_COUNT], smtp_phase /*phase*/,
+						   struct timeval * /*phase_start*/);
+static mp_subcheck smtp_dialogue(check_smtp_config /*config*/, char * /*server_address*/,
+								 char * /*helocmd*/, char * /*cmd_str*/,
+								 smtp_dialogue_timing * /*timing*/);
+static mp_subcheck smtp_timing_subcheck(check_smtp_config /*config*/,
+										const smtp_dialogue_timing * /*timing*/,
+										const char * /*label_prefix*/);
+static mp_check smtp_sweep_mx(check_smtp_config /*config*/, char * /*helocmd*/, char * /*cmd_str*/);
 
 static int verbose = 0;
 
@@ -173,22 +217,55 @@ int main(int argc, char **argv) {
 	/* initialize alarm signal handling */
 	(void)signal(SIGALRM, socket_timeout_alarm_handler);
 
+	if (config.mx_domain != NULL) {
+		mp_exit(smtp_sweep_mx(config, helocmd, cmd_str));
+	}
+
 	/* set socket timeout */
 	(void)alarm(socket_timeout);
 
+	mp_check overall = mp_check_init();
+	mp_set_ok_summary(&overall, "SMTP connection check is OK");
+
+	smtp_dialogue_timing timing;
+	mp_subcheck dialogue =
+		smtp_dialogue(config, config.server_address, helocmd, cmd_str, &timing);
+
+	/* reset the alarm */
+	alarm(0);
+
+	for (mp_subcheck_list *step = dialogue.subchecks; step != NULL; step = step->next) {
+		mp_add_subcheck_to_check(&overall, step->subcheck);
+	}
+	if (timing.finished) {
+		mp_add_subcheck_to_check(&overall, smtp_timing_subcheck(config, &timing, NULL));
+	}
+
+	mp_exit(overall);
+}
+
+/*
+ * Runs the configured dialogue against one server, the subchecks of the
+ * returned subcheck are the results of the individual steps and the
+ * durations are stored in timing
+ */
+mp_subcheck smtp_dialogue(check_smtp_config config, char *server_address, char *helocmd,
+						  char *cmd_str, smtp_dialogue_timing *timing) {
 	struct timeval start_time;
 	/* start timer */
 	gettimeofday(&start_time, NULL);
 
+	*timing = (smtp_dialogue_timing){0};
+	struct timeval phase_start = start_time;
+
 	int socket_descriptor = 0;
 
 	/* try to connect to the host at the given port number */
 	mp_state_enum tcp_result =
-		my_tcp_connect(config.server_address, config.server_port, &socket_descriptor);
+		my_tcp_connect(server_address, config.server_port, &socket_descriptor);
 
-	mp_check overall = mp_check_init();
-
-	mp_set_ok_summary(&overall, "SMTP connection check is OK");
+	mp_subcheck result = mp_subcheck_init();
+	xasprintf(&result.output, "%s", server_address);
 
 	mp_subcheck sc_tcp_connect = mp_subcheck_init();
 	char buffer[MAX_INPUT_BUFFER];
@@ -197,10 +274,11 @@ int main(int argc, char **argv) {
 	if (tcp_result != STATE_OK) {
 		// Connect failed
 		sc_tcp_connect = mp_set_subcheck_state(sc_tcp_connect, STATE_CRITICAL);
-		xasprintf(&sc_tcp_connect.output, "TCP connect to '%s' failed", config.server_address);
-		mp_add_subcheck_to_check(&overall, sc_tcp_connect);
-		mp_exit(overall);
+		xasprintf(&sc_tcp_connect.output, "TCP connect to '%s' failed", server_address);
+		mp_add_subcheck_to_subcheck(&result, sc_tcp_connect);
+		return result;
 	}
+	smtp_phase_add(timing->phases, SMTP_PHASE_CONNECT, &phase_start);
 
 	/* we connected */
 	/* If requested, send PROXY header */
@@ -214,7 +292,7 @@ int main(int argc, char **argv) {
 #ifdef HAVE_SSL
 	if (config.use_ssl) {
 		int tls_result = np_net_ssl_init_with_hostname(
-			socket_descriptor, (config.use_sni ? config.server_address : NULL));
+			socket_descriptor, (config.use_sni ? server_address : NULL));
 
 		mp_subcheck sc_tls_connection = mp_subcheck_init();
 
@@ -224,14 +302,15 @@ int main(int argc, char **argv) {
 
 			sc_tls_connection = mp_set_subcheck_state(sc_tls_connection, STATE_CRITICAL);
 			xasprintf(&sc_tls_connection.output, "cannot create TLS context");
-			mp_add_subcheck_to_check(&overall, sc_tls_connection);
-			mp_exit(overall);
+			mp_add_subcheck_to_subcheck(&result, sc_tls_connection);
+			return result;
 		}
 
 		sc_tls_connection = mp_set_subcheck_state(sc_tls_connection, STATE_OK);
 		xasprintf(&sc_tls_connection.output, "TLS context established");
-		mp_add_subcheck_to_check(&overall, sc_tls_connection);
+		mp_add_subcheck_to_subcheck(&result, sc_tls_connection);
 		ssl_established = true;
+		smtp_phase_add(timing->phases, SMTP_PHASE_TLS, &phase_start);
 	}
 #endif
 
@@ -241,10 +320,13 @@ int main(int argc, char **argv) {
 		mp_subcheck sc_read_data = mp_subcheck_init();
 		sc_read_data = mp_set_subcheck_state(sc_read_data, STATE_WARNING);
 		xasprintf(&sc_read_data.output, "recv() failed");
-		mp_add_subcheck_to_check(&overall, sc_read_data);
-		mp_exit(overall);
+		mp_add_subcheck_to_subcheck(&result, sc_read_data);
+		my_close(socket_descriptor);
+		return result;
 	}
 
+	smtp_phase_add(timing->phases, SMTP_PHASE_BANNER, &phase_start);
+
 	char *server_response = NULL;
 	/* save connect return (220 hostname ..) for later use */
 	xasprintf(&server_response, "%s", buffer);
@@ -257,9 +339,11 @@ int main(int argc, char **argv) {
 		mp_subcheck sc_read_data = mp_subcheck_init();
 		sc_read_data = mp_set_subcheck_state(sc_read_data, STATE_WARNING);
 		xasprintf(&sc_read_data.output, "recv() failed");
-		mp_add_subcheck_to_check(&overall, sc_read_data);
-		mp_exit(overall);
+		mp_add_subcheck_to_subcheck(&result, sc_read_data);
+		my_close(socket_descriptor);
+		return result;
 	}
+	smtp_phase_add(timing->phases, SMTP_PHASE_HELO, &phase_start);
 
 	bool supports_tls = false;
 	if (config.use_ehlo || config.use_lhlo) {
@@ -274,8 +358,9 @@ int main(int argc, char **argv) {
 		mp_subcheck sc_read_data = mp_subcheck_init();
 		sc_read_data = mp_set_subcheck_state(sc_read_data, STATE_WARNING);
 		xasprintf(&sc_read_data.output, "StartTLS not supported by server");
-		mp_add_subcheck_to_check(&overall, sc_read_data);
-		mp_exit(overall);
+		mp_add_subcheck_to_subcheck(&result, sc_read_data);
+		my_close(socket_descriptor);
+		return result;
 	}
 
 #ifdef HAVE_SSL
@@ -291,24 +376,25 @@ int main(int argc, char **argv) {
 
 			xasprintf(&sc_starttls_init.output, "StartTLS not supported by server");
 			sc_starttls_init = mp_set_subcheck_state(sc_starttls_init, STATE_UNKNOWN);
-			mp_add_subcheck_to_check(&overall, sc_starttls_init);
-			mp_exit(overall);
+			mp_add_subcheck_to_subcheck(&result, sc_starttls_init);
+			my_close(socket_descriptor);
+			return result;
 		}
 
 		mp_state_enum starttls_result = np_net_ssl_init_with_hostname(
-			socket_descriptor, (config.use_sni ? config.server_address : NULL));
+			socket_descriptor, (config.use_sni ? server_address : NULL));
 		if (starttls_result != STATE_OK) {
 			close(socket_descriptor);
 			np_net_ssl_cleanup();
 
 			sc_starttls_init = mp_set_subcheck_state(sc_starttls_init, STATE_CRITICAL);
 			xasprintf(&sc_starttls_init.output, "failed to create StartTLS context");
-			mp_add_subcheck_to_check(&overall, sc_starttls_init);
-			mp_exit(overall);
+			mp_add_subcheck_to_subcheck(&result, sc_starttls_init);
+			return result;
 		}
 		sc_starttls_init = mp_set_subcheck_state(sc_starttls_init, STATE_OK);
 		xasprintf(&sc_starttls_init.output, "created StartTLS context");
-		mp_add_subcheck_to_check(&overall, sc_starttls_init);
+		mp_add_subcheck_to_subcheck(&result, sc_starttls_init);
 
 		ssl_established = true;
 
@@ -330,8 +416,8 @@ int main(int argc, char **argv) {
 			mp_subcheck sc_ehlo = mp_subcheck_init();
 			sc_ehlo = mp_set_subcheck_state(sc_ehlo, STATE_UNKNOWN);
 			xasprintf(&sc_ehlo.output, "cannot send EHLO command via StartTLS");
-			mp_add_subcheck_to_check(&overall, sc_ehlo);
-			mp_exit(overall);
+			mp_add_subcheck_to_subcheck(&result, sc_ehlo);
+			return result;
 		}
 
 		if (verbose) {
@@ -344,13 +430,16 @@ int main(int argc, char **argv) {
 			mp_subcheck sc_ehlo = mp_subcheck_init();
 			sc_ehlo = mp_set_subcheck_state(sc_ehlo, STATE_UNKNOWN);
 			xasprintf(&sc_ehlo.output, "cannot read EHLO response via StartTLS");
-			mp_add_subcheck_to_check(&overall, sc_ehlo);
-			mp_exit(overall);
+			mp_add_subcheck_to_subcheck(&result, sc_ehlo);
+			return result;
 		}
 
 		if (verbose) {
 			printf("%s", buffer);
 		}
+
+		/* the handshake and the repeated EHLO are accounted to TLS */
+		smtp_phase_add(timing->phases, SMTP_PHASE_TLS, &phase_start);
 	}
 
 #	ifdef MOPL_USE_OPENSSL
@@ -390,7 +479,7 @@ int main(int argc, char **argv) {
 		} break;
 		};
 
-		mp_add_subcheck_to_check(&overall, sc_cert_check);
+		mp_add_subcheck_to_subcheck(&result, sc_cert_check);
 	}
 #	endif /* MOPL_USE_OPENSSL */
 
@@ -400,6 +489,22 @@ int main(int argc, char **argv) {
 		printf("%s", buffer);
 	}
 
+	/* the buffer holds the (last) EHLO response here, see RFC 2920 for PIPELINING */
+	bool use_pipelining = false;
+	if (config.use_pipelining) {
+		use_pipelining = smtp_ehlo_has_keyword(buffer, "PIPELINING");
+
+		mp_subcheck sc_pipelining = mp_subcheck_init();
+		sc_pipelining = mp_set_subcheck_state(sc_pipelining, STATE_OK);
+		if (use_pipelining) {
+			xasprintf(&sc_pipelining.output, "server supports PIPELINING");
+		} else {
+			xasprintf(&sc_pipelining.output,
+					  "server does not advertise PIPELINING, sending commands one by one");
+		}
+		mp_add_subcheck_to_subcheck(&result, sc_pipelining);
+	}
+
 	/* save buffer for later use */
 	xasprintf(&server_response, "%s%s", server_response, buffer);
 	/* strip the buffer of carriage returns */
@@ -418,27 +523,105 @@ int main(int argc, char **argv) {
 					  _("invalid SMTP response received from host on port %d: %s"),
 					  config.server_port, server_response);
 		}
-		exit(STATE_WARNING);
+		mp_add_subcheck_to_subcheck(&result, sc_expect_response);
+		my_close(socket_descriptor);
+		return result;
 	} else {
 		xasprintf(&sc_expect_response.output, "received valid SMTP response '%s' from host: '%s'",
 				  config.server_expect, server_response);
 		sc_expect_response = mp_set_subcheck_state(sc_expect_response, STATE_OK);
 	}
 
-	mp_add_subcheck_to_check(&overall, sc_expect_response);
+	mp_add_subcheck_to_subcheck(&result, sc_expect_response);
+
+	/* phase timing only starts here, the expect evaluation above is local */
+	gettimeofday(&phase_start, NULL);
 
-	if (config.send_mail_from) {
+	size_t counter = 0;
+	if (use_pipelining && (config.send_mail_from || config.ncommands > 0)) {
+		/*
+		 * RFC 2920: send MAIL FROM and the leading run of pipelinable
+		 * commands as one group, then read the replies in order. QUIT
+		 * is left to smtp_quit() so that --ignore-quit-failure applies.
+		 */
+		char *group = strdup("");
+		size_t group_size = 0;
+		if (config.send_mail_from) {
+			xasprintf(&group, "%s%s", group, cmd_str);
+			group_size++;
+		}
+		for (size_t i = 0; i < config.nrecipients; i++) {
+			xasprintf(&group, "%sRCPT TO:<%s>\r\n", group, config.recipients[i]);
+			group_size++;
+		}
+		size_t pipelined_commands = 0;
+		while (pipelined_commands < config.ncommands &&
+			   smtp_is_pipelinable(config.commands[pipelined_commands])) {
+			xasprintf(&group, "%s%s\r\n", group, config.commands[pipelined_commands]);
+			pipelined_commands++;
+			group_size++;
+		}
+		if (verbose) {
+			printf(_("sending %zu pipelined commands:\n%s"), group_size, group);
+		}
+		my_send(config, group, (int)strlen(group), socket_descriptor, ssl_established);
+		free(group);
+
+		if (config.send_mail_from) {
+			if (recvlines(config, buffer, MAX_INPUT_BUFFER, socket_descriptor, ssl_established) >=
+					1 &&
+				verbose) {
+				printf("%s", buffer);
+			}
+		}
+
+		for (size_t i = 0; i < config.nrecipients; i++) {
+			int received =
+				recvlines(config, buffer, MAX_INPUT_BUFFER, socket_descriptor, ssl_established);
+			mp_add_subcheck_to_subcheck(
+				&result, smtp_check_rcpt_response(config.recipients[i], buffer, received));
+		}
+
+		for (; counter < pipelined_commands; counter++) {
+			if (recvlines(config, buffer, MAX_INPUT_BUFFER, socket_descriptor, ssl_established) >=
+					1 &&
+				verbose) {
+				printf("%s", buffer);
+			}
+
+			strip(buffer);
+
+			if (counter < config.nresponses) {
+				mp_add_subcheck_to_subcheck(&result,
+										 smtp_check_command_response(config, counter, buffer));
+			}
+		}
+	} else if (config.send_mail_from) {
 		my_send(config, cmd_str, (int)strlen(cmd_str), socket_descriptor, ssl_established);
 		if (recvlines(config, buffer, MAX_INPUT_BUFFER, socket_descriptor, ssl_established) >= 1 &&
 			verbose) {
 			printf("%s", buffer);
 		}
+
+		for (size_t i = 0; i < config.nrecipients; i++) {
+			char *rcpt_command = NULL;
+			xasprintf(&rcpt_command, "RCPT TO:<%s>\r\n", config.recipients[i]);
+			my_send(config, rcpt_command, (int)strlen(rcpt_command), socket_descriptor,
+					ssl_established);
+			free(rcpt_command);
+
+			int received =
+				recvlines(config, buffer, MAX_INPUT_BUFFER, socket_descriptor, ssl_established);
+			mp_add_subcheck_to_subcheck(
+				&result, smtp_check_rcpt_response(config.recipients[i], buffer, received));
+		}
 	}
 
-	size_t counter = 0;
 	while (counter < config.ncommands) {
-		xasprintf(&cmd_str, "%s%s", config.commands[counter], "\r\n");
-		my_send(config, cmd_str, (int)strlen(cmd_str), socket_descriptor, ssl_established);
+		char *command = NULL;
+		xasprintf(&command, "%s%s", config.commands[counter], "\r\n");
+		my_send(config, command, (int)strlen(command), socket_descriptor, ssl_established);
+		free(command);
 		if (recvlines(config, buffer, MAX_INPUT_BUFFER, socket_descriptor, ssl_established) >= 1 &&
 			verbose) {
 			printf("%s", buffer);
@@ -447,39 +630,16 @@ int main(int argc, char **argv) {
 		strip(buffer);
 
 		if (counter < config.nresponses) {
-			int cflags = REG_EXTENDED | REG_NOSUB | REG_NEWLINE;
-			regex_t preg;
-			int errcode = regcomp(&preg, config.responses[counter], cflags);
-			char errbuf[MAX_INPUT_BUFFER];
-			if (errcode != 0) {
-				regerror(errcode, &preg, errbuf, MAX_INPUT_BUFFER);
-				printf(_("Could Not Compile Regular Expression"));
-				exit(STATE_UNKNOWN);
-			}
-
-			regmatch_t pmatch[10];
-			int eflags = 0;
-			int excode = regexec(&preg, buffer, 10, pmatch, eflags);
-			mp_subcheck sc_expected_responses = mp_subcheck_init();
-			if (excode == 0) {
-				xasprintf(&sc_expected_responses.output, "valid response '%s' to command '%s'",
-						  buffer, config.commands[counter]);
-				sc_expected_responses = mp_set_subcheck_state(sc_expected_responses, STATE_OK);
-			} else if (excode == REG_NOMATCH) {
-				sc_expected_responses = mp_set_subcheck_state(sc_expected_responses, STATE_WARNING);
-				xasprintf(&sc_expected_responses.output, "invalid response '%s' to command '%s'",
-						  buffer, config.commands[counter]);
-			} else {
-				regerror(excode, &preg, errbuf, MAX_INPUT_BUFFER);
-				xasprintf(&sc_expected_responses.output, "regexec execute error: %s", errbuf);
-				sc_expected_responses = mp_set_subcheck_state(sc_expected_responses, STATE_UNKNOWN);
-			}
-
-			mp_add_subcheck_to_check(&overall, sc_expected_responses);
+			mp_add_subcheck_to_subcheck(&result,
+									 smtp_check_command_response(config, counter, buffer));
 		}
 		counter++;
 	}
 
+	if (config.send_mail_from || config.ncommands > 0) {
+		smtp_phase_add(timing->phases, SMTP_PHASE_ENVELOPE, &phase_start);
+	}
+
 	if (config.authtype != NULL) {
 		mp_subcheck sc_auth = mp_subcheck_init();
 
@@ -572,7 +732,8 @@ int main(int argc, char **argv) {
 			xasprintf(&sc_auth.output, "only authtype LOGIN is supported");
 		}
 
-		mp_add_subcheck_to_check(&overall, sc_auth);
+		mp_add_subcheck_to_subcheck(&result, sc_auth);
+		smtp_phase_add(timing->phases, SMTP_PHASE_AUTH, &phase_start);
 	}
 
 	/* tell the server we're done */
@@ -581,26 +742,272 @@ int main(int argc, char **argv) {
 	/* finally close the connection */
 	close(socket_descriptor);
 
-	/* reset the alarm */
-	alarm(0);
+	timing->elapsed = (double)deltime(start_time) / 1.0e6;
+	timing->finished = true;
 
-	long microsec = deltime(start_time);
-	double elapsed_time = (double)microsec / 1.0e6;
+	return result;
+}
+
+/* The connection time with one subcheck per phase, perfdata labels start with label_prefix */
+mp_subcheck smtp_timing_subcheck(check_smtp_config config, const smtp_dialogue_timing *timing,
+								 const char *label_prefix) {
+	if (label_prefix == NULL) {
+		label_prefix = "";
+	}
 
 	mp_perfdata pd_elapsed_time = perfdata_init();
-	pd_elapsed_time = mp_set_pd_value(pd_elapsed_time, elapsed_time);
-	pd_elapsed_time.label = "time";
+	pd_elapsed_time = mp_set_pd_value(pd_elapsed_time, timing->elapsed);
+	xasprintf(&pd_elapsed_time.label, "%stime", label_prefix);
 	pd_elapsed_time.uom = "s";
 
 	pd_elapsed_time = mp_pd_set_thresholds(pd_elapsed_time, config.connection_time);
 
 	mp_subcheck sc_connection_time = mp_subcheck_init();
-	xasprintf(&sc_connection_time.output, "connection time: %.3gs", elapsed_time);
+	xasprintf(&sc_connection_time.output, "connection time: %.3gs", timing->elapsed);
 	sc_connection_time =
 		mp_set_subcheck_state(sc_connection_time, mp_get_pd_status(pd_elapsed_time));
-	mp_add_subcheck_to_check(&overall, sc_connection_time);
+	mp_add_perfdata_to_subcheck(&sc_connection_time, pd_elapsed_time);
 
-	mp_exit(overall);
+	/* per phase timing as sub-subchecks, so the latency can be attributed */
+	for (smtp_phase phase = 0; phase < SMTP_PHASE_COUNT; phase++) {
+		if (!timing->phases[phase].measured) {
+			continue;
+		}
+
+		mp_perfdata pd_phase = perfdata_init();
+		xasprintf(&pd_phase.label, "%stime_%s", label_prefix, smtp_phase_names[phase]);
+		pd_phase.uom = "s";
+		pd_phase = mp_set_pd_value(pd_phase, timing->phases[phase].duration);
+
+		mp_subcheck sc_phase = mp_subcheck_init();
+		sc_phase = mp_set_subcheck_state(sc_phase, STATE_OK);
+		xasprintf(&sc_phase.output, "%s: %.3gs", smtp_phase_names[phase],
+				  timing->phases[phase].duration);
+		mp_add_perfdata_to_subcheck(&sc_phase, pd_phase);
+		mp_add_subcheck_to_subcheck(&sc_connection_time, sc_phase);
+	}
+
+	return sc_connection_time;
+}
+
+/* What the child of one MX sends back, the parent builds the subchecks from it */
+typedef struct {
+	mp_state_enum state;                  /* the worst state of the steps */
+	char message[SMTP_SWEEP_MESSAGE_MAX]; /* the output of the first step with that state */
+	smtp_dialogue_timing timing;
+} smtp_sweep_result;
+
+/* A dialogue which runs in a child process */
+typedef struct {
+	pid_t pid;
+	int result_fd;
+	char *output; /* verbose output or the output of die() */
+	size_t output_length;
+} smtp_sweep_child;
+
+/*
+ * Resolves the MX records of the domain and runs the dialogue against all of
+ * them at the same time. The TLS state in netutils is global, so every dialogue
+ * gets its own process which sends its result back through a pipe.
+ */
+mp_check smtp_sweep_mx(check_smtp_config config, char *helocmd, char *cmd_str) {
+	mp_check overall = mp_check_init();
+	mp_set_ok_summary(&overall, "all MX hosts passed the SMTP check");
+
+	/* the lookup is covered by the timeout as well */
+	(void)alarm(socket_timeout);
+	smtp_mx_list mx_list = smtp_resolve_mx(config.mx_domain);
+	alarm(0);
+
+	mp_subcheck sc_mx = mp_subcheck_init();
+	switch (mx_list.status) {
+	case SMTP_MX_OK:
+		xasprintf(&sc_mx.output, _("%s has %zu MX records"), config.mx_domain, mx_list.count);
+		sc_mx = mp_set_subcheck_state(sc_mx, STATE_OK);
+		break;
+	case SMTP_MX_NO_RECORDS:
+		/* RFC 5321, 5.1: without MX records the domain itself is the implicit MX */
+		mx_list.targets = calloc(1, sizeof(smtp_mx_target));
+		if (mx_list.targets == NULL) {
+			die(STATE_UNKNOWN, _("Could not calloc() units [%d]\n"), 1);
+		}
+		mx_list.targets[0].host = config.mx_domain;
+		mx_list.count = 1;
+		xasprintf(&sc_mx.output, _("%s has no MX records, using the domain itself"),
+				  config.mx_domain);
+		sc_mx = mp_set_subcheck_state(sc_mx, STATE_OK);
+		break;
+	case SMTP_MX_NULL_MX:
+		xasprintf(&sc_mx.output, _("%s does not accept mail (null MX record)"), config.mx_domain);
+		sc_mx = mp_set_subcheck_state(sc_mx, STATE_CRITICAL);
+		break;
+	case SMTP_MX_NXDOMAIN:
+		xasprintf(&sc_mx.output, _("domain %s does not exist"), config.mx_domain);
+		sc_mx = mp_set_subcheck_state(sc_mx, STATE_CRITICAL);
+		break;
+	case SMTP_MX_ERROR:
+		xasprintf(&sc_mx.output, _("failed to look up the MX records of %s"), config.mx_domain);
+		sc_mx = mp_set_subcheck_state(sc_mx, STATE_UNKNOWN);
+		break;
+	}
+
+	if (mx_list.count == 0) {
+		mp_add_subcheck_to_check(&overall, sc_mx);
+		return overall;
+	}
+
+	mp_perfdata pd_mx_count = perfdata_init();
+	pd_mx_count.label = "mx_hosts";
+	pd_mx_count = mp_set_pd_value(pd_mx_count, mx_list.count);
+	mp_add_perfdata_to_subcheck(&sc_mx, pd_mx_count);
+
+	/* the children inherit the stdio buffers, nothing may be printed twice */
+	fflush(stdout);
+
+	smtp_sweep_child *children = calloc(mx_list.count, sizeof(smtp_sweep_child));
+	struct pollfd *poll_fds = calloc(mx_list.count, sizeof(struct pollfd));
+	if (children == NULL || poll_fds == NULL) {
+		die(STATE_UNKNOWN, _("Could not calloc() units [%lu]\n"), mx_list.count);
+	}
+
+	for (size_t i = 0; i < mx_list.count; i++) {
+		int pipe_fds[2];
+		int result_fds[2];
+		if (pipe(pipe_fds) != 0 || pipe(result_fds) != 0) {
+			die(STATE_UNKNOWN, _("pipe() failed: %s\n"), strerror(errno));
+		}
+
+		pid_t pid = fork();
+		if (pid < 0) {
+			die(STATE_UNKNOWN, _("fork() failed: %s\n"), strerror(errno));
+		}
+
+		if (pid == 0) {
+			close(pipe_fds[0]);
+			close(result_fds[0]);
+			/* the pipe also catches the output of die() and of the timeout handler */
+			if (dup2(pipe_fds[1], STDOUT_FILENO) < 0) {
+				exit(STATE_UNKNOWN);
+			}
+			close(pipe_fds[1]);
+
+			smtp_sweep_result result = {0};
+			(void)alarm(socket_timeout);
+			mp_subcheck dialogue = smtp_dialogue(config, mx_list.targets[i].host, helocmd,
+												 cmd_str, &result.timing);
+			alarm(0);
+
+			result.state = smtp_worst_step(dialogue, result.message, sizeof(result.message));
+			fflush(stdout);
+			/* fits into PIPE_BUF, so the empty pipe takes it at once */
+			if (write(result_fds[1], &result, sizeof(result)) != (ssize_t)sizeof(result)) {
+				exit(STATE_UNKNOWN);
+			}
+			exit(STATE_OK);
+		}
+
+		close(pipe_fds[1]);
+		close(result_fds[1]);
+		children[i].pid = pid;
+		children[i].result_fd = result_fds[0];
+		poll_fds[i].fd = pipe_fds[0];
+		poll_fds[i].events = POLLIN;
+	}
+
+	/* the children enforce the timeout themselves, this only guards against hangs */
+	(void)alarm(socket_timeout + 1);
+
+	size_t open_pipes = mx_list.count;
+	while (open_pipes > 0) {
+		if (poll(poll_fds, mx_list.count, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			die(STATE_UNKNOWN, _("poll() failed: %s\n"), strerror(errno));
+		}
+
+		for (size_t i = 0; i < mx_list.count; i++) {
+			if (poll_fds[i].fd < 0 || poll_fds[i].revents == 0) {
+				continue;
+			}
+
+			char chunk[MAX_INPUT_BUFFER];
+			ssize_t received = read(poll_fds[i].fd, chunk, sizeof(chunk));
+			if (received > 0) {
+				children[i].output =
+					realloc(children[i].output, children[i].output_length + (size_t)received + 1);
+				if (children[i].output == NULL) {
+					die(STATE_UNKNOWN, _("Could not realloc() units [%lu]\n"),
+						children[i].output_length + (size_t)received + 1);
+				}
+				memcpy(&children[i].output[children[i].output_length], chunk, (size_t)received);
+				children[i].output_length += (size_t)received;
+				children[i].output[children[i].output_length] = '\0';
+			} else if (received == 0 || errno != EINTR) {
+				close(poll_fds[i].fd);
+				poll_fds[i].fd = -1;
+				open_pipes--;
+			}
+		}
+	}
+
+	alarm(0);
+
+	/* mp_add_subcheck_to_check prepends, go backwards to list the MX by preference */
+	for (size_t i = mx_list.count; i-- > 0;) {
+		int status = 0;
+		waitpid(children[i].pid, &status, 0);
+
+		/* the child has exited, a complete result is already in the pipe */
+		smtp_sweep_result result;
+		bool has_result =
+			read(children[i].result_fd, &result, sizeof(result)) == (ssize_t)sizeof(result);
+		close(children[i].result_fd);
+
+		char *output = (children[i].output != NULL) ? children[i].output : "";
+		if (verbose && has_result) {
+			printf("%s", output);
+		}
+
+		mp_subcheck sc_target = mp_subcheck_init();
+		if (has_result) {
+			if (result.state != STATE_OK) {
+				result.message[sizeof(result.message) - 1] = '\0';
+				mp_subcheck sc_step = mp_subcheck_init();
+				sc_step = mp_set_subcheck_state(sc_step, result.state);
+				xasprintf(&sc_step.output, "%s", result.message);
+				mp_add_subcheck_to_subcheck(&sc_target, sc_step);
+			}
+			if (result.timing.finished) {
+				char *label_prefix = NULL;
+				xasprintf(&label_prefix, "%s_", mx_list.targets[i].host);
+				mp_add_subcheck_to_subcheck(
+					&sc_target, smtp_timing_subcheck(config, &result.timing, label_prefix));
+			}
+		} else {
+			/* the dialogue was aborted, e.g. by die() or by the socket timeout */
+			mp_state_enum state = STATE_UNKNOWN;
+			if (WIFEXITED(status) && WEXITSTATUS(status) > STATE_OK &&
+				WEXITSTATUS(status) <= STATE_UNKNOWN) {
+				state = (mp_state_enum)WEXITSTATUS(status);
+			}
+
+			/* the summary line is enough, the details were printed for a single host */
+			output[strcspn(output, "\n")] = '\0';
+			mp_subcheck sc_aborted = mp_subcheck_init();
+			sc_aborted = mp_set_subcheck_state(sc_aborted, state);
+			xasprintf(&sc_aborted.output, _("dialogue aborted: %s"),
+					  (output[0] != '\0') ? output : _("no output"));
+			mp_add_subcheck_to_subcheck(&sc_target, sc_aborted);
+		}
+
+		xasprintf(&sc_target.output, "MX %s (preference %u)", mx_list.targets[i].host,
+				  mx_list.targets[i].preference);
+		mp_add_subcheck_to_check(&overall, sc_target);
+	}
+
+	mp_add_subcheck_to_check(&overall, sc_mx);
+	return overall;
 }
 
 /* process command-line arguments */
@@ -609,6 +1016,9 @@ check_smtp_config_wrapper process_arguments(int argc, char **argv) {
 		SNI_OPTION = CHAR_MAX + 1,
 		output_format_index,
 		ignore_certificate_expiration_index,
+		pipelining_index,
+		rcpt_index,
+		mx_index,
 	};
 
 	int option = 0;
@@ -639,6 +1049,9 @@ check_smtp_config_wrapper process_arguments(int argc, char **argv) {
 		{"certificate", required_argument, 0, 'D'},
 		{"ignore-quit-failure", no_argument, 0, 'q'},
 		{"proxy", no_argument, 0, 'r'},
+		{"pipelining", no_argument, 0, pipelining_index},
+		{"rcpt", required_argument, 0, rcpt_index},
+		{"mx", required_argument, 0, mx_index},
 		{"ignore-certificate-expiration", no_argument, 0, ignore_certificate_expiration_index},
 		{"output-format", required_argument, 0, output_format_index},
 		{0, 0, 0, 0}};
@@ -818,6 +1231,26 @@ check_smtp_config_wrapper process_arguments(int argc, char **argv) {
 		case 'r':
 			result.config.use_proxy_prefix = true;
 			break;
+		case pipelining_index:
+			result.config.use_pipelining = true;
+			break;
+		case rcpt_index:
+			result.config.recipients = realloc(
+				result.config.recipients, sizeof(char *) * (result.config.nrecipients + 1));
+			if (result.config.recipients == NULL) {
+				die(STATE_UNKNOWN, _("Could not realloc() units [%lu]\n"),
+					result.config.nrecipients);
+			}
+			result.config.recipients[result.config.nrecipients] = optarg + strspn(optarg, "<");
+			result.config.recipients[result.config.nrecipients] =
+				strndup(result.config.recipients[result.config.nrecipients],
+						strcspn(result.config.recipients[result.config.nrecipients], ">"));
+			result.config.nrecipients++;
+			break;
+		case mx_index:
+			/* a mail domain does not need an address of its own, the lookup validates it */
+			result.config.mx_domain = optarg;
+			break;
 		case 'L':
 			result.config.use_lhlo = true;
 			break;
@@ -854,7 +1287,11 @@ check_smtp_config_wrapper process_arguments(int argc, char **argv) {
 	}
 
 	int c = optind;
-	if (result.config.server_address == NULL) {
+	if (result.config.mx_domain != NULL) {
+		if (result.config.server_address != NULL || argv[c] != NULL) {
+			usage4(_("Set either -H/--hostname or --mx"));
+		}
+	} else if (result.config.server_address == NULL) {
 		if (argv[c]) {
 			if (is_host(argv[c])) {
 				result.config.server_address = argv[c];
@@ -875,6 +1312,17 @@ check_smtp_config_wrapper process_arguments(int argc, char **argv) {
 		usage4(_("Set either -s/--ssl/--tls or -S/--starttls"));
 	}
 
+	/* PIPELINING is an ESMTP extension, it needs EHLO unless LHLO is used anyway */
+	if (result.config.use_pipelining && !result.config.use_lhlo) {
+		result.config.use_ehlo = true;
+	}
+
+	/* RCPT TO needs a transaction, fall back to the null sender */
+	if (result.config.nrecipients > 0 && !result.config.send_mail_from) {
+		result.config.from_arg = "";
+		result.config.send_mail_from = true;
+	}
+
 	if (server_port_option != 0) {
 		result.config.server_port = server_port_option;
 	}
@@ -995,6 +1443,94 @@ int my_close(int socket_descriptor) {
 	return result;
 }
 
+/*
+ * Commands which may appear anywhere in a pipelined group (RFC 2920, 3.1).
+ * Everything else has to wait for the replies before it is sent.
+ */
+bool smtp_is_pipelinable(const char *command) {
+	static const char *pipelinable[] = {"MAIL FROM:", "RCPT TO:", "RSET", "SEND FROM:",
+										"SOML FROM:", "SAML FROM:"};
+
+	for (size_t i = 0; i < sizeof(pipelinable) / sizeof(pipelinable[0]); i++) {
+		if (strncasecmp(command, pipelinable[i], strlen(pipelinable[i])) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Matches the reply to a -C command against the corresponding -R regex */
+mp_subcheck smtp_check_command_response(check_smtp_config config, size_t index, char *buffer) {
+	int cflags = REG_EXTENDED | REG_NOSUB | REG_NEWLINE;
+	regex_t preg;
+	int errcode = regcomp(&preg, config.responses[index], cflags);
+	char errbuf[MAX_INPUT_BUFFER];
+	if (errcode != 0) {
+		regerror(errcode, &preg, errbuf, MAX_INPUT_BUFFER);
+		printf(_("Could Not Compile Regular Expression"));
+		exit(STATE_UNKNOWN);
+	}
+
+	regmatch_t pmatch[10];
+	int eflags = 0;
+	int excode = regexec(&preg, buffer, 10, pmatch, eflags);
+	mp_subcheck sc_expected_responses = mp_subcheck_init();
+	if (excode == 0) {
+		xasprintf(&sc_expected_responses.output, "valid response '%s' to command '%s'", buffer,
+				  config.commands[index]);
+		sc_expected_responses = mp_set_subcheck_state(sc_expected_responses, STATE_OK);
+	} else if (excode == REG_NOMATCH) {
+		sc_expected_responses = mp_set_subcheck_state(sc_expected_responses, STATE_WARNING);
+		xasprintf(&sc_expected_responses.output, "invalid response '%s' to command '%s'", buffer,
+				  config.commands[index]);
+	} else {
+		regerror(excode, &preg, errbuf, MAX_INPUT_BUFFER);
+		xasprintf(&sc_expected_responses.output, "regexec execute error: %s", errbuf);
+		sc_expected_responses = mp_set_subcheck_state(sc_expected_responses, STATE_UNKNOWN);
+	}
+	regfree(&preg);
+
+	return sc_expected_responses;
+}
+
+/* RCPT TO is accepted with 250 or 251, 4xx is a temporary and 5xx a permanent rejection */
+mp_subcheck smtp_check_rcpt_response(const char *recipient, char *buffer, int received) {
+	mp_subcheck sc_rcpt = mp_subcheck_init();
+
+	if (received <= 0) {
+		xasprintf(&sc_rcpt.output, _("no response to RCPT TO:<%s>"), recipient);
+		sc_rcpt = mp_set_subcheck_state(sc_rcpt, STATE_WARNING);
+		return sc_rcpt;
+	}
+
+	if (verbose) {
+		printf("%s", buffer);
+	}
+	strip(buffer);
+
+	if (buffer[0] == '2') {
+		xasprintf(&sc_rcpt.output, _("recipient <%s> accepted: '%s'"), recipient, buffer);
+		sc_rcpt = mp_set_subcheck_state(sc_rcpt, STATE_OK);
+	} else if (buffer[0] == '4') {
+		xasprintf(&sc_rcpt.output, _("recipient <%s> temporarily rejected: '%s'"), recipient,
+				  buffer);
+		sc_rcpt = mp_set_subcheck_state(sc_rcpt, STATE_WARNING);
+	} else {
+		xasprintf(&sc_rcpt.output, _("recipient <%s> rejected: '%s'"), recipient, buffer);
+		sc_rcpt = mp_set_subcheck_state(sc_rcpt, STATE_CRITICAL);
+	}
+
+	return sc_rcpt;
+}
+
+/* Accounts the time since phase_start to phase and restarts the phase timer */
+void smtp_phase_add(smtp_phase_timing timings[SMTP_PHASE_COUNT], smtp_phase phase,
+					struct timeval *phase_start) {
+	timings[phase].measured = true;
+	timings[phase].duration += (double)deltime(*phase_start) / 1.0e6;
+	gettimeofday(phase_start, NULL);
+}
+
 void print_help(void) {
 	char *myport;
 	xasprintf(&myport, "%d", SMTP_PORT);
@@ -1030,6 +1566,16 @@ void print_help(void) {
 	printf("    %s\n", _("FQDN used for HELO"));
 	printf(" %s\n", "-r, --proxy");
 	printf("    %s\n", _("Use PROXY protocol prefix for the connection."));
+	printf(" %s\n", "--pipelining");
+	printf("    %s\n", _("Use EHLO (or LHLO with -L) and, if the server advertises PIPELINING"));
+	printf("    %s\n", _("(RFC 2920), send MAIL FROM and the following RCPT TO/RSET commands"));
+	printf("    %s\n", _("as one group"));
+	printf(" %s\n", "--rcpt=ADDRESS");
+	printf("    %s\n", _("Send RCPT TO for this address after MAIL FROM (may be used repeatedly)"));
+	printf("    %s\n", _("4xx replies result in WARNING, 5xx replies in CRITICAL"));
+	printf(" %s\n", "--mx=DOMAIN");
+	printf("    %s\n", _("Check all MX hosts of DOMAIN at the same time instead of -H, every MX"));
+	printf("    %s\n", _("is reported on its own with its perfdata prefixed by the host name"));
 #ifdef HAVE_SSL
 	printf(" %s\n", "-D, --certificate=INTEGER[,INTEGER]");
 	printf("    %s\n", _("Minimum number of days a certificate has to be valid."));
@@ -1078,5 +1624,6 @@ void print_usage(void) {
 		   progname);
 	printf("[-A authtype -U authuser -P authpass] [-w warn] [-c crit] [-t timeout] [-q]\n");
 	printf("[-F fqdn] [-S] [-L] [-D warn days cert expire[,crit days cert expire]] [-r] [--sni] "
-		   "[-v] \n");
+		   "[--pipelining] [-v] \n");
+	printf("[--rcpt address] [--mx domain]\n");
 }
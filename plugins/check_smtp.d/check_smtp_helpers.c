@@ -0,0 +1,147 @@
+#include "../common.h"
+#include "./check_smtp_helpers.h"
+#include "../utils.h"
+#include "states.h"
+
+#include <arpa/nameser.h>
+#include <ctype.h>
+#include <netdb.h>
+#include <resolv.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int smtp_mx_compare(const void *left, const void *right) {
+	const smtp_mx_target *mx_left = left;
+	const smtp_mx_target *mx_right = right;
+
+	if (mx_left->preference != mx_right->preference) {
+		return (mx_left->preference < mx_right->preference) ? -1 : 1;
+	}
+	return strcasecmp(mx_left->host, mx_right->host);
+}
+
+smtp_mx_list smtp_parse_mx_answer(const unsigned char *answer, int length) {
+	smtp_mx_list result = {
+		.status = SMTP_MX_OK,
+		.targets = NULL,
+		.count = 0,
+	};
+
+	ns_msg handle;
+	if (ns_initparse(answer, length, &handle) < 0) {
+		result.status = SMTP_MX_ERROR;
+		return result;
+	}
+
+	if (ns_msg_getflag(handle, ns_f_rcode) == ns_r_nxdomain) {
+		result.status = SMTP_MX_NXDOMAIN;
+		return result;
+	}
+	if (ns_msg_getflag(handle, ns_f_rcode) != ns_r_noerror) {
+		result.status = SMTP_MX_ERROR;
+		return result;
+	}
+
+	bool null_mx = false;
+	int answer_count = ns_msg_count(handle, ns_s_an);
+	for (int i = 0; i < answer_count && result.count < SMTP_MAX_MX_TARGETS; i++) {
+		ns_rr record;
+		if (ns_parserr(&handle, ns_s_an, i, &record) < 0) {
+			result.status = SMTP_MX_ERROR;
+			return result;
+		}
+
+		/* the answer may start with the CNAME chain leading to the MX records */
+		if (ns_rr_type(record) != ns_t_mx || ns_rr_rdlen(record) < 3) {
+			continue;
+		}
+
+		const unsigned char *rdata = ns_rr_rdata(record);
+		char host[NS_MAXDNAME];
+		if (dn_expand(ns_msg_base(handle), ns_msg_end(handle), rdata + NS_INT16SZ, host,
+					  sizeof(host)) < 0) {
+			continue;
+		}
+
+		/* RFC 7505: a single MX with the root as exchange means "no mail service" */
+		if (host[0] == '\0') {
+			null_mx = true;
+			continue;
+		}
+
+		result.targets = realloc(result.targets, (result.count + 1) * sizeof(smtp_mx_target));
+		if (result.targets == NULL) {
+			die(STATE_UNKNOWN, _("Could not realloc() units [%lu]\n"), result.count + 1);
+		}
+		result.targets[result.count].host = strdup(host);
+		result.targets[result.count].preference = ns_get16(rdata);
+		result.count++;
+	}
+
+	if (result.count == 0) {
+		result.status = null_mx ? SMTP_MX_NULL_MX : SMTP_MX_NO_RECORDS;
+		return result;
+	}
+
+	qsort(result.targets, result.count, sizeof(smtp_mx_target), smtp_mx_compare);
+	return result;
+}
+
+smtp_mx_list smtp_resolve_mx(const char *domain) {
+	unsigned char answer[NS_MAXMSG];
+
+	if (res_init() != 0) {
+		smtp_mx_list result = {.status = SMTP_MX_ERROR};
+		return result;
+	}
+
+	int length = res_query(domain, ns_c_in, ns_t_mx, answer, sizeof(answer));
+	if (length < 0) {
+		smtp_mx_list result = {.status = SMTP_MX_ERROR};
+		switch (h_errno) {
+		case HOST_NOT_FOUND:
+			result.status = SMTP_MX_NXDOMAIN;
+			break;
+		case NO_DATA:
+			result.status = SMTP_MX_NO_RECORDS;
+			break;
+		}
+		return result;
+	}
+
+	return smtp_parse_mx_answer(answer, length);
+}
+
+mp_state_enum smtp_worst_step(mp_subcheck dialogue, char *message, size_t size) {
+	mp_state_enum worst = STATE_OK;
+	const char *worst_output = NULL;
+	for (mp_subcheck_list *step = dialogue.subchecks; step != NULL; step = step->next) {
+		mp_state_enum state = mp_compute_subcheck_state(step->subcheck);
+		if (state != STATE_OK && max_state_alt(worst, state) != worst) {
+			worst = state;
+			worst_output = step->subcheck.output;
+		}
+	}
+
+	snprintf(message, size, "%s", (worst_output != NULL) ? worst_output : "");
+	return worst;
+}
+
+bool smtp_ehlo_has_keyword(const char *response, const char *keyword) {
+	size_t keyword_length = strlen(keyword);
+	for (const char *line = response; line != NULL; line = strchr(line, '\n')) {
+		if (*line == '\n') {
+			line++;
+		}
+		/* "250-KEYWORD params" or "250 KEYWORD", the keyword is not case sensitive */
+		if (strlen(line) >= 4 + keyword_length && isdigit((unsigned char)line[0]) &&
+			isdigit((unsigned char)line[1]) && isdigit((unsigned char)line[2]) &&
+			(line[3] == '-' || line[3] == ' ') &&
+			strncasecmp(&line[4], keyword, keyword_length) == 0 &&
+			(line[4 + keyword_length] == '\0' ||
+			 isspace((unsigned char)line[4 + keyword_length]))) {
+			return true;
+		}
+	}
+	return false;
+}
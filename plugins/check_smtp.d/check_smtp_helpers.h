@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../../config.h"
+#include "output.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Upper bound on the number of MX targets which are checked in one run */
+#define SMTP_MAX_MX_TARGETS 64
+
+/* Length of the message an MX dialogue sends back, keeps the result below PIPE_BUF */
+#define SMTP_SWEEP_MESSAGE_MAX 512
+
+typedef struct {
+	char *host;
+	unsigned int preference;
+} smtp_mx_target;
+
+typedef enum {
+	SMTP_MX_OK = 0,
+	SMTP_MX_NO_RECORDS, /* the domain exists but has no MX records */
+	SMTP_MX_NULL_MX,    /* the domain does not accept mail (RFC 7505) */
+	SMTP_MX_NXDOMAIN,
+	SMTP_MX_ERROR,
+} smtp_mx_status;
+
+typedef struct {
+	smtp_mx_status status;
+	smtp_mx_target *targets; /* sorted by preference */
+	size_t count;
+} smtp_mx_list;
+
+/* Looks up the MX records of domain */
+smtp_mx_list smtp_resolve_mx(const char *domain);
+/* Decodes the MX records in a DNS answer, used by smtp_resolve_mx */
+smtp_mx_list smtp_parse_mx_answer(const unsigned char *answer, int length);
+
+/*
+ * Whether an EHLO or LHLO response advertises the extension keyword, which
+ * starts a response line after the reply code (RFC 5321, 4.1.1.1)
+ */
+bool smtp_ehlo_has_keyword(const char *response, const char *keyword);
+
+/*
+ * The worst state of the steps of a dialogue, the output of the first step with
+ * that state is copied to message. The message is empty if every step is OK.
+ */
+mp_state_enum smtp_worst_step(mp_subcheck dialogue, char *message, size_t size);
@@ -28,6 +28,11 @@ typedef struct {
 	char *from_arg;
 	bool send_mail_from;
 
+	size_t nrecipients;
+	char **recipients;
+
+	char *mx_domain; /* check all MX hosts of this domain instead of server_address */
+
 	unsigned long ncommands;
 	char **commands;
 
@@ -39,6 +44,7 @@ typedef struct {
 	char *authpass;
 
 	bool use_proxy_prefix;
+	bool use_pipelining;
 #ifdef HAVE_SSL
 	unsigned int days_till_exp_warn;
 	unsigned int days_till_exp_crit;
@@ -69,6 +75,11 @@ check_smtp_config check_smtp_config_init(void) {
 		.from_arg = strdup(" "),
 		.send_mail_from = false,
 
+		.nrecipients = 0,
+		.recipients = NULL,
+
+		.mx_domain = NULL,
+
 		.ncommands = 0,
 		.commands = NULL,
 
@@ -80,6 +91,7 @@ check_smtp_config check_smtp_config_init(void) {
 		.authpass = NULL,
 
 		.use_proxy_prefix = false,
+		.use_pipelining = false,
 #ifdef HAVE_SSL
 		.days_till_exp_warn = 0,
 		.days_till_exp_crit = 0,
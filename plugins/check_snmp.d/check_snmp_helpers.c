@@ -600,341 +600,3 @@ check_snmp_evaluation evaluate_single_unit(response_value response,
 
 	return result;
 }
-
-char *_np_state_generate_key(int argc, char **argv);
-
-/*
- * If time=NULL, use current time. Create state file, with state format
- * version, default text. Writes version, time, and data. Avoid locking
- * problems - use mv to write and then swap. Possible loss of state data if
- * two things writing to same key at same time.
- * Will die with UNKNOWN if errors
- */
-void np_state_write_string(state_key stateKey, time_t timestamp, char *stringToStore) {
-	time_t current_time;
-	if (timestamp == 0) {
-		time(&current_time);
-	} else {
-		current_time = timestamp;
-	}
-
-	int result = 0;
-
-	/* If file doesn't currently exist, create directories */
-	if (access(stateKey._filename, F_OK) != 0) {
-		char *directories = NULL;
-		result = asprintf(&directories, "%s", stateKey._filename);
-		if (result < 0) {
-			die(STATE_UNKNOWN, _("Cannot allocate memory: %s"), strerror(errno));
-		}
-
-		for (char *p = directories + 1; *p; p++) {
-			if (*p == '/') {
-				*p = '\0';
-				if ((access(directories, F_OK) != 0) && (mkdir(directories, S_IRWXU) != 0)) {
-					/* Can't free this! Otherwise error message is wrong! */
-					/* np_free(directories); */
-					die(STATE_UNKNOWN, _("Cannot create directory: %s"), directories);
-				}
-				*p = '/';
-			}
-		}
-
-		if (directories) {
-			free(directories);
-		}
-	}
-
-	char *temp_file = NULL;
-	result = asprintf(&temp_file, "%s.XXXXXX", stateKey._filename);
-	if (result < 0) {
-		die(STATE_UNKNOWN, _("Cannot allocate memory: %s"), strerror(errno));
-	}
-
-	int temp_file_desc = 0;
-	if ((temp_file_desc = mkstemp(temp_file)) == -1) {
-		if (temp_file) {
-			free(temp_file);
-		}
-		die(STATE_UNKNOWN, _("Cannot create temporary filename"));
-	}
-
-	FILE *temp_file_pointer = fdopen(temp_file_desc, "w");
-	if (temp_file_pointer == NULL) {
-		close(temp_file_desc);
-		unlink(temp_file);
-		if (temp_file) {
-			free(temp_file);
-		}
-		die(STATE_UNKNOWN, _("Unable to open temporary state file"));
-	}
-
-	fprintf(temp_file_pointer, "# NP State file\n");
-	fprintf(temp_file_pointer, "%d\n", NP_STATE_FORMAT_VERSION);
-	fprintf(temp_file_pointer, "%d\n", stateKey.data_version);
-	fprintf(temp_file_pointer, "%lu\n", current_time);
-	fprintf(temp_file_pointer, "%s\n", stringToStore);
-
-	fchmod(temp_file_desc, S_IRUSR | S_IWUSR | S_IRGRP);
-
-	fflush(temp_file_pointer);
-
-	result = fclose(temp_file_pointer);
-
-	fsync(temp_file_desc);
-
-	if (result != 0) {
-		unlink(temp_file);
-		if (temp_file) {
-			free(temp_file);
-		}
-		die(STATE_UNKNOWN, _("Error writing temp file"));
-	}
-
-	if (rename(temp_file, stateKey._filename) != 0) {
-		unlink(temp_file);
-		if (temp_file) {
-			free(temp_file);
-		}
-		die(STATE_UNKNOWN, _("Cannot rename state temp file"));
-	}
-
-	if (temp_file) {
-		free(temp_file);
-	}
-}
-
-/*
- * Read the state file
- */
-bool _np_state_read_file(FILE *state_file, state_key stateKey) {
-	time_t current_time;
-	time(&current_time);
-
-	/* Note: This introduces a limit of 8192 bytes in the string data */
-	char *line = (char *)calloc(1, 8192);
-	if (line == NULL) {
-		die(STATE_UNKNOWN, _("Cannot allocate memory: %s"), strerror(errno));
-	}
-
-	bool status = false;
-	enum {
-		STATE_FILE_VERSION,
-		STATE_DATA_VERSION,
-		STATE_DATA_TIME,
-		STATE_DATA_TEXT,
-		STATE_DATA_END
-	} expected = STATE_FILE_VERSION;
-
-	int failure = 0;
-	while (!failure && (fgets(line, 8192, state_file)) != NULL) {
-		size_t pos = strlen(line);
-		if (line[pos - 1] == '\n') {
-			line[pos - 1] = '\0';
-		}
-
-		if (line[0] == '#') {
-			continue;
-		}
-
-		switch (expected) {
-		case STATE_FILE_VERSION: {
-			int i = atoi(line);
-			if (i != NP_STATE_FORMAT_VERSION) {
-				failure++;
-			} else {
-				expected = STATE_DATA_VERSION;
-			}
-		} break;
-		case STATE_DATA_VERSION: {
-			int i = atoi(line);
-			if (i != stateKey.data_version) {
-				failure++;
-			} else {
-				expected = STATE_DATA_TIME;
-			}
-		} break;
-		case STATE_DATA_TIME: {
-			/* If time > now, error */
-			time_t data_time = strtoul(line, NULL, 10);
-			if (data_time > current_time) {
-				failure++;
-			} else {
-				stateKey.state_data->time = data_time;
-				expected = STATE_DATA_TEXT;
-			}
-		} break;
-		case STATE_DATA_TEXT:
-			stateKey.state_data->data = strdup(line);
-			if (stateKey.state_data->data == NULL) {
-				die(STATE_UNKNOWN, _("Cannot execute strdup: %s"), strerror(errno));
-			}
-			stateKey.state_data->length = strlen(line);
-			expected = STATE_DATA_END;
-			status = true;
-			break;
-		case STATE_DATA_END:;
-		}
-	}
-
-	if (line) {
-		free(line);
-	}
-	return status;
-}
-/*
- * Will return NULL if no data is available (first run). If key currently
- * exists, read data. If state file format version is not expected, return
- * as if no data. Get state data version number and compares to expected.
- * If numerically lower, then return as no previous state. die with UNKNOWN
- * if exceptional error.
- */
-state_data *np_state_read(state_key stateKey) {
-	/* Open file. If this fails, no previous state found */
-	FILE *statefile = fopen(stateKey._filename, "r");
-	state_data *this_state_data = (state_data *)calloc(1, sizeof(state_data));
-	if (statefile != NULL) {
-
-		if (this_state_data == NULL) {
-			die(STATE_UNKNOWN, _("Cannot allocate memory: %s"), strerror(errno));
-		}
-
-		this_state_data->data = NULL;
-		stateKey.state_data = this_state_data;
-
-		if (_np_state_read_file(statefile, stateKey)) {
-			this_state_data->errorcode = OK;
-		} else {
-			this_state_data->errorcode = ERROR;
-		}
-
-		fclose(statefile);
-	} else {
-		// Failed to open state file
-		this_state_data->errorcode = ERROR;
-	}
-
-	return stateKey.state_data;
-}
-
-/*
- * Internal function. Returns either:
- *   envvar NAGIOS_PLUGIN_STATE_DIRECTORY
- *   statically compiled shared state directory
- */
-char *_np_state_calculate_location_prefix(void) {
-	char *env_dir;
-
-	/* Do not allow passing MP_STATE_PATH in setuid plugins
-	 * for security reasons */
-	if (!mp_suid()) {
-		env_dir = getenv("MP_STATE_PATH");
-		if (env_dir && env_dir[0] != '\0') {
-			return env_dir;
-		}
-		/* This is the former ENV, for backward-compatibility */
-		env_dir = getenv("NAGIOS_PLUGIN_STATE_DIRECTORY");
-		if (env_dir && env_dir[0] != '\0') {
-			return env_dir;
-		}
-	}
-
-	return NP_STATE_DIR_PREFIX;
-}
-
-/*
- * Initiatializer for state routines.
- * Sets variables. Generates filename. Returns np_state_key. die with
- * UNKNOWN if exception
- */
-state_key np_enable_state(char *keyname, int expected_data_version, const char *plugin_name,
-						  int argc, char **argv) {
-	state_key *this_state = (state_key *)calloc(1, sizeof(state_key));
-	if (this_state == NULL) {
-		die(STATE_UNKNOWN, _("Cannot allocate memory: %s"), strerror(errno));
-	}
-
-	char *temp_keyname = NULL;
-	if (keyname == NULL) {
-		temp_keyname = _np_state_generate_key(argc, argv);
-	} else {
-		temp_keyname = strdup(keyname);
-		if (temp_keyname == NULL) {
-			die(STATE_UNKNOWN, _("Cannot execute strdup: %s"), strerror(errno));
-		}
-	}
-
-	/* Die if invalid characters used for keyname */
-	char *tmp_char = temp_keyname;
-	while (*tmp_char != '\0') {
-		if (!(isalnum(*tmp_char) || *tmp_char == '_')) {
-			die(STATE_UNKNOWN, _("Invalid character for keyname - only alphanumerics or '_'"));
-		}
-		tmp_char++;
-	}
-	this_state->name = temp_keyname;
-	this_state->plugin_name = (char *)plugin_name;
-	this_state->data_version = expected_data_version;
-	this_state->state_data = NULL;
-
-	/* Calculate filename */
-	char *temp_filename = NULL;
-	int error = asprintf(&temp_filename, "%s/%lu/%s/%s", _np_state_calculate_location_prefix(),
-						 (unsigned long)geteuid(), plugin_name, this_state->name);
-	if (error < 0) {
-		die(STATE_UNKNOWN, _("Cannot allocate memory: %s"), strerror(errno));
-	}
-
-	this_state->_filename = temp_filename;
-
-	return *this_state;
-}
-
-/*
- * Returns a string to use as a keyname, based on an md5 hash of argv, thus
- * hopefully a unique key per service/plugin invocation. Use the extra-opts
- * parse of argv, so that uniqueness in parameters are reflected there.
- */
-char *_np_state_generate_key(int argc, char **argv) {
-	unsigned char result[256];
-
-#ifdef USE_OPENSSL
-	/*
-	 * This code path is chosen if openssl is available (which should be the most common
-	 * scenario). Alternatively, the gnulib implementation/
-	 *
-	 */
-	EVP_MD_CTX *ctx = EVP_MD_CTX_new();
-
-	EVP_DigestInit(ctx, EVP_sha256());
-
-	for (int i = 0; i < argc; i++) {
-		EVP_DigestUpdate(ctx, argv[i], strlen(argv[i]));
-	}
-
-	EVP_DigestFinal(ctx, result, NULL);
-#else
-
-	struct sha256_ctx ctx;
-
-	for (int i = 0; i < this_monitoring_plugin->argc; i++) {
-		sha256_process_bytes(argv[i], strlen(argv[i]), &ctx);
-	}
-
-	sha256_finish_ctx(&ctx, result);
-#endif // FOUNDOPENSSL
-
-	char keyname[41];
-	for (int i = 0; i < 20; ++i) {
-		sprintf(&keyname[2 * i], "%02x", result[i]);
-	}
-
-	keyname[40] = '\0';
-
-	char *keyname_copy = strdup(keyname);
-	if (keyname_copy == NULL) {
-		die(STATE_UNKNOWN, _("Cannot execute strdup: %s"), strerror(errno));
-	}
-
-	return keyname_copy;
-}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "./config.h"
+#include "../../lib/utils_base.h"
 #include <net-snmp/library/asn1.h>
 
 check_snmp_test_unit check_snmp_test_unit_init();
@@ -48,25 +49,3 @@ check_snmp_evaluation evaluate_single_unit(response_value response,
 										   check_snmp_test_unit test_unit, time_t query_timestamp,
 										   check_snmp_state_entry prev_state,
 										   bool have_previous_state);
-
-#define NP_STATE_FORMAT_VERSION 1
-
-typedef struct state_data_struct {
-	time_t time;
-	void *data;
-	size_t length; /* Of binary data */
-	int errorcode;
-} state_data;
-
-typedef struct state_key_struct {
-	char *name;
-	char *plugin_name;
-	int data_version;
-	char *_filename;
-	state_data *state_data;
-} state_key;
-
-state_data *np_state_read(state_key stateKey);
-state_key np_enable_state(char *keyname, int expected_data_version, const char *plugin_name,
-						  int argc, char **argv);
-void np_state_write_string(state_key stateKey, time_t timestamp, char *stringToStore);
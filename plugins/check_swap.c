@@ -44,6 +44,7 @@
 #endif
 
 #include <stdint.h>
+#include <sys/time.h>
 #include "./check_swap.d/check_swap.h"
 #include "./utils.h"
 
@@ -55,6 +56,7 @@ typedef struct {
 static swap_config_wrapper process_arguments(int argc, char **argv);
 void print_usage(void);
 static void print_help(swap_config /*config*/);
+static mp_subcheck evaluate_swap_rates(swap_config config, int argc, char **argv);
 
 int verbose;
 
@@ -63,6 +65,10 @@ int verbose;
 #define BYTES_TO_KiB(number) (number / 1024)
 #define BYTES_TO_MiB(number) (BYTES_TO_KiB(number) / 1024)
 
+/* a previous run longer ago than this is not used for the rates, but a second sample instead */
+#define SWAP_RATE_MAX_STATE_AGE 3600
+#define SWAP_RATE_STATE_VERSION 1
+
 const char *progname = "check_swap";
 const char *copyright = "2000-2024";
 const char *email = "devel@monitoring-plugins.org";
@@ -106,6 +112,11 @@ int main(int argc, char **argv) {
 	if (config.output_format_is_set) {
 		mp_set_format(config.output_format);
 	}
+
+	if (config.rate_mode) {
+		mp_add_subcheck_to_check(&overall, evaluate_swap_rates(config, argc, argv));
+	}
+
 	mp_subcheck sc1 = mp_subcheck_init();
 	sc1 = mp_set_subcheck_default_state(sc1, STATE_OK);
 
@@ -233,7 +244,124 @@ int check_swap(float free_swap_mb, float total_swap_mb, swap_config config) {
 	return STATE_OK;
 }
 
-#define output_format_index CHAR_MAX + 1
+static double seconds_between(struct timeval start, struct timeval end) {
+	return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_usec - start.tv_usec) / 1.0e6;
+}
+
+/*
+ * The rates are computed against the counters of the previous run with the
+ * same arguments, or against a second sample if there is no usable one
+ */
+static mp_subcheck evaluate_swap_rates(swap_config config, int argc, char **argv) {
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	swap_vmstat_result current = getVmstatFromProc(PROC_VMSTAT);
+	if (current.errorcode != STATE_OK) {
+		result = mp_set_subcheck_state(result, STATE_UNKNOWN);
+		xasprintf(&result.output, _("Could not read the swap counters from %s"), PROC_VMSTAT);
+		return result;
+	}
+
+	state_key key = np_enable_state(NULL, SWAP_RATE_STATE_VERSION, progname, argc, argv);
+	state_data *previous_state = np_state_read(key);
+
+	swap_rates rates = {
+		.errorcode = ERROR,
+	};
+	double elapsed = 0;
+	swap_vmstat previous;
+	/* there is no state data on the first run */
+	if (previous_state != NULL && previous_state->errorcode == OK &&
+		sscanf(previous_state->data, "%llu %llu %llu", &previous.pswpin, &previous.pswpout,
+			   &previous.pgmajfault) == 3 &&
+		now.tv_sec - previous_state->time <= SWAP_RATE_MAX_STATE_AGE) {
+		elapsed = (double)(now.tv_sec - previous_state->time);
+		rates = compute_swap_rates(previous, current.counters, elapsed);
+	}
+
+	if (rates.errorcode != OK) {
+		if (verbose) {
+			printf("No usable previous counters, sampling for %u seconds\n", config.rate_interval);
+		}
+
+		previous = current.counters;
+		struct timeval start = now;
+		sleep(config.rate_interval);
+
+		gettimeofday(&now, NULL);
+		current = getVmstatFromProc(PROC_VMSTAT);
+		elapsed = seconds_between(start, now);
+		rates = compute_swap_rates(previous, current.counters, elapsed);
+		if (current.errorcode != STATE_OK || rates.errorcode != OK) {
+			result = mp_set_subcheck_state(result, STATE_UNKNOWN);
+			xasprintf(&result.output, _("Could not read the swap counters from %s"),
+					  PROC_VMSTAT);
+			return result;
+		}
+	}
+
+	char *state_string = NULL;
+	xasprintf(&state_string, "%llu %llu %llu", current.counters.pswpin, current.counters.pswpout,
+			  current.counters.pgmajfault);
+	np_state_write_string(key, now.tv_sec, state_string);
+	free(state_string);
+
+	const char *labels[SWAP_RATE_COUNT] = {"swap_in", "swap_out", "major_faults"};
+	const char *names[SWAP_RATE_COUNT] = {_("Swap in"), _("Swap out"), _("Major page faults")};
+	const char *units[SWAP_RATE_COUNT] = {_("pages/s"), _("pages/s"), _("/s")};
+	double values[SWAP_RATE_COUNT] = {rates.swap_in, rates.swap_out, rates.major_faults};
+
+	for (int i = 0; i < SWAP_RATE_COUNT; i++) {
+		mp_perfdata rate_pd = perfdata_init();
+		rate_pd.label = (char *)labels[i];
+		rate_pd = mp_set_pd_value(rate_pd, values[i]);
+		rate_pd = mp_set_pd_min_value(rate_pd, mp_create_pd_value(0));
+		rate_pd = mp_pd_set_thresholds(rate_pd, config.rate_thresholds[i]);
+
+		mp_subcheck rate_sc = mp_subcheck_init();
+		rate_sc = mp_set_subcheck_state(rate_sc, mp_get_pd_status(rate_pd));
+		xasprintf(&rate_sc.output, "%s: %.1f %s", names[i], values[i], units[i]);
+		mp_add_perfdata_to_subcheck(&rate_sc, rate_pd);
+		mp_add_subcheck_to_subcheck(&result, rate_sc);
+	}
+
+	xasprintf(&result.output, _("Swap activity over %.0f seconds"), elapsed);
+	return result;
+}
+
+/* "IN,OUT,MAJFAULTS", like the load thresholds of check_load, empty ones stay unset */
+static void parse_rate_thresholds(char *arg, mp_thresholds thresholds[SWAP_RATE_COUNT],
+								  bool warning) {
+	char *position = arg;
+	for (int i = 0; i < SWAP_RATE_COUNT && position != NULL; i++) {
+		char *separator = strchr(position, ',');
+		if (separator != NULL) {
+			*separator = '\0';
+		}
+
+		if (*position != '\0') {
+			mp_range_parsed range = mp_parse_range_string(position);
+			if (range.error != MP_PARSING_SUCCESS) {
+				die(STATE_UNKNOWN, "failed to parse rate threshold: %s", position);
+			}
+			thresholds[i] = warning ? mp_thresholds_set_warn(thresholds[i], range.range)
+									: mp_thresholds_set_crit(thresholds[i], range.range);
+		}
+
+		position = (separator != NULL) ? separator + 1 : NULL;
+	}
+}
+
+enum {
+	output_format_index = CHAR_MAX + 1,
+	rate_index,
+	rate_warning_index,
+	rate_critical_index,
+	rate_interval_index,
+};
 
 /* process command-line arguments */
 swap_config_wrapper process_arguments(int argc, char **argv) {
@@ -248,6 +376,10 @@ swap_config_wrapper process_arguments(int argc, char **argv) {
 									   {"version", no_argument, 0, 'V'},
 									   {"help", no_argument, 0, 'h'},
 									   {"output-format", required_argument, 0, output_format_index},
+									   {"rate", no_argument, 0, rate_index},
+									   {"rate-warning", required_argument, 0, rate_warning_index},
+									   {"rate-critical", required_argument, 0, rate_critical_index},
+									   {"rate-interval", required_argument, 0, rate_interval_index},
 									   {0, 0, 0, 0}};
 
 	while (true) {
@@ -267,57 +399,30 @@ swap_config_wrapper process_arguments(int argc, char **argv) {
 			 * percentage sign (%), which means the value must be with 0 and 100
 			 * and is relative to the total swap
 			 */
-			size_t length;
-			length = strlen(optarg);
-			conf_wrapper.config.warn_is_set = true;
-
-			if (optarg[length - 1] == '%') {
-				/* It's percentage */
-				conf_wrapper.config.warn.is_percentage = true;
-				optarg[length - 1] = '\0';
-				if (is_uint64(optarg, &conf_wrapper.config.warn.value)) {
-					if (conf_wrapper.config.warn.value > HUNDRED_PERCENT) {
-						usage4(_("Warning threshold percentage must be <= 100!"));
-					}
-				}
-				break;
-			} /* It's Bytes */
-			conf_wrapper.config.warn.is_percentage = false;
-			if (is_uint64(optarg, &conf_wrapper.config.warn.value)) {
-				break;
+			swap_threshold_parsed parsed = parse_swap_threshold(optarg);
+			if (parsed.error == SWAP_THRESHOLD_PERCENTAGE_TOO_BIG) {
+				usage4(_("Warning threshold percentage must be <= 100!"));
+			} else if (parsed.error != SWAP_THRESHOLD_PARSING_SUCCESS) {
+				usage4(_("Warning threshold be positive integer or "
+						 "percentage!"));
 			}
-			usage4(_("Warning threshold be positive integer or "
-					 "percentage!"));
+			conf_wrapper.config.warn_is_set = true;
+			conf_wrapper.config.warn = parsed.threshold;
+			break;
 		}
 		case 'c': /* critical size threshold */
 		{
-			/*
-			 * We expect either a positive integer value without a unit, which
-			 * means the unit is Bytes or a positive integer value and a
-			 * percentage sign (%), which means the value must be with 0 and 100
-			 * and is relative to the total swap
-			 */
-			size_t length;
-			length = strlen(optarg);
-			conf_wrapper.config.crit_is_set = true;
-
-			if (optarg[length - 1] == '%') {
-				/* It's percentage */
-				conf_wrapper.config.crit.is_percentage = true;
-				optarg[length - 1] = '\0';
-				if (is_uint64(optarg, &conf_wrapper.config.crit.value)) {
-					if (conf_wrapper.config.crit.value > HUNDRED_PERCENT) {
-						usage4(_("Critical threshold percentage must be <= 100!"));
-					}
-				}
-				break;
-			} /* It's Bytes */
-			conf_wrapper.config.crit.is_percentage = false;
-			if (is_uint64(optarg, &conf_wrapper.config.crit.value)) {
-				break;
+			/* Same format as the warning threshold */
+			swap_threshold_parsed parsed = parse_swap_threshold(optarg);
+			if (parsed.error == SWAP_THRESHOLD_PERCENTAGE_TOO_BIG) {
+				usage4(_("Critical threshold percentage must be <= 100!"));
+			} else if (parsed.error != SWAP_THRESHOLD_PARSING_SUCCESS) {
+				usage4(_("Critical threshold be positive integer or "
+						 "percentage!"));
 			}
-			usage4(_("Critical threshold be positive integer or "
-					 "percentage!"));
+			conf_wrapper.config.crit_is_set = true;
+			conf_wrapper.config.crit = parsed.threshold;
+			break;
 		}
 		case 'a': /* all swap */
 			conf_wrapper.config.allswaps = true;
@@ -331,6 +436,21 @@ swap_config_wrapper process_arguments(int argc, char **argv) {
 		case 'v': /* verbose */
 			verbose++;
 			break;
+		case rate_index:
+			conf_wrapper.config.rate_mode = true;
+			break;
+		case rate_warning_index:
+		case rate_critical_index:
+			parse_rate_thresholds(optarg, conf_wrapper.config.rate_thresholds,
+								  option_char == rate_warning_index);
+			conf_wrapper.config.rate_mode = true;
+			break;
+		case rate_interval_index:
+			if (!is_intpos(optarg) || atoi(optarg) > SWAP_RATE_MAX_STATE_AGE) {
+				usage2(_("Rate interval must be a positive number of seconds"), optarg);
+			}
+			conf_wrapper.config.rate_interval = (unsigned int)atoi(optarg);
+			break;
 		case output_format_index: {
 			parsed_output_format parser = mp_parse_output_format(optarg);
 			if (!parser.parsing_success) {
@@ -399,6 +519,17 @@ void print_help(swap_config config) {
 		   _("Resulting state when there is no swap regardless of thresholds. "
 			 "Default:"),
 		   state_text(config.no_swap_state));
+	printf(" %s\n", "--rate");
+	printf("    %s\n", _("Report the swap in, swap out (pages per second) and major page fault"));
+	printf("    %s\n", _("rates from " PROC_VMSTAT ". They are computed against the counters of"));
+	printf("    %s\n", _("the previous run with the same arguments, which are kept in a state"));
+	printf("    %s\n", _("file, or against a second sample"));
+	printf(" %s\n", "--rate-warning=IN,OUT,MAJFAULTS, --rate-critical=IN,OUT,MAJFAULTS");
+	printf("    %s\n", _("Threshold ranges for the rates, empty ones are not checked."));
+	printf("    %s\n", _("Imply --rate"));
+	printf(" %s\n", "--rate-interval=SECONDS");
+	printf("    %s %d\n", _("Time between the two samples without a previous run. Default:"),
+		   config.rate_interval);
 	printf(UT_OUTPUT_FORMAT);
 	printf(UT_VERBOSE);
 
@@ -415,4 +546,6 @@ void print_usage(void) {
 	printf("%s\n", _("Usage:"));
 	printf(" %s [-av] -w <percent_free>%% -c <percent_free>%%\n", progname);
 	printf("  -w <bytes_free> -c <bytes_free> [-n <state>]\n");
+	printf("  [--rate] [--rate-warning=IN,OUT,MAJFAULTS] [--rate-critical=IN,OUT,MAJFAULTS]\n");
+	printf("  [--rate-interval=SECONDS]\n");
 }
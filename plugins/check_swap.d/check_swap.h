@@ -3,16 +3,32 @@
 #include "../common.h"
 #include "../../lib/output.h"
 #include "../../lib/states.h"
+#include "../../lib/thresholds.h"
 
 #ifndef SWAP_CONVERSION
 #	define SWAP_CONVERSION 1
 #endif
 
+#ifndef PROC_VMSTAT
+#	define PROC_VMSTAT "/proc/vmstat"
+#endif
+
 typedef struct {
 	bool is_percentage;
 	uint64_t value;
 } check_swap_threshold;
 
+typedef enum {
+	SWAP_THRESHOLD_PARSING_SUCCESS,
+	SWAP_THRESHOLD_PARSING_FAILURE,
+	SWAP_THRESHOLD_PERCENTAGE_TOO_BIG,
+} swap_threshold_parsing_error;
+
+typedef struct {
+	swap_threshold_parsing_error error;
+	check_swap_threshold threshold;
+} swap_threshold_parsed;
+
 typedef struct {
 	unsigned long long free;  // Free swap in Bytes!
 	unsigned long long used;  // Used swap in Bytes!
@@ -25,6 +41,32 @@ typedef struct {
 	swap_metrics metrics;
 } swap_result;
 
+/* counters of /proc/vmstat, in pages and faults since boot */
+typedef struct {
+	unsigned long long pswpin;
+	unsigned long long pswpout;
+	unsigned long long pgmajfault;
+} swap_vmstat;
+
+typedef struct {
+	int errorcode;
+	swap_vmstat counters;
+} swap_vmstat_result;
+
+typedef struct {
+	int errorcode; /* ERROR if a counter went backwards, e.g. after a reboot */
+	double swap_in;
+	double swap_out;
+	double major_faults;
+} swap_rates;
+
+typedef enum {
+	SWAP_RATE_IN,
+	SWAP_RATE_OUT,
+	SWAP_RATE_MAJOR_FAULTS,
+	SWAP_RATE_COUNT,
+} swap_rate_index;
+
 typedef struct {
 	bool allswaps;
 	mp_state_enum no_swap_state;
@@ -35,15 +77,29 @@ typedef struct {
 	bool on_aix;
 	int conversion_factor;
 
+	/* rates of swapping and major page faults per second */
+	bool rate_mode;
+	mp_thresholds rate_thresholds[SWAP_RATE_COUNT];
+	unsigned int rate_interval; /* seconds between two samples without a previous run */
+
 	bool output_format_is_set;
 	mp_output_format output_format;
 } swap_config;
 
 swap_config swap_config_init(void);
 
+/*
+ * Parses a positive integer, which is a size in Bytes, or a positive integer
+ * followed by a percentage sign (%), which is relative to a total size
+ */
+swap_threshold_parsed parse_swap_threshold(const char *arg);
+
 swap_result get_swap_data(swap_config config);
 swap_result getSwapFromProcMeminfo(char path_to_proc_meminfo[]);
 swap_result getSwapFromSwapCommand(swap_config config, const char swap_command[],
 								   const char swap_format[]);
 swap_result getSwapFromSwapctl_BSD(swap_config config);
 swap_result getSwapFromSwap_SRV4(swap_config config);
+
+swap_vmstat_result getVmstatFromProc(char path_to_proc_vmstat[]);
+swap_rates compute_swap_rates(swap_vmstat previous, swap_vmstat current, double seconds);
@@ -14,6 +14,12 @@ swap_config swap_config_init(void) {
 	tmp.warn_is_set = false;
 	tmp.crit_is_set = false;
 
+	tmp.rate_mode = false;
+	for (int i = 0; i < SWAP_RATE_COUNT; i++) {
+		tmp.rate_thresholds[i] = mp_thresholds_init();
+	}
+	tmp.rate_interval = 1;
+
 	tmp.output_format_is_set = false;
 
 #ifdef _AIX
@@ -25,6 +31,32 @@ swap_config swap_config_init(void) {
 	return tmp;
 }
 
+swap_threshold_parsed parse_swap_threshold(const char *arg) {
+	swap_threshold_parsed result = {
+		.error = SWAP_THRESHOLD_PARSING_FAILURE,
+	};
+
+	size_t length = strlen(arg);
+	if (length == 0) {
+		return result;
+	}
+
+	char *number = strdup(arg);
+	if (number[length - 1] == '%') {
+		result.threshold.is_percentage = true;
+		number[length - 1] = '\0';
+	}
+
+	if (is_uint64(number, &result.threshold.value)) {
+		result.error = (result.threshold.is_percentage && result.threshold.value > 100)
+						   ? SWAP_THRESHOLD_PERCENTAGE_TOO_BIG
+						   : SWAP_THRESHOLD_PARSING_SUCCESS;
+	}
+
+	free(number);
+	return result;
+}
+
 swap_result get_swap_data(swap_config config) {
 #ifdef HAVE_PROC_MEMINFO
 	if (verbose >= 3) {
@@ -151,6 +183,70 @@ swap_result getSwapFromProcMeminfo(char proc_meminfo[]) {
 	return result;
 }
 
+swap_vmstat_result getVmstatFromProc(char path_to_proc_vmstat[]) {
+	swap_vmstat_result result = {
+		.errorcode = STATE_UNKNOWN,
+	};
+
+	FILE *vmstat_file = fopen(path_to_proc_vmstat, "r");
+	if (vmstat_file == NULL) {
+		return result;
+	}
+
+	bool found_in = false;
+	bool found_out = false;
+	bool found_majfault = false;
+
+	/* lines like "pswpin 123", all counters in one pass */
+	char input_buffer[MAX_INPUT_BUFFER];
+	while (fgets(input_buffer, MAX_INPUT_BUFFER - 1, vmstat_file)) {
+		char name[32];
+		unsigned long long value;
+		if (sscanf(input_buffer, "%31s %llu", name, &value) != 2) {
+			continue;
+		}
+
+		if (strcmp(name, "pswpin") == 0) {
+			result.counters.pswpin = value;
+			found_in = true;
+		} else if (strcmp(name, "pswpout") == 0) {
+			result.counters.pswpout = value;
+			found_out = true;
+		} else if (strcmp(name, "pgmajfault") == 0) {
+			result.counters.pgmajfault = value;
+			found_majfault = true;
+		}
+	}
+	fclose(vmstat_file);
+
+	if (verbose >= 3) {
+		printf("Got pswpin %llu, pswpout %llu, pgmajfault %llu\n", result.counters.pswpin,
+			   result.counters.pswpout, result.counters.pgmajfault);
+	}
+
+	if (found_in && found_out && found_majfault) {
+		result.errorcode = STATE_OK;
+	}
+	return result;
+}
+
+swap_rates compute_swap_rates(swap_vmstat previous, swap_vmstat current, double seconds) {
+	swap_rates result = {
+		.errorcode = ERROR,
+	};
+
+	if (seconds <= 0 || current.pswpin < previous.pswpin || current.pswpout < previous.pswpout ||
+		current.pgmajfault < previous.pgmajfault) {
+		return result;
+	}
+
+	result.errorcode = OK;
+	result.swap_in = (double)(current.pswpin - previous.pswpin) / seconds;
+	result.swap_out = (double)(current.pswpout - previous.pswpout) / seconds;
+	result.major_faults = (double)(current.pgmajfault - previous.pgmajfault) / seconds;
+	return result;
+}
+
 swap_result getSwapFromSwapCommand(swap_config config, const char swap_command[],
 								   const char swap_format[]) {
 	swap_result result = {0};
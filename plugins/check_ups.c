@@ -43,20 +43,52 @@ const char *email = "devel@monitoring-plugins.org";
 #include "netutils.h"
 #include "utils.h"
 #include "check_ups.d/config.h"
+#include "check_ups.d/vars.h"
 #include "states.h"
 
-enum {
-	NOSUCHVAR = ERROR - 1
-};
-
 // Forward declarations
 typedef struct {
-	int errorcode;
 	int ups_status;
 	int supported_options;
 } determine_status_result;
-static determine_status_result determine_status(check_ups_config /*config*/);
-static int get_ups_variable(const char * /*varname*/, char * /*buf*/, check_ups_config config);
+static determine_status_result determine_status(const char * /*status*/);
+
+/* a connection to upsd whose replies are read line by line */
+typedef struct {
+	int socket;
+	char buffer[MAX_INPUT_BUFFER];
+	size_t start;
+	size_t end;
+} nut_connection;
+static bool nut_connect(nut_connection * /*connection*/, check_ups_config /*config*/);
+static bool nut_send(nut_connection * /*connection*/, const char * /*commands*/);
+static char *nut_read_line(nut_connection * /*connection*/);
+
+typedef struct {
+	int errorcode;
+	const char *error; /* why the UPS could not be listed */
+	ups_vars vars;
+} list_vars_result;
+static list_vars_result list_vars(nut_connection * /*connection*/, const char * /*ups_name*/);
+
+typedef struct {
+	char *name;
+	char *description;
+} ups_entry;
+
+typedef struct {
+	int errorcode;
+	const char *error;
+	ups_entry *ups;
+	size_t ups_num;
+} list_ups_result;
+static list_ups_result list_ups(nut_connection * /*connection*/);
+
+static void check_single_ups(mp_check * /*overall*/, check_ups_config /*config*/);
+static void check_all_ups(mp_check * /*overall*/, check_ups_config /*config*/);
+static void add_ups_results(mp_check * /*overall*/, mp_subcheck * /*parent*/,
+							const char * /*label_prefix*/, const ups_vars * /*vars*/,
+							check_ups_config /*config*/);
 
 typedef struct {
 	int errorcode;
@@ -93,20 +125,150 @@ int main(int argc, char **argv) {
 
 	mp_set_ok_summary(&overall, "UPS check is OK");
 
+	if (config.all_ups) {
+		check_all_ups(&overall, config);
+	} else {
+		check_single_ups(&overall, config);
+	}
+
+	/* reset timeout */
+	alarm(0);
+
+	mp_exit(overall);
+}
+
+/* checks the UPS given with --ups, its results are the top level subchecks */
+void check_single_ups(mp_check *overall, const check_ups_config config) {
 	mp_subcheck sc_retrieve_status = mp_subcheck_init();
 	sc_retrieve_status = mp_set_subcheck_default_state(sc_retrieve_status, STATE_OK);
 
-	/* get the ups status if possible */
-	determine_status_result query_result = determine_status(config);
-	if (query_result.errorcode != OK) {
+	/* all variables of the UPS are fetched with one command */
+	list_vars_result listed = {
+		.errorcode = ERROR,
+		.error = _("Invalid response received from host"),
+	};
+	nut_connection connection;
+	if (nut_connect(&connection, config)) {
+		char *commands;
+		/* Add LOGOUT to avoid read failure logs */
+		xasprintf(&commands, "LIST VAR %s\nLOGOUT\n", config.ups_name);
+		if (nut_send(&connection, commands)) {
+			listed = list_vars(&connection, config.ups_name);
+		}
+		free(commands);
+		close(connection.socket);
+	}
+
+	if (listed.errorcode != OK) {
 		sc_retrieve_status = mp_set_subcheck_state(sc_retrieve_status, STATE_CRITICAL);
-		xasprintf(&sc_retrieve_status.output, "%s", "Failed to retrieve status from UPS tools");
-		mp_add_subcheck_to_check(&overall, sc_retrieve_status);
-		mp_exit(overall);
+		xasprintf(&sc_retrieve_status.output, "%s: %s", "Failed to retrieve status from UPS tools",
+				  listed.error);
+		mp_add_subcheck_to_check(overall, sc_retrieve_status);
+		mp_exit(*overall);
 	}
 
 	xasprintf(&sc_retrieve_status.output, "%s", "Retrieved status from UPS tools");
-	mp_add_subcheck_to_check(&overall, sc_retrieve_status);
+	mp_add_subcheck_to_check(overall, sc_retrieve_status);
+
+	add_ups_results(overall, NULL, "", &listed.vars, config);
+	ups_vars_free(&listed.vars);
+}
+
+/* checks every UPS known to upsd over one connection, one subcheck per UPS */
+void check_all_ups(mp_check *overall, const check_ups_config config) {
+	mp_subcheck sc_list = mp_subcheck_init();
+
+	nut_connection connection;
+	if (!nut_connect(&connection, config)) {
+		sc_list = mp_set_subcheck_state(sc_list, STATE_CRITICAL);
+		xasprintf(&sc_list.output, "%s", _("Failed to connect to upsd"));
+		mp_add_subcheck_to_check(overall, sc_list);
+		return;
+	}
+
+	list_ups_result listed = {
+		.errorcode = ERROR,
+		.error = _("Invalid response received from host"),
+	};
+	if (nut_send(&connection, "LIST UPS\n")) {
+		listed = list_ups(&connection);
+	}
+	if (listed.errorcode != OK || listed.ups_num == 0) {
+		sc_list = mp_set_subcheck_state(sc_list, STATE_CRITICAL);
+		xasprintf(&sc_list.output, "%s: %s", _("Failed to list the UPS"),
+				  listed.errorcode != OK ? listed.error : _("upsd does not know any UPS"));
+		mp_add_subcheck_to_check(overall, sc_list);
+		close(connection.socket);
+		return;
+	}
+
+	/* the variables of all UPS are requested at once, upsd answers in order */
+	char *commands;
+	xasprintf(&commands, "%s", "");
+	for (size_t i = 0; i < listed.ups_num; i++) {
+		char *previous = commands;
+		xasprintf(&commands, "%sLIST VAR %s\n", previous, listed.ups[i].name);
+		free(previous);
+	}
+	char *previous = commands;
+	xasprintf(&commands, "%sLOGOUT\n", previous);
+	free(previous);
+	bool sent = nut_send(&connection, commands);
+	free(commands);
+
+	mp_subcheck *sc_ups = calloc(listed.ups_num, sizeof(mp_subcheck));
+	if (sc_ups == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the UPS\n"));
+	}
+	for (size_t i = 0; i < listed.ups_num; i++) {
+		const ups_entry *ups = &listed.ups[i];
+		sc_ups[i] = mp_subcheck_init();
+		sc_ups[i] = mp_set_subcheck_default_state(sc_ups[i], STATE_OK);
+
+		list_vars_result vars = {
+			.errorcode = ERROR,
+			.error = _("Invalid response received from host"),
+		};
+		if (sent) {
+			vars = list_vars(&connection, ups->name);
+		}
+		if (vars.errorcode != OK) {
+			sc_ups[i] = mp_set_subcheck_state(sc_ups[i], STATE_CRITICAL);
+			xasprintf(&sc_ups[i].output, "%s: %s", ups->name, vars.error);
+			continue;
+		}
+
+		if (ups->description[0] != '\0') {
+			xasprintf(&sc_ups[i].output, "%s (%s)", ups->name, ups->description);
+		} else {
+			xasprintf(&sc_ups[i].output, "%s", ups->name);
+		}
+
+		char *label_prefix;
+		xasprintf(&label_prefix, "%s_", ups->name);
+		add_ups_results(overall, &sc_ups[i], label_prefix, &vars.vars, config);
+		ups_vars_free(&vars.vars);
+	}
+	close(connection.socket);
+
+	/* subchecks are prepended, so the UPS are added in reverse to keep the order of upsd */
+	for (size_t i = listed.ups_num; i > 0; i--) {
+		mp_add_subcheck_to_check(overall, sc_ups[i - 1]);
+	}
+}
+
+static void add_result(mp_check *overall, mp_subcheck *parent, mp_subcheck subcheck) {
+	if (parent != NULL) {
+		mp_add_subcheck_to_subcheck(parent, subcheck);
+	} else {
+		mp_add_subcheck_to_check(overall, subcheck);
+	}
+}
+
+/* evaluates the variables of one UPS, the subchecks go to parent if there is one */
+void add_ups_results(mp_check *overall, mp_subcheck *parent, const char *label_prefix,
+					 const ups_vars *vars, const check_ups_config config) {
+	determine_status_result query_result = determine_status(ups_vars_get(vars, "ups.status"));
 
 	int ups_status_flags = query_result.ups_status;
 	int supported_options = query_result.supported_options;
@@ -177,27 +339,19 @@ int main(int argc, char **argv) {
 		}
 		xasprintf(&sc_ups_status.output, "Status: %s", sc_ups_status.output);
 		sc_ups_status = mp_set_subcheck_state(sc_ups_status, ups_state_result);
-		mp_add_subcheck_to_check(&overall, sc_ups_status);
+		add_result(overall, parent, sc_ups_status);
 	}
 
-	int res;
-	char temp_buffer[MAX_INPUT_BUFFER];
+	char *label;
 	/* get the ups utility voltage if possible */
-	mp_subcheck sc_voltage = mp_subcheck_init();
-	sc_voltage = mp_set_subcheck_default_state(sc_voltage, STATE_OK);
-	res = get_ups_variable("input.voltage", temp_buffer, config);
-	if (res == NOSUCHVAR) {
-		supported_options &= ~UPS_UTILITY;
-	} else if (res != OK) {
-		sc_voltage = mp_set_subcheck_state(sc_voltage, STATE_CRITICAL);
-		xasprintf(&sc_voltage.output, "%s", "Failed to detect voltage");
-		mp_add_subcheck_to_check(&overall, sc_voltage);
-		mp_exit(overall);
-	} else {
+	const char *value = ups_vars_get(vars, "input.voltage");
+	if (value != NULL) {
 		supported_options |= UPS_UTILITY;
+		mp_subcheck sc_voltage = mp_subcheck_init();
+		sc_voltage = mp_set_subcheck_default_state(sc_voltage, STATE_OK);
 
 		double ups_utility_voltage = 0.0;
-		ups_utility_voltage = atof(temp_buffer);
+		ups_utility_voltage = atof(value);
 		xasprintf(&sc_voltage.output, "Utility: %3.1fV", ups_utility_voltage);
 
 		double ups_utility_deviation = 0.0;
@@ -207,7 +361,8 @@ int main(int argc, char **argv) {
 			ups_utility_deviation = ups_utility_voltage - 120.0;
 		}
 		mp_perfdata pd_voltage_deviation = perfdata_init();
-		pd_voltage_deviation.label = "voltage_deviation";
+		xasprintf(&label, "%svoltage_deviation", label_prefix);
+		pd_voltage_deviation.label = label;
 		pd_voltage_deviation.uom = "V";
 		pd_voltage_deviation.value = mp_create_pd_value(ups_utility_deviation);
 
@@ -217,34 +372,29 @@ int main(int argc, char **argv) {
 		mp_add_perfdata_to_subcheck(&sc_voltage, pd_voltage_deviation);
 
 		mp_perfdata pd_voltage = perfdata_init();
-		pd_voltage.label = "voltage";
+		xasprintf(&label, "%svoltage", label_prefix);
+		pd_voltage.label = label;
 		pd_voltage.uom = "V";
 		pd_voltage.value = mp_create_pd_value(ups_utility_voltage);
 		mp_add_perfdata_to_subcheck(&sc_voltage, pd_voltage);
 
-		mp_add_subcheck_to_check(&overall, sc_voltage);
+		add_result(overall, parent, sc_voltage);
 	}
 
 	/* get the ups battery percent if possible */
-	mp_subcheck sc_battery_charge = mp_subcheck_init();
-	sc_battery_charge = mp_set_subcheck_default_state(sc_battery_charge, STATE_OK);
-	res = get_ups_variable("battery.charge", temp_buffer, config);
-	if (res == NOSUCHVAR) {
-		supported_options &= ~UPS_BATTPCT;
-	} else if (res != OK) {
-		sc_battery_charge = mp_set_subcheck_state(sc_battery_charge, STATE_CRITICAL);
-		xasprintf(&sc_battery_charge.output, "%s", "Failed to detect battery charge");
-		mp_add_subcheck_to_check(&overall, sc_battery_charge);
-		mp_exit(overall);
-	} else {
+	value = ups_vars_get(vars, "battery.charge");
+	if (value != NULL) {
 		supported_options |= UPS_BATTPCT;
+		mp_subcheck sc_battery_charge = mp_subcheck_init();
+		sc_battery_charge = mp_set_subcheck_default_state(sc_battery_charge, STATE_OK);
 
-		double ups_battery_percent = atof(temp_buffer);
+		double ups_battery_percent = atof(value);
 		xasprintf(&sc_battery_charge.output, "Battery charge: %3.1f%%", ups_battery_percent);
 
 		mp_perfdata pd_battery_charge = perfdata_init();
 		pd_battery_charge = mp_set_pd_value(pd_battery_charge, ups_battery_percent);
-		pd_battery_charge.label = "battery";
+		xasprintf(&label, "%sbattery", label_prefix);
+		pd_battery_charge.label = label;
 		pd_battery_charge.uom = "%";
 		pd_battery_charge = mp_pd_set_thresholds(pd_battery_charge, config.battery_thresholds);
 		mp_add_perfdata_to_subcheck(&sc_battery_charge, pd_battery_charge);
@@ -252,30 +402,33 @@ int main(int argc, char **argv) {
 		sc_battery_charge =
 			mp_set_subcheck_state(sc_battery_charge, mp_get_pd_status(pd_battery_charge));
 
-		// if (config.check_crit && ups_battery_percent <= config.critical_value) {
-		// } else if (config.check_warn && ups_battery_percent <= config.warning_value) {
-		mp_add_subcheck_to_check(&overall, sc_battery_charge);
+		/* the estimated runtime on battery in seconds */
+		const char *runtime = ups_vars_get(vars, "battery.runtime");
+		if (runtime != NULL) {
+			mp_perfdata pd_runtime = perfdata_init();
+			pd_runtime = mp_set_pd_value(pd_runtime, atof(runtime));
+			xasprintf(&label, "%sruntime", label_prefix);
+			pd_runtime.label = label;
+			pd_runtime.uom = "s";
+			mp_add_perfdata_to_subcheck(&sc_battery_charge, pd_runtime);
+		}
+
+		add_result(overall, parent, sc_battery_charge);
 	}
 
 	/* get the ups load percent if possible */
-	res = get_ups_variable("ups.load", temp_buffer, config);
-	mp_subcheck sc_load_percent = mp_subcheck_init();
-	sc_load_percent = mp_set_subcheck_default_state(sc_load_percent, STATE_OK);
-	if (res == NOSUCHVAR) {
-		supported_options &= ~UPS_LOADPCT;
-	} else if (res != OK) {
-		sc_load_percent = mp_set_subcheck_state(sc_load_percent, STATE_CRITICAL);
-		xasprintf(&sc_load_percent.output, "%s", "Failed to detect load");
-		mp_add_subcheck_to_check(&overall, sc_load_percent);
-		mp_exit(overall);
-	} else {
+	value = ups_vars_get(vars, "ups.load");
+	if (value != NULL) {
 		supported_options |= UPS_LOADPCT;
+		mp_subcheck sc_load_percent = mp_subcheck_init();
+		sc_load_percent = mp_set_subcheck_default_state(sc_load_percent, STATE_OK);
 
-		double ups_load_percent = atof(temp_buffer);
+		double ups_load_percent = atof(value);
 		xasprintf(&sc_load_percent.output, "Load: %3.1f%%", ups_load_percent);
 
 		mp_perfdata pd_load_percent = perfdata_init();
-		pd_load_percent.label = "load";
+		xasprintf(&label, "%sload", label_prefix);
+		pd_load_percent.label = label;
 		pd_load_percent.uom = "%";
 		pd_load_percent.value = mp_create_pd_value(ups_load_percent);
 		pd_load_percent = mp_pd_set_thresholds(pd_load_percent, config.load_thresholds);
@@ -283,28 +436,20 @@ int main(int argc, char **argv) {
 		mp_add_perfdata_to_subcheck(&sc_load_percent, pd_load_percent);
 		sc_load_percent = mp_set_subcheck_state(sc_load_percent, mp_get_pd_status(pd_load_percent));
 
-		// if (config.check_crit && ups_load_percent >= config.critical_value) {
-		// } else if (config.check_warn && ups_load_percent >= config.warning_value) {
-		mp_add_subcheck_to_check(&overall, sc_load_percent);
+		add_result(overall, parent, sc_load_percent);
 	}
 
 	/* get the ups temperature if possible */
-	res = get_ups_variable("ups.temperature", temp_buffer, config);
-	mp_subcheck sc_temperature = mp_subcheck_init();
-	sc_temperature = mp_set_subcheck_default_state(sc_temperature, STATE_OK);
-	if (res == NOSUCHVAR) {
-		supported_options &= ~UPS_TEMP;
-	} else if (res != OK) {
-		sc_temperature = mp_set_subcheck_state(sc_temperature, STATE_CRITICAL);
-		xasprintf(&sc_temperature.output, "%s", "Failed to detect temperature");
-		mp_add_subcheck_to_check(&overall, sc_temperature);
-		mp_exit(overall);
-	} else {
+	value = ups_vars_get(vars, "ups.temperature");
+	if (value != NULL) {
 		supported_options |= UPS_TEMP;
+		mp_subcheck sc_temperature = mp_subcheck_init();
+		sc_temperature = mp_set_subcheck_default_state(sc_temperature, STATE_OK);
 
-		double ups_temperature = atof(temp_buffer);
+		double ups_temperature = atof(value);
 		mp_perfdata pd_temperature = perfdata_init();
-		pd_temperature.label = "temp";
+		xasprintf(&label, "%stemp", label_prefix);
+		pd_temperature.label = label;
 
 		if (config.temp_output_c) {
 			xasprintf(&sc_temperature.output, "Temperature: %3.1fC", ups_temperature);
@@ -321,30 +466,22 @@ int main(int argc, char **argv) {
 		mp_add_perfdata_to_subcheck(&sc_temperature, pd_temperature);
 		sc_temperature = mp_set_subcheck_state(sc_temperature, mp_get_pd_status(pd_temperature));
 
-		// if (config.check_crit && ups_temperature >= config.critical_value) {
-		// } else if (config.check_warn && ups_temperature >= config.warning_value) {
-		mp_add_subcheck_to_check(&overall, sc_temperature);
+		add_result(overall, parent, sc_temperature);
 	}
 
 	/* get the ups real power if possible */
-	res = get_ups_variable("ups.realpower", temp_buffer, config);
-	mp_subcheck sc_real_power = mp_subcheck_init();
-	sc_real_power = mp_set_subcheck_default_state(sc_real_power, STATE_OK);
-	if (res == NOSUCHVAR) {
-		supported_options &= ~UPS_REALPOWER;
-	} else if (res != OK) {
-		sc_real_power = mp_set_subcheck_state(sc_real_power, STATE_CRITICAL);
-		xasprintf(&sc_real_power.output, "%s", "Failed to detect real power");
-		mp_add_subcheck_to_check(&overall, sc_real_power);
-		mp_exit(overall);
-	} else {
+	value = ups_vars_get(vars, "ups.realpower");
+	if (value != NULL) {
 		supported_options |= UPS_REALPOWER;
+		mp_subcheck sc_real_power = mp_subcheck_init();
+		sc_real_power = mp_set_subcheck_default_state(sc_real_power, STATE_OK);
 
-		double ups_realpower = atof(temp_buffer);
+		double ups_realpower = atof(value);
 		xasprintf(&sc_real_power.output, "Real power: %3.1fW", ups_realpower);
 
 		mp_perfdata pd_real_power = perfdata_init();
-		pd_real_power.label = "realpower";
+		xasprintf(&label, "%srealpower", label_prefix);
+		pd_real_power.label = label;
 		pd_real_power = mp_set_pd_value(pd_real_power, ups_realpower);
 		pd_real_power.uom = "W";
 		pd_real_power = mp_pd_set_thresholds(pd_real_power, config.real_power_thresholds);
@@ -352,9 +489,7 @@ int main(int argc, char **argv) {
 		mp_add_perfdata_to_subcheck(&sc_real_power, pd_real_power);
 		sc_real_power = mp_set_subcheck_state(sc_real_power, mp_get_pd_status(pd_real_power));
 
-		// if (config.check_crit && ups_realpower >= config.critical_value) {
-		// } else if (config.check_warn && ups_realpower >= config.warning_value) {
-		mp_add_subcheck_to_check(&overall, sc_real_power);
+		add_result(overall, parent, sc_real_power);
 	}
 
 	/* if the UPS does not support any options we are looking for, report an
@@ -363,41 +498,25 @@ int main(int argc, char **argv) {
 		mp_subcheck sc_any_option = mp_subcheck_init();
 		sc_any_option = mp_set_subcheck_state(sc_any_option, STATE_CRITICAL);
 		xasprintf(&sc_any_option.output, _("UPS does not support any available options\n"));
-		mp_add_subcheck_to_check(&overall, sc_any_option);
+		add_result(overall, parent, sc_any_option);
 	}
-
-	/* reset timeout */
-	alarm(0);
-
-	mp_exit(overall);
 }
 
 /* determines what options are supported by the UPS */
-determine_status_result determine_status(const check_ups_config config) {
+determine_status_result determine_status(const char *status) {
 
 	determine_status_result result = {
-		.errorcode = OK,
 		.ups_status = UPSSTATUS_NONE,
 		.supported_options = 0,
 	};
 
-	char recv_buffer[MAX_INPUT_BUFFER];
-	int res = get_ups_variable("ups.status", recv_buffer, config);
-	if (res == NOSUCHVAR) {
-		return result;
-	}
-
-	if (res != STATE_OK) {
-		printf("%s\n", _("Invalid response received from host"));
-		result.errorcode = ERROR;
+	if (status == NULL) {
 		return result;
 	}
 
 	result.supported_options |= UPS_STATUS;
 
-	char temp_buffer[MAX_INPUT_BUFFER];
-
-	strcpy(temp_buffer, recv_buffer);
+	char *temp_buffer = strdup(status);
 	for (char *ptr = strtok(temp_buffer, " "); ptr != NULL; ptr = strtok(NULL, " ")) {
 		if (!strcmp(ptr, "OFF")) {
 			result.ups_status |= UPSSTATUS_OFF;
@@ -430,74 +549,166 @@ determine_status_result determine_status(const check_ups_config config) {
 		}
 	}
 
+	free(temp_buffer);
+
 	return result;
 }
 
-/* gets a variable value for a specific UPS  */
-int get_ups_variable(const char *varname, char *buf, const check_ups_config config) {
-	char send_buffer[MAX_INPUT_BUFFER];
+bool nut_connect(nut_connection *connection, const check_ups_config config) {
+	connection->start = 0;
+	connection->end = 0;
+	return my_tcp_connect(config.server_address, (int)config.server_port,
+						  &connection->socket) == STATE_OK;
+}
 
-	/* create the command string to send to the UPS daemon */
-	/* Add LOGOUT to avoid read failure logs */
-	int res = snprintf(send_buffer, sizeof(send_buffer), "GET VAR %s %s\nLOGOUT\n", config.ups_name,
-					   varname);
-	if ((res > 0) && ((size_t)res >= sizeof(send_buffer))) {
-		printf("%s\n", _("UPS name to long for buffer"));
-		return ERROR;
+bool nut_send(nut_connection *connection, const char *commands) {
+	size_t length = strlen(commands);
+	while (length > 0) {
+		ssize_t sent = send(connection->socket, commands, length, 0);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		commands += sent;
+		length -= (size_t)sent;
 	}
+	return true;
+}
 
-	char temp_buffer[MAX_INPUT_BUFFER];
-
-	/* send the command to the daemon and get a response back */
-	if (process_tcp_request(config.server_address, config.server_port, send_buffer, temp_buffer,
-							sizeof(temp_buffer)) != STATE_OK) {
-		printf("%s\n", _("Invalid response received from host"));
-		return ERROR;
-	}
+/* returns the next line of the reply without the newline, NULL if there is none */
+char *nut_read_line(nut_connection *connection) {
+	while (true) {
+		char *start = connection->buffer + connection->start;
+		char *newline = memchr(start, '\n', connection->end - connection->start);
+		if (newline != NULL) {
+			*newline = '\0';
+			connection->start = (size_t)(newline - connection->buffer) + 1;
+			return start;
+		}
 
-	char *ptr = temp_buffer;
-	int len = strlen(ptr);
-	const char *logout = "OK Goodbye\n";
-	const int logout_len = strlen(logout);
+		/* keep the incomplete line and read more */
+		memmove(connection->buffer, start, connection->end - connection->start);
+		connection->end -= connection->start;
+		connection->start = 0;
+		if (connection->end == sizeof(connection->buffer)) {
+			return NULL;
+		}
 
-	if (len > logout_len && strcmp(ptr + len - logout_len, logout) == 0) {
-		len -= logout_len;
-	}
-	if (len > 0 && ptr[len - 1] == '\n') {
-		ptr[len - 1] = 0;
-	}
-	if (strcmp(ptr, "ERR UNKNOWN-UPS") == 0) {
-		printf(_("CRITICAL - no such UPS '%s' on that host\n"), config.ups_name);
-		return ERROR;
+		ssize_t received = recv(connection->socket, connection->buffer + connection->end,
+								sizeof(connection->buffer) - connection->end, 0);
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+		if (received <= 0) {
+			return NULL;
+		}
+		connection->end += (size_t)received;
 	}
+}
 
-	if (strcmp(ptr, "ERR VAR-NOT-SUPPORTED") == 0) {
-		/*printf ("Error: Variable '%s' is not supported\n", varname);*/
-		return NOSUCHVAR;
+static char *nut_error_text(const char *error, const char *ups_name) {
+	char *text;
+	if (strcmp(error, "UNKNOWN-UPS") == 0) {
+		xasprintf(&text, _("no such UPS '%s' on that host"), ups_name);
+	} else if (strcmp(error, "DATA-STALE") == 0) {
+		xasprintf(&text, "%s", _("UPS data is stale"));
+	} else {
+		xasprintf(&text, _("Unknown error: %s"), error);
 	}
+	return text;
+}
 
-	if (strcmp(ptr, "ERR DATA-STALE") == 0) {
-		printf("%s\n", _("CRITICAL - UPS data is stale"));
-		return ERROR;
-	}
+/* reads the reply to "LIST VAR <ups>" */
+list_vars_result list_vars(nut_connection *connection, const char *ups_name) {
+	list_vars_result result = {
+		.errorcode = ERROR,
+		.error = _("Invalid response received from host"),
+		.vars = ups_vars_init(),
+	};
 
-	if (strncmp(ptr, "ERR", 3) == 0) {
-		printf(_("Unknown error: %s\n"), ptr);
-		return ERROR;
+	bool begun = false;
+	bool invalid = false;
+	for (char *line = nut_read_line(connection); line != NULL; line = nut_read_line(connection)) {
+		/* VAR <ups> <name> "<value>" */
+		char *words[4];
+		size_t words_num = nut_split_line(line, words, 4);
+
+		if (!begun) {
+			if (words_num == 2 && strcmp(words[0], "ERR") == 0) {
+				result.error = nut_error_text(words[1], ups_name);
+				break;
+			}
+			begun = words_num == 4 && strcmp(words[0], "BEGIN") == 0 &&
+					strcmp(words[2], "VAR") == 0 && strcmp(words[3], ups_name) == 0;
+			if (!begun) {
+				break;
+			}
+		} else if (words_num == 4 && strcmp(words[0], "END") == 0 &&
+				   strcmp(words[2], "VAR") == 0 && strcmp(words[3], ups_name) == 0) {
+			if (invalid) {
+				break;
+			}
+			result.errorcode = OK;
+			result.error = NULL;
+			return result;
+		} else if (words_num == 4 && strcmp(words[0], "VAR") == 0) {
+			ups_vars_set(&result.vars, words[2], words[3]);
+		} else {
+			/* the rest of the reply is read so that the next one starts in place */
+			invalid = true;
+		}
 	}
 
-	ptr = temp_buffer + strlen(varname) + strlen(config.ups_name) + 6;
-	len = strlen(ptr);
-	if (len < 2 || ptr[0] != '"' || ptr[len - 1] != '"') {
-		printf("%s\n", _("Error: unable to parse variable"));
-		return ERROR;
-	}
+	ups_vars_free(&result.vars);
+	return result;
+}
+
+/* reads the reply to "LIST UPS" */
+list_ups_result list_ups(nut_connection *connection) {
+	list_ups_result result = {
+		.errorcode = ERROR,
+		.error = _("Invalid response received from host"),
+		.ups = NULL,
+		.ups_num = 0,
+	};
 
-	*buf = 0;
-	strncpy(buf, ptr + 1, len - 2);
-	buf[len - 2] = 0;
+	bool begun = false;
+	for (char *line = nut_read_line(connection); line != NULL; line = nut_read_line(connection)) {
+		/* UPS <name> "<description>" */
+		char *words[3];
+		size_t words_num = nut_split_line(line, words, 3);
 
-	return OK;
+		if (words_num == 2 && strcmp(words[0], "ERR") == 0) {
+			result.error = nut_error_text(words[1], "");
+			return result;
+		}
+		if (!begun) {
+			begun = words_num == 3 && strcmp(words[0], "BEGIN") == 0 &&
+					strcmp(words[2], "UPS") == 0;
+			if (!begun) {
+				return result;
+			}
+		} else if (words_num >= 2 && strcmp(words[0], "UPS") == 0) {
+			ups_entry *ups = realloc(result.ups, (result.ups_num + 1) * sizeof(ups_entry));
+			if (ups == NULL) {
+				die(STATE_UNKNOWN, _("Could not allocate memory for the UPS\n"));
+			}
+			result.ups = ups;
+			result.ups[result.ups_num].name = strdup(words[1]);
+			result.ups[result.ups_num].description = strdup(words_num == 3 ? words[2] : "");
+			result.ups_num++;
+		} else if (words_num >= 1 && strcmp(words[0], "END") == 0) {
+			result.errorcode = OK;
+			result.error = NULL;
+			return result;
+		} else {
+			return result;
+		}
+	}
+
+	return result;
 }
 
 /* Command line: CHECK_UPS -H <host_address> -u ups [-p port] [-v variable]
@@ -508,6 +719,7 @@ check_ups_config_wrapper process_arguments(int argc, char **argv) {
 
 	static struct option longopts[] = {{"hostname", required_argument, 0, 'H'},
 									   {"ups", required_argument, 0, 'u'},
+									   {"all", no_argument, 0, 'a'},
 									   {"port", required_argument, 0, 'p'},
 									   {"critical", required_argument, 0, 'c'},
 									   {"warning", required_argument, 0, 'w'},
@@ -542,7 +754,7 @@ check_ups_config_wrapper process_arguments(int argc, char **argv) {
 	ups_test_type test_selection = UPS_NONE;
 	mp_thresholds tmp_thr = mp_thresholds_init();
 	while (true) {
-		int counter = getopt_long(argc, argv, "hVTH:u:p:v:c:w:t:", longopts, &option);
+		int counter = getopt_long(argc, argv, "hVTaH:u:p:v:c:w:t:", longopts, &option);
 
 		if (counter == -1 || counter == EOF) {
 			break;
@@ -565,6 +777,9 @@ check_ups_config_wrapper process_arguments(int argc, char **argv) {
 		case 'u': /* ups name */
 			result.config.ups_name = optarg;
 			break;
+		case 'a': /* every ups of the host */
+			result.config.all_ups = true;
+			break;
 		case 'p': /* port */
 			if (is_intpos(optarg)) {
 				result.config.server_port = atoi(optarg);
@@ -665,9 +880,12 @@ check_ups_config_wrapper process_arguments(int argc, char **argv) {
 }
 
 check_ups_config_wrapper validate_arguments(check_ups_config_wrapper config_wrapper) {
-	if (config_wrapper.config.ups_name == NULL) {
+	if (config_wrapper.config.ups_name == NULL && !config_wrapper.config.all_ups) {
 		printf("%s\n", _("Error : no UPS indicated"));
 		config_wrapper.errorcode = ERROR;
+	} else if (config_wrapper.config.ups_name != NULL && config_wrapper.config.all_ups) {
+		printf("%s\n", _("Error : --ups and --all can not be combined"));
+		config_wrapper.errorcode = ERROR;
 	}
 	return config_wrapper;
 }
@@ -698,6 +916,9 @@ void print_help(void) {
 
 	printf(" %s\n", "-u, --ups=STRING");
 	printf("    %s\n", _("Name of UPS"));
+	printf(" %s\n", "-a, --all");
+	printf("    %s\n", _("Check every UPS of the host instead, their variables are fetched over"));
+	printf("    %s\n", _("one connection and each UPS gets its own result and perfdata prefix"));
 	printf(" %s\n", "-T, --temperature");
 	printf("    %s\n", _("Output of temperatures in Celsius"));
 	printf(" %s\n", "-v, --variable=STRING");
@@ -735,7 +956,8 @@ void print_help(void) {
 	printf(" %s\n", _("of that variable.  If the remote host has multiple UPS "
 					  "that are being monitored"));
 	printf(" %s\n", _("you will have to use the --ups option to specify which "
-					  "UPS to check."));
+					  "UPS to check,"));
+	printf(" %s\n", _("or --all to check all of them."));
 	printf("\n");
 	printf(" %s\n", _("This plugin requires that the UPSD daemon distributed "
 					  "with Russell Kroll's"));
@@ -749,7 +971,7 @@ void print_help(void) {
 
 void print_usage(void) {
 	printf("%s\n", _("Usage:"));
-	printf("%s -H host -u ups [-p port] [-v variable] [-w warn_value] [-c "
+	printf("%s -H host {-u ups | -a} [-p port] [-v variable] [-w warn_value] [-c "
 		   "crit_value] [-to to_sec] [-T]\n",
 		   progname);
 }
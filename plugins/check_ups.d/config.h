@@ -40,6 +40,7 @@ typedef struct ups_config {
 	unsigned int server_port;
 	char *server_address;
 	char *ups_name;
+	bool all_ups; /* check every UPS listed by upsd */
 
 	mp_thresholds utility_thresholds;
 	mp_thresholds battery_thresholds;
@@ -55,6 +56,7 @@ check_ups_config check_ups_config_init(void) {
 		.server_port = PORT,
 		.server_address = NULL,
 		.ups_name = NULL,
+		.all_ups = false,
 
 		.utility_thresholds = mp_thresholds_init(),
 		.battery_thresholds = mp_thresholds_init(),
@@ -0,0 +1,97 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./vars.h"
+
+ups_vars ups_vars_init(void) {
+	ups_vars vars = {
+		.vars = NULL,
+		.vars_num = 0,
+		.capacity = 0,
+		.index = mp_hashtable_init(false),
+	};
+	return vars;
+}
+
+void ups_vars_set(ups_vars *vars, const char *name, const char *value) {
+	char *copy = strdup(value);
+	if (copy == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the UPS variables\n"));
+	}
+
+	size_t index = mp_hashtable_add(&vars->index, name, vars->vars_num);
+	if (index < vars->vars_num) {
+		free(vars->vars[index].value);
+		vars->vars[index].value = copy;
+		return;
+	}
+
+	if (vars->vars_num == vars->capacity) {
+		size_t capacity = vars->capacity == 0 ? 64 : vars->capacity * 2;
+		ups_var *grown = realloc(vars->vars, capacity * sizeof(ups_var));
+		if (grown == NULL) {
+			die(STATE_UNKNOWN, _("Could not allocate memory for the UPS variables\n"));
+		}
+		vars->vars = grown;
+		vars->capacity = capacity;
+	}
+	ups_var var = {
+		.name = strdup(name),
+		.value = copy,
+	};
+	if (var.name == NULL) {
+		die(STATE_UNKNOWN, _("Could not allocate memory for the UPS variables\n"));
+	}
+	vars->vars[vars->vars_num++] = var;
+}
+
+const char *ups_vars_get(const ups_vars *vars, const char *name) {
+	size_t index;
+	if (!mp_hashtable_get(&vars->index, name, &index)) {
+		return NULL;
+	}
+	return vars->vars[index].value;
+}
+
+void ups_vars_free(ups_vars *vars) {
+	for (size_t i = 0; i < vars->vars_num; i++) {
+		free(vars->vars[i].name);
+		free(vars->vars[i].value);
+	}
+	free(vars->vars);
+	mp_hashtable_free(&vars->index);
+	*vars = ups_vars_init();
+}
+
+size_t nut_split_line(char *line, char *words[], size_t max_words) {
+	size_t words_num = 0;
+	char *read = line;
+
+	while (words_num < max_words) {
+		while (*read == ' ' || *read == '\t') {
+			read++;
+		}
+		if (*read == '\0') {
+			break;
+		}
+
+		/* the word is copied onto itself without the quotes and escapes */
+		char *write = read;
+		words[words_num++] = write;
+		bool quoted = false;
+		for (; *read != '\0'; read++) {
+			if (*read == '"') {
+				quoted = !quoted;
+			} else if (*read == '\\' && read[1] != '\0') {
+				*write++ = *++read;
+			} else if (!quoted && (*read == ' ' || *read == '\t')) {
+				read++;
+				break;
+			} else {
+				*write++ = *read;
+			}
+		}
+		*write = '\0';
+	}
+
+	return words_num;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "../../config.h"
+#include "../../lib/hashtable.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * The variables of one UPS as listed by "LIST VAR <ups>", indexed by name
+ * so that the checks can look them up.
+ */
+typedef struct {
+	char *name;
+	char *value;
+} ups_var;
+
+typedef struct {
+	ups_var *vars;
+	size_t vars_num;
+	size_t capacity;
+	mp_hashtable index; /* the names of the variables */
+} ups_vars;
+
+ups_vars ups_vars_init(void);
+/* copies name and value, an existing value is replaced */
+void ups_vars_set(ups_vars *vars, const char *name, const char *value);
+/* returns NULL if the UPS does not have the variable */
+const char *ups_vars_get(const ups_vars *vars, const char *name);
+void ups_vars_free(ups_vars *vars);
+
+/*
+ * Splits a line of the upsd protocol into its words in place. Quoted words
+ * may contain spaces and backslash escapes. Returns the number of words,
+ * at most max_words.
+ */
+size_t nut_split_line(char *line, char *words[], size_t max_words);
@@ -35,6 +35,7 @@ const char *copyright = "2000-2024";
 const char *email = "devel@monitoring-plugins.org";
 
 #include "check_users.d/users.h"
+#include "check_users.d/sessions.h"
 #include "output.h"
 #include "perfdata.h"
 #include "states.h"
@@ -63,6 +64,8 @@ typedef struct process_argument_wrapper {
 	check_users_config config;
 } check_users_config_wrapper;
 check_users_config_wrapper process_arguments(int /*argc*/, char ** /*argv*/);
+static mp_subcheck evaluate_breakdown(users_breakdown * /*breakdown*/,
+									  check_users_config /*config*/);
 
 void print_help(void);
 void print_usage(void);
@@ -83,21 +86,39 @@ int main(int argc, char **argv) {
 
 	check_users_config config = tmp_config.config;
 
+	/* the sessions are enumerated once for the total and the breakdown */
+	users_breakdown breakdown = {0};
+	if (config.breakdown) {
+#if defined(HAVE_LIBSYSTEMD)
+		breakdown = users_breakdown_systemd(config.group_by, config.idle_time);
+#elif defined(HAVE_UTMPX_H) && !defined(_WIN32)
+		breakdown = users_breakdown_utmp(config.group_by, config.idle_time);
+#else
+		usage4(_("The session breakdown needs systemd-logind or utmpx"));
+#endif
+	}
+
+	get_num_of_users_wrapper user_wrapper = {
+		.errorcode = breakdown.errorcode,
+		.users = breakdown.users,
+	};
+	if (!config.breakdown) {
 #ifdef _WIN32
 #	if HAVE_WTSAPI32_H
-	get_num_of_users_wrapper user_wrapper = get_num_of_users_windows();
+		user_wrapper = get_num_of_users_windows();
 #	else
 #		error Did not find WTSAPI32
 #	endif // HAVE_WTSAPI32_H
 #else
 #	ifdef HAVE_LIBSYSTEMD
-	get_num_of_users_wrapper user_wrapper = get_num_of_users_systemd();
+		user_wrapper = get_num_of_users_systemd();
 #	elif HAVE_UTMPX_H
-	get_num_of_users_wrapper user_wrapper = get_num_of_users_utmp();
+		user_wrapper = get_num_of_users_utmp();
 #	else  // !HAVE_LIBSYSTEMD && !HAVE_UTMPX_H
-	get_num_of_users_wrapper user_wrapper = get_num_of_users_who_command();
+		user_wrapper = get_num_of_users_who_command();
 #	endif // HAVE_LIBSYSTEMD
 #endif     // _WIN32
+	}
 
 	mp_check overall = mp_check_init();
 	if (config.output_format_is_set) {
@@ -144,11 +165,72 @@ int main(int argc, char **argv) {
 		xasprintf(&sc_users.output, "%d users currently logged in", user_wrapper.users);
 	}
 
+	if (config.breakdown) {
+		mp_add_subcheck_to_check(&overall, evaluate_breakdown(&breakdown, config));
+		users_breakdown_free(&breakdown);
+	}
+
 	mp_add_subcheck_to_check(&overall, sc_users);
 	mp_exit(overall);
 }
 
-#define output_format_index CHAR_MAX + 1
+/* one subcheck for every group of sessions, or only for the biggest ones with --top */
+static mp_subcheck evaluate_breakdown(users_breakdown *breakdown, check_users_config config) {
+	const char *group_names[] = {
+		[USERS_GROUP_USER] = "users",
+		[USERS_GROUP_CLASS] = "terminal classes",
+		[USERS_GROUP_HOST] = "hosts",
+	};
+
+	mp_subcheck result = mp_subcheck_init();
+	result = mp_set_subcheck_default_state(result, STATE_OK);
+
+	users_breakdown_sort(breakdown);
+	size_t hidden = 0;
+	for (size_t i = 0; i < breakdown->count; i++) {
+		users_group group = breakdown->groups[i];
+
+		mp_perfdata pd_sessions = perfdata_init();
+		xasprintf(&pd_sessions.label, "%s_sessions", group.name);
+		pd_sessions = mp_set_pd_value(pd_sessions, group.sessions);
+		pd_sessions = mp_pd_set_thresholds(pd_sessions, config.group_thresholds);
+		mp_state_enum state = mp_get_pd_status(pd_sessions);
+
+		/* groups beyond the top ones are only shown if they violate a threshold */
+		if (config.top > 0 && i >= config.top && state == STATE_OK) {
+			hidden++;
+			continue;
+		}
+
+		mp_perfdata pd_idle = perfdata_init();
+		xasprintf(&pd_idle.label, "%s_idle", group.name);
+		pd_idle = mp_set_pd_value(pd_idle, group.idle_sessions);
+
+		mp_subcheck sc_group = mp_subcheck_init();
+		sc_group = mp_set_subcheck_state(sc_group, state);
+		xasprintf(&sc_group.output, "%s: %lu sessions, %lu idle", group.name, group.sessions,
+				  group.idle_sessions);
+		mp_add_perfdata_to_subcheck(&sc_group, pd_sessions);
+		mp_add_perfdata_to_subcheck(&sc_group, pd_idle);
+		mp_add_subcheck_to_subcheck(&result, sc_group);
+	}
+
+	xasprintf(&result.output, "%lu sessions of %zu %s", breakdown->sessions, breakdown->count,
+			  group_names[config.group_by]);
+	if (hidden > 0) {
+		char *shown = result.output;
+		xasprintf(&result.output, "%s, %zu more not shown", shown, hidden);
+		free(shown);
+	}
+	return result;
+}
+
+#define output_format_index    CHAR_MAX + 1
+#define breakdown_index        CHAR_MAX + 2
+#define top_index              CHAR_MAX + 3
+#define idle_time_index        CHAR_MAX + 4
+#define group_warning_index    CHAR_MAX + 5
+#define group_critical_index   CHAR_MAX + 6
 
 /* process command-line arguments */
 check_users_config_wrapper process_arguments(int argc, char **argv) {
@@ -157,6 +239,12 @@ check_users_config_wrapper process_arguments(int argc, char **argv) {
 									   {"version", no_argument, 0, 'V'},
 									   {"help", no_argument, 0, 'h'},
 									   {"output-format", required_argument, 0, output_format_index},
+									   {"breakdown", required_argument, 0, breakdown_index},
+									   {"top", required_argument, 0, top_index},
+									   {"idle-time", required_argument, 0, idle_time_index},
+									   {"group-warning", required_argument, 0, group_warning_index},
+									   {"group-critical", required_argument, 0,
+										group_critical_index},
 									   {0, 0, 0, 0}};
 
 	if (argc < 2) {
@@ -204,6 +292,48 @@ check_users_config_wrapper process_arguments(int argc, char **argv) {
 			result.config.output_format = parser.output_format;
 			break;
 		}
+		case breakdown_index:
+			result.config.breakdown = true;
+			if (strcmp(optarg, "user") == 0) {
+				result.config.group_by = USERS_GROUP_USER;
+			} else if (strcmp(optarg, "class") == 0) {
+				result.config.group_by = USERS_GROUP_CLASS;
+			} else if (strcmp(optarg, "host") == 0) {
+				result.config.group_by = USERS_GROUP_HOST;
+			} else {
+				usage4(_("--breakdown must be one of user, class or host"));
+			}
+			break;
+		case top_index:
+			if (!is_intpos(optarg)) {
+				usage4(_("--top must be a positive integer"));
+			}
+			/* the heaviest users unless something else was asked for */
+			result.config.breakdown = true;
+			result.config.top = (size_t)strtoul(optarg, NULL, 10);
+			break;
+		case idle_time_index:
+			if (!is_intnonneg(optarg)) {
+				usage4(_("--idle-time must be a number of seconds"));
+			}
+			result.config.idle_time = strtoll(optarg, NULL, 10);
+			break;
+		case group_warning_index:
+		case group_critical_index: {
+			mp_range_parsed group_range = mp_parse_range_string(optarg);
+			if (group_range.error != MP_PARSING_SUCCESS) {
+				die(STATE_UNKNOWN, _("Failed to parse the group threshold: %s\n"), optarg);
+			}
+			result.config.breakdown = true;
+			if (counter == group_warning_index) {
+				result.config.group_thresholds =
+					mp_thresholds_set_warn(result.config.group_thresholds, group_range.range);
+			} else {
+				result.config.group_thresholds =
+					mp_thresholds_set_crit(result.config.group_thresholds, group_range.range);
+			}
+			break;
+		}
 		}
 	}
 
@@ -277,6 +407,19 @@ void print_help(void) {
 	printf(" %s\n", "-c, --critical=RANGE_EXPRESSION");
 	printf("    %s\n",
 		   _("Set CRITICAL status if number of logged in users violates RANGE_EXPRESSION"));
+	printf(" %s\n", "--breakdown=user|class|host");
+	printf("    %s\n", _("Group the sessions by user, by terminal class (tty, pts, x11) or by"));
+	printf("    %s\n", _("remote host and report every group"));
+	printf(" %s\n", "--top=N");
+	printf("    %s\n", _("Only show the N groups with the most sessions and those violating"));
+	printf("    %s\n", _("a threshold, implies --breakdown=user"));
+	printf(" %s\n", "--group-warning=RANGE_EXPRESSION");
+	printf("    %s\n", _("Set WARNING status if the sessions of any group violate the range"));
+	printf(" %s\n", "--group-critical=RANGE_EXPRESSION");
+	printf("    %s\n", _("Set CRITICAL status if the sessions of any group violate the range"));
+	printf(" %s\n", "--idle-time=SECONDS");
+	printf("    %s\n", _("Sessions whose terminal was not used for longer are idle"));
+	printf("    %s %d\n", _("Default:"), USERS_IDLE_TIME);
 	printf(UT_OUTPUT_FORMAT);
 
 	printf(UT_SUPPORT);
@@ -285,4 +428,6 @@ void print_help(void) {
 void print_usage(void) {
 	printf("%s\n", _("Usage:"));
 	printf("%s -w <users> -c <users>\n", progname);
+	printf("  [--breakdown=user|class|host] [--top=N] [--group-warning=<sessions>]\n");
+	printf("  [--group-critical=<sessions>] [--idle-time=<seconds>]\n");
 }
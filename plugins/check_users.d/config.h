@@ -2,10 +2,18 @@
 
 #include "output.h"
 #include "thresholds.h"
+#include "./sessions.h"
+#include <stddef.h>
 
 typedef struct check_users_config {
 	mp_thresholds thresholds;
 
+	bool breakdown;
+	users_group_by group_by;
+	size_t top; /* 0 shows all groups */
+	long long idle_time;
+	mp_thresholds group_thresholds;
+
 	bool output_format_is_set;
 	mp_output_format output_format;
 } check_users_config;
@@ -14,6 +22,12 @@ check_users_config check_users_config_init() {
 	check_users_config tmp = {
 		.thresholds = mp_thresholds_init(),
 
+		.breakdown = false,
+		.group_by = USERS_GROUP_USER,
+		.top = 0,
+		.idle_time = USERS_IDLE_TIME,
+		.group_thresholds = mp_thresholds_init(),
+
 		.output_format_is_set = false,
 	};
 	return tmp;
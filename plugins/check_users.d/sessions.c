@@ -0,0 +1,220 @@
+#include "../common.h"
+#include "../utils.h"
+#include "./sessions.h"
+#include "./users.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef HAVE_LIBSYSTEMD
+#	include <systemd/sd-daemon.h>
+#	include <systemd/sd-login.h>
+#endif
+
+#ifdef HAVE_UTMPX_H
+#	include <utmpx.h>
+#endif
+
+users_breakdown users_breakdown_init(void) {
+	users_breakdown result = {
+		.errorcode = 0,
+		.index = mp_hashtable_init(false),
+	};
+	return result;
+}
+
+void users_breakdown_free(users_breakdown *breakdown) {
+	for (size_t i = 0; i < breakdown->count; i++) {
+		free(breakdown->groups[i].name);
+	}
+	free(breakdown->groups);
+	mp_hashtable_free(&breakdown->index);
+	breakdown->groups = NULL;
+	breakdown->count = 0;
+	breakdown->capacity = 0;
+}
+
+void users_breakdown_add(users_breakdown *breakdown, const char *name, long long idle,
+						 long long idle_time) {
+	size_t index = mp_hashtable_add(&breakdown->index, name, breakdown->count);
+	if (index == breakdown->count) {
+		if (breakdown->count == breakdown->capacity) {
+			size_t capacity = breakdown->capacity == 0 ? 16 : breakdown->capacity * 2;
+			users_group *groups = realloc(breakdown->groups, capacity * sizeof(users_group));
+			if (groups == NULL) {
+				die(STATE_UNKNOWN, _("Could not allocate memory for the sessions\n"));
+			}
+			breakdown->groups = groups;
+			breakdown->capacity = capacity;
+		}
+		users_group group = {
+			.name = strdup(name),
+		};
+		breakdown->groups[breakdown->count++] = group;
+	}
+
+	users_group *group = &breakdown->groups[index];
+	group->sessions++;
+	if (idle >= 0 && idle > idle_time) {
+		group->idle_sessions++;
+	}
+	breakdown->sessions++;
+}
+
+static int users_compare_groups(const void *left, const void *right) {
+	const users_group *left_group = left;
+	const users_group *right_group = right;
+	if (left_group->sessions != right_group->sessions) {
+		return left_group->sessions > right_group->sessions ? -1 : 1;
+	}
+	return strcmp(left_group->name, right_group->name);
+}
+
+void users_breakdown_sort(users_breakdown *breakdown) {
+	if (breakdown->count > 1) {
+		qsort(breakdown->groups, breakdown->count, sizeof(users_group), users_compare_groups);
+	}
+	mp_hashtable_clear(&breakdown->index);
+	for (size_t i = 0; i < breakdown->count; i++) {
+		mp_hashtable_add(&breakdown->index, breakdown->groups[i].name, i);
+	}
+}
+
+const char *users_tty_class(const char *line, char *buffer, size_t size) {
+	if (line == NULL || line[0] == '\0') {
+		return "unknown";
+	}
+	/* an X display, :0 or :0.0 */
+	if (line[0] == ':') {
+		return "x11";
+	}
+	size_t length = 0;
+	while (line[length] != '\0' && isalpha((unsigned char)line[length]) && length + 1 < size) {
+		buffer[length] = line[length];
+		length++;
+	}
+	buffer[length] = '\0';
+	return length > 0 ? buffer : "unknown";
+}
+
+long long users_tty_idle(const char *line) {
+	if (line == NULL || line[0] == '\0' || line[0] == ':') {
+		return -1;
+	}
+	char path[MAX_INPUT_BUFFER];
+	snprintf(path, sizeof(path), "/dev/%s", line);
+	struct stat tty_stat;
+	if (stat(path, &tty_stat) != 0) {
+		return -1;
+	}
+	long long idle = (long long)(time(NULL) - tty_stat.st_atime);
+	return idle > 0 ? idle : 0;
+}
+
+/* the name of the group a session belongs to */
+static const char *users_group_name(users_group_by group_by, const char *user, const char *line,
+									const char *host, char *buffer, size_t size) {
+	switch (group_by) {
+	case USERS_GROUP_CLASS:
+		return users_tty_class(line, buffer, size);
+	case USERS_GROUP_HOST:
+		return (host != NULL && host[0] != '\0') ? host : "local";
+	case USERS_GROUP_USER:
+	default:
+		return (user != NULL && user[0] != '\0') ? user : "unknown";
+	}
+}
+
+#ifdef HAVE_LIBSYSTEMD
+users_breakdown users_breakdown_systemd(users_group_by group_by, long long idle_time) {
+	users_breakdown result = users_breakdown_init();
+	if (sd_booted() <= 0) {
+		result.errorcode = NO_SYSTEMD_ERROR;
+		return result;
+	}
+
+	char **sessions = NULL;
+	int count = sd_get_sessions(&sessions);
+	if (count < 0) {
+		result.errorcode = count;
+		return result;
+	}
+
+	for (int i = 0; i < count; i++) {
+		char *class = NULL;
+		/* greeters and lock screens are no logged in users */
+		if (sd_session_get_class(sessions[i], &class) < 0 || strcmp(class, "user") != 0) {
+			free(class);
+			free(sessions[i]);
+			continue;
+		}
+
+		char *user = NULL;
+		char *tty = NULL;
+		char *host = NULL;
+		char *type = NULL;
+		sd_session_get_username(sessions[i], &user);
+		sd_session_get_tty(sessions[i], &tty);
+		sd_session_get_remote_host(sessions[i], &host);
+		sd_session_get_type(sessions[i], &type);
+
+		char buffer[64];
+		const char *name = users_group_name(group_by, user, tty, host, buffer, sizeof(buffer));
+		/* sessions without a terminal are only known by their type */
+		if (group_by == USERS_GROUP_CLASS && tty == NULL && type != NULL) {
+			name = type;
+		}
+		users_breakdown_add(&result, name, users_tty_idle(tty), idle_time);
+
+		free(class);
+		free(user);
+		free(tty);
+		free(host);
+		free(type);
+		free(sessions[i]);
+	}
+	free(sessions);
+
+	/* the plain check counts the users, not their sessions */
+	int users = sd_get_uids(NULL);
+	if (users < 0) {
+		result.errorcode = users;
+	} else {
+		result.users = users;
+	}
+	return result;
+}
+#endif
+
+#ifdef HAVE_UTMPX_H
+users_breakdown users_breakdown_utmp(users_group_by group_by, long long idle_time) {
+	users_breakdown result = users_breakdown_init();
+
+	setutxent();
+	struct utmpx *putmpx;
+	while ((putmpx = getutxent()) != NULL) {
+		if (putmpx->ut_type != USER_PROCESS) {
+			continue;
+		}
+
+		/* the fields are not necessarily terminated */
+		char user[sizeof(putmpx->ut_user) + 1];
+		char line[sizeof(putmpx->ut_line) + 1];
+		char host[sizeof(putmpx->ut_host) + 1];
+		snprintf(user, sizeof(user), "%.*s", (int)sizeof(putmpx->ut_user), putmpx->ut_user);
+		snprintf(line, sizeof(line), "%.*s", (int)sizeof(putmpx->ut_line), putmpx->ut_line);
+		snprintf(host, sizeof(host), "%.*s", (int)sizeof(putmpx->ut_host), putmpx->ut_host);
+
+		char buffer[64];
+		const char *name = users_group_name(group_by, user, line, host, buffer, sizeof(buffer));
+		users_breakdown_add(&result, name, users_tty_idle(line), idle_time);
+	}
+	endutxent();
+
+	/* like get_num_of_users_utmp every session is a user */
+	result.users = (int)result.sessions;
+	return result;
+}
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../../config.h"
+#include "../../lib/hashtable.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* sessions idle for longer than this many seconds count as idle */
+#define USERS_IDLE_TIME 3600
+
+typedef enum {
+	USERS_GROUP_USER,
+	USERS_GROUP_CLASS, /* the kind of terminal: tty, pts, x11, ... */
+	USERS_GROUP_HOST,  /* the remote host or "local" */
+} users_group_by;
+
+/* the sessions which have the same user, class or remote host */
+typedef struct {
+	char *name;
+	unsigned long sessions;
+	unsigned long idle_sessions;
+} users_group;
+
+typedef struct {
+	int errorcode;
+	users_group *groups;
+	size_t count;
+	unsigned long sessions;
+	int users; /* the number the plain check reports for the same source */
+	size_t capacity;
+
+	mp_hashtable index; /* the names of the groups */
+} users_breakdown;
+
+users_breakdown users_breakdown_init(void);
+void users_breakdown_free(users_breakdown *breakdown);
+
+/* counts one session for the group name, idle is in seconds or negative if unknown */
+void users_breakdown_add(users_breakdown *breakdown, const char *name, long long idle,
+						 long long idle_time);
+
+/* orders the groups by the number of sessions, the biggest first */
+void users_breakdown_sort(users_breakdown *breakdown);
+
+/* pts for pts/3, tty for tty1, x11 for :0 */
+const char *users_tty_class(const char *line, char *buffer, size_t size);
+
+/* seconds since the terminal device in /dev was used, -1 if unknown */
+long long users_tty_idle(const char *line);
+
+/*
+ * Enumerates the sessions once and groups them, with systemd-logind or
+ * the utmpx database depending on what the plugin was built with.
+ * errorcode is 0 or one of the errors of get_num_of_users_*.
+ */
+users_breakdown users_breakdown_systemd(users_group_by group_by, long long idle_time);
+users_breakdown users_breakdown_utmp(users_group_by group_by, long long idle_time);
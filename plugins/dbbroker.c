@@ -0,0 +1,698 @@
+/*****************************************************************************
+ *
+ * Monitoring Plugins database connection broker
+ *
+ * License: GPL
+ * Copyright (c) 2024 Monitoring Plugins Development Team
+ *
+ * Description:
+ *
+ * This file contains the connection broker shared by check_pgsql and
+ * check_mysql_query, see dbbroker.h.
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "dbbroker.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+
+#ifdef HAVE_SYS_UN_H
+#	include <sys/un.h>
+#endif
+
+/* a client has this many seconds to send its request and read the reply */
+#define DBBROKER_IO_TIMEOUT 10
+/* how often a starting broker is tried, 20ms apart */
+#define DBBROKER_START_TRIES 50
+/* connection strings and queries are not longer than this */
+#define DBBROKER_MAX_STRING (1024 * 1024)
+
+void dbbroker_reply_free(dbbroker_reply *reply) {
+	free(reply->value);
+	free(reply->message);
+	reply->value = NULL;
+	reply->message = NULL;
+}
+
+#ifdef HAVE_SYS_UN_H
+
+static bool dbbroker_write_all(int socket_fd, const void *buffer, size_t length) {
+	const char *position = buffer;
+	while (length > 0) {
+		ssize_t written = write(socket_fd, position, length);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			return false;
+		}
+		position += written;
+		length -= (size_t)written;
+	}
+	return true;
+}
+
+static bool dbbroker_read_all(int socket_fd, void *buffer, size_t length) {
+	char *position = buffer;
+	while (length > 0) {
+		ssize_t got = read(socket_fd, position, length);
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got <= 0) {
+			return false;
+		}
+		position += got;
+		length -= (size_t)got;
+	}
+	return true;
+}
+
+/* the messages are strings with their length in front, NULL is sent as an empty string */
+static bool dbbroker_send(int socket_fd, const char *string) {
+	size_t length = string == NULL ? 0 : strlen(string);
+	uint32_t header = htonl((uint32_t)length);
+	return dbbroker_write_all(socket_fd, &header, sizeof(header)) &&
+		   dbbroker_write_all(socket_fd, string, length);
+}
+
+static char *dbbroker_receive(int socket_fd) {
+	uint32_t header;
+	if (!dbbroker_read_all(socket_fd, &header, sizeof(header))) {
+		return NULL;
+	}
+	size_t length = ntohl(header);
+	if (length > DBBROKER_MAX_STRING) {
+		return NULL;
+	}
+	char *result = malloc(length + 1);
+	if (result == NULL) {
+		return NULL;
+	}
+	if (!dbbroker_read_all(socket_fd, result, length)) {
+		free(result);
+		return NULL;
+	}
+	result[length] = '\0';
+	return result;
+}
+
+static bool dbbroker_address(const char *socket_path, struct sockaddr_un *address) {
+	memset(address, 0, sizeof(*address));
+	address->sun_family = AF_UNIX;
+	if (strlen(socket_path) >= sizeof(address->sun_path)) {
+		return false;
+	}
+	strcpy(address->sun_path, socket_path);
+	return true;
+}
+
+static int dbbroker_connect(const char *socket_path) {
+	struct sockaddr_un address;
+	if (!dbbroker_address(socket_path, &address)) {
+		return -1;
+	}
+	int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (socket_fd < 0) {
+		return -1;
+	}
+	if (connect(socket_fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+		close(socket_fd);
+		return -1;
+	}
+	return socket_fd;
+}
+
+static void dbbroker_set_timeouts(int socket_fd) {
+	struct timeval timeout = {
+		.tv_sec = DBBROKER_IO_TIMEOUT,
+	};
+	setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+typedef struct {
+	char *dsn; /* NULL without a connection */
+	void *connection;
+} dbbroker_connection;
+
+static void dbbroker_drop(const dbbroker_backend *backend, dbbroker_connection *kept) {
+	backend->close(kept->connection);
+	free(kept->dsn);
+	*kept = (dbbroker_connection){0};
+}
+
+static dbbroker_reply dbbroker_execute(const dbbroker_backend *backend, dbbroker_connection *kept,
+									   const char *dsn, const char *query) {
+	dbbroker_reply result = {
+		.status = DBBROKER_OK,
+	};
+
+	if (kept->dsn != NULL) {
+		if (backend->alive(kept->connection)) {
+			result.reused = true;
+		} else {
+			dbbroker_drop(backend, kept);
+		}
+	}
+
+	if (!result.reused) {
+		struct timeval start;
+		gettimeofday(&start, NULL);
+		void *connection = backend->connect(dsn, &result);
+		result.connect_time = delta_time(start);
+		if (connection == NULL) {
+			result.status = DBBROKER_CONNECT_FAILED;
+			return result;
+		}
+		kept->dsn = strdup(dsn);
+		kept->connection = connection;
+	}
+
+	if (query != NULL && query[0] != '\0') {
+		struct timeval start;
+		gettimeofday(&start, NULL);
+		dbbroker_reply query_result = backend->query(kept->connection, query);
+		result.query_time = delta_time(start);
+		result.status = query_result.status;
+		result.value = query_result.value;
+		result.message = query_result.message;
+		result.error_code = query_result.error_code;
+	}
+	return result;
+}
+
+static void dbbroker_send_reply(int client, const dbbroker_reply *reply) {
+	char *numbers;
+	xasprintf(&numbers, "%d %d %d %f %f", (int)reply->status, reply->reused ? 1 : 0,
+			  reply->error_code, reply->connect_time, reply->query_time);
+	/* a client which went away meanwhile does not matter */
+	if (dbbroker_send(client, numbers) && dbbroker_send(client, reply->value)) {
+		dbbroker_send(client, reply->message);
+	}
+	free(numbers);
+}
+
+/* hands the socket of a client to a worker, the byte only carries the descriptor */
+static bool dbbroker_pass_client(int channel, int client) {
+	char byte = 0;
+	struct iovec data = {
+		.iov_base = &byte,
+		.iov_len = 1,
+	};
+	union {
+		struct cmsghdr header;
+		char buffer[CMSG_SPACE(sizeof(int))];
+	} control;
+	memset(&control, 0, sizeof(control));
+	struct msghdr message = {
+		.msg_iov = &data,
+		.msg_iovlen = 1,
+		.msg_control = control.buffer,
+		.msg_controllen = sizeof(control.buffer),
+	};
+	struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(header), &client, sizeof(int));
+
+	ssize_t sent;
+	do {
+		sent = sendmsg(channel, &message, 0);
+	} while (sent < 0 && errno == EINTR);
+	return sent == 1;
+}
+
+/* the socket of the next client, -1 once the broker closed the channel */
+static int dbbroker_take_client(int channel) {
+	while (true) {
+		char byte;
+		struct iovec data = {
+			.iov_base = &byte,
+			.iov_len = 1,
+		};
+		union {
+			struct cmsghdr header;
+			char buffer[CMSG_SPACE(sizeof(int))];
+		} control;
+		struct msghdr message = {
+			.msg_iov = &data,
+			.msg_iovlen = 1,
+			.msg_control = control.buffer,
+			.msg_controllen = sizeof(control.buffer),
+		};
+
+		ssize_t got = recvmsg(channel, &message, 0);
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got <= 0) {
+			return -1;
+		}
+		struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+		if (header != NULL && header->cmsg_level == SOL_SOCKET &&
+			header->cmsg_type == SCM_RIGHTS) {
+			int client;
+			memcpy(&client, CMSG_DATA(header), sizeof(int));
+			return client;
+		}
+	}
+}
+
+/*
+ * A worker keeps the connection to one connection string and runs the
+ * queries of the clients the broker hands to it, one after the other. It
+ * exits when the broker closes the channel.
+ */
+static void dbbroker_work(int channel, const dbbroker_backend *backend, const char *dsn) {
+	dbbroker_connection kept = {0};
+	for (int client = dbbroker_take_client(channel); client >= 0;
+		 client = dbbroker_take_client(channel)) {
+		char *query = dbbroker_receive(client);
+		if (query != NULL) {
+			dbbroker_reply reply = dbbroker_execute(backend, &kept, dsn, query);
+			dbbroker_send_reply(client, &reply);
+			dbbroker_reply_free(&reply);
+			free(query);
+		}
+		close(client);
+	}
+	if (kept.dsn != NULL) {
+		dbbroker_drop(backend, &kept);
+	}
+	_exit(STATE_OK);
+}
+
+typedef struct {
+	char *dsn;   /* NULL for a free slot */
+	int channel; /* the broker end of the socket pair to the worker */
+	time_t last_used;
+} dbbroker_worker;
+
+/* the worker finishes the clients it already has and exits */
+static void dbbroker_stop(dbbroker_worker *worker) {
+	close(worker->channel);
+	free(worker->dsn);
+	*worker = (dbbroker_worker){0};
+}
+
+/* the worker of the connection string, or a free slot, or the least recently used one */
+static dbbroker_worker *dbbroker_worker_slot(dbbroker_worker *workers, const char *dsn) {
+	dbbroker_worker *result = NULL;
+	for (int i = 0; i < DBBROKER_MAX_CONNECTIONS; i++) {
+		if (workers[i].dsn != NULL && strcmp(workers[i].dsn, dsn) == 0) {
+			return &workers[i];
+		}
+		if (result == NULL ||
+			(result->dsn != NULL &&
+			 (workers[i].dsn == NULL || workers[i].last_used < result->last_used))) {
+			result = &workers[i];
+		}
+	}
+	return result;
+}
+
+static bool dbbroker_spawn(dbbroker_worker *workers, dbbroker_worker *worker, int listener,
+						   int client, const dbbroker_backend *backend, const char *dsn) {
+	int channels[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, channels) != 0) {
+		return false;
+	}
+	pid_t child = fork();
+	if (child < 0) {
+		close(channels[0]);
+		close(channels[1]);
+		return false;
+	}
+	if (child == 0) {
+		/* the worker only gets its clients through the channel */
+		close(listener);
+		close(client);
+		close(channels[0]);
+		for (int i = 0; i < DBBROKER_MAX_CONNECTIONS; i++) {
+			if (workers[i].dsn != NULL) {
+				close(workers[i].channel);
+			}
+		}
+		dbbroker_work(channels[1], backend, dsn);
+	}
+	close(channels[1]);
+	worker->dsn = strdup(dsn);
+	worker->channel = channels[0];
+	return true;
+}
+
+/* the user on the other end of the socket, false if the system does not tell */
+static bool dbbroker_peer_uid(int socket_fd, uid_t *uid) {
+#	if defined(SO_PEERCRED)
+	struct ucred credentials;
+	socklen_t length = sizeof(credentials);
+	if (getsockopt(socket_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+		return false;
+	}
+	*uid = credentials.uid;
+	return true;
+#	elif defined(HAVE_GETPEEREID)
+	gid_t gid;
+	return getpeereid(socket_fd, uid, &gid) == 0;
+#	else
+	(void)socket_fd;
+	(void)uid;
+	return false;
+#	endif
+}
+
+static bool dbbroker_same_user(int client) {
+	uid_t uid;
+	if (!dbbroker_peer_uid(client, &uid)) {
+		/* the socket is only accessible for its owner anyway */
+		return true;
+	}
+	return uid == getuid();
+}
+
+/*
+ * The connection strings hold passwords, they are only sent to a broker
+ * of the same user or root. Without peer credentials the owner of the
+ * socket file has to do, the directory check keeps others from replacing it.
+ */
+static bool dbbroker_trusted_broker(int socket_fd, const char *socket_path) {
+	uid_t uid;
+	if (!dbbroker_peer_uid(socket_fd, &uid)) {
+		struct stat socket_stat;
+		if (lstat(socket_path, &socket_stat) != 0) {
+			return false;
+		}
+		uid = socket_stat.st_uid;
+	}
+	return uid == getuid() || uid == 0;
+}
+
+/* others must not be able to put a socket of their own in place of the broker */
+static bool dbbroker_safe_directory(const char *socket_path) {
+	char *directory = strdup(socket_path);
+	if (directory == NULL) {
+		return false;
+	}
+	char *slash = strrchr(directory, '/');
+	if (slash == NULL) {
+		strcpy(directory, ".");
+	} else {
+		slash[slash == directory ? 1 : 0] = '\0';
+	}
+
+	struct stat directory_stat;
+	bool result = stat(directory, &directory_stat) == 0 && S_ISDIR(directory_stat.st_mode) &&
+				  (directory_stat.st_uid == getuid() || directory_stat.st_uid == 0) &&
+				  (directory_stat.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+	free(directory);
+	return result;
+}
+
+/*
+ * Reads which database the client wants and hands it to the worker of that
+ * connection string, which reads the query and answers. A slow server only
+ * holds up the checks of its own connection string.
+ */
+static void dbbroker_handle(int client, int listener, const dbbroker_backend *backend,
+							dbbroker_worker *workers) {
+	dbbroker_set_timeouts(client);
+	if (!dbbroker_same_user(client)) {
+		return;
+	}
+
+	char *name = dbbroker_receive(client);
+	char *dsn = name == NULL ? NULL : dbbroker_receive(client);
+	if (dsn == NULL) {
+		free(name);
+		return;
+	}
+
+	if (strcmp(name, backend->name) != 0) {
+		/* the query is read so that the client gets to the reply */
+		free(dbbroker_receive(client));
+		dbbroker_reply reply = {
+			.status = DBBROKER_UNAVAILABLE,
+		};
+		xasprintf(&reply.message, "the broker on this socket is for %s", backend->name);
+		dbbroker_send_reply(client, &reply);
+		dbbroker_reply_free(&reply);
+		free(name);
+		free(dsn);
+		return;
+	}
+
+	dbbroker_worker *worker = dbbroker_worker_slot(workers, dsn);
+	if (worker->dsn != NULL && strcmp(worker->dsn, dsn) != 0) {
+		/* all slots are taken */
+		dbbroker_stop(worker);
+	}
+	bool passed = worker->dsn != NULL && dbbroker_pass_client(worker->channel, client);
+	if (!passed) {
+		/* a worker which died is replaced */
+		if (worker->dsn != NULL) {
+			dbbroker_stop(worker);
+		}
+		passed = dbbroker_spawn(workers, worker, listener, client, backend, dsn) &&
+				 dbbroker_pass_client(worker->channel, client);
+	}
+	if (passed) {
+		worker->last_used = time(NULL);
+	}
+
+	free(name);
+	free(dsn);
+}
+
+static void dbbroker_serve(int listener, const dbbroker_backend *backend) {
+	dbbroker_worker workers[DBBROKER_MAX_CONNECTIONS] = {0};
+	time_t last_request = time(NULL);
+
+	while (true) {
+		struct pollfd listener_poll = {
+			.fd = listener,
+			.events = POLLIN,
+		};
+		/* wake up now and then to stop idle workers */
+		int ready = poll(&listener_poll, 1, 10 * 1000);
+
+		while (waitpid(-1, NULL, WNOHANG) > 0) {
+		}
+
+		time_t now = time(NULL);
+		for (int i = 0; i < DBBROKER_MAX_CONNECTIONS; i++) {
+			if (workers[i].dsn != NULL && now - workers[i].last_used >= DBBROKER_IDLE_TIMEOUT) {
+				dbbroker_stop(&workers[i]);
+			}
+		}
+
+		if (ready <= 0) {
+			if (now - last_request >= DBBROKER_EXIT_TIMEOUT) {
+				break;
+			}
+			continue;
+		}
+
+		int client = accept(listener, NULL, NULL);
+		if (client < 0) {
+			continue;
+		}
+		dbbroker_handle(client, listener, backend, workers);
+		close(client);
+		last_request = time(NULL);
+	}
+
+	for (int i = 0; i < DBBROKER_MAX_CONNECTIONS; i++) {
+		if (workers[i].dsn != NULL) {
+			dbbroker_stop(&workers[i]);
+		}
+	}
+}
+
+/* runs in the background until the broker exits */
+static void dbbroker_daemon(const char *socket_path, const dbbroker_backend *backend) {
+	/* the monitoring core waits for the output pipe of the plugin to be closed */
+	int null_fd = open("/dev/null", O_RDWR);
+	if (null_fd >= 0) {
+		dup2(null_fd, STDIN_FILENO);
+		dup2(null_fd, STDOUT_FILENO);
+		dup2(null_fd, STDERR_FILENO);
+	}
+	long max_fd = sysconf(_SC_OPEN_MAX);
+	for (long fd = STDERR_FILENO + 1; fd < (max_fd > 0 ? max_fd : 1024); fd++) {
+		close((int)fd);
+	}
+
+	signal(SIGALRM, SIG_DFL);
+	signal(SIGHUP, SIG_IGN);
+	signal(SIGPIPE, SIG_IGN);
+	umask(077);
+
+	/* only one broker per socket, the lock file holds its pid */
+	char *lock_path;
+	xasprintf(&lock_path, "%s.lock", socket_path);
+	int lock_fd = open(lock_path, O_RDWR | O_CREAT, 0600);
+	struct flock lock = {
+		.l_type = F_WRLCK,
+		.l_whence = SEEK_SET,
+	};
+	if (lock_fd < 0 || fcntl(lock_fd, F_SETLK, &lock) != 0) {
+		_exit(STATE_OK);
+	}
+	char pid[32];
+	int pid_length = snprintf(pid, sizeof(pid), "%ld\n", (long)getpid());
+	if (ftruncate(lock_fd, 0) == 0) {
+		dbbroker_write_all(lock_fd, pid, (size_t)pid_length);
+	}
+
+	/* a socket left behind by a broker which did not exit cleanly */
+	unlink(socket_path);
+
+	struct sockaddr_un address;
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0 || !dbbroker_address(socket_path, &address) ||
+		bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+		listen(listener, 16) != 0) {
+		_exit(STATE_UNKNOWN);
+	}
+	if (chdir("/") != 0) {
+		/* only to not keep a file system busy */
+	}
+
+	dbbroker_serve(listener, backend);
+
+	unlink(socket_path);
+	close(listener);
+	_exit(STATE_OK);
+}
+
+static bool dbbroker_start(const char *socket_path, const dbbroker_backend *backend) {
+	pid_t child = fork();
+	if (child < 0) {
+		return false;
+	}
+	if (child == 0) {
+		/* forked twice, the broker is not a child of the plugin */
+		setsid();
+		pid_t broker = fork();
+		if (broker != 0) {
+			_exit(broker < 0 ? STATE_UNKNOWN : STATE_OK);
+		}
+		dbbroker_daemon(socket_path, backend);
+	}
+	int status;
+	while (waitpid(child, &status, 0) < 0 && errno == EINTR) {
+	}
+	return WIFEXITED(status) && WEXITSTATUS(status) == STATE_OK;
+}
+
+dbbroker_reply dbbroker_request(const char *socket_path, const dbbroker_backend *backend,
+								const char *dsn, const char *query) {
+	dbbroker_reply result = {
+		.status = DBBROKER_UNAVAILABLE,
+	};
+
+	struct sockaddr_un address;
+	if (!dbbroker_address(socket_path, &address)) {
+		xasprintf(&result.message, "the socket path %s is too long", socket_path);
+		return result;
+	}
+	if (!dbbroker_safe_directory(socket_path)) {
+		xasprintf(&result.message,
+				  "the directory of %s is writable or owned by other users, not using it",
+				  socket_path);
+		return result;
+	}
+
+	int socket_fd = dbbroker_connect(socket_path);
+	if (socket_fd < 0) {
+		if (!dbbroker_start(socket_path, backend)) {
+			xasprintf(&result.message, "could not start a broker on %s", socket_path);
+			return result;
+		}
+		for (int i = 0; i < DBBROKER_START_TRIES && socket_fd < 0; i++) {
+			usleep(20 * 1000);
+			socket_fd = dbbroker_connect(socket_path);
+		}
+		if (socket_fd < 0) {
+			xasprintf(&result.message, "no broker is listening on %s", socket_path);
+			return result;
+		}
+	}
+	if (!dbbroker_trusted_broker(socket_fd, socket_path)) {
+		close(socket_fd);
+		xasprintf(&result.message, "the broker on %s belongs to another user", socket_path);
+		return result;
+	}
+
+	/* the time the broker may take is bounded by the timeout of the plugin */
+	char *numbers = NULL;
+	if (dbbroker_send(socket_fd, backend->name) && dbbroker_send(socket_fd, dsn) &&
+		dbbroker_send(socket_fd, query) && (numbers = dbbroker_receive(socket_fd)) != NULL) {
+		int status;
+		int reused;
+		if (sscanf(numbers, "%d %d %d %lf %lf", &status, &reused, &result.error_code,
+				   &result.connect_time, &result.query_time) == 5 &&
+			status >= DBBROKER_OK && status <= DBBROKER_UNAVAILABLE) {
+			result.status = (dbbroker_status)status;
+			result.reused = reused != 0;
+			result.value = dbbroker_receive(socket_fd);
+			result.message = dbbroker_receive(socket_fd);
+		}
+	}
+	close(socket_fd);
+	free(numbers);
+
+	/* empty strings stand for NULL */
+	if (result.value != NULL && result.value[0] == '\0') {
+		free(result.value);
+		result.value = NULL;
+	}
+	if (result.message != NULL && result.message[0] == '\0') {
+		free(result.message);
+		result.message = NULL;
+	}
+	if (result.status == DBBROKER_UNAVAILABLE && result.message == NULL) {
+		xasprintf(&result.message, "the broker on %s did not answer", socket_path);
+	}
+	return result;
+}
+
+#else
+
+dbbroker_reply dbbroker_request(const char *socket_path, const dbbroker_backend *backend,
+								const char *dsn, const char *query) {
+	dbbroker_reply result = {
+		.status = DBBROKER_UNAVAILABLE,
+	};
+	xasprintf(&result.message, "Unix sockets are not supported on this system");
+	return result;
+}
+
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "../config.h"
+#include <stdbool.h>
+
+/*
+ * A local connection broker for the database plugins. The broker is a
+ * background copy of the plugin which keeps the database connections of
+ * earlier checks open. Every connection string gets a worker process with
+ * its own connection, which runs the checks for it one after the other,
+ * while the checks of other connection strings go on in their workers.
+ * The plugins send their query over a Unix socket instead of connecting
+ * themselves. The first plugin which finds no broker on the socket starts
+ * one, it exits again after DBBROKER_EXIT_TIMEOUT seconds without requests.
+ */
+
+/* workers unused for this many seconds are stopped and close their connection */
+#define DBBROKER_IDLE_TIMEOUT 300
+/* the broker exits after this many seconds without a request */
+#define DBBROKER_EXIT_TIMEOUT 900
+/* at most this many workers */
+#define DBBROKER_MAX_CONNECTIONS 32
+/* the checks of one connection string wait for each other, connecting gives up after this */
+#define DBBROKER_CONNECT_TIMEOUT 10
+
+typedef enum {
+	DBBROKER_OK,
+	DBBROKER_CONNECT_FAILED,
+	DBBROKER_QUERY_FAILED,
+	DBBROKER_NO_ROWS,
+	DBBROKER_NO_COLUMNS,
+	DBBROKER_NO_DATA,
+	DBBROKER_UNAVAILABLE, /* no broker could be reached, the plugin has to connect itself */
+} dbbroker_status;
+
+typedef struct {
+	dbbroker_status status;
+	bool reused;         /* the connection was kept open from an earlier check */
+	double connect_time; /* seconds, 0 for a reused connection */
+	double query_time;   /* seconds */
+	char *value;         /* the first column of the first row, or NULL */
+	char *message;       /* the error of the database library, or NULL */
+	int error_code;      /* the error number of the database library, 0 if there is none */
+} dbbroker_reply;
+
+/* what the broker needs to know about the database library */
+typedef struct {
+	const char *name; /* a broker only answers plugins with the same backend */
+	/* returns NULL and sets the message and error code of the reply if there is no connection */
+	void *(*connect)(const char *dsn, dbbroker_reply *reply);
+	/* whether a kept connection still works, it is asked before every reuse */
+	bool (*alive)(void *connection);
+	/* sets status, value, message and error code of the reply */
+	dbbroker_reply (*query)(void *connection, const char *query);
+	void (*close)(void *connection);
+} dbbroker_backend;
+
+/*
+ * Runs the query (or only connects if it is NULL) through the broker
+ * listening on socket_path and starts the broker if there is none.
+ * The status is DBBROKER_UNAVAILABLE if that did not work.
+ */
+dbbroker_reply dbbroker_request(const char *socket_path, const dbbroker_backend *backend,
+								const char *dsn, const char *query);
+
+void dbbroker_reply_free(dbbroker_reply *reply);
@@ -15,7 +15,7 @@ use vars qw($tests);
 
 plan skip_all => "check_dbi not compiled" unless (-x "check_dbi");
 
-$tests = 20;
+$tests = 30;
 plan tests => $tests;
 
 my $missing_driver_output = "failed to open DBI driver 'sqlite3'";
@@ -27,6 +27,8 @@ my $no_rows_output       = "/no rows returned/";
 my $not_numeric_output   = "/result value is not a numeric:/";
 my $query_time_output    = "/connection time: [0-9\.]+s, 'SELECT 1' returned 1.000000 in [0-9\.]+s \|/";
 my $syntax_error_output  = "/1: near \"GET\": syntax error/";
+my $batch_failed_output  = "/broken: query failed: /";
+my $batch_nan_output     = "/text: query result is not numeric/";
 
 my $result;
 
@@ -96,6 +98,32 @@ SKIP: {
 	cmp_ok($result->return_code, '==', 0, "QUERY_TIME metric okay");
 	like($result->output, $query_time_output, "QUERY_TIME metric output okay");
 
+	$result = NPTest->testCmd("$check_cmd --batch-query='one,,,,SELECT 1' --batch-query='two,QUERY_RESULT,5,10,SELECT 2'");
+	cmp_ok($result->return_code, '==', 0, "Batch queries okay");
+	like($result->output, "/one: 1/", "First batch query has its own subcheck");
+	like($result->output, "/two: 2/", "Second batch query has its own subcheck");
+
+	$result = NPTest->testCmd("$check_cmd --batch-query='one,,,,SELECT 1' --batch-query='broken,,,,GET ALL FROM test'");
+	cmp_ok($result->return_code, '==', 2, "A failing batch query is critical");
+	like($result->output, $batch_failed_output, "Failing batch query error message");
+	like($result->output, "/one: 1/", "The other batch queries still run");
+
+	$result = NPTest->testCmd("$check_cmd --batch-query='text,,,,SELECT b FROM test'");
+	cmp_ok($result->return_code, '==', 2, "Batch query value is not a numeric");
+	like($result->output, $batch_nan_output, "Batch query value is not a numeric error message");
+
+	my $ini = File::Temp->new(
+		TEMPLATE => "/tmp/check_dbi_batch.XXXXXXX",
+		SUFFIX   => ".ini",
+		UNLINK   => 1,
+	);
+	print $ini "[check_dbi]\nquery=SELECT 42\n\n[check_dbi_batch]\nrows = QUERY_RESULT,,,SELECT COUNT(*) FROM test\n";
+	close($ini);
+
+	$result = NPTest->testCmd("$check_cmd --batch-section=@" . $ini->filename);
+	cmp_ok($result->return_code, '==', 0, "Batch queries from the default section okay");
+	like($result->output, "/rows: 2/", "The default section is [check_dbi_batch]");
+
 	$result = NPTest->testCmd("./check_dbi -d nodriver -q ''");
 	cmp_ok($result->return_code, '==', 3, "Unknown DBI driver");
 	like($result->output, $bad_driver_output, "Correct error message");
@@ -17,7 +17,7 @@ my $hostname_invalid   = getTestParameter("NP_HOSTNAME_INVALID", "An invalid (no
 my($result, $cmd);
 my $command = './check_ldap';
 
-plan tests => 16;
+plan tests => 25;
 
 SKIP: {
     skip "NP_HOST_NONRESPONSIVE not set", 2 if ! $host_nonresponsive;
@@ -69,3 +69,32 @@ SKIP: {
     is( $result->return_code, 0, $cmd );
     like( $result->output, '/found \d+ entries/', "output ok" );
 };
+
+SKIP: {
+    skip "NP_HOST_TCP_LDAP not set", 9 if ! $host_tcp_ldap;
+    skip "NP_LDAP_BASE_DN not set",  9 if ! $ldap_base_dn;
+
+    $cmd = "$command -H $host_tcp_ldap -b $ldap_base_dn -t 5 -3";
+    $result = NPTest->testCmd($cmd);
+    is( $result->return_code, 0, $cmd );
+    like( $result->output, "/'bind_time'=[\\d.]+s/", "bind time perfdata ok" );
+    like( $result->output, "/'first_entry_time'=[\\d.]+s/", "first entry time perfdata ok" );
+    like( $result->output, "/'search_time'=[\\d.]+s/", "search time perfdata ok" );
+
+    # one entry per page, the cookie of every page leads to the next one
+    $cmd = "$command -H $host_tcp_ldap -b $ldap_base_dn -t 5 -3 -W 10000000 -C 10000001";
+    $result = NPTest->testCmd($cmd);
+    my ($entries) = $result->output =~ /found (\d+) entries/;
+    $entries = -1 unless defined $entries;
+    $result = NPTest->testCmd("$cmd --page-size=1 -v");
+    is( $result->return_code, 0, "$cmd --page-size=1" );
+    like( $result->output, "/found $entries entries/", "paged search finds the same entries" );
+    my ($pages) = $result->output =~ /in (\d+) page\(s\)/;
+    cmp_ok( $pages || 0, '>=', $entries, "every page was requested" );
+
+    # the error comes with the result of the search, not when it is sent
+    $cmd = "$command -H $host_tcp_ldap -b ou=nosuchou,$ldap_base_dn -t 5 -3 -W 10000000 -C 10000001";
+    $result = NPTest->testCmd($cmd);
+    is( $result->return_code, 2, $cmd );
+    like( $result->output, '/could not search\/find objectclasses in ou=nosuchou/', "output ok" );
+};
@@ -8,6 +8,7 @@ use strict;
 use warnings;
 use Test::More;
 use NPTest;
+use IO::Socket::INET;
 
 my $host_tcp_smtp            = getTestParameter( "NP_HOST_TCP_SMTP",
 					   "A host providing an SMTP Service (a mail server)", "mailhost");
@@ -25,7 +26,7 @@ my $hostname_invalid   = getTestParameter( "NP_HOSTNAME_INVALID",
                                            "An invalid (not known to DNS) hostname", "nosuchhost" );
 my $res;
 
-plan tests => 13;
+plan tests => 19;
 
 SKIP: {
 	skip "No SMTP server defined", 4 unless $host_tcp_smtp;
@@ -80,3 +81,56 @@ is ($res->return_code, 2, "CRITICAL - host non responding" );
 $res = NPTest->testCmd( "./check_smtp $hostname_invalid" );
 is ($res->return_code, 3, "UNKNOWN - hostname invalid" );
 
+
+# A local SMTP server for one connection. It records the command lines
+# of every read, so a pipelined group shows up as one read.
+sub fake_smtp_server {
+	my ($pipelining) = @_;
+	my $listener = IO::Socket::INET->new(LocalAddr => "127.0.0.1", LocalPort => 0,
+		Listen => 1, ReuseAddr => 1) or die "listen: $!";
+	my $log = "/tmp/check_smtp_fake.$$." . $listener->sockport;
+	my $pid = fork();
+	if ($pid == 0) {
+		my $client = $listener->accept();
+		open(my $reads, ">", $log);
+		$client->syswrite("220 fake ESMTP\r\n");
+		my $data;
+		while ($client->sysread($data, 4096)) {
+			my @lines = grep { length } split(/\r\n/, $data);
+			print $reads join(",", map { (split(/[ :]/, $_))[0] } @lines), "\n";
+			for my $line (@lines) {
+				if ($line =~ /^EHLO/) {
+					$client->syswrite($pipelining ? "250-fake\r\n250 PIPELINING\r\n"
+						: "250 fake\r\n");
+				} elsif ($line =~ /^QUIT/) {
+					$client->syswrite("221 bye\r\n");
+				} else {
+					$client->syswrite("250 ok\r\n");
+				}
+			}
+			last if grep { /^QUIT/ } @lines;
+		}
+		close($reads);
+		exit(0);
+	}
+	return ($listener->sockport, $pid, $log);
+}
+
+for my $pipelining (1, 0) {
+	my ($port, $pid, $log) = fake_smtp_server($pipelining);
+	$res = NPTest->testCmd( "./check_smtp -H 127.0.0.1 -p $port --pipelining "
+		. "-f sender\@example.com --rcpt one\@example.com --rcpt two\@example.com" );
+	waitpid($pid, 0);
+	open(my $reads, "<", $log);
+	my @reads = map { chomp; $_ } <$reads>;
+	unlink($log);
+
+	my $name = $pipelining ? "with PIPELINING" : "without PIPELINING";
+	is ($res->return_code, 0, "OK $name");
+	if ($pipelining) {
+		is ($reads[1], "MAIL,RCPT,RCPT", "MAIL FROM and RCPT TO are sent as one group");
+	} else {
+		is_deeply ([ @reads[1..3] ], [ "MAIL", "RCPT", "RCPT" ], "Commands are sent one by one");
+	}
+	is ($reads[-1], "QUIT", "QUIT is sent on its own $name");
+}
@@ -0,0 +1,114 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "../check_apt.d/apt_index.h"
+#include "../../tap/tap.h"
+
+void print_usage(void) {}
+
+const char *progname = "test_check_apt";
+
+static int compare(const char *left, const char *right) {
+	int result = apt_version_compare(left, strlen(left), right, strlen(right));
+	return (result > 0) - (result < 0);
+}
+
+static void write_file(const char *path, const char *contents) {
+	FILE *file = fopen(path, "w");
+	if (file != NULL) {
+		fputs(contents, file);
+		fclose(file);
+	}
+}
+
+int main(void) {
+	plan_tests(19);
+
+	ok(compare("1.0", "1.1") < 0, "1.0 < 1.1");
+	ok(compare("1.10", "1.9") > 0, "Numbers are compared numerically");
+	ok(compare("1.0", "1.00") == 0, "Leading zeros are ignored");
+	ok(compare("1.0~rc1", "1.0") < 0, "~ sorts before the end of the version");
+	ok(compare("1.0a", "1.0") > 0 && compare("1.0+b1", "1.0") > 0,
+	   "Letters and other characters sort after the end of the version");
+	ok(compare("1.0a", "1.0+") < 0, "Letters sort before the other characters");
+	ok(compare("1:0.9", "2.0") > 0, "The epoch is compared first");
+	ok(compare("1.0-1", "1.0-2") < 0 && compare("2.36-9+deb12u4", "2.36-9+deb12u3") > 0,
+	   "The Debian revision is compared last");
+	ok(compare("1.2-3-1", "1.2-3") > 0, "The revision starts after the last hyphen");
+
+	apt_index_result result = apt_index_upgradable("./var/dpkg_status", "./var/apt_lists");
+	ok(result.errorcode == OK, "Status and lists are read");
+	ok(result.count == 3, "Three packages can be upgraded");
+	ok(result.count == 3 && strcmp(result.packages[0].name, "libc6") == 0 &&
+		   strcmp(result.packages[1].name, "openssl") == 0 &&
+		   strcmp(result.packages[2].name, "tzdata") == 0,
+	   "Downgrades, other architectures and removed packages are ignored");
+	ok(result.count == 3 && result.packages[0].security && result.packages[1].security &&
+		   !result.packages[2].security,
+	   "Versions from the security suite are marked");
+	ok(result.count == 3 &&
+		   strcmp(result.packages[0].installed_version, "2.36-9+deb12u3") == 0 &&
+		   strcmp(result.packages[0].candidate_version, "2.36-9+deb12u4") == 0 &&
+		   strcmp(result.packages[2].architecture, "all") == 0,
+	   "Versions and architecture are reported");
+	apt_index_free(&result);
+
+	result = apt_index_upgradable("./var/no_such_status", "./var/apt_lists");
+	ok(result.errorcode == ERROR, "A missing status file is reported");
+
+	char directory[] = "/tmp/test_check_apt.XXXXXX";
+	if (mkdtemp(directory) == NULL) {
+		skip(4, "mkdtemp() failed");
+		return exit_status();
+	}
+	char *status_path = NULL;
+	xasprintf(&status_path, "%s/status", directory);
+
+	ok(apt_index_fingerprint(status_path, directory) == NULL,
+	   "No fingerprint without a status file");
+
+	write_file(status_path, "Package: bash\nStatus: install ok installed\nVersion: 1\n");
+	char *first = apt_index_fingerprint(status_path, directory);
+	char *second = apt_index_fingerprint(status_path, directory);
+	ok(first != NULL && second != NULL && strcmp(first, second) == 0,
+	   "The fingerprint is stable");
+
+	write_file(status_path, "Package: bash\nStatus: install ok installed\nVersion: 1.1\n");
+	free(second);
+	second = apt_index_fingerprint(status_path, directory);
+	ok(second != NULL && strcmp(first, second) != 0, "A changed status file changes it");
+
+	char *index_path = NULL;
+	xasprintf(&index_path, "%s/mirror_dists_stable_main_binary-amd64_Packages", directory);
+	write_file(index_path, "Package: bash\nVersion: 2\nArchitecture: amd64\n");
+	free(first);
+	first = apt_index_fingerprint(status_path, directory);
+	ok(first != NULL && strcmp(first, second) != 0, "A new index changes it");
+
+	unlink(index_path);
+	unlink(status_path);
+	rmdir(directory);
+	free(first);
+	free(second);
+	free(index_path);
+	free(status_path);
+
+	return exit_status();
+}
@@ -0,0 +1,86 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "../check_dig.d/dig_batch.h"
+#include "../../tap/tap.h"
+
+void print_usage(void) {}
+
+const char *progname = "test_check_dig";
+
+int main(void) {
+	plan_tests(22);
+
+	ok(dig_record_type_from_string("aaaa") == 28, "AAAA is type 28");
+	ok(dig_record_type_from_string("TYPE65") == 65, "RFC 3597 type notation");
+	ok(dig_record_type_from_string("BOGUS") == 0, "Unknown type is rejected");
+
+	uint8_t query[DIG_MAX_QUERY_SIZE];
+	size_t length = dig_encode_query(query, sizeof(query), 0x1234, "www.example.com.", 1);
+	ok(length == 12 + 17 + 4, "Query has the expected length");
+	ok(query[0] == 0x12 && query[1] == 0x34, "Query id is encoded");
+	ok(query[12] == 3 && memcmp(&query[13], "www", 3) == 0, "First label is encoded");
+	uint8_t invalid_query[DIG_MAX_QUERY_SIZE];
+	ok(dig_encode_query(invalid_query, sizeof(invalid_query), 1, "a..b", 1) == 0,
+	   "Empty label is rejected");
+
+	/* response to the query above: two A records, the second one using compression */
+	uint8_t response[DIG_MAX_PACKET_SIZE];
+	memcpy(response, query, length);
+	response[2] = 0x85; /* QR, AA, RD */
+	response[3] = 0x80; /* RA, NOERROR */
+	response[7] = 2;    /* ANCOUNT */
+	const uint8_t answers[] = {0xc0, 0x0c, 0, 1, 0, 1, 0, 0, 0x0e, 0x10, 0, 4, 192, 0,  2, 1,
+							   0xc0, 0x0c, 0, 1, 0, 1, 0, 0, 0x0e, 0x10, 0, 4, 192, 0, 2, 2};
+	memcpy(&response[length], answers, sizeof(answers));
+	size_t response_length = length + sizeof(answers);
+
+	dig_response_header header = dig_parse_response_header(response, response_length);
+	ok(header.errorcode == OK, "Response header is parsed");
+	ok(header.query_id == 0x1234, "Response id matches");
+	ok(strcmp(header.question, "www.example.com.") == 0, "Question name is decoded");
+	ok(header.qtype == 1, "Question type is decoded");
+	ok(dig_parse_response_header(query, length).errorcode == ERROR, "Queries are not responses");
+
+	dig_batch_result result = {0};
+	ok(dig_parse_response(response, response_length, &result) == OK, "Response is parsed");
+	ok(result.rcode == DIG_RCODE_NOERROR, "RCODE is NOERROR");
+	ok(result.authoritative, "AA flag is set");
+	ok(result.answer_count == 2, "Both answers are decoded");
+	ok(strcmp(result.answers[1], "www.example.com. 3600 IN A 192.0.2.2") == 0,
+	   "Answer is rendered like dig does");
+
+	dig_batch_query batch_query = {.name = "www.example.com", .expected = "192.0.2.2"};
+	dig_batch_match_answer(&batch_query, &result);
+	ok(result.answer_matched && result.matching_answer == result.answers[1],
+	   "Expected answer is found");
+	batch_query.expected = "192.0.2.3";
+	dig_batch_match_answer(&batch_query, &result);
+	ok(!result.answer_matched, "Missing answer is detected");
+
+	dig_batch_result truncated = {0};
+	ok(dig_parse_response(response, response_length - 3, &truncated) == ERROR,
+	   "Cut off answer without TC flag is an error");
+
+	const double latencies[] = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1.0};
+	ok(dig_percentile(latencies, 10, 50) == 0.5, "p50 uses the nearest rank");
+	ok(dig_percentile(latencies, 10, 99) == 1.0, "p99 of 10 values is the maximum");
+
+	return exit_status();
+}
@@ -0,0 +1,93 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "../check_game.d/query.h"
+#include "../../tap/tap.h"
+
+void print_usage(void) {}
+
+const char *progname = "test_check_game";
+
+int main(void) {
+	plan_tests(14);
+
+	game_status status;
+	uint32_t challenge = 0;
+
+	const char quake3[] = "\xff\xff\xff\xffstatusResponse\n"
+						  "\\sv_hostname\\^1My ^7Server\\mapname\\q3dm17\\sv_maxclients\\16\n"
+						  "5 50 \"player\"\n"
+						  "0 0 \"bot\"\n";
+	ok(game_parse_reply(GAME_QUAKE3, (const uint8_t *)quake3, sizeof(quake3) - 1, &status,
+						&challenge) == GAME_REPLY_STATUS,
+	   "A Quake 3 status is parsed");
+	ok(strcmp(status.name, "My Server") == 0 && strcmp(status.map, "q3dm17") == 0,
+	   "The colour codes are removed from the Quake 3 names");
+	ok(status.players == 2 && status.max_players == 16, "The Quake 3 players are counted");
+	game_status_free(&status);
+
+	const char quake3_other[] = "\xff\xff\xff\xffinfoResponse\n\\hostname\\x\n";
+	ok(game_parse_reply(GAME_QUAKE3, (const uint8_t *)quake3_other, sizeof(quake3_other) - 1,
+						&status, &challenge) == GAME_REPLY_INVALID,
+	   "Another Quake 3 reply is invalid");
+
+	const uint8_t a2s_challenge[] = {0xff, 0xff, 0xff, 0xff, 'A', 0x01, 0x02, 0x03, 0x04};
+	ok(game_parse_reply(GAME_A2S, a2s_challenge, sizeof(a2s_challenge), &status, &challenge) ==
+			   GAME_REPLY_CHALLENGE &&
+		   challenge == 0x04030201,
+	   "An A2S challenge is read");
+
+	uint8_t packet[GAME_MAX_PACKET_LENGTH];
+	size_t length = game_build_query(GAME_A2S, false, 0, packet);
+	ok(length == 25 && memcmp(packet + 4, "TSource Engine Query", 21) == 0,
+	   "The A2S query ends with a zero");
+	length = game_build_query(GAME_A2S, true, challenge, packet);
+	ok(length == 29 && memcmp(packet + 25, a2s_challenge + 5, 4) == 0,
+	   "The challenge is sent back as received");
+
+	const char a2s_info[] = "\xff\xff\xff\xffI\x11Name\0de_dust2\0cstrike\0Counter-Strike\0"
+							"\x0a\x00\x05\x20\x02\x64\x6c\x00\x01";
+	ok(game_parse_reply(GAME_A2S, (const uint8_t *)a2s_info, sizeof(a2s_info) - 1, &status,
+						&challenge) == GAME_REPLY_STATUS,
+	   "An A2S info reply is parsed");
+	ok(strcmp(status.name, "Name") == 0 && strcmp(status.map, "de_dust2") == 0 &&
+		   status.players == 5 && status.max_players == 32 && status.bots == 2,
+	   "The A2S fields are read");
+	game_status_free(&status);
+
+	ok(game_parse_reply(GAME_A2S, (const uint8_t *)a2s_info, 30, &status, &challenge) ==
+		   GAME_REPLY_INVALID,
+	   "A truncated A2S reply is invalid");
+
+	char *host;
+	char *port;
+	ok(game_split_address("example.com:27960", &host, &port) && strcmp(host, "example.com") == 0 &&
+		   strcmp(port, "27960") == 0,
+	   "A host with port is split");
+	ok(game_split_address("[2001:db8::1]:27015", &host, &port) &&
+		   strcmp(host, "2001:db8::1") == 0 && strcmp(port, "27015") == 0,
+	   "An IPv6 address in brackets is split");
+	ok(game_split_address("2001:db8::1", &host, &port) && strcmp(host, "2001:db8::1") == 0 &&
+		   port == NULL,
+	   "An IPv6 address without brackets has no port");
+	ok(!game_split_address("[2001:db8::1", &host, &port), "An unclosed bracket is rejected");
+
+	return exit_status();
+}
@@ -0,0 +1,203 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "../check_ide_smart.d/nvme.h"
+#include "../check_ide_smart.d/scan.h"
+#include "../../tap/tap.h"
+
+#include <sys/stat.h>
+
+void print_usage(void) {}
+
+const char *progname = "test_check_ide_smart";
+
+static void touch(const char *directory, const char *name) {
+	char path[MAX_INPUT_BUFFER];
+	snprintf(path, sizeof(path), "%s/%s", directory, name);
+	FILE *file = fopen(path, "w");
+	if (file != NULL) {
+		fclose(file);
+	}
+}
+
+static void remove_file(const char *directory, const char *name) {
+	char path[MAX_INPUT_BUFFER];
+	snprintf(path, sizeof(path), "%s/%s", directory, name);
+	unlink(path);
+}
+
+/* a /sys/block entry, with a device link for real hardware */
+static void make_block_device(const char *sys_block, const char *name, bool physical) {
+	char path[MAX_INPUT_BUFFER];
+	snprintf(path, sizeof(path), "%s/%s", sys_block, name);
+	mkdir(path, 0700);
+	if (physical) {
+		touch(path, "device");
+	}
+}
+
+static void remove_block_device(const char *sys_block, const char *name) {
+	char path[MAX_INPUT_BUFFER];
+	snprintf(path, sizeof(path), "%s/%s", sys_block, name);
+	remove_file(path, "device");
+	rmdir(path);
+}
+
+static char *join_devices(char **devices, size_t count) {
+	char *joined = NULL;
+	for (size_t i = 0; i < count; i++) {
+		const char *name = strrchr(devices[i], '/') + 1;
+		xasprintf(&joined, "%s%s%s", joined ? joined : "", joined ? "," : "", name);
+	}
+	return joined;
+}
+
+static void test_probe(const char *device, smart_probe_result *result) {
+	if (strcmp(device, "hanging") == 0) {
+		sleep(10);
+	} else if (strcmp(device, "crashing") == 0) {
+		_exit(1);
+	}
+	result->step = 4;
+	result->data[0] = (uint8_t)device[0];
+	result->data[SMART_PROBE_DATA_SIZE - 1] = 0x5a;
+	/* printed output must not reach the plugin output */
+	printf("noise from %s\n", device);
+}
+
+int main(void) {
+	plan_tests(17);
+
+	/* a SMART / Health Information log page as a controller returns it */
+	uint8_t log[NVME_SMART_LOG_SIZE];
+	memset(log, 0, sizeof(log));
+	log[0] = NVME_WARNING_SPARE | NVME_WARNING_DEGRADED;
+	log[1] = 0x3b; /* 315 K */
+	log[2] = 0x01;
+	log[3] = 95;
+	log[4] = 10;
+	log[5] = 3;
+	log[48] = 0x40; /* data units written 0x0140 */
+	log[49] = 0x01;
+	log[112] = 42;   /* power cycles */
+	log[128] = 0x10; /* power on hours 0x2710 = 10000 */
+	log[129] = 0x27;
+	log[144] = 7; /* unsafe shutdowns */
+	log[160] = 2; /* media errors */
+	log[176] = 0xff; /* error log entries with the upper 64 bits set */
+	log[184] = 1;
+
+	nvme_health health = nvme_parse_smart_log(log);
+	ok(health.critical_warning == (NVME_WARNING_SPARE | NVME_WARNING_DEGRADED),
+	   "Critical warning is read");
+	ok(health.temperature == 42, "Temperature is converted from Kelvin");
+	ok(health.available_spare == 95 && health.available_spare_threshold == 10,
+	   "Available spare and its threshold are read");
+	ok(health.percentage_used == 3, "Percentage used is read");
+	ok(health.data_units_written == 0x140 && health.power_cycles == 42,
+	   "Counters are little endian");
+	ok(health.power_on_hours == 10000 && health.unsafe_shutdowns == 7 && health.media_errors == 2,
+	   "Power on hours, unsafe shutdowns and media errors are read");
+	ok(health.error_log_entries == UINT64_MAX, "Counters beyond 64 bits are saturated");
+
+	ok(nvme_is_device_name("/dev/nvme0") && nvme_is_device_name("/dev/nvme1n1") &&
+		   nvme_is_device_name("nvme3"),
+	   "NVMe devices are recognised");
+	ok(!nvme_is_device_name("/dev/sda") && !nvme_is_device_name("/dev/nvme-fabrics") &&
+		   !nvme_is_device_name("/dev/nvme"),
+	   "Other devices are not");
+
+	char directory[] = "/tmp/test_check_ide_smart.XXXXXX";
+	if (mkdtemp(directory) == NULL) {
+		skip(3, "mkdtemp() failed");
+		return exit_status();
+	}
+
+	const char *names[] = {"nvme10", "nvme0n1", "nvme2", "nvme-fabrics", "sda", "nvme0"};
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		touch(directory, names[i]);
+	}
+
+	char **devices = NULL;
+	size_t count = nvme_list_controllers(directory, &devices);
+	ok(count == 3, "Only the controllers are listed");
+	char *expected = NULL;
+	xasprintf(&expected, "%s/nvme0|%s/nvme2|%s/nvme10", directory, directory, directory);
+	char *listed = NULL;
+	for (size_t i = 0; i < count; i++) {
+		xasprintf(&listed, "%s%s%s", listed ? listed : "", listed ? "|" : "", devices[i]);
+	}
+	ok(listed != NULL && strcmp(listed, expected) == 0, "Controllers are sorted numerically");
+	nvme_free_devices(devices, count);
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		remove_file(directory, names[i]);
+	}
+	rmdir(directory);
+
+	count = nvme_list_controllers(directory, &devices);
+	ok(count == 0 && devices == NULL, "A missing directory has no controllers");
+
+	char sys_block[] = "/tmp/test_check_ide_smart_sys.XXXXXX";
+	if (mkdtemp(sys_block) == NULL) {
+		skip(5, "mkdtemp() failed");
+		return exit_status();
+	}
+	struct {
+		const char *name;
+		bool physical;
+	} block_devices[] = {{"sdb", true},     {"loop0", false},   {"sdaa", true},
+						 {"nvme0n2", true}, {"nvme0n1", true},  {"nvme1n1", true},
+						 {"sr0", true},     {"dm-0", false},    {"sda", true},
+						 {"zram0", false},  {"nvme0n10", true}, {"vda", true}};
+	size_t block_device_count = sizeof(block_devices) / sizeof(block_devices[0]);
+	for (size_t i = 0; i < block_device_count; i++) {
+		make_block_device(sys_block, block_devices[i].name, block_devices[i].physical);
+	}
+
+	count = smart_list_block_devices(sys_block, "/dev", &devices);
+	char *joined = join_devices(devices, count);
+	ok(joined != NULL && strcmp(joined, "sda,sdb,vda,sdaa,nvme0n1,nvme1n1") == 0,
+	   "Disks are listed without virtual devices, optical drives and further namespaces");
+	ok(count > 0 && strcmp(devices[0], "/dev/sda") == 0, "Disks are listed as devices");
+	smart_free_devices(devices, count);
+
+	for (size_t i = 0; i < block_device_count; i++) {
+		remove_block_device(sys_block, block_devices[i].name);
+	}
+	rmdir(sys_block);
+
+	char *probed[] = {"answering", "hanging", "crashing", "fast"};
+	smart_probe_status statuses[4];
+	smart_probe_result results[4];
+	time_t start = time(NULL);
+	smart_probe_devices(probed, 4, test_probe, 1, statuses, results);
+	time_t elapsed = time(NULL) - start;
+
+	ok(statuses[0] == SMART_PROBE_DONE && statuses[3] == SMART_PROBE_DONE &&
+		   results[0].data[0] == 'a' && results[3].data[0] == 'f' && results[3].step == 4 &&
+		   results[3].data[SMART_PROBE_DATA_SIZE - 1] == 0x5a,
+	   "Results of the probes are handed back");
+	ok(statuses[1] == SMART_PROBE_TIMEOUT && statuses[2] == SMART_PROBE_FAILED,
+	   "A hanging probe times out, a crashing one fails");
+	ok(elapsed <= 3, "A hanging probe does not stall the others");
+
+	return exit_status();
+}
@@ -0,0 +1,81 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "../check_ldap.d/replicas.h"
+#include "../../tap/tap.h"
+
+void print_usage(void) {}
+
+const char *progname = "test_check_ldap";
+
+int main(void) {
+	plan_tests(12);
+
+	double time = 0;
+	ok(ldap_generalized_time_parse("20240501120000Z", &time) && time == 1714564800,
+	   "A modifyTimestamp is parsed");
+	ok(ldap_generalized_time_parse("20240501120000.250000Z", &time) && time == 1714564800.25,
+	   "The fraction of a second is kept");
+	ok(!ldap_generalized_time_parse("20240501120000", &time), "A time without zone is rejected");
+
+	ldap_csn csn = {0};
+	ok(ldap_csn_parse("20240501120000.000000Z#000000#00a#000000", &csn) && csn.sid == 10 &&
+		   csn.time == 1714564800,
+	   "The time and the hexadecimal server ID of a CSN are parsed");
+	ok(!ldap_csn_parse("20240501120000.000000Z", &csn), "A CSN needs a server ID");
+
+	ldap_csn_set provider = {0};
+	ldap_csn_set_add(&provider, (ldap_csn){.sid = 1, .time = 1000});
+	ldap_csn_set_add(&provider, (ldap_csn){.sid = 2, .time = 500});
+	ldap_csn_set_add(&provider, (ldap_csn){.sid = 1, .time = 900});
+	ok(provider.count == 2 && provider.csns[0].time == 1000,
+	   "Only the newest change per server ID is kept");
+
+	ldap_csn_set replica = {0};
+	ldap_csn_set_add(&replica, (ldap_csn){.sid = 1, .time = 970});
+	ldap_csn_set_add(&replica, (ldap_csn){.sid = 2, .time = 520});
+
+	ldap_csn_set newest = {0};
+	ldap_csn_set_merge(&newest, &provider);
+	ldap_csn_set_merge(&newest, &replica);
+	ok(newest.count == 2 && newest.csns[0].time == 1000 && newest.csns[1].time == 520,
+	   "The newest changes are merged per server ID");
+
+	ldap_replica_lag lag = ldap_csn_lag(&newest, &replica);
+	ok(lag.lag == 30 && lag.missing == 0, "The lag is the largest one of all server IDs");
+	lag = ldap_csn_lag(&newest, &provider);
+	ok(lag.lag == 20 && lag.missing == 0, "A provider can lag behind for another server ID");
+
+	ldap_csn_set partial = {0};
+	ldap_csn_set_add(&partial, (ldap_csn){.sid = 1, .time = 1000});
+	lag = ldap_csn_lag(&newest, &partial);
+	ok(lag.lag == 0 && lag.missing == 1, "A server ID without changes is counted as missing");
+
+	lag = ldap_csn_lag(&newest, &newest);
+	ok(lag.lag == 0 && lag.missing == 0, "The newest server does not lag");
+
+	ldap_csn_set_free(&provider);
+	ldap_csn_set_free(&replica);
+	ldap_csn_set_free(&newest);
+	ldap_csn_set_free(&partial);
+	ok(newest.count == 0 && newest.csns == NULL, "The sets are freed");
+
+	return exit_status();
+}
@@ -0,0 +1,234 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "../check_load.d/top_procs.h"
+#include "../check_load.d/pressure.h"
+#include "../../tap/tap.h"
+
+#include <sys/stat.h>
+#include <sys/time.h>
+
+void print_usage(void) {}
+
+const char *progname = "test_check_load";
+
+#define BENCHMARK_PROCESSES 50000
+#define BENCHMARK_TOP       10
+
+static double seconds_since(struct timeval start) {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (double)(now.tv_sec - start.tv_sec) + (double)(now.tv_usec - start.tv_usec) / 1.0e6;
+}
+
+static void write_stat(const char *proc_dir, const char *pid, const char *contents) {
+	char path[MAX_INPUT_BUFFER];
+	snprintf(path, sizeof(path), "%s/%s", proc_dir, pid);
+	mkdir(path, 0700);
+	snprintf(path, sizeof(path), "%s/%s/stat", proc_dir, pid);
+	FILE *stat_file = fopen(path, "w");
+	if (stat_file != NULL) {
+		fputs(contents, stat_file);
+		fclose(stat_file);
+	}
+}
+
+/* the reference the heap selection has to agree with: sort everything */
+static int compare_delta(const void *left, const void *right) {
+	const load_top_entry *entry_left = left;
+	const load_top_entry *entry_right = right;
+	if (entry_left->delta_ticks != entry_right->delta_ticks) {
+		return (entry_left->delta_ticks < entry_right->delta_ticks) ? 1 : -1;
+	}
+	if (entry_left->sample.cpu_ticks != entry_right->sample.cpu_ticks) {
+		return (entry_left->sample.cpu_ticks < entry_right->sample.cpu_ticks) ? 1 : -1;
+	}
+	return (entry_left->sample.pid > entry_right->sample.pid) ? 1 : -1;
+}
+
+static void remove_stat(const char *proc_dir, const char *pid) {
+	char path[MAX_INPUT_BUFFER];
+	snprintf(path, sizeof(path), "%s/%s/stat", proc_dir, pid);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/%s", proc_dir, pid);
+	rmdir(path);
+}
+
+int main(void) {
+	char proc_dir[] = "/tmp/test_check_load.XXXXXX";
+	if (mkdtemp(proc_dir) == NULL) {
+		return plan_skip_all("mkdtemp() failed");
+	}
+
+	plan_tests(24);
+
+	load_proc_sample sample;
+	ok(load_parse_proc_stat("4242 (bash) S 1 4242 4242 34816 4242 4194304 1303 5 0 0 120 35 0 0 "
+							"20 0 1 0 98765 8876032 1280 18446744073709551615 1 1 0 0 0 0",
+							&sample),
+	   "Plain stat line is parsed");
+	ok(sample.pid == 4242 && sample.state == 'S' && strcmp(sample.command, "bash") == 0,
+	   "Pid, state and command are read");
+	ok(sample.cpu_ticks == 155 && sample.start_time == 98765 && sample.rss_pages == 1280,
+	   "CPU time, start time and RSS are read");
+
+	ok(load_parse_proc_stat("17 (we(ird) cmd)) R 2 0 0 0 -1 69238880 0 0 0 0 7 3 0 0 20 0 1 0 "
+							"12 0 0 18446744073709551615",
+							&sample),
+	   "Command with blanks and parentheses is parsed");
+	ok(strcmp(sample.command, "we(ird) cmd)") == 0 && sample.cpu_ticks == 10,
+	   "Fields after the command are found behind the last parenthesis");
+	ok(!load_parse_proc_stat("99 (truncated) S 1 2", &sample), "Truncated stat line is rejected");
+
+	/* a synthetic /proc */
+	write_stat(proc_dir, "1", "1 (init) S 0 1 1 0 -1 0 0 0 0 0 500 200 0 0 20 0 1 0 1 0 100");
+	write_stat(proc_dir, "300", "300 (worker) R 1 1 1 0 -1 0 0 0 0 0 50 25 0 0 20 0 1 0 90 0 10");
+	write_stat(proc_dir, "self", "1 (not a pid directory) S 0 1 1 0 -1 0 0 0 0 0 0 0 0 0 20 0 1 0 "
+								 "1 0 100");
+	write_stat(proc_dir, "301", "garbage");
+
+	load_proc_table before = load_read_proc_table(proc_dir);
+	ok(before.samples != NULL && before.count == 2, "Only parseable pid directories are read");
+
+	/* the worker gets busy, init stays idle and a new process shows up */
+	write_stat(proc_dir, "300", "300 (worker) R 1 1 1 0 -1 0 0 0 0 0 80 45 0 0 20 0 1 0 90 0 10");
+	write_stat(proc_dir, "302", "302 (short) R 1 1 1 0 -1 0 0 0 0 0 12 0 0 0 20 0 1 0 120 0 10");
+	load_proc_table after = load_read_proc_table(proc_dir);
+
+	load_top_entry top[5];
+	size_t selected = load_select_top(&before, &after, 0.5, 100, 5, top);
+	ok(selected == 3, "Every process is ranked when there are fewer than N");
+	ok(top[0].sample.pid == 300 && top[0].delta_ticks == 50 && top[0].pcpu > 99.9 &&
+		   top[0].pcpu < 100.1,
+	   "Busiest process comes first with its CPU share of the interval");
+	ok(top[1].sample.pid == 302 && top[1].delta_ticks == 12,
+	   "New process is charged with all of its CPU time");
+	ok(top[2].sample.pid == 1 && top[2].delta_ticks == 0, "Idle process comes last");
+
+	ok(load_select_top(&before, &after, 0.5, 100, 0, top) == 0, "N = 0 selects nothing");
+	load_free_proc_table(&before);
+	load_free_proc_table(&after);
+
+	const char *pids[] = {"1", "300", "301", "302", "self"};
+	for (size_t i = 0; i < sizeof(pids) / sizeof(pids[0]); i++) {
+		remove_stat(proc_dir, pids[i]);
+	}
+	rmdir(proc_dir);
+
+	load_proc_table missing = load_read_proc_table("/nonexistent/proc");
+	ok(missing.samples == NULL, "Unreadable /proc is reported");
+
+	/* pressure stall information and cgroup v2 CPU controller files */
+	load_pressure pressure = load_parse_pressure(
+		"some avg10=12.50 avg60=3.25 avg300=0.75 total=123456789\n"
+		"full avg10=1.00 avg60=0.50 avg300=0.00 total=4242\n");
+	ok(pressure.available && pressure.some.avg10 == 12.5 && pressure.some.avg60 == 3.25 &&
+		   pressure.some.avg300 == 0.75 && pressure.some.total == 123456789,
+	   "Pressure \"some\" line is parsed");
+	ok(pressure.full.present && pressure.full.avg10 == 1.0 && pressure.full.total == 4242,
+	   "Pressure \"full\" line is parsed");
+
+	pressure = load_parse_pressure("some avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+	ok(pressure.available && !pressure.full.present, "Missing \"full\" line of older kernels");
+	ok(!load_parse_pressure(NULL).available && !load_parse_pressure("garbage").available,
+	   "Unreadable pressure file is reported");
+
+	load_cgroup_cpu_stat cpu_stat =
+		load_parse_cgroup_cpu_stat("usage_usec 8000000\nuser_usec 6000000\nsystem_usec 2000000\n"
+								   "nr_periods 200\nnr_throttled 50\nthrottled_usec 1500000\n");
+	ok(cpu_stat.available && cpu_stat.usage_usec == 8000000 && cpu_stat.nr_periods == 200 &&
+		   cpu_stat.nr_throttled == 50 && cpu_stat.throttled_usec == 1500000,
+	   "cgroup cpu.stat is parsed");
+	ok(!load_parse_cgroup_cpu_stat("").available, "Empty cpu.stat is reported");
+
+	load_cgroup_cpu_max cpu_max = load_parse_cgroup_cpu_max("150000 100000\n");
+	ok(cpu_max.available && cpu_max.limited && cpu_max.quota_usec == 150000 &&
+		   cpu_max.period_usec == 100000,
+	   "cgroup CPU quota is parsed");
+	cpu_max = load_parse_cgroup_cpu_max("max 100000\n");
+	ok(cpu_max.available && !cpu_max.limited, "cgroup without CPU quota");
+	ok(!load_parse_cgroup_cpu_max("150000 0\n").available, "Zero period is rejected");
+
+	/* benchmark: a busy host with a big synthetic process table */
+	load_proc_table big_before = {
+		.samples = calloc(BENCHMARK_PROCESSES, sizeof(load_proc_sample)),
+		.count = BENCHMARK_PROCESSES,
+	};
+	load_proc_table big_after = {
+		.samples = calloc(BENCHMARK_PROCESSES, sizeof(load_proc_sample)),
+		.count = BENCHMARK_PROCESSES,
+	};
+	if (big_before.samples == NULL || big_after.samples == NULL) {
+		die(STATE_UNKNOWN, "calloc() failed\n");
+	}
+	srandom(4711);
+	for (size_t i = 0; i < BENCHMARK_PROCESSES; i++) {
+		load_proc_sample *process = &big_before.samples[i];
+		process->pid = (pid_t)(i * 7 + 2);
+		process->start_time = (unsigned long long)(random() % 100000);
+		process->cpu_ticks = (unsigned long long)(random() % 1000000);
+		snprintf(process->command, sizeof(process->command), "synthetic%zu", i);
+		big_after.samples[i] = *process;
+		big_after.samples[i].cpu_ticks += (unsigned long long)(random() % 30);
+	}
+	/* /proc lists the processes in a different order each time */
+	for (size_t i = BENCHMARK_PROCESSES - 1; i > 0; i--) {
+		size_t j = (size_t)random() % (i + 1);
+		load_proc_sample tmp = big_after.samples[i];
+		big_after.samples[i] = big_after.samples[j];
+		big_after.samples[j] = tmp;
+	}
+
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	load_top_entry heap_top[BENCHMARK_TOP];
+	selected = load_select_top(&big_before, &big_after, 0.25, 100, BENCHMARK_TOP, heap_top);
+	double heap_seconds = seconds_since(start);
+
+	gettimeofday(&start, NULL);
+	load_top_entry *all = calloc(BENCHMARK_PROCESSES, sizeof(load_top_entry));
+	if (all == NULL) {
+		die(STATE_UNKNOWN, "calloc() failed\n");
+	}
+	for (size_t i = 0; i < BENCHMARK_PROCESSES; i++) {
+		all[i].sample = big_after.samples[i];
+		/* the first sample is in pid order, so the reference gets its lookup for free */
+		const load_proc_sample *previous = &big_before.samples[(all[i].sample.pid - 2) / 7];
+		all[i].delta_ticks = all[i].sample.cpu_ticks - previous->cpu_ticks;
+	}
+	qsort(all, BENCHMARK_PROCESSES, sizeof(load_top_entry), compare_delta);
+	double sort_seconds = seconds_since(start);
+
+	diag("top %d of %d processes: heap selection %.4fs, full sort %.4fs", BENCHMARK_TOP,
+		 BENCHMARK_PROCESSES, heap_seconds, sort_seconds);
+
+	ok(selected == BENCHMARK_TOP, "Heap selection returns N processes");
+	bool same = true;
+	for (size_t i = 0; i < BENCHMARK_TOP; i++) {
+		same = same && heap_top[i].sample.pid == all[i].sample.pid &&
+			   heap_top[i].delta_ticks == all[i].delta_ticks;
+	}
+	ok(same, "Heap selection agrees with sorting the whole table");
+
+	free(all);
+	load_free_proc_table(&big_before);
+	load_free_proc_table(&big_after);
+
+	return exit_status();
+}
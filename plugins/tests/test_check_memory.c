@@ -0,0 +1,133 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "../check_memory.d/meminfo.h"
+#include "../../tap/tap.h"
+
+#include <sys/stat.h>
+
+void print_usage(void) {}
+
+const char *progname = "test_check_memory";
+
+static unsigned long long meminfo_value(const memory_value values[], const char *key) {
+	long index = memory_find_field(memory_meminfo_fields, memory_meminfo_fields_count, key);
+	return (index >= 0 && values[index].present) ? values[index].value : 0;
+}
+
+static void write_file(const char *directory, const char *name, const char *contents) {
+	char path[MAX_INPUT_BUFFER];
+	snprintf(path, sizeof(path), "%s/%s", directory, name);
+	FILE *file = fopen(path, "w");
+	if (file != NULL) {
+		fputs(contents, file);
+		fclose(file);
+	}
+}
+
+static void remove_file(const char *directory, const char *name) {
+	char path[MAX_INPUT_BUFFER];
+	snprintf(path, sizeof(path), "%s/%s", directory, name);
+	unlink(path);
+}
+
+int main(void) {
+	char cgroup_dir[] = "/tmp/test_check_memory.XXXXXX";
+	if (mkdtemp(cgroup_dir) == NULL) {
+		return plan_skip_all("mkdtemp() failed");
+	}
+
+	plan_tests(14);
+
+	memory_value *values = calloc(memory_meminfo_fields_count, sizeof(memory_value));
+	if (values == NULL) {
+		die(STATE_UNKNOWN, "calloc() failed\n");
+	}
+
+	char *text = memory_read_file("./var/proc_meminfo");
+	ok(text != NULL, "meminfo fixture is read");
+	size_t found =
+		memory_parse_fields(text, memory_meminfo_fields, memory_meminfo_fields_count, values);
+	free(text);
+	ok(found == memory_meminfo_fields_count, "Every field of the table is found");
+	ok(meminfo_value(values, "MemTotal") == 32767776ULL * 1024 &&
+		   meminfo_value(values, "MemAvailable") == 23807480ULL * 1024,
+	   "Sizes in kB are converted to Bytes");
+	ok(meminfo_value(values, "Dirty") == 784ULL * 1024 &&
+		   meminfo_value(values, "Slab") == 3801908ULL * 1024,
+	   "Dirty and Slab are read");
+	ok(meminfo_value(values, "Active") == 7860680ULL * 1024,
+	   "Active is not confused with Active(anon)");
+	ok(values[memory_find_field(memory_meminfo_fields, memory_meminfo_fields_count,
+								"HugePages_Total")]
+				   .present &&
+		   meminfo_value(values, "HugePages_Total") == 0 &&
+		   meminfo_value(values, "Hugepagesize") == 2048ULL * 1024,
+	   "Huge page counters stay counters");
+
+	/* an older kernel without MemAvailable, in a different order */
+	found = memory_parse_fields("MemFree: 100 kB\nMemTotal: 200 kB\nBogus: 3 kB\n",
+								memory_meminfo_fields, memory_meminfo_fields_count, values);
+	ok(found == 2 && meminfo_value(values, "MemTotal") == 200 * 1024 &&
+		   !values[memory_find_field(memory_meminfo_fields, memory_meminfo_fields_count,
+									 "MemAvailable")]
+				.present,
+	   "Missing fields are not present, the order does not matter");
+	free(values);
+
+	bool limited = true;
+	unsigned long long limit = 0;
+	ok(memory_parse_cgroup_limit("max\n", &limited, &limit) && !limited, "Unlimited cgroup");
+	ok(memory_parse_cgroup_limit("536870912\n", &limited, &limit) && limited &&
+		   limit == 536870912ULL,
+	   "cgroup memory limit is parsed");
+	ok(!memory_parse_cgroup_limit(NULL, &limited, &limit), "Missing memory.max is reported");
+
+	/* a synthetic cgroup */
+	write_file(cgroup_dir, "memory.current", "104857600\n");
+	write_file(cgroup_dir, "memory.max", "268435456\n");
+	write_file(cgroup_dir, "memory.stat",
+			   "anon 52428800\nfile 41943040\nkernel 1048576\nfile_dirty 4096\nslab 524288\n"
+			   "pgfault 1000\npgmajfault 7\n");
+	write_file(cgroup_dir, "memory.events", "low 0\nhigh 12\nmax 3\noom 1\noom_kill 1\n");
+
+	memory_cgroup cgroup = memory_read_cgroup(cgroup_dir);
+	ok(cgroup.available && cgroup.current == 104857600ULL && cgroup.limited &&
+		   cgroup.max == 268435456ULL,
+	   "cgroup usage and limit are read");
+	long index = memory_find_field(memory_cgroup_stat_fields, memory_cgroup_stat_fields_count,
+								   "file_dirty");
+	ok(cgroup.stat[index].present && cgroup.stat[index].value == 4096, "memory.stat is read");
+	index = memory_find_field(memory_cgroup_events_fields, memory_cgroup_events_fields_count,
+							  "oom_kill");
+	ok(cgroup.events[index].present && cgroup.events[index].value == 1, "memory.events is read");
+	memory_free_cgroup(&cgroup);
+
+	const char *files[] = {"memory.current", "memory.max", "memory.stat", "memory.events"};
+	for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+		remove_file(cgroup_dir, files[i]);
+	}
+	rmdir(cgroup_dir);
+
+	cgroup = memory_read_cgroup(cgroup_dir);
+	ok(!cgroup.available, "Missing cgroup is reported");
+	memory_free_cgroup(&cgroup);
+
+	return exit_status();
+}
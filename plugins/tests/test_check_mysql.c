@@ -0,0 +1,162 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "../check_mysql.d/metrics.h"
+#include "../check_mysql.d/rates.h"
+#include "../../tap/tap.h"
+
+#include <math.h>
+
+void print_usage(void) {}
+
+const char *progname = "test_check_mysql";
+
+static mysql_counter_list counters(unsigned long long connections, unsigned long long queries,
+								   unsigned long long uptime) {
+	mysql_counter_list result = mysql_counter_list_init();
+	mysql_counters_set(&result, "Connections", connections);
+	mysql_counters_set(&result, "Queries", queries);
+	mysql_counters_set(&result, "Uptime", uptime);
+	return result;
+}
+
+int main(void) {
+	plan_tests(28);
+
+	double rates[3];
+
+	mysql_counter_list current = mysql_counter_list_init();
+	mysql_counters_set(&current, "Queries", 1);
+	mysql_counters_set(&current, "Uptime", 1000);
+	mysql_counters_set(&current, "queries", 2000);
+	ok(current.count == 2 && mysql_counters_get(&current, "QUERIES")->value == 2000,
+	   "Counters are set by name without case");
+	char *state = mysql_counters_format(&current);
+	ok(strcmp(state, "Queries=2000 Uptime=1000") == 0, "The counters are stored by name");
+	mysql_counter_list_free(&current);
+
+	mysql_counter_list previous = mysql_counter_list_init();
+	ok(mysql_counters_parse(state, &previous), "The stored counters are parsed");
+	ok(previous.count == 2 && mysql_counters_get(&previous, "Queries")->value == 2000 &&
+		   mysql_counters_get(&previous, "Connections") == NULL,
+	   "Counters missing from the state are not in the list");
+	free(state);
+	mysql_counter_list_free(&previous);
+
+	ok(mysql_counters_parse("Slow_queries=5 Aborted_clients=7", &previous) &&
+		   mysql_counters_get(&previous, "Aborted_clients")->value == 7,
+	   "Any counter is kept in the state");
+	mysql_counter_list_free(&previous);
+	ok(!mysql_counters_parse("Queries=abc", &previous), "Bad values are rejected");
+	mysql_counter_list_free(&previous);
+
+	previous = counters(100, 5000, 1000);
+	current = counters(160, 11000, 1060);
+	mysql_rates_result result = mysql_counters_rates(&previous, &current, "Uptime", 60, rates);
+	ok(result.errorcode == OK && !result.restarted, "Rates are computed between two samples");
+	ok(rates[0] == 1 && rates[1] == 100, "The rates are the deltas per second");
+	ok(isnan(rates[2]), "There is no rate for the uptime");
+	mysql_counter_list_free(&current);
+
+	/* FLUSH STATUS resets the counters but not the uptime */
+	current = counters(160, 10, 1060);
+	result = mysql_counters_rates(&previous, &current, "Uptime", 60, rates);
+	ok(result.errorcode == OK && isnan(rates[1]) && rates[0] == 1,
+	   "A counter which went down has no rate");
+	mysql_counter_list_free(&current);
+
+	current = mysql_counter_list_init();
+	mysql_counters_set(&current, "Slow_queries", 30);
+	mysql_counters_set(&current, "Uptime", 1060);
+	result = mysql_counters_rates(&previous, &current, "Uptime", 60, rates);
+	ok(result.errorcode == OK && isnan(rates[0]), "A new counter has no rate yet");
+	mysql_counter_list_free(&current);
+
+	/* restarted 30 seconds ago, the uptime is lower than before */
+	current = counters(3, 600, 30);
+	result = mysql_counters_rates(&previous, &current, "Uptime", 60, rates);
+	ok(result.restarted && result.elapsed == 30, "A lower uptime is a restart");
+	ok(rates[0] == 0.1 && rates[1] == 20, "The rates after a restart are averages since then");
+	mysql_counter_list_free(&current);
+
+	/* restarted 1500 seconds ago, long after the previous sample */
+	current = counters(150, 3000, 1500);
+	result = mysql_counters_rates(&previous, &current, "Uptime", 3600, rates);
+	ok(result.restarted && rates[1] == 2, "An uptime which grew too little is a restart");
+	mysql_counter_list_free(&current);
+
+	current = counters(160, 11000, 1058);
+	result = mysql_counters_rates(&previous, &current, "Uptime", 60, rates);
+	ok(!result.restarted, "A small difference of the uptime is no restart");
+	mysql_counter_list_free(&current);
+
+	current = counters(100, 5000, 1000);
+	result = mysql_counters_rates(&previous, &current, "Uptime", 0, rates);
+	ok(result.errorcode == ERROR, "No rates without elapsed time");
+	mysql_counter_list_free(&current);
+	mysql_counter_list_free(&previous);
+
+	mysql_metric_set set = mysql_metric_set_init();
+	mysql_metric_set_add_list(&set, "Queries,Innodb_buffer_pool_*,Threads_?unning,Queries");
+	ok(set.count == 1 && set.globs_count == 2, "Names and globs are told apart, once each");
+	ok(mysql_metric_set_index(&set, "queries") == 0, "Names are found without case");
+	ok(mysql_metric_set_matches(&set, "Innodb_buffer_pool_pages_free") &&
+		   mysql_metric_set_matches(&set, "THREADS_RUNNING"),
+	   "Variables matching a glob are in the set");
+	ok(!mysql_metric_set_matches(&set, "Innodb_rows_read") &&
+		   !mysql_metric_set_matches(&set, "Threads_running_total"),
+	   "Other variables are not");
+
+	char *query = mysql_metric_set_query(&set);
+	ok(strcmp(query, "SHOW GLOBAL STATUS WHERE Variable_name IN ('Queries') OR "
+					 "Variable_name LIKE 'Innodb\\_buffer\\_pool\\_%' OR "
+					 "Variable_name LIKE 'Threads\\__unning'") == 0,
+	   "The globs become LIKE patterns");
+	free(query);
+	mysql_metric_set_free(&set);
+	ok(mysql_metric_set_index(&set, "Queries") == -1 && !mysql_metric_set_matches(&set, "Queries"),
+	   "A freed set is empty");
+
+	ok(!mysql_metric_valid_pattern("Queries' OR 1") && !mysql_metric_valid_pattern(""),
+	   "Patterns which would need quoting are invalid");
+
+	/* enough names to grow the index a few times */
+	set = mysql_metric_set_init();
+	char name[32];
+	for (int i = 0; i < 2000; i++) {
+		snprintf(name, sizeof(name), "Var_%d", i);
+		mysql_metric_set_add(&set, name);
+	}
+	ok(set.count == 2000, "Every name is stored");
+	ok(mysql_metric_set_index(&set, "Var_1234") == 1234, "Names are found after growing");
+	ok(mysql_metric_set_index(&set, "Var_2000") == -1, "Missing names are not found");
+
+	query = mysql_metric_set_query(&set);
+	ok(strstr(query, "'Var_0','Var_1',") != NULL && strstr(query, ",'Var_1999')") != NULL,
+	   "Every name is in the query");
+	free(query);
+	mysql_metric_set_free(&set);
+
+	query = mysql_metric_set_query(&set);
+	ok(strcmp(query, "SHOW GLOBAL STATUS WHERE FALSE") == 0, "An empty set selects nothing");
+	free(query);
+
+	return exit_status();
+}
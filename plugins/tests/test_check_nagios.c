@@ -0,0 +1,224 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "../check_nagios.d/status_log.h"
+#include "../check_nagios.d/proc.h"
+#include "../../tap/tap.h"
+
+#include <sys/stat.h>
+
+void print_usage(void) {}
+
+const char *progname = "test_check_nagios";
+
+static void write_file(const char *path, const char *mode, const char *contents) {
+	FILE *file = fopen(path, mode);
+	if (file != NULL) {
+		fputs(contents, file);
+		fclose(file);
+	}
+}
+
+/* a process in the fake proc directory, started ticks clock ticks after boot */
+static void write_process(const char *proc_dir, const char *pid, const char *cmdline,
+						  size_t cmdline_length, unsigned long long ticks) {
+	char *path = NULL;
+	xasprintf(&path, "%s/%s", proc_dir, pid);
+	mkdir(path, 0700);
+	free(path);
+
+	xasprintf(&path, "%s/%s/cmdline", proc_dir, pid);
+	FILE *file = fopen(path, "w");
+	if (file != NULL) {
+		fwrite(cmdline, 1, cmdline_length, file);
+		fclose(file);
+	}
+	free(path);
+
+	char *contents = NULL;
+	xasprintf(&contents, "%s (nagios d) S 1 %s %s 0 -1 4194560 100 0 0 0 1 2 0 0 20 0 1 0 %llu "
+						 "12345 250\n",
+			  pid, pid, pid, ticks);
+	xasprintf(&path, "%s/%s/stat", proc_dir, pid);
+	write_file(path, "w", contents);
+	free(path);
+	free(contents);
+
+	xasprintf(&path, "%s/%s/statm", proc_dir, pid);
+	write_file(path, "w", "1000 250 100 10 0 200 0\n");
+	free(path);
+}
+
+static void remove_process(const char *proc_dir, const char *pid) {
+	const char *files[] = {"cmdline", "stat", "statm", NULL};
+	char path[MAX_INPUT_BUFFER];
+	for (int i = 0; files[i] != NULL; i++) {
+		snprintf(path, sizeof(path), "%s/%s/%s", proc_dir, pid, files[i]);
+		unlink(path);
+	}
+	snprintf(path, sizeof(path), "%s/%s", proc_dir, pid);
+	rmdir(path);
+}
+
+static void test_proc(void) {
+	char proc_dir[] = "/tmp/test_check_nagios_proc.XXXXXX";
+	if (mkdtemp(proc_dir) == NULL) {
+		skip(11, "mkdtemp() failed");
+		return;
+	}
+
+	long ticks_per_second = sysconf(_SC_CLK_TCK);
+	time_t now = time(NULL);
+	char *path = NULL;
+	char *contents = NULL;
+	xasprintf(&path, "%s/stat", proc_dir);
+	xasprintf(&contents, "cpu  1 2 3 4\nbtime %lld\nprocesses 100\n", (long long)(now - 1000));
+	write_file(path, "w", contents);
+	free(path);
+	free(contents);
+
+	ok(nagios_proc_available(proc_dir), "The fake proc directory can be used");
+
+	const char daemon[] = "/usr/sbin/nagios\0-d\0/etc/nagios/nagios.cfg\0";
+	const char worker[] = "/usr/sbin/nagios\0--worker\0/var/lib/nagios/rw/nagios.qh\0";
+	const char plugin[] = "/usr/lib/nagios/plugins/check_nagios\0-C\0/usr/sbin/nagios\0";
+	write_process(proc_dir, "4242", daemon, sizeof(daemon) - 1,
+				  100 * (unsigned long long)ticks_per_second);
+	write_process(proc_dir, "4250", worker, sizeof(worker) - 1,
+				  101 * (unsigned long long)ticks_per_second);
+	write_process(proc_dir, "5000", plugin, sizeof(plugin) - 1,
+				  990 * (unsigned long long)ticks_per_second);
+	/* a kernel thread */
+	write_process(proc_dir, "2", "", 0, 0);
+
+	nagios_proc_result result = nagios_proc_scan(proc_dir, "/usr/sbin/nagios", "check_nagios");
+	ok(result.errorcode == OK, "The fake process table is scanned");
+	ok(result.processes == 2, "The daemon and its worker are found, the plugin is not");
+	ok(result.pid == 4242, "The oldest process is the daemon");
+	ok(result.uptime >= 900 && result.uptime <= 902, "The uptime of the daemon is known");
+	ok(result.rss == 250 * sysconf(_SC_PAGESIZE),
+	   "The resident memory of the daemon is known");
+
+	xasprintf(&path, "%s/nagios.lock", proc_dir);
+	write_file(path, "w", "4242\n");
+	result = nagios_proc_from_pidfile(proc_dir, path, "/usr/sbin/nagios");
+	ok(result.errorcode == OK && result.from_pidfile && result.pid == 4242,
+	   "The daemon is found through the pidfile");
+	ok(result.processes == 1 && result.uptime >= 900, "The pidfile names a single process");
+
+	char *statm = NULL;
+	xasprintf(&statm, "%s/4242/statm", proc_dir);
+	unlink(statm);
+	free(statm);
+	result = nagios_proc_from_pidfile(proc_dir, path, "/usr/sbin/nagios");
+	ok(result.errorcode == OK && result.rss == -1, "The resident memory may be unknown");
+
+	result = nagios_proc_from_pidfile(proc_dir, path, "/usr/sbin/icinga");
+	ok(result.errorcode == ERROR, "A pidfile naming another program is not used");
+
+	/* the pid was given to a process started after the pidfile was written */
+	write_process(proc_dir, "4242", daemon, sizeof(daemon) - 1,
+				  1100 * (unsigned long long)ticks_per_second);
+	result = nagios_proc_from_pidfile(proc_dir, path, "/usr/sbin/nagios");
+	ok(result.errorcode == ERROR, "A recycled pid is not used");
+
+	write_file(path, "w", "4343\n");
+	result = nagios_proc_from_pidfile(proc_dir, path, "/usr/sbin/nagios");
+	ok(result.errorcode == ERROR, "A pidfile of a process which is gone is not used");
+	unlink(path);
+	free(path);
+
+	const char *pids[] = {"2", "4242", "4250", "5000", NULL};
+	for (int i = 0; pids[i] != NULL; i++) {
+		remove_process(proc_dir, pids[i]);
+	}
+	xasprintf(&path, "%s/stat", proc_dir);
+	unlink(path);
+	free(path);
+	rmdir(proc_dir);
+}
+
+int main(void) {
+	plan_tests(28);
+
+	status_log_position position = {0};
+	ok(status_log_scan("/nonexistent/status.log", &position) == ERROR,
+	   "A missing status log is an error");
+
+	char path[] = "/tmp/test_check_nagios.XXXXXX";
+	int file_descriptor = mkstemp(path);
+	if (file_descriptor < 0) {
+		skip(26, "mkstemp() failed");
+		return exit_status();
+	}
+	close(file_descriptor);
+
+	write_file(path, "w", "[1700000100] SERVICE ALERT\n[1700000050] HOST ALERT\n");
+	ok(status_log_scan(path, &position) == OK, "The status log is read");
+	ok(position.latest_entry_time == 1700000100, "The newest timestamp is found");
+	status_log_position first = position;
+	long long first_offset = position.offset;
+	ok(first_offset == 51, "The offset is behind the last line");
+	ok(position.inode != 0, "The position can be continued");
+
+	write_file(path, "a", "[1700000200] SERVICE ALERT\n[1700000300] unfinish");
+	ok(status_log_scan(path, &position) == OK, "The appended lines are read");
+	ok(position.latest_entry_time == 1700000300, "The newest appended timestamp is found");
+	ok(position.offset == first_offset + 27, "An unfinished line is read again next time");
+
+	/* a position into the old lines must not see their timestamps again */
+	position = first;
+	position.latest_entry_time = 0;
+	write_file(path, "a", "ed line\n");
+	ok(status_log_scan(path, &position) == OK && position.latest_entry_time == 1700000300,
+	   "Only the lines behind the offset are read");
+
+	write_file(path, "w", "[1700000400] after the rotation\n");
+	position.offset = 1000;
+	ok(status_log_scan(path, &position) == OK && position.latest_entry_time == 1700000400,
+	   "A shorter file is read from the start");
+	ok(position.offset == 32, "The offset starts again with the new file");
+
+	write_file(path, "w", "info {\n\tcreated=1700000500\n\tversion=4.4.14\n}\n");
+	ok(status_log_scan(path, &position) == OK && position.latest_entry_time == 1700000500,
+	   "The created time of a status.dat is used");
+	ok(position.inode == 0, "A status.dat is not continued");
+
+	status_log_position saved = {.inode = 1234,
+								 .offset = 5678,
+								 .line_length = 42,
+								 .line_hash = 0xfedcba9876543210ULL,
+								 .latest_entry_time = 1700000600};
+	char *state_string = status_log_format_position(saved);
+	status_log_position parsed = {0};
+	ok(status_log_parse_position(state_string, &parsed), "The saved position can be parsed");
+	ok(parsed.inode == 1234 && parsed.offset == 5678 && parsed.line_length == 42 &&
+		   parsed.line_hash == 0xfedcba9876543210ULL && parsed.latest_entry_time == 1700000600,
+	   "The saved position is restored");
+	free(state_string);
+	ok(!status_log_parse_position("garbage", &parsed) && parsed.inode == 1234,
+	   "A broken position is ignored");
+
+	unlink(path);
+
+	test_proc();
+
+	return exit_status();
+}
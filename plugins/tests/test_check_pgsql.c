@@ -0,0 +1,131 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "../check_pgsql.d/stats.h"
+#include "../../tap/tap.h"
+
+void print_usage(void) {}
+
+const char *progname = "test_check_pgsql";
+
+int main(void) {
+	plan_tests(18);
+
+	ok(pgsql_stats_parse_sets("replication") == PGSQL_STATS_REPLICATION,
+	   "A single set is parsed");
+	ok(pgsql_stats_parse_sets("bgwriter,database,replication") ==
+		   (PGSQL_STATS_REPLICATION | PGSQL_STATS_DATABASE | PGSQL_STATS_BGWRITER),
+	   "A list of sets is parsed");
+	ok(pgsql_stats_parse_sets("database,bloat") == 0, "An unknown set is rejected");
+
+	pgsql_counter_list current = {0};
+	pgsql_counters_add(&current, "database postgres xact_commit", 1000);
+	pgsql_counters_add(&current, "database my db xact_commit", 50);
+	pgsql_counters_add(&current, "bgwriter buffers_alloc", 7);
+	ok(current.count == 3, "The counters are added");
+
+	char *formatted = pgsql_counters_format(&current);
+	ok(strcmp(formatted, "database postgres xact_commit=1000;database my db xact_commit=50;"
+						 "bgwriter buffers_alloc=7;") == 0,
+	   "The counters are formatted on one line");
+	free(formatted);
+
+	/* the state file keeps one line of data */
+	char state_dir[] = "/tmp/test_check_pgsql.XXXXXX";
+	if (mkdtemp(state_dir) == NULL) {
+		die(STATE_UNKNOWN, "mkdtemp() failed\n");
+	}
+	setenv("MP_STATE_PATH", state_dir, 1);
+	char *fake_argv[] = {"./check_pgsql", "--stats=database,bgwriter"};
+	state_key key = np_enable_state(NULL, PGSQL_STATS_STATE_VERSION, progname, 2, fake_argv);
+	formatted = pgsql_counters_format(&current);
+	np_state_write_string(key, 1234567890, formatted);
+	free(formatted);
+	state_data *state = np_state_read(key);
+	ok(state != NULL && state->errorcode == OK && state->time == 1234567890,
+	   "The counters are written to the state file");
+
+	pgsql_counter_list previous = pgsql_counters_parse(state->data);
+	ok(previous.count == 3, "Every counter is read back from the state file");
+
+	pgsql_counter_list odd = {0};
+	pgsql_counters_add(&odd, "database a;b=c%d\ne xact_commit", 12);
+	formatted = pgsql_counters_format(&odd);
+	ok(strcmp(formatted, "database a%3Bb%3Dc%25d%0Ae xact_commit=12;") == 0,
+	   "Separators and line breaks in names are escaped");
+	pgsql_counter_list parsed = pgsql_counters_parse(formatted);
+	ok(parsed.count == 1 && strcmp(parsed.counters[0].name, odd.counters[0].name) == 0 &&
+		   parsed.counters[0].value == 12,
+	   "Escaped names are parsed again");
+	free(formatted);
+	pgsql_counters_free(&parsed);
+	pgsql_counters_free(&odd);
+
+	for (int i = 0; i < 1000; i++) {
+		char name[64];
+		snprintf(name, sizeof(name), "database db%d xact_commit", i);
+		pgsql_counters_add(&odd, name, 123456789);
+	}
+	formatted = pgsql_counters_format(&odd);
+	np_state_write_string(key, 1234567890, formatted);
+	free(formatted);
+	pgsql_counters_free(&odd);
+	state = np_state_read(key);
+	parsed = pgsql_counters_parse(state->data);
+	ok(parsed.count == 1000 && strcmp(parsed.counters[999].name, "database db999 xact_commit") == 0,
+	   "Many counters are kept in the state file");
+	pgsql_counters_free(&parsed);
+	unlink(key._filename);
+
+	parsed = pgsql_counters_parse("database a xact_commit=5;database b xact_commit=12");
+	ok(parsed.count == 1 && parsed.counters[0].value == 5,
+	   "A counter cut off at the end is ignored");
+	pgsql_counters_free(&parsed);
+
+	long long delta = 0;
+	ok(pgsql_counter_delta(&previous, "database my db xact_commit", 80, &delta) && delta == 30,
+	   "Names with spaces survive the state file");
+	ok(pgsql_counter_delta(&previous, "database postgres xact_commit", 1000, &delta) &&
+		   delta == 0,
+	   "An unchanged counter has no delta");
+	ok(!pgsql_counter_delta(&previous, "database postgres xact_commit", 10, &delta),
+	   "A counter which went down was reset");
+	ok(!pgsql_counter_delta(&previous, "database template1 xact_commit", 10, &delta),
+	   "A new counter has no delta");
+
+	double rate = 0;
+	ok(pgsql_counter_rate(&previous, "bgwriter buffers_alloc", 127, 60, &rate) && rate == 2,
+	   "The rate is the delta per second");
+	ok(!pgsql_counter_rate(&previous, "bgwriter buffers_alloc", 127, 0, &rate),
+	   "There is no rate without elapsed time");
+
+	pgsql_counters_free(&previous);
+	pgsql_counters_free(&current);
+	ok(current.count == 0 && current.counters == NULL, "The counters are freed");
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%lu/%s", state_dir, (unsigned long)geteuid(), progname);
+	rmdir(path);
+	snprintf(path, sizeof(path), "%s/%lu", state_dir, (unsigned long)geteuid());
+	rmdir(path);
+	rmdir(state_dir);
+
+	return exit_status();
+}
@@ -0,0 +1,90 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "../check_radius.d/client.h"
+#include "../../tap/tap.h"
+
+void print_usage(void) {}
+
+const char *progname = "test_check_radius";
+
+static void from_hex(const char *hex, uint8_t *bytes) {
+	for (size_t i = 0; hex[2 * i] != '\0'; i++) {
+		sscanf(hex + 2 * i, "%2hhx", &bytes[i]);
+	}
+}
+
+/* the examples of RFC 2865 section 7.1 */
+int main(void) {
+#ifndef MOPL_USE_OPENSSL
+	plan_skip_all("the RADIUS client needs OpenSSL");
+#endif
+	plan_tests(10);
+
+	uint8_t authenticator[RADIUS_AUTHENTICATOR_LENGTH];
+	from_hex("0f403f9473978057bd83d5cb98f4227a", authenticator);
+
+	radius_credentials credentials = {
+		.username = "nemo",
+		.password = "arctangent",
+		.secret = "xyzzy5461",
+	};
+	uint8_t packet[RADIUS_MAX_PACKET_LENGTH];
+	size_t length = radius_build_access_request(packet, 0, authenticator, &credentials);
+	ok(length > RADIUS_HEADER_LENGTH && packet[0] == RADIUS_ACCESS_REQUEST && packet[1] == 0,
+	   "An Access-Request is built");
+	ok(((size_t)packet[2] << 8 | packet[3]) == length, "The length field matches");
+
+	uint8_t hidden[16];
+	from_hex("0dbe708d93d413ce3196e43f782a0aee", hidden);
+	const uint8_t *password = NULL;
+	for (size_t i = RADIUS_HEADER_LENGTH; i + 1 < length; i += packet[i + 1]) {
+		if (packet[i] == 2) {
+			password = packet + i;
+			break;
+		}
+	}
+	ok(password != NULL && password[1] == 2 + sizeof(hidden) &&
+		   memcmp(password + 2, hidden, sizeof(hidden)) == 0,
+	   "The password is hidden");
+
+	uint8_t reply[38];
+	from_hex("0200002686fe220e7624ba2a1005f6bf9b55e0b2060600000001"
+			 "0f06000000000e06c0a80103",
+			 reply);
+	ok(radius_check_reply(reply, sizeof(reply), 0, authenticator, "xyzzy5461") ==
+		   RADIUS_REPLY_ACCEPT,
+	   "The Access-Accept is verified");
+	ok(radius_check_reply(reply, sizeof(reply), 1, authenticator, "xyzzy5461") ==
+		   RADIUS_REPLY_INVALID,
+	   "A reply to another identifier is invalid");
+	ok(radius_check_reply(reply, sizeof(reply), 0, authenticator, "wrong") == RADIUS_REPLY_INVALID,
+	   "A reply signed with another secret is invalid");
+	ok(radius_check_reply(reply, sizeof(reply) - 1, 0, authenticator, "xyzzy5461") ==
+		   RADIUS_REPLY_INVALID,
+	   "A truncated reply is invalid");
+
+	ok(radius_latency_bucket(0.5) == 0, "A fast reply lands in the first bucket");
+	ok(radius_latency_bucket(5) == 0, "The bounds are inclusive");
+	ok(radius_latency_bucket(60000) == RADIUS_LATENCY_BUCKETS - 1,
+	   "A slow reply lands in the last bucket");
+
+	return exit_status();
+}
@@ -0,0 +1,123 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "../check_smtp.d/check_smtp_helpers.h"
+#include "../../tap/tap.h"
+
+void print_usage(void) {}
+
+const char *progname = "test_check_smtp";
+
+/* example.com MX: 20 mx2.example.com, 10 mx1.example.com, 10 aaaa.example.com */
+static const unsigned char mx_answer[] = {
+	0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00,
+	/* question */
+	0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x03, 'c', 'o', 'm', 0x00, 0x00, 0x0f, 0x00, 0x01,
+	/* answers */
+	0xc0, 0x0c, 0x00, 0x0f, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x08, 0x00, 0x14, 0x03, 'm',
+	'x', '2', 0xc0, 0x0c,
+	0xc0, 0x0c, 0x00, 0x0f, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x08, 0x00, 0x0a, 0x03, 'm',
+	'x', '1', 0xc0, 0x0c,
+	0xc0, 0x0c, 0x00, 0x0f, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x09, 0x00, 0x0a, 0x04, 'a',
+	'a', 'a', 'a', 0xc0, 0x0c};
+
+/* example.com MX: 0 . */
+static const unsigned char null_mx_answer[] = {
+	0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x07, 'e', 'x',
+	'a',  'm',  'p',  'l',  'e',  0x03, 'c',  'o',  'm',  0x00, 0x00, 0x0f, 0x00, 0x01, 0xc0,
+	0x0c, 0x00, 0x0f, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x03, 0x00, 0x00, 0x00};
+
+static const unsigned char nxdomain_answer[] = {
+	0x12, 0x34, 0x81, 0x83, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 'e', 'x', 'a',
+	'm',  'p',  'l',  'e',  0x03, 'c',  'o',  'm',  0x00, 0x00, 0x0f, 0x00, 0x01};
+
+int main(void) {
+	plan_tests(15);
+
+	smtp_mx_list mx_list = smtp_parse_mx_answer(mx_answer, sizeof(mx_answer));
+	ok(mx_list.status == SMTP_MX_OK, "MX answer is parsed");
+	ok(mx_list.count == 3, "All MX records are found");
+	ok(strcmp(mx_list.targets[0].host, "aaaa.example.com") == 0 &&
+		   mx_list.targets[0].preference == 10,
+	   "Equal preferences are sorted by name");
+	ok(strcmp(mx_list.targets[1].host, "mx1.example.com") == 0, "Compressed names are expanded");
+	ok(strcmp(mx_list.targets[2].host, "mx2.example.com") == 0 &&
+		   mx_list.targets[2].preference == 20,
+	   "Lowest preference comes last");
+
+	mx_list = smtp_parse_mx_answer(null_mx_answer, sizeof(null_mx_answer));
+	ok(mx_list.status == SMTP_MX_NULL_MX && mx_list.count == 0, "Null MX is recognized");
+
+	mx_list = smtp_parse_mx_answer(nxdomain_answer, sizeof(nxdomain_answer));
+	ok(mx_list.status == SMTP_MX_NXDOMAIN, "NXDOMAIN is recognized");
+
+	mx_list = smtp_parse_mx_answer(mx_answer, 20);
+	ok(mx_list.status == SMTP_MX_ERROR, "Truncated answer is rejected");
+
+	const char *ehlo = "250-mail.example.com\r\n250-Pipelining\r\n250-SIZE 10240000\r\n"
+					   "250 STARTTLS";
+	ok(smtp_ehlo_has_keyword(ehlo, "PIPELINING"), "EHLO keywords are not case sensitive");
+	ok(smtp_ehlo_has_keyword(ehlo, "SIZE") && smtp_ehlo_has_keyword(ehlo, "STARTTLS"),
+	   "Keywords with parameters and on the last line are found");
+	ok(!smtp_ehlo_has_keyword("250-mail.example.com\r\n250 X-PIPELINING\r\n", "PIPELINING") &&
+		   !smtp_ehlo_has_keyword("250-PIPELININGX\r\n250 HELP\r\n", "PIPELINING") &&
+		   !smtp_ehlo_has_keyword("250 mail.example.com PIPELINING\r\n", "PIPELINING"),
+	   "Only whole keywords at the start of a line count");
+
+	/* the steps of a dialogue like it runs in a child process */
+	mp_subcheck dialogue = mp_subcheck_init();
+	dialogue.output = "mx1.example.com";
+
+	mp_subcheck sc_banner = mp_subcheck_init();
+	sc_banner = mp_set_subcheck_state(sc_banner, STATE_OK);
+	sc_banner.output = "banner received";
+	mp_add_subcheck_to_subcheck(&dialogue, sc_banner);
+
+	char message[SMTP_SWEEP_MESSAGE_MAX];
+	ok(smtp_worst_step(dialogue, message, sizeof(message)) == STATE_OK && message[0] == '\0',
+	   "A dialogue without problems has no message");
+
+	mp_subcheck sc_rcpt = mp_subcheck_init();
+	sc_rcpt = mp_set_subcheck_state(sc_rcpt, STATE_WARNING);
+	sc_rcpt.output = "recipient rejected";
+	mp_add_subcheck_to_subcheck(&dialogue, sc_rcpt);
+
+	mp_subcheck sc_quit = mp_subcheck_init();
+	mp_subcheck sc_quit_reply = mp_subcheck_init();
+	sc_quit_reply = mp_set_subcheck_state(sc_quit_reply, STATE_CRITICAL);
+	sc_quit_reply.output = "no reply";
+	mp_add_subcheck_to_subcheck(&sc_quit, sc_quit_reply);
+	sc_quit.output = "QUIT failed";
+	mp_add_subcheck_to_subcheck(&dialogue, sc_quit);
+
+	mp_subcheck sc_auth = mp_subcheck_init();
+	sc_auth = mp_set_subcheck_state(sc_auth, STATE_CRITICAL);
+	sc_auth.output = "authentication failed";
+	mp_add_subcheck_to_subcheck(&dialogue, sc_auth);
+
+	ok(smtp_worst_step(dialogue, message, sizeof(message)) == STATE_CRITICAL,
+	   "The state of the dialogue is the worst state of the steps");
+	ok(strcmp(message, "QUIT failed") == 0, "The first step with the worst state is reported");
+
+	char short_message[8];
+	smtp_worst_step(dialogue, short_message, sizeof(short_message));
+	ok(strcmp(short_message, "QUIT fa") == 0, "A long message is cut off");
+
+	return exit_status();
+}
@@ -0,0 +1,6 @@
+#!/usr/bin/perl
+use Test::More;
+if (! -e "./test_check_smtp") {
+	plan skip_all => "./test_check_smtp not compiled - please enable libtap library to test";
+}
+exec "./test_check_smtp";
@@ -12,10 +12,40 @@ const char *progname = "test_check_swap";
 int main(void) {
 	swap_result test_data = getSwapFromProcMeminfo("./var/proc_meminfo");
 
-	plan_tests(4);
+	plan_tests(13);
 
 	ok(test_data.errorcode == 0, "Test whether we manage to retrieve swap data");
 	ok(test_data.metrics.total == 34233905152, "Is the total Swap correct");
 	ok(test_data.metrics.free == 34233905152, "Is the free Swap correct");
 	ok(test_data.metrics.used == 0, "Is the used Swap correct");
+
+	swap_threshold_parsed threshold = parse_swap_threshold("1048576");
+	ok(threshold.error == SWAP_THRESHOLD_PARSING_SUCCESS && !threshold.threshold.is_percentage &&
+		   threshold.threshold.value == 1048576,
+	   "Threshold in Bytes is parsed");
+	threshold = parse_swap_threshold("20%");
+	ok(threshold.error == SWAP_THRESHOLD_PARSING_SUCCESS && threshold.threshold.is_percentage &&
+		   threshold.threshold.value == 20,
+	   "Percentage threshold is parsed");
+	ok(parse_swap_threshold("101%").error == SWAP_THRESHOLD_PERCENTAGE_TOO_BIG,
+	   "Percentage over 100 is rejected");
+	ok(parse_swap_threshold("ten%").error == SWAP_THRESHOLD_PARSING_FAILURE &&
+		   parse_swap_threshold("").error == SWAP_THRESHOLD_PARSING_FAILURE,
+	   "Garbage threshold is rejected");
+
+	swap_vmstat_result vmstat = getVmstatFromProc("./var/proc_vmstat");
+	ok(vmstat.errorcode == STATE_OK, "vmstat counters are read");
+	ok(vmstat.counters.pswpin == 1523 && vmstat.counters.pswpout == 8841 &&
+		   vmstat.counters.pgmajfault == 4711,
+	   "pswpin, pswpout and pgmajfault are found");
+
+	swap_vmstat later = {.pswpin = 1623, .pswpout = 9841, .pgmajfault = 4721};
+	swap_rates rates = compute_swap_rates(vmstat.counters, later, 10);
+	ok(rates.errorcode == OK && rates.swap_in == 10 && rates.swap_out == 100 &&
+		   rates.major_faults == 1,
+	   "Rates are per second");
+	ok(compute_swap_rates(later, vmstat.counters, 10).errorcode == ERROR,
+	   "Counters going backwards are no rate");
+	ok(getVmstatFromProc("./var/nonexistent").errorcode == STATE_UNKNOWN,
+	   "Missing vmstat is reported");
 }
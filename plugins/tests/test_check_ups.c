@@ -0,0 +1,70 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "../check_ups.d/vars.h"
+#include "../../tap/tap.h"
+
+void print_usage(void) {}
+
+const char *progname = "test_check_ups";
+
+int main(void) {
+	plan_tests(9);
+
+	char *words[4];
+	char line[] = "VAR ups1 ups.status \"OL CHRG\"";
+	ok(nut_split_line(line, words, 4) == 4 && strcmp(words[2], "ups.status") == 0 &&
+		   strcmp(words[3], "OL CHRG") == 0,
+	   "A quoted value keeps its spaces");
+
+	char escaped[] = "UPS ups1 \"a \\\"big\\\" one\\\\\"";
+	ok(nut_split_line(escaped, words, 4) == 3 && strcmp(words[2], "a \"big\" one\\") == 0,
+	   "Escaped quotes and backslashes are unescaped");
+
+	char more[] = "VAR ups1 ups.load \"23\" trailing";
+	ok(nut_split_line(more, words, 4) == 4 && strcmp(words[3], "23") == 0,
+	   "At most the requested number of words is returned");
+
+	char empty[] = "   ";
+	ok(nut_split_line(empty, words, 4) == 0, "A blank line has no words");
+
+	ups_vars vars = ups_vars_init();
+	ok(ups_vars_get(&vars, "battery.charge") == NULL, "An empty table has no variables");
+
+	char name[32];
+	char value[32];
+	for (int i = 0; i < 200; i++) {
+		snprintf(name, sizeof(name), "var.%d", i);
+		snprintf(value, sizeof(value), "%d", i);
+		ups_vars_set(&vars, name, value);
+	}
+	ok(vars.vars_num == 200 && vars.index.keys_num == 200, "The table grows with the variables");
+	ok(strcmp(ups_vars_get(&vars, "var.0"), "0") == 0 &&
+		   strcmp(ups_vars_get(&vars, "var.199"), "199") == 0,
+	   "Variables are found after growing");
+
+	ups_vars_set(&vars, "var.7", "seven");
+	ok(vars.vars_num == 200 && strcmp(ups_vars_get(&vars, "var.7"), "seven") == 0,
+	   "Setting a variable again replaces its value");
+	ok(ups_vars_get(&vars, "var.200") == NULL, "Unknown variables are not found");
+	ups_vars_free(&vars);
+
+	return exit_status();
+}
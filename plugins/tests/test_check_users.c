@@ -0,0 +1,76 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "../check_users.d/sessions.h"
+#include "../../tap/tap.h"
+
+void print_usage(void) {}
+
+const char *progname = "test_check_users";
+
+int main(void) {
+	plan_tests(14);
+
+	char buffer[64];
+	ok(strcmp(users_tty_class("pts/12", buffer, sizeof(buffer)), "pts") == 0,
+	   "A pseudo terminal is a pts session");
+	ok(strcmp(users_tty_class("tty1", buffer, sizeof(buffer)), "tty") == 0,
+	   "A virtual console is a tty session");
+	ok(strcmp(users_tty_class(":0", buffer, sizeof(buffer)), "x11") == 0,
+	   "An X display is a x11 session");
+	ok(strcmp(users_tty_class("", buffer, sizeof(buffer)), "unknown") == 0,
+	   "A session without a line is unknown");
+	ok(users_tty_idle(":1") == -1, "The idle time of an X display is unknown");
+
+	users_breakdown breakdown = users_breakdown_init();
+	users_breakdown_add(&breakdown, "alice", 10, 3600);
+	users_breakdown_add(&breakdown, "bob", 7200, 3600);
+	users_breakdown_add(&breakdown, "alice", -1, 3600);
+	users_breakdown_add(&breakdown, "alice", 4000, 3600);
+	ok(breakdown.count == 2 && breakdown.sessions == 4, "The sessions are grouped");
+
+	users_breakdown_sort(&breakdown);
+	ok(strcmp(breakdown.groups[0].name, "alice") == 0 && breakdown.groups[0].sessions == 3,
+	   "The group with the most sessions is first");
+	ok(breakdown.groups[0].idle_sessions == 1, "Only sessions idle for too long are idle");
+	ok(strcmp(breakdown.groups[1].name, "bob") == 0 && breakdown.groups[1].idle_sessions == 1,
+	   "The smaller group follows");
+
+	users_breakdown_add(&breakdown, "bob", 0, 3600);
+	ok(breakdown.count == 2 && breakdown.groups[1].sessions == 2,
+	   "The groups are still found after sorting");
+
+	/* enough groups to grow the index a few times */
+	char name[32];
+	for (int session = 0; session < 5000; session++) {
+		snprintf(name, sizeof(name), "user%d", session % 1000);
+		users_breakdown_add(&breakdown, name, 0, 3600);
+	}
+	ok(breakdown.count == 1002, "Every user has one group");
+	ok(breakdown.sessions == 5005, "Every session is counted");
+	users_breakdown_sort(&breakdown);
+	ok(breakdown.groups[0].sessions == 5 && strcmp(breakdown.groups[0].name, "user0") == 0,
+	   "Groups with the same number of sessions are ordered by name");
+
+	users_breakdown_free(&breakdown);
+	ok(breakdown.count == 0 && breakdown.groups == NULL, "The breakdown is freed");
+
+	return exit_status();
+}
@@ -0,0 +1,213 @@
+/*****************************************************************************
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *****************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "../dbbroker.h"
+#include "../../tap/tap.h"
+
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+void print_usage(void) {}
+
+const char *progname = "test_dbbroker";
+
+/* a database where the connection string is the connection */
+static void *fake_connect(const char *dsn, dbbroker_reply *reply) {
+	if (strcmp(dsn, "refuse") == 0) {
+		reply->message = strdup("connection refused");
+		reply->error_code = 111;
+		return NULL;
+	}
+	return strdup(dsn);
+}
+
+/* the flaky database drops every connection between two checks */
+static bool fake_alive(void *connection) { return strcmp(connection, "flaky") != 0; }
+
+static dbbroker_reply fake_query(void *connection, const char *query) {
+	(void)connection;
+	dbbroker_reply result = {
+		.status = DBBROKER_OK,
+	};
+	if (strcmp(query, "slow") == 0) {
+		sleep(2);
+		result.value = strdup("42");
+	} else if (strcmp(query, "fail") == 0) {
+		result.status = DBBROKER_QUERY_FAILED;
+		result.message = strdup("syntax error");
+	} else if (strcmp(query, "empty") == 0) {
+		result.status = DBBROKER_NO_ROWS;
+	} else {
+		result.value = strdup("42");
+	}
+	return result;
+}
+
+static void fake_close(void *connection) { free(connection); }
+
+static const dbbroker_backend fake_backend = {
+	.name = "fake",
+	.connect = fake_connect,
+	.alive = fake_alive,
+	.query = fake_query,
+	.close = fake_close,
+};
+
+static pid_t broker_pid(const char *socket_path) {
+	char lock_path[PATH_MAX];
+	snprintf(lock_path, sizeof(lock_path), "%s.lock", socket_path);
+	FILE *lock = fopen(lock_path, "r");
+	long pid = 0;
+	if (lock != NULL) {
+		if (fscanf(lock, "%ld", &pid) != 1) {
+			pid = 0;
+		}
+		fclose(lock);
+	}
+	return (pid_t)pid;
+}
+
+static void stop_broker(const char *socket_path) {
+	pid_t pid = broker_pid(socket_path);
+	if (pid > 0) {
+		kill(pid, SIGKILL);
+	}
+	/* it is not our child, wait until it is gone */
+	for (int i = 0; i < 100 && pid > 0 && kill(pid, 0) == 0; i++) {
+		usleep(10 * 1000);
+	}
+}
+
+int main(void) {
+	plan_tests(19);
+
+	/* the directory of the socket must not be writable by others */
+	char directory[] = "/tmp/test_dbbroker.XXXXXX";
+	if (mkdtemp(directory) == NULL) {
+		diag("could not create a directory for the socket");
+		return exit_status();
+	}
+	char socket_path[PATH_MAX];
+	snprintf(socket_path, sizeof(socket_path), "%s/broker", directory);
+
+	dbbroker_reply reply = dbbroker_request(socket_path, &fake_backend, "db1", "SELECT 42");
+	ok(reply.status == DBBROKER_OK && strcmp(reply.value, "42") == 0,
+	   "The first request starts a broker which runs the query");
+	ok(!reply.reused, "The first connection is a new one");
+	ok(broker_pid(socket_path) > 0 && broker_pid(socket_path) != getpid(),
+	   "The lock file holds the pid of the broker");
+	dbbroker_reply_free(&reply);
+
+	reply = dbbroker_request(socket_path, &fake_backend, "db1", "SELECT 42");
+	ok(reply.status == DBBROKER_OK && reply.reused && reply.connect_time == 0,
+	   "The connection is reused by the next check");
+	dbbroker_reply_free(&reply);
+
+	reply = dbbroker_request(socket_path, &fake_backend, "db2", NULL);
+	ok(reply.status == DBBROKER_OK && !reply.reused && reply.value == NULL,
+	   "Another connection string gets its own connection, without a query");
+	dbbroker_reply_free(&reply);
+
+	/* a slow query of another connection string does not hold up this one */
+	pid_t slow_check = fork();
+	if (slow_check == 0) {
+		reply = dbbroker_request(socket_path, &fake_backend, "slowdb", "slow");
+		_exit(reply.status == DBBROKER_OK ? 0 : 1);
+	}
+	usleep(200 * 1000);
+	reply = dbbroker_request(socket_path, &fake_backend, "db1", "SELECT 42");
+	int slow_status;
+	ok(reply.status == DBBROKER_OK && waitpid(slow_check, &slow_status, WNOHANG) == 0,
+	   "Another connection string is served while a slow query runs");
+	dbbroker_reply_free(&reply);
+	ok(waitpid(slow_check, &slow_status, 0) == slow_check && WIFEXITED(slow_status) &&
+		   WEXITSTATUS(slow_status) == 0,
+	   "The slow query gets its reply too");
+
+	reply = dbbroker_request(socket_path, &fake_backend, "refuse", "SELECT 42");
+	ok(reply.status == DBBROKER_CONNECT_FAILED &&
+		   strcmp(reply.message, "connection refused") == 0 && reply.error_code == 111,
+	   "Connection errors are passed on");
+	dbbroker_reply_free(&reply);
+
+	reply = dbbroker_request(socket_path, &fake_backend, "db1", "fail");
+	ok(reply.status == DBBROKER_QUERY_FAILED && strcmp(reply.message, "syntax error") == 0,
+	   "Query errors are passed on");
+	dbbroker_reply_free(&reply);
+
+	reply = dbbroker_request(socket_path, &fake_backend, "db1", "empty");
+	ok(reply.status == DBBROKER_NO_ROWS && reply.reused, "The result status is passed on");
+	dbbroker_reply_free(&reply);
+
+	reply = dbbroker_request(socket_path, &fake_backend, "flaky", "SELECT 42");
+	dbbroker_reply_free(&reply);
+	reply = dbbroker_request(socket_path, &fake_backend, "flaky", "SELECT 42");
+	ok(reply.status == DBBROKER_OK && !reply.reused, "Dead connections are replaced");
+	dbbroker_reply_free(&reply);
+
+	dbbroker_backend other_backend = fake_backend;
+	other_backend.name = "other";
+	reply = dbbroker_request(socket_path, &other_backend, "db1", "SELECT 42");
+	ok(reply.status == DBBROKER_UNAVAILABLE && reply.message != NULL,
+	   "A broker does not answer plugins of another database");
+	dbbroker_reply_free(&reply);
+
+	/* a broker which was killed leaves its socket behind */
+	pid_t first_broker = broker_pid(socket_path);
+	stop_broker(socket_path);
+	ok(access(socket_path, F_OK) == 0, "The socket of a killed broker is left behind");
+
+	reply = dbbroker_request(socket_path, &fake_backend, "db1", "SELECT 42");
+	ok(reply.status == DBBROKER_OK && !reply.reused,
+	   "A new broker is started on a stale socket");
+	ok(broker_pid(socket_path) != first_broker, "It is another broker");
+	dbbroker_reply_free(&reply);
+
+	stop_broker(socket_path);
+	unlink(socket_path);
+	char lock_path[PATH_MAX];
+	snprintf(lock_path, sizeof(lock_path), "%s.lock", socket_path);
+	unlink(lock_path);
+
+	chmod(directory, 0770);
+	reply = dbbroker_request(socket_path, &fake_backend, "db1", "SELECT 42");
+	ok(reply.status == DBBROKER_UNAVAILABLE && reply.message != NULL,
+	   "A socket in a directory writable by the group is not used");
+	ok(access(socket_path, F_OK) != 0 && broker_pid(socket_path) == 0,
+	   "No broker is started for it");
+	dbbroker_reply_free(&reply);
+	unlink(lock_path);
+	rmdir(directory);
+
+	char long_path[PATH_MAX];
+	memset(long_path, 'x', 200);
+	memcpy(long_path, "/tmp/", 5);
+	long_path[200] = '\0';
+	reply = dbbroker_request(long_path, &fake_backend, "db1", "SELECT 42");
+	ok(reply.status == DBBROKER_UNAVAILABLE && reply.message != NULL,
+	   "A socket path which is too long makes the broker unavailable");
+	ok(access(long_path, F_OK) != 0, "Nothing is left behind for it");
+	dbbroker_reply_free(&reply);
+	snprintf(lock_path, sizeof(lock_path), "%s.lock", long_path);
+	unlink(lock_path);
+
+	return exit_status();
+}
@@ -0,0 +1,6 @@
+#!/usr/bin/perl
+use Test::More;
+if (! -e "./test_dbbroker") {
+	plan skip_all => "./test_dbbroker not compiled - please enable libtap library to test";
+}
+exec "./test_dbbroker";